@@ -0,0 +1,465 @@
+/*
+ * alias.c
+ *
+ * Alias analysis.  Every load and store in a function is tagged with what it
+ * may touch, so that later passes can tell whether a store leaves the value
+ * of an earlier load or store somewhere else intact.
+ *
+ * Addresses are followed through the temporaries that hold them: an
+ * IR_ADDRESS_OF names a slot of the frame or a global, and adding a constant
+ * to it keeps the access exact, while adding anything else only keeps the
+ * object it is in.  Distinct slots, distinct globals and the frame and the
+ * globals never overlap.
+ *
+ * A slot's address escapes if it is used for anything but a load or store,
+ * or to work out another address that is.  Only bytes of the frame that some
+ * escaping slot covers can be reached through a pointer we know nothing
+ * about, and then, as C allows, only by an access of the same width, or of
+ * a char.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "ir.h"
+#include "frame.h"
+#include "alias.h"
+
+/* Rounds of working out values before giving up on a function */
+#define ALIAS_MAX_ROUNDS 16
+
+/* Offsets below this are parameters and saved registers, not slots */
+#define ALIAS_FRAME_BASE 88
+/* ...and below this, parameters */
+#define ALIAS_PARAMETERS 16
+
+/* What is known about the value of a temporary */
+struct alias_value {
+  /* ALIAS_NONE if it is not known to be an address */
+  int kind;
+  char *label;
+  int exact;
+  int offset;
+  /* The object the address is in; size 0 if not known */
+  int object, size;
+  /* IR_LOAD_IMMEDIATE and arithmetic on them */
+  int constant;
+  long number;
+};
+
+/* A range of frame bytes that may be reached through a pointer */
+struct alias_range {
+  int from, to;
+};
+
+static struct alias_range *alias_escaped;
+static int alias_escaped_len, alias_escaped_size;
+/* Set if an address escaped from an object whose size is not known */
+static int alias_frame_escapes;
+
+/* alias_defines - whether an instruction's first operand is a temporary it writes */
+static int alias_defines(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_STORE_BYTE: case IR_STORE_HALF_WORD: case IR_STORE_WORD:
+    case IR_SEQUENCE_PT: case IR_PARAMETER: case IR_RETURN:
+    case IR_PRINT_NUMBER: case IR_PRINT_STRING:
+    case IR_GOTO_IF_FALSE: case IR_GOTO_IF_TRUE:
+    case IR_GOTO_IF_EQUAL: case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS: case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER: case IR_GOTO_IF_GREATER_EQUAL:
+    case IR_GOTO_TABLE:
+      return 0;
+    default:
+      return instruction->operands[0].kind == OPERAND_TEMPORARY;
+  }
+}
+
+/* alias_width - the bytes a load or store accesses, or 0 for other instructions */
+static int alias_width(int kind) {
+  switch (kind) {
+    case IR_LOAD_BYTE: case IR_LOAD_BYTE_U: case IR_STORE_BYTE:
+      return 1;
+    case IR_LOAD_HALF_WORD: case IR_LOAD_HALF_WORD_U: case IR_STORE_HALF_WORD:
+      return 2;
+    case IR_LOAD_WORD: case IR_STORE_WORD:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+/* alias_frame_object - finds the object a frame offset is in
+ *
+ * Parameters:
+ *   value - alias_value - set to the address of the offset
+ *   offset - int - the offset from $fp
+ *   slots - frame_slot - the function's slots
+ *   count - int - how many there are
+ */
+static void alias_frame_object(struct alias_value *value, int offset, struct frame_slot *slots, int count) {
+  int low = 0, high = 0, i, found = 0;
+
+  value->kind = ALIAS_FRAME;
+  value->exact = 1;
+  value->offset = offset;
+  value->object = 0;
+  value->size = 0;
+  if (offset < ALIAS_PARAMETERS) {
+    value->object = offset & ~3;
+    value->size = 4;
+    return;
+  }
+  if (offset < ALIAS_FRAME_BASE) {
+    return;
+  }
+
+  // Variables in different blocks may share space, so take in all of them
+  for (i = 0; i < count; i++) {
+    int from = slots[i].offset, to = slots[i].offset + slots[i].size;
+    if (offset < from || offset >= to) {
+      continue;
+    }
+    if (!found || from < low) {
+      low = from;
+    }
+    if (!found || to > high) {
+      high = to;
+    }
+    found = 1;
+  }
+  if (found) {
+    value->object = low;
+    value->size = high - low;
+  }
+}
+
+/* alias_escape - notes that the object an address is in may be reached through a pointer */
+static void alias_escape(struct alias_value *value) {
+  if (value->kind != ALIAS_FRAME) {
+    return;
+  }
+  if (value->size == 0) {
+    alias_frame_escapes = 1;
+    return;
+  }
+  if (alias_escaped_len == alias_escaped_size) {
+    alias_escaped_size = alias_escaped_size * 2 + 8;
+    alias_escaped = realloc(alias_escaped, sizeof(struct alias_range) * alias_escaped_size);
+    assert(NULL != alias_escaped);
+  }
+  alias_escaped[alias_escaped_len].from = value->object;
+  alias_escaped[alias_escaped_len].to = value->object + value->size;
+  alias_escaped_len++;
+}
+
+/* alias_range_escapes - whether any of a range of frame bytes may be reached through a pointer */
+static int alias_range_escapes(int from, int to) {
+  int i;
+
+  if (alias_frame_escapes) {
+    return 1;
+  }
+  for (i = 0; i < alias_escaped_len; i++) {
+    if (from < alias_escaped[i].to && alias_escaped[i].from < to) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* alias_derive - works out the value an instruction gives its temporary
+ *
+ * Parameters:
+ *   instruction - ir_instruction - the only definition of the temporary
+ *   values - alias_value - what is known so far, by temporary
+ *   slots, count - frame_slot - the function's slots
+ *
+ * Returns what is known about the result
+ */
+static struct alias_value alias_derive(struct ir_instruction *instruction, struct alias_value *values,
+                                       struct frame_slot *slots, int count) {
+  struct alias_value result, *left = NULL, *right = NULL;
+
+  memset(&result, 0, sizeof(result));
+  if (instruction->operands[1].kind == OPERAND_TEMPORARY) {
+    left = &values[instruction->operands[1].data.temporary];
+  }
+  if (instruction->operands[2].kind == OPERAND_TEMPORARY) {
+    right = &values[instruction->operands[2].data.temporary];
+  }
+
+  switch (instruction->kind) {
+    case IR_LOAD_IMMEDIATE:
+      result.constant = 1;
+      result.number = instruction->operands[1].data.number;
+      break;
+
+    case IR_ADDRESS_OF:
+      if (instruction->operands[1].kind == OPERAND_LVALUE) {
+        alias_frame_object(&result, instruction->operands[1].data.offset, slots, count);
+      } else if (instruction->operands[1].kind == OPERAND_LABEL) {
+        result.kind = ALIAS_GLOBAL;
+        result.label = instruction->operands[1].data.label_name;
+        result.exact = 1;
+      }
+      break;
+
+    case IR_COPY:
+      if (NULL != left) {
+        result = *left;
+      }
+      break;
+
+    case IR_ADDI:
+      if (NULL != left && instruction->operands[2].kind == OPERAND_NUMBER) {
+        result = *left;
+        result.offset += (int)instruction->operands[2].data.number;
+        result.number += instruction->operands[2].data.number;
+      }
+      break;
+
+    case IR_ADD: case IR_ADDU: case IR_SUBTRACT: case IR_SUBU:
+      if (NULL == left || NULL == right) {
+        break;
+      }
+      if (left->constant && right->constant) {
+        result.constant = 1;
+        result.number = (instruction->kind == IR_ADD || instruction->kind == IR_ADDU) ?
+            left->number + right->number : left->number - right->number;
+      } else if (left->kind != ALIAS_NONE && right->kind == ALIAS_NONE) {
+        result = *left;
+        if (!right->constant) {
+          result.exact = 0;
+        } else if (instruction->kind == IR_ADD || instruction->kind == IR_ADDU) {
+          result.offset += (int)right->number;
+        } else {
+          result.offset -= (int)right->number;
+        }
+      } else if (right->kind != ALIAS_NONE && left->kind == ALIAS_NONE &&
+                 (instruction->kind == IR_ADD || instruction->kind == IR_ADDU)) {
+        result = *right;
+        if (!left->constant) {
+          result.exact = 0;
+        } else {
+          result.offset += (int)left->number;
+        }
+      }
+      break;
+
+    case IR_MULTIPLY: case IR_MULU: case IR_SHIFT_LEFT:
+      if (NULL != left && NULL != right && left->constant && right->constant) {
+        result.constant = 1;
+        result.number = (instruction->kind == IR_SHIFT_LEFT) ?
+            left->number << right->number : left->number * right->number;
+      }
+      break;
+
+    default:
+      break;
+  }
+  return result;
+}
+
+/* alias_is_derivation - whether an instruction works out an address from its operands */
+static int alias_is_derivation(int kind) {
+  switch (kind) {
+    case IR_COPY: case IR_ADDI: case IR_ADD: case IR_ADDU: case IR_SUBTRACT: case IR_SUBU:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* alias_analyze_function - tags each load and store of a function with what it may touch
+ *
+ * Parameters:
+ *   begin, end - ir_instruction - the function's first and last instructions
+ *   slots - frame_slot - the function's slots, at their final offsets
+ *   count - int - how many there are
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void alias_analyze_function(struct ir_instruction *begin, struct ir_instruction *end,
+                            struct frame_slot *slots, int count) {
+  struct ir_instruction *iter;
+  struct alias_value *values, *value;
+  int *definitions;
+  int max_temporary = 0, changed = 1, rounds = 0, i;
+
+  for (iter = begin; iter != end->next; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY && iter->operands[i].data.temporary > max_temporary) {
+        max_temporary = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  values = calloc(max_temporary + 1, sizeof(struct alias_value));
+  definitions = calloc(max_temporary + 1, sizeof(int));
+  assert(NULL != values && NULL != definitions);
+  alias_escaped_len = 0;
+  alias_frame_escapes = 0;
+
+  for (iter = begin; iter != end->next; iter = iter->next) {
+    if (alias_defines(iter)) {
+      definitions[iter->operands[0].data.temporary]++;
+    }
+  }
+
+  // A temporary written once holds one value; the order of the code doesn't matter
+  while (changed && rounds++ < ALIAS_MAX_ROUNDS) {
+    changed = 0;
+    for (iter = begin; iter != end->next; iter = iter->next) {
+      struct alias_value result;
+      if (!alias_defines(iter) || definitions[iter->operands[0].data.temporary] != 1) {
+        continue;
+      }
+      result = alias_derive(iter, values, slots, count);
+      if (memcmp(&result, &values[iter->operands[0].data.temporary], sizeof(result))) {
+        values[iter->operands[0].data.temporary] = result;
+        changed = 1;
+      }
+    }
+  }
+
+  // Any other use of an address lets it escape
+  for (iter = begin; iter != end->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = alias_defines(iter) ? 1 : 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      value = &values[iter->operands[i].data.temporary];
+      if (value->kind == ALIAS_NONE) {
+        continue;
+      }
+      if (alias_width(iter->kind) && i == 1) {
+        continue;
+      }
+      if (alias_is_derivation(iter->kind) && definitions[iter->operands[0].data.temporary] == 1 &&
+          values[iter->operands[0].data.temporary].kind != ALIAS_NONE) {
+        continue;
+      }
+      alias_escape(value);
+    }
+  }
+
+  for (iter = begin; iter != end->next; iter = iter->next) {
+    struct alias_location *location = &iter->alias;
+    struct ir_operand *address = &iter->operands[1];
+
+    if (!alias_width(iter->kind)) {
+      continue;
+    }
+    memset(location, 0, sizeof(struct alias_location));
+    if (changed) {
+      // Leave it untagged: later passes then assume it may touch anything
+      continue;
+    }
+    location->width = alias_width(iter->kind);
+    location->escapes = 1;
+    if (address->kind == OPERAND_LVALUE) {
+      alias_set_frame(location, address->data.offset, location->width,
+                      alias_range_escapes(address->data.offset, address->data.offset + location->width));
+      continue;
+    }
+    if (address->kind != OPERAND_TEMPORARY || values[address->data.temporary].kind == ALIAS_NONE) {
+      location->kind = ALIAS_UNKNOWN;
+      continue;
+    }
+
+    value = &values[address->data.temporary];
+    location->kind = value->kind;
+    location->label = value->label;
+    location->exact = value->exact;
+    location->offset = value->exact ? value->offset : value->object;
+    location->size = value->exact ? 0 : value->size;
+    if (value->kind == ALIAS_FRAME) {
+      if (value->exact) {
+        location->escapes = alias_range_escapes(value->offset, value->offset + location->width);
+      } else {
+        location->escapes = value->size == 0 || alias_range_escapes(value->object, value->object + value->size);
+      }
+    }
+  }
+
+  free(values);
+  free(definitions);
+}
+
+/* alias_set_frame - makes a location an exact one in the frame
+ *
+ * Parameters:
+ *   location - alias_location - the location to set
+ *   offset - int - the offset from $fp accessed
+ *   width - int - bytes accessed
+ *   escapes - int - "true" if a pointer to them may exist
+ */
+void alias_set_frame(struct alias_location *location, int offset, int width, int escapes) {
+  memset(location, 0, sizeof(struct alias_location));
+  location->kind = ALIAS_FRAME;
+  location->exact = 1;
+  location->offset = offset;
+  location->width = width;
+  location->escapes = escapes;
+}
+
+/* alias_bounds - the bytes a location may cover, from its object or label
+ *
+ * Returns "false" if they are not known
+ */
+static int alias_bounds(struct alias_location *location, int *from, int *to) {
+  if (location->exact) {
+    *from = location->offset;
+    *to = location->offset + location->width;
+    return 1;
+  }
+  if (location->size == 0) {
+    return 0;
+  }
+  *from = location->offset;
+  *to = location->offset + location->size;
+  return 1;
+}
+
+/* alias_may_overlap - whether two accesses may touch the same byte
+ *
+ * Parameters:
+ *   a, b - alias_location - the accesses
+ */
+int alias_may_overlap(struct alias_location *a, struct alias_location *b) {
+  struct alias_location *other;
+  int a_from, a_to, b_from, b_to;
+
+  if (a->kind == ALIAS_NONE || b->kind == ALIAS_NONE) {
+    return 1;
+  }
+  if (a->kind == ALIAS_UNKNOWN || b->kind == ALIAS_UNKNOWN) {
+    other = (a->kind == ALIAS_UNKNOWN) ? b : a;
+    if (other->kind == ALIAS_FRAME && !other->escapes) {
+      return 0;
+    }
+    // An object may only be accessed through its own type, or as chars
+    return a->width == b->width || a->width == 1 || b->width == 1;
+  }
+  if (a->kind != b->kind) {
+    return 0;
+  }
+  if (a->kind == ALIAS_GLOBAL && strcmp(a->label, b->label)) {
+    return 0;
+  }
+  if (!alias_bounds(a, &a_from, &a_to) || !alias_bounds(b, &b_from, &b_to)) {
+    return 1;
+  }
+  return a_from < b_to && b_from < a_to;
+}
+
+/* alias_survives_call - whether a call leaves a location alone: only one that
+ *   no pointer can reach does
+ */
+int alias_survives_call(struct alias_location *location) {
+  return location->kind == ALIAS_FRAME && !location->escapes;
+}
@@ -0,0 +1,35 @@
+#ifndef _ALIAS_H
+#define _ALIAS_H
+
+struct ir_instruction;
+struct frame_slot;
+
+/* What a load or store may touch */
+#define ALIAS_NONE     0  /* not worked out: anything */
+#define ALIAS_UNKNOWN  1  /* through a pointer of unknown origin */
+#define ALIAS_FRAME    2  /* the function's own frame */
+#define ALIAS_GLOBAL   3  /* a file-scope object */
+
+struct alias_location {
+  int kind;
+  /* "true" if offset is the address accessed; otherwise it is where the
+   * object accessed starts, and size is its size (0 if it is not known) */
+  int exact;
+  /* ALIAS_GLOBAL: the object's label */
+  char *label;
+  /* ALIAS_FRAME: from $fp; ALIAS_GLOBAL: from the label */
+  int offset;
+  int size;
+  /* Bytes accessed: 1, 2 or 4 */
+  int width;
+  /* "true" if a pointer to the bytes accessed may exist */
+  int escapes;
+};
+
+void alias_analyze_function(struct ir_instruction *begin, struct ir_instruction *end,
+                            struct frame_slot *slots, int count);
+void alias_set_frame(struct alias_location *location, int offset, int width, int escapes);
+int alias_may_overlap(struct alias_location *a, struct alias_location *b);
+int alias_survives_call(struct alias_location *location);
+
+#endif
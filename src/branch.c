@@ -0,0 +1,409 @@
+/*
+ * branch.c
+ *
+ * Conditional branch lowering on the IR.  Expressions compute a condition
+ * into a temporary that IR_GOTO_IF_FALSE or IR_GOTO_IF_TRUE then tests, so
+ * `while (c > 0)` becomes a greater-than into a register, a beqz, and on the
+ * way back round the loop an unconditional jump to the test.  This pass
+ *
+ *   - fuses a comparison with the branch that consumes it into one of the
+ *     IR_GOTO_IF_<relation> instructions, which the back end turns into
+ *     beq/bne, a branch against zero, or an slt and a branch;
+ *   - turns a conditional branch over an unconditional jump into the
+ *     opposite branch, so the code that falls through is the code that
+ *     follows; and
+ *   - rotates loops whose test is a short, side-effect free computation: the
+ *     jump back to the test becomes a copy of the test that branches back to
+ *     the top of the body when the loop goes round again, so each iteration
+ *     runs one branch instead of a branch and a jump.  Loops a profile shows
+ *     never went round are left alone.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "ir.h"
+#include "cfg.h"
+#include "branch.h"
+
+int branch_fuse_enabled = 1;
+int branch_rotate_enabled = 1;
+
+/* branch_relation - the fused branch that jumps when a comparison holds
+ *
+ * Parameters:
+ *   kind - int - an IR comparison
+ *
+ * Returns the IR_GOTO_IF_<relation> kind, or 0 if kind is not a comparison
+ */
+static int branch_relation(int kind) {
+  switch (kind) {
+    case IR_EQUAL:         return IR_GOTO_IF_EQUAL;
+    case IR_NOT_EQUAL:     return IR_GOTO_IF_NOT_EQUAL;
+    case IR_LESS:          return IR_GOTO_IF_LESS;
+    case IR_LESS_EQUAL:    return IR_GOTO_IF_LESS_EQUAL;
+    case IR_GREATER:       return IR_GOTO_IF_GREATER;
+    case IR_GREATER_EQUAL: return IR_GOTO_IF_GREATER_EQUAL;
+    default:               return 0;
+  }
+}
+
+/* branch_inverse - the branch that jumps exactly when another one falls through
+ *
+ * Parameters:
+ *   kind - int - a conditional branch kind
+ *
+ * Returns the opposite kind, or 0 if kind is not a conditional branch
+ */
+int branch_inverse(int kind) {
+  switch (kind) {
+    case IR_GOTO_IF_FALSE:         return IR_GOTO_IF_TRUE;
+    case IR_GOTO_IF_TRUE:          return IR_GOTO_IF_FALSE;
+    case IR_GOTO_IF_EQUAL:         return IR_GOTO_IF_NOT_EQUAL;
+    case IR_GOTO_IF_NOT_EQUAL:     return IR_GOTO_IF_EQUAL;
+    case IR_GOTO_IF_LESS:          return IR_GOTO_IF_GREATER_EQUAL;
+    case IR_GOTO_IF_GREATER_EQUAL: return IR_GOTO_IF_LESS;
+    case IR_GOTO_IF_GREATER:       return IR_GOTO_IF_LESS_EQUAL;
+    case IR_GOTO_IF_LESS_EQUAL:    return IR_GOTO_IF_GREATER;
+    default:                       return 0;
+  }
+}
+
+/* branch_is_fusable_operand - whether a comparison operand can be an operand
+ *   of a fused branch: a temporary, or the constant 0 (which is $zero)
+ */
+static int branch_is_fusable_operand(struct ir_operand *operand) {
+  return operand->kind == OPERAND_TEMPORARY || (operand->kind == OPERAND_NUMBER && operand->data.number == 0);
+}
+
+/* branch_count_uses - counts how many times each temporary is read
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Returns the counts, indexed by temporary
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static int *branch_count_uses(struct ir_section *section) {
+  struct ir_instruction *iter;
+  int *uses, max = 0, i;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY && iter->operands[i].data.temporary > max) {
+        max = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  uses = calloc(max + 1, sizeof(int));
+  assert(NULL != uses);
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    // The result of a comparison is its first operand; everything else is a use
+    for (i = branch_relation(iter->kind) ? 1 : 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY) {
+        uses[iter->operands[i].data.temporary]++;
+      }
+    }
+  }
+  return uses;
+}
+
+/* branch_fuse - merges each comparison that only feeds the branch right after
+ *   it into that branch
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ */
+static void branch_fuse(struct ir_section *section) {
+  struct ir_instruction *iter, *compare;
+  int *uses = branch_count_uses(section);
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    int kind;
+
+    if (iter->kind != IR_GOTO_IF_FALSE && iter->kind != IR_GOTO_IF_TRUE) {
+      continue;
+    }
+    compare = iter->prev;
+    if (NULL == compare || !branch_relation(compare->kind) ||
+        compare->operands[0].kind != OPERAND_TEMPORARY ||
+        iter->operands[0].kind != OPERAND_TEMPORARY ||
+        compare->operands[0].data.temporary != iter->operands[0].data.temporary ||
+        uses[iter->operands[0].data.temporary] != 1 ||
+        !branch_is_fusable_operand(&compare->operands[1]) ||
+        !branch_is_fusable_operand(&compare->operands[2])) {
+      continue;
+    }
+
+    kind = branch_relation(compare->kind);
+    if (iter->kind == IR_GOTO_IF_FALSE) {
+      kind = branch_inverse(kind);
+    }
+    iter->operands[2] = iter->operands[1];
+    iter->operands[0] = compare->operands[1];
+    iter->operands[1] = compare->operands[2];
+    iter->kind = kind;
+    ir_remove(section, compare);
+  }
+  free(uses);
+}
+
+/* branch_next_real - the first instruction from a position on that generates code */
+static struct ir_instruction *branch_next_real(struct ir_instruction *iter) {
+  while (NULL != iter && (iter->kind == IR_SEQUENCE_PT || iter->kind == IR_NO_OPERATION)) {
+    iter = iter->next;
+  }
+  return iter;
+}
+
+/* branch_invert_over_jumps - rewrites
+ *
+ *       if (condition) goto L1
+ *       goto L2
+ *     L1:
+ *
+ *   as "if (!condition) goto L2", falling through to L1
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ */
+static void branch_invert_over_jumps(struct ir_section *section) {
+  struct ir_instruction *iter, *jump, *label;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (!branch_inverse(iter->kind)) {
+      continue;
+    }
+    jump = branch_next_real(iter->next);
+    if (NULL == jump || jump->kind != IR_GOTO) {
+      continue;
+    }
+    label = branch_next_real(jump->next);
+    if (NULL == label || label->kind != IR_LABEL ||
+        strcmp(label->operands[0].data.label_name, cfg_branch_label(iter)->data.label_name)) {
+      continue;
+    }
+    iter->kind = branch_inverse(iter->kind);
+    *cfg_branch_label(iter) = jump->operands[0];
+    ir_remove(section, jump);
+  }
+}
+
+/* branch_is_pure - whether an instruction may be part of a loop test that is
+ *   copied: it only computes a temporary from temporaries, constants and memory
+ */
+static int branch_is_pure(int kind) {
+  switch (kind) {
+    case IR_MULTIPLY: case IR_DIVIDE: case IR_MOD: case IR_MULU: case IR_DIVU:
+    case IR_MULTIPLY_HIGH: case IR_MULTIPLY_HIGH_U:
+    case IR_ADD: case IR_SUBTRACT: case IR_ADDU: case IR_SUBU: case IR_ADDI:
+    case IR_SHIFT_LEFT: case IR_SHIFT_RIGHT: case IR_SHIFT_RIGHT_U:
+    case IR_XOR: case IR_BIT_AND: case IR_BIT_OR:
+    case IR_LESS: case IR_LESS_EQUAL: case IR_GREATER: case IR_GREATER_EQUAL:
+    case IR_EQUAL: case IR_NOT_EQUAL:
+    case IR_LOG_NOT: case IR_BIT_NOT: case IR_MAKE_NEGATIVE:
+    case IR_LOAD_WORD: case IR_LOAD_HALF_WORD: case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_BYTE: case IR_LOAD_BYTE_U:
+    case IR_ADDRESS_OF: case IR_LOAD_IMMEDIATE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* branch_test_is_local - whether no code after a loop test reads the
+ *   temporaries it defines, which a copy of the test would give other numbers
+ */
+static int branch_test_is_local(struct ir_instruction *test, int *renamed, int num_renamed) {
+  struct ir_instruction *iter;
+  int i, j;
+
+  for (iter = test->next; NULL != iter && iter->kind != IR_PROC_END; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      for (j = 0; j < num_renamed; j++) {
+        if (renamed[j] == iter->operands[i].data.temporary) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/* branch_loop_test - finds the test at the top of a loop
+ *
+ * Parameters:
+ *   top - ir_instruction - the label the loop jumps back to
+ *   renamed - int * - filled with the temporaries the test defines, in order
+ *   num_renamed - int * - set to how many there are
+ *
+ * Returns the conditional branch that ends the test, or NULL if the code at
+ *   the label is not a short test that only uses temporaries it defines, and
+ *   whose temporaries are not used after it
+ */
+static struct ir_instruction *branch_loop_test(struct ir_instruction *top, int *renamed, int *num_renamed) {
+  struct ir_instruction *iter;
+  int count = 0, i, j;
+
+  *num_renamed = 0;
+  for (iter = top->next; NULL != iter && count <= BRANCH_ROTATE_LIMIT; iter = iter->next) {
+    int first = 0;
+
+    if (iter->kind == IR_SEQUENCE_PT || iter->kind == IR_NO_OPERATION) {
+      continue;
+    }
+    count++;
+    if (branch_is_pure(iter->kind)) {
+      first = 1;
+    } else if (!branch_inverse(iter->kind)) {
+      return NULL;
+    }
+
+    // Every temporary read has to come from the test itself
+    for (i = first; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      for (j = 0; j < *num_renamed && renamed[j] != iter->operands[i].data.temporary; j++)
+        ;
+      if (j == *num_renamed) {
+        return NULL;
+      }
+    }
+
+    if (!first) {
+      return branch_test_is_local(iter, renamed, *num_renamed) ? iter : NULL;
+    }
+    if (iter->operands[0].kind != OPERAND_TEMPORARY) {
+      return NULL;
+    }
+    renamed[(*num_renamed)++] = iter->operands[0].data.temporary;
+  }
+  return NULL;
+}
+
+/* branch_rotate - copies the test of a loop in place of one jump back to it
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   jump - ir_instruction - the IR_GOTO back to the top of the loop
+ *   top - ir_instruction - the label at the top of the loop
+ *   test - ir_instruction - the branch that ends the test
+ *   renamed - int * - the temporaries the test defines
+ *   num_renamed - int - how many there are
+ */
+static void branch_rotate(struct ir_section *section, struct ir_instruction *jump, struct ir_instruction *top,
+                          struct ir_instruction *test, int *renamed, int num_renamed) {
+  struct ir_instruction *iter, *body, *enter, *restore, *copy;
+  int base = ir_reserve_temporaries(num_renamed + 1), i, j;
+
+  // The copy gets registers of its own, starting over at the first one...
+  enter = ir_instruction(IR_SEQUENCE_PT);
+  enter->operands[0].kind = OPERAND_TEMPORARY;
+  enter->operands[0].data.temporary = base;
+  ir_insert_before(section, jump, enter);
+
+  for (iter = top->next; iter != test->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT || iter->kind == IR_NO_OPERATION) {
+      continue;
+    }
+    copy = ir_instruction(iter->kind);
+    memcpy(copy->operands, iter->operands, sizeof(copy->operands));
+    copy->alias = iter->alias;
+    for (i = 0; i < 3; i++) {
+      if (copy->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      for (j = 0; renamed[j] != copy->operands[i].data.temporary; j++)
+        ;
+      copy->operands[i].data.temporary = base + 1 + j;
+    }
+    ir_insert_before(section, jump, copy);
+  }
+
+  // ...that branches back into the body when the loop goes round again
+  body = ir_instruction(IR_LABEL);
+  ir_operand_label(body, 0);
+  ir_insert_after(section, test, body);
+  copy->kind = branch_inverse(test->kind);
+  *cfg_branch_label(copy) = body->operands[0];
+
+  // ...and then code after it has the registers it had before
+  restore = ir_instruction(IR_SEQUENCE_PT);
+  restore->operands[0].kind = OPERAND_TEMPORARY;
+  restore->operands[0].data.temporary = -1;
+  for (iter = enter->prev; NULL != iter && iter->kind != IR_PROC_BEGIN; iter = iter->prev) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      restore->operands[0] = iter->operands[0];
+      break;
+    }
+  }
+  ir_insert_before(section, jump, restore);
+
+  // Leaving the loop now means falling out of the copy
+  jump->operands[0] = *cfg_branch_label(test);
+}
+
+/* branch_rotate_loops - rotates each loop whose test can be copied to the
+ *   jump back to it
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ */
+static void branch_rotate_loops(struct ir_section *section) {
+  struct ir_instruction *iter, *label, *test;
+  int renamed[BRANCH_ROTATE_LIMIT + 1], num_renamed;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind != IR_GOTO) {
+      continue;
+    }
+    // Only jumps backwards, within the same function
+    for (label = iter->prev; NULL != label && label->kind != IR_PROC_BEGIN; label = label->prev) {
+      if (label->kind == IR_LABEL && !strcmp(label->operands[0].data.label_name, iter->operands[0].data.label_name)) {
+        break;
+      }
+    }
+    if (NULL == label || label->kind != IR_LABEL) {
+      continue;
+    }
+    // A loop the profile shows never went round gains nothing but code
+    if (0 == iter->profile_count) {
+      continue;
+    }
+    test = branch_loop_test(label, renamed, &num_renamed);
+    if (NULL != test) {
+      branch_rotate(section, iter, label, test, renamed, num_renamed);
+    }
+  }
+}
+
+/* branch_optimize - lowers the conditional branches of a program
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void branch_optimize(struct ir_section *section) {
+  if (branch_fuse_enabled) {
+    branch_fuse(section);
+  }
+  if (branch_rotate_enabled) {
+    branch_rotate_loops(section);
+  }
+  branch_invert_over_jumps(section);
+}
@@ -0,0 +1,15 @@
+#ifndef _BRANCH_H
+#define _BRANCH_H
+
+struct ir_section;
+
+/* Longest loop test, in IR instructions, that is copied to the bottom of the loop */
+#define BRANCH_ROTATE_LIMIT 12
+
+void branch_optimize(struct ir_section *section);
+int branch_inverse(int kind);
+
+extern int branch_fuse_enabled;
+extern int branch_rotate_enabled;
+
+#endif
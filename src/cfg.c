@@ -0,0 +1,298 @@
+/*
+ * cfg.c
+ *
+ * Control flow graphs over the IR.  Each function is split into basic blocks
+ * at labels and after jumps, and blocks are linked to the blocks control can
+ * reach next.  The graph points into the IR rather than copying it, so it goes
+ * stale as soon as a pass adds or removes jumps or labels.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "ir.h"
+#include "cfg.h"
+
+/* cfg_branch_label - the label a jump or conditional branch goes to
+ *
+ * Parameters:
+ *   instruction - ir_instruction - the instruction to check
+ *
+ * Returns the label operand, or NULL if the instruction is not a jump
+ */
+struct ir_operand *cfg_branch_label(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_GOTO:
+      return &instruction->operands[0];
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      return &instruction->operands[1];
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+      return &instruction->operands[2];
+    default:
+      return NULL;
+  }
+}
+
+/* cfg_ends_block - whether control can leave the block after an instruction
+ *
+ * Parameters:
+ *   instruction - ir_instruction - the instruction to check
+ */
+static int cfg_ends_block(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_PROC_END:
+    case IR_TAIL_CALL:
+    case IR_GOTO_TABLE:
+      return 1;
+    default:
+      return NULL != cfg_branch_label(instruction);
+  }
+}
+
+/* cfg_add_edge - links two blocks
+ *
+ * Parameters:
+ *   from - cfg_block - block control leaves
+ *   to - cfg_block - block control enters
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void cfg_add_edge(struct cfg_block *from, struct cfg_block *to) {
+  struct cfg_edge *edge;
+
+  for (edge = from->successors; NULL != edge; edge = edge->next) {
+    if (edge->block == to) {
+      return;
+    }
+  }
+
+  edge = malloc(sizeof(struct cfg_edge));
+  assert(NULL != edge);
+  edge->block = to;
+  edge->next = from->successors;
+  from->successors = edge;
+
+  edge = malloc(sizeof(struct cfg_edge));
+  assert(NULL != edge);
+  edge->block = from;
+  edge->next = to->predecessors;
+  to->predecessors = edge;
+}
+
+/* cfg_block - makes an empty block and adds it to the end of a graph
+ *
+ * Parameters:
+ *   graph - cfg - the graph to add to
+ *   last - cfg_block - the current last block, or NULL
+ *   first - ir_instruction - first instruction of the block
+ *
+ * Returns the new block
+ */
+static struct cfg_block *cfg_block(struct cfg *graph, struct cfg_block *last, struct ir_instruction *first) {
+  struct cfg_block *block = malloc(sizeof(struct cfg_block));
+  assert(NULL != block);
+  block->id = graph->num_blocks++;
+  block->first = first;
+  block->last = first;
+  block->successors = NULL;
+  block->predecessors = NULL;
+  block->next = NULL;
+  if (NULL == last) {
+    graph->entry = block;
+  } else {
+    last->next = block;
+  }
+  return block;
+}
+
+/* cfg_find_label - finds the block a label starts
+ *
+ * Parameters:
+ *   graph - cfg - the function's graph
+ *   label_name - char * - name of the label
+ *
+ * Returns the block, or NULL if the label is not in this function
+ */
+struct cfg_block *cfg_find_label(struct cfg *graph, char *label_name) {
+  struct cfg_block *block;
+  for (block = graph->entry; NULL != block; block = block->next) {
+    if (block->first->kind == IR_LABEL && !strcmp(block->first->operands[0].data.label_name, label_name)) {
+      return block;
+    }
+  }
+  return NULL;
+}
+
+/* cfg_block_of - finds the block holding an instruction
+ *
+ * Parameters:
+ *   graph - cfg - the function's graph
+ *   instruction - ir_instruction - the instruction to look for
+ *
+ * Returns the block, or NULL if the instruction is not in this function
+ */
+struct cfg_block *cfg_block_of(struct cfg *graph, struct ir_instruction *instruction) {
+  struct cfg_block *block;
+  struct ir_instruction *iter;
+  for (block = graph->entry; NULL != block; block = block->next) {
+    for (iter = block->first; NULL != iter; iter = iter->next) {
+      if (iter == instruction) {
+        return block;
+      }
+      if (iter == block->last) {
+        break;
+      }
+    }
+  }
+  return NULL;
+}
+
+/* cfg_build_function - splits one function into basic blocks and links them
+ *
+ * Parameters:
+ *   begin - ir_instruction - the function's IR_PROC_BEGIN
+ *
+ * Returns the graph
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+struct cfg *cfg_build_function(struct ir_instruction *begin) {
+  struct cfg *graph;
+  struct cfg_block *block = NULL, *iter_block;
+  struct ir_instruction *iter;
+  int starts_block = 1;
+
+  assert(begin->kind == IR_PROC_BEGIN);
+  graph = malloc(sizeof(struct cfg));
+  assert(NULL != graph);
+  graph->name = begin->operands[0].data.label_name;
+  graph->begin = begin;
+  graph->end = begin;
+  graph->entry = NULL;
+  graph->num_blocks = 0;
+  graph->next = NULL;
+
+  for (iter = begin; NULL != iter; iter = iter->next) {
+    if (iter != begin && iter->kind == IR_PROC_BEGIN) {
+      break;
+    }
+    if (starts_block || iter->kind == IR_LABEL) {
+      block = cfg_block(graph, block, iter);
+    }
+    block->last = iter;
+    graph->end = iter;
+    starts_block = cfg_ends_block(iter);
+  }
+
+  for (iter_block = graph->entry; NULL != iter_block; iter_block = iter_block->next) {
+    struct ir_instruction *last = iter_block->last;
+    struct cfg_block *target;
+    struct ir_jump_table *table;
+    int i;
+
+    switch (last->kind) {
+      case IR_PROC_END:
+      case IR_TAIL_CALL:
+        break;
+
+      case IR_GOTO_TABLE:
+        table = ir_find_jump_table(last->operands[1].data.label_name);
+        assert(NULL != table);
+        for (i = 0; i < table->count; i++) {
+          target = cfg_find_label(graph, table->targets[i]);
+          if (NULL != target) {
+            cfg_add_edge(iter_block, target);
+          }
+        }
+        break;
+
+      default:
+        if (NULL != cfg_branch_label(last)) {
+          target = cfg_find_label(graph, cfg_branch_label(last)->data.label_name);
+          if (NULL != target) {
+            cfg_add_edge(iter_block, target);
+          }
+        }
+        if (last->kind != IR_GOTO && NULL != iter_block->next) {
+          cfg_add_edge(iter_block, iter_block->next);
+        }
+        break;
+    }
+  }
+  return graph;
+}
+
+/* cfg_build_program - builds a graph for every function in the program
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Returns the graphs, linked in program order
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+struct cfg *cfg_build_program(struct ir_section *section) {
+  struct cfg *graphs = NULL, *last = NULL, *graph;
+  struct ir_instruction *iter;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind != IR_PROC_BEGIN) {
+      continue;
+    }
+    graph = cfg_build_function(iter);
+    if (NULL == last) {
+      graphs = graph;
+    } else {
+      last->next = graph;
+    }
+    last = graph;
+    iter = graph->end;
+  }
+  return graphs;
+}
+
+/* cfg_free_edges - frees a list of edges
+ *
+ * Parameters:
+ *   edge - cfg_edge - first edge of the list
+ */
+static void cfg_free_edges(struct cfg_edge *edge) {
+  while (NULL != edge) {
+    struct cfg_edge *next = edge->next;
+    free(edge);
+    edge = next;
+  }
+}
+
+/* cfg_free - frees a list of graphs, leaving the IR they describe alone
+ *
+ * Parameters:
+ *   graph - cfg - first graph of the list
+ */
+void cfg_free(struct cfg *graph) {
+  while (NULL != graph) {
+    struct cfg *next_graph = graph->next;
+    struct cfg_block *block = graph->entry;
+    while (NULL != block) {
+      struct cfg_block *next_block = block->next;
+      cfg_free_edges(block->successors);
+      cfg_free_edges(block->predecessors);
+      free(block);
+      block = next_block;
+    }
+    free(graph);
+    graph = next_graph;
+  }
+}
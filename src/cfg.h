@@ -0,0 +1,43 @@
+#ifndef _CFG_H
+#define _CFG_H
+
+struct ir_instruction;
+struct ir_operand;
+struct ir_section;
+
+struct cfg_edge {
+  struct cfg_block *block;
+  struct cfg_edge *next;
+};
+
+/*
+ * A basic block is a run of instructions from first to last, inclusive, that
+ * is only entered at first and only left after last.
+ */
+struct cfg_block {
+  int id;
+  struct ir_instruction *first, *last;
+  struct cfg_edge *successors, *predecessors;
+  struct cfg_block *next;
+};
+
+/*
+ * The control flow graph of one function, from its IR_PROC_BEGIN to the
+ * instruction before the next function's.  Blocks are kept in program order.
+ */
+struct cfg {
+  char *name;
+  struct ir_instruction *begin, *end;
+  struct cfg_block *entry;
+  int num_blocks;
+  struct cfg *next;
+};
+
+struct ir_operand *cfg_branch_label(struct ir_instruction *instruction);
+struct cfg *cfg_build_program(struct ir_section *section);
+struct cfg *cfg_build_function(struct ir_instruction *begin);
+struct cfg_block *cfg_block_of(struct cfg *graph, struct ir_instruction *instruction);
+struct cfg_block *cfg_find_label(struct cfg *graph, char *label_name);
+void cfg_free(struct cfg *graph);
+
+#endif
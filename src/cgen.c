@@ -0,0 +1,915 @@
+/*
+ * cgen.c
+ *
+ * The C back end, for -s c: prints the IR as a C program, which any C
+ * compiler for the host can then make into a native program.  Every IR
+ * instruction becomes a statement of its own, with the optimizing left to
+ * that compiler.  A function becomes a C function of as many words as it takes
+ * arguments.  Its temporaries become locals and its labels become labels to
+ * goto, and a jump table becomes a switch of gotos.
+ *
+ * The IR's pointers are 32-bit addresses, so memory is one array of bytes
+ * that they index, laid out at generation time: a few bytes no object starts
+ * at, so that no address of one is 0, then the string literals as
+ * literal_layout lays them out, then the file-scope objects, then the stack
+ * the frames are taken from.  IR_PROC_BEGIN takes its frame off the stack and
+ * puts the arguments in the first four words of it, as mips.c does.  A word is
+ * read and written a byte at a time, little-endian as on the simulator, which
+ * the host compiler turns into one load or store where it can.
+ *
+ * add, sub and neg stop the program on a signed overflow, as MIPS does, and
+ * the rest of the arithmetic is on uint32_t wherever C would leave an
+ * overflow undefined.  Division does what the MIPS division does with the
+ * most negative number over -1, and stops the program for a division by
+ * zero.  IR_PARAMETER sets a0-a3 and IR_RETURN v0, as on MIPS, and a call
+ * passes a0-a3 and puts what it returns in v0.  A function the program does
+ * not define is declared as taking and returning words, which suits the C
+ * library's abs and the like; one taking a pointer would be handed an index
+ * into the array.
+ *
+ * A tail call gives up the frame before it calls.  Self tail calls never get
+ * here, since the tail call pass has already made them jumps back to the top
+ * of the function, so self recursion runs in constant stack whatever the host
+ * compiler does.  Any other tail call is a C call returned at once: the frames
+ * the IR lays out are still reused, but the host stack only stays flat through
+ * mutual recursion if the host compiler turns that call into a jump, as gcc
+ * and clang do from -O2.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "ir.h"
+#include "literal.h"
+#include "cgen.h"
+
+int cgen_num_errors;
+
+/* The most arguments a call passes, all in registers */
+#define CGEN_MAX_ARGUMENTS 4
+
+/* Where the first object goes, and how big the stack is */
+#define CGEN_DATA_BASE  16
+#define CGEN_STACK_SIZE (16 << 20)
+
+struct cgen_function {
+  char *name;
+  struct ir_instruction *begin;
+  struct ir_instruction *end;
+  int frame_size;
+  int num_params;
+  int first_temporary;
+  int num_temporaries;
+  /* Whether anything writes each temporary, and whether anything reads it */
+  unsigned char *written;
+  unsigned char *read;
+  /* One more than the highest argument register an IR_PARAMETER sets */
+  int num_arguments;
+  struct cgen_function *next;
+};
+
+/* A function the program calls but does not define */
+struct cgen_external {
+  char *name;
+  int num_arguments;
+};
+
+static struct cgen_function *cgen_functions;
+static struct cgen_external *cgen_externals;
+static int cgen_externals_len;
+/* Set once something calls a read_int the program does not define */
+static int cgen_read_int_called;
+
+/* The memory: the string literals, laid out by literal_layout, then the
+ * file-scope objects at the addresses here, then the stack */
+static struct ir_section *cgen_section;
+static char *cgen_strings;
+static int cgen_strings_size;
+static uint32_t *cgen_global_addresses;
+static uint32_t cgen_stack_base;
+static uint32_t cgen_memory_size;
+
+/* The C for each operation with a result and two operands */
+static struct {
+  int kind;
+  char *format;
+} cgen_binary_formats[] = {
+  {IR_ADD,             "rt_add(%s, %s)"},
+  {IR_ADDI,            "rt_add(%s, %s)"},
+  {IR_ADDU,            "(int32_t)((uint32_t)%s + (uint32_t)%s)"},
+  {IR_SUBTRACT,        "rt_sub(%s, %s)"},
+  {IR_SUBU,            "(int32_t)((uint32_t)%s - (uint32_t)%s)"},
+  {IR_MULTIPLY,        "(int32_t)((uint32_t)%s * (uint32_t)%s)"},
+  {IR_MULU,            "(int32_t)((uint32_t)%s * (uint32_t)%s)"},
+  {IR_MULTIPLY_HIGH,   "(int32_t)(((int64_t)%s * %s) >> 32)"},
+  {IR_MULTIPLY_HIGH_U, "(int32_t)(((uint64_t)(uint32_t)%s * (uint32_t)%s) >> 32)"},
+  {IR_DIVIDE,          "rt_div(%s, %s)"},
+  {IR_MOD,             "rt_mod(%s, %s)"},
+  {IR_DIVU,            "rt_divu(%s, %s)"},
+  {IR_SHIFT_LEFT,      "(int32_t)((uint32_t)%s << (%s & 31))"},
+  {IR_SHIFT_RIGHT,     "%s >> (%s & 31)"},
+  {IR_SHIFT_RIGHT_U,   "(int32_t)((uint32_t)%s >> (%s & 31))"},
+  {IR_XOR,             "%s ^ %s"},
+  {IR_BIT_AND,         "%s & %s"},
+  {IR_BIT_OR,          "%s | %s"},
+  {IR_LESS,            "%s < %s"},
+  {IR_LESS_EQUAL,      "%s <= %s"},
+  {IR_GREATER,         "%s > %s"},
+  {IR_GREATER_EQUAL,   "%s >= %s"},
+  {IR_EQUAL,           "%s == %s"},
+  {IR_NOT_EQUAL,       "%s != %s"},
+  {0,                  NULL}
+};
+
+/* The C for each operation with a result and one operand */
+static struct {
+  int kind;
+  char *format;
+} cgen_unary_formats[] = {
+  {IR_COPY,              "%s"},
+  {IR_MAKE_POSITIVE,     "%s"},
+  {IR_BYTE_TO_HALF_WORD, "%s"},
+  {IR_BYTE_TO_WORD,      "%s"},
+  {IR_HALF_WORD_TO_WORD, "%s"},
+  {IR_WORD_TO_BYTE,      "(int8_t)%s"},
+  {IR_HALF_WORD_TO_BYTE, "(int8_t)%s"},
+  {IR_WORD_TO_HALF_WORD, "(int16_t)%s"},
+  {IR_LOG_NOT,           "0 == %s"},
+  {IR_BIT_NOT,           "~%s"},
+  {IR_MAKE_NEGATIVE,     "rt_sub(0, %s)"},
+  {IR_LOAD_BYTE,         "rt_lb(%s)"},
+  {IR_LOAD_BYTE_U,       "rt_lbu(%s)"},
+  {IR_LOAD_HALF_WORD,    "rt_lh(%s)"},
+  {IR_LOAD_HALF_WORD_U,  "rt_lhu(%s)"},
+  {IR_LOAD_WORD,         "rt_lw(%s)"},
+  {0,                    NULL}
+};
+
+/* The runtime every program gets: memory and what reads and writes it,
+ * division, and the built-ins */
+static char *cgen_runtime[] = {
+  "static unsigned char rt_memory[RT_MEMORY_SIZE];",
+  "static uint32_t rt_sp = RT_MEMORY_SIZE;",
+  "",
+  "static void rt_trap(const char *message) {",
+  "  fflush(stdout);",
+  "  fprintf(stderr, \"\\n%s\\n\", message);",
+  "  exit(1);",
+  "}",
+  "",
+  "static inline int32_t rt_lb(uint32_t address) {",
+  "  return (int8_t)rt_memory[address];",
+  "}",
+  "",
+  "static inline int32_t rt_lbu(uint32_t address) {",
+  "  return rt_memory[address];",
+  "}",
+  "",
+  "static inline int32_t rt_lh(uint32_t address) {",
+  "  return (int16_t)(rt_memory[address] | rt_memory[address + 1] << 8);",
+  "}",
+  "",
+  "static inline int32_t rt_lhu(uint32_t address) {",
+  "  return rt_memory[address] | rt_memory[address + 1] << 8;",
+  "}",
+  "",
+  "static inline int32_t rt_lw(uint32_t address) {",
+  "  return (int32_t)((uint32_t)rt_memory[address] | (uint32_t)rt_memory[address + 1] << 8",
+  "                   | (uint32_t)rt_memory[address + 2] << 16 | (uint32_t)rt_memory[address + 3] << 24);",
+  "}",
+  "",
+  "static inline void rt_sb(uint32_t address, int32_t value) {",
+  "  rt_memory[address] = (unsigned char)value;",
+  "}",
+  "",
+  "static inline void rt_sh(uint32_t address, int32_t value) {",
+  "  rt_memory[address] = (unsigned char)value;",
+  "  rt_memory[address + 1] = (unsigned char)((uint32_t)value >> 8);",
+  "}",
+  "",
+  "static inline void rt_sw(uint32_t address, int32_t value) {",
+  "  rt_memory[address] = (unsigned char)value;",
+  "  rt_memory[address + 1] = (unsigned char)((uint32_t)value >> 8);",
+  "  rt_memory[address + 2] = (unsigned char)((uint32_t)value >> 16);",
+  "  rt_memory[address + 3] = (unsigned char)((uint32_t)value >> 24);",
+  "}",
+  "",
+  "static inline uint32_t rt_enter(uint32_t frame_size) {",
+  "  if (rt_sp - RT_STACK_BASE < frame_size) {",
+  "    rt_trap(\"stack overflow\");",
+  "  }",
+  "  return rt_sp -= frame_size;",
+  "}",
+  "",
+  "static inline int32_t rt_add(int32_t x, int32_t y) {",
+  "  int64_t sum = (int64_t)x + y;",
+  "",
+  "  if (sum != (int32_t)sum) {",
+  "    rt_trap(\"arithmetic overflow\");",
+  "  }",
+  "  return (int32_t)sum;",
+  "}",
+  "",
+  "static inline int32_t rt_sub(int32_t x, int32_t y) {",
+  "  int64_t difference = (int64_t)x - y;",
+  "",
+  "  if (difference != (int32_t)difference) {",
+  "    rt_trap(\"arithmetic overflow\");",
+  "  }",
+  "  return (int32_t)difference;",
+  "}",
+  "",
+  "static inline int32_t rt_div(int32_t x, int32_t y) {",
+  "  if (0 == y) {",
+  "    rt_trap(\"division by zero\");",
+  "  }",
+  "  return (INT32_MIN == x && -1 == y) ? INT32_MIN : x / y;",
+  "}",
+  "",
+  "static inline int32_t rt_mod(int32_t x, int32_t y) {",
+  "  if (0 == y) {",
+  "    rt_trap(\"division by zero\");",
+  "  }",
+  "  return (INT32_MIN == x && -1 == y) ? 0 : x % y;",
+  "}",
+  "",
+  "static inline int32_t rt_divu(int32_t x, int32_t y) {",
+  "  if (0 == y) {",
+  "    rt_trap(\"division by zero\");",
+  "  }",
+  "  return (int32_t)((uint32_t)x / (uint32_t)y);",
+  "}",
+  "",
+  "static inline void rt_print_string(int32_t address) {",
+  "  fputs((char *)rt_memory + (uint32_t)address, stdout);",
+  "}",
+  NULL
+};
+
+static char *cgen_read_int[] = {
+  "",
+  "static inline int32_t rt_read_int(void) {",
+  "  int number;",
+  "",
+  "  if (1 != scanf(\"%d\", &number)) {",
+  "    return 0;",
+  "  }",
+  "  return number;",
+  "}",
+  NULL
+};
+
+/****************************
+ * FUNCTIONS                *
+ ****************************/
+
+/* cgen_writes - whether an instruction writes its first operand */
+static int cgen_writes(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+    case IR_PRINT_NUMBER:
+    case IR_PRINT_STRING:
+    case IR_RETURN:
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+    case IR_GOTO_TABLE:
+    case IR_SEQUENCE_PT:
+      return 0;
+    default:
+      return instruction->operands[0].kind == OPERAND_TEMPORARY;
+  }
+}
+
+/* cgen_measure - works out the range of temporaries a function uses, which
+ *   of them are written and read, and how many arguments its calls pass
+ */
+static void cgen_measure(struct cgen_function *function) {
+  struct ir_instruction *iter;
+  int low = -1, high = -1, i, t;
+
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      if (low < 0 || iter->operands[i].data.temporary < low) {
+        low = iter->operands[i].data.temporary;
+      }
+      if (iter->operands[i].data.temporary > high) {
+        high = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  function->first_temporary = low < 0 ? 0 : low;
+  function->num_temporaries = low < 0 ? 0 : high - low + 1;
+
+  function->written = calloc(function->num_temporaries + 1, 1);
+  function->read = calloc(function->num_temporaries + 1, 1);
+  assert(NULL != function->written && NULL != function->read);
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY) {
+        t = iter->operands[i].data.temporary - function->first_temporary;
+        if (0 == i && cgen_writes(iter)) {
+          function->written[t] = 1;
+        } else {
+          function->read[t] = 1;
+        }
+      }
+    }
+    if (iter->kind == IR_PARAMETER && iter->operands[0].data.number >= function->num_arguments
+        && iter->operands[0].data.number < CGEN_MAX_ARGUMENTS) {
+      function->num_arguments = (int)iter->operands[0].data.number + 1;
+    }
+  }
+}
+
+/* cgen_collect_functions - walks the program and records each function's
+ *   extent, up to where the next one begins
+ */
+static struct cgen_function *cgen_collect_functions(struct ir_section *section) {
+  struct cgen_function *functions = NULL, *last = NULL, *current = NULL;
+  struct ir_instruction *iter;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == IR_PROC_BEGIN) {
+      current = calloc(1, sizeof(struct cgen_function));
+      assert(NULL != current);
+      current->name = iter->operands[0].data.label_name;
+      current->begin = iter;
+      current->end = iter;
+      current->frame_size = (int)iter->operands[1].data.number;
+      current->num_params = (int)iter->operands[2].data.number;
+      if (NULL == last) {
+        functions = current;
+      } else {
+        last->next = current;
+      }
+      last = current;
+    } else if (NULL != current) {
+      // Block layout may move code past the last IR_PROC_END
+      current->end = iter;
+    }
+    if (iter == section->last) {
+      break;
+    }
+  }
+
+  for (current = functions; NULL != current; current = current->next) {
+    cgen_measure(current);
+  }
+  return functions;
+}
+
+static struct cgen_function *cgen_find_function(char *name) {
+  struct cgen_function *function;
+
+  for (function = cgen_functions; NULL != function; function = function->next) {
+    if (!strcmp(function->name, name)) {
+      return function;
+    }
+  }
+  return NULL;
+}
+
+/* cgen_add_external - records a call of a function the program does not
+ *   define, with the arguments the first call of it passes
+ */
+static void cgen_add_external(char *name, int num_arguments) {
+  int i;
+
+  for (i = 0; i < cgen_externals_len; i++) {
+    if (!strcmp(cgen_externals[i].name, name)) {
+      return;
+    }
+  }
+  cgen_externals = realloc(cgen_externals, sizeof(struct cgen_external) * (cgen_externals_len + 1));
+  assert(NULL != cgen_externals);
+  cgen_externals[cgen_externals_len].name = name;
+  cgen_externals[cgen_externals_len++].num_arguments = num_arguments;
+}
+
+/****************************
+ * MEMORY                   *
+ ****************************/
+
+static uint32_t cgen_align(uint32_t offset, uint32_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/* cgen_layout_memory - gives the string literals and each file-scope object
+ *   its address, and puts the stack after them
+ */
+static void cgen_layout_memory(void) {
+  uint32_t size;
+  int i;
+
+  cgen_strings_size = literal_layout(&cgen_strings);
+  size = CGEN_DATA_BASE + cgen_strings_size;
+  cgen_global_addresses = calloc(ir_globals_len + 1, sizeof(uint32_t));
+  assert(NULL != cgen_global_addresses);
+  for (i = 0; i < ir_globals_len; i++) {
+    size = cgen_align(size, ir_globals[i].alignment > 0 ? ir_globals[i].alignment : 1);
+    cgen_global_addresses[i] = size;
+    size += ir_globals[i].size;
+  }
+  cgen_stack_base = cgen_align(size, 16);
+  cgen_memory_size = cgen_stack_base + CGEN_STACK_SIZE;
+}
+
+/* cgen_object_address - the address of a string literal or file-scope object,
+ *   or 0 if the label is neither
+ */
+static uint32_t cgen_object_address(char *label) {
+  int i, offset = literal_offset(label);
+
+  if (offset >= 0) {
+    return CGEN_DATA_BASE + offset;
+  }
+  for (i = 0; i < ir_globals_len; i++) {
+    if (!strcmp(ir_globals[i].label, label)) {
+      return cgen_global_addresses[i];
+    }
+  }
+  return 0;
+}
+
+/****************************
+ * CHECKING                 *
+ ****************************/
+
+/* cgen_check - reports an instruction there is no C for */
+static void cgen_check(struct cgen_function *function, struct ir_instruction *instruction) {
+  struct ir_operand *operands = instruction->operands;
+
+  switch (instruction->kind) {
+    case IR_LOG_AND:
+    case IR_LOG_OR:
+      printf("ERROR - C: no C for IR instruction %s in %s\n", ir_opcode_name(instruction->kind), function->name);
+      cgen_num_errors++;
+      break;
+
+    case IR_ADDRESS_OF:
+      if (operands[1].kind != OPERAND_LVALUE && 0 == cgen_object_address(operands[1].data.label_name)) {
+        printf("ERROR - C: nothing is called %s\n", operands[1].data.label_name);
+        cgen_num_errors++;
+      }
+      break;
+
+    case IR_GOTO_TABLE:
+      if (NULL == ir_find_jump_table(operands[1].data.label_name)) {
+        printf("ERROR - C: no jump table %s\n", operands[1].data.label_name);
+        cgen_num_errors++;
+      }
+      break;
+
+    case IR_PARAMETER:
+      if (operands[0].data.number >= CGEN_MAX_ARGUMENTS) {
+        printf("ERROR - C: a call in %s passes more than %d arguments\n", function->name, CGEN_MAX_ARGUMENTS);
+        cgen_num_errors++;
+      }
+      break;
+
+    default:
+      if (instruction->kind < IR_NO_OPERATION || instruction->kind > IR_MOVE_IF_ZERO) {
+        printf("ERROR - C: no C for IR instruction %d in %s\n", instruction->kind, function->name);
+        cgen_num_errors++;
+      }
+      break;
+  }
+}
+
+/* cgen_walk - goes through the program in order, finds the functions the
+ *   program calls but does not define, and checks there is C for each
+ *   instruction
+ */
+static void cgen_walk(struct ir_section *section) {
+  struct cgen_function *function = NULL, *next = cgen_functions;
+  struct ir_instruction *iter;
+  int arguments = 0;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (NULL != next && iter == next->begin) {
+      function = next;
+      next = next->next;
+    }
+    if (NULL != function && iter->kind != IR_SEQUENCE_PT) {
+      cgen_check(function, iter);
+      if (iter->kind == IR_PARAMETER && iter->operands[0].data.number >= arguments) {
+        arguments = (int)iter->operands[0].data.number + 1;
+      }
+      if (iter->kind == IR_FUNCTION_CALL || iter->kind == IR_TAIL_CALL) {
+        if (!strcmp(iter->operands[0].data.label_name, "read_int")
+            && NULL == cgen_find_function("read_int")) {
+          cgen_read_int_called = 1;
+        } else if (NULL == cgen_find_function(iter->operands[0].data.label_name)) {
+          cgen_add_external(iter->operands[0].data.label_name, arguments);
+        }
+        arguments = 0;
+      }
+    }
+    if (NULL != function && iter == function->end) {
+      function = NULL;
+    }
+    if (iter == section->last) {
+      break;
+    }
+  }
+}
+
+/****************************
+ * GENERATION               *
+ ****************************/
+
+/* cgen_generate_program - works out what the C for a program needs: its
+ *   functions, what they call, and where everything is in memory
+ *
+ * Parameters:
+ *   section - ir_section - all the instructions
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.  cgen_num_errors says whether the
+ *   program can be printed.
+ */
+void cgen_generate_program(struct ir_section *section) {
+  struct cgen_function *function;
+
+  cgen_num_errors = 0;
+  cgen_read_int_called = 0;
+  cgen_externals_len = 0;
+  cgen_section = section;
+  cgen_functions = cgen_collect_functions(section);
+  if (NULL == cgen_find_function("main")) {
+    printf("ERROR - C: the program has no main\n");
+    cgen_num_errors++;
+  }
+  for (function = cgen_functions; NULL != function; function = function->next) {
+    if (function->num_params > CGEN_MAX_ARGUMENTS) {
+      printf("ERROR - C: %s takes more than %d arguments\n", function->name, CGEN_MAX_ARGUMENTS);
+      cgen_num_errors++;
+    }
+  }
+  cgen_layout_memory();
+  cgen_walk(section);
+}
+
+/****************************
+ * C OUTPUT                 *
+ ****************************/
+
+/* cgen_value - the C for an operand read as a word: a temporary or a constant
+ *
+ * Returns one of a few buffers, so an instruction's operands can all be held
+ */
+static char *cgen_value(struct ir_operand *operand) {
+  static char buffers[3][32];
+  static int next;
+  char *buffer = buffers[next++ % 3];
+
+  switch (operand->kind) {
+    case OPERAND_TEMPORARY:
+      sprintf(buffer, "t%d", operand->data.temporary);
+      break;
+    case OPERAND_LVALUE:
+      sprintf(buffer, "(int32_t)(fp + %d)", operand->data.offset);
+      break;
+    default:
+      if (INT32_MIN == (int32_t)operand->data.number) {
+        sprintf(buffer, "INT32_MIN");
+      } else {
+        sprintf(buffer, "%d", (int32_t)operand->data.number);
+      }
+      break;
+  }
+  return buffer;
+}
+
+/* cgen_address - the C for the address a load or store reaches */
+static char *cgen_address(struct ir_operand *operand) {
+  static char buffer[48];
+
+  if (operand->kind == OPERAND_LVALUE) {
+    sprintf(buffer, "fp + %d", operand->data.offset);
+  } else {
+    sprintf(buffer, "(uint32_t)%s", cgen_value(operand));
+  }
+  return buffer;
+}
+
+/* cgen_print_arguments - prints the argument registers a call passes */
+static void cgen_print_arguments(FILE *output, int num_arguments) {
+  int i;
+
+  for (i = 0; i < num_arguments; i++) {
+    fprintf(output, "%sa%d", i > 0 ? ", " : "", i);
+  }
+}
+
+/* cgen_print_call - prints the C for a call, to the program's function, the
+ *   built-in read_int or one from outside the program
+ */
+static void cgen_print_call(FILE *output, char *name) {
+  struct cgen_function *callee = cgen_find_function(name);
+  int i;
+
+  if (NULL != callee) {
+    fprintf(output, "fn_%s(", name);
+    cgen_print_arguments(output, callee->num_params);
+  } else if (!strcmp(name, "read_int")) {
+    fprintf(output, "rt_read_int(");
+  } else {
+    for (i = 0; strcmp(cgen_externals[i].name, name); i++)
+      ;
+    fprintf(output, "%s(", name);
+    cgen_print_arguments(output, cgen_externals[i].num_arguments);
+  }
+  fprintf(output, ")");
+}
+
+static int cgen_is_load(int kind) {
+  return kind == IR_LOAD_BYTE || kind == IR_LOAD_BYTE_U || kind == IR_LOAD_HALF_WORD
+      || kind == IR_LOAD_HALF_WORD_U || kind == IR_LOAD_WORD;
+}
+
+/* cgen_print_instruction - prints the C statement for one instruction
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ *   function - cgen_function - the function it is in
+ *   instruction - ir_instruction - the instruction
+ */
+static void cgen_print_instruction(FILE *output, struct cgen_function *function,
+                                   struct ir_instruction *instruction) {
+  struct ir_operand *operands = instruction->operands;
+  struct ir_jump_table *table;
+  uint32_t address;
+  int i;
+
+  for (i = 0; NULL != cgen_binary_formats[i].format; i++) {
+    if (cgen_binary_formats[i].kind == instruction->kind) {
+      fprintf(output, "  t%d = ", operands[0].data.temporary);
+      fprintf(output, cgen_binary_formats[i].format, cgen_value(&operands[1]),
+              cgen_value(&operands[2]));
+      fprintf(output, ";\n");
+      return;
+    }
+  }
+  for (i = 0; NULL != cgen_unary_formats[i].format; i++) {
+    if (cgen_unary_formats[i].kind == instruction->kind) {
+      fprintf(output, "  t%d = ", operands[0].data.temporary);
+      if (cgen_is_load(instruction->kind)) {
+        fprintf(output, cgen_unary_formats[i].format, cgen_address(&operands[1]));
+      } else {
+        fprintf(output, cgen_unary_formats[i].format, cgen_value(&operands[1]));
+      }
+      fprintf(output, ";\n");
+      return;
+    }
+  }
+
+  switch (instruction->kind) {
+    case IR_LOAD_IMMEDIATE:
+      fprintf(output, "  t%d = %s;\n", operands[0].data.temporary, cgen_value(&operands[1]));
+      break;
+
+    case IR_ADDRESS_OF:
+      if (operands[1].kind == OPERAND_LVALUE) {
+        fprintf(output, "  t%d = %s;\n", operands[0].data.temporary, cgen_value(&operands[1]));
+        break;
+      }
+      address = cgen_object_address(operands[1].data.label_name);
+      fprintf(output, "  t%d = %u; /* %s */\n", operands[0].data.temporary, address, operands[1].data.label_name);
+      break;
+
+    case IR_MOVE_IF_NOT_ZERO:
+    case IR_MOVE_IF_ZERO:
+      fprintf(output, "  if (%s %s 0) {\n", cgen_value(&operands[2]),
+              instruction->kind == IR_MOVE_IF_NOT_ZERO ? "!=" : "==");
+      fprintf(output, "    t%d = %s;\n  }\n", operands[0].data.temporary, cgen_value(&operands[1]));
+      break;
+
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+      fprintf(output, "  rt_%s(%s, ", instruction->kind == IR_STORE_BYTE ? "sb"
+              : instruction->kind == IR_STORE_HALF_WORD ? "sh" : "sw", cgen_address(&operands[1]));
+      fprintf(output, "%s);\n", cgen_value(&operands[0]));
+      break;
+
+    case IR_LABEL:
+      fprintf(output, "L_%s:;\n", operands[0].data.label_name);
+      break;
+
+    case IR_GOTO:
+      fprintf(output, "  goto L_%s;\n", operands[0].data.label_name);
+      break;
+
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      fprintf(output, "  if (%s %s 0) {\n    goto L_%s;\n  }\n", cgen_value(&operands[0]),
+              instruction->kind == IR_GOTO_IF_TRUE ? "!=" : "==", operands[1].data.label_name);
+      break;
+
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+      fprintf(output, "  if (%s ", cgen_value(&operands[0]));
+      fprintf(output, "%s %s) {\n    goto L_%s;\n  }\n",
+              (char *[]){"==", "!=", "<", "<=", ">", ">="}[instruction->kind - IR_GOTO_IF_EQUAL],
+              cgen_value(&operands[1]), operands[2].data.label_name);
+      break;
+
+    case IR_GOTO_TABLE:
+      table = ir_find_jump_table(operands[1].data.label_name);
+      fprintf(output, "  switch ((uint32_t)%s) {\n", cgen_value(&operands[0]));
+      for (i = 0; i < table->count; i++) {
+        fprintf(output, "    case %d: goto L_%s;\n", i, table->targets[i]);
+      }
+      fprintf(output, "    default: rt_trap(\"jump table entry out of range\");\n  }\n");
+      break;
+
+    case IR_PARAMETER:
+      fprintf(output, "  a%d = %s;\n", (int)operands[0].data.number, cgen_value(&operands[1]));
+      break;
+
+    case IR_FUNCTION_CALL:
+      fprintf(output, "  v0 = ");
+      cgen_print_call(output, operands[0].data.label_name);
+      fprintf(output, ";\n");
+      break;
+
+    // The frame is given up first, so the callee's goes where it was
+    case IR_TAIL_CALL:
+      fprintf(output, "  rt_sp = fp + %d;\n  return ", function->frame_size);
+      cgen_print_call(output, operands[0].data.label_name);
+      fprintf(output, ";\n");
+      break;
+
+    case IR_RESULT_WORD:
+    case IR_RESULT_BYTE:
+      fprintf(output, "  t%d = v0;\n", operands[0].data.temporary);
+      break;
+
+    case IR_RETURN:
+      fprintf(output, "  v0 = %s;\n", cgen_value(&operands[0]));
+      break;
+
+    case IR_PROC_BEGIN:
+      fprintf(output, "  fp = rt_enter(%d);\n", function->frame_size);
+      for (i = 0; i < function->num_params && i < CGEN_MAX_ARGUMENTS && (i + 1) * 4 <= function->frame_size; i++) {
+        fprintf(output, "  rt_sw(fp + %d, p%d);\n", 4 * i, i);
+      }
+      break;
+
+    case IR_PROC_END:
+      fprintf(output, "  rt_sp = fp + %d;\n  return v0;\n", function->frame_size);
+      break;
+
+    case IR_PRINT_NUMBER:
+      fprintf(output, "  printf(\"%%d\", (int)%s);\n", cgen_value(&operands[0]));
+      break;
+
+    case IR_PRINT_STRING:
+      fprintf(output, "  rt_print_string(%s);\n", cgen_value(&operands[0]));
+      break;
+
+    // cgen_check has turned away anything else
+    default:
+      break;
+  }
+}
+
+/* cgen_print_signature - prints "int32_t fn_name(int32_t p0, ...)" */
+static void cgen_print_signature(FILE *output, struct cgen_function *function) {
+  int i;
+
+  fprintf(output, "int32_t fn_%s(", function->name);
+  for (i = 0; i < function->num_params; i++) {
+    fprintf(output, "%sint32_t p%d", i > 0 ? ", " : "", i);
+  }
+  fprintf(output, "%s)", 0 == function->num_params ? "void" : "");
+}
+
+/* cgen_print_locals - declares the temporaries a function reads or writes,
+ *   and the argument registers its calls pass
+ */
+static void cgen_print_locals(FILE *output, struct cgen_function *function) {
+  int t;
+
+  fprintf(output, "  uint32_t fp;\n  int32_t v0 = 0;\n");
+  for (t = 0; t < function->num_temporaries; t++) {
+    if (function->written[t] || function->read[t]) {
+      fprintf(output, "  int32_t t%d = 0;\n", function->first_temporary + t);
+    }
+  }
+  for (t = 0; t < function->num_arguments; t++) {
+    fprintf(output, "  int32_t a%d = 0;\n", t);
+  }
+}
+
+/* cgen_print_functions - prints each function, walking the program in order */
+static void cgen_print_functions(FILE *output) {
+  struct cgen_function *function = NULL, *next = cgen_functions;
+  struct ir_instruction *iter;
+
+  for (iter = cgen_section->first; NULL != iter; iter = iter->next) {
+    if (NULL != next && iter == next->begin) {
+      function = next;
+      next = next->next;
+      fprintf(output, "\n");
+      cgen_print_signature(output, function);
+      fprintf(output, " {\n");
+      cgen_print_locals(output, function);
+      fprintf(output, "\n");
+    }
+    if (NULL != function) {
+      cgen_print_instruction(output, function, iter);
+      if (iter == function->end) {
+        fprintf(output, "}\n");
+        function = NULL;
+      }
+    }
+    if (iter == cgen_section->last) {
+      break;
+    }
+  }
+}
+
+/* cgen_print_program - prints the program as C
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void cgen_print_program(FILE *output) {
+  struct cgen_function *function;
+  int i, j;
+
+  fputs("/* C from the IR; compile with a C99 compiler, e.g. cc -O2 */\n", output);
+  fputs("#include <stdio.h>\n#include <stdlib.h>\n#include <stdint.h>\n#include <string.h>\n\n", output);
+  fprintf(output, "#define RT_MEMORY_SIZE %uu\n#define RT_STACK_BASE %uu\n\n", cgen_memory_size, cgen_stack_base);
+  for (i = 0; NULL != cgen_runtime[i]; i++) {
+    fprintf(output, "%s\n", cgen_runtime[i]);
+  }
+  if (cgen_read_int_called) {
+    for (i = 0; NULL != cgen_read_int[i]; i++) {
+      fprintf(output, "%s\n", cgen_read_int[i]);
+    }
+  }
+
+  if (cgen_strings_size > 0) {
+    fprintf(output, "\nstatic const unsigned char rt_strings[%d] = {", cgen_strings_size);
+    for (i = 0; i < cgen_strings_size; i++) {
+      fprintf(output, "%s%d", i % 16 == 0 ? (i > 0 ? ",\n  " : "\n  ") : ", ", (unsigned char)cgen_strings[i]);
+    }
+    fputs("\n};\n", output);
+  }
+
+  fputs("\n", output);
+  for (i = 0; i < cgen_externals_len; i++) {
+    fprintf(output, "int32_t %s(", cgen_externals[i].name);
+    for (j = 0; j < cgen_externals[i].num_arguments; j++) {
+      fprintf(output, "%sint32_t", j > 0 ? ", " : "");
+    }
+    fprintf(output, "%s);\n", 0 == cgen_externals[i].num_arguments ? "void" : "");
+  }
+  for (function = cgen_functions; NULL != function; function = function->next) {
+    cgen_print_signature(output, function);
+    fputs(";\n", output);
+  }
+
+  cgen_print_functions(output);
+
+  fputs("\nint main(void) {\n", output);
+  if (cgen_strings_size > 0) {
+    fprintf(output, "  memcpy(rt_memory + %d, rt_strings, sizeof(rt_strings));\n", CGEN_DATA_BASE);
+  }
+  function = cgen_find_function("main");
+  if (NULL != function) {
+    fputs("  fn_main(", output);
+    for (i = 0; i < function->num_params; i++) {
+      fprintf(output, "%s0", i > 0 ? ", " : "");
+    }
+    fputs(");\n", output);
+  }
+  fputs("  return 0;\n}\n", output);
+}
@@ -0,0 +1,13 @@
+#ifndef _CGEN_H
+#define _CGEN_H
+
+#include <stdio.h>
+
+struct ir_section;
+
+void cgen_generate_program(struct ir_section *section);
+void cgen_print_program(FILE *output);
+
+extern int cgen_num_errors;
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
@@ -7,7 +8,18 @@
 #include "symbol.h"
 #include "type.h"
 #include "ir.h"
+#include "inline.h"
 #include "mips.h"
+#include "frame.h"
+#include "profile.h"
+#include "peephole.h"
+#include "schedule.h"
+#include "interpret.h"
+#include "object.h"
+#include "x86.h"
+#include "jit.h"
+#include "cgen.h"
+#include "pass.h"
 
 
 #define YYSTYPE struct node *
@@ -220,31 +232,93 @@ int scan_only(FILE *output) {
   return num_errors;
 }
 
+/* set_flag - handles a -f<name> code generation option
+ *
+ * Parameters:
+ *   flag - char * - the option text following -f
+ *
+ * Returns "true" if the option was recognized
+ */
+static int set_flag(char *flag) {
+  if (!strncmp(flag, "inline-limit=", 13)) {
+    inline_limit = atoi(flag + 13);
+  } else if (!strncmp(flag, "inline-caller-limit=", 20)) {
+    inline_caller_limit = atoi(flag + 20);
+  } else if (!strcmp(flag, "inline-report")) {
+    inline_report = 1;
+  } else if (!strcmp(flag, "frame-report")) {
+    frame_report = 1;
+  } else if (!strcmp(flag, "profile-generate")) {
+    profile_generate = 1;
+  } else if (!strncmp(flag, "profile-use=", 12)) {
+    profile_use = flag + 12;
+  } else if (!strcmp(flag, "peephole-report")) {
+    peephole_report = 1;
+  } else if (!strcmp(flag, "pass-report")) {
+    pass_report = 1;
+  } else if (!strcmp(flag, "delayed-branch")) {
+    schedule_delay_slots = 1;
+  } else if (!strcmp(flag, "no-delayed-branch")) {
+    schedule_delay_slots = 0;
+  } else if (!strcmp(flag, "big-endian")) {
+    object_big_endian = 1;
+  } else if (!strcmp(flag, "little-endian")) {
+    object_big_endian = 0;
+  } else {
+    /* The optimizations, which -O also switches */
+    return pass_set_flag(flag);
+  }
+  return 1;
+}
+
 int main(int argc, char **argv) {
   FILE *output;
   int result;
   struct symbol_table symbol_table;
-  char *stage;
-  int opt;
+  struct mips_section *code;
+  char *stage, *output_name, *level, **flags;
+  int opt, object_output, num_flags, i;
 
   /* yydebug = 1; */
   
-  output = NULL;
+  output_name = NULL;
+  object_output = 0;
   stage = "mips";
-  while (-1 != (opt = getopt(argc, argv, "o:s:"))) {
+  level = NULL;
+  flags = malloc(sizeof(char *) * argc);
+  assert(NULL != flags);
+  num_flags = 0;
+  while (-1 != (opt = getopt(argc, argv, "co:s:f:O:"))) {
     switch (opt) {
+      case 'c':
+        object_output = 1;
+        break;
       case 'o':
-        output = fopen(optarg, "w");
-        if (NULL == output) {
-          fprintf(stdout, "Could not open output file %s: %s", optarg, strerror(errno));
-          return -1;
-        }
+        output_name = optarg;
         break;
       case 's':
         stage = optarg;
         break;
+      case 'f':
+        flags[num_flags++] = optarg;
+        break;
+      case 'O':
+        level = optarg;
+        break;
+    }
+  }
+  /* -O first, so that -f can change what it picked */
+  if (NULL != level && !pass_set_level(level)) {
+    fprintf(stdout, "Unknown option -O%s\n", level);
+    return -1;
+  }
+  for (i = 0; i < num_flags; i++) {
+    if (!set_flag(flags[i])) {
+      fprintf(stdout, "Unknown option -f%s\n", flags[i]);
+      return -1;
     }
   }
+  free(flags);
   /* Figure out whether we're using stdin/stdout or file in/file out. */
   if (argc < 2 || !strcmp("-", argv[1])) {
     yyin = stdin;
@@ -252,8 +326,14 @@ int main(int argc, char **argv) {
     yyin = fopen(argv[1], "r");
   }
 
+  /* Assembly by default, or with -c an object file written directly */
+  if (NULL == output_name) {
+    output_name = object_output ? "output.o" : 0 == strcmp("c", stage) ? "output.c" : "output.s";
+  }
+  output = fopen(output_name, object_output ? "wb" : "w");
   if (NULL == output) {
-    output = fopen("output.s", "w");
+    fprintf(stdout, "Could not open output file %s: %s", output_name, strerror(errno));
+    return -1;
   }
 
   if (0 == strcmp("scanner", stage)) {
@@ -321,15 +401,112 @@ int main(int argc, char **argv) {
   }
   fprintf(stdout, "=================== IR ===================\n");
   ir_print_section(stdout, root_node->ir);
+  if (inline_report) {
+    fprintf(stdout, "================= INLINING ===============\n");
+    inline_print_report(stdout);
+  }
+  if (frame_report) {
+    fprintf(stdout, "================= FRAMES =================\n");
+    frame_print_report(stdout);
+  }
+  /* With -s mips the report comes after the MIPS passes have run too */
+  if (pass_report && 0 != strcmp("mips", stage)) {
+    fprintf(stdout, "================= PASSES =================\n");
+    pass_print_report(stdout);
+  }
   if (0 == strcmp("ir", stage)) {
     return 0;
   }
+  if (0 == strcmp("ir-run", stage)) {
+    fprintf(stdout, "================= IR RUN =================\n");
+    result = interpret_program(stdout, root_node->ir);
+    fprintf(stdout, "\n=============== IR PROFILE ===============\n");
+    interpret_print_report(stdout);
+    return result ? 6 : 0;
+  }
+  if (0 == strcmp("x86-64", stage)) {
+    struct x86_section *x86_code;
+    if (object_output) {
+      fprintf(stdout, "-c writes MIPS objects only\n");
+      return -1;
+    }
+    x86_code = x86_generate_program(root_node->ir);
+    if (x86_num_errors > 0) {
+      print_errors_from_pass(stdout, "x86-64 code generation", x86_num_errors);
+      return 8;
+    }
+    x86_generate_runtime(x86_code);
+    fprintf(stdout, "================= X86-64 =================\n");
+    x86_print_program(stdout, x86_code);
+    x86_print_program(output, x86_code);
+    return 0;
+  }
+  if (0 == strcmp("jit", stage)) {
+    if (object_output) {
+      fprintf(stdout, "-c writes MIPS objects only\n");
+      return -1;
+    }
+    jit_compile(root_node->ir);
+    if (jit_num_errors > 0) {
+      print_errors_from_pass(stdout, "JIT", jit_num_errors);
+      return 9;
+    }
+    fprintf(stdout, "=================== JIT ==================\n");
+    jit_print_listing(stdout);
+    fprintf(stdout, "\n================= JIT RUN ================\n");
+    fflush(stdout);
+    jit_run();
+    fprintf(stdout, "\n================ JIT TIMES ===============\n");
+    jit_print_report(stdout);
+    return 0;
+  }
+  if (0 == strcmp("c", stage)) {
+    if (object_output) {
+      fprintf(stdout, "-c writes MIPS objects only\n");
+      return -1;
+    }
+    cgen_generate_program(root_node->ir);
+    if (cgen_num_errors > 0) {
+      print_errors_from_pass(stdout, "C generation", cgen_num_errors);
+      return 10;
+    }
+    fprintf(stdout, "=================== C ====================\n");
+    cgen_print_program(stdout);
+    cgen_print_program(output);
+    return 0;
+  }
 
-  fprintf(stdout, "================== MIPS ==================\n");
-  mips_print_program(stdout, root_node->ir);
-  fputs("\n\n", stdout);
+  code = mips_generate_program(root_node->ir);
+  pass_run_mips(code, root_node->ir);
+
+  if (!object_output) {
+    fprintf(stdout, "================== MIPS ==================\n");
+    mips_print_program(stdout, code);
+    fputs("\n\n", stdout);
+  }
+  if (peephole_report) {
+    fprintf(stdout, "================ PEEPHOLE ================\n");
+    peephole_print_report(stdout);
+  }
+  if (pass_report) {
+    fprintf(stdout, "================= PASSES =================\n");
+    pass_print_report(stdout);
+  }
+
+  /* With -c the instructions are encoded here instead of printed for an assembler */
+  if (object_output) {
+    object_assemble(code);
+    if (object_num_errors > 0) {
+      print_errors_from_pass(stdout, "Object writer", object_num_errors);
+      return 7;
+    }
+    fprintf(stdout, "================= OBJECT =================\n");
+    object_print_listing(stdout);
+    object_write(output);
+    return 0;
+  }
 
-  mips_print_program(output, root_node->ir);
+  mips_print_program(output, code);
   fputs("\n\n", output);
 
   return 0;
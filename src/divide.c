@@ -0,0 +1,222 @@
+/*
+ * divide.c
+ *
+ * Division by a constant as a multiply by its reciprocal, since a div takes
+ * 35 cycles on the R2000 and R3000.  The high word of the dividend times a
+ * "magic number" close to 2^(32 + s) / d, shifted right by s, is the quotient
+ * rounded down; negative quotients are rounded toward zero by adding one.
+ * The magic numbers are the ones Hacker's Delight, chapter 10, works out.
+ * Powers of two only need shifts: a signed dividend is biased by d - 1 first
+ * if it is negative, so that the shift rounds toward zero too.
+ *
+ * The steps are given back for the IR generator to turn into instructions,
+ * the same way multiply.c gives back its shift and add chains.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "divide.h"
+
+int divide_magic_enabled = 1;
+
+/* The multiplier and shift that replace division by a constant */
+struct divide_magic {
+  long multiplier;
+  int shift;
+  /* Unsigned only: the multiplier needs a 33rd bit, which is added back in */
+  int add;
+};
+
+/* divide_signed_magic - works out the magic number for signed division, as in
+ *   Hacker's Delight, section 10-4
+ *
+ * Parameters:
+ *   divisor - long - the divisor, with 2 <= |divisor| < 2^31
+ *
+ * Returns the multiplier, as a signed 32-bit value, and the shift
+ */
+static struct divide_magic divide_signed_magic(long divisor) {
+  const uint32_t two31 = 0x80000000u;
+  uint32_t d = (uint32_t)divisor, ad, t, anc, q1, r1, q2, r2, delta;
+  struct divide_magic magic;
+  int p = 31;
+
+  ad = divisor < 0 ? (uint32_t)-divisor : d;
+  t = two31 + (d >> 31);
+  anc = t - 1 - t % ad;
+  q1 = two31 / anc;
+  r1 = two31 - q1 * anc;
+  q2 = two31 / ad;
+  r2 = two31 - q2 * ad;
+  do {
+    p++;
+    q1 = 2 * q1;
+    r1 = 2 * r1;
+    if (r1 >= anc) {
+      q1++;
+      r1 -= anc;
+    }
+    q2 = 2 * q2;
+    r2 = 2 * r2;
+    if (r2 >= ad) {
+      q2++;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  magic.multiplier = (int32_t)(q2 + 1);
+  if (divisor < 0) {
+    magic.multiplier = -magic.multiplier;
+  }
+  magic.shift = p - 32;
+  magic.add = 0;
+  return magic;
+}
+
+/* divide_unsigned_magic - works out the magic number for unsigned division,
+ *   as in Hacker's Delight, section 10-10
+ *
+ * Parameters:
+ *   divisor - long - the divisor, with 2 <= divisor < 2^32
+ *
+ * Returns the multiplier, as a signed 32-bit value, the shift, and whether the
+ *   multiplier has a 33rd bit
+ */
+static struct divide_magic divide_unsigned_magic(long divisor) {
+  uint32_t d = (uint32_t)divisor, nc, q1, r1, q2, r2, delta;
+  struct divide_magic magic;
+  int p = 31;
+
+  magic.add = 0;
+  nc = (uint32_t)-1 - (uint32_t)(-d) % d;
+  q1 = 0x80000000u / nc;
+  r1 = 0x80000000u - q1 * nc;
+  q2 = 0x7fffffffu / d;
+  r2 = 0x7fffffffu - q2 * d;
+  do {
+    p++;
+    if (r1 >= nc - r1) {
+      q1 = 2 * q1 + 1;
+      r1 = 2 * r1 - nc;
+    } else {
+      q1 = 2 * q1;
+      r1 = 2 * r1;
+    }
+    if (r2 + 1 >= d - r2) {
+      if (q2 >= 0x7fffffffu) {
+        magic.add = 1;
+      }
+      q2 = 2 * q2 + 1;
+      r2 = 2 * r2 + 1 - d;
+    } else {
+      if (q2 >= 0x80000000u) {
+        magic.add = 1;
+      }
+      q2 = 2 * q2;
+      r2 = 2 * r2 + 1;
+    }
+    delta = d - 1 - r2;
+  } while (p < 64 && (q1 < delta || (q1 == delta && r1 == 0)));
+
+  magic.multiplier = (int32_t)(q2 + 1);
+  magic.shift = p - 32;
+  return magic;
+}
+
+/* divide_log2 - the exponent of a power of two, or -1 for anything else */
+static int divide_log2(unsigned long value) {
+  int exponent = 0;
+
+  if (0 == value || 0 != (value & (value - 1))) {
+    return -1;
+  }
+  while (value > 1) {
+    value >>= 1;
+    exponent++;
+  }
+  return exponent;
+}
+
+/* divide_append - adds a step to a plan and returns the value it computes */
+static int divide_append(struct divide_step *steps, int *count, int kind, int left, int right, long amount) {
+  assert(*count < DIVIDE_MAX_STEPS);
+  steps[*count].kind = kind;
+  steps[*count].left = left;
+  steps[*count].right = right;
+  steps[*count].amount = amount;
+  return ++*count;
+}
+
+/* divide_plan - works out the steps that divide by a constant, rounding the
+ *   quotient toward zero
+ *
+ * Parameters:
+ *   divisor - long - a 32-bit divisor other than 0, and, when unsigned,
+ *     between 1 and 2^31 - 1
+ *   is_unsigned - int - "true" for unsigned division
+ *   steps - divide_step - room for DIVIDE_MAX_STEPS steps
+ *
+ * Returns the number of steps, the last of which computes the quotient (none
+ *   for a divisor of 1), or -1 if the division should be left to a div
+ */
+int divide_plan(long divisor, int is_unsigned, struct divide_step *steps) {
+  unsigned long magnitude = divisor < 0 ? 0UL - (unsigned long)divisor : (unsigned long)divisor;
+  int exponent = divide_log2(magnitude), count = 0, value = 0, sign;
+  struct divide_magic magic;
+
+  assert(0 != divisor && (!is_unsigned || divisor > 0));
+  if (!divide_magic_enabled) {
+    return -1;
+  }
+
+  if (is_unsigned) {
+    if (exponent >= 0) {
+      return exponent > 0 ? divide_append(steps, &count, DIVIDE_SHIFT_RIGHT_U, 0, 0, exponent) : 0;
+    }
+    magic = divide_unsigned_magic(divisor);
+    value = divide_append(steps, &count, DIVIDE_MULTIPLY_HIGH_U, 0, 0, magic.multiplier);
+    if (!magic.add) {
+      return divide_append(steps, &count, DIVIDE_SHIFT_RIGHT_U, value, 0, magic.shift);
+    }
+    // ((dividend - high) / 2 + high) >> (shift - 1), without overflowing 32 bits
+    sign = divide_append(steps, &count, DIVIDE_SUBTRACT, 0, value, 0);
+    sign = divide_append(steps, &count, DIVIDE_SHIFT_RIGHT_U, sign, 0, 1);
+    value = divide_append(steps, &count, DIVIDE_ADD, sign, value, 0);
+    return divide_append(steps, &count, DIVIDE_SHIFT_RIGHT_U, value, 0, magic.shift - 1);
+  }
+
+  if (exponent >= 0) {
+    // Negative dividends are biased by divisor - 1 so the shift rounds toward zero
+    if (exponent > 0) {
+      sign = 0;
+      if (exponent > 1) {
+        sign = divide_append(steps, &count, DIVIDE_SHIFT_RIGHT, 0, 0, exponent - 1);
+      }
+      sign = divide_append(steps, &count, DIVIDE_SHIFT_RIGHT_U, sign, 0, 32 - exponent);
+      value = divide_append(steps, &count, DIVIDE_ADD, 0, sign, 0);
+      value = divide_append(steps, &count, DIVIDE_SHIFT_RIGHT, value, 0, exponent);
+    }
+    if (divisor < 0) {
+      divide_append(steps, &count, DIVIDE_NEGATE, value, 0, 0);
+    }
+    return count;
+  }
+
+  magic = divide_signed_magic(divisor);
+  value = divide_append(steps, &count, DIVIDE_MULTIPLY_HIGH, 0, 0, magic.multiplier);
+  if (divisor > 0 && magic.multiplier < 0) {
+    value = divide_append(steps, &count, DIVIDE_ADD, value, 0, 0);
+  } else if (divisor < 0 && magic.multiplier > 0) {
+    value = divide_append(steps, &count, DIVIDE_SUBTRACT, value, 0, 0);
+  }
+  if (magic.shift > 0) {
+    value = divide_append(steps, &count, DIVIDE_SHIFT_RIGHT, value, 0, magic.shift);
+  }
+
+  // Add one to negative quotients, which are one too small
+  sign = divide_append(steps, &count, DIVIDE_SHIFT_RIGHT_U, value, 0, 31);
+  return divide_append(steps, &count, DIVIDE_ADD, value, sign, 0);
+}
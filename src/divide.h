@@ -0,0 +1,29 @@
+#ifndef _DIVIDE_H
+#define _DIVIDE_H
+
+/*
+ * One step of a division by a constant.  Value 0 is the dividend and step i
+ * computes value i + 1 from earlier values.  Adds and subtracts wrap round.
+ */
+#define DIVIDE_MULTIPLY_HIGH     1 /* high word of values[left] * amount, signed */
+#define DIVIDE_MULTIPLY_HIGH_U   2 /* high word of values[left] * amount, unsigned */
+#define DIVIDE_SHIFT_RIGHT       3 /* values[left] >> amount, arithmetic */
+#define DIVIDE_SHIFT_RIGHT_U     4 /* values[left] >> amount, logical */
+#define DIVIDE_ADD               5 /* values[left] + values[right] */
+#define DIVIDE_SUBTRACT          6 /* values[left] - values[right] */
+#define DIVIDE_NEGATE            7 /* 0 - values[left] */
+
+struct divide_step {
+  int kind;
+  int left, right;
+  long amount;
+};
+
+/* Enough steps for any 32-bit divisor */
+#define DIVIDE_MAX_STEPS 8
+
+int divide_plan(long divisor, int is_unsigned, struct divide_step *steps);
+
+extern int divide_magic_enabled;
+
+#endif
@@ -0,0 +1,827 @@
+/*
+ * evaluate.c
+ *
+ * Compile-time evaluation of calls to pure functions.  A function is pure if
+ * nothing it does can be seen from outside but its return value: it prints
+ * nothing, takes the address of no global or string, every load and store it
+ * makes is one alias.c has tied to its own frame, and every function it calls
+ * is pure too.  Purity is worked out over the call graph, starting from every
+ * function that passes on its own and dropping those that call one that does
+ * not, until nothing changes; a function that calls itself stays pure.
+ *
+ * A call of a pure function whose arguments are all constants is then run
+ * here, on the IR, with frames of its own for it and anything it calls.  If it
+ * returns within EVALUATE_MAX_STEPS instructions and EVALUATE_MAX_DEPTH nested
+ * calls, without reading anything it never wrote or doing anything that would
+ * trap on the machine, its result replaces the call as an IR_LOAD_IMMEDIATE.
+ * Otherwise the call is left to run time.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "ir.h"
+#include "alias.h"
+#include "evaluate.h"
+
+int evaluate_enabled = 1;
+
+/* Where frame number n of an evaluation starts in the addresses it sees */
+#define EVALUATE_FRAME_ADDRESS(n) (0x10000000L + (long)(n) * EVALUATE_MAX_FRAME)
+
+struct evaluate_function {
+  char *name;
+  struct ir_instruction *begin;
+  struct ir_instruction *end;
+  int num_params;
+  int frame_size;
+  /* The temporaries its instructions use are first_temporary onwards */
+  int first_temporary;
+  int num_temporaries;
+  int pure;
+  struct evaluate_function *next;
+};
+
+/* One call being evaluated */
+struct evaluate_frame {
+  struct evaluate_function *function;
+  long *temporaries;
+  unsigned char *temporary_set;
+  unsigned char *memory;
+  unsigned char *memory_set;
+};
+
+/* An evaluation in progress */
+struct evaluate_state {
+  struct evaluate_function *functions;
+  struct evaluate_frame frames[EVALUATE_MAX_DEPTH];
+  int depth;
+  long steps;
+  long limit;
+};
+
+/*********************
+ * PURITY            *
+ *********************/
+
+/* evaluate_find - looks up a function by name */
+static struct evaluate_function *evaluate_find(struct evaluate_function *functions, char *name) {
+  for (; NULL != functions; functions = functions->next) {
+    if (!strcmp(functions->name, name)) {
+      return functions;
+    }
+  }
+  return NULL;
+}
+
+/* evaluate_measure - works out the range of temporaries a function uses */
+static void evaluate_measure(struct evaluate_function *function) {
+  struct ir_instruction *iter;
+  int low = -1, high = -1, i;
+
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      if (low < 0 || iter->operands[i].data.temporary < low) {
+        low = iter->operands[i].data.temporary;
+      }
+      if (iter->operands[i].data.temporary > high) {
+        high = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  function->first_temporary = low < 0 ? 0 : low;
+  function->num_temporaries = low < 0 ? 0 : high - low + 1;
+}
+
+/* evaluate_collect_functions - walks the program and records each function's extent
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Returns a list of functions in program order
+ */
+static struct evaluate_function *evaluate_collect_functions(struct ir_section *section) {
+  struct evaluate_function *functions = NULL, *last = NULL, *current = NULL;
+  struct ir_instruction *iter;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == IR_PROC_BEGIN) {
+      current = malloc(sizeof(struct evaluate_function));
+      assert(NULL != current);
+      current->name = iter->operands[0].data.label_name;
+      current->begin = iter;
+      current->end = iter;
+      current->frame_size = (int)iter->operands[1].data.number;
+      current->num_params = (int)iter->operands[2].data.number;
+      current->pure = 0;
+      current->next = NULL;
+      if (NULL == last) {
+        functions = current;
+      } else {
+        last->next = current;
+      }
+      last = current;
+    } else if ((iter->kind == IR_PROC_END || iter->kind == IR_TAIL_CALL) && NULL != current) {
+      current->end = iter;
+    }
+    if (iter == section->last) {
+      break;
+    }
+  }
+
+  for (current = functions; NULL != current; current = current->next) {
+    evaluate_measure(current);
+  }
+  return functions;
+}
+
+/* evaluate_is_pure - whether a function, leaving aside what it calls, has no
+ *   effect but its return value
+ */
+static int evaluate_is_pure(struct evaluate_function *function) {
+  struct ir_instruction *iter;
+
+  if (function->frame_size > EVALUATE_MAX_FRAME) {
+    return 0;
+  }
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    switch (iter->kind) {
+      case IR_PRINT_NUMBER:
+      case IR_PRINT_STRING:
+      case IR_TAIL_CALL:
+        return 0;
+
+      case IR_ADDRESS_OF:
+        // Globals and strings are labels; the frame is all it may touch
+        if (iter->operands[1].kind != OPERAND_LVALUE) {
+          return 0;
+        }
+        break;
+
+      case IR_LOAD_BYTE:
+      case IR_LOAD_BYTE_U:
+      case IR_LOAD_HALF_WORD:
+      case IR_LOAD_HALF_WORD_U:
+      case IR_LOAD_WORD:
+      case IR_STORE_BYTE:
+      case IR_STORE_HALF_WORD:
+      case IR_STORE_WORD:
+        if (iter->alias.kind != ALIAS_FRAME) {
+          return 0;
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+  return 1;
+}
+
+/* evaluate_mark_pure - works out which functions are pure
+ *
+ * Parameters:
+ *   functions - evaluate_function - all functions
+ */
+static void evaluate_mark_pure(struct evaluate_function *functions) {
+  struct evaluate_function *function, *callee;
+  struct ir_instruction *iter;
+  int changed = 1;
+
+  for (function = functions; NULL != function; function = function->next) {
+    function->pure = evaluate_is_pure(function);
+  }
+
+  // Calling something that is not pure, or that is not defined here, is not
+  while (changed) {
+    changed = 0;
+    for (function = functions; NULL != function; function = function->next) {
+      for (iter = function->begin; function->pure && iter != function->end->next; iter = iter->next) {
+        if (iter->kind != IR_FUNCTION_CALL) {
+          continue;
+        }
+        callee = evaluate_find(functions, iter->operands[0].data.label_name);
+        if (NULL == callee || !callee->pure) {
+          function->pure = 0;
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+/*********************
+ * EVALUATION        *
+ *********************/
+
+/* evaluate_wrap - a value cut down to the 32 bits of a register */
+static long evaluate_wrap(int64_t value) {
+  return (int32_t)(uint32_t)value;
+}
+
+/* evaluate_get - the value of an operand
+ *
+ * Returns "true" if it has one
+ */
+static int evaluate_get(struct evaluate_frame *frame, struct ir_operand *operand, long *value) {
+  int index;
+
+  if (operand->kind == OPERAND_NUMBER) {
+    *value = evaluate_wrap(operand->data.number);
+    return 1;
+  }
+  if (operand->kind != OPERAND_TEMPORARY) {
+    return 0;
+  }
+  index = operand->data.temporary - frame->function->first_temporary;
+  assert(index >= 0 && index < frame->function->num_temporaries);
+  *value = frame->temporaries[index];
+  return frame->temporary_set[index];
+}
+
+/* evaluate_set - gives a temporary a value */
+static void evaluate_set(struct evaluate_frame *frame, struct ir_operand *operand, long value) {
+  int index = operand->data.temporary - frame->function->first_temporary;
+
+  assert(operand->kind == OPERAND_TEMPORARY);
+  assert(index >= 0 && index < frame->function->num_temporaries);
+  frame->temporaries[index] = evaluate_wrap(value);
+  frame->temporary_set[index] = 1;
+}
+
+/* evaluate_memory - finds the bytes an access goes to
+ *
+ * Parameters:
+ *   state - evaluate_state - the evaluation
+ *   address - long - the address accessed
+ *   width - int - bytes accessed
+ *   frame - evaluate_frame ** - set to the frame the bytes are in
+ *
+ * Returns the offset of the bytes in the frame, or -1 if they are not all in
+ *   one, or the address is not aligned, so the access would fault
+ */
+static long evaluate_memory(struct evaluate_state *state, long address, int width, struct evaluate_frame **frame) {
+  long number, offset;
+
+  if (address < EVALUATE_FRAME_ADDRESS(0) || address % width != 0) {
+    return -1;
+  }
+  number = (address - EVALUATE_FRAME_ADDRESS(0)) / EVALUATE_MAX_FRAME;
+  offset = address - EVALUATE_FRAME_ADDRESS(number);
+  if (number >= state->depth || offset + width > state->frames[number].function->frame_size) {
+    return -1;
+  }
+  *frame = &state->frames[number];
+  return offset;
+}
+
+/* evaluate_load - reads memory, little end first as on the simulator
+ *
+ * Returns "true" if every byte read was written before
+ */
+static int evaluate_load(struct evaluate_state *state, int kind, long address, long *value) {
+  struct evaluate_frame *frame;
+  int width, i;
+  long offset;
+  uint32_t bits = 0;
+
+  switch (kind) {
+    case IR_LOAD_BYTE: case IR_LOAD_BYTE_U: width = 1; break;
+    case IR_LOAD_HALF_WORD: case IR_LOAD_HALF_WORD_U: width = 2; break;
+    default: width = 4; break;
+  }
+  offset = evaluate_memory(state, address, width, &frame);
+  if (offset < 0) {
+    return 0;
+  }
+  for (i = width - 1; i >= 0; i--) {
+    if (!frame->memory_set[offset + i]) {
+      return 0;
+    }
+    bits = (bits << 8) | frame->memory[offset + i];
+  }
+
+  switch (kind) {
+    case IR_LOAD_BYTE: *value = (int8_t)bits; break;
+    case IR_LOAD_HALF_WORD: *value = (int16_t)bits; break;
+    default: *value = evaluate_wrap(bits); break;
+  }
+  return 1;
+}
+
+/* evaluate_store - writes memory
+ *
+ * Returns "true" if the store would not fault
+ */
+static int evaluate_store(struct evaluate_state *state, int kind, long address, long value) {
+  struct evaluate_frame *frame;
+  int width, i;
+  long offset;
+
+  switch (kind) {
+    case IR_STORE_BYTE: width = 1; break;
+    case IR_STORE_HALF_WORD: width = 2; break;
+    default: width = 4; break;
+  }
+  offset = evaluate_memory(state, address, width, &frame);
+  if (offset < 0) {
+    return 0;
+  }
+  for (i = 0; i < width; i++) {
+    frame->memory[offset + i] = (unsigned char)((uint32_t)value >> (8 * i));
+    frame->memory_set[offset + i] = 1;
+  }
+  return 1;
+}
+
+/* evaluate_arithmetic - works out an operation with two operands, as the
+ *   machine instructions the back end picks for it would
+ *
+ * Returns "true" unless the operation would trap (add and sub on overflow) or
+ *   its result is undefined (division by zero)
+ */
+static int evaluate_arithmetic(int kind, long left, long right, long *result) {
+  int64_t a = left, b = right, value;
+
+  switch (kind) {
+    case IR_ADD: case IR_ADDI: value = a + b; break;
+    case IR_SUBTRACT: value = a - b; break;
+    case IR_ADDU: *result = evaluate_wrap(a + b); return 1;
+    case IR_SUBU: *result = evaluate_wrap(a - b); return 1;
+    case IR_MULTIPLY: case IR_MULU: *result = evaluate_wrap(a * b); return 1;
+    case IR_MULTIPLY_HIGH: *result = evaluate_wrap((a * b) >> 32); return 1;
+    case IR_MULTIPLY_HIGH_U:
+      *result = evaluate_wrap(((uint64_t)(uint32_t)a * (uint32_t)b) >> 32);
+      return 1;
+    case IR_DIVIDE: case IR_MOD:
+      if (b == 0 || (a == INT32_MIN && b == -1)) {
+        return 0;
+      }
+      *result = kind == IR_DIVIDE ? a / b : a % b;
+      return 1;
+    case IR_DIVU:
+      if (b == 0) {
+        return 0;
+      }
+      *result = evaluate_wrap((uint32_t)a / (uint32_t)b);
+      return 1;
+    case IR_SHIFT_LEFT: *result = evaluate_wrap((uint32_t)a << (b & 31)); return 1;
+    case IR_SHIFT_RIGHT: *result = (int32_t)a >> (b & 31); return 1;
+    case IR_SHIFT_RIGHT_U: *result = evaluate_wrap((uint32_t)a >> (b & 31)); return 1;
+    case IR_XOR: *result = a ^ b; return 1;
+    case IR_BIT_AND: *result = a & b; return 1;
+    case IR_BIT_OR: *result = a | b; return 1;
+    case IR_LESS: case IR_GOTO_IF_LESS: *result = a < b; return 1;
+    case IR_LESS_EQUAL: case IR_GOTO_IF_LESS_EQUAL: *result = a <= b; return 1;
+    case IR_GREATER: case IR_GOTO_IF_GREATER: *result = a > b; return 1;
+    case IR_GREATER_EQUAL: case IR_GOTO_IF_GREATER_EQUAL: *result = a >= b; return 1;
+    case IR_EQUAL: case IR_GOTO_IF_EQUAL: *result = a == b; return 1;
+    case IR_NOT_EQUAL: case IR_GOTO_IF_NOT_EQUAL: *result = a != b; return 1;
+    default: return 0;
+  }
+  if (value < INT32_MIN || value > INT32_MAX) {
+    return 0;
+  }
+  *result = value;
+  return 1;
+}
+
+/* evaluate_label - finds where a jump goes in a function, or NULL */
+static struct ir_instruction *evaluate_label(struct evaluate_function *function, char *label_name) {
+  struct ir_instruction *iter;
+
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter->kind == IR_LABEL && !strcmp(iter->operands[0].data.label_name, label_name)) {
+      return iter;
+    }
+  }
+  return NULL;
+}
+
+static int evaluate_call(struct evaluate_state *state, struct evaluate_function *function, long *arguments,
+                         int num_arguments, long *result, int *has_result);
+
+/* evaluate_run - runs the body of the function of the newest frame
+ *
+ * Parameters:
+ *   state - evaluate_state - the evaluation
+ *   result - long * - set to what it returns
+ *   has_result - int * - set to "true" if it returns a value
+ *
+ * Returns "true" if it returned
+ */
+static int evaluate_run(struct evaluate_state *state, long *result, int *has_result) {
+  struct evaluate_frame *frame = &state->frames[state->depth - 1];
+  struct evaluate_function *function = frame->function, *callee;
+  struct ir_instruction *iter, *target;
+  struct ir_jump_table *table;
+  long arguments[4], value, left, right, returned = 0;
+  int argument_set[4] = {0, 0, 0, 0}, returned_set = 0, i;
+
+  for (iter = function->begin->next; NULL != iter; iter = target) {
+    if (++state->steps > state->limit) {
+      return 0;
+    }
+    target = iter->next;
+
+    switch (iter->kind) {
+      case IR_NO_OPERATION:
+      case IR_SEQUENCE_PT:
+      case IR_LABEL:
+        break;
+
+      case IR_LOAD_IMMEDIATE:
+        evaluate_set(frame, &iter->operands[0], iter->operands[1].data.number);
+        break;
+
+      case IR_COPY:
+      case IR_BYTE_TO_HALF_WORD:
+      case IR_BYTE_TO_WORD:
+      case IR_HALF_WORD_TO_WORD:
+        if (!evaluate_get(frame, &iter->operands[1], &value)) {
+          return 0;
+        }
+        evaluate_set(frame, &iter->operands[0], value);
+        break;
+
+      case IR_WORD_TO_BYTE:
+      case IR_HALF_WORD_TO_BYTE:
+      case IR_WORD_TO_HALF_WORD:
+        if (!evaluate_get(frame, &iter->operands[1], &value)) {
+          return 0;
+        }
+        evaluate_set(frame, &iter->operands[0],
+                     iter->kind == IR_WORD_TO_HALF_WORD ? (int16_t)value : (int8_t)value);
+        break;
+
+      case IR_ADDRESS_OF:
+        evaluate_set(frame, &iter->operands[0], EVALUATE_FRAME_ADDRESS(state->depth - 1) + iter->operands[1].data.offset);
+        break;
+
+      case IR_LOG_NOT:
+      case IR_BIT_NOT:
+      case IR_MAKE_NEGATIVE:
+        if (!evaluate_get(frame, &iter->operands[1], &value)) {
+          return 0;
+        }
+        // neg is a sub from $zero, which traps on the most negative number
+        if (iter->kind == IR_MAKE_NEGATIVE && value == INT32_MIN) {
+          return 0;
+        }
+        evaluate_set(frame, &iter->operands[0],
+                     iter->kind == IR_LOG_NOT ? value == 0 : iter->kind == IR_BIT_NOT ? ~value : -value);
+        break;
+
+      case IR_MULTIPLY: case IR_DIVIDE: case IR_MOD: case IR_MULU: case IR_DIVU:
+      case IR_MULTIPLY_HIGH: case IR_MULTIPLY_HIGH_U:
+      case IR_ADD: case IR_SUBTRACT: case IR_ADDU: case IR_SUBU: case IR_ADDI:
+      case IR_SHIFT_LEFT: case IR_SHIFT_RIGHT: case IR_SHIFT_RIGHT_U:
+      case IR_XOR: case IR_BIT_AND: case IR_BIT_OR:
+      case IR_LESS: case IR_LESS_EQUAL: case IR_GREATER: case IR_GREATER_EQUAL:
+      case IR_EQUAL: case IR_NOT_EQUAL:
+        if (!evaluate_get(frame, &iter->operands[1], &left) || !evaluate_get(frame, &iter->operands[2], &right) ||
+            !evaluate_arithmetic(iter->kind, left, right, &value)) {
+          return 0;
+        }
+        evaluate_set(frame, &iter->operands[0], value);
+        break;
+
+      case IR_MOVE_IF_NOT_ZERO:
+      case IR_MOVE_IF_ZERO:
+        if (!evaluate_get(frame, &iter->operands[2], &right)) {
+          return 0;
+        }
+        if ((right != 0) == (iter->kind == IR_MOVE_IF_NOT_ZERO)) {
+          if (!evaluate_get(frame, &iter->operands[1], &value)) {
+            return 0;
+          }
+          evaluate_set(frame, &iter->operands[0], value);
+        }
+        break;
+
+      case IR_LOAD_BYTE:
+      case IR_LOAD_BYTE_U:
+      case IR_LOAD_HALF_WORD:
+      case IR_LOAD_HALF_WORD_U:
+      case IR_LOAD_WORD:
+        if (!evaluate_get(frame, &iter->operands[1], &left) || !evaluate_load(state, iter->kind, left, &value)) {
+          return 0;
+        }
+        evaluate_set(frame, &iter->operands[0], value);
+        break;
+
+      case IR_STORE_BYTE:
+      case IR_STORE_HALF_WORD:
+      case IR_STORE_WORD:
+        if (!evaluate_get(frame, &iter->operands[0], &value) || !evaluate_get(frame, &iter->operands[1], &left) ||
+            !evaluate_store(state, iter->kind, left, value)) {
+          return 0;
+        }
+        break;
+
+      case IR_PARAMETER:
+        i = (int)iter->operands[0].data.number;
+        if (i < 0 || i >= 4 || !evaluate_get(frame, &iter->operands[1], &arguments[i])) {
+          return 0;
+        }
+        argument_set[i] = 1;
+        break;
+
+      case IR_FUNCTION_CALL:
+        callee = evaluate_find(state->functions, iter->operands[0].data.label_name);
+        if (NULL == callee || !callee->pure) {
+          return 0;
+        }
+        for (i = 0; i < callee->num_params; i++) {
+          if (!argument_set[i]) {
+            return 0;
+          }
+        }
+        if (!evaluate_call(state, callee, arguments, callee->num_params, &returned, &returned_set)) {
+          return 0;
+        }
+        for (i = 0; i < 4; i++) {
+          argument_set[i] = 0;
+        }
+        break;
+
+      case IR_RESULT_WORD:
+      case IR_RESULT_BYTE:
+        if (!returned_set) {
+          return 0;
+        }
+        evaluate_set(frame, &iter->operands[0], returned);
+        break;
+
+      case IR_GOTO:
+        target = evaluate_label(function, iter->operands[0].data.label_name);
+        break;
+
+      case IR_GOTO_IF_FALSE:
+      case IR_GOTO_IF_TRUE:
+        if (!evaluate_get(frame, &iter->operands[0], &value)) {
+          return 0;
+        }
+        if ((value != 0) == (iter->kind == IR_GOTO_IF_TRUE)) {
+          target = evaluate_label(function, iter->operands[1].data.label_name);
+        }
+        break;
+
+      case IR_GOTO_IF_EQUAL: case IR_GOTO_IF_NOT_EQUAL:
+      case IR_GOTO_IF_LESS: case IR_GOTO_IF_LESS_EQUAL:
+      case IR_GOTO_IF_GREATER: case IR_GOTO_IF_GREATER_EQUAL:
+        if (!evaluate_get(frame, &iter->operands[0], &left) || !evaluate_get(frame, &iter->operands[1], &right)) {
+          return 0;
+        }
+        evaluate_arithmetic(iter->kind, left, right, &value);
+        if (value) {
+          target = evaluate_label(function, iter->operands[2].data.label_name);
+        }
+        break;
+
+      case IR_GOTO_TABLE:
+        table = ir_find_jump_table(iter->operands[1].data.label_name);
+        if (NULL == table || !evaluate_get(frame, &iter->operands[0], &value) || value < 0 || value >= table->count) {
+          return 0;
+        }
+        target = evaluate_label(function, table->targets[value]);
+        break;
+
+      case IR_RETURN:
+        if (!evaluate_get(frame, &iter->operands[0], &value)) {
+          return 0;
+        }
+        *result = value;
+        *has_result = 1;
+        break;
+
+      case IR_RETURN_VOID:
+        *has_result = 0;
+        break;
+
+      case IR_PROC_END:
+        return 1;
+
+      default:
+        // Output, tail calls, and anything the back end has no instruction for
+        return 0;
+    }
+    if (NULL == target) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/* evaluate_call - evaluates a call in a frame of its own
+ *
+ * Parameters:
+ *   state - evaluate_state - the evaluation
+ *   function - evaluate_function - the function called
+ *   arguments - long * - what is passed in $a0-$a3
+ *   num_arguments - int - how many there are
+ *   result - long * - set to what the function returns
+ *   has_result - int * - set to "true" if it returns a value
+ *
+ * Returns "true" if the call returned
+ */
+static int evaluate_call(struct evaluate_state *state, struct evaluate_function *function, long *arguments,
+                         int num_arguments, long *result, int *has_result) {
+  struct evaluate_frame *frame;
+  int returned, i, j;
+
+  if (state->depth == EVALUATE_MAX_DEPTH) {
+    return 0;
+  }
+  frame = &state->frames[state->depth++];
+  frame->function = function;
+  frame->temporaries = calloc(function->num_temporaries + 1, sizeof(long));
+  frame->temporary_set = calloc(function->num_temporaries + 1, 1);
+  frame->memory = calloc(function->frame_size + 1, 1);
+  frame->memory_set = calloc(function->frame_size + 1, 1);
+  assert(NULL != frame->temporaries && NULL != frame->temporary_set);
+  assert(NULL != frame->memory && NULL != frame->memory_set);
+
+  // The prologue puts the arguments in their home slots at the bottom of the frame
+  for (i = 0; i < num_arguments && i < 4 && (i + 1) * 4 <= function->frame_size; i++) {
+    for (j = 0; j < 4; j++) {
+      frame->memory[i * 4 + j] = (unsigned char)((uint32_t)arguments[i] >> (8 * j));
+      frame->memory_set[i * 4 + j] = 1;
+    }
+  }
+
+  *has_result = 0;
+  returned = evaluate_run(state, result, has_result);
+
+  free(frame->temporaries);
+  free(frame->temporary_set);
+  free(frame->memory);
+  free(frame->memory_set);
+  state->depth--;
+  return returned;
+}
+
+/*********************
+ * CALL SITES        *
+ *********************/
+
+/* evaluate_constant - finds the constant an argument is
+ *
+ * Parameters:
+ *   parameter - ir_instruction - the IR_PARAMETER passing the argument
+ *   limit - ir_instruction - where to stop looking back, the IR_PROC_BEGIN
+ *   definition - ir_instruction ** - set to the IR_LOAD_IMMEDIATE that loads it
+ *   value - long * - set to the constant
+ *
+ * Returns "true" if the argument is a constant loaded in straight-line code
+ *   before the parameter
+ */
+static int evaluate_constant(struct ir_instruction *parameter, struct ir_instruction *limit,
+                             struct ir_instruction **definition, long *value) {
+  struct ir_instruction *iter;
+  int temporary = parameter->operands[1].data.temporary;
+
+  for (iter = parameter->prev; NULL != iter && iter != limit && iter->kind != IR_LABEL; iter = iter->prev) {
+    if (iter->kind == IR_SEQUENCE_PT || iter->operands[0].kind != OPERAND_TEMPORARY ||
+        iter->operands[0].data.temporary != temporary) {
+      continue;
+    }
+    if (iter->kind != IR_LOAD_IMMEDIATE) {
+      return 0;
+    }
+    *definition = iter;
+    *value = evaluate_wrap(iter->operands[1].data.number);
+    return 1;
+  }
+  return 0;
+}
+
+/* evaluate_is_used - whether any instruction of a function but the one
+ *   defining a temporary mentions it
+ */
+static int evaluate_is_used(struct evaluate_function *function, struct ir_instruction *definition) {
+  struct ir_instruction *iter;
+  int temporary = definition->operands[0].data.temporary, i;
+
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter == definition || iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY && iter->operands[i].data.temporary == temporary) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* evaluate_call_site - replaces a call of a pure function with constant
+ *   arguments by its result, if it can be worked out
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   functions - evaluate_function - all functions
+ *   caller - evaluate_function - the function the call is in
+ *   call - ir_instruction - the IR_FUNCTION_CALL
+ *   budget - long * - steps left for the whole program, reduced by those taken
+ */
+static void evaluate_call_site(struct ir_section *section, struct evaluate_function *functions,
+                               struct evaluate_function *caller, struct ir_instruction *call, long *budget) {
+  struct evaluate_function *callee = evaluate_find(functions, call->operands[0].data.label_name);
+  struct ir_instruction *params[4] = {NULL, NULL, NULL, NULL}, *definitions[4], *result = call->next;
+  struct evaluate_state *state;
+  long arguments[4], value = 0;
+  int count = (int)call->operands[1].data.number, has_value, returned, i;
+
+  if (NULL == callee || !callee->pure || count != callee->num_params || count > 4 || *budget <= 0 ||
+      !ir_find_call_parameters(call, caller->begin, params)) {
+    return;
+  }
+  for (i = 0; i < count; i++) {
+    if (params[i]->operands[1].kind != OPERAND_TEMPORARY ||
+        !evaluate_constant(params[i], caller->begin, &definitions[i], &arguments[i])) {
+      return;
+    }
+  }
+
+  state = malloc(sizeof(struct evaluate_state));
+  assert(NULL != state);
+  state->functions = functions;
+  state->depth = 0;
+  state->steps = 0;
+  state->limit = *budget < EVALUATE_MAX_STEPS ? *budget : EVALUATE_MAX_STEPS;
+  returned = evaluate_call(state, callee, arguments, count, &value, &has_value);
+  *budget -= state->steps;
+  free(state);
+
+  if (NULL == result || (result->kind != IR_RESULT_WORD && result->kind != IR_RESULT_BYTE)) {
+    result = NULL;
+  }
+  if (!returned || (NULL != result && !has_value)) {
+    return;
+  }
+
+  // The call, its parameters, and the constants only they used all go
+  for (i = 0; i < count; i++) {
+    ir_remove(section, params[i]);
+  }
+  for (i = 0; i < count; i++) {
+    if (NULL != definitions[i]->prev && !evaluate_is_used(caller, definitions[i])) {
+      ir_remove(section, definitions[i]);
+    }
+  }
+  ir_remove(section, call);
+  if (NULL != result) {
+    result->kind = IR_LOAD_IMMEDIATE;
+    result->operands[1].kind = OPERAND_NUMBER;
+    result->operands[1].data.number = value;
+  }
+}
+
+/* evaluate_program - replaces calls of pure functions with constant arguments
+ *   by their results throughout the program
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void evaluate_program(struct ir_section *section) {
+  struct evaluate_function *functions, *function;
+  struct ir_instruction *iter, *next;
+  long budget = EVALUATE_MAX_TOTAL_STEPS;
+
+  if (!evaluate_enabled || NULL == section || NULL == section->first) {
+    return;
+  }
+
+  functions = evaluate_collect_functions(section);
+  evaluate_mark_pure(functions);
+
+  // A call folded in an argument leaves a constant for the call around it
+  for (function = functions; NULL != function; function = function->next) {
+    for (iter = function->begin; iter != function->end; iter = next) {
+      next = iter->next;
+      if (iter->kind == IR_FUNCTION_CALL) {
+        evaluate_call_site(section, functions, function, iter, &budget);
+      }
+    }
+  }
+
+  while (NULL != functions) {
+    function = functions->next;
+    free(functions);
+    functions = function;
+  }
+}
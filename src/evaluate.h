@@ -0,0 +1,19 @@
+#ifndef _EVALUATE_H
+#define _EVALUATE_H
+
+struct ir_section;
+
+/* IR instructions one call may run before it is left to run time */
+#define EVALUATE_MAX_STEPS        1000000
+/* ... and all the calls of a program together */
+#define EVALUATE_MAX_TOTAL_STEPS 10000000
+/* Calls one evaluation may nest */
+#define EVALUATE_MAX_DEPTH            256
+/* Largest frame an evaluated function may have, in bytes */
+#define EVALUATE_MAX_FRAME          65536
+
+void evaluate_program(struct ir_section *section);
+
+extern int evaluate_enabled;
+
+#endif
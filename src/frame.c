@@ -0,0 +1,411 @@
+/*
+ * frame.c
+ *
+ * Stack frame layout.  IR generation gives every local variable a slot of its
+ * own, sorted by alignment; once the function's IR exists this pass packs the
+ * slots again, sharing space between variables that are never live at the
+ * same time.
+ *
+ * A variable whose address is only ever used by a load or store next to the
+ * IR_ADDRESS_OF has a live range we can see: the instructions from its first
+ * access to its last, stretched over any loop it is touched in.  Variables
+ * with overlapping live ranges get disjoint slots, and the rest share.
+ *
+ * Anything else, arrays included, may be reached through a pointer for as long
+ * as its block is running, so it keeps its block as its lifetime: variables
+ * in sibling blocks share space, as the C standard allows.
+ *
+ * Variables that are never accessed take no space at all.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "ir.h"
+#include "cfg.h"
+#include "frame.h"
+
+int frame_layout_enabled = 1;
+int frame_report = 0;
+
+/* A function's frame size before and after layout, for the report */
+struct frame_record {
+  char *function;
+  int before, after;
+  struct frame_record *next;
+};
+
+static struct frame_record *records, *last_record;
+
+/* A backward jump, from the branch at position to to the label at from */
+struct frame_loop {
+  int from, to;
+};
+
+/* frame_align - rounds an offset up to an alignment */
+static int frame_align(int offset, int alignment) {
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+/* frame_tail_alignment - the alignment of the end of a slot, if it starts aligned */
+static int frame_tail_alignment(struct frame_slot *slot) {
+  int alignment = slot->alignment;
+
+  while (alignment > 1 && slot->size % alignment) {
+    alignment /= 2;
+  }
+  return alignment;
+}
+
+/* frame_compare - orders slots so that padding is only needed where a slot's
+ *   size is not a multiple of its alignment: most aligned first, and among
+ *   those the ones that leave the next slot aligned
+ */
+static int frame_compare(const void *left, const void *right) {
+  struct frame_slot *a = (struct frame_slot *)left, *b = (struct frame_slot *)right;
+
+  if (a->alignment != b->alignment) {
+    return b->alignment - a->alignment;
+  }
+  if (frame_tail_alignment(a) != frame_tail_alignment(b)) {
+    return frame_tail_alignment(b) - frame_tail_alignment(a);
+  }
+  // Keep the order stable so layouts don't change from run to run
+  return a->offset - b->offset;
+}
+
+/* frame_sort_slots - sorts slots into the order they should be laid out in
+ *
+ * Parameters:
+ *   slots - frame_slot - the slots, each with its offset set to a distinct
+ *                        number, used to break ties
+ *   count - int - how many there are
+ */
+void frame_sort_slots(struct frame_slot *slots, int count) {
+  qsort(slots, count, sizeof(struct frame_slot), frame_compare);
+}
+
+/* frame_find - the slot at an offset, or NULL */
+static struct frame_slot *frame_find(struct frame_slot *slots, int count, int offset) {
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (slots[i].offset == offset) {
+      return &slots[i];
+    }
+  }
+  return NULL;
+}
+
+/* frame_is_memory_access - whether an operand is the address of a load or store
+ *
+ * Parameters:
+ *   instruction - ir_instruction - the instruction
+ *   position - int - operand number
+ */
+static int frame_is_memory_access(struct ir_instruction *instruction, int position) {
+  switch (instruction->kind) {
+    case IR_LOAD_BYTE:
+    case IR_LOAD_BYTE_U:
+    case IR_LOAD_HALF_WORD:
+    case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_WORD:
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+      return position == 1;
+    default:
+      return 0;
+  }
+}
+
+/* frame_touch - notes an access to a slot at a position in the function */
+static void frame_touch(struct frame_slot *slot, int position) {
+  if (!slot->referenced) {
+    slot->referenced = 1;
+    slot->first = position;
+  }
+  slot->last = position;
+}
+
+/* frame_find_live_ranges - works out which slots are used, which have their
+ *   address escape and the live ranges of the rest
+ *
+ * Parameters:
+ *   begin, end - ir_instruction - the function's first and last instructions
+ *   slots - frame_slot - the function's slots
+ *   count - int - how many there are
+ *   base - int - offsets below this are not slots
+ */
+static void frame_find_live_ranges(struct ir_instruction *begin, struct ir_instruction *end,
+                                   struct frame_slot *slots, int count, int base) {
+  struct ir_instruction *iter;
+  struct frame_slot **address_of;
+  struct frame_slot *slot;
+  int max_temporary = 0, position, i;
+
+  for (iter = begin; iter != end->next; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY && iter->operands[i].data.temporary > max_temporary) {
+        max_temporary = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  address_of = calloc(max_temporary + 1, sizeof(struct frame_slot *));
+  assert(NULL != address_of);
+
+  for (iter = begin, position = 0; iter != end->next; iter = iter->next, position++) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      struct ir_operand *operand = &iter->operands[i];
+
+      if (operand->kind == OPERAND_LVALUE && operand->data.offset >= base &&
+          NULL != (slot = frame_find(slots, count, operand->data.offset))) {
+        frame_touch(slot, position);
+        if (iter->kind == IR_ADDRESS_OF && iter->operands[0].kind == OPERAND_TEMPORARY) {
+          address_of[iter->operands[0].data.temporary] = slot;
+        } else if (!frame_is_memory_access(iter, i)) {
+          slot->escapes = 1;
+        }
+      } else if (operand->kind == OPERAND_TEMPORARY && NULL != (slot = address_of[operand->data.temporary]) &&
+                 !(iter->kind == IR_ADDRESS_OF && i == 0)) {
+        frame_touch(slot, position);
+        if (!frame_is_memory_access(iter, i)) {
+          slot->escapes = 1;
+        }
+      }
+    }
+  }
+  free(address_of);
+}
+
+/* frame_stretch_over_loops - makes the live range of each slot that is used in
+ *   a loop cover the whole loop, since its value may be carried round
+ *
+ * Parameters:
+ *   begin, end - ir_instruction - the function's first and last instructions
+ *   slots - frame_slot - the function's slots
+ *   count - int - how many there are
+ */
+static void frame_stretch_over_loops(struct ir_instruction *begin, struct ir_instruction *end,
+                                     struct frame_slot *slots, int count) {
+  struct ir_instruction *iter, *target;
+  struct ir_operand *label;
+  struct frame_loop *loops = NULL;
+  int num_loops = 0, position, target_position, changed, i, j;
+
+  for (iter = begin, position = 0; iter != end->next; iter = iter->next, position++) {
+    if (NULL == (label = cfg_branch_label(iter))) {
+      continue;
+    }
+    for (target = begin, target_position = 0; target != iter; target = target->next, target_position++) {
+      if (target->kind == IR_LABEL && !strcmp(target->operands[0].data.label_name, label->data.label_name)) {
+        loops = realloc(loops, sizeof(struct frame_loop) * (num_loops + 1));
+        assert(NULL != loops);
+        loops[num_loops].from = target_position;
+        loops[num_loops].to = position;
+        num_loops++;
+        break;
+      }
+    }
+  }
+
+  // Loops can nest or overlap, so keep going until nothing changes
+  do {
+    changed = 0;
+    for (i = 0; i < count; i++) {
+      struct frame_slot *slot = &slots[i];
+      if (!slot->referenced || slot->escapes) {
+        continue;
+      }
+      for (j = 0; j < num_loops; j++) {
+        if (slot->first <= loops[j].to && slot->last >= loops[j].from &&
+            (slot->first > loops[j].from || slot->last < loops[j].to)) {
+          if (slot->first > loops[j].from) {
+            slot->first = loops[j].from;
+          }
+          if (slot->last < loops[j].to) {
+            slot->last = loops[j].to;
+          }
+          changed = 1;
+        }
+      }
+    }
+  } while (changed);
+  free(loops);
+}
+
+/* frame_place_scope - lays out the escaping slots of a block and, above them,
+ *   those of the blocks inside it, which all start at the same place
+ *
+ * Parameters:
+ *   slots - frame_slot - the function's slots, in layout order
+ *   count - int - how many there are
+ *   placed - int * - set to each slot's new offset
+ *   scope_parents - int * - the enclosing block of each block
+ *   scopes - int - how many blocks there are
+ *   scope - int - the block to lay out
+ *   start - int - where the block's slots begin
+ *   all - int - "true" to lay out every slot, as if they all escaped
+ *
+ * Returns the end of the block's slots and all of the blocks inside it
+ */
+static int frame_place_scope(struct frame_slot *slots, int count, int *placed, int *scope_parents, int scopes,
+                             int scope, int start, int all) {
+  int offset = start, top, end, i;
+
+  for (i = 0; i < count; i++) {
+    if (slots[i].scope == scope && (all || (slots[i].referenced && slots[i].escapes))) {
+      offset = frame_align(offset, slots[i].alignment);
+      placed[i] = offset;
+      offset += slots[i].size;
+    }
+  }
+
+  top = offset;
+  for (i = 0; i < scopes; i++) {
+    if (scope_parents[i] == scope) {
+      end = frame_place_scope(slots, count, placed, scope_parents, scopes, i, offset, all);
+      if (end > top) {
+        top = end;
+      }
+    }
+  }
+  return top;
+}
+
+/* frame_place_live_ranges - gives each slot with a known live range the lowest
+ *   offset that no slot live at the same time is using
+ *
+ * Parameters:
+ *   slots - frame_slot - the function's slots, in layout order
+ *   count - int - how many there are
+ *   placed - int * - set to each slot's new offset
+ *   start - int - the lowest offset to use
+ *
+ * Returns the end of the slots
+ */
+static int frame_place_live_ranges(struct frame_slot *slots, int count, int *placed, int start) {
+  int top = start, offset, i, j;
+
+  for (i = 0; i < count; i++) {
+    if (!slots[i].referenced || slots[i].escapes) {
+      continue;
+    }
+
+    offset = frame_align(start, slots[i].alignment);
+    for (j = 0; j < i; j++) {
+      if (slots[j].referenced && !slots[j].escapes &&
+          slots[j].first <= slots[i].last && slots[i].first <= slots[j].last &&
+          placed[j] < offset + slots[i].size && offset < placed[j] + slots[j].size) {
+        // Clashes; try just above it and check everything again
+        offset = frame_align(placed[j] + slots[j].size, slots[i].alignment);
+        j = -1;
+      }
+    }
+    placed[i] = offset;
+    if (offset + slots[i].size > top) {
+      top = offset + slots[i].size;
+    }
+  }
+  return top;
+}
+
+/* frame_layout - packs a function's slots and moves every access to them
+ *
+ * Parameters:
+ *   function - char * - the function's name, for the report
+ *   begin, end - ir_instruction - the function's first and last instructions
+ *   slots - frame_slot - the function's slots, each at a distinct offset and
+ *                        sorted by frame_sort_slots within its block
+ *   count - int - how many there are
+ *   scope_parents - int * - the enclosing block of each block, -1 for the
+ *                           function's outermost one
+ *   scopes - int - how many blocks there are
+ *   base - int - where slots start; everything below is fixed
+ *
+ * Returns the new end of the frame
+ */
+int frame_layout(char *function, struct ir_instruction *begin, struct ir_instruction *end,
+                 struct frame_slot *slots, int count, int *scope_parents, int scopes, int base) {
+  struct ir_instruction *iter;
+  struct frame_slot *slot;
+  struct frame_record *record;
+  int *placed;
+  int before = base, after = base, i;
+
+  placed = calloc(count + 1, sizeof(int));
+  assert(NULL != placed);
+  if (!frame_layout_enabled) {
+    for (i = 0; i < count; i++) {
+      if (slots[i].offset + slots[i].size > before) {
+        before = slots[i].offset + slots[i].size;
+      }
+    }
+    after = before;
+  } else {
+    frame_find_live_ranges(begin, end, slots, count, base);
+    frame_stretch_over_loops(begin, end, slots, count);
+
+    for (i = 0; i < scopes; i++) {
+      if (-1 == scope_parents[i]) {
+        // What the frame would take with only blocks sharing space, for the report
+        before = frame_place_scope(slots, count, placed, scope_parents, scopes, i, base, 1);
+        after = frame_place_scope(slots, count, placed, scope_parents, scopes, i, base, 0);
+      }
+    }
+    after = frame_place_live_ranges(slots, count, placed, after);
+  }
+
+  // Every operand is looked up by its old offset exactly once, so it doesn't
+  // matter that new offsets can match old ones
+  for (iter = begin; frame_layout_enabled && iter != end->next; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_LVALUE && iter->operands[i].data.offset >= base &&
+          NULL != (slot = frame_find(slots, count, iter->operands[i].data.offset))) {
+        iter->operands[i].data.offset = placed[slot - slots];
+      }
+    }
+  }
+  for (i = 0; frame_layout_enabled && i < count; i++) {
+    slots[i].offset = placed[i];
+  }
+  free(placed);
+
+  record = malloc(sizeof(struct frame_record));
+  assert(NULL != record);
+  record->function = function;
+  record->before = frame_align(before, 8);
+  record->after = frame_align(after, 8);
+  record->next = NULL;
+  if (NULL == last_record) {
+    records = record;
+  } else {
+    last_record->next = record;
+  }
+  last_record = record;
+
+  return after;
+}
+
+/* frame_print_report - lists each function's frame size with only variables in
+ *   different blocks sharing space, and after layout
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void frame_print_report(FILE *output) {
+  struct frame_record *iter;
+  int before = 0, after = 0;
+
+  for (iter = records; NULL != iter; iter = iter->next) {
+    fprintf(output, "%-20s %6d -> %6d bytes\n", iter->function, iter->before, iter->after);
+    before += iter->before;
+    after += iter->after;
+  }
+  fprintf(output, "%-20s %6d -> %6d bytes\n", "total", before, after);
+}
@@ -0,0 +1,32 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include <stdio.h>
+
+struct symbol;
+struct ir_instruction;
+
+/* A local variable's storage in the stack frame */
+struct frame_slot {
+  struct symbol *symbol;
+  int offset;
+  int size;
+  int alignment;
+  /* The block the variable is declared in; see frame_layout */
+  int scope;
+
+  /* Worked out by frame_layout */
+  int referenced;
+  int escapes;
+  int first, last;
+};
+
+void frame_sort_slots(struct frame_slot *slots, int count);
+int frame_layout(char *function, struct ir_instruction *begin, struct ir_instruction *end,
+                 struct frame_slot *slots, int count, int *scope_parents, int scopes, int base);
+void frame_print_report(FILE *output);
+
+extern int frame_layout_enabled;
+extern int frame_report;
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * ifconvert.c
+ *
+ * If-conversion.  A ?: whose two sides are short and cannot fault or have
+ * side effects is cheaper computed without a branch: both sides are worked
+ * out, and the condition picks between them with movn or movz.  Without those
+ * (they are MIPS IV), the choice is made with a mask of all ones or all zeros,
+ *
+ *     result = if_false ^ ((if_true ^ if_false) & -(condition != 0))
+ *
+ * The same goes for an if-else that assigns one variable in each branch, or
+ * an if that only assigns a variable, which become "v = c ? a : b" and
+ * "v = c ? a : v".  This is where min, max and absolute values come from.
+ *
+ * The decisions are made here, on the tree; ir.c generates the code.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "node.h"
+#include "symbol.h"
+#include "type.h"
+#include "ifconvert.h"
+
+int ifconvert_enabled = 1;
+int ifconvert_conditional_moves = 1;
+
+/* ifconvert_cost - how many instructions an expression takes, if it has no
+ *   side effects and nothing in it can fault or is slow
+ *
+ * Returns the count, or -1 if the expression cannot be computed speculatively
+ */
+static int ifconvert_cost(struct node *expression) {
+  int left, right;
+
+  switch (expression->kind) {
+    case NODE_NUMBER:
+      return 0 == expression->data.number.value ? 0 : 1;
+
+    case NODE_IDENTIFIER:
+      // Loading a variable cannot fault; an array's name is just its address
+      switch (expression->data.identifier.symbol->result.type->kind) {
+        case TYPE_BASIC: case TYPE_POINTER: case TYPE_ARRAY:
+          return 1;
+        default:
+          return -1;
+      }
+
+    case NODE_CAST:
+      return ifconvert_cost(expression->data.cast.cast);
+
+    case NODE_COMMA_LIST:
+      if (NULL != expression->data.comma_list.next) {
+        return -1;
+      }
+      return ifconvert_cost(expression->data.comma_list.data);
+
+    case NODE_UNARY_OPERATION:
+      // No dereferences: the pointer may only be valid on the other side
+      switch (expression->data.unary_operation.operation) {
+        case OP_MINUS: case OP_TILDE: case OP_EXCLAMATION:
+          left = ifconvert_cost(expression->data.unary_operation.operand);
+          return left < 0 ? -1 : left + 1;
+        case OP_PLUS:
+          return ifconvert_cost(expression->data.unary_operation.operand);
+        default:
+          return -1;
+      }
+
+    case NODE_BINARY_OPERATION:
+      // No assignments, no && or || (they branch), no division (it traps)
+      switch (expression->data.binary_operation.operation) {
+        case OP_PLUS: case OP_MINUS:
+        case OP_LESS_LESS: case OP_GREATER_GREATER:
+        case OP_AMPERSAND: case OP_VBAR: case OP_CARET:
+        case OP_LESS: case OP_LESS_EQUAL: case OP_GREATER: case OP_GREATER_EQUAL:
+        case OP_EQUAL_EQUAL: case OP_EXCLAMATION_EQUAL:
+          break;
+        default:
+          return -1;
+      }
+      left = ifconvert_cost(expression->data.binary_operation.left_operand);
+      right = ifconvert_cost(expression->data.binary_operation.right_operand);
+      if (left < 0 || right < 0) {
+        return -1;
+      }
+      return left + right + 1;
+
+    default:
+      return -1;
+  }
+}
+
+/* ifconvert_is_cheap - whether one side of a ?: can be computed whichever
+ *   side is taken
+ *
+ * Parameters:
+ *   expression - node - the side
+ *
+ * Returns "true" if it has no side effects, cannot fault, and is short
+ */
+int ifconvert_is_cheap(struct node *expression) {
+  int cost = ifconvert_cost(expression);
+  return cost >= 0 && cost <= IFCONVERT_MAX_ARM_COST;
+}
+
+/* ifconvert_condition - the value a converted ?: tests
+ *
+ * Parameters:
+ *   condition - node - the condition of the ?: or if
+ *   negated - int * - set to "true" if the side to take is the if_true one
+ *     when the value returned is zero
+ *
+ * Returns the expression to test, with any ! taken off, or NULL if the
+ *   condition is an && or || and so is only worth branching on
+ */
+struct node *ifconvert_condition(struct node *condition, int *negated) {
+  *negated = 0;
+  for (;;) {
+    if (NODE_COMMA_LIST == condition->kind && NULL == condition->data.comma_list.next) {
+      condition = condition->data.comma_list.data;
+    } else if (NODE_UNARY_OPERATION == condition->kind &&
+               OP_EXCLAMATION == condition->data.unary_operation.operation) {
+      condition = condition->data.unary_operation.operand;
+      *negated = !*negated;
+    } else {
+      break;
+    }
+  }
+  if (NODE_BINARY_OPERATION == condition->kind &&
+      (OP_AMPERSAND_AMPERSAND == condition->data.binary_operation.operation ||
+       OP_VBAR_VBAR == condition->data.binary_operation.operation)) {
+    return NULL;
+  }
+  return condition;
+}
+
+/* ifconvert_is_boolean - whether a condition's value is already 0 or 1 */
+int ifconvert_is_boolean(struct node *condition) {
+  if (NODE_BINARY_OPERATION != condition->kind) {
+    return 0;
+  }
+  switch (condition->data.binary_operation.operation) {
+    case OP_LESS: case OP_LESS_EQUAL: case OP_GREATER: case OP_GREATER_EQUAL:
+    case OP_EQUAL_EQUAL: case OP_EXCLAMATION_EQUAL:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* ifconvert_assignment - the assignment a branch of an if consists of
+ *
+ * Parameters:
+ *   statement - node - the branch, or NULL if there is none
+ *
+ * Returns the "v = expression" node, if the statement is just that (braces
+ *   and all) for a scalar variable v and a cheap expression, or NULL
+ */
+struct node *ifconvert_assignment(struct node *statement) {
+  struct node *expression, *left;
+
+  if (NULL == statement) {
+    return NULL;
+  }
+  if (NODE_COMPOUND == statement->kind) {
+    statement = statement->data.compound.statement_list;
+    if (NULL == statement || NULL != statement->data.statement_list.init) {
+      return NULL;
+    }
+    statement = statement->data.statement_list.statement;
+  }
+  if (NODE_EXPRESSION_STATEMENT != statement->kind) {
+    return NULL;
+  }
+
+  expression = statement->data.expression_statement.expression;
+  if (NODE_COMMA_LIST == expression->kind) {
+    if (NULL != expression->data.comma_list.next) {
+      return NULL;
+    }
+    expression = expression->data.comma_list.data;
+  }
+  if (NODE_BINARY_OPERATION != expression->kind || OP_EQUAL != expression->data.binary_operation.operation) {
+    return NULL;
+  }
+
+  left = expression->data.binary_operation.left_operand;
+  if (NODE_IDENTIFIER != left->kind) {
+    return NULL;
+  }
+  switch (left->data.identifier.symbol->result.type->kind) {
+    case TYPE_BASIC: case TYPE_POINTER:
+      break;
+    default:
+      return NULL;
+  }
+  if (!ifconvert_is_cheap(expression->data.binary_operation.right_operand)) {
+    return NULL;
+  }
+  return expression;
+}
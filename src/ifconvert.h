@@ -0,0 +1,18 @@
+#ifndef _IFCONVERT_H
+#define _IFCONVERT_H
+
+struct node;
+
+/* Each side of a converted ?: or if-else may take at most this many
+ * instructions, since both are always computed */
+#define IFCONVERT_MAX_ARM_COST  3
+
+int ifconvert_is_cheap(struct node *expression);
+struct node *ifconvert_condition(struct node *condition, int *negated);
+int ifconvert_is_boolean(struct node *condition);
+struct node *ifconvert_assignment(struct node *statement);
+
+extern int ifconvert_enabled;
+extern int ifconvert_conditional_moves;
+
+#endif
@@ -0,0 +1,726 @@
+/*
+ * inline.c
+ *
+ * IR-level function inliner.  Functions are found by their IR_PROC_BEGIN
+ * instructions, a call graph is built from the IR_FUNCTION_CALLs inside them,
+ * and small non-recursive callees are copied into their callers bottom-up.
+ *
+ * An inlined body keeps its own $fp-relative locals by moving them into a
+ * fresh area at the end of the caller's frame.  Its temporaries and labels
+ * are renamed, parameters become stores into the moved parameter slots and
+ * returns become a store of the value plus a jump to a continuation label.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "ir.h"
+#include "alias.h"
+#include "inline.h"
+#include "profile.h"
+
+int inline_enabled = 1;
+int inline_limit = INLINE_DEFAULT_LIMIT;
+int inline_caller_limit = INLINE_DEFAULT_CALLER_LIMIT;
+int inline_report = 0;
+
+struct inline_function {
+  char *name;
+  struct ir_instruction *begin;
+  struct ir_instruction *end;
+  int size;
+  int num_params;
+  int call_sites;
+  int recursive;
+  int tail_calls;
+  int visited;
+  struct inline_function *next;
+};
+
+struct inline_record {
+  char *caller;
+  char *callee;
+  int size;
+  struct inline_record *next;
+};
+
+struct inline_label_map {
+  char *from;
+  char *to;
+  struct inline_label_map *next;
+};
+
+static struct inline_record *records, *last_record;
+
+/*********************
+ * CALL GRAPH        *
+ *********************/
+
+/* inline_counts_toward_size - whether an instruction will turn into real code
+ *
+ * Parameters:
+ *   instruction - ir_instruction - the instruction to check
+ */
+static int inline_counts_toward_size(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_LABEL:
+    case IR_SEQUENCE_PT:
+    case IR_NO_OPERATION:
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+/* inline_find - looks up a function by name
+ *
+ * Parameters:
+ *   functions - inline_function - list of functions in the program
+ *   name - char * - name to look for
+ *
+ * Returns the function, or NULL if it is not defined in this program
+ */
+static struct inline_function *inline_find(struct inline_function *functions, char *name) {
+  for (; NULL != functions; functions = functions->next) {
+    if (!strcmp(functions->name, name)) {
+      return functions;
+    }
+  }
+  return NULL;
+}
+
+/* inline_measure - recomputes a function's size in IR instructions
+ *
+ * Parameters:
+ *   function - inline_function - the function to measure
+ */
+static void inline_measure(struct inline_function *function) {
+  struct ir_instruction *iter;
+  function->size = 0;
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    function->size += inline_counts_toward_size(iter);
+  }
+}
+
+/* inline_collect_functions - walks the program and records each function's extent
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Returns a list of functions in program order
+ */
+static struct inline_function *inline_collect_functions(struct ir_section *section) {
+  struct inline_function *functions = NULL, *last = NULL, *current = NULL;
+  struct ir_instruction *iter;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == IR_PROC_BEGIN) {
+      current = malloc(sizeof(struct inline_function));
+      assert(NULL != current);
+      current->name = iter->operands[0].data.label_name;
+      current->begin = iter;
+      current->end = iter;
+      current->num_params = (int)iter->operands[2].data.number;
+      current->call_sites = 0;
+      current->recursive = 0;
+      current->tail_calls = 0;
+      current->visited = 0;
+      current->next = NULL;
+      if (NULL == last) {
+        functions = current;
+      } else {
+        last->next = current;
+      }
+      last = current;
+    } else if (iter->kind == IR_PROC_END && NULL != current) {
+      current->end = iter;
+    } else if (iter->kind == IR_TAIL_CALL && NULL != current) {
+      current->end = iter;
+      current->tail_calls++;
+    }
+    if (iter == section->last) {
+      break;
+    }
+  }
+
+  for (current = functions; NULL != current; current = current->next) {
+    inline_measure(current);
+    for (iter = current->begin; iter != current->end->next; iter = iter->next) {
+      if (iter->kind == IR_FUNCTION_CALL) {
+        struct inline_function *callee = inline_find(functions, iter->operands[0].data.label_name);
+        if (NULL != callee) {
+          callee->call_sites++;
+        }
+      }
+    }
+  }
+  return functions;
+}
+
+/* inline_reaches - depth-first search of the call graph
+ *
+ * Parameters:
+ *   functions - inline_function - all functions
+ *   from - inline_function - where the search currently is
+ *   target - inline_function - the function being searched for
+ *
+ * Returns "true" if target can be called, directly or not, from from
+ */
+static int inline_reaches(struct inline_function *functions, struct inline_function *from,
+                          struct inline_function *target) {
+  struct ir_instruction *iter;
+  if (from->visited) {
+    return 0;
+  }
+  from->visited = 1;
+  for (iter = from->begin; iter != from->end->next; iter = iter->next) {
+    if (iter->kind == IR_FUNCTION_CALL) {
+      struct inline_function *callee = inline_find(functions, iter->operands[0].data.label_name);
+      if (NULL == callee) {
+        continue;
+      }
+      if (callee == target || inline_reaches(functions, callee, target)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* inline_mark_recursive - flags every function that sits on a call graph cycle
+ *
+ * Parameters:
+ *   functions - inline_function - all functions
+ */
+static void inline_mark_recursive(struct inline_function *functions) {
+  struct inline_function *function, *iter;
+  for (function = functions; NULL != function; function = function->next) {
+    for (iter = functions; NULL != iter; iter = iter->next) {
+      iter->visited = 0;
+    }
+    function->recursive = inline_reaches(functions, function, function);
+  }
+  for (iter = functions; NULL != iter; iter = iter->next) {
+    iter->visited = 0;
+  }
+}
+
+/* inline_post_order - orders functions so callees come before their callers
+ *
+ * Parameters:
+ *   functions - inline_function - all functions
+ *   function - inline_function - the function being visited
+ *   order - inline_function ** - array being filled in
+ *   count - int * - number of entries in order so far
+ */
+static void inline_post_order(struct inline_function *functions, struct inline_function *function,
+                              struct inline_function **order, int *count) {
+  struct ir_instruction *iter;
+  if (function->visited) {
+    return;
+  }
+  function->visited = 1;
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter->kind == IR_FUNCTION_CALL) {
+      struct inline_function *callee = inline_find(functions, iter->operands[0].data.label_name);
+      if (NULL != callee) {
+        inline_post_order(functions, callee, order, count);
+      }
+    }
+  }
+  order[(*count)++] = function;
+}
+
+/*********************
+ * CALL SITES        *
+ *********************/
+
+/* inline_region_start - finds the sequence point whose temporaries an instruction
+ *   belongs to
+ *
+ * Parameters:
+ *   instruction - ir_instruction - where to start looking backward
+ *
+ * Returns the sequence point, or NULL if the instruction precedes all of them
+ */
+static struct ir_instruction *inline_region_start(struct ir_instruction *instruction) {
+  struct ir_instruction *iter;
+  for (iter = instruction->prev; NULL != iter; iter = iter->prev) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      return iter;
+    }
+  }
+  return NULL;
+}
+
+/* inline_uses_temporary - checks whether an instruction mentions a temporary
+ *
+ * Parameters:
+ *   instruction - ir_instruction - instruction to check
+ *   temporary - int - temporary number
+ */
+static int inline_uses_temporary(struct ir_instruction *instruction, int temporary) {
+  int i;
+  if (instruction->kind == IR_SEQUENCE_PT) {
+    return 0;
+  }
+  for (i = 0; i < 3; i++) {
+    if (instruction->operands[i].kind == OPERAND_TEMPORARY &&
+        instruction->operands[i].data.temporary == temporary) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* inline_live_across - checks whether any of the caller's temporaries are
+ *   computed before the call and still needed after it.  Those would be held in
+ *   registers the inlined body is free to reuse.
+ *
+ * Parameters:
+ *   region - ir_instruction - sequence point starting the caller's statement
+ *   call - ir_instruction - the call being inlined
+ *   after - ir_instruction - last instruction belonging to the call
+ */
+static int inline_live_across(struct ir_instruction *region, struct ir_instruction *call,
+                              struct ir_instruction *after) {
+  struct ir_instruction *before, *later;
+  int i;
+
+  before = (NULL == region) ? call : region->next;
+  for (; before != call; before = before->next) {
+    if (before->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (before->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      for (later = after->next; NULL != later && later->kind != IR_SEQUENCE_PT; later = later->next) {
+        if (inline_uses_temporary(later, before->operands[i].data.temporary)) {
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/*********************
+ * COPYING BODIES    *
+ *********************/
+
+/* inline_map_label - renames a callee label for one inlined copy
+ *
+ * Parameters:
+ *   map - inline_label_map - labels defined in the callee and their new names
+ *   operand - ir_operand - a label operand to rename in place
+ */
+static void inline_map_label(struct inline_label_map *map, struct ir_operand *operand) {
+  for (; NULL != map; map = map->next) {
+    if (!strcmp(map->from, operand->data.label_name)) {
+      operand->data.label_name = map->to;
+      return;
+    }
+  }
+}
+
+/* inline_copy_instruction - clones a callee instruction, moving its locals,
+ *   temporaries and labels into the caller
+ *
+ * Parameters:
+ *   original - ir_instruction - the callee instruction
+ *   map - inline_label_map - label renaming
+ *   delta - int - added to every temporary
+ *   base - int - added to every $fp offset
+ *
+ * Returns the copy
+ */
+static struct ir_instruction *inline_copy_instruction(struct ir_instruction *original, struct inline_label_map *map,
+                                                      int delta, int base) {
+  struct ir_instruction *copy = ir_instruction(original->kind);
+  struct ir_jump_table *table;
+  char **targets;
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    copy->operands[i] = original->operands[i];
+    if (copy->operands[i].kind == OPERAND_TEMPORARY) {
+      copy->operands[i].data.temporary += delta;
+    } else if (copy->operands[i].kind == OPERAND_LVALUE) {
+      copy->operands[i].data.offset += base;
+    }
+  }
+  copy->alias = original->alias;
+  if (copy->alias.kind == ALIAS_FRAME) {
+    copy->alias.offset += base;
+  }
+
+  switch (copy->kind) {
+    case IR_LABEL:
+    case IR_GOTO:
+      inline_map_label(map, &copy->operands[0]);
+      break;
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      inline_map_label(map, &copy->operands[1]);
+      break;
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+      inline_map_label(map, &copy->operands[2]);
+      break;
+    case IR_GOTO_TABLE:
+      // The copy jumps through a copy of the table, to the copied labels
+      table = ir_find_jump_table(original->operands[1].data.label_name);
+      assert(NULL != table);
+      targets = malloc(sizeof(char *) * table->count);
+      assert(NULL != targets);
+      for (i = 0; i < table->count; i++) {
+        struct ir_operand target;
+        target.kind = OPERAND_LABEL;
+        target.data.label_name = table->targets[i];
+        inline_map_label(map, &target);
+        targets[i] = target.data.label_name;
+      }
+      ir_operand_label(copy, 1);
+      ir_add_jump_table(copy->operands[1].data.label_name, table->count, targets);
+      break;
+    default:
+      break;
+  }
+  return copy;
+}
+
+/* inline_goto - makes a jump to a label
+ *
+ * Parameters:
+ *   label - ir_instruction - the IR_LABEL to jump to
+ */
+static struct ir_instruction *inline_goto(struct ir_instruction *label) {
+  struct ir_instruction *jump = ir_instruction(IR_GOTO);
+  jump->operands[0] = label->operands[0];
+  return jump;
+}
+
+/* inline_lvalue - fills in an $fp-relative operand
+ *
+ * Parameters:
+ *   operand - ir_operand - the operand to fill in
+ *   offset - int - the frame offset
+ */
+static void inline_lvalue(struct ir_operand *operand, int offset) {
+  operand->kind = OPERAND_LVALUE;
+  operand->data.offset = offset;
+}
+
+/* inline_call_site - replaces one call with a copy of the callee's body
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   caller - inline_function - the function holding the call
+ *   callee - inline_function - the function being called
+ *   call - ir_instruction - the IR_FUNCTION_CALL
+ *   params - ir_instruction ** - the call's IR_PARAMETERs, by number
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void inline_call_site(struct ir_section *section, struct inline_function *caller, struct inline_function *callee,
+                             struct ir_instruction *call, struct ir_instruction **params) {
+  struct ir_instruction *region = inline_region_start(call);
+  struct ir_instruction *result = NULL;
+  struct ir_instruction *iter, *copy, *emitted = NULL;
+  struct inline_label_map *map = NULL;
+  int old_frame = (int)caller->begin->operands[1].data.number;
+  int base = ((old_frame + 7) / 8) * 8;
+  int grow = (((int)callee->begin->operands[1].data.number + 7) / 8) * 8;
+  int return_slot = base + 16;
+  int min_temporary = -1, max_temporary = -1, entry_temporary = -1;
+  int delta, i, seen_sequence_point = 0;
+
+  if (call->next->kind == IR_RESULT_WORD || call->next->kind == IR_RESULT_BYTE) {
+    result = call->next;
+  }
+
+  /* Temporaries of the callee get a fresh, equally spaced block of numbers. */
+  for (iter = callee->begin->next; iter != callee->end->next; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY) {
+        int temporary = iter->operands[i].data.temporary;
+        if (min_temporary < 0 || temporary < min_temporary) {
+          min_temporary = temporary;
+        }
+        if (temporary > max_temporary) {
+          max_temporary = temporary;
+        }
+        if (!seen_sequence_point && iter->kind != IR_SEQUENCE_PT &&
+            (entry_temporary < 0 || temporary < entry_temporary)) {
+          entry_temporary = temporary;
+        }
+      }
+    }
+    if (iter->kind == IR_SEQUENCE_PT) {
+      seen_sequence_point = 1;
+    }
+  }
+  if (min_temporary < 0) {
+    min_temporary = max_temporary = 0;
+  }
+  if (entry_temporary < 0) {
+    entry_temporary = min_temporary;
+  }
+  delta = ir_reserve_temporaries(max_temporary - min_temporary + 2) - min_temporary + 1;
+
+  /* Every label the callee defines gets a new name in this copy. */
+  for (iter = callee->begin->next; iter != callee->end->next; iter = iter->next) {
+    if (iter->kind == IR_LABEL) {
+      struct inline_label_map *entry = malloc(sizeof(struct inline_label_map));
+      struct ir_instruction *renamed = ir_instruction(IR_LABEL);
+      assert(NULL != entry);
+      ir_operand_label(renamed, 0);
+      entry->from = iter->operands[0].data.label_name;
+      entry->to = renamed->operands[0].data.label_name;
+      entry->next = map;
+      map = entry;
+    }
+  }
+
+  /* Arguments are stored straight into the callee's (moved) parameter slots. */
+  for (i = 0; i < callee->num_params; i++) {
+    struct ir_operand value = params[i]->operands[1];
+    params[i]->kind = IR_STORE_WORD;
+    params[i]->operands[0] = value;
+    inline_lvalue(&params[i]->operands[1], base + i * 4);
+  }
+
+  struct ir_instruction *continuation = ir_instruction(IR_LABEL);
+  ir_operand_label(continuation, 0);
+
+  /* Registers are numbered from the latest sequence point, so the body gets its own. */
+  struct ir_instruction *entry = ir_instruction(IR_SEQUENCE_PT);
+  entry->operands[0].kind = OPERAND_TEMPORARY;
+  entry->operands[0].data.temporary = entry_temporary + delta - 1;
+  ir_insert_before(section, call, entry);
+
+  for (iter = callee->begin->next; iter != callee->end->next; iter = iter->next) {
+    switch (iter->kind) {
+      case IR_RETURN:
+        if (NULL != result) {
+          copy = ir_instruction(IR_STORE_WORD);
+          copy->operands[0] = iter->operands[0];
+          copy->operands[0].data.temporary += delta;
+          inline_lvalue(&copy->operands[1], return_slot);
+          alias_set_frame(&copy->alias, return_slot, 4, 0);
+          ir_insert_before(section, call, copy);
+        }
+        emitted = inline_goto(continuation);
+        ir_insert_before(section, call, emitted);
+        break;
+
+      case IR_RETURN_VOID:
+        emitted = inline_goto(continuation);
+        ir_insert_before(section, call, emitted);
+        break;
+
+      case IR_PROC_END:
+        if (NULL == emitted || emitted->kind != IR_GOTO) {
+          emitted = inline_goto(continuation);
+          ir_insert_before(section, call, emitted);
+        }
+        break;
+
+      default:
+        emitted = inline_copy_instruction(iter, map, delta, base);
+        emitted->profile_count = profile_scale(iter->profile_count, call->profile_count,
+                                               callee->begin->profile_count);
+        ir_insert_before(section, call, emitted);
+        break;
+    }
+  }
+  ir_insert_before(section, call, continuation);
+
+  /* Back in the caller's statement: restore its register numbering. */
+  struct ir_instruction *restore = ir_instruction(IR_SEQUENCE_PT);
+  if (NULL != region) {
+    restore->operands[0] = region->operands[0];
+  } else {
+    restore->operands[0].kind = OPERAND_TEMPORARY;
+    restore->operands[0].data.temporary = -1;
+  }
+  ir_insert_before(section, call, restore);
+
+  if (NULL != result) {
+    result->kind = IR_LOAD_WORD;
+    inline_lvalue(&result->operands[1], return_slot);
+    alias_set_frame(&result->alias, return_slot, 4, 0);
+  }
+  ir_remove(section, call);
+
+  /* The caller's frame now also holds the callee's. */
+  for (iter = caller->begin; iter != caller->end->next; iter = iter->next) {
+    if (iter->kind == IR_PROC_BEGIN || iter->kind == IR_PROC_END) {
+      iter->operands[1].kind = OPERAND_NUMBER;
+      iter->operands[1].data.number = base + grow;
+    } else if (iter->kind == IR_TAIL_CALL) {
+      iter->operands[2].data.number = base + grow;
+    }
+  }
+
+  while (NULL != map) {
+    struct inline_label_map *next = map->next;
+    free(map);
+    map = next;
+  }
+}
+
+/* inline_should_inline - size/benefit heuristic for one call site
+ *
+ * Parameters:
+ *   caller - inline_function - function holding the call
+ *   callee - inline_function - function being called
+ *   call - ir_instruction - the IR_FUNCTION_CALL
+ */
+static int inline_should_inline(struct inline_function *caller, struct inline_function *callee,
+                                struct ir_instruction *call) {
+  int limit = inline_limit;
+
+  /* A tail call would tear down the caller's frame instead of the callee's. */
+  if (callee == caller || callee->recursive || callee->tail_calls > 0 || !strcmp(callee->name, "main")) {
+    return 0;
+  }
+  if (caller->size + callee->size > inline_caller_limit) {
+    return 0;
+  }
+  /* With a profile, calls that never ran aren't worth the space, and hot ones are worth more. */
+  if (0 == call->profile_count) {
+    return 0;
+  }
+  if (profile_is_hot(call->profile_count)) {
+    limit *= INLINE_HOT_FACTOR;
+  }
+  if (callee->size <= limit) {
+    return 1;
+  }
+  /* With only one caller, the out-of-line copy goes away entirely. */
+  return callee->call_sites == 1 && callee->size <= limit * INLINE_SINGLE_SITE_FACTOR;
+}
+
+/* inline_into - inlines every suitable call site in one function
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   functions - inline_function - all functions
+ *   caller - inline_function - the function to inline into
+ */
+static void inline_into(struct ir_section *section, struct inline_function *functions, struct inline_function *caller) {
+  struct ir_instruction *iter, *next;
+  struct ir_instruction *params[4];
+
+  for (iter = caller->begin; iter != caller->end->next; iter = next) {
+    next = iter->next;
+    if (iter->kind != IR_FUNCTION_CALL) {
+      continue;
+    }
+
+    struct inline_function *callee = inline_find(functions, iter->operands[0].data.label_name);
+    if (NULL == callee || callee->num_params > 4 || !inline_should_inline(caller, callee, iter)) {
+      continue;
+    }
+
+    memset(params, 0, sizeof(params));
+    if ((int)iter->operands[1].data.number != callee->num_params ||
+        !ir_find_call_parameters(iter, caller->begin, params)) {
+      continue;
+    }
+
+    struct ir_instruction *after = iter;
+    if (iter->next->kind == IR_RESULT_WORD || iter->next->kind == IR_RESULT_BYTE) {
+      after = iter->next;
+    }
+    if (inline_live_across(inline_region_start(iter), iter, after)) {
+      continue;
+    }
+
+    inline_call_site(section, caller, callee, iter, params);
+
+    struct inline_record *record = malloc(sizeof(struct inline_record));
+    assert(NULL != record);
+    record->caller = caller->name;
+    record->callee = callee->name;
+    record->size = callee->size;
+    record->next = NULL;
+    if (NULL == last_record) {
+      records = record;
+    } else {
+      last_record->next = record;
+    }
+    last_record = record;
+
+    callee->call_sites--;
+    inline_measure(caller);
+  }
+}
+
+/* inline_functions - runs the inliner over the whole program
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void inline_functions(struct ir_section *section) {
+  struct inline_function *functions, *iter;
+  struct inline_function **order;
+  int count = 0, i;
+
+  if (!inline_enabled || NULL == section || NULL == section->first) {
+    return;
+  }
+
+  functions = inline_collect_functions(section);
+  inline_mark_recursive(functions);
+
+  for (iter = functions; NULL != iter; iter = iter->next) {
+    count++;
+  }
+  order = malloc(sizeof(struct inline_function *) * (count + 1));
+  assert(NULL != order);
+  count = 0;
+  for (iter = functions; NULL != iter; iter = iter->next) {
+    inline_post_order(functions, iter, order, &count);
+  }
+
+  for (i = 0; i < count; i++) {
+    inline_into(section, functions, order[i]);
+  }
+
+  free(order);
+  while (NULL != functions) {
+    iter = functions->next;
+    free(functions);
+    functions = iter;
+  }
+}
+
+/* inline_print_report - lists every call site that was inlined
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void inline_print_report(FILE *output) {
+  struct inline_record *iter;
+  int count = 0;
+  for (iter = records; NULL != iter; iter = iter->next) {
+    fprintf(output, "inlined %-20s into %-20s (%d instructions)\n", iter->callee, iter->caller, iter->size);
+    count++;
+  }
+  fprintf(output, "%d call %s inlined.\n", count, (count == 1 ? "site" : "sites"));
+}
@@ -0,0 +1,25 @@
+#ifndef _INLINE_H
+#define _INLINE_H
+
+#include <stdio.h>
+
+struct ir_section;
+
+/* Largest callee, in IR instructions, that is inlined at every call site */
+#define INLINE_DEFAULT_LIMIT          40
+/* Callees with a single call site may be this many times larger */
+#define INLINE_SINGLE_SITE_FACTOR      3
+/* Call sites the profile shows to be hot may inline callees this many times larger */
+#define INLINE_HOT_FACTOR              4
+/* No caller is grown past this many IR instructions */
+#define INLINE_DEFAULT_CALLER_LIMIT 2000
+
+void inline_functions(struct ir_section *section);
+void inline_print_report(FILE *output);
+
+extern int inline_enabled;
+extern int inline_limit;
+extern int inline_caller_limit;
+extern int inline_report;
+
+#endif
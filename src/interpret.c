@@ -0,0 +1,1209 @@
+/*
+ * interpret.c
+ *
+ * Runs a program from its IR, for -s ir-run, without the MIPS back end.  The
+ * instruction lists are decoded first into an array of bytecode: labels become
+ * pointers to the code they mark, calls point at the function called, every
+ * temporary becomes a slot in the register window of the function's
+ * activation, and a constant operand becomes a slot the window is started
+ * with.  Each piece of code then holds the address of the code that runs it,
+ * and one goes straight on to the next with a computed goto (or, for
+ * compilers without one, a switch).
+ *
+ * Everything else is modelled the way the back end lays it out: IR_PROC_BEGIN
+ * takes a frame of the size it gives off the stack and puts the arguments in
+ * the first four words of it, IR_PARAMETER sets $a0-$a3 and IR_RETURN $v0, and
+ * file-scope objects and strings live in a data segment of their own.  Loads
+ * and stores check their addresses, and anything that would trap on the
+ * machine stops the run.  How many times each kind of IR instruction ran is
+ * kept for interpret_print_report.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "ir.h"
+#include "literal.h"
+#include "interpret.h"
+
+#ifdef __GNUC__
+#define INTERPRET_THREADED
+#endif
+
+/* What a piece of bytecode does; IR kinds the back end treats alike share one */
+#define INTERPRET_OP_UNSUPPORTED   0
+#define INTERPRET_OP_LI            1
+#define INTERPRET_OP_ADDRESS       2
+#define INTERPRET_OP_COPY          3
+#define INTERPRET_OP_TO_BYTE       4
+#define INTERPRET_OP_TO_HALF_WORD  5
+#define INTERPRET_OP_ADD           6
+#define INTERPRET_OP_SUB           7
+#define INTERPRET_OP_ADDU          8
+#define INTERPRET_OP_SUBU          9
+#define INTERPRET_OP_MUL          10
+#define INTERPRET_OP_MULH         11
+#define INTERPRET_OP_MULHU        12
+#define INTERPRET_OP_DIV          13
+#define INTERPRET_OP_MOD          14
+#define INTERPRET_OP_DIVU         15
+#define INTERPRET_OP_SLL          16
+#define INTERPRET_OP_SRA          17
+#define INTERPRET_OP_SRL          18
+#define INTERPRET_OP_XOR          19
+#define INTERPRET_OP_AND          20
+#define INTERPRET_OP_OR           21
+#define INTERPRET_OP_LT           22
+#define INTERPRET_OP_LE           23
+#define INTERPRET_OP_GT           24
+#define INTERPRET_OP_GE           25
+#define INTERPRET_OP_EQ           26
+#define INTERPRET_OP_NE           27
+#define INTERPRET_OP_LOG_NOT      28
+#define INTERPRET_OP_BIT_NOT      29
+#define INTERPRET_OP_NEG          30
+#define INTERPRET_OP_MOVN         31
+#define INTERPRET_OP_MOVZ         32
+#define INTERPRET_OP_LB           33
+#define INTERPRET_OP_LBU          34
+#define INTERPRET_OP_LH           35
+#define INTERPRET_OP_LHU          36
+#define INTERPRET_OP_LW           37
+#define INTERPRET_OP_SB           38
+#define INTERPRET_OP_SH           39
+#define INTERPRET_OP_SW           40
+#define INTERPRET_OP_GOTO         41
+#define INTERPRET_OP_BEQZ         42
+#define INTERPRET_OP_BNEZ         43
+#define INTERPRET_OP_BEQ          44
+#define INTERPRET_OP_BNE          45
+#define INTERPRET_OP_BLT          46
+#define INTERPRET_OP_BLE          47
+#define INTERPRET_OP_BGT          48
+#define INTERPRET_OP_BGE          49
+#define INTERPRET_OP_TABLE        50
+#define INTERPRET_OP_PARAM        51
+#define INTERPRET_OP_CALL         52
+#define INTERPRET_OP_TAIL         53
+/* A call of a function the program does not define */
+#define INTERPRET_OP_UNDEFINED    54
+#define INTERPRET_OP_RESULT       55
+#define INTERPRET_OP_RETURN       56
+#define INTERPRET_OP_ENTER        57
+#define INTERPRET_OP_LEAVE        58
+#define INTERPRET_OP_PRINT_NUMBER 59
+#define INTERPRET_OP_PRINT_STRING 60
+#define INTERPRET_OPS             61
+
+/* One more than the largest IR kind */
+#define INTERPRET_KINDS (IR_MOVE_IF_ZERO + 1)
+
+struct interpret_function;
+
+struct interpret_code {
+  /* Where the code that runs it is, once threaded */
+  const void *handler;
+  int op;
+  /* The IR kind it came from, for the counts */
+  int kind;
+  /* Slots in the register window */
+  int a, b, c;
+  /* A constant, a frame offset or a parameter number */
+  int32_t number;
+  struct interpret_code *target;
+  /* The entries of an IR_GOTO_TABLE, number of them */
+  struct interpret_code **table;
+  /* The function called, or the one an IR_PROC_BEGIN starts */
+  struct interpret_function *function;
+  char *label_name;
+};
+
+struct interpret_function {
+  char *name;
+  struct ir_instruction *begin;
+  struct ir_instruction *end;
+  int frame_size;
+  int num_params;
+  /* Its register window: the temporaries it uses, $fp, then the constants */
+  int first_temporary;
+  int num_temporaries;
+  int fp;
+  int32_t *constants;
+  int num_constants;
+  int window;
+  struct interpret_code *entry;
+  struct interpret_function *next;
+};
+
+struct interpret_label {
+  char *name;
+  int index;
+};
+
+/* A call in progress */
+struct interpret_activation {
+  struct interpret_code *return_pc;
+  struct interpret_function *function;
+  /* Where its register window starts */
+  int registers;
+};
+
+/* A data segment object the program takes the address of */
+struct interpret_object {
+  char *label;
+  uint32_t address;
+};
+
+struct interpret_machine {
+  unsigned char *stack;
+  unsigned char *data;
+  uint32_t data_size;
+  struct interpret_object *objects;
+  int num_objects;
+  int32_t *registers;
+  int registers_size;
+  int registers_top;
+  struct interpret_activation *activations;
+  int activations_size;
+  int depth;
+  int32_t arguments[4];
+  int32_t result;
+  uint32_t sp;
+};
+
+static struct interpret_machine interpret_machine;
+static struct interpret_code *interpret_code;
+static int interpret_code_len;
+static struct interpret_label *interpret_labels;
+static int interpret_labels_len;
+
+static long interpret_counts[INTERPRET_KINDS];
+static int interpret_exit_code;
+
+/*********************
+ * DATA SEGMENT      *
+ *********************/
+
+/* interpret_object_address - the address of a file-scope object or string,
+ *   laid out in the data segment the first time it is asked for
+ *
+ * Returns the address, or 0 if the label is neither
+ */
+static uint32_t interpret_object_address(char *label) {
+  struct interpret_machine *machine = &interpret_machine;
+  uint32_t offset, size = 0, alignment = 1;
+  char *contents = NULL;
+  int i, len;
+
+  for (i = 0; i < machine->num_objects; i++) {
+    if (!strcmp(machine->objects[i].label, label)) {
+      return machine->objects[i].address;
+    }
+  }
+
+  for (i = 0; i < ir_globals_len; i++) {
+    if (!strcmp(ir_globals[i].label, label)) {
+      size = ir_globals[i].size;
+      alignment = ir_globals[i].alignment > 0 ? ir_globals[i].alignment : 1;
+      break;
+    }
+  }
+  if (i == ir_globals_len) {
+    contents = literal_contents(label, &len);
+    if (NULL == contents) {
+      return 0;
+    }
+    size = len + 1;
+  }
+
+  offset = (machine->data_size + alignment - 1) / alignment * alignment;
+  machine->data = realloc(machine->data, offset + size + 1);
+  assert(NULL != machine->data);
+  memset(machine->data + machine->data_size, 0, offset + size - machine->data_size);
+  if (NULL != contents) {
+    memcpy(machine->data + offset, contents, size);
+  }
+  machine->data_size = offset + size;
+
+  machine->objects = realloc(machine->objects, sizeof(struct interpret_object) * (machine->num_objects + 1));
+  assert(NULL != machine->objects);
+  machine->objects[machine->num_objects].label = label;
+  machine->objects[machine->num_objects].address = INTERPRET_DATA_BASE + offset;
+  machine->num_objects++;
+  return INTERPRET_DATA_BASE + offset;
+}
+
+/* interpret_access - finds the bytes an access goes to
+ *
+ * Returns them, or NULL if the access would fault: the address is not
+ *   aligned, or not in the stack or the data segment
+ */
+static unsigned char *interpret_access(struct interpret_machine *machine, uint32_t address, uint32_t width) {
+  if (0 != (address & (width - 1))) {
+    return NULL;
+  }
+  if (address >= INTERPRET_STACK_TOP - INTERPRET_STACK_SIZE && address <= INTERPRET_STACK_TOP - width) {
+    return machine->stack + (address - (INTERPRET_STACK_TOP - INTERPRET_STACK_SIZE));
+  }
+  if (address >= INTERPRET_DATA_BASE && address - INTERPRET_DATA_BASE + width <= machine->data_size) {
+    return machine->data + (address - INTERPRET_DATA_BASE);
+  }
+  return NULL;
+}
+
+/*********************
+ * DECODING          *
+ *********************/
+
+/* interpret_measure - works out the range of temporaries a function uses */
+static void interpret_measure(struct interpret_function *function) {
+  struct ir_instruction *iter;
+  int low = -1, high = -1, i;
+
+  for (iter = function->begin; iter != function->end->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      if (low < 0 || iter->operands[i].data.temporary < low) {
+        low = iter->operands[i].data.temporary;
+      }
+      if (iter->operands[i].data.temporary > high) {
+        high = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  function->first_temporary = low < 0 ? 0 : low;
+  function->num_temporaries = low < 0 ? 0 : high - low + 1;
+  function->fp = function->num_temporaries;
+}
+
+/* interpret_collect_functions - walks the program and records each function's
+ *   extent, up to where the next one begins
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Returns a list of functions in program order
+ */
+static struct interpret_function *interpret_collect_functions(struct ir_section *section) {
+  struct interpret_function *functions = NULL, *last = NULL, *current = NULL;
+  struct ir_instruction *iter;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == IR_PROC_BEGIN) {
+      current = calloc(1, sizeof(struct interpret_function));
+      assert(NULL != current);
+      current->name = iter->operands[0].data.label_name;
+      current->begin = iter;
+      current->end = iter;
+      current->frame_size = (int)iter->operands[1].data.number;
+      current->num_params = (int)iter->operands[2].data.number;
+      if (NULL == last) {
+        functions = current;
+      } else {
+        last->next = current;
+      }
+      last = current;
+    } else if (NULL != current) {
+      // Block layout may move code past the last IR_PROC_END
+      current->end = iter;
+    }
+    if (iter == section->last) {
+      break;
+    }
+  }
+
+  for (current = functions; NULL != current; current = current->next) {
+    interpret_measure(current);
+  }
+  return functions;
+}
+
+/* interpret_find_function - looks up a function by name, or NULL */
+static struct interpret_function *interpret_find_function(struct interpret_function *functions, char *name) {
+  for (; NULL != functions; functions = functions->next) {
+    if (!strcmp(functions->name, name)) {
+      return functions;
+    }
+  }
+  return NULL;
+}
+
+/* interpret_emits - whether an instruction becomes a piece of bytecode; the
+ *   rest only mark places or tell the register allocator things
+ */
+static int interpret_emits(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_NO_OPERATION:
+    case IR_LABEL:
+    case IR_SEQUENCE_PT:
+    case IR_RETURN_VOID:
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+static int interpret_compare_labels(const void *left, const void *right) {
+  return strcmp(((const struct interpret_label *)left)->name, ((const struct interpret_label *)right)->name);
+}
+
+/* interpret_find_label - the code a label marks, or NULL */
+static struct interpret_code *interpret_find_label(char *name) {
+  struct interpret_label key, *found;
+
+  key.name = name;
+  found = bsearch(&key, interpret_labels, interpret_labels_len, sizeof(struct interpret_label),
+                  interpret_compare_labels);
+  return NULL == found ? NULL : &interpret_code[found->index];
+}
+
+/* interpret_slot - the register window slot of a temporary or a constant */
+static int interpret_slot(struct interpret_function *function, struct ir_operand *operand) {
+  int32_t value;
+  int i;
+
+  if (operand->kind == OPERAND_TEMPORARY) {
+    int slot = operand->data.temporary - function->first_temporary;
+
+    assert(slot >= 0 && slot < function->num_temporaries);
+    return slot;
+  }
+  assert(operand->kind == OPERAND_NUMBER);
+  value = (int32_t)operand->data.number;
+  for (i = 0; i < function->num_constants; i++) {
+    if (function->constants[i] == value) {
+      return function->fp + 1 + i;
+    }
+  }
+  function->constants = realloc(function->constants, sizeof(int32_t) * (function->num_constants + 1));
+  assert(NULL != function->constants);
+  function->constants[function->num_constants] = value;
+  return function->fp + 1 + function->num_constants++;
+}
+
+/* interpret_memory_operand - sets up the address of a load or store, a
+ *   temporary or an offset from $fp
+ */
+static void interpret_memory_operand(struct interpret_function *function, struct ir_operand *operand,
+                                     struct interpret_code *code) {
+  if (operand->kind == OPERAND_LVALUE) {
+    code->b = function->fp;
+    code->number = operand->data.offset;
+  } else {
+    code->b = interpret_slot(function, operand);
+    code->number = 0;
+  }
+}
+
+/* interpret_decode - turns one instruction into bytecode
+ *
+ * Parameters:
+ *   functions - interpret_function - all functions
+ *   function - interpret_function - the one the instruction is in
+ *   instruction - ir_instruction - the instruction
+ *   code - interpret_code - filled in
+ */
+static void interpret_decode(struct interpret_function *functions, struct interpret_function *function,
+                             struct ir_instruction *instruction, struct interpret_code *code) {
+  struct ir_operand *operands = instruction->operands;
+  struct ir_jump_table *table;
+  int i;
+
+  code->kind = instruction->kind;
+  switch (instruction->kind) {
+    case IR_LOAD_IMMEDIATE:
+      code->op = INTERPRET_OP_LI;
+      code->a = interpret_slot(function, &operands[0]);
+      code->number = (int32_t)operands[1].data.number;
+      return;
+
+    case IR_ADDRESS_OF:
+      code->a = interpret_slot(function, &operands[0]);
+      if (operands[1].kind == OPERAND_LVALUE) {
+        code->op = INTERPRET_OP_ADDRESS;
+        code->b = function->fp;
+        code->number = operands[1].data.offset;
+      } else {
+        code->op = INTERPRET_OP_LI;
+        code->number = (int32_t)interpret_object_address(operands[1].data.label_name);
+        if (0 == code->number) {
+          code->op = INTERPRET_OP_UNSUPPORTED;
+        }
+      }
+      return;
+
+    case IR_COPY:
+    case IR_MAKE_POSITIVE:
+    case IR_BYTE_TO_HALF_WORD:
+    case IR_BYTE_TO_WORD:
+    case IR_HALF_WORD_TO_WORD:
+    case IR_WORD_TO_BYTE:
+    case IR_HALF_WORD_TO_BYTE:
+    case IR_WORD_TO_HALF_WORD:
+    case IR_LOG_NOT:
+    case IR_BIT_NOT:
+    case IR_MAKE_NEGATIVE:
+      switch (instruction->kind) {
+        case IR_WORD_TO_BYTE: case IR_HALF_WORD_TO_BYTE: code->op = INTERPRET_OP_TO_BYTE; break;
+        case IR_WORD_TO_HALF_WORD: code->op = INTERPRET_OP_TO_HALF_WORD; break;
+        case IR_LOG_NOT: code->op = INTERPRET_OP_LOG_NOT; break;
+        case IR_BIT_NOT: code->op = INTERPRET_OP_BIT_NOT; break;
+        case IR_MAKE_NEGATIVE: code->op = INTERPRET_OP_NEG; break;
+        default: code->op = INTERPRET_OP_COPY; break;
+      }
+      code->a = interpret_slot(function, &operands[0]);
+      code->b = interpret_slot(function, &operands[1]);
+      return;
+
+    case IR_ADD: case IR_ADDI: code->op = INTERPRET_OP_ADD; break;
+    case IR_SUBTRACT: code->op = INTERPRET_OP_SUB; break;
+    case IR_ADDU: code->op = INTERPRET_OP_ADDU; break;
+    case IR_SUBU: code->op = INTERPRET_OP_SUBU; break;
+    case IR_MULTIPLY: case IR_MULU: code->op = INTERPRET_OP_MUL; break;
+    case IR_MULTIPLY_HIGH: code->op = INTERPRET_OP_MULH; break;
+    case IR_MULTIPLY_HIGH_U: code->op = INTERPRET_OP_MULHU; break;
+    case IR_DIVIDE: code->op = INTERPRET_OP_DIV; break;
+    case IR_MOD: code->op = INTERPRET_OP_MOD; break;
+    case IR_DIVU: code->op = INTERPRET_OP_DIVU; break;
+    case IR_SHIFT_LEFT: code->op = INTERPRET_OP_SLL; break;
+    case IR_SHIFT_RIGHT: code->op = INTERPRET_OP_SRA; break;
+    case IR_SHIFT_RIGHT_U: code->op = INTERPRET_OP_SRL; break;
+    case IR_XOR: code->op = INTERPRET_OP_XOR; break;
+    case IR_BIT_AND: code->op = INTERPRET_OP_AND; break;
+    case IR_BIT_OR: code->op = INTERPRET_OP_OR; break;
+    case IR_LESS: code->op = INTERPRET_OP_LT; break;
+    case IR_LESS_EQUAL: code->op = INTERPRET_OP_LE; break;
+    case IR_GREATER: code->op = INTERPRET_OP_GT; break;
+    case IR_GREATER_EQUAL: code->op = INTERPRET_OP_GE; break;
+    case IR_EQUAL: code->op = INTERPRET_OP_EQ; break;
+    case IR_NOT_EQUAL: code->op = INTERPRET_OP_NE; break;
+    case IR_MOVE_IF_NOT_ZERO: code->op = INTERPRET_OP_MOVN; break;
+    case IR_MOVE_IF_ZERO: code->op = INTERPRET_OP_MOVZ; break;
+
+    case IR_LOAD_BYTE:
+    case IR_LOAD_BYTE_U:
+    case IR_LOAD_HALF_WORD:
+    case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_WORD:
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+      switch (instruction->kind) {
+        case IR_LOAD_BYTE: code->op = INTERPRET_OP_LB; break;
+        case IR_LOAD_BYTE_U: code->op = INTERPRET_OP_LBU; break;
+        case IR_LOAD_HALF_WORD: code->op = INTERPRET_OP_LH; break;
+        case IR_LOAD_HALF_WORD_U: code->op = INTERPRET_OP_LHU; break;
+        case IR_LOAD_WORD: code->op = INTERPRET_OP_LW; break;
+        case IR_STORE_BYTE: code->op = INTERPRET_OP_SB; break;
+        case IR_STORE_HALF_WORD: code->op = INTERPRET_OP_SH; break;
+        default: code->op = INTERPRET_OP_SW; break;
+      }
+      code->a = interpret_slot(function, &operands[0]);
+      interpret_memory_operand(function, &operands[1], code);
+      return;
+
+    case IR_GOTO:
+      code->op = INTERPRET_OP_GOTO;
+      code->target = interpret_find_label(operands[0].data.label_name);
+      return;
+
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      code->op = instruction->kind == IR_GOTO_IF_FALSE ? INTERPRET_OP_BEQZ : INTERPRET_OP_BNEZ;
+      code->a = interpret_slot(function, &operands[0]);
+      code->target = interpret_find_label(operands[1].data.label_name);
+      return;
+
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+      code->op = INTERPRET_OP_BEQ + (instruction->kind - IR_GOTO_IF_EQUAL);
+      code->a = interpret_slot(function, &operands[0]);
+      code->b = interpret_slot(function, &operands[1]);
+      code->target = interpret_find_label(operands[2].data.label_name);
+      return;
+
+    case IR_GOTO_TABLE:
+      table = ir_find_jump_table(operands[1].data.label_name);
+      code->op = INTERPRET_OP_TABLE;
+      code->a = interpret_slot(function, &operands[0]);
+      if (NULL == table) {
+        code->op = INTERPRET_OP_UNSUPPORTED;
+        return;
+      }
+      code->number = table->count;
+      code->table = malloc(sizeof(struct interpret_code *) * (table->count + 1));
+      assert(NULL != code->table);
+      for (i = 0; i < table->count; i++) {
+        code->table[i] = interpret_find_label(table->targets[i]);
+        if (NULL == code->table[i]) {
+          code->op = INTERPRET_OP_UNSUPPORTED;
+        }
+      }
+      return;
+
+    case IR_PARAMETER:
+      code->op = INTERPRET_OP_PARAM;
+      code->number = (int32_t)operands[0].data.number;
+      code->b = interpret_slot(function, &operands[1]);
+      if (code->number < 0 || code->number >= 4) {
+        code->op = INTERPRET_OP_UNSUPPORTED;
+      }
+      return;
+
+    case IR_FUNCTION_CALL:
+    case IR_TAIL_CALL:
+      code->label_name = operands[0].data.label_name;
+      code->function = interpret_find_function(functions, code->label_name);
+      if (NULL == code->function) {
+        code->op = INTERPRET_OP_UNDEFINED;
+      } else {
+        code->op = instruction->kind == IR_TAIL_CALL ? INTERPRET_OP_TAIL : INTERPRET_OP_CALL;
+      }
+      return;
+
+    case IR_RESULT_WORD:
+    case IR_RESULT_BYTE:
+      code->op = INTERPRET_OP_RESULT;
+      code->a = interpret_slot(function, &operands[0]);
+      return;
+
+    case IR_RETURN:
+      code->op = INTERPRET_OP_RETURN;
+      code->a = interpret_slot(function, &operands[0]);
+      return;
+
+    case IR_PROC_BEGIN:
+      code->op = INTERPRET_OP_ENTER;
+      code->function = function;
+      return;
+
+    case IR_PROC_END:
+      code->op = INTERPRET_OP_LEAVE;
+      return;
+
+    case IR_PRINT_NUMBER:
+    case IR_PRINT_STRING:
+      code->op = instruction->kind == IR_PRINT_NUMBER ? INTERPRET_OP_PRINT_NUMBER : INTERPRET_OP_PRINT_STRING;
+      code->a = interpret_slot(function, &operands[0]);
+      return;
+
+    default:
+      code->op = INTERPRET_OP_UNSUPPORTED;
+      return;
+  }
+
+  // The operations with a result and two operands
+  code->a = interpret_slot(function, &operands[0]);
+  code->b = interpret_slot(function, &operands[1]);
+  code->c = interpret_slot(function, &operands[2]);
+}
+
+/* interpret_decode_program - turns the whole program into bytecode
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   functions - interpret_function - all functions
+ */
+static void interpret_decode_program(struct ir_section *section, struct interpret_function *functions) {
+  struct interpret_function *function, *next;
+  struct interpret_code *code = NULL;
+  struct ir_instruction *iter;
+  int index = 0, pass;
+
+  /* First for where each label goes and how much code there is, then to decode */
+  interpret_labels_len = 0;
+  for (pass = 0; pass < 2; pass++) {
+    function = NULL;
+    next = functions;
+    for (iter = section->first; NULL != iter; iter = iter->next) {
+      if (NULL != next && iter == next->begin) {
+        function = next;
+        next = next->next;
+        if (1 == pass) {
+          function->entry = code;
+        }
+      }
+      if (NULL == function) {
+        ;
+      } else if (0 == pass && iter->kind == IR_LABEL) {
+        interpret_labels = realloc(interpret_labels, sizeof(struct interpret_label) * (interpret_labels_len + 1));
+        assert(NULL != interpret_labels);
+        interpret_labels[interpret_labels_len].name = iter->operands[0].data.label_name;
+        interpret_labels[interpret_labels_len++].index = index;
+      } else if (0 == pass && interpret_emits(iter)) {
+        index++;
+      } else if (1 == pass && interpret_emits(iter)) {
+        interpret_decode(functions, function, iter, code);
+        if (INTERPRET_OP_GOTO <= code->op && code->op <= INTERPRET_OP_BGE && NULL == code->target) {
+          code->op = INTERPRET_OP_UNSUPPORTED;
+        }
+        code++;
+      }
+      if (NULL != function && iter == function->end) {
+        if (1 == pass) {
+          function->window = function->fp + 1 + function->num_constants;
+        }
+        function = NULL;
+      }
+      if (iter == section->last) {
+        break;
+      }
+    }
+
+    if (0 == pass) {
+      qsort(interpret_labels, interpret_labels_len, sizeof(struct interpret_label), interpret_compare_labels);
+      interpret_code_len = index;
+      interpret_code = calloc(interpret_code_len + 1, sizeof(struct interpret_code));
+      assert(NULL != interpret_code);
+      code = interpret_code;
+    }
+  }
+}
+
+/*********************
+ * EXECUTION         *
+ *********************/
+
+/* The code for a bytecode op, and how to go on to the next piece */
+#ifdef INTERPRET_THREADED
+#define INTERPRET_CASE(label, op) label:
+#define INTERPRET_DISPATCH() __extension__ ({ interpret_counts[pc->kind]++; goto *pc->handler; })
+#else
+#define INTERPRET_CASE(label, op) case op:
+#define INTERPRET_DISPATCH() goto dispatch
+#endif
+#define INTERPRET_NEXT() do { pc++; INTERPRET_DISPATCH(); } while (0)
+#define INTERPRET_JUMP(code) do { pc = (code); INTERPRET_DISPATCH(); } while (0)
+#define INTERPRET_FAULT(text) do { message = (text); goto fault; } while (0)
+
+/* The operations whose result is worked out from two registers without a fault */
+#define INTERPRET_BINARY(label, op, expression) \
+  INTERPRET_CASE(label, op) \
+    x = r[pc->b]; \
+    y = r[pc->c]; \
+    r[pc->a] = (int32_t)(expression); \
+    INTERPRET_NEXT();
+
+#define INTERPRET_BRANCH(label, op, condition) \
+  INTERPRET_CASE(label, op) \
+    x = r[pc->a]; \
+    y = r[pc->b]; \
+    if (condition) { \
+      INTERPRET_JUMP(pc->target); \
+    } \
+    INTERPRET_NEXT();
+
+/* interpret_run - runs the program from main
+ *
+ * Parameters:
+ *   output - FILE - where the program prints
+ *   main_function - interpret_function - main
+ *
+ * Returns 0 if main returned, or 1 if the program did something that would
+ *   trap, having said what
+ */
+static int interpret_run(FILE *output, struct interpret_function *main_function) {
+  struct interpret_machine *machine = &interpret_machine;
+  struct interpret_activation *activation;
+  struct interpret_function *function;
+  struct interpret_code *pc, *return_pc;
+  char *message;
+  int32_t *r = NULL, x, y;
+  int64_t wide;
+  uint32_t address;
+  unsigned char *p;
+  int i;
+
+#ifdef INTERPRET_THREADED
+  static const void *handlers[INTERPRET_OPS] = {
+    [INTERPRET_OP_UNSUPPORTED] = __extension__ &&op_unsupported,
+    [INTERPRET_OP_LI] = __extension__ &&op_li,
+    [INTERPRET_OP_ADDRESS] = __extension__ &&op_address,
+    [INTERPRET_OP_COPY] = __extension__ &&op_copy,
+    [INTERPRET_OP_TO_BYTE] = __extension__ &&op_to_byte,
+    [INTERPRET_OP_TO_HALF_WORD] = __extension__ &&op_to_half_word,
+    [INTERPRET_OP_ADD] = __extension__ &&op_add,
+    [INTERPRET_OP_SUB] = __extension__ &&op_sub,
+    [INTERPRET_OP_ADDU] = __extension__ &&op_addu,
+    [INTERPRET_OP_SUBU] = __extension__ &&op_subu,
+    [INTERPRET_OP_MUL] = __extension__ &&op_mul,
+    [INTERPRET_OP_MULH] = __extension__ &&op_mulh,
+    [INTERPRET_OP_MULHU] = __extension__ &&op_mulhu,
+    [INTERPRET_OP_DIV] = __extension__ &&op_div,
+    [INTERPRET_OP_MOD] = __extension__ &&op_mod,
+    [INTERPRET_OP_DIVU] = __extension__ &&op_divu,
+    [INTERPRET_OP_SLL] = __extension__ &&op_sll,
+    [INTERPRET_OP_SRA] = __extension__ &&op_sra,
+    [INTERPRET_OP_SRL] = __extension__ &&op_srl,
+    [INTERPRET_OP_XOR] = __extension__ &&op_xor,
+    [INTERPRET_OP_AND] = __extension__ &&op_and,
+    [INTERPRET_OP_OR] = __extension__ &&op_or,
+    [INTERPRET_OP_LT] = __extension__ &&op_lt,
+    [INTERPRET_OP_LE] = __extension__ &&op_le,
+    [INTERPRET_OP_GT] = __extension__ &&op_gt,
+    [INTERPRET_OP_GE] = __extension__ &&op_ge,
+    [INTERPRET_OP_EQ] = __extension__ &&op_eq,
+    [INTERPRET_OP_NE] = __extension__ &&op_ne,
+    [INTERPRET_OP_LOG_NOT] = __extension__ &&op_log_not,
+    [INTERPRET_OP_BIT_NOT] = __extension__ &&op_bit_not,
+    [INTERPRET_OP_NEG] = __extension__ &&op_neg,
+    [INTERPRET_OP_MOVN] = __extension__ &&op_movn,
+    [INTERPRET_OP_MOVZ] = __extension__ &&op_movz,
+    [INTERPRET_OP_LB] = __extension__ &&op_lb,
+    [INTERPRET_OP_LBU] = __extension__ &&op_lbu,
+    [INTERPRET_OP_LH] = __extension__ &&op_lh,
+    [INTERPRET_OP_LHU] = __extension__ &&op_lhu,
+    [INTERPRET_OP_LW] = __extension__ &&op_lw,
+    [INTERPRET_OP_SB] = __extension__ &&op_sb,
+    [INTERPRET_OP_SH] = __extension__ &&op_sh,
+    [INTERPRET_OP_SW] = __extension__ &&op_sw,
+    [INTERPRET_OP_GOTO] = __extension__ &&op_goto,
+    [INTERPRET_OP_BEQZ] = __extension__ &&op_beqz,
+    [INTERPRET_OP_BNEZ] = __extension__ &&op_bnez,
+    [INTERPRET_OP_BEQ] = __extension__ &&op_beq,
+    [INTERPRET_OP_BNE] = __extension__ &&op_bne,
+    [INTERPRET_OP_BLT] = __extension__ &&op_blt,
+    [INTERPRET_OP_BLE] = __extension__ &&op_ble,
+    [INTERPRET_OP_BGT] = __extension__ &&op_bgt,
+    [INTERPRET_OP_BGE] = __extension__ &&op_bge,
+    [INTERPRET_OP_TABLE] = __extension__ &&op_table,
+    [INTERPRET_OP_PARAM] = __extension__ &&op_param,
+    [INTERPRET_OP_CALL] = __extension__ &&op_call,
+    [INTERPRET_OP_TAIL] = __extension__ &&op_tail,
+    [INTERPRET_OP_UNDEFINED] = __extension__ &&op_undefined,
+    [INTERPRET_OP_RESULT] = __extension__ &&op_result,
+    [INTERPRET_OP_RETURN] = __extension__ &&op_return,
+    [INTERPRET_OP_ENTER] = __extension__ &&op_enter,
+    [INTERPRET_OP_LEAVE] = __extension__ &&op_leave,
+    [INTERPRET_OP_PRINT_NUMBER] = __extension__ &&op_print_number,
+    [INTERPRET_OP_PRINT_STRING] = __extension__ &&op_print_string
+  };
+
+  // Thread the code: each piece points at what runs it
+  for (i = 0; i < interpret_code_len; i++) {
+    interpret_code[i].handler = handlers[interpret_code[i].op];
+  }
+#endif
+
+  // main is called from nowhere; returning from it stops the run
+  machine->depth = 1;
+  machine->activations[0].return_pc = NULL;
+  pc = main_function->entry;
+  INTERPRET_DISPATCH();
+
+#ifndef INTERPRET_THREADED
+dispatch:
+  interpret_counts[pc->kind]++;
+  switch (pc->op) {
+#endif
+
+  INTERPRET_CASE(op_li, INTERPRET_OP_LI)
+    r[pc->a] = pc->number;
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_address, INTERPRET_OP_ADDRESS)
+    r[pc->a] = (int32_t)((uint32_t)r[pc->b] + (uint32_t)pc->number);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_copy, INTERPRET_OP_COPY)
+    r[pc->a] = r[pc->b];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_to_byte, INTERPRET_OP_TO_BYTE)
+    r[pc->a] = (int8_t)r[pc->b];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_to_half_word, INTERPRET_OP_TO_HALF_WORD)
+    r[pc->a] = (int16_t)r[pc->b];
+    INTERPRET_NEXT();
+
+  // add and sub trap on signed overflow
+  INTERPRET_CASE(op_add, INTERPRET_OP_ADD)
+    wide = (int64_t)r[pc->b] + r[pc->c];
+    if (wide != (int32_t)wide) {
+      INTERPRET_FAULT("arithmetic overflow");
+    }
+    r[pc->a] = (int32_t)wide;
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_sub, INTERPRET_OP_SUB)
+    wide = (int64_t)r[pc->b] - r[pc->c];
+    if (wide != (int32_t)wide) {
+      INTERPRET_FAULT("arithmetic overflow");
+    }
+    r[pc->a] = (int32_t)wide;
+    INTERPRET_NEXT();
+
+  INTERPRET_BINARY(op_addu, INTERPRET_OP_ADDU, (uint32_t)x + (uint32_t)y)
+  INTERPRET_BINARY(op_subu, INTERPRET_OP_SUBU, (uint32_t)x - (uint32_t)y)
+  INTERPRET_BINARY(op_mul, INTERPRET_OP_MUL, (uint32_t)x * (uint32_t)y)
+  INTERPRET_BINARY(op_mulh, INTERPRET_OP_MULH, ((int64_t)x * y) >> 32)
+  INTERPRET_BINARY(op_mulhu, INTERPRET_OP_MULHU, ((uint64_t)(uint32_t)x * (uint32_t)y) >> 32)
+  INTERPRET_BINARY(op_sll, INTERPRET_OP_SLL, (uint32_t)x << (y & 31))
+  INTERPRET_BINARY(op_sra, INTERPRET_OP_SRA, x >> (y & 31))
+  INTERPRET_BINARY(op_srl, INTERPRET_OP_SRL, (uint32_t)x >> (y & 31))
+  INTERPRET_BINARY(op_xor, INTERPRET_OP_XOR, x ^ y)
+  INTERPRET_BINARY(op_and, INTERPRET_OP_AND, x & y)
+  INTERPRET_BINARY(op_or, INTERPRET_OP_OR, x | y)
+  INTERPRET_BINARY(op_lt, INTERPRET_OP_LT, x < y)
+  INTERPRET_BINARY(op_le, INTERPRET_OP_LE, x <= y)
+  INTERPRET_BINARY(op_gt, INTERPRET_OP_GT, x > y)
+  INTERPRET_BINARY(op_ge, INTERPRET_OP_GE, x >= y)
+  INTERPRET_BINARY(op_eq, INTERPRET_OP_EQ, x == y)
+  INTERPRET_BINARY(op_ne, INTERPRET_OP_NE, x != y)
+
+  // The most negative number over -1 gives what div leaves in lo and hi
+  INTERPRET_CASE(op_div, INTERPRET_OP_DIV)
+    x = r[pc->b];
+    y = r[pc->c];
+    if (0 == y) {
+      INTERPRET_FAULT("division by zero");
+    }
+    r[pc->a] = (INT32_MIN == x && -1 == y) ? INT32_MIN : x / y;
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_mod, INTERPRET_OP_MOD)
+    x = r[pc->b];
+    y = r[pc->c];
+    if (0 == y) {
+      INTERPRET_FAULT("division by zero");
+    }
+    r[pc->a] = (INT32_MIN == x && -1 == y) ? 0 : x % y;
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_divu, INTERPRET_OP_DIVU)
+    y = r[pc->c];
+    if (0 == y) {
+      INTERPRET_FAULT("division by zero");
+    }
+    r[pc->a] = (int32_t)((uint32_t)r[pc->b] / (uint32_t)y);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_log_not, INTERPRET_OP_LOG_NOT)
+    r[pc->a] = 0 == r[pc->b];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_bit_not, INTERPRET_OP_BIT_NOT)
+    r[pc->a] = ~r[pc->b];
+    INTERPRET_NEXT();
+
+  // neg is a sub from $zero
+  INTERPRET_CASE(op_neg, INTERPRET_OP_NEG)
+    if (INT32_MIN == r[pc->b]) {
+      INTERPRET_FAULT("arithmetic overflow");
+    }
+    r[pc->a] = -r[pc->b];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_movn, INTERPRET_OP_MOVN)
+    if (0 != r[pc->c]) {
+      r[pc->a] = r[pc->b];
+    }
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_movz, INTERPRET_OP_MOVZ)
+    if (0 == r[pc->c]) {
+      r[pc->a] = r[pc->b];
+    }
+    INTERPRET_NEXT();
+
+  // Memory is little-endian, as on the simulator
+  INTERPRET_CASE(op_lb, INTERPRET_OP_LB)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 1))) {
+      goto fault_memory;
+    }
+    r[pc->a] = (int8_t)p[0];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_lbu, INTERPRET_OP_LBU)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 1))) {
+      goto fault_memory;
+    }
+    r[pc->a] = p[0];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_lh, INTERPRET_OP_LH)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 2))) {
+      goto fault_memory;
+    }
+    r[pc->a] = (int16_t)(p[0] | p[1] << 8);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_lhu, INTERPRET_OP_LHU)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 2))) {
+      goto fault_memory;
+    }
+    r[pc->a] = p[0] | p[1] << 8;
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_lw, INTERPRET_OP_LW)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 4))) {
+      goto fault_memory;
+    }
+    r[pc->a] = (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_sb, INTERPRET_OP_SB)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 1))) {
+      goto fault_memory;
+    }
+    p[0] = (unsigned char)r[pc->a];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_sh, INTERPRET_OP_SH)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 2))) {
+      goto fault_memory;
+    }
+    p[0] = (unsigned char)r[pc->a];
+    p[1] = (unsigned char)((uint32_t)r[pc->a] >> 8);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_sw, INTERPRET_OP_SW)
+    address = (uint32_t)r[pc->b] + (uint32_t)pc->number;
+    if (NULL == (p = interpret_access(machine, address, 4))) {
+      goto fault_memory;
+    }
+    p[0] = (unsigned char)r[pc->a];
+    p[1] = (unsigned char)((uint32_t)r[pc->a] >> 8);
+    p[2] = (unsigned char)((uint32_t)r[pc->a] >> 16);
+    p[3] = (unsigned char)((uint32_t)r[pc->a] >> 24);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_goto, INTERPRET_OP_GOTO)
+    INTERPRET_JUMP(pc->target);
+
+  INTERPRET_CASE(op_beqz, INTERPRET_OP_BEQZ)
+    if (0 == r[pc->a]) {
+      INTERPRET_JUMP(pc->target);
+    }
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_bnez, INTERPRET_OP_BNEZ)
+    if (0 != r[pc->a]) {
+      INTERPRET_JUMP(pc->target);
+    }
+    INTERPRET_NEXT();
+
+  INTERPRET_BRANCH(op_beq, INTERPRET_OP_BEQ, x == y)
+  INTERPRET_BRANCH(op_bne, INTERPRET_OP_BNE, x != y)
+  INTERPRET_BRANCH(op_blt, INTERPRET_OP_BLT, x < y)
+  INTERPRET_BRANCH(op_ble, INTERPRET_OP_BLE, x <= y)
+  INTERPRET_BRANCH(op_bgt, INTERPRET_OP_BGT, x > y)
+  INTERPRET_BRANCH(op_bge, INTERPRET_OP_BGE, x >= y)
+
+  INTERPRET_CASE(op_table, INTERPRET_OP_TABLE)
+    if ((uint32_t)r[pc->a] >= (uint32_t)pc->number) {
+      INTERPRET_FAULT("jump table entry out of range");
+    }
+    INTERPRET_JUMP(pc->table[r[pc->a]]);
+
+  INTERPRET_CASE(op_param, INTERPRET_OP_PARAM)
+    machine->arguments[pc->number] = r[pc->b];
+    INTERPRET_NEXT();
+
+  // A call saves where to come back to; IR_PROC_BEGIN does the rest
+  INTERPRET_CASE(op_call, INTERPRET_OP_CALL)
+    if (machine->depth == machine->activations_size) {
+      machine->activations_size *= 2;
+      machine->activations = realloc(machine->activations,
+                                     sizeof(struct interpret_activation) * machine->activations_size);
+      assert(NULL != machine->activations);
+    }
+    machine->activations[machine->depth++].return_pc = pc + 1;
+    INTERPRET_JUMP(pc->function->entry);
+
+  // A tail call gives up the frame first, so the callee returns to our caller
+  INTERPRET_CASE(op_tail, INTERPRET_OP_TAIL)
+    activation = &machine->activations[machine->depth - 1];
+    machine->sp += activation->function->frame_size;
+    machine->registers_top = activation->registers;
+    INTERPRET_JUMP(pc->function->entry);
+
+  INTERPRET_CASE(op_result, INTERPRET_OP_RESULT)
+    r[pc->a] = machine->result;
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_return, INTERPRET_OP_RETURN)
+    machine->result = r[pc->a];
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_enter, INTERPRET_OP_ENTER)
+    function = pc->function;
+    activation = &machine->activations[machine->depth - 1];
+    activation->function = function;
+    if (machine->sp - (INTERPRET_STACK_TOP - INTERPRET_STACK_SIZE) < (uint32_t)function->frame_size) {
+      INTERPRET_FAULT("stack overflow");
+    }
+    machine->sp -= function->frame_size;
+
+    if (machine->registers_top + function->window > machine->registers_size) {
+      while (machine->registers_top + function->window > machine->registers_size) {
+        machine->registers_size *= 2;
+      }
+      machine->registers = realloc(machine->registers, sizeof(int32_t) * machine->registers_size);
+      assert(NULL != machine->registers);
+    }
+    activation->registers = machine->registers_top;
+    r = machine->registers + machine->registers_top;
+    machine->registers_top += function->window;
+    r[function->fp] = (int32_t)machine->sp;
+    memcpy(r + function->fp + 1, function->constants, sizeof(int32_t) * function->num_constants);
+
+    // The arguments go into their home slots at the bottom of the frame
+    for (i = 0; i < function->num_params && i < 4 && (i + 1) * 4 <= function->frame_size; i++) {
+      p = machine->stack + (machine->sp + i * 4 - (INTERPRET_STACK_TOP - INTERPRET_STACK_SIZE));
+      p[0] = (unsigned char)machine->arguments[i];
+      p[1] = (unsigned char)((uint32_t)machine->arguments[i] >> 8);
+      p[2] = (unsigned char)((uint32_t)machine->arguments[i] >> 16);
+      p[3] = (unsigned char)((uint32_t)machine->arguments[i] >> 24);
+    }
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_leave, INTERPRET_OP_LEAVE)
+    activation = &machine->activations[--machine->depth];
+    machine->sp += activation->function->frame_size;
+    machine->registers_top = activation->registers;
+    return_pc = activation->return_pc;
+    if (NULL == return_pc) {
+      interpret_exit_code = machine->result;
+      return 0;
+    }
+    r = machine->registers + machine->activations[machine->depth - 1].registers;
+    INTERPRET_JUMP(return_pc);
+
+  INTERPRET_CASE(op_print_number, INTERPRET_OP_PRINT_NUMBER)
+    fprintf(output, "%d", r[pc->a]);
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_print_string, INTERPRET_OP_PRINT_STRING)
+    for (address = (uint32_t)r[pc->a];; address++) {
+      if (NULL == (p = interpret_access(machine, address, 1))) {
+        goto fault_memory;
+      }
+      if (0 == p[0]) {
+        break;
+      }
+      fputc(p[0], output);
+    }
+    INTERPRET_NEXT();
+
+  INTERPRET_CASE(op_undefined, INTERPRET_OP_UNDEFINED)
+    fprintf(output, "\nIR run: call of undefined function %s\n", pc->label_name);
+    return 1;
+
+  INTERPRET_CASE(op_unsupported, INTERPRET_OP_UNSUPPORTED)
+    fprintf(output, "\nIR run: cannot run %s in %s\n", ir_opcode_name(pc->kind),
+            machine->activations[machine->depth - 1].function->name);
+    return 1;
+
+#ifndef INTERPRET_THREADED
+  default:
+    INTERPRET_FAULT("unknown bytecode");
+  }
+#endif
+
+fault_memory:
+  fprintf(output, "\nIR run: bad address 0x%08lx in %s\n", (unsigned long)address,
+          machine->activations[machine->depth - 1].function->name);
+  return 1;
+
+fault:
+  fprintf(output, "\nIR run: %s in %s\n", message, machine->activations[machine->depth - 1].function->name);
+  return 1;
+}
+
+/* interpret_program - runs a program from its IR
+ *
+ * Parameters:
+ *   output - FILE - where the program prints, and where any fault is reported
+ *   section - ir_section - the whole program
+ *
+ * Returns 0 if main returned, or 1 if it could not be run to the end
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+int interpret_program(FILE *output, struct ir_section *section) {
+  struct interpret_machine *machine = &interpret_machine;
+  struct interpret_function *functions, *main_function;
+  int result;
+
+  memset(interpret_counts, 0, sizeof(interpret_counts));
+  interpret_exit_code = 0;
+  if (NULL == section || NULL == section->first) {
+    fprintf(output, "IR run: no program\n");
+    return 1;
+  }
+  functions = interpret_collect_functions(section);
+  main_function = interpret_find_function(functions, "main");
+  if (NULL == main_function) {
+    fprintf(output, "IR run: no main\n");
+    return 1;
+  }
+  interpret_decode_program(section, functions);
+
+  machine->stack = calloc(INTERPRET_STACK_SIZE, 1);
+  machine->registers_size = 1024;
+  machine->registers = malloc(sizeof(int32_t) * machine->registers_size);
+  machine->activations_size = 64;
+  machine->activations = malloc(sizeof(struct interpret_activation) * machine->activations_size);
+  assert(NULL != machine->stack && NULL != machine->registers && NULL != machine->activations);
+  machine->registers_top = 0;
+  machine->sp = INTERPRET_STACK_TOP;
+
+  result = interpret_run(output, main_function);
+  fflush(output);
+
+  free(machine->stack);
+  free(machine->registers);
+  free(machine->activations);
+  return result;
+}
+
+/* interpret_print_report - prints how many times each kind of IR instruction
+ *   ran, most first
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void interpret_print_report(FILE *output) {
+  int order[INTERPRET_KINDS], count = 0, i, j, kind;
+  long total = 0;
+
+  for (kind = 1; kind < INTERPRET_KINDS; kind++) {
+    if (0 == interpret_counts[kind]) {
+      continue;
+    }
+    total += interpret_counts[kind];
+    for (i = count++; i > 0 && interpret_counts[order[i - 1]] < interpret_counts[kind]; i--) {
+      order[i] = order[i - 1];
+    }
+    order[i] = kind;
+  }
+
+  for (j = 0; j < count; j++) {
+    fprintf(output, "%-10s %12ld  %5.1f%%\n", ir_opcode_name(order[j]), interpret_counts[order[j]],
+            100.0 * interpret_counts[order[j]] / total);
+  }
+  fprintf(output, "%-10s %12ld\n", "total", total);
+  fprintf(output, "exit code  %12d\n", interpret_exit_code);
+}
@@ -0,0 +1,17 @@
+#ifndef _INTERPRET_H
+#define _INTERPRET_H
+
+#include <stdio.h>
+
+struct ir_section;
+
+/* Where memory is, as the program sees it: file-scope objects and strings
+ * from the start of the data segment, and the stack down from its top */
+#define INTERPRET_DATA_BASE   0x10010000u
+#define INTERPRET_STACK_TOP   0x7ffff000u
+#define INTERPRET_STACK_SIZE  (4u << 20)
+
+int interpret_program(FILE *output, struct ir_section *section);
+void interpret_print_report(FILE *output);
+
+#endif
@@ -3,15 +3,56 @@
 #include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 
 #include "node.h"
 #include "symbol.h"
 #include "type.h"
 #include "ir.h"
+#include "multiply.h"
+#include "divide.h"
+#include "literal.h"
+#include "frame.h"
+#include "alias.h"
+#include "switch.h"
+#include "ifconvert.h"
+#include "vectorize.h"
+#include "pass.h"
 
 int ir_generation_num_errors;
-char *string_labels[1000];
-int string_labels_len = 0;
+/* Every IR instruction ever made, for the pass manager's counters */
+long ir_instructions_made;
+struct ir_global *ir_globals;
+int ir_globals_len = 0;
+struct ir_jump_table *ir_jump_tables;
+int ir_jump_tables_len = 0;
+
+static int next_temporary;
+
+/*
+ * The temporary of the last sequence point numbered.  mips.c gives each
+ * temporary after a sequence point the register as far on from $t0 as the
+ * temporary is from it, and there are IR_WINDOW_SIZE of them, up to $s7.
+ */
+#define IR_WINDOW_SIZE 16
+static int window_base;
+
+/*
+ * Divisions by constants since the last sequence point.  Each is a div until
+ * the next sequence point is numbered, when it is known how many registers
+ * the rest of the statement left, and is then turned into the steps from
+ * divide_plan if they fit.
+ */
+struct ir_division {
+  struct ir_instruction *immediate, *division;
+  long divisor;
+  int is_unsigned;
+  struct ir_division *next;
+};
+static struct ir_division *divisions;
+static struct ir_division **last_division = &divisions;
+
+static void ir_expand_divisions(void);
 
 
 
@@ -81,8 +122,12 @@ struct ir_instruction *ir_instruction(int kind) {
 
   instruction = malloc(sizeof(struct ir_instruction));
   assert(NULL != instruction);
+  ir_instructions_made++;
 
   instruction->kind = kind;
+  memset(instruction->operands, 0, sizeof(instruction->operands));
+  instruction->profile_count = -1;
+  memset(&instruction->alias, 0, sizeof(instruction->alias));
 
   instruction->next = NULL;
   instruction->prev = NULL;
@@ -90,45 +135,156 @@ struct ir_instruction *ir_instruction(int kind) {
   return instruction;
 }
 
+/* ir_insert_before - links an instruction into a section just ahead of another
+ *
+ * Parameters:
+ *   section - ir_section - the section holding position
+ *   position - ir_instruction - the instruction to insert in front of
+ *   instruction - ir_instruction - the new instruction
+ */
+void ir_insert_before(struct ir_section *section, struct ir_instruction *position, struct ir_instruction *instruction) {
+  instruction->prev = position->prev;
+  instruction->next = position;
+  if (NULL != position->prev) {
+    position->prev->next = instruction;
+  }
+  position->prev = instruction;
+  if (section->first == position) {
+    section->first = instruction;
+  }
+}
+
+/* ir_insert_after - links an instruction into a section just behind another
+ *
+ * Parameters:
+ *   section - ir_section - the section holding position
+ *   position - ir_instruction - the instruction to insert behind
+ *   instruction - ir_instruction - the new instruction
+ */
+void ir_insert_after(struct ir_section *section, struct ir_instruction *position, struct ir_instruction *instruction) {
+  instruction->next = position->next;
+  instruction->prev = position;
+  if (NULL != position->next) {
+    position->next->prev = instruction;
+  }
+  position->next = instruction;
+  if (section->last == position) {
+    section->last = instruction;
+  }
+}
+
+/* ir_remove - unlinks an instruction from a section
+ *
+ * Parameters:
+ *   section - ir_section - the section holding the instruction
+ *   instruction - ir_instruction - the instruction to unlink
+ */
+void ir_remove(struct ir_section *section, struct ir_instruction *instruction) {
+  if (NULL != instruction->prev) {
+    instruction->prev->next = instruction->next;
+  }
+  if (NULL != instruction->next) {
+    instruction->next->prev = instruction->prev;
+  }
+  if (section->first == instruction) {
+    section->first = instruction->next;
+  }
+  if (section->last == instruction) {
+    section->last = instruction->prev;
+  }
+  instruction->prev = NULL;
+  instruction->next = NULL;
+}
+
+/* ir_find_call_parameters - finds the IR_PARAMETER instructions of one call
+ *   Walks backward from the call, stepping over the parameters of any calls
+ *   nested in the argument expressions.
+ *
+ * Parameters:
+ *   call - ir_instruction - the IR_FUNCTION_CALL
+ *   limit - ir_instruction - instruction to stop the search at, usually IR_PROC_BEGIN
+ *   params - ir_instruction ** - filled in, indexed by parameter number
+ *
+ * Returns "true" if every parameter of the call was found
+ */
+int ir_find_call_parameters(struct ir_instruction *call, struct ir_instruction *limit, struct ir_instruction **params) {
+  int pending[64];
+  int depth = 0;
+  int found = 0;
+  int num_params = (int)call->operands[1].data.number;
+  struct ir_instruction *iter;
+
+  for (iter = call->prev; found < num_params && NULL != iter && iter != limit; iter = iter->prev) {
+    if (iter->kind == IR_FUNCTION_CALL || iter->kind == IR_TAIL_CALL) {
+      if (depth == 64) {
+        return 0;
+      }
+      pending[depth++] = (int)iter->operands[1].data.number;
+    } else if (iter->kind == IR_PARAMETER) {
+      if (depth > 0) {
+        pending[depth - 1]--;
+      } else {
+        int number = (int)iter->operands[0].data.number;
+        if (number < 0 || number >= num_params || NULL != params[number]) {
+          return 0;
+        }
+        params[number] = iter;
+        found++;
+      }
+    }
+    while (depth > 0 && pending[depth - 1] <= 0) {
+      depth--;
+    }
+  }
+  return found == num_params;
+}
+
 static void ir_operand_number(struct ir_instruction *instruction, int position, struct node *number) {
   instruction->operands[position].kind = OPERAND_NUMBER;
   instruction->operands[position].data.number = number->data.number.value;
 }
 
 static void ir_operand_temporary(struct ir_instruction *instruction, int position) {
-  static int next_temporary;
+  if (IR_SEQUENCE_PT == instruction->kind) {
+    ir_expand_divisions();
+    window_base = next_temporary;
+  }
   instruction->operands[position].kind = OPERAND_TEMPORARY;
   instruction->operands[position].data.temporary = next_temporary++;
 }
 
+/* ir_reserve_temporaries - hands out a block of fresh temporary numbers, for
+ *   passes that copy code and need the copies not to collide with the original
+ *
+ * Parameters:
+ *   count - int - how many temporaries are needed
+ *
+ * Returns the first temporary number of the block
+ */
+int ir_reserve_temporaries(int count) {
+  int first = next_temporary;
+  next_temporary += count;
+  return first;
+}
+
 static void ir_operand_copy(struct ir_instruction *instruction, int position, struct ir_operand *operand) {
   instruction->operands[position] = *operand;
 }
 
-/* ir_operand_string - makes a new label for string constant, puts the value
- *                     into a global (*gasp) array of char pointers
+/* ir_operand_string - makes a label operand for a string constant, whose
+ *                     value goes into the literal pool
  *
  * Parameters:
  *   instruction - ir_instruction - instruction to add label to
  *   position - int - operand number
- *   string - node - the node whose string value goes into the array
+ *   string - node - the node whose string value goes into the pool
  *
  * Side-effects:
  *   Memory may be allocated on the heap.
  *
  */
 static void ir_operand_string(struct ir_instruction *instruction, int position, struct node *string) {
-	static int str_count;
-
-	if(str_count > 999)
-	{
-		ir_generation_num_errors++;
-		printf("ERROR - Too many strings!\n");
-	}
-	string_labels[str_count] = string->data.string.contents;
-	string_labels_len++;
-	instruction->operands[position].data.label_name = malloc(256);
-	sprintf(instruction->operands[position].data.label_name,"_StringLabel_%d", str_count++);
+	instruction->operands[position].data.label_name = literal_label(string->data.string.contents, string->data.string.len);
 	instruction->operands[position].kind = OPERAND_LABEL;
 }
 
@@ -142,13 +298,16 @@ static void ir_operand_string(struct ir_instruction *instruction, int position,
  *   Memory may be allocated on the heap.
  *
  */
-static void ir_operand_label(struct ir_instruction *instruction, int position) {
+void ir_operand_label(struct ir_instruction *instruction, int position) {
 	static int lbl_count;
 	instruction->operands[position].data.label_name = malloc(256);
 	sprintf(instruction->operands[position].data.label_name, "_GeneratedLabel_%d", lbl_count++);
 	instruction->operands[position].kind = OPERAND_LABEL;
 }
 
+static struct ir_operand *ir_multiply_by_constant(struct ir_section *ir, struct ir_operand *operand,
+		long multiplier, int is_unsigned);
+
 /* ir_pointer_arithmetic_conversion - adds extra instructions for doing
  *                                    pointer arithmetic (multiply by pointer-type
  *                                    size)
@@ -163,8 +322,6 @@ static void ir_operand_label(struct ir_instruction *instruction, int position) {
  *
  */
 struct ir_operand *ir_pointer_arithmetic_conversion(struct type *type, struct ir_section *ir, struct ir_operand *right_op) {
-	  struct ir_instruction *factor_inst, *pointer_inst;
-
 	  int size;
 	  if(type->data.pointer.type->kind == TYPE_BASIC)
 	  {
@@ -173,18 +330,7 @@ struct ir_operand *ir_pointer_arithmetic_conversion(struct type *type, struct ir
 	  else
 		  size = TYPE_WIDTH_POINTER;
 
-	  factor_inst = ir_instruction(IR_LOAD_IMMEDIATE);
-	  ir_operand_temporary(factor_inst, 0);
-	  factor_inst->operands[1].kind = OPERAND_NUMBER;
-	  factor_inst->operands[1].data.number = size;
-	  ir_append(ir, factor_inst);
-
-	  pointer_inst = ir_instruction(IR_MULTIPLY);
-	  ir_operand_temporary(pointer_inst, 0);
-	  ir_operand_copy(pointer_inst, 1, &factor_inst->operands[0]);
-	  ir_operand_copy(pointer_inst, 2, right_op);
-	  ir_append(ir, pointer_inst);
-	  return &pointer_inst->operands[0];
+	  return ir_multiply_by_constant(ir, right_op, size, 0);
 }
 
 
@@ -233,31 +379,44 @@ int ir_get_id_size(struct node *id_node) {
  * UTITLITY METHODS *
  ********************/
 
-/* ir_get_name - helper for function_definition, just grabs the function name
- *   from which ever type of node holds it
+/* ir_get_symbol - grabs the symbol a declarator declares, from which ever type
+ *   of node holds it
  *
  * Parameters:
  *   declarator - node - some kind of declarator node
  *
- * Returns a "string" with function name, if found
+ * Returns the symbol, if found
  */
-char *ir_get_name(struct node *declarator) {
+struct symbol *ir_get_symbol(struct node *declarator) {
 	switch (declarator->kind)
 	{
 	case NODE_IDENTIFIER:
-		return declarator->data.identifier.symbol->name;
+		return declarator->data.identifier.symbol;
 	case NODE_FUNCTION_DECLARATOR:
-		return ir_get_name(declarator->data.function_declarator.dir_dec);
+		return ir_get_symbol(declarator->data.function_declarator.dir_dec);
 	case NODE_ARRAY_DECLARATOR:
-		return ir_get_name(declarator->data.array_declarator.dir_dec);
+		return ir_get_symbol(declarator->data.array_declarator.dir_dec);
 	case NODE_POINTER_DECLARATOR:
-		return ir_get_name(declarator->data.pointer_declarator.declarator);
+		return ir_get_symbol(declarator->data.pointer_declarator.declarator);
 	default:
 		printf("Can't find node's name.");
-		return 0;
+		return NULL;
 	}
 }
 
+/* ir_get_name - helper for function_definition, just grabs the function name
+ *   from which ever type of node holds it
+ *
+ * Parameters:
+ *   declarator - node - some kind of declarator node
+ *
+ * Returns a "string" with function name, if found
+ */
+char *ir_get_name(struct node *declarator) {
+	struct symbol *symbol = ir_get_symbol(declarator);
+	return symbol == NULL ? NULL : symbol->name;
+}
+
 /*ir_constrant_check - checks to see if a binary operand contains a constant
  *
  * Paramenters:
@@ -314,6 +473,359 @@ void ir_return_zero(struct node *node)
 	node->data.binary_operation.result.ir_operand = &li->operands[0];
 }
 
+/* ir_append_operation - appends "result = left <kind> right" to a section
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   kind - int - the IR operation
+ *   left - ir_operand - the first operand
+ *   right - ir_operand - the second operand, or NULL for a unary operation
+ *
+ * Returns the result operand
+ */
+static struct ir_operand *ir_append_operation(struct ir_section *ir, int kind,
+		struct ir_operand *left, struct ir_operand *right)
+{
+	struct ir_instruction *instruction = ir_instruction(kind);
+	ir_operand_temporary(instruction, 0);
+	ir_operand_copy(instruction, 1, left);
+	if(NULL != right)
+		ir_operand_copy(instruction, 2, right);
+	ir_append(ir, instruction);
+	return &instruction->operands[0];
+}
+
+/* ir_new_label_name - makes a fresh generated label, for a place that gets its
+ *   IR_LABEL later
+ */
+static char *ir_new_label_name(void) {
+	struct ir_instruction label;
+	ir_operand_label(&label, 0);
+	return label.operands[0].data.label_name;
+}
+
+/* ir_append_label - appends an IR_LABEL for a label name
+ *
+ * Returns the section appended to, which is new if it was NULL
+ */
+static struct ir_section *ir_append_label(struct ir_section *ir, char *label_name) {
+	struct ir_instruction *label = ir_instruction(IR_LABEL);
+	label->operands[0].kind = OPERAND_LABEL;
+	label->operands[0].data.label_name = label_name;
+	return ir_append(ir, label);
+}
+
+/* ir_append_goto - appends a jump to a label name
+ *
+ * Returns the section appended to, which is new if it was NULL
+ */
+static struct ir_section *ir_append_goto(struct ir_section *ir, char *label_name) {
+	struct ir_instruction *jump = ir_instruction(IR_GOTO);
+	jump->operands[0].kind = OPERAND_LABEL;
+	jump->operands[0].data.label_name = label_name;
+	return ir_append(ir, jump);
+}
+
+/* ir_join - ir_concatenate, for a first section that may be NULL */
+static struct ir_section *ir_join(struct ir_section *before, struct ir_section *after) {
+	if(NULL == before)
+		return after;
+	return ir_concatenate(before, after);
+}
+
+/* ir_append_shift - appends a shift by a constant amount to a section */
+static struct ir_operand *ir_append_shift(struct ir_section *ir, int kind, struct ir_operand *operand, int amount)
+{
+	struct ir_operand number;
+	number.kind = OPERAND_NUMBER;
+	number.data.number = amount;
+	return ir_append_operation(ir, kind, operand, &number);
+}
+
+/* ir_append_immediate - appends a load immediate to a section */
+static struct ir_operand *ir_append_immediate(struct ir_section *ir, long value)
+{
+	struct ir_instruction *li = ir_instruction(IR_LOAD_IMMEDIATE);
+	ir_operand_temporary(li, 0);
+	li->operands[1].kind = OPERAND_NUMBER;
+	li->operands[1].data.number = value;
+	ir_append(ir, li);
+	return &li->operands[0];
+}
+
+/* ir_multiply_plan - multiply_plan, for a product the IR can build as a chain:
+ *   negating an unsigned product would trap where a multiply wraps round
+ */
+static int ir_multiply_plan(long multiplier, int is_unsigned, struct multiply_step *steps)
+{
+	if(is_unsigned && multiplier < 0)
+		return -1;
+	return multiply_plan(multiplier, steps);
+}
+
+/* ir_multiply_by_constant - appends the instructions for multiplication by a
+ *   constant, as the shift and add chain from multiply_plan when that is
+ *   cheaper on the target than a multiply
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   operand - ir_operand - the multiplicand
+ *   multiplier - long - the constant, which must not be 0
+ *   is_unsigned - int - "true" if the multiplication is unsigned
+ *
+ * Returns the operand holding the product
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static struct ir_operand *ir_multiply_by_constant(struct ir_section *ir, struct ir_operand *operand,
+		long multiplier, int is_unsigned)
+{
+	struct multiply_step steps[MULTIPLY_MAX_STEPS];
+	struct ir_operand *values[MULTIPLY_MAX_STEPS + 1];
+	int count = ir_multiply_plan(multiplier, is_unsigned, steps), i;
+
+	if(count < 0)
+		return ir_append_operation(ir, is_unsigned ? IR_MULU : IR_MULTIPLY, operand,
+				ir_append_immediate(ir, multiplier));
+
+	values[0] = operand;
+	for(i = 0; i < count; i++)
+	{
+		switch(steps[i].kind)
+		{
+		case MULTIPLY_SHIFT:
+			values[i + 1] = ir_append_shift(ir, IR_SHIFT_LEFT, values[steps[i].left], steps[i].amount);
+			break;
+		case MULTIPLY_ADD:
+			values[i + 1] = ir_append_operation(ir, IR_ADDU, values[steps[i].left], values[steps[i].right]);
+			break;
+		case MULTIPLY_SUBTRACT:
+			values[i + 1] = ir_append_operation(ir, IR_SUBU, values[steps[i].left], values[steps[i].right]);
+			break;
+		default:
+			assert(MULTIPLY_NEGATE == steps[i].kind);
+			values[i + 1] = ir_append_operation(ir, IR_MAKE_NEGATIVE, values[steps[i].left], NULL);
+			break;
+		}
+	}
+	return values[count];
+}
+
+/* ir_divide_by_constant - appends the steps from divide_plan that divide by a
+ *   constant with a multiply-high and shifts instead of a div
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   dividend - ir_operand - the dividend, a temporary
+ *   steps - divide_step - the plan
+ *   count - int - how many steps it has
+ *   magic - ir_operand - a temporary already holding the magic number, or NULL
+ *     to load it
+ *
+ * Returns the quotient operand
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static struct ir_operand *ir_divide_by_constant(struct ir_section *ir, struct ir_operand *dividend,
+		struct divide_step *steps, int count, struct ir_operand *magic)
+{
+	struct ir_operand *values[DIVIDE_MAX_STEPS + 1];
+	struct ir_operand *left;
+	int i;
+
+	values[0] = dividend;
+	for(i = 0; i < count; i++)
+	{
+		left = values[steps[i].left];
+		switch(steps[i].kind)
+		{
+		case DIVIDE_MULTIPLY_HIGH:
+		case DIVIDE_MULTIPLY_HIGH_U:
+			if(NULL == magic)
+				magic = ir_append_immediate(ir, steps[i].amount);
+			values[i + 1] = ir_append_operation(ir, DIVIDE_MULTIPLY_HIGH == steps[i].kind ?
+					IR_MULTIPLY_HIGH : IR_MULTIPLY_HIGH_U, left, magic);
+			break;
+		case DIVIDE_SHIFT_RIGHT:
+			values[i + 1] = ir_append_shift(ir, IR_SHIFT_RIGHT, left, steps[i].amount);
+			break;
+		case DIVIDE_SHIFT_RIGHT_U:
+			values[i + 1] = ir_append_shift(ir, IR_SHIFT_RIGHT_U, left, steps[i].amount);
+			break;
+		case DIVIDE_ADD:
+			values[i + 1] = ir_append_operation(ir, IR_ADDU, left, values[steps[i].right]);
+			break;
+		case DIVIDE_SUBTRACT:
+			values[i + 1] = ir_append_operation(ir, IR_SUBU, left, values[steps[i].right]);
+			break;
+		default:
+			assert(DIVIDE_NEGATE == steps[i].kind);
+			values[i + 1] = ir_append_operation(ir, IR_MAKE_NEGATIVE, left, NULL);
+			break;
+		}
+	}
+	return values[count];
+}
+
+/* ir_remainder_by_constant - appends the instructions for the remainder of
+ *   division by a constant, dividend - quotient * divisor
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   dividend - ir_operand - the dividend, a temporary
+ *   steps - divide_step - the plan for the quotient
+ *   count - int - how many steps it has
+ *   divisor - long - the divisor
+ *   is_unsigned - int - "true" for unsigned division
+ *   magic - ir_operand - as for ir_divide_by_constant
+ *
+ * Returns the remainder operand
+ */
+static struct ir_operand *ir_remainder_by_constant(struct ir_section *ir, struct ir_operand *dividend,
+		struct divide_step *steps, int count, long divisor, int is_unsigned, struct ir_operand *magic)
+{
+	struct ir_operand *quotient = ir_divide_by_constant(ir, dividend, steps, count, magic);
+	struct ir_operand *product = ir_multiply_by_constant(ir, quotient, divisor, is_unsigned);
+
+	return ir_append_operation(ir, IR_SUBU, dividend, product);
+}
+
+/* ir_division_temporaries - how many temporaries a division by a constant
+ *   takes, with those that multiply back and subtract for a remainder
+ */
+static int ir_division_temporaries(struct divide_step *steps, int count, long divisor, int is_unsigned,
+		int remainder)
+{
+	struct multiply_step products[MULTIPLY_MAX_STEPS];
+	int temporaries = count, product, i;
+
+	// Each magic number is loaded into a temporary of its own
+	for(i = 0; i < count; i++)
+		if(steps[i].kind == DIVIDE_MULTIPLY_HIGH || steps[i].kind == DIVIDE_MULTIPLY_HIGH_U)
+			temporaries++;
+	if(remainder)
+	{
+		product = ir_multiply_plan(divisor, is_unsigned, products);
+		temporaries += (product < 0 ? 2 : product) + 1;
+	}
+	return temporaries;
+}
+
+/* ir_append_division - appends a div by a constant, which ir_expand_divisions
+ *   may turn into the steps from divide_plan once the statement is done
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   dividend - ir_operand - the dividend, a temporary
+ *   divisor - long - the divisor
+ *   is_unsigned - int - "true" for unsigned division
+ *   remainder - int - "true" for the remainder rather than the quotient
+ *
+ * Returns the quotient or remainder operand
+ *
+ * Side-effects:
+ *   Memory is allocated on the heap.
+ */
+static struct ir_operand *ir_append_division(struct ir_section *ir, struct ir_operand *dividend,
+		long divisor, int is_unsigned, int remainder)
+{
+	struct ir_division *pending = malloc(sizeof(struct ir_division));
+	struct ir_operand *immediate = ir_append_immediate(ir, divisor);
+	struct ir_operand *result;
+
+	assert(NULL != pending);
+	pending->immediate = ir->last;
+	// The same instructions as for any other division
+	result = ir_append_operation(ir, remainder ? IR_MOD : is_unsigned ? IR_DIVU : IR_DIVIDE, dividend, immediate);
+	pending->division = ir->last;
+	pending->divisor = divisor;
+	pending->is_unsigned = is_unsigned;
+	pending->next = NULL;
+	*last_division = pending;
+	last_division = &pending->next;
+	return result;
+}
+
+/* ir_expand_divisions - turns the divs from ir_append_division into the steps
+ *   from divide_plan, in order, while the registers after the last sequence
+ *   point go round.  Called just before the next is numbered: the steps get
+ *   numbers after the rest of the statement's, the div's load of the divisor
+ *   is kept for the magic number, and the last step takes over the div.
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap and is freed.
+ */
+static void ir_expand_divisions(void)
+{
+	struct divide_step steps[DIVIDE_MAX_STEPS];
+	struct ir_division *pending;
+	struct ir_instruction *division, *last, *instruction;
+	struct ir_operand dividend, *magic, *result;
+	struct ir_section *ir;
+	int used = next_temporary - 1 - window_base;
+	int count, remainder, extra, i;
+
+	while(NULL != (pending = divisions))
+	{
+		divisions = pending->next;
+		division = pending->division;
+		remainder = IR_MOD == division->kind;
+		count = divide_plan(pending->divisor, pending->is_unsigned, steps);
+		assert(count > 0);
+
+		magic = NULL;
+		for(i = 0; i < count; i++)
+			if(steps[i].kind == DIVIDE_MULTIPLY_HIGH || steps[i].kind == DIVIDE_MULTIPLY_HIGH_U)
+			{
+				magic = &pending->immediate->operands[0];
+				break;
+			}
+		extra = ir_division_temporaries(steps, count, pending->divisor, pending->is_unsigned, remainder)
+				- 1 - (NULL != magic);
+		if(used + extra > IR_WINDOW_SIZE)
+		{
+			free(pending);
+			continue;
+		}
+		used += extra;
+
+		if(NULL != magic)
+			pending->immediate->operands[1].data.number = steps[i].amount;
+		else
+		{
+			pending->immediate->kind = IR_NO_OPERATION;
+			memset(pending->immediate->operands, 0, sizeof(pending->immediate->operands));
+		}
+
+		dividend = division->operands[1];
+		ir = ir_section(NULL, NULL);
+		if(remainder)
+			result = ir_remainder_by_constant(ir, &dividend, steps, count, pending->divisor, pending->is_unsigned, magic);
+		else
+			result = ir_divide_by_constant(ir, &dividend, steps, count, magic);
+		last = ir->last;
+		assert(result == &last->operands[0]);
+
+		// The last step writes the div's temporary, in the div's place
+		division->kind = last->kind;
+		division->operands[1] = last->operands[1];
+		division->operands[2] = last->operands[2];
+		while(ir->first != last)
+		{
+			instruction = ir->first;
+			ir->first = instruction->next;
+			instruction->prev = division->prev;
+			instruction->next = division;
+			division->prev->next = instruction;
+			division->prev = instruction;
+		}
+		free(pending);
+	}
+	last_division = &divisions;
+}
+
 /* ir_simplify_binary - optimizes various binary operands, identities, etc.
  *
  * Parameters:
@@ -351,12 +863,12 @@ int ir_simplify_binary(struct node *binary_operation, struct ir_operand *op, int
 				break;
 		case OP_PLUS:
 		case OP_VBAR:
-		case OP_AMPERSAND:
+		case OP_CARET:
 	    	  binary_operation->ir = ir_copy(node->ir);
 	    	  op = ir_convert_l_to_r(op, binary_operation->ir, node);
 			  binary_operation->data.binary_operation.result.ir_operand = op;
 			  return 1;
-		case OP_CARET:
+		case OP_AMPERSAND:
 		case OP_ASTERISK:
 		case OP_SLASH:
 		case OP_PERCENT:
@@ -390,36 +902,42 @@ int ir_simplify_binary(struct node *binary_operation, struct ir_operand *op, int
 			break;
 		}
 	}
-	else if(is_power_of_two(result))
+	else if(!left_side && (binary_operation->data.binary_operation.operation == OP_SLASH ||
+			binary_operation->data.binary_operation.operation == OP_PERCENT))
 	{
-		if(!left_side)
-		{
-			if(binary_operation->data.binary_operation.operation == OP_ASTERISK ||
-				binary_operation->data.binary_operation.operation == OP_SLASH)
-			{
+		int is_unsigned = type_is_unsigned(type_get_from_node(node));
+		int remainder = binary_operation->data.binary_operation.operation == OP_PERCENT;
+		struct divide_step steps[DIVIDE_MAX_STEPS];
+		int count;
 
-		    	binary_operation->ir = ir_copy(node->ir);
-		    	op = ir_convert_l_to_r(op, binary_operation->ir, node);
-				int direction = IR_SHIFT_RIGHT;
-				if(binary_operation->data.binary_operation.operation == OP_ASTERISK)
-					direction = IR_SHIFT_LEFT;
-				result = log(result)/log(2);
-				struct ir_instruction *li = ir_instruction(IR_LOAD_IMMEDIATE);
-				ir_operand_temporary(li, 0);
-				li->operands[1].kind = OPERAND_NUMBER;
-				li->operands[1].data.number = result;
-
-				struct ir_instruction *shift = ir_instruction(direction);
-				ir_operand_temporary(shift, 0);
-				ir_operand_copy(shift, 1, op);
-				ir_operand_copy(shift, 2, &li->operands[0]);
-
-				binary_operation->ir = ir_append(binary_operation->ir, li);
-				binary_operation->ir = ir_append(binary_operation->ir, shift);
-				binary_operation->data.binary_operation.result.ir_operand = &shift->operands[0];
-				return 1;
-			}
-		}
+		if(is_unsigned && result < 0)
+			return 0;
+
+		count = divide_plan(result, is_unsigned, steps);
+		if(count < 0)
+			return 0;
+
+		// A div takes two registers.  Steps that take more wait to see whether
+		// the rest of the statement leaves them enough.
+		binary_operation->ir = ir_copy(node->ir);
+		op = ir_convert_l_to_r(op, binary_operation->ir, node);
+		if(ir_division_temporaries(steps, count, result, is_unsigned, remainder) > 2)
+			op = ir_append_division(binary_operation->ir, op, result, is_unsigned, remainder);
+		else if(remainder)
+			op = ir_remainder_by_constant(binary_operation->ir, op, steps, count, result, is_unsigned, NULL);
+		else
+			op = ir_divide_by_constant(binary_operation->ir, op, steps, count, NULL);
+		binary_operation->data.binary_operation.result.ir_operand = op;
+		return 1;
+	}
+	else if(binary_operation->data.binary_operation.operation == OP_ASTERISK)
+	{
+		binary_operation->ir = ir_copy(node->ir);
+		op = ir_convert_l_to_r(op, binary_operation->ir, node);
+		op = ir_multiply_by_constant(binary_operation->ir, op, result,
+				type_is_unsigned(type_get_from_node(node)));
+		binary_operation->data.binary_operation.result.ir_operand = op;
+		return 1;
 	}
 	return 0;
 }
@@ -479,6 +997,30 @@ void ir_constant_folding_bi(struct node *binary_operation, long left, long right
 	  case OP_CARET:
 		  result = left ^ right;
 		  break;
+	  case OP_LESS:
+		  result = left < right;
+		  break;
+	  case OP_LESS_EQUAL:
+		  result = left <= right;
+		  break;
+	  case OP_GREATER:
+		  result = left > right;
+		  break;
+	  case OP_GREATER_EQUAL:
+		  result = left >= right;
+		  break;
+	  case OP_EQUAL_EQUAL:
+		  result = left == right;
+		  break;
+	  case OP_EXCLAMATION_EQUAL:
+		  result = left != right;
+		  break;
+	  case OP_AMPERSAND_AMPERSAND:
+		  result = left && right;
+		  break;
+	  case OP_VBAR_VBAR:
+		  result = left || right;
+		  break;
 	  default:
 		  assert(0);
 		  break;
@@ -493,111 +1035,152 @@ void ir_constant_folding_bi(struct node *binary_operation, long left, long right
 }
 
 
+/* ir_is_array - "true" if a variable is a one-dimensional array, which is
+ *   stored in place and whose name stands for the address of its elements.
+ *   Array parameters are pointers to the caller's array.
+ *
+ * Parameters:
+ *   type - type - the variable's type
+ */
+static int ir_is_array(struct type *type)
+{
+	return type->kind == TYPE_POINTER && type->data.pointer.size > 1 && type->is_param != 1;
+}
+
+/* ir_storage_width - the size of a scalar of some type
+ *
+ * Parameters:
+ *   type - type - the type
+ */
+static int ir_storage_width(struct type *type)
+{
+	if(type->kind == TYPE_BASIC)
+	{
+		if(type->data.basic.width == TYPE_WIDTH_CHAR)
+			return 1;
+		else if(type->data.basic.width == TYPE_WIDTH_SHORT)
+			return 2;
+	}
+	return 4;
+}
+
+/* ir_storage_size - works out how much memory a variable needs
+ *
+ * Parameters:
+ *   type - type - the variable's type
+ *
+ * Returns the size, in bytes
+ */
+static int ir_storage_size(struct type *type)
+{
+	if (type->kind == TYPE_ARRAY && type->data.array.len > 1)
+		return type->data.array.len * ir_storage_width(type->data.array.type);
+	// Here be arrays
+	if (ir_is_array(type))
+		return type->data.pointer.size * ir_storage_width(type->data.pointer.type);
+	return ir_storage_width(type);
+}
+
+/* ir_storage_alignment - works out the alignment a variable needs
+ *
+ * Parameters:
+ *   type - type - the variable's type
+ *
+ * Returns the alignment, in bytes
+ */
+static int ir_storage_alignment(struct type *type)
+{
+	if(type->kind == TYPE_ARRAY && type->data.array.len > 1)
+		return ir_storage_width(type->data.array.type);
+	if(ir_is_array(type))
+		return ir_storage_width(type->data.pointer.type);
+	return ir_storage_width(type);
+}
+
+/* The current function's locals, for frame_layout */
+static struct frame_slot *ir_frame_slots;
+static int ir_frame_slots_len;
+static int ir_frame_slots_size;
+static int *ir_frame_scope_parents;
+static int ir_frame_scopes;
+
 /* ir_set_symbol_table_offsets - helper function that walks through symbol
  *   table and sets identifiers' offsets
  *
+ * Each variable gets its own slot, sorted by alignment, and each block's
+ *   slots go above those of the block around it.  The slots are also noted
+ *   in ir_frame_slots for frame_layout, which may share them out again.
+ *
  * Parameters:
  *   table - symbol_table - the calling function's child table
  *   overhead - int - space on the stack already occupied
+ *   parent - int - the number of the enclosing block's table, or -1
  *
  * Returns an integer that is the number of bytes needed for the stack frame
  */
-int ir_set_symbol_table_offsets(struct symbol_table *table, int overhead){
+int ir_set_symbol_table_offsets(struct symbol_table *table, int overhead, int parent){
 	// Borrowed from symbol table print function
 	  struct symbol_list *iter;
+	  int scope = ir_frame_scopes++;
+	  int first = ir_frame_slots_len;
+	  int i, top;
 
-	  for (iter = table->variables; NULL != iter; iter = iter->next) {
-	    int size = 4;
-	    int array_size = 0;
-
-	    if(iter->symbol.result.type->kind == TYPE_BASIC)
-	    {
-	    	if(iter->symbol.result.type->data.basic.width == TYPE_WIDTH_CHAR)
-	    		size = 1;
-	    	else if(iter->symbol.result.type->data.basic.width == TYPE_WIDTH_SHORT)
-	    		size = 2;
-	    }
-	    else if (iter->symbol.result.type->kind == TYPE_ARRAY)
-	    {
-	    	if (iter->symbol.result.type->data.array.len > 1)
-	    	{
-	    		array_size = 4;
-
-	    		if(iter->symbol.result.type->data.array.type->kind == TYPE_BASIC)
-	    		{
-	    			if(iter->symbol.result.type->data.array.type->data.basic.width == TYPE_WIDTH_CHAR)
-	    				array_size = 1;
-	    			else if(iter->symbol.result.type->data.array.type->data.basic.width == TYPE_WIDTH_SHORT)
-	    				array_size = 2;
-	    		}
-	    		size = iter->symbol.result.type->data.array.len * array_size;
-	    	}
-	    }
-	    else if (iter->symbol.result.type->kind == TYPE_POINTER)
-	    {
-	    	// Here be arrays
-	    	if (iter->symbol.result.type->data.pointer.size > 1)
-	    	{
-	    		array_size = 4;
-
-	    		if(iter->symbol.result.type->data.pointer.type->kind == TYPE_BASIC)
-	    		{
-	    			if(iter->symbol.result.type->data.pointer.type->data.basic.width == TYPE_WIDTH_CHAR)
-	    				array_size = 1;
-	    			else if(iter->symbol.result.type->data.pointer.type->data.basic.width == TYPE_WIDTH_SHORT)
-	    				array_size = 2;
-	    		}
-	    		// pointer -> overhead;
-	    		array_size = iter->symbol.result.type->data.pointer.size * array_size;
-	    	}
-	    }
-
+	  ir_frame_scope_parents = realloc(ir_frame_scope_parents, sizeof(int) * ir_frame_scopes);
+	  assert(NULL != ir_frame_scope_parents);
+	  ir_frame_scope_parents[scope] = parent;
 
+	  for (iter = table->variables; NULL != iter; iter = iter->next) {
 	    iter->symbol.result.offset = malloc(sizeof(struct ir_operand));
 	    iter->symbol.result.offset->kind = OPERAND_LVALUE;
 
-	    if(iter->symbol.result.type->is_param != 1)
-	    {
-		    // Align halfwords
-		    if(size == 2)
-		    {
-		    	overhead = ((overhead + 1) / 2) * 2;
-		    }
-
-		    // Align words
-		    else if (size == 4)
-		    {
-		    	overhead = ((overhead + 3) / 4) * 4;
-		    }
-
-		    iter->symbol.result.offset->data.offset = overhead;
-		    overhead += size;
-	    }
-	    else
+	    if(iter->symbol.result.type->is_param == 1)
 	    {
 		    iter->symbol.result.offset->data.offset = iter->symbol.result.type->param_num * 4;
+		    continue;
 	    }
 
-	    // If there's an array, it will sit just below the pointer to it.
-	    overhead += array_size;
+	    if(ir_frame_slots_len == ir_frame_slots_size)
+	    {
+		    ir_frame_slots_size = ir_frame_slots_size ? ir_frame_slots_size * 2 : 32;
+		    ir_frame_slots = realloc(ir_frame_slots, sizeof(struct frame_slot) * ir_frame_slots_size);
+		    assert(NULL != ir_frame_slots);
+	    }
+	    memset(&ir_frame_slots[ir_frame_slots_len], 0, sizeof(struct frame_slot));
+	    ir_frame_slots[ir_frame_slots_len].symbol = &iter->symbol;
+	    ir_frame_slots[ir_frame_slots_len].size = ir_storage_size(iter->symbol.result.type);
+	    ir_frame_slots[ir_frame_slots_len].alignment = ir_storage_alignment(iter->symbol.result.type);
+	    ir_frame_slots[ir_frame_slots_len].scope = scope;
+	    ir_frame_slots[ir_frame_slots_len].offset = ir_frame_slots_len;
+	    ir_frame_slots_len++;
+	  }
 
+	  frame_sort_slots(&ir_frame_slots[first], ir_frame_slots_len - first);
+	  for (i = first; i < ir_frame_slots_len; i++) {
+	    overhead = ((overhead + ir_frame_slots[i].alignment - 1) / ir_frame_slots[i].alignment) * ir_frame_slots[i].alignment;
+	    ir_frame_slots[i].offset = overhead;
+	    ir_frame_slots[i].symbol->result.offset->data.offset = overhead;
+	    overhead += ir_frame_slots[i].size;
 	  }
 
-	  // Now walk through child tables, calling this function recursively and so that
-	  // each table at the same depth overlaps its offsets
+	  // Now walk through child tables, calling this function recursively.  Without
+	  // frame layout each table at the same depth overlaps its offsets; with it,
+	  // every slot must start out distinct and frame_layout does the overlapping.
 	  struct table_list *iter_tb;
 
+	  top = overhead;
 	  if (table->children != NULL)
 	  {
 		  iter_tb = table->children;
 		  while (iter_tb != NULL)
 		  {
-			 ir_set_symbol_table_offsets(iter_tb->child, overhead);
+			 int end = ir_set_symbol_table_offsets(iter_tb->child, frame_layout_enabled ? top : overhead, scope);
+			 if (end > top)
+				 top = end;
 			 iter_tb = iter_tb->next;
 		  }
 	  }
 
-	  return overhead;
+	  return top;
 }
 
 
@@ -665,6 +1248,10 @@ void ir_generate_for_string(struct node *string) {
 
 	if(id_node->kind == NODE_IDENTIFIER)
 	{
+		// An array's name is already the address of its elements
+		if(ir_is_array(id_node->data.identifier.symbol->result.type))
+			return operand;
+
 		if(id_node->data.identifier.symbol->result.type->kind == TYPE_BASIC)
 		{
 			width = id_node->data.identifier.symbol->result.type->data.basic.width;
@@ -743,7 +1330,7 @@ void ir_generate_for_numeric_unary(int kind, struct node *unary_operation) {
 	  struct ir_instruction *instruction;
 	  assert(NODE_UNARY_OPERATION == unary_operation->kind);
 
-	  ir_generate_for_expression(unary_operation->data.unary_operation.operand);
+	  // The operand's code is already in unary_operation->ir
 	  struct ir_operand *op;
 	  op = node_get_result(unary_operation->data.unary_operation.operand)->ir_operand;
 
@@ -782,10 +1369,13 @@ void ir_generate_for_arithmetic_binary_operation(int kind, struct node *binary_o
     int flag = 0;
   	long left_result;
   	long right_result;
+  	int first_temporary = next_temporary;
+  	int right_temporary;
 
   	// Generate ir for both expressions
     ir_generate_for_expression(binary_operation->data.binary_operation.left_operand);
     struct ir_operand *left_op = node_get_result(binary_operation->data.binary_operation.left_operand)->ir_operand;
+    right_temporary = next_temporary;
     ir_generate_for_expression(binary_operation->data.binary_operation.right_operand);
     struct ir_operand *right_op = node_get_result(binary_operation->data.binary_operation.right_operand)->ir_operand;
 
@@ -811,6 +1401,8 @@ void ir_generate_for_arithmetic_binary_operation(int kind, struct node *binary_o
     // In this case, both sides are constants
     if(flag == 3)
     {
+    	// Neither side's code is kept, so their temporaries can go to the result
+    	next_temporary = first_temporary;
     	ir_constant_folding_bi(binary_operation, left_result, right_result);
     	return;
     }
@@ -824,8 +1416,15 @@ void ir_generate_for_arithmetic_binary_operation(int kind, struct node *binary_o
 
     if(flag == 2)
     {
+    	// The constant's load is dropped, so the first temporary simplifying
+    	// numbers, such as a divisor's load, takes over the constant's.  A gap
+    	// in the numbering would push the rest of the statement out of the
+    	// register window.
+    	int constant_end = next_temporary;
+    	next_temporary = right_temporary;
     	if(ir_simplify_binary(binary_operation, left_op, right_result, 0))
     		return;
+    	next_temporary = constant_end;
     }
 
   binary_operation->ir = ir_copy(binary_operation->data.binary_operation.left_operand->ir);
@@ -1098,75 +1697,110 @@ struct ir_operand *ir_convert_to_zero_one(struct ir_operand *result, struct ir_s
 	return &real_result->operands[0];
 }
 
-/* ir_generate_for_log_and_or - adds instructions for logical operations 
+/* ir_generate_for_condition - appends code that goes to a label if an
+ *   expression's truth is jump_if, and falls through otherwise.  &&, || and !
+ *   become branches rather than 0 or 1 values; a relational operator's value
+ *   and the branch on it are fused by branch_optimize.
  *
- * Parameters: 
- *   binary_operation - node - contains the operands
- *   is_or - int - flag set if this is a || expression 
+ * Parameters:
+ *   ir - ir_section - section to append to, or NULL
+ *   expression - node - the condition
+ *   jump_if - int - 1 to jump if the condition holds, 0 if it does not
+ *   label_name - char * - where to jump
+ *
+ * Returns the section appended to, which is new if it was NULL
  *
  * Side-effects:
  *   Memory may be allocated on the heap.
- *
  */
-void ir_generate_for_log_and_or(struct node *binary_operation, int is_or) {
-	ir_generate_for_expression(binary_operation->data.binary_operation.left_operand);
-	binary_operation->ir = binary_operation->data.binary_operation.left_operand->ir;
-	struct ir_operand *left_op = node_get_result(binary_operation->data.binary_operation.left_operand)->ir_operand;
-	left_op = ir_convert_l_to_r(left_op, binary_operation->ir, binary_operation->data.binary_operation.left_operand);
+static struct ir_section *ir_generate_for_condition(struct ir_section *ir, struct node *expression, int jump_if,
+		char *label_name) {
+	struct ir_instruction *branch_instruction;
+	struct ir_operand *result_op;
+	char *skip_label;
+	int is_or;
 
-	// Result will go in this instruction
-	struct ir_instruction *result_instruction = ir_instruction(IR_COPY);
-	ir_operand_temporary(result_instruction, 0);
-	struct ir_instruction *other_result = ir_instruction(IR_COPY);
-	ir_operand_copy(other_result, 0, &result_instruction->operands[0]);
+	switch(expression->kind)
+	{
+	case NODE_NUMBER:
+		// Either always jumps or never does
+		if((expression->data.number.value != 0) == jump_if)
+			ir = ir_append_goto(ir, label_name);
+		return ir;
 
-	// Set the GOTO kind, based on && or ||
-	int kind;
-	if (is_or)
-		kind = IR_GOTO_IF_TRUE;
-	else
-		kind = IR_GOTO_IF_FALSE;
+	case NODE_UNARY_OPERATION:
+		if(expression->data.unary_operation.operation == OP_EXCLAMATION)
+			return ir_generate_for_condition(ir, expression->data.unary_operation.operand, !jump_if, label_name);
+		break;
 
-	// Branch instruction
-	struct ir_instruction *branch_instruction = ir_instruction(kind);
-	ir_operand_copy(branch_instruction, 0, left_op);
-	ir_operand_label(branch_instruction, 1);
-	binary_operation->ir = ir_append(binary_operation->ir, branch_instruction);
-
-	// Right expression
-	ir_generate_for_expression(binary_operation->data.binary_operation.right_operand);
-	binary_operation->ir = ir_concatenate(binary_operation->ir, binary_operation->data.binary_operation.right_operand->ir);
-	struct ir_operand *right_op = node_get_result(binary_operation->data.binary_operation.right_operand)->ir_operand;
-	right_op = ir_convert_l_to_r(right_op, binary_operation->ir, binary_operation->data.binary_operation.right_operand);
-
-	ir_operand_copy(result_instruction, 1, right_op);
-	binary_operation->ir = ir_append(binary_operation->ir, result_instruction);
-	struct ir_instruction *end_jump = ir_instruction(IR_GOTO);
-	ir_operand_label(end_jump, 0);
-	binary_operation->ir = ir_append(binary_operation->ir, end_jump);
-
-	// Jump label
-	struct ir_instruction *label = ir_instruction(IR_LABEL);
-	ir_operand_copy(label, 0, &branch_instruction->operands[1]);
-	binary_operation->ir = ir_append(binary_operation->ir, label);
-	ir_operand_copy(other_result, 1, left_op);
-	binary_operation->ir = ir_append(binary_operation->ir, other_result);
+	case NODE_BINARY_OPERATION:
+		if(expression->data.binary_operation.operation != OP_AMPERSAND_AMPERSAND &&
+				expression->data.binary_operation.operation != OP_VBAR_VBAR)
+			break;
+		is_or = expression->data.binary_operation.operation == OP_VBAR_VBAR;
 
-	// End label
-	struct ir_instruction *end_label = ir_instruction(IR_LABEL);
-	ir_operand_copy(end_label, 0, &end_jump->operands[0]);
-	binary_operation->ir = ir_append(binary_operation->ir, end_label);
+		// A false left side decides &&, and a true one ||, so it can take the same jump
+		if(jump_if == is_or)
+		{
+			ir = ir_generate_for_condition(ir, expression->data.binary_operation.left_operand, jump_if, label_name);
+			return ir_generate_for_condition(ir, expression->data.binary_operation.right_operand, jump_if, label_name);
+		}
 
-	//	Result is either "true" or "false".  It needs to be 1 or 0
-	struct ir_instruction *zero_or_one = ir_instruction(IR_NOT_EQUAL);
-	ir_operand_copy(zero_or_one, 1, &result_instruction->operands[0]);
-	ir_operand_temporary(zero_or_one, 0);
-	zero_or_one->operands[2].kind = OPERAND_NUMBER;
-	zero_or_one->operands[2].data.number = 0;
-	binary_operation->ir = ir_append(binary_operation->ir, zero_or_one);
+		// Otherwise deciding it means skipping the right side and the jump
+		skip_label = ir_new_label_name();
+		ir = ir_generate_for_condition(ir, expression->data.binary_operation.left_operand, !jump_if, skip_label);
+		ir = ir_generate_for_condition(ir, expression->data.binary_operation.right_operand, jump_if, label_name);
+		return ir_append_label(ir, skip_label);
 
-	binary_operation->data.binary_operation.result.ir_operand = &zero_or_one->operands[0];
+	case NODE_COMMA_LIST:
+		// Conditions are parsed as lists; one with a single item is just that item
+		if(expression->data.comma_list.next == NULL)
+			return ir_generate_for_condition(ir, expression->data.comma_list.data, jump_if, label_name);
+		break;
+	}
 
+	ir_generate_for_expression(expression);
+	ir = ir_join(ir, expression->ir);
+	result_op = node_get_result(expression)->ir_operand;
+	result_op = ir_convert_l_to_r(result_op, ir, expression);
+
+	branch_instruction = ir_instruction(jump_if ? IR_GOTO_IF_TRUE : IR_GOTO_IF_FALSE);
+	ir_operand_copy(branch_instruction, 0, result_op);
+	branch_instruction->operands[1].kind = OPERAND_LABEL;
+	branch_instruction->operands[1].data.label_name = label_name;
+	return ir_append(ir, branch_instruction);
+}
+
+/* ir_generate_for_log_and_or - adds instructions for logical operations whose
+ *   value is used, rather than just branched on
+ *
+ * Parameters: 
+ *   binary_operation - node - contains the operands
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ *
+ */
+void ir_generate_for_log_and_or(struct node *binary_operation) {
+	struct ir_instruction *false_result = ir_instruction(IR_LOAD_IMMEDIATE);
+	struct ir_instruction *true_result = ir_instruction(IR_LOAD_IMMEDIATE);
+	char *end_label = ir_new_label_name();
+
+	// 0 unless the condition gets past its jump to the end
+	ir_operand_temporary(false_result, 0);
+	false_result->operands[1].kind = OPERAND_NUMBER;
+	false_result->operands[1].data.number = 0;
+	binary_operation->ir = ir_section(false_result, false_result);
+
+	binary_operation->ir = ir_generate_for_condition(binary_operation->ir, binary_operation, 0, end_label);
+
+	ir_operand_copy(true_result, 0, &false_result->operands[0]);
+	true_result->operands[1].kind = OPERAND_NUMBER;
+	true_result->operands[1].data.number = 1;
+	ir_append(binary_operation->ir, true_result);
+	ir_append_label(binary_operation->ir, end_label);
+
+	binary_operation->data.binary_operation.result.ir_operand = &false_result->operands[0];
 }
 
 /* ir_generate_for_binary_operation - just a multi-way branch based on operation type 
@@ -1281,11 +1915,8 @@ void ir_generate_for_binary_operation(struct node *binary_operation) {
     	break;
 
     case OP_AMPERSAND_AMPERSAND:
-    	ir_generate_for_log_and_or(binary_operation, 0);
-    	break;
-
     case OP_VBAR_VBAR:
-    	ir_generate_for_log_and_or(binary_operation, 1);
+    	ir_generate_for_log_and_or(binary_operation);
     	break;
 
     default:
@@ -1294,6 +1925,70 @@ void ir_generate_for_binary_operation(struct node *binary_operation) {
   }
 }
 
+/* ir_append_value - appends the code for an expression to a section that
+ *   may be NULL, and returns the operand holding its value
+ */
+static struct ir_operand *ir_append_value(struct ir_section **ir, struct node *expression) {
+	ir_generate_for_expression(expression);
+	*ir = ir_join(*ir, expression->ir);
+	return ir_convert_l_to_r(node_get_result(expression)->ir_operand, *ir, expression);
+}
+
+/* ir_generate_for_select - appends code without branches for "condition ?
+ *   if_true : if_false", whose sides ifconvert_is_cheap allows
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to, or NULL
+ *   condition - node - the value tested, from ifconvert_condition
+ *   negated - int - "true" if if_true is wanted when condition is zero
+ *   if_true - node - the value if the condition holds
+ *   if_false - node - the value if it does not
+ *   result - ir_operand ** - set to the operand holding the value chosen
+ *
+ * Returns the section appended to, which is new if it was NULL
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static struct ir_section *ir_generate_for_select(struct ir_section *ir, struct node *condition, int negated,
+		struct node *if_true, struct node *if_false, struct ir_operand **result) {
+	struct ir_operand *test, *true_op, *false_op, *mask, *difference;
+	struct ir_instruction *copy, *move;
+
+	test = ir_append_value(&ir, condition);
+	true_op = ir_append_value(&ir, if_true);
+	false_op = ir_append_value(&ir, if_false);
+
+	if(ifconvert_conditional_moves)
+	{
+		// Start with if_false and overwrite it with if_true
+		copy = ir_instruction(IR_COPY);
+		ir_operand_temporary(copy, 0);
+		ir_operand_copy(copy, 1, false_op);
+		ir_append(ir, copy);
+
+		move = ir_instruction(negated ? IR_MOVE_IF_ZERO : IR_MOVE_IF_NOT_ZERO);
+		ir_operand_copy(move, 0, &copy->operands[0]);
+		ir_operand_copy(move, 1, true_op);
+		ir_operand_copy(move, 2, test);
+		ir_append(ir, move);
+
+		*result = &copy->operands[0];
+		return ir;
+	}
+
+	// A mask of all ones when if_true is wanted picks the bits where it differs
+	if(negated)
+		test = ir_append_operation(ir, IR_LOG_NOT, test, NULL);
+	else if(!ifconvert_is_boolean(condition))
+		test = ir_append_operation(ir, IR_NOT_EQUAL, test, ir_append_immediate(ir, 0));
+	mask = ir_append_operation(ir, IR_MAKE_NEGATIVE, test, NULL);
+	difference = ir_append_operation(ir, IR_XOR, true_op, false_op);
+	difference = ir_append_operation(ir, IR_BIT_AND, difference, mask);
+	*result = ir_append_operation(ir, IR_XOR, false_op, difference);
+	return ir;
+}
+
 /* ir_generate_for_ternary_operation - evaluation and flow control for ternary operations
  *
  * Parameters: 
@@ -1304,10 +1999,20 @@ void ir_generate_for_binary_operation(struct node *binary_operation) {
  *
  */
 void ir_generate_for_ternary_operation(struct node *expression) {
-	ir_generate_for_expression(expression->data.ternary_operation.log_expr);
-	expression->ir = ir_copy(expression->data.ternary_operation.log_expr->ir);
-	struct ir_operand *expr_op = node_get_result(expression->data.ternary_operation.log_expr)->ir_operand;
 	struct ir_operand *result_op;
+	struct node *condition;
+	int negated;
+
+	// Short sides without side effects are both computed, and one picked
+	if(ifconvert_enabled && ifconvert_is_cheap(expression->data.ternary_operation.expr) &&
+			ifconvert_is_cheap(expression->data.ternary_operation.cond_expr) &&
+			NULL != (condition = ifconvert_condition(expression->data.ternary_operation.log_expr, &negated)))
+	{
+		expression->ir = ir_generate_for_select(NULL, condition, negated, expression->data.ternary_operation.expr,
+				expression->data.ternary_operation.cond_expr, &result_op);
+		expression->data.ternary_operation.result.ir_operand = result_op;
+		return;
+	}
 
 	// Both branches feed into the same result register, which will be the following
 	// temporary operand
@@ -1316,18 +2021,16 @@ void ir_generate_for_ternary_operation(struct node *expression) {
 	struct ir_instruction *other_store = ir_instruction(IR_COPY);
 	ir_operand_copy(other_store, 0, &store_instruction->operands[0]);
 
-	expr_op = ir_convert_l_to_r(expr_op, expression->ir, expression->data.ternary_operation.log_expr);
-
 	// Branch
-	struct ir_instruction *branch_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-	ir_operand_label(branch_instruction, 1);
-	ir_operand_copy(branch_instruction, 0, expr_op);
-	ir_append(expression->ir, branch_instruction);
+	struct ir_instruction *first_label = ir_instruction(IR_LABEL);
+	ir_operand_label(first_label, 0);
+	expression->ir = ir_generate_for_condition(NULL, expression->data.ternary_operation.log_expr, 0,
+			first_label->operands[0].data.label_name);
 
 	// Then instructions
 	ir_generate_for_expression(expression->data.ternary_operation.expr);
 	struct ir_section *ir = ir_copy(expression->data.ternary_operation.expr->ir);
-	expression->ir = ir_concatenate(expression->ir, ir);
+	expression->ir = ir_join(expression->ir, ir);
 	result_op = node_get_result(expression->data.ternary_operation.expr)->ir_operand;
 	result_op = ir_convert_l_to_r(result_op, expression->ir, expression->data.ternary_operation.expr);
 
@@ -1341,8 +2044,6 @@ void ir_generate_for_ternary_operation(struct node *expression) {
 	expression->ir = ir_append(expression->ir, goto_instruction); 
 
 	// False label
-	struct ir_instruction *first_label = ir_instruction(IR_LABEL);
-	ir_operand_copy(first_label, 0, &branch_instruction->operands[1]);
 	expression->ir = ir_append(expression->ir, first_label); 
 
 	// False branch
@@ -1519,12 +2220,26 @@ void ir_generate_for_cast(struct node *cast) {
 		expression->data.prefix.result.ir_operand = &oper_instruction->operands[0];
 }
 
-int ir_generate_for_parameter_list(struct node *call, struct node *list_node, char *function_name) {
+/* ir_generate_for_parameter_list - generates the arguments of a call, and
+ *   their IR_PARAMETER instructions into a section of their own
+ *
+ * Parameters:
+ *   call - node - contains the function call expression
+ *   list_node - node - the arguments, last first
+ *   function_name - char * - the function called
+ *   params - ir_section - where the IR_PARAMETER instructions go, which the
+ *     caller places after every argument, since an argument may make a call
+ *     of its own that would pass its parameters over the earlier ones
+ *
+ * Returns the number of arguments, or -1 for the built-in print functions
+ */
+int ir_generate_for_parameter_list(struct node *call, struct node *list_node, char *function_name,
+		struct ir_section *params) {
 	struct ir_instruction *pass_arg;
 	int arg_num = 0;
 	if (list_node->data.comma_list.next != NULL)
 	{
-		arg_num = ir_generate_for_parameter_list(call, list_node->data.comma_list.next, function_name);
+		arg_num = ir_generate_for_parameter_list(call, list_node->data.comma_list.next, function_name, params);
 	}
 	ir_generate_for_expression(list_node->data.comma_list.data);
 	call->ir = ir_concatenate(call->ir, list_node->data.comma_list.data->ir);
@@ -1551,8 +2266,7 @@ int ir_generate_for_parameter_list(struct node *call, struct node *list_node, ch
 	pass_arg->operands[0].kind = OPERAND_NUMBER;
 	pass_arg->operands[0].data.number = arg_num;
 	ir_operand_copy(pass_arg, 1, arg_op);
-	list_node = list_node->data.comma_list.next;
-	call->ir = ir_append(call->ir, pass_arg);
+	ir_append(params, pass_arg);
 	return ++arg_num;
 }
 
@@ -1571,11 +2285,15 @@ void ir_generate_for_function_call(struct node *call) {
 	int arg_num = 0;
 	char *function_name = call->data.function_call.expression->data.identifier.name;
 	struct ir_instruction *dummy = ir_instruction(IR_NO_OPERATION);
+	struct ir_section *params = ir_section(NULL, NULL);
 	call->ir = ir_section(dummy, dummy);
 
-	arg_num = ir_generate_for_parameter_list(call, list_node, function_name);
+	if(list_node != NULL)
+		arg_num = ir_generate_for_parameter_list(call, list_node, function_name, params);
 	if(arg_num == -1)
 		return;
+	if(NULL != params->first)
+		call->ir = ir_concatenate(call->ir, params);
 	if(arg_num > 4)
 	{
 		ir_generation_num_errors++;
@@ -1585,6 +2303,9 @@ void ir_generate_for_function_call(struct node *call) {
 	struct ir_instruction *function_instruction = ir_instruction(IR_FUNCTION_CALL);
 	function_instruction->operands[0].kind = OPERAND_LABEL;
 	function_instruction->operands[0].data.label_name = function_name;
+	// Remember how many arguments belong to this call, so later passes can find its parameters
+	function_instruction->operands[1].kind = OPERAND_NUMBER;
+	function_instruction->operands[1].data.number = arg_num;
 	call->ir = ir_append(call->ir, function_instruction);
 
 	struct type *return_type = type_get_from_node(call->data.function_call.expression)->data.func.return_type;
@@ -1665,180 +2386,755 @@ void ir_generate_for_expression(struct node *expression) {
     	ir_generate_for_string(expression);
     	break;
 
-    case NODE_CAST:
-    	ir_generate_for_cast(expression);
-		break;
+    case NODE_CAST:
+    	ir_generate_for_cast(expression);
+		break;
+
+    case NODE_POSTFIX:
+    	ir_generate_for_postfix(expression, 1);
+    	break;
+    case NODE_PREFIX:
+    	ir_generate_for_postfix(expression, 0);
+    	break;
+
+    case NODE_FUNCTION_CALL:
+    	ir_generate_for_function_call(expression);
+		break;
+
+    case NODE_COMMA_LIST:
+    	ir_generate_for_comma_list(expression);
+    	break;
+
+    default:
+      assert(0);
+      break;
+  }
+}
+
+void ir_generate_for_statement(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size);
+
+/* ir_generate_for_expression_statement - passes contents to generate_for_expression
+ *
+ * Parameters: 
+ *   expression - node - contains the statement 
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ *
+ */
+void ir_generate_for_expression_statement(struct node *expression_statement) {
+  struct ir_instruction *instruction;
+  struct node *expression = expression_statement->data.expression_statement.expression;
+  assert(NODE_EXPRESSION_STATEMENT == expression_statement->kind);
+  ir_generate_for_expression(expression);
+
+  expression_statement->ir = ir_copy(expression_statement->data.expression_statement.expression->ir);
+}
+
+/* ir_generate_for_statement_list - calls generate for statement for each statement in list
+ *
+ * Parameters: 
+ *   statement_list - node - contains the statements
+ *   function_name - char[] - needed for user labels
+ *   cont - ir_instruction - instruction with label for continue statements
+ *   brk - ir_instruction - instruction with label for break statements
+ *
+ */
+void ir_generate_for_statement_list(struct node *statement_list, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
+  struct node *init = statement_list->data.statement_list.init;
+  struct node *statement = statement_list->data.statement_list.statement;
+
+  assert(NODE_STATEMENT_LIST == statement_list->kind);
+
+  if (NULL != init) {
+    ir_generate_for_statement_list(init, function_name, cont, brk, frame_size);
+    statement_list->ir = init->ir;
+    ir_generate_for_statement(statement, function_name, cont, brk, frame_size);
+    if(init->ir == NULL)
+    	statement_list->ir = statement->ir;
+    else
+    	statement_list->ir = ir_concatenate(init->ir, statement->ir);
+  } else {
+    ir_generate_for_statement(statement, function_name, cont, brk, frame_size);
+    statement_list->ir = statement->ir;
+  }
+}
+
+/* ir_generate_for_labeled_statement - prepends user label to include function name
+ *
+ * Parameters: 
+ *   statement - node - contains the statement
+ *   function_name - char[] - prepended to labels for function-level uniqueness
+ *   cont - ir_instruction - instruction with label for continue statements
+ *   brk - ir_instruction - instruction with label for break statements
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void ir_generate_for_labeled_statement(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
+	char *label_name = statement->data.labeled_statement.id->data.identifier.name;
+	char *str_buf = malloc(256);
+	sprintf(str_buf,"_UserLabel_%s_%s", function_name, label_name);
+	struct ir_instruction *label_instruction = ir_instruction(IR_LABEL);
+	label_instruction->operands[0].kind = OPERAND_LABEL;
+	label_instruction->operands[0].data.label_name = str_buf;
+	struct ir_section *ir = ir_section(label_instruction, label_instruction);
+
+	ir_generate_for_statement(statement->data.labeled_statement.statement, function_name, cont, brk, frame_size);
+	ir = ir_concatenate(ir, statement->data.labeled_statement.statement->ir);
+	statement->ir = ir;
+}
+
+/* ir_generate_for_compound - calls generate for statement list
+ *
+ * Parameters: 
+ *   statement - node - contains the statement
+ *   function_name - char[] - needed for user labels
+ *   cont - ir_instruction - instruction with label for continue statements
+ *   brk - ir_instruction - instruction with label for break statements
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void ir_generate_for_compound(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
+  assert(NODE_COMPOUND == statement->kind);
+  if(statement->data.compound.statement_list != NULL)
+  {
+    ir_generate_for_statement_list(statement->data.compound.statement_list, function_name, cont, brk, frame_size);
+    statement->ir = ir_copy(statement->data.compound.statement_list->ir);
+  }
+  else
+	  statement->ir = NULL;
+}
+
+/* ir_generate_for_conditional_select - generates "if (c) v = a; else v = b;"
+ *   as "v = c ? a : b", and "if (c) v = a;" as "v = c ? a : v", without
+ *   branches, when ifconvert allows
+ *
+ * Parameters:
+ *   statement - node - contains the statement
+ *
+ * Returns "true" if the statement was generated
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static int ir_generate_for_conditional_select(struct node *statement) {
+	struct node *then_assignment, *else_assignment, *left, *if_false, *condition;
+	struct ir_instruction *instruction;
+	struct ir_operand *value;
+	int negated;
+
+	then_assignment = ifconvert_assignment(statement->data.conditional.then_statement);
+	if(NULL == then_assignment)
+		return 0;
+	left = then_assignment->data.binary_operation.left_operand;
+
+	if(NULL == statement->data.conditional.else_statement)
+		if_false = left;
+	else
+	{
+		else_assignment = ifconvert_assignment(statement->data.conditional.else_statement);
+		if(NULL == else_assignment ||
+				else_assignment->data.binary_operation.left_operand->data.identifier.symbol != left->data.identifier.symbol)
+			return 0;
+		if_false = else_assignment->data.binary_operation.right_operand;
+	}
+
+	condition = ifconvert_condition(statement->data.conditional.expr, &negated);
+	if(NULL == condition)
+		return 0;
+
+	statement->ir = ir_generate_for_select(NULL, condition, negated, then_assignment->data.binary_operation.right_operand,
+			if_false, &value);
+
+	// The one store, as ir_generate_for_simple_assignment does it
+	instruction = ir_instruction(ir_get_id_size(left));
+	ir_generate_for_expression(left);
+	statement->ir = ir_concatenate(statement->ir, left->ir);
+	ir_operand_copy(instruction, 1, node_get_result(left)->ir_operand);
+	ir_operand_copy(instruction, 0, value);
+	ir_append(statement->ir, instruction);
+	return 1;
+}
+
+/* ir_append_sequence_point - appends a sequence point, after which the
+ *   numbering of temporaries starts over at the first register
+ */
+static struct ir_section *ir_append_sequence_point(struct ir_section *ir) {
+	struct ir_instruction *sequence_point = ir_instruction(IR_SEQUENCE_PT);
+	ir_operand_temporary(sequence_point, 0);
+	return ir_append(ir, sequence_point);
+}
+
+/* ir_generate_for_conditional - flow control for if/if-else statements
+ *
+ * Parameters: 
+ *   statement - node - contains the statement
+ *   function_name - char[] - needed for user labels
+ *   cont - ir_instruction - instruction with label for continue statements
+ *   brk - ir_instruction - instruction with label for break statements
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void ir_generate_for_conditional(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
+	if(ifconvert_enabled && ir_generate_for_conditional_select(statement))
+		return;
+
+	// Branch
+	struct ir_instruction *first_label = ir_instruction(IR_LABEL);
+	ir_operand_label(first_label, 0);
+	struct ir_section *ir = ir_generate_for_condition(NULL, statement->data.conditional.expr, 0,
+			first_label->operands[0].data.label_name);
+	printf("%s\n",first_label->operands[0].data.label_name);
+
+	// Then instructions, which start the registers over after the test
+	ir = ir_append_sequence_point(ir);
+	ir_generate_for_statement(statement->data.conditional.then_statement, function_name, cont, brk, frame_size);
+	ir = ir_join(ir, statement->data.conditional.then_statement->ir);
+
+	struct ir_instruction *goto_instruction;
+	// If there's an else statement, we need to branch again
+	if(statement->data.conditional.else_statement != NULL)
+	{
+		goto_instruction = ir_instruction(IR_GOTO);
+		ir_operand_label(goto_instruction, 0);
+		ir_append(ir, goto_instruction);
+	}
+
+	// False label
+	ir_append(ir, first_label);
+
+	// False branch
+	if(statement->data.conditional.else_statement != NULL)
+	{
+		ir_generate_for_statement(statement->data.conditional.else_statement, function_name, cont, brk, frame_size);
+		ir = ir_concatenate(ir, statement->data.conditional.else_statement->ir);
+
+		struct ir_instruction *second_label = ir_instruction(IR_LABEL);
+		ir_operand_copy(second_label, 0, &goto_instruction->operands[0]);
+		ir_append(ir, second_label);
+	}
+	statement->ir = ir;
+}
+
+/* A switch statement while its dispatch code is being generated */
+struct ir_switch {
+	/* The controlling value */
+	struct ir_operand *value;
+	struct switch_case *cases;
+	/* Label of each destination, by switch_case.target */
+	char **targets;
+	char *default_label;
+};
+
+/* ir_append_compare_branch - appends "if (value <relation> constant) goto label"
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   kind - int - one of the IR_GOTO_IF_<relation> kinds
+ *   value - ir_operand - the value compared
+ *   constant - long - what it is compared with
+ *   label_name - char * - where to go
+ */
+static void ir_append_compare_branch(struct ir_section *ir, int kind, struct ir_operand *value, long constant,
+		char *label_name) {
+	struct ir_instruction *branch = ir_instruction(kind);
+	ir_operand_copy(branch, 0, value);
+	branch->operands[1].kind = OPERAND_NUMBER;
+	branch->operands[1].data.number = constant;
+	branch->operands[2].kind = OPERAND_LABEL;
+	branch->operands[2].data.label_name = label_name;
+	ir_append(ir, branch);
+}
+
+/* ir_switch_fits - whether a cluster's temporaries can all be in registers
+ *   together with the value.  mips.c gives the registers of earlier clusters
+ *   to later ones, so nothing else is live.
+ */
+static int ir_switch_fits(int count) {
+	return count + 1 <= SWITCH_MAX_TEMPORARIES;
+}
+
+/* ir_switch_offset - appends "value - low", the position of the value in a
+ *   cluster, and returns it
+ */
+static struct ir_operand *ir_switch_offset(struct ir_switch *sw, struct ir_section *ir, long low) {
+	if(low == 0)
+		return sw->value;
+	return ir_append_operation(ir, IR_SUBTRACT, sw->value, ir_append_immediate(ir, low));
+}
+
+/* ir_switch_range_check - appends branches for values outside a cluster,
+ *   unless earlier comparisons have ruled them out already.  Clusters are
+ *   tried in order of value, so one below this cluster is no case at all.
+ *
+ * Parameters:
+ *   sw - ir_switch - the switch
+ *   ir - ir_section - section to append to
+ *   cluster - switch_cluster - the cluster
+ *   lower, upper - long - bounds known to hold for the value
+ *   miss - char * - where values above the cluster go
+ */
+static void ir_switch_range_check(struct ir_switch *sw, struct ir_section *ir, struct switch_cluster *cluster,
+		long lower, long upper, char *miss) {
+	if(lower < cluster->low)
+		ir_append_compare_branch(ir, IR_GOTO_IF_LESS, sw->value, cluster->low, sw->default_label);
+	if(upper > cluster->high)
+		ir_append_compare_branch(ir, IR_GOTO_IF_GREATER, sw->value, cluster->high, miss);
+}
+
+/* ir_switch_table - appends a jump through a table with an entry for every
+ *   value of a cluster; values that are not cases go to the default
+ */
+static void ir_switch_table(struct ir_switch *sw, struct ir_section *ir, struct switch_cluster *cluster) {
+	long entries = cluster->high - cluster->low + 1, i;
+	char **table = malloc(sizeof(char *) * entries);
+	struct ir_instruction *jump = ir_instruction(IR_GOTO_TABLE);
+	int next = cluster->first;
+
+	assert(NULL != table);
+	for(i = 0; i < entries; i++)
+	{
+		if(sw->cases[next].value == cluster->low + i)
+			table[i] = sw->targets[sw->cases[next++].target];
+		else
+			table[i] = sw->default_label;
+	}
+
+	ir_operand_copy(jump, 0, ir_switch_offset(sw, ir, cluster->low));
+	ir_operand_label(jump, 1);
+	ir_add_jump_table(jump->operands[1].data.label_name, (int)entries, table);
+	ir_append(ir, jump);
+}
+
+/* ir_switch_bit_test - appends "if ((1 << (value - low)) & mask) goto case"
+ *   for each destination of a cluster, with the mask holding that
+ *   destination's values; anything left goes to the default
+ */
+static void ir_switch_bit_test(struct ir_switch *sw, struct ir_section *ir, struct switch_cluster *cluster) {
+	int targets[SWITCH_BIT_TEST_TARGETS + 1];
+	int num_targets = switch_bit_test_targets(sw->cases, cluster, targets), i, j;
+	struct ir_operand *bit = ir_append_operation(ir, IR_SHIFT_LEFT, ir_append_immediate(ir, 1),
+			ir_switch_offset(sw, ir, cluster->low));
+
+	for(i = 0; i < num_targets; i++)
+	{
+		unsigned long mask = 0;
+		struct ir_instruction *branch = ir_instruction(IR_GOTO_IF_TRUE);
+
+		for(j = cluster->first; j < cluster->first + cluster->count; j++)
+			if(sw->cases[j].target == targets[i])
+				mask |= 1ul << (sw->cases[j].value - cluster->low);
+
+		ir_operand_copy(branch, 0, ir_append_operation(ir, IR_BIT_AND, bit,
+				ir_append_immediate(ir, (int32_t)(uint32_t)mask)));
+		branch->operands[1].kind = OPERAND_LABEL;
+		branch->operands[1].data.label_name = sw->targets[targets[i]];
+		ir_append(ir, branch);
+	}
+	ir_append_goto(ir, sw->default_label);
+}
+
+/* ir_switch_cluster - appends the code that goes to the case for a value in
+ *   a cluster, or to miss for anything above it
+ *
+ * Parameters:
+ *   sw - ir_switch - the switch
+ *   ir - ir_section - section to append to
+ *   cluster - switch_cluster - the cluster
+ *   lower, upper - long - bounds known to hold for the value
+ *   miss - char * - where values outside the cluster go
+ *   miss_follows - int - set if the code appended next is at miss
+ *
+ * Returns the least value that can get to miss
+ */
+static long ir_switch_cluster(struct ir_switch *sw, struct ir_section *ir, struct switch_cluster *cluster,
+		long lower, long upper, char *miss, int miss_follows) {
+	int targets[SWITCH_BIT_TEST_TARGETS + 1];
+	int i, temporaries = cluster->low == 0 ? 0 : 2;
+
+	switch(cluster->kind)
+	{
+	case SWITCH_CLUSTER_TABLE:
+		if(!ir_switch_fits(temporaries))
+			break;
+		ir_switch_range_check(sw, ir, cluster, lower, upper, miss);
+		ir_switch_table(sw, ir, cluster);
+		return cluster->high + 1;
 
-    case NODE_POSTFIX:
-    	ir_generate_for_postfix(expression, 1);
-    	break;
-    case NODE_PREFIX:
-    	ir_generate_for_postfix(expression, 0);
-    	break;
+	case SWITCH_CLUSTER_BIT_TEST:
+		temporaries += 2 + 2 * switch_bit_test_targets(sw->cases, cluster, targets);
+		if(!ir_switch_fits(temporaries))
+			break;
+		ir_switch_range_check(sw, ir, cluster, lower, upper, miss);
+		ir_switch_bit_test(sw, ir, cluster);
+		return cluster->high + 1;
 
-    case NODE_FUNCTION_CALL:
-    	ir_generate_for_function_call(expression);
+	default:
+		// Nothing else is left for the value to be
+		if(lower == cluster->low && upper == cluster->high)
+		{
+			ir_append_goto(ir, sw->targets[sw->cases[cluster->first].target]);
+			return lower;
+		}
 		break;
+	}
 
-    case NODE_COMMA_LIST:
-    	ir_generate_for_comma_list(expression);
-    	break;
-
-    default:
-      assert(0);
-      break;
-  }
+	// A single case, or a cluster there are no registers left for: compare for each value
+	for(i = cluster->first; i < cluster->first + cluster->count; i++)
+		ir_append_compare_branch(ir, IR_GOTO_IF_EQUAL, sw->value, sw->cases[i].value,
+				sw->targets[sw->cases[i].target]);
+	if(!miss_follows)
+		ir_append_goto(ir, miss);
+	return lower;
 }
 
-void ir_generate_for_statement(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size);
-
-/* ir_generate_for_expression_statement - passes contents to generate_for_expression
- *
- * Parameters: 
- *   expression - node - contains the statement 
- *
- * Side-effects:
- *   Memory may be allocated on the heap.
+/* ir_switch_search - appends a balanced binary search of clusters for the value
  *
+ * Parameters:
+ *   sw - ir_switch - the switch
+ *   ir - ir_section - section to append to
+ *   clusters - switch_cluster - the clusters, in order of value
+ *   first, last - int - the clusters to search, inclusive
+ *   lower, upper - long - bounds known to hold for the value
  */
-void ir_generate_for_expression_statement(struct node *expression_statement) {
-  struct ir_instruction *instruction;
-  struct node *expression = expression_statement->data.expression_statement.expression;
-  assert(NODE_EXPRESSION_STATEMENT == expression_statement->kind);
-  ir_generate_for_expression(expression);
+static void ir_switch_search(struct ir_switch *sw, struct ir_section *ir, struct switch_cluster *clusters,
+		int first, int last, long lower, long upper) {
+	int mid, i;
+	char *label_name;
 
-  expression_statement->ir = ir_copy(expression_statement->data.expression_statement.expression->ir);
+	// A few clusters are quicker to try one by one
+	if(last - first < SWITCH_LINEAR_CLUSTERS)
+	{
+		for(i = first; i < last; i++)
+		{
+			label_name = ir_new_label_name();
+			lower = ir_switch_cluster(sw, ir, &clusters[i], lower, upper, label_name, 1);
+			ir_append_label(ir, label_name);
+		}
+		ir_switch_cluster(sw, ir, &clusters[last], lower, upper, sw->default_label, 0);
+		return;
+	}
+
+	mid = (first + last + 1) / 2;
+	label_name = ir_new_label_name();
+	ir_append_compare_branch(ir, IR_GOTO_IF_GREATER_EQUAL, sw->value, clusters[mid].low, label_name);
+	ir_switch_search(sw, ir, clusters, first, mid - 1, lower, clusters[mid].low - 1);
+	ir_append_label(ir, label_name);
+	ir_switch_search(sw, ir, clusters, mid, last, clusters[mid].low, upper);
 }
 
-/* ir_generate_for_statement_list - calls generate for statement for each statement in list
+/* ir_generate_for_switch - evaluates the controlling expression and goes to the
+ *   matching case through a search of the cases, jump tables and bit tests
+ *   that switch_plan splits them into
  *
- * Parameters: 
- *   statement_list - node - contains the statements
+ * Parameters:
+ *   statement - node - contains the statement
  *   function_name - char[] - needed for user labels
  *   cont - ir_instruction - instruction with label for continue statements
- *   brk - ir_instruction - instruction with label for break statements
  *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
  */
-void ir_generate_for_statement_list(struct node *statement_list, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
-  struct node *init = statement_list->data.statement_list.init;
-  struct node *statement = statement_list->data.statement_list.statement;
+void ir_generate_for_switch(struct node *statement, char function_name[], struct ir_instruction *cont, int frame_size) {
+	struct node *expr = statement->data.switch_statement.expr;
+	struct node *case_label, *destination;
+	struct ir_instruction *sequence_point = ir_instruction(IR_SEQUENCE_PT);
+	struct ir_instruction *break_label = ir_instruction(IR_LABEL);
+	struct switch_cluster *clusters;
+	struct ir_switch sw;
+	int count = 0, num_clusters, i;
+	int is_unsigned = type_is_unsigned(node_get_result(expr)->type);
+
+	for(case_label = statement->data.switch_statement.cases; case_label != NULL; case_label = case_label->data.case_label.next)
+		count++;
+	sw.cases = malloc(sizeof(struct switch_case) * (count + 1));
+	sw.targets = malloc(sizeof(char *) * (count + 1));
+	clusters = malloc(sizeof(struct switch_cluster) * (count + 1));
+	assert(NULL != sw.cases && NULL != sw.targets && NULL != clusters);
 
-  assert(NODE_STATEMENT_LIST == statement_list->kind);
+	ir_operand_label(break_label, 0);
+	for(case_label = statement->data.switch_statement.cases, i = 0; case_label != NULL; case_label = case_label->data.case_label.next, i++)
+		sw.targets[i] = case_label->data.case_label.label_name = ir_new_label_name();
+	sw.default_label = break_label->operands[0].data.label_name;
+	if(statement->data.switch_statement.default_case != NULL)
+		sw.default_label = statement->data.switch_statement.default_case->data.case_label.label_name = ir_new_label_name();
+	sw.targets[count] = sw.default_label;
+
+	for(case_label = statement->data.switch_statement.cases, i = 0; case_label != NULL; case_label = case_label->data.case_label.next, i++)
+	{
+		// "case 1: case 2: ..." all go to the same place, which bit tests want to know
+		for(destination = case_label; destination->data.case_label.statement->kind == NODE_CASE;
+				destination = destination->data.case_label.statement)
+			;
+		sw.cases[i].target = i;
+		while(strcmp(sw.targets[sw.cases[i].target], destination->data.case_label.label_name))
+			sw.cases[i].target = (sw.cases[i].target + 1) % (count + 1);
+
+		// Unsigned values are searched with signed comparisons by flipping their top bit
+		sw.cases[i].value = case_label->data.case_label.value;
+		if(is_unsigned)
+			sw.cases[i].value = (int32_t)((uint32_t)sw.cases[i].value ^ 0x80000000u);
+	}
 
-  if (NULL != init) {
-    ir_generate_for_statement_list(init, function_name, cont, brk, frame_size);
-    statement_list->ir = init->ir;
-    ir_generate_for_statement(statement, function_name, cont, brk, frame_size);
-    if(init->ir == NULL)
-    	statement_list->ir = statement->ir;
-    else
-    	statement_list->ir = ir_concatenate(init->ir, statement->ir);
-  } else {
-    ir_generate_for_statement(statement, function_name, cont, brk, frame_size);
-    statement_list->ir = statement->ir;
-  }
+	ir_operand_temporary(sequence_point, 0);
+	statement->ir = ir_section(sequence_point, sequence_point);
+
+	ir_generate_for_expression(expr);
+	statement->ir = ir_concatenate(statement->ir, expr->ir);
+	sw.value = ir_convert_l_to_r(node_get_result(expr)->ir_operand, statement->ir, expr);
+	if(is_unsigned)
+		sw.value = ir_append_operation(statement->ir, IR_XOR, sw.value, ir_append_immediate(statement->ir, INT32_MIN));
+	assert(sw.value->kind == OPERAND_TEMPORARY);
+
+	// Expand the value's divisions before the dispatch code's temporaries use up the window
+	ir_expand_divisions();
+
+	if(count == 0)
+		ir_append_goto(statement->ir, sw.default_label);
+	else
+	{
+		switch_sort_cases(sw.cases, count);
+		num_clusters = switch_plan(sw.cases, count, clusters);
+		ir_switch_search(&sw, statement->ir, clusters, 0, num_clusters - 1, INT32_MIN, INT32_MAX);
+	}
+
+	// The cases start the registers over after the dispatch code
+	statement->ir = ir_append_sequence_point(statement->ir);
+	ir_generate_for_statement(statement->data.switch_statement.statement, function_name, cont, break_label, frame_size);
+	statement->ir = ir_concatenate(statement->ir, statement->data.switch_statement.statement->ir);
+	ir_append(statement->ir, break_label);
+
+	free(sw.cases);
+	free(sw.targets);
+	free(clusters);
 }
 
-/* ir_generate_for_labeled_statement - prepends user label to include function name
+/* ir_generate_for_case - places the label the switch's dispatch code goes to
  *
- * Parameters: 
+ * Parameters:
  *   statement - node - contains the statement
- *   function_name - char[] - prepended to labels for function-level uniqueness
+ *   function_name - char[] - needed for user labels
  *   cont - ir_instruction - instruction with label for continue statements
  *   brk - ir_instruction - instruction with label for break statements
  *
  * Side-effects:
  *   Memory may be allocated on the heap.
  */
-void ir_generate_for_labeled_statement(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
-	char *label_name = statement->data.labeled_statement.id->data.identifier.name;
-	char *str_buf = malloc(256);
-	sprintf(str_buf,"_UserLabel_%s_%s", function_name, label_name);
-	struct ir_instruction *label_instruction = ir_instruction(IR_LABEL);
-	label_instruction->operands[0].kind = OPERAND_LABEL;
-	label_instruction->operands[0].data.label_name = str_buf;
-	struct ir_section *ir = ir_section(label_instruction, label_instruction);
+void ir_generate_for_case(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
+	struct ir_section *ir = ir_section(NULL, NULL);
 
-	ir_generate_for_statement(statement->data.labeled_statement.statement, function_name, cont, brk, frame_size);
-	ir = ir_concatenate(ir, statement->data.labeled_statement.statement->ir);
-	statement->ir = ir;
+	ir_append_label(ir, statement->data.case_label.label_name);
+	ir_generate_for_statement(statement->data.case_label.statement, function_name, cont, brk, frame_size);
+	statement->ir = ir_concatenate(ir, statement->data.case_label.statement->ir);
 }
 
-/* ir_generate_for_compound - calls generate for statement list
+/* ir_vector_bytes - a byte copied into all four bytes of a word */
+static long ir_vector_bytes(long value) {
+	return (int32_t)((uint32_t)(value & 0xff) * 0x01010101u);
+}
+
+/* ir_vector_element - appends the address of the element of a char array at
+ *   the index of a vectorized loop, and returns the operand holding it
+ */
+static struct ir_operand *ir_vector_element(struct ir_section **ir, struct node *array, struct ir_operand *index) {
+	struct ir_operand *base = ir_append_value(ir, array);
+	return ir_append_operation(*ir, IR_ADD, base, index);
+}
+
+/* ir_vector_splat - appends a word with the low byte of a constant in each
+ *   of its bytes, and returns the operand holding it
+ */
+static struct ir_operand *ir_vector_splat(struct ir_section **ir, struct node *constant) {
+	struct ir_operand *word;
+
+	if(constant->kind == NODE_NUMBER)
+		return ir_append_immediate(*ir, ir_vector_bytes(constant->data.number.value));
+
+	// The byte at the top, then copied down into the bytes below it
+	word = ir_append_value(ir, constant);
+	word = ir_append_shift(*ir, IR_SHIFT_LEFT, word, 24);
+	word = ir_append_operation(*ir, IR_BIT_OR, word, ir_append_shift(*ir, IR_SHIFT_RIGHT_U, word, 8));
+	return ir_append_operation(*ir, IR_BIT_OR, word, ir_append_shift(*ir, IR_SHIFT_RIGHT_U, word, 16));
+}
+
+/* ir_vector_word - appends the computation of a word of a vectorized loop's
+ *   destination from the word of its source, and returns the operand holding it
  *
- * Parameters: 
- *   statement - node - contains the statement
+ * Parameters:
+ *   ir - ir_section ** - section to append to
+ *   loop - vectorize_loop - the loop
+ *   word - ir_operand - the word of the source, or NULL for a fill
+ */
+static struct ir_operand *ir_vector_word(struct ir_section **ir, struct vectorize_loop *loop, struct ir_operand *word) {
+	struct ir_operand *low, *sum, *top, *bytes;
+	long value;
+	int kind;
+
+	switch(loop->operation)
+	{
+	case OP_PLUS:
+	case OP_MINUS:
+		value = loop->constant->data.number.value;
+		value = ir_vector_bytes(loop->operation == OP_MINUS ? -value : value);
+
+		// The low seven bits of each byte add without reaching the next byte,
+		// and the top bit is the sum of the top bits and that carry, mod 2
+		low = ir_append_operation(*ir, IR_BIT_AND, word, ir_append_immediate(*ir, 0x7f7f7f7f));
+		sum = ir_append_operation(*ir, IR_ADDU, low, ir_append_immediate(*ir, value & 0x7f7f7f7f));
+		top = ir_append_operation(*ir, IR_XOR, word, low);
+		if(value & 0x80)
+			top = ir_append_operation(*ir, IR_XOR, top, ir_append_immediate(*ir, ir_vector_bytes(0x80)));
+		return ir_append_operation(*ir, IR_XOR, sum, top);
+	case OP_CARET:
+		kind = IR_XOR;
+		break;
+	case OP_AMPERSAND:
+		kind = IR_BIT_AND;
+		break;
+	case OP_VBAR:
+		kind = IR_BIT_OR;
+		break;
+	default:
+		return NULL == word ? ir_vector_splat(ir, loop->constant) : word;
+	}
+
+	// The bitwise operators leave each byte to itself
+	bytes = ir_vector_splat(ir, loop->constant);
+	return ir_append_operation(*ir, kind, word, bytes);
+}
+
+/* ir_append_scalar_loop - appends a vectorized loop's original, one byte at a
+ *   time
+ *
+ * Parameters:
+ *   ir - ir_section - section to append to
+ *   statement - node - the for loop
+ *   loop - vectorize_loop - its parts
+ *   top_label - char * - the label to put at the top of the loop
+ *   aligned_label - char * - where to go once the destination is word
+ *     aligned, or NULL to go round until the loop ends
+ *   done_label - char * - where to go when the loop ends
  *   function_name - char[] - needed for user labels
- *   cont - ir_instruction - instruction with label for continue statements
- *   brk - ir_instruction - instruction with label for break statements
+ *
+ * Returns the section appended to
  *
  * Side-effects:
  *   Memory may be allocated on the heap.
  */
-void ir_generate_for_compound(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
-  assert(NODE_COMPOUND == statement->kind);
-  if(statement->data.compound.statement_list != NULL)
-  {
-    ir_generate_for_statement_list(statement->data.compound.statement_list, function_name, cont, brk, frame_size);
-    statement->ir = ir_copy(statement->data.compound.statement_list->ir);
-  }
-  else
-	  statement->ir = NULL;
+static struct ir_section *ir_append_scalar_loop(struct ir_section *ir, struct node *statement, struct vectorize_loop *loop,
+		char *top_label, char *aligned_label, char *done_label, char function_name[], int frame_size) {
+	struct node *for_expr = statement->data.while_loop.expr;
+	struct ir_operand *index, *address;
+
+	ir = ir_append_label(ir, top_label);
+	ir = ir_generate_for_condition(ir, for_expr->data.for_loop.expr2, 0, done_label);
+	if(NULL != aligned_label)
+	{
+		index = ir_append_value(&ir, loop->index);
+		address = ir_vector_element(&ir, loop->destination, index);
+		address = ir_append_operation(ir, IR_BIT_AND, address, ir_append_immediate(ir, VECTORIZE_WIDTH - 1));
+		ir_append_compare_branch(ir, IR_GOTO_IF_EQUAL, address, 0, aligned_label);
+	}
+	ir = ir_append_sequence_point(ir);
+
+	// The body is one assignment, with nothing to continue or break
+	ir_generate_for_statement(statement->data.while_loop.statement, function_name, NULL, NULL, frame_size);
+	ir = ir_concatenate(ir, statement->data.while_loop.statement->ir);
+	ir_generate_for_expression(for_expr->data.for_loop.expr3);
+	ir = ir_concatenate(ir, for_expr->data.for_loop.expr3->ir);
+	return ir_append_goto(ir, top_label);
 }
 
-/* ir_generate_for_conditional - flow control for if/if-else statements
+/* ir_generate_for_vectorized_for - a for loop vectorize_loop recognized: one
+ *   byte at a time until the destination is word aligned, a word at a time
+ *   while there are four bytes left, and one byte at a time for the rest.
+ *   Each part keeps the index in its variable, so the next takes up where the
+ *   last left off, and the variable ends up as the loop leaves it.
  *
- * Parameters: 
- *   statement - node - contains the statement
+ * Parameters:
+ *   statement - node - the for loop
+ *   loop - vectorize_loop - its parts
  *   function_name - char[] - needed for user labels
- *   cont - ir_instruction - instruction with label for continue statements
- *   brk - ir_instruction - instruction with label for break statements
  *
  * Side-effects:
  *   Memory may be allocated on the heap.
  */
-void ir_generate_for_conditional(struct node *statement, char function_name[], struct ir_instruction *cont, struct ir_instruction *brk, int frame_size) {
-	ir_generate_for_expression(statement->data.conditional.expr);
-	struct ir_section *ir = ir_copy(statement->data.conditional.expr->ir);
-	struct ir_operand *expr_op = node_get_result(statement->data.conditional.expr)->ir_operand;
-	expr_op = ir_convert_l_to_r(expr_op, ir, statement->data.conditional.expr);
-
-	// Branch
-	struct ir_instruction *branch_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-	ir_operand_label(branch_instruction, 1);
-	ir_operand_copy(branch_instruction, 0, expr_op);
-	ir_append(ir, branch_instruction);
-	printf("%s\n",branch_instruction->operands[1].data.label_name);
-
-	// Then instructions
-	ir_generate_for_statement(statement->data.conditional.then_statement, function_name, cont, brk, frame_size);
-	ir = ir_concatenate(ir, statement->data.conditional.then_statement->ir);
+static void ir_generate_for_vectorized_for(struct node *statement, struct vectorize_loop *loop, char function_name[],
+		int frame_size) {
+	struct node *for_expr = statement->data.while_loop.expr;
+	char *word_label = ir_new_label_name(), *scalar_label = ir_new_label_name(), *done_label = ir_new_label_name();
+	struct ir_section *ir = NULL;
+	struct ir_operand *index, *bound, *next, *target, *word, *difference, *source;
+	struct ir_instruction *instruction;
 
-	struct ir_instruction *goto_instruction;
-	// If there's an else statement, we need to branch again
-	if(statement->data.conditional.else_statement != NULL)
+	if(for_expr->data.for_loop.expr1 != NULL)
 	{
-		goto_instruction = ir_instruction(IR_GOTO);
-		ir_operand_label(goto_instruction, 0);
-		ir_append(ir, goto_instruction);
+		ir_generate_for_expression(for_expr->data.for_loop.expr1);
+		ir = ir_copy(for_expr->data.for_loop.expr1->ir);
 	}
+	ir = ir_append_sequence_point(ir);
 
-	// False label
-	struct ir_instruction *first_label = ir_instruction(IR_LABEL);
-	ir_operand_copy(first_label, 0, &branch_instruction->operands[1]);
-	ir_append(ir, first_label);
-
-	// False branch
-	if(statement->data.conditional.else_statement != NULL)
+	// Arrays whose addresses differ in their low bits are never aligned together
+	if(NULL != loop->source)
 	{
-		ir_generate_for_statement(statement->data.conditional.else_statement, function_name, cont, brk, frame_size);
-		ir = ir_concatenate(ir, statement->data.conditional.else_statement->ir);
-
-		struct ir_instruction *second_label = ir_instruction(IR_LABEL);
-		ir_operand_copy(second_label, 0, &goto_instruction->operands[0]);
-		ir_append(ir, second_label);
+		difference = ir_append_value(&ir, loop->destination);
+		source = ir_append_value(&ir, loop->source);
+		difference = ir_append_operation(ir, IR_XOR, difference, source);
+		difference = ir_append_operation(ir, IR_BIT_AND, difference, ir_append_immediate(ir, VECTORIZE_WIDTH - 1));
+		ir_append_compare_branch(ir, IR_GOTO_IF_NOT_EQUAL, difference, 0, scalar_label);
+		ir = ir_append_sequence_point(ir);
 	}
-	statement->ir = ir;
+	ir = ir_append_scalar_loop(ir, statement, loop, ir_new_label_name(), word_label, done_label, function_name, frame_size);
+
+	// Go round while a whole word is left: i + 4 <= n
+	ir_append_label(ir, word_label);
+	index = ir_append_value(&ir, loop->index);
+	bound = ir_append_value(&ir, loop->bound);
+	next = ir_append_operation(ir, IR_ADD, index, ir_append_immediate(ir, VECTORIZE_WIDTH));
+	instruction = ir_instruction(IR_GOTO_IF_GREATER);
+	ir_operand_copy(instruction, 0, next);
+	ir_operand_copy(instruction, 1, bound);
+	instruction->operands[2].kind = OPERAND_LABEL;
+	instruction->operands[2].data.label_name = scalar_label;
+	ir_append(ir, instruction);
+	ir = ir_append_sequence_point(ir);
+
+	// d[i..i+3] = f(s[i..i+3])
+	index = ir_append_value(&ir, loop->index);
+	target = ir_vector_element(&ir, loop->destination, index);
+	word = NULL;
+	if(NULL != loop->source)
+	{
+		instruction = ir_instruction(IR_LOAD_WORD);
+		ir_operand_temporary(instruction, 0);
+		ir_operand_copy(instruction, 1, ir_vector_element(&ir, loop->source, index));
+		ir_append(ir, instruction);
+		word = &instruction->operands[0];
+	}
+	word = ir_vector_word(&ir, loop, word);
+	instruction = ir_instruction(IR_STORE_WORD);
+	ir_operand_copy(instruction, 0, word);
+	ir_operand_copy(instruction, 1, target);
+	ir_append(ir, instruction);
+	ir = ir_append_sequence_point(ir);
+
+	// i = i + 4
+	ir_generate_for_expression(loop->index);
+	ir = ir_concatenate(ir, loop->index->ir);
+	target = node_get_result(loop->index)->ir_operand;
+	index = ir_convert_l_to_r(target, ir, loop->index);
+	instruction = ir_instruction(IR_STORE_WORD);
+	ir_operand_copy(instruction, 0, ir_append_operation(ir, IR_ADD, index, ir_append_immediate(ir, VECTORIZE_WIDTH)));
+	ir_operand_copy(instruction, 1, target);
+	ir_append(ir, instruction);
+	ir = ir_append_sequence_point(ir);
+	ir_append_goto(ir, word_label);
+
+	ir = ir_append_scalar_loop(ir, statement, loop, scalar_label, NULL, done_label, function_name, frame_size);
+	statement->ir = ir_append_label(ir, done_label);
 }
 
 /* ir_generate_for_for - flow control for for statements
@@ -1856,6 +3152,13 @@ void ir_generate_for_for(struct node *statement, char function_name[], int frame
 	assert(statement->kind == NODE_WHILE);
 	assert(statement->data.while_loop.expr->kind == NODE_FOR);
 	struct node *for_expr = statement->data.while_loop.expr;
+	struct vectorize_loop loop;
+
+	if(vectorize_enabled && vectorize_loop(statement, &loop))
+	{
+		ir_generate_for_vectorized_for(statement, &loop, function_name, frame_size);
+		return;
+	}
 
 	// Evaluate expr1, throw out the value
 	if(for_expr->data.for_loop.expr1 != NULL)
@@ -1875,19 +3178,11 @@ void ir_generate_for_for(struct node *statement, char function_name[], int frame
 
 	// If it's present, evaluate expr2 and go on if true
 	if(for_expr->data.for_loop.expr2 != NULL)
-	{
-		ir_generate_for_expression(for_expr->data.for_loop.expr2);
-		statement->ir = ir_concatenate(statement->ir, for_expr->data.for_loop.expr2->ir);
-		struct ir_opearnd *op = node_get_result(for_expr->data.for_loop.expr2)->ir_operand;
-		op = ir_convert_l_to_r(op, statement->ir, for_expr->data.for_loop.expr2);
-
-		struct ir_instruction *branch_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-		ir_operand_copy(branch_instruction, 0, op);
-		ir_operand_copy(branch_instruction, 1, &break_label->operands[0]);
-		ir_append(statement->ir, branch_instruction);
-	}
+		statement->ir = ir_generate_for_condition(statement->ir, for_expr->data.for_loop.expr2, 0,
+				break_label->operands[0].data.label_name);
 
-	// Now the body
+	// Now the body, which starts the registers over after the test
+	statement->ir = ir_append_sequence_point(statement->ir);
 	ir_generate_for_statement(statement->data.while_loop.statement, function_name, continue_label, break_label, frame_size);
 	statement->ir = ir_concatenate(statement->ir, statement->data.while_loop.statement->ir);
 
@@ -1921,8 +3216,6 @@ void ir_generate_for_for(struct node *statement, char function_name[], int frame
 void ir_generate_for_while(struct node *statement, char function_name[], int frame_size) {
 	struct ir_instruction *continue_label = ir_instruction(IR_LABEL);
 	struct ir_instruction *break_label = ir_instruction(IR_LABEL);
-	struct ir_instruction *branch_instruction;
-	struct ir_operand *result_op;
 
 	switch (statement->data.while_loop.type)
 	{
@@ -1931,23 +3224,13 @@ void ir_generate_for_while(struct node *statement, char function_name[], int fra
 			ir_operand_label(continue_label, 0);
 			statement->ir = ir_append(statement->ir, continue_label);
 
-			// Evaluate the expression
-			ir_generate_for_expression(statement->data.while_loop.expr);
-			statement->ir = ir_concatenate(statement->ir, statement->data.while_loop.expr->ir);
-			result_op = node_get_result(statement->data.while_loop.expr)->ir_operand;
-			result_op = ir_convert_l_to_r(result_op, statement->ir, statement->data.while_loop.expr);
-
-
-			// Branch if false
-			branch_instruction = ir_instruction(IR_GOTO_IF_FALSE);
-			ir_operand_label(branch_instruction, 1);
-			ir_operand_copy(branch_instruction, 0, result_op);
-			ir_append(statement->ir, branch_instruction);
-
-			// Save the label just created (three lines above), so it can be passed to statements
-			ir_operand_copy(break_label, 0, &branch_instruction->operands[1]);
+			// Evaluate the expression, branching out if false
+			ir_operand_label(break_label, 0);
+			statement->ir = ir_generate_for_condition(statement->ir, statement->data.while_loop.expr, 0,
+					break_label->operands[0].data.label_name);
 
-			// Inside the loop
+			// Inside the loop, which starts the registers over after the test
+			statement->ir = ir_append_sequence_point(statement->ir);
 			ir_generate_for_statement(statement->data.while_loop.statement, function_name, continue_label, break_label, frame_size);
 			statement->ir = ir_concatenate(statement->ir, statement->data.while_loop.statement->ir);
 
@@ -1971,17 +3254,9 @@ void ir_generate_for_while(struct node *statement, char function_name[], int fra
 			ir_generate_for_statement(statement->data.while_loop.statement, function_name, continue_label, break_label, frame_size);
 			statement->ir = ir_concatenate(statement->ir, statement->data.while_loop.statement->ir);
 
-			// Evaluate the expression
-			ir_generate_for_expression(statement->data.while_loop.expr);
-			statement->ir = ir_concatenate(statement->ir, statement->data.while_loop.expr->ir);
-			result_op = node_get_result(statement->data.while_loop.expr)->ir_operand;
-			result_op = ir_convert_l_to_r(result_op, statement->ir, statement->data.while_loop.expr);
-
-			// Branch if true
-			branch_instruction = ir_instruction(IR_GOTO_IF_TRUE);
-			ir_operand_copy(branch_instruction, 0, result_op);
-			ir_operand_copy(branch_instruction, 1, &continue_label->operands[0]);
-			ir_append(statement->ir, branch_instruction);
+			// Evaluate the expression, branching back if true
+			statement->ir = ir_generate_for_condition(statement->ir, statement->data.while_loop.expr, 1,
+					continue_label->operands[0].data.label_name);
 
 			// Break label
 			ir_append(statement->ir, break_label);
@@ -2109,7 +3384,9 @@ void ir_generate_for_function_definition(struct node *statement) {
 	int overhead = 88;
 
 	// This function returns the number of bytes needing to be reserved on the stack frame
-	overhead = ir_set_symbol_table_offsets(table, overhead);
+	ir_frame_slots_len = 0;
+	ir_frame_scopes = 0;
+	overhead = ir_set_symbol_table_offsets(table, overhead, -1);
 	// That value needs to be rounded to the nearest doubleword
 	type->data.func.frame_size = ((overhead + 7) / 8) * 8;
 
@@ -2118,40 +3395,26 @@ void ir_generate_for_function_definition(struct node *statement) {
 	proc_begin->operands[0].kind = OPERAND_LABEL;
 	proc_begin->operands[0].data.label_name = function_name;
 	proc_begin->operands[1].kind = OPERAND_NUMBER;
-	proc_begin->operands[1].data.number = overhead;
+	proc_begin->operands[1].data.number = type->data.func.frame_size;
 	proc_begin->operands[2].kind = OPERAND_NUMBER;
 	proc_begin->operands[2].data.number = type->data.func.num_params;
 	statement->ir = ir_section(proc_begin, proc_begin);
 
-	struct symbol_list *iter;
-	for (iter = table->variables; NULL != iter; iter = iter->next)
-	{
-		if(iter->symbol.result.type->kind == TYPE_POINTER &&
-				iter->symbol.result.type->data.pointer.size > 1)
-		{
-			struct ir_instruction *load = ir_instruction(IR_ADDRESS_OF);
-			ir_operand_temporary(load, 0);
-			ir_operand_copy(load, 1, iter->symbol.result.offset);
-			statement->ir = ir_append(statement->ir, load);
-
-			struct ir_instruction *add = ir_instruction(IR_ADDI);
-			ir_operand_temporary(add, 0);
-			ir_operand_copy(add, 1, &load->operands[0]);
-			add->operands[2].kind = OPERAND_NUMBER;
-			add->operands[2].data.number = 4;
-			statement->ir = ir_append(statement->ir, add);
-
-			struct ir_instruction *store = ir_instruction(IR_STORE_WORD);
-			ir_operand_copy(store, 0, &add->operands[0]);
-			ir_operand_copy(store, 1, iter->symbol.result.offset);
-			statement->ir = ir_append(statement->ir, store);
-		}
-
-	}
+	struct ir_instruction *iter_instruction;
 
 	ir_generate_for_statement(statement->data.function_definition.compound, function_name, NULL, NULL, type->data.func.frame_size);
 	statement->ir = ir_concatenate(statement->ir, statement->data.function_definition.compound->ir);
 
+	// Now that every access to the frame is known, pack it again
+	overhead = frame_layout(function_name, statement->ir->first, statement->ir->last,
+			ir_frame_slots, ir_frame_slots_len, ir_frame_scope_parents, ir_frame_scopes, 88);
+	type->data.func.frame_size = ((overhead + 7) / 8) * 8;
+	proc_begin->operands[1].data.number = type->data.func.frame_size;
+	alias_analyze_function(statement->ir->first, statement->ir->last, ir_frame_slots, ir_frame_slots_len);
+	for (iter_instruction = statement->ir->first; iter_instruction != NULL; iter_instruction = iter_instruction->next)
+		if (iter_instruction->kind == IR_PROC_END)
+			iter_instruction->operands[1].data.number = type->data.func.frame_size;
+
 	// Proc end is either handled by the explicit return statement, or here, if there's
 	// only an implied return.
 	if(type->data.func.return_type->kind == TYPE_VOID)
@@ -2166,6 +3429,95 @@ void ir_generate_for_function_definition(struct node *statement) {
 	}
 }
 
+/* ir_add_global - adds an object to the list printed in the data section
+ *
+ * Parameters:
+ *   label - char * - the object's label
+ *   size - int - its size, in bytes
+ *   alignment - int - its alignment, in bytes
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void ir_add_global(char *label, int size, int alignment)
+{
+	struct ir_global *global;
+
+	ir_globals = realloc(ir_globals, sizeof(struct ir_global) * (ir_globals_len + 1));
+	assert(NULL != ir_globals);
+	global = &ir_globals[ir_globals_len++];
+	global->label = label;
+	global->size = size;
+	global->alignment = alignment;
+}
+
+/* ir_add_jump_table - adds a jump table to the list printed in the data section
+ *
+ * Parameters:
+ *   label - char * - the table's label
+ *   count - int - how many entries it has
+ *   targets - char ** - the label of each entry
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void ir_add_jump_table(char *label, int count, char **targets)
+{
+	struct ir_jump_table *table;
+
+	ir_jump_tables = realloc(ir_jump_tables, sizeof(struct ir_jump_table) * (ir_jump_tables_len + 1));
+	assert(NULL != ir_jump_tables);
+	table = &ir_jump_tables[ir_jump_tables_len++];
+	table->label = label;
+	table->count = count;
+	table->targets = targets;
+}
+
+/* ir_find_jump_table - the jump table with a label, or NULL */
+struct ir_jump_table *ir_find_jump_table(char *label)
+{
+	int i;
+
+	for(i = 0; i < ir_jump_tables_len; i++)
+		if(!strcmp(ir_jump_tables[i].label, label))
+			return &ir_jump_tables[i];
+	return NULL;
+}
+
+/* ir_generate_for_global_decl - gives each variable in a file-scope declaration
+ *   static storage, addressed through a label
+ *
+ * Parameters:
+ *   decl - node - the declaration
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void ir_generate_for_global_decl(struct node *decl)
+{
+	struct node *list_node;
+
+	for(list_node = decl->data.decl.init_decl_list; list_node != NULL; list_node = list_node->data.comma_list.next)
+	{
+		struct symbol *symbol = ir_get_symbol(list_node->data.comma_list.data);
+		char *label;
+
+		// Function prototypes need no storage
+		if(symbol == NULL || symbol->result.type->kind == TYPE_FUNCTION || symbol->result.offset != NULL)
+			continue;
+
+		label = malloc(strlen(symbol->name) + 16);
+		assert(NULL != label);
+		sprintf(label, "_Global_%s", symbol->name);
+		ir_add_global(label, ir_storage_size(symbol->result.type), ir_storage_alignment(symbol->result.type));
+
+		symbol->result.offset = malloc(sizeof(struct ir_operand));
+		assert(NULL != symbol->result.offset);
+		symbol->result.offset->kind = OPERAND_LABEL;
+		symbol->result.offset->data.label_name = label;
+	}
+}
+
 /* symbol_add_from_statement - just like add_from_expression, but for statements
  *
  * Parameters:
@@ -2188,6 +3540,12 @@ void ir_generate_for_statement(struct node *statement, char function_name[], str
     case NODE_CONDITIONAL:
       ir_generate_for_conditional(statement, function_name, cont, brk, frame_size);
       break;
+    case NODE_SWITCH:
+      ir_generate_for_switch(statement, function_name, cont, frame_size);
+      break;
+    case NODE_CASE:
+      ir_generate_for_case(statement, function_name, cont, brk, frame_size);
+      break;
     case NODE_WHILE:
       ir_generate_for_while(statement, function_name, frame_size);
       break;
@@ -2202,6 +3560,8 @@ void ir_generate_for_statement(struct node *statement, char function_name[], str
       ir_generate_for_function_definition(statement);
       break;
     case NODE_DECL:
+    	if(function_name == NULL)
+    		ir_generate_for_global_decl(statement);
     	dummy_instruction = ir_instruction(IR_NO_OPERATION);
     	statement->ir = ir_section(dummy_instruction, dummy_instruction);
       break;
@@ -2242,13 +3602,18 @@ void ir_generate_for_translation_unit(struct node *unit) {
   }
 }
 
+/* ir_garbage_collect - unlinks the code after an unconditional jump or return
+ *   that no label leads back into
+ */
 void ir_garbage_collect(struct ir_section *ir) {
 	struct ir_instruction *iter = ir->first;
 	struct ir_instruction *clip;
 	while(iter != NULL)
 	{
 		if((iter->kind == IR_PROC_END ||
-				iter->kind == IR_GOTO))
+				iter->kind == IR_GOTO ||
+				iter->kind == IR_GOTO_TABLE ||
+				iter->kind == IR_TAIL_CALL))
 		{
 			clip = iter;
 
@@ -2267,104 +3632,12 @@ void ir_garbage_collect(struct ir_section *ir) {
 	}
 }
 
-void ir_tail_recursion(struct ir_section *ir) {
-	struct ir_instruction *iter = ir->last;
-	struct ir_instruction *end;
-	char function_name[31];
-	int args[4];
-	int num_args = 0;
-
-	while(iter != NULL)
-	{
-		num_args = 0;
-
-		if(iter->kind == IR_RETURN)
-		{
-			if(iter->prev->kind == IR_RESULT_WORD)
-			{
-				// Save the next instruction
-				end = iter->next;
-				strcpy(function_name, end->operands[0].data.label_name);
-
-				// Cut out return and result instructions
-				// This should be the result word, which we cut
-				iter = iter->prev;
-				assert(iter->kind == IR_RESULT_WORD);
-				iter = iter->prev;
-
-				// Now we should be looking at the function call, itself
-				assert(iter->kind == IR_FUNCTION_CALL);
-				if(strcmp(function_name, iter->operands[0].data.label_name) != 0)
-					continue;
-
-				// Remove it, as well
-				iter->prev->next = end;
-				end->prev = iter->prev;
-				iter = iter->prev;
-
-				while(iter->kind != IR_PROC_BEGIN)
-				{
-					if(iter->kind == IR_PARAMETER)
-					{
-						int i = (int)iter->operands[0].data.number;
-						args[i] = iter->operands[1].data.temporary;
-
-						// Cut out the parameter instruction
-						iter->prev->next = iter->next;
-						iter->next->prev = iter->prev;
-						num_args++;
-					}
-					iter = iter->prev;
-				}
-				// Now we should have the proc begin, which is where we branch to
-				assert(iter->kind == IR_PROC_BEGIN);
-				{
-					// Insert label at top of function
-					struct ir_instruction *label = ir_instruction(IR_LABEL);
-					ir_operand_label(label, 0);
-					label->next = iter->next;
-					label->prev = iter;
-					iter->next->prev = label;
-					iter->next = label;
-
-					// Branch to top goes at the end
-					struct ir_instruction *branch = ir_instruction(IR_GOTO);
-					ir_operand_copy(branch, 0, &label->operands[0]);
-
-					struct ir_instruction *dummy = ir_instruction(IR_NO_OPERATION);
-					struct ir_section *sec = ir_section(dummy, dummy);
-
-					int j;
-					for(j = 0; j < num_args; j++)
-					{
-						struct ir_instruction *store = ir_instruction(IR_STORE_WORD);
-						store->operands[1].kind = OPERAND_LVALUE;
-						store->operands[1].data.offset = j * 4;
-						store->operands[0].kind = OPERAND_TEMPORARY;
-						store->operands[0].data.temporary = args[j];
-						sec = ir_append(sec, store);
-					}
-
-
-					sec->last->next = branch;
-					branch->prev = sec->last;
-
-					end->prev->next = sec->first;
-					sec->first->prev = end->prev;
-
-					branch->next = end;
-					end->prev = branch;
-				}
-			}
-		}
-		iter = iter->prev;
-	}
-}
-
+/* ir_generate_for_program - makes the IR for the whole program and runs the
+ *   IR passes over it; see pass.c
+ */
 void ir_generate_for_program(struct node *unit) {
 	ir_generate_for_translation_unit(unit);
-	ir_tail_recursion(unit->ir);
-	ir_garbage_collect(unit->ir);
+	pass_run_ir(unit->ir);
 }
 
 
@@ -2372,7 +3645,8 @@ void ir_generate_for_program(struct node *unit) {
  * PRINT INSTRUCTIONS *
  **********************/
 
-static void ir_print_opcode(FILE *output, int kind) {
+/* ir_opcode_name - the short name an instruction kind is printed with */
+char *ir_opcode_name(int kind) {
   static char *instruction_names[] = {
     NULL,
     "NOP",
@@ -2435,10 +3709,27 @@ static void ir_print_opcode(FILE *output, int kind) {
 	"SEQ_PT",
 	"PRT_S",
 	"ADDI",
+	"TAIL_CALL",
+	"MULH",
+	"MULHU",
+	"SHFT_RU",
+	"GOTO_EQ",
+	"GOTO_NE",
+	"GOTO_LT",
+	"GOTO_LE",
+	"GOTO_GT",
+	"GOTO_GE",
+	"GOTO_TAB",
+	"MOVN",
+	"MOVZ",
     NULL
   };
 
-  fprintf(output, "%-8s", instruction_names[kind]);
+  return instruction_names[kind];
+}
+
+static void ir_print_opcode(FILE *output, int kind) {
+  fprintf(output, "%-8s", ir_opcode_name(kind));
 }
 
 static void ir_print_operand(FILE *output, struct ir_operand *operand) {
@@ -2487,6 +3778,17 @@ void ir_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_MULU:
     case IR_DIVU:
     case IR_ADDI:
+    case IR_MULTIPLY_HIGH:
+    case IR_MULTIPLY_HIGH_U:
+    case IR_SHIFT_RIGHT_U:
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+    case IR_MOVE_IF_NOT_ZERO:
+    case IR_MOVE_IF_ZERO:
       ir_print_operand(output, &instruction->operands[0]);
       fprintf(output, ", ");
       ir_print_operand(output, &instruction->operands[1]);
@@ -2516,6 +3818,7 @@ void ir_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_WORD_TO_HALF_WORD:
     case IR_GOTO_IF_FALSE:
     case IR_GOTO_IF_TRUE:
+    case IR_GOTO_TABLE:
     case IR_PARAMETER:
       ir_print_operand(output, &instruction->operands[0]);
       fprintf(output, ", ");
@@ -2523,6 +3826,7 @@ void ir_print_instruction(FILE *output, struct ir_instruction *instruction) {
       break;
     case IR_PRINT_NUMBER:
     case IR_FUNCTION_CALL:
+    case IR_TAIL_CALL:
     case IR_RESULT_BYTE:
     case IR_RESULT_WORD:
     case IR_LABEL:
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+#include "alias.h"
+
 struct node;
 struct symbol;
 struct symbol_table;
@@ -86,14 +88,37 @@ struct ir_operand {
 #define IR_STORE_BYTE              55
 #define IR_STORE_HALF_WORD         56
 #define IR_STORE_WORD              57
+/* Temporaries after the first operand are numbered from the first register
+ * again; a number in the second says values from before stay in theirs */
 #define IR_SEQUENCE_PT             58
 #define IR_PRINT_STRING            59
 #define IR_ADDI                    60
+#define IR_TAIL_CALL               61
+/* High word of the 64-bit product */
+#define IR_MULTIPLY_HIGH           62
+#define IR_MULTIPLY_HIGH_U         63
+#define IR_SHIFT_RIGHT_U           64
+/* Compare the first two operands and branch to the label in the third */
+#define IR_GOTO_IF_EQUAL           65
+#define IR_GOTO_IF_NOT_EQUAL       66
+#define IR_GOTO_IF_LESS            67
+#define IR_GOTO_IF_LESS_EQUAL      68
+#define IR_GOTO_IF_GREATER         69
+#define IR_GOTO_IF_GREATER_EQUAL   70
+/* Jump to entry number (first operand) of the jump table labelled by the second */
+#define IR_GOTO_TABLE              71
+/* Copy the second operand into the first if the third is not zero, or is zero */
+#define IR_MOVE_IF_NOT_ZERO        72
+#define IR_MOVE_IF_ZERO            73
 
 struct ir_instruction {
   int kind;
   struct ir_instruction *prev, *next;
   struct ir_operand operands[3];
+  /* Times the instruction ran in the training run, or -1; see profile.c */
+  long profile_count;
+  /* What a load or store may touch; see alias.c */
+  struct alias_location alias;
 };
 
 struct ir_section {
@@ -101,13 +126,46 @@ struct ir_section {
 };
 
 void ir_print_section(FILE *output, struct ir_section *section);
+void ir_print_instruction(FILE *output, struct ir_instruction *instruction);
+char *ir_opcode_name(int kind);
 void ir_generate_for_program(struct node *node);
+void ir_garbage_collect(struct ir_section *ir);
+struct ir_instruction *ir_instruction(int kind);
+void ir_insert_before(struct ir_section *section, struct ir_instruction *position, struct ir_instruction *instruction);
+void ir_insert_after(struct ir_section *section, struct ir_instruction *position, struct ir_instruction *instruction);
+void ir_remove(struct ir_section *section, struct ir_instruction *instruction);
+void ir_operand_label(struct ir_instruction *instruction, int position);
+int ir_find_call_parameters(struct ir_instruction *call, struct ir_instruction *limit, struct ir_instruction **params);
+int ir_reserve_temporaries(int count);
 struct ir_operand *ir_convert_to_zero_one(struct ir_operand *result, struct ir_section *ir, int is_log_not);
 struct ir_operand *ir_convert_l_to_r(struct ir_operand *operand, struct ir_section *ir, struct node *id_node);
 
 
 extern FILE *error_output;
 extern int ir_generation_num_errors;
-extern char *string_labels[1000];
-extern int string_labels_len;
+extern long ir_instructions_made;
+/* A file-scope object with static storage */
+struct ir_global {
+  char *label;
+  int size;
+  int alignment;
+};
+
+void ir_add_global(char *label, int size, int alignment);
+
+extern struct ir_global *ir_globals;
+extern int ir_globals_len;
+
+/* The labels an IR_GOTO_TABLE picks from, printed in the data section */
+struct ir_jump_table {
+  char *label;
+  int count;
+  char **targets;
+};
+
+void ir_add_jump_table(char *label, int count, char **targets);
+struct ir_jump_table *ir_find_jump_table(char *label);
+
+extern struct ir_jump_table *ir_jump_tables;
+extern int ir_jump_tables_len;
 #endif
@@ -0,0 +1,853 @@
+/*
+ * jit.c
+ *
+ * Runs the program inside the compiler, for -s jit.  x86.c translates the IR
+ * as it does for -s x86-64, and instead of being printed for an assembler
+ * each instruction is encoded straight into memory, which is then made
+ * executable, and main is called.
+ *
+ * The IR's pointers are 32 bits wide, so everything is mapped with MAP_32BIT,
+ * below 2GB, the way x86.c has the program linked with -no-pie.  The string
+ * literals, the jump tables, the file-scope objects and the frame stack are
+ * in one mapping, laid out as x86_print_data has the assembler lay them out,
+ * and the code is in another, which is only made executable once all of it
+ * has been written.  Labels are placed in a first pass; every reference to a
+ * label is 32 bits wide, so how long an instruction is never depends on where
+ * anything is.
+ *
+ * Calls between the program's functions go straight to them.  The built-ins
+ * print_number, print_string and read_int are bound to functions of the
+ * compiler's own, in place of those x86_generate_runtime writes, and any
+ * other function the program calls is looked up with dlsym, which finds the
+ * C library the compiler is linked with.  The C library is too far away for a
+ * 32-bit displacement, so those calls go through a table of addresses after
+ * the code.
+ *
+ * The time from the IR to code that can run and the time the code takes to
+ * run are measured separately.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <dlfcn.h>
+
+#include "ir.h"
+#include "literal.h"
+#include "x86.h"
+#include "jit.h"
+
+int jit_num_errors;
+
+/* Code can only be run where it was written for */
+#if defined(__x86_64__) && defined(MAP_32BIT)
+#define JIT_HOST_SUPPORTED 1
+#else
+#define JIT_HOST_SUPPORTED 0
+#define MAP_32BIT 0
+#endif
+
+/* The longest instruction encoded, in bytes, for the listing */
+#define JIT_MAX_LENGTH 12
+
+/* How the operands of an instruction are encoded */
+#define JIT_FORM_NONE     1  /* the opcode alone */
+#define JIT_FORM_MOVE     2  /* mov of a word, half word or byte */
+#define JIT_FORM_ARITH    3  /* add, or, and, sub, xor and cmp, by the operation */
+#define JIT_FORM_TEST     4  /* register, register or memory */
+#define JIT_FORM_UNARY    5  /* not, neg, mul, imul, div and idiv of one operand */
+#define JIT_FORM_IMUL     6  /* imul of two operands, or of one */
+#define JIT_FORM_SHIFT    7  /* by a constant or by %cl */
+#define JIT_FORM_EXTEND   8  /* 0x0f opcode, register from register or memory */
+#define JIT_FORM_SET      9  /* 0x0f opcode, byte register */
+#define JIT_FORM_LEA     10
+#define JIT_FORM_STACK   11  /* push and pop, the register in the opcode */
+#define JIT_FORM_JUMP    12
+#define JIT_FORM_BRANCH  13
+#define JIT_FORM_CALL    14
+
+struct jit_opcode {
+  char *name;
+  int form;
+  int opcode;
+  /* Which operation of a group, in the reg field of the ModRM byte */
+  int extension;
+  /* Bytes operated on: 2 takes the operand size prefix, 8 takes REX.W */
+  int width;
+};
+
+static struct jit_opcode jit_opcodes[] = {
+  {"movl",    JIT_FORM_MOVE,   0x89, 0, 4},
+  {"movw",    JIT_FORM_MOVE,   0x89, 0, 2},
+  {"movb",    JIT_FORM_MOVE,   0x88, 0, 1},
+  {"addl",    JIT_FORM_ARITH,  0,    0, 4},
+  {"orl",     JIT_FORM_ARITH,  0,    1, 4},
+  {"andl",    JIT_FORM_ARITH,  0,    4, 4},
+  {"subl",    JIT_FORM_ARITH,  0,    5, 4},
+  {"xorl",    JIT_FORM_ARITH,  0,    6, 4},
+  {"cmpl",    JIT_FORM_ARITH,  0,    7, 4},
+  {"addq",    JIT_FORM_ARITH,  0,    0, 8},
+  {"subq",    JIT_FORM_ARITH,  0,    5, 8},
+  {"testl",   JIT_FORM_TEST,   0x85, 0, 4},
+  {"notl",    JIT_FORM_UNARY,  0xf7, 2, 4},
+  {"negl",    JIT_FORM_UNARY,  0xf7, 3, 4},
+  {"mull",    JIT_FORM_UNARY,  0xf7, 4, 4},
+  {"divl",    JIT_FORM_UNARY,  0xf7, 6, 4},
+  {"idivl",   JIT_FORM_UNARY,  0xf7, 7, 4},
+  {"imull",   JIT_FORM_IMUL,   0xaf, 5, 4},
+  {"shll",    JIT_FORM_SHIFT,  0,    4, 4},
+  {"shrl",    JIT_FORM_SHIFT,  0,    5, 4},
+  {"sarl",    JIT_FORM_SHIFT,  0,    7, 4},
+  {"movzbl",  JIT_FORM_EXTEND, 0xb6, 0, 4},
+  {"movzwl",  JIT_FORM_EXTEND, 0xb7, 0, 4},
+  {"movsbl",  JIT_FORM_EXTEND, 0xbe, 0, 4},
+  {"movswl",  JIT_FORM_EXTEND, 0xbf, 0, 4},
+  {"cmovel",  JIT_FORM_EXTEND, 0x44, 0, 4},
+  {"cmovnel", JIT_FORM_EXTEND, 0x45, 0, 4},
+  {"sete",    JIT_FORM_SET,    0x94, 0, 1},
+  {"setne",   JIT_FORM_SET,    0x95, 0, 1},
+  {"setl",    JIT_FORM_SET,    0x9c, 0, 1},
+  {"setge",   JIT_FORM_SET,    0x9d, 0, 1},
+  {"setle",   JIT_FORM_SET,    0x9e, 0, 1},
+  {"setg",    JIT_FORM_SET,    0x9f, 0, 1},
+  {"leal",    JIT_FORM_LEA,    0x8d, 0, 4},
+  {"leaq",    JIT_FORM_LEA,    0x8d, 0, 8},
+  {"pushq",   JIT_FORM_STACK,  0x50, 0, 8},
+  {"popq",    JIT_FORM_STACK,  0x58, 0, 8},
+  {"jmp",     JIT_FORM_JUMP,   0xe9, 4, 4},
+  {"je",      JIT_FORM_BRANCH, 0x84, 0, 4},
+  {"jne",     JIT_FORM_BRANCH, 0x85, 0, 4},
+  {"jl",      JIT_FORM_BRANCH, 0x8c, 0, 4},
+  {"jge",     JIT_FORM_BRANCH, 0x8d, 0, 4},
+  {"jle",     JIT_FORM_BRANCH, 0x8e, 0, 4},
+  {"jg",      JIT_FORM_BRANCH, 0x8f, 0, 4},
+  {"call",    JIT_FORM_CALL,   0xe8, 2, 4},
+  {"ret",     JIT_FORM_NONE,   0xc3, 0, 4},
+  {"cltd",    JIT_FORM_NONE,   0x99, 0, 4},
+  {NULL,      0,               0,    0, 0}
+};
+
+#define JIT_REGION_CODE 0
+#define JIT_REGION_DATA 1
+
+struct jit_label {
+  char *name;
+  int region;
+  uint32_t offset;
+};
+
+/* A function the program calls but does not define, and the slot in the
+ * table after the code its address is kept in */
+struct jit_import {
+  char *name;
+  uint64_t address;
+  /* "built-in" or "dlsym", for the listing */
+  char *bound_by;
+};
+
+static struct jit_label *jit_labels;
+static int jit_labels_len;
+static struct jit_import *jit_imports;
+static int jit_imports_len;
+
+static unsigned char *jit_regions[2];
+static uint32_t jit_region_sizes[2];
+/* Where the table of imported functions' addresses starts in the code */
+static uint32_t jit_imports_offset;
+
+/* The instructions, and where each one was encoded, with the end after them */
+static struct x86_section *jit_program;
+static uint32_t *jit_offsets;
+
+/* How much code has been encoded; only counted in the first pass, and written
+ * to jit_regions[JIT_REGION_CODE] as well in the second */
+static uint32_t jit_code_len;
+static int jit_writing;
+
+/* In milliseconds */
+static double jit_compile_time;
+static double jit_run_time;
+
+/****************************
+ * BUILT-INS                *
+ ****************************/
+
+/* The IR's addresses are zero-extended words, which the host takes as they are */
+static void jit_print_number(int number) {
+  printf("%d", number);
+}
+
+static void jit_print_string(uint32_t address) {
+  printf("%s", (char *)(uintptr_t)address);
+}
+
+static int jit_read_int(void) {
+  int number;
+
+  if (1 != scanf("%d", &number)) {
+    return 0;
+  }
+  return number;
+}
+
+static struct {
+  char *name;
+  void (*function)(void);
+} jit_builtins[] = {
+  {X86_PRINT_NUMBER_LABEL, (void (*)(void))jit_print_number},
+  {X86_PRINT_STRING_LABEL, (void (*)(void))jit_print_string},
+  {X86_READ_INT_LABEL,     (void (*)(void))jit_read_int},
+  {NULL,                   NULL}
+};
+
+/****************************
+ * LABELS                   *
+ ****************************/
+
+static double jit_now(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+static uint32_t jit_align(uint32_t offset, uint32_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/* jit_local - the local label x86.c turns the program's label into */
+static char *jit_local(char *label) {
+  char *local = malloc(strlen(label) + 3);
+  assert(NULL != local);
+  sprintf(local, ".L%s", label);
+  return local;
+}
+
+static void jit_add_label(char *name, int region, uint32_t offset) {
+  jit_labels = realloc(jit_labels, sizeof(struct jit_label) * (jit_labels_len + 1));
+  assert(NULL != jit_labels);
+  jit_labels[jit_labels_len].name = name;
+  jit_labels[jit_labels_len].region = region;
+  jit_labels[jit_labels_len++].offset = offset;
+}
+
+static int jit_compare_labels(const void *left, const void *right) {
+  return strcmp(((const struct jit_label *)left)->name, ((const struct jit_label *)right)->name);
+}
+
+/* jit_find_label - a label, once all of them have been added and sorted, or
+ *   NULL if the program does not define it
+ */
+static struct jit_label *jit_find_label(char *name) {
+  struct jit_label key;
+
+  key.name = name;
+  return bsearch(&key, jit_labels, jit_labels_len, sizeof(struct jit_label), jit_compare_labels);
+}
+
+/* jit_find_import - the imported function a call goes to, added in the first
+ *   pass if nothing calls it yet, or NULL if the program defines it
+ */
+static struct jit_import *jit_find_import(char *name) {
+  struct jit_label *label = jit_find_label(name);
+  int i;
+
+  if (NULL != label && label->region == JIT_REGION_CODE) {
+    return NULL;
+  }
+  for (i = 0; i < jit_imports_len; i++) {
+    if (!strcmp(jit_imports[i].name, name)) {
+      return &jit_imports[i];
+    }
+  }
+  assert(!jit_writing);
+  jit_imports = realloc(jit_imports, sizeof(struct jit_import) * (jit_imports_len + 1));
+  assert(NULL != jit_imports);
+  memset(&jit_imports[jit_imports_len], 0, sizeof(struct jit_import));
+  jit_imports[jit_imports_len].name = name;
+  return &jit_imports[jit_imports_len++];
+}
+
+/* jit_address - where a label is, once its region is mapped; unknown labels
+ *   are reported in the first pass
+ */
+static uint32_t jit_address(char *name) {
+  struct jit_label *label = jit_find_label(name);
+
+  if (NULL == label) {
+    if (!jit_writing) {
+      printf("ERROR - JIT: nothing is called %s\n", name);
+      jit_num_errors++;
+    }
+    return 0;
+  }
+  return (uint32_t)((uintptr_t)jit_regions[label->region] + label->offset);
+}
+
+/* jit_value - the number an immediate or a displacement stands for */
+static int64_t jit_value(struct x86_operand *operand) {
+  return operand->number + (NULL == operand->label ? 0 : (int64_t)jit_address(operand->label));
+}
+
+/****************************
+ * ENCODING                 *
+ ****************************/
+
+/* jit_put - encodes the low bytes of a value, least significant first */
+static void jit_put(int64_t value, int width) {
+  int i;
+
+  for (i = 0; i < width; i++) {
+    if (jit_writing) {
+      jit_regions[JIT_REGION_CODE][jit_code_len] = (unsigned char)(value >> (8 * i));
+    }
+    jit_code_len++;
+  }
+}
+
+/* jit_put_relative - encodes the 32-bit distance from the end of the field
+ *   to an offset in the code
+ */
+static void jit_put_relative(uint32_t offset) {
+  jit_put((int64_t)offset - (int64_t)(jit_code_len + 4), 4);
+}
+
+/* jit_encode_rm - encodes the prefixes, the opcode and the ModRM byte of an
+ *   instruction, then whatever SIB byte and displacement its register or
+ *   memory operand takes.  Any immediate is for the caller to put after.
+ *
+ * Parameters:
+ *   width - int - 2 for the operand size prefix, 8 for REX.W, else 1 or 4
+ *   opcode - int - one byte, or 0x0fxx for two
+ *   reg - int - a register, or which operation of a group
+ *   reg_byte - int - "true" if reg is a register's low byte
+ *   rm - x86_operand - a register, or memory
+ */
+static void jit_encode_rm(int width, int opcode, int reg, int reg_byte, struct x86_operand *rm) {
+  int rex = 0, mod, field, sib = -1, displacement_size = 0, index;
+  int64_t displacement = 0;
+
+  // Without a REX prefix, byte registers 4 to 7 are %ah to %bh, not %spl to %dil
+  if (8 == width) {
+    rex |= 0x48;
+  }
+  if (reg & 8) {
+    rex |= 0x44;
+  }
+  if (reg_byte && reg >= 4) {
+    rex |= 0x40;
+  }
+
+  if (rm->kind == X86_OPERAND_REGISTER) {
+    if (rm->reg & 8) {
+      rex |= 0x41;
+    }
+    if (1 == rm->width && rm->reg >= 4) {
+      rex |= 0x40;
+    }
+    mod = 3;
+    field = rm->reg & 7;
+  } else {
+    displacement = jit_value(rm);
+    index = rm->index >= 0 ? rm->index : X86_REGISTER_RSP;
+    if (rm->index >= 0) {
+      rex |= (rm->index & 8) ? 0x42 : 0;
+      sib = (rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0) << 6;
+    } else {
+      sib = 0;
+    }
+    sib |= (index & 7) << 3;
+
+    if (rm->reg < 0) {
+      // An address with no base takes a SIB byte, as ModRM alone would make it from %rip
+      mod = 0;
+      field = 4;
+      sib |= 5;
+      displacement_size = 4;
+    } else {
+      if (rm->reg & 8) {
+        rex |= 0x41;
+      }
+      // A label's displacement is always a word, so it is the same size in both passes
+      if (NULL != rm->label || displacement < -128 || displacement > 127) {
+        mod = 2;
+        displacement_size = 4;
+      } else if (0 != displacement || 5 == (rm->reg & 7)) {
+        mod = 1;
+        displacement_size = 1;
+      } else {
+        mod = 0;
+      }
+      if (rm->index >= 0 || 4 == (rm->reg & 7)) {
+        field = 4;
+        sib |= rm->reg & 7;
+      } else {
+        field = rm->reg & 7;
+        sib = -1;
+      }
+    }
+  }
+
+  if (2 == width) {
+    jit_put(0x66, 1);
+  }
+  if (rex) {
+    jit_put(rex, 1);
+  }
+  if (opcode > 0xff) {
+    jit_put(opcode >> 8, 1);
+  }
+  jit_put(opcode & 0xff, 1);
+  jit_put((mod << 6) | ((reg & 7) << 3) | field, 1);
+  if (sib >= 0) {
+    jit_put(sib, 1);
+  }
+  jit_put(displacement, displacement_size);
+}
+
+/* jit_encode_immediate - encodes an operation on a constant, as a byte if it
+ *   fits in one and is not a label
+ *
+ * Parameters:
+ *   width - int - as for jit_encode_rm
+ *   short_opcode, long_opcode - int - the opcodes for a byte and for a word
+ *   reg - int - a register, or which operation of a group
+ *   rm - x86_operand - a register, or memory
+ *   immediate - x86_operand - the constant
+ */
+static void jit_encode_immediate(int width, int short_opcode, int long_opcode, int reg, struct x86_operand *rm,
+                                 struct x86_operand *immediate) {
+  int64_t value = jit_value(immediate);
+
+  if (NULL == immediate->label && value >= -128 && value <= 127) {
+    jit_encode_rm(width, short_opcode, reg, 0, rm);
+    jit_put(value, 1);
+  } else {
+    jit_encode_rm(width, long_opcode, reg, 0, rm);
+    jit_put(value, 4);
+  }
+}
+
+/* jit_encode_transfer - encodes a jump or call: to a label in the code
+ *   relative to the instruction, or to an imported function through its slot
+ *   relative to %rip
+ */
+static void jit_encode_transfer(struct jit_opcode *opcode, struct x86_operand *target) {
+  struct jit_import *import;
+  struct jit_label *label;
+
+  if (target->kind == X86_OPERAND_INDIRECT) {
+    jit_encode_rm(4, 0xff, opcode->extension, 0, target);
+    return;
+  }
+  import = jit_find_import(target->label);
+  if (NULL != import) {
+    jit_put(0xff, 1);
+    jit_put((opcode->extension << 3) | 5, 1);
+    jit_put_relative(jit_imports_offset + 8 * (uint32_t)(import - jit_imports));
+    return;
+  }
+  label = jit_find_label(target->label);
+  jit_put(opcode->opcode, 1);
+  jit_put_relative(label->offset);
+}
+
+static struct jit_opcode *jit_find_opcode(char *name) {
+  int i;
+
+  for (i = 0; NULL != jit_opcodes[i].name; i++) {
+    if (!strcmp(jit_opcodes[i].name, name)) {
+      return &jit_opcodes[i];
+    }
+  }
+  return NULL;
+}
+
+/* jit_encode - encodes one instruction, in whichever of the forms x86.c uses
+ *   its operands are
+ *
+ * Parameters:
+ *   instruction - x86_instruction - an operation
+ */
+static void jit_encode(struct x86_instruction *instruction) {
+  struct jit_opcode *opcode = jit_find_opcode(instruction->opcode);
+  struct x86_operand *source = &instruction->operands[0], *destination = &instruction->operands[1];
+  struct jit_label *label;
+
+  if (NULL == opcode) {
+    if (!jit_writing) {
+      printf("ERROR - JIT: cannot encode %s\n", instruction->opcode);
+      jit_num_errors++;
+    }
+    return;
+  }
+
+  switch (opcode->form) {
+    case JIT_FORM_NONE:
+      jit_put(opcode->opcode, 1);
+      break;
+
+    case JIT_FORM_MOVE:
+      if (source->kind == X86_OPERAND_IMMEDIATE) {
+        if (destination->kind == X86_OPERAND_REGISTER && 4 == opcode->width) {
+          if (destination->reg & 8) {
+            jit_put(0x41, 1);
+          }
+          jit_put(0xb8 + (destination->reg & 7), 1);
+        } else {
+          jit_encode_rm(opcode->width, 1 == opcode->width ? 0xc6 : 0xc7, 0, 0, destination);
+        }
+        jit_put(jit_value(source), opcode->width);
+      } else if (source->kind == X86_OPERAND_REGISTER) {
+        jit_encode_rm(opcode->width, opcode->opcode, source->reg, 1 == opcode->width, destination);
+      } else {
+        jit_encode_rm(opcode->width, opcode->opcode + 2, destination->reg, 1 == opcode->width, source);
+      }
+      break;
+
+    case JIT_FORM_ARITH:
+      if (source->kind == X86_OPERAND_IMMEDIATE) {
+        jit_encode_immediate(opcode->width, 0x83, 0x81, opcode->extension, destination, source);
+      } else if (source->kind == X86_OPERAND_REGISTER) {
+        jit_encode_rm(opcode->width, 8 * opcode->extension + 1, source->reg, 0, destination);
+      } else {
+        jit_encode_rm(opcode->width, 8 * opcode->extension + 3, destination->reg, 0, source);
+      }
+      break;
+
+    case JIT_FORM_TEST:
+      jit_encode_rm(opcode->width, opcode->opcode, source->reg, 0, destination);
+      break;
+
+    case JIT_FORM_UNARY:
+      jit_encode_rm(opcode->width, opcode->opcode, opcode->extension, 0, source);
+      break;
+
+    case JIT_FORM_IMUL:
+      if (1 == instruction->num_operands) {
+        jit_encode_rm(opcode->width, 0xf7, opcode->extension, 0, source);
+      } else if (source->kind == X86_OPERAND_IMMEDIATE) {
+        jit_encode_immediate(opcode->width, 0x6b, 0x69, destination->reg, destination, source);
+      } else {
+        jit_encode_rm(opcode->width, 0x0f00 | opcode->opcode, destination->reg, 0, source);
+      }
+      break;
+
+    case JIT_FORM_SHIFT:
+      if (source->kind == X86_OPERAND_IMMEDIATE) {
+        jit_encode_rm(opcode->width, 0xc1, opcode->extension, 0, destination);
+        jit_put(jit_value(source), 1);
+      } else {
+        jit_encode_rm(opcode->width, 0xd3, opcode->extension, 0, destination);
+      }
+      break;
+
+    case JIT_FORM_EXTEND:
+      jit_encode_rm(opcode->width, 0x0f00 | opcode->opcode, destination->reg, 0, source);
+      break;
+
+    case JIT_FORM_SET:
+      jit_encode_rm(opcode->width, 0x0f00 | opcode->opcode, 0, 0, source);
+      break;
+
+    case JIT_FORM_LEA:
+      jit_encode_rm(opcode->width, opcode->opcode, destination->reg, 0, source);
+      break;
+
+    case JIT_FORM_STACK:
+      if (source->reg & 8) {
+        jit_put(0x41, 1);
+      }
+      jit_put(opcode->opcode + (source->reg & 7), 1);
+      break;
+
+    case JIT_FORM_JUMP:
+    case JIT_FORM_CALL:
+      jit_encode_transfer(opcode, source);
+      break;
+
+    case JIT_FORM_BRANCH:
+      label = jit_find_label(source->label);
+      if (NULL == label || label->region != JIT_REGION_CODE) {
+        if (!jit_writing) {
+          printf("ERROR - JIT: %s goes to %s, which is not in the program\n", opcode->name, source->label);
+          jit_num_errors++;
+        }
+        jit_put(0, 6);
+        break;
+      }
+      jit_put(0x0f, 1);
+      jit_put(opcode->opcode, 1);
+      jit_put_relative(label->offset);
+      break;
+  }
+}
+
+/****************************
+ * MEMORY                   *
+ ****************************/
+
+/* jit_map - maps memory below 2GB that can be read and written, or reports
+ *   why it could not
+ */
+static unsigned char *jit_map(uint32_t size) {
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+  if (MAP_FAILED == memory) {
+    printf("ERROR - JIT: could not map %u bytes: %s\n", size, strerror(errno));
+    jit_num_errors++;
+    return NULL;
+  }
+  return memory;
+}
+
+/* jit_layout_data - maps the data and puts the string literals in it; the
+ *   rest starts out zero, as .bss does
+ */
+static void jit_layout_data(void) {
+  char *strings;
+  uint32_t size = (uint32_t)literal_layout(&strings), strings_size = size;
+  int i;
+
+  jit_add_label(X86_STRINGS_LABEL, JIT_REGION_DATA, 0);
+  for (i = 0; i < ir_jump_tables_len; i++) {
+    size = jit_align(size, 8);
+    jit_add_label(jit_local(ir_jump_tables[i].label), JIT_REGION_DATA, size);
+    size += 8 * ir_jump_tables[i].count;
+  }
+  for (i = 0; i < ir_globals_len; i++) {
+    size = jit_align(size, ir_globals[i].alignment > 0 ? ir_globals[i].alignment : 1);
+    jit_add_label(jit_local(ir_globals[i].label), JIT_REGION_DATA, size);
+    size += ir_globals[i].size;
+  }
+  size = jit_align(size, 16);
+  jit_add_label(X86_STACK_LABEL, JIT_REGION_DATA, size);
+  size += X86_STACK_SIZE;
+
+  jit_region_sizes[JIT_REGION_DATA] = size;
+  jit_regions[JIT_REGION_DATA] = jit_map(size);
+  if (NULL != jit_regions[JIT_REGION_DATA]) {
+    memcpy(jit_regions[JIT_REGION_DATA], strings, strings_size);
+  }
+  free(strings);
+}
+
+/* jit_fill_jump_tables - puts the address of each case in the jump tables,
+ *   once the code is mapped
+ */
+static void jit_fill_jump_tables(void) {
+  struct jit_label *table, *target;
+  uint64_t address;
+  int i, j;
+
+  for (i = 0; i < ir_jump_tables_len; i++) {
+    table = jit_find_label(jit_local(ir_jump_tables[i].label));
+    for (j = 0; j < ir_jump_tables[i].count; j++) {
+      target = jit_find_label(jit_local(ir_jump_tables[i].targets[j]));
+      if (NULL == target) {
+        printf("ERROR - JIT: jump table %s goes to %s, which is not in the program\n", ir_jump_tables[i].label,
+               ir_jump_tables[i].targets[j]);
+        jit_num_errors++;
+        continue;
+      }
+      address = (uintptr_t)jit_regions[JIT_REGION_CODE] + target->offset;
+      memcpy(jit_regions[JIT_REGION_DATA] + table->offset + 8 * j, &address, 8);
+    }
+  }
+}
+
+/* jit_bind_imports - puts the address of each function the program calls but
+ *   does not define in its slot: one of the built-ins, or else whatever
+ *   dlsym finds
+ */
+static void jit_bind_imports(void) {
+  struct jit_import *import;
+  void *symbol;
+  int i, j;
+
+  for (i = 0; i < jit_imports_len; i++) {
+    import = &jit_imports[i];
+    for (j = 0; NULL != jit_builtins[j].name; j++) {
+      if (!strcmp(jit_builtins[j].name, import->name)) {
+        import->address = (uintptr_t)jit_builtins[j].function;
+        import->bound_by = "built-in";
+      }
+    }
+    if (NULL == import->bound_by) {
+      symbol = dlsym(RTLD_DEFAULT, import->name);
+      if (NULL == symbol) {
+        printf("ERROR - JIT: %s is not defined anywhere\n", import->name);
+        jit_num_errors++;
+        continue;
+      }
+      import->address = (uintptr_t)symbol;
+      import->bound_by = "dlsym";
+    }
+    memcpy(jit_regions[JIT_REGION_CODE] + jit_imports_offset + 8 * i, &import->address, 8);
+  }
+}
+
+/****************************
+ * COMPILING AND RUNNING    *
+ ****************************/
+
+/* jit_compile - translates the program and encodes it into memory that can
+ *   be run
+ *
+ * Parameters:
+ *   section - ir_section - all the instructions
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap, and is mapped for the code and data.
+ */
+void jit_compile(struct ir_section *section) {
+  double start = jit_now();
+  struct x86_instruction *instruction;
+  int i, count = 0;
+
+  jit_num_errors = 0;
+  if (!JIT_HOST_SUPPORTED) {
+    printf("ERROR - JIT: code can only be run on an x86-64 host\n");
+    jit_num_errors++;
+    return;
+  }
+  jit_program = x86_generate_program(section);
+  if (x86_num_errors > 0) {
+    jit_num_errors += x86_num_errors;
+    return;
+  }
+
+  jit_layout_data();
+  for (instruction = jit_program->first; NULL != instruction; instruction = instruction->next) {
+    if (instruction->kind == X86_INSTRUCTION_LABEL) {
+      jit_add_label(instruction->operands[0].label, JIT_REGION_CODE, 0);
+    }
+    count++;
+  }
+  qsort(jit_labels, jit_labels_len, sizeof(struct jit_label), jit_compare_labels);
+  if (jit_num_errors > 0) {
+    return;
+  }
+
+  // Place the labels and find out which functions come from elsewhere
+  jit_writing = 0;
+  jit_code_len = 0;
+  for (instruction = jit_program->first; NULL != instruction; instruction = instruction->next) {
+    if (instruction->kind == X86_INSTRUCTION_LABEL) {
+      jit_find_label(instruction->operands[0].label)->offset = jit_code_len;
+    } else {
+      jit_encode(instruction);
+    }
+  }
+  if (jit_num_errors > 0) {
+    return;
+  }
+
+  jit_imports_offset = jit_align(jit_code_len, 8);
+  jit_region_sizes[JIT_REGION_CODE] = jit_imports_offset + 8 * jit_imports_len;
+  jit_regions[JIT_REGION_CODE] = jit_map(jit_region_sizes[JIT_REGION_CODE]);
+  if (NULL == jit_regions[JIT_REGION_CODE]) {
+    return;
+  }
+  jit_bind_imports();
+  jit_fill_jump_tables();
+  if (jit_num_errors > 0) {
+    return;
+  }
+
+  jit_offsets = calloc(count + 1, sizeof(uint32_t));
+  assert(NULL != jit_offsets);
+  jit_writing = 1;
+  jit_code_len = 0;
+  for (instruction = jit_program->first, i = 0; NULL != instruction; instruction = instruction->next, i++) {
+    jit_offsets[i] = jit_code_len;
+    if (instruction->kind == X86_INSTRUCTION_LABEL) {
+      assert(jit_find_label(instruction->operands[0].label)->offset == jit_code_len);
+    } else {
+      jit_encode(instruction);
+    }
+  }
+  jit_offsets[count] = jit_code_len;
+
+  if (0 != mprotect(jit_regions[JIT_REGION_CODE], jit_region_sizes[JIT_REGION_CODE], PROT_READ | PROT_EXEC)) {
+    printf("ERROR - JIT: could not make the code executable: %s\n", strerror(errno));
+    jit_num_errors++;
+    return;
+  }
+  jit_compile_time = jit_now() - start;
+}
+
+static void jit_print_bytes(FILE *output, uint32_t at, uint32_t end) {
+  fprintf(output, "%08x ", at);
+  for (; at < end; at++) {
+    fprintf(output, "%02x", jit_regions[JIT_REGION_CODE][at]);
+  }
+}
+
+/* jit_print_listing - prints the code as it was encoded, then the table of
+ *   imported functions' addresses
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void jit_print_listing(FILE *output) {
+  struct x86_instruction *instruction;
+  uint32_t length;
+  int i;
+
+  for (instruction = jit_program->first, i = 0; NULL != instruction; instruction = instruction->next, i++) {
+    if (instruction->kind == X86_INSTRUCTION_LABEL) {
+      fprintf(output, "\n%s:\n", instruction->operands[0].label);
+      continue;
+    }
+    length = jit_offsets[i + 1] - jit_offsets[i];
+    jit_print_bytes(output, jit_offsets[i], jit_offsets[i + 1]);
+    fprintf(output, "%*s", 2 * (JIT_MAX_LENGTH - (int)length), "");
+    x86_print_instruction(output, instruction);
+  }
+
+  if (jit_imports_len > 0) {
+    fputs("\n", output);
+  }
+  for (i = 0; i < jit_imports_len; i++) {
+    jit_print_bytes(output, jit_imports_offset + 8 * i, jit_imports_offset + 8 * (i + 1));
+    fprintf(output, "%*s\t.quad\t%s\t# %s\n", 2 * (JIT_MAX_LENGTH - 8), "", jit_imports[i].name,
+            jit_imports[i].bound_by);
+  }
+}
+
+/* jit_run - calls main, which the program's output goes to stdout from, then
+ *   gives back the memory the program was in
+ */
+void jit_run(void) {
+  int (*entry)(void) = (int (*)(void))(uintptr_t)jit_address("main");
+  double start = jit_now();
+
+  entry();
+  fflush(stdout);
+  jit_run_time = jit_now() - start;
+
+  munmap(jit_regions[JIT_REGION_CODE], jit_region_sizes[JIT_REGION_CODE]);
+  munmap(jit_regions[JIT_REGION_DATA], jit_region_sizes[JIT_REGION_DATA]);
+}
+
+/* jit_print_report - prints how long the code took to get ready and to run,
+ *   and how big it was
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void jit_print_report(FILE *output) {
+  fprintf(output, "%-10s %12.3f ms\n", "compile", jit_compile_time);
+  fprintf(output, "%-10s %12.3f ms\n", "run", jit_run_time);
+  fprintf(output, "%-10s %12u bytes\n", "code", jit_code_len);
+  fprintf(output, "%-10s %12u bytes\n", "data", jit_region_sizes[JIT_REGION_DATA] - X86_STACK_SIZE);
+  fprintf(output, "%-10s %12d\n", "imports", jit_imports_len);
+}
@@ -0,0 +1,15 @@
+#ifndef _JIT_H
+#define _JIT_H
+
+#include <stdio.h>
+
+struct ir_section;
+
+void jit_compile(struct ir_section *section);
+void jit_print_listing(FILE *output);
+void jit_run(void);
+void jit_print_report(FILE *output);
+
+extern int jit_num_errors;
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * layout.c
+ *
+ * Basic block placement.  IR generation lays blocks out in source order, so
+ * an early return sits in the middle of the code around it and the common
+ * side of a branch may be the one that jumps.  This pass reorders the blocks
+ * of each function in the manner of Pettis and Hansen:
+ *
+ *   - every CFG edge gets a weight: how often it was taken in the training
+ *     run when there is a profile, or else an estimate.  Loop bodies are
+ *     taken to run LAYOUT_LOOP_SCALE times per entry, back edges to be taken,
+ *     and loop exits and branches to a return not;
+ *   - going through the forward edges heaviest first, the two blocks of an
+ *     edge are joined into one chain if the first ends a chain and the second
+ *     starts one, so hot paths fall through.  Back edges are left alone, as
+ *     loop rotation has already made them the branches at the bottom;
+ *   - the entry's chain goes first, then each time the chain most strongly
+ *     tied to those already placed; and
+ *   - cold blocks, ones that never ran or that return early, form chains of
+ *     their own that go at the end of the function.
+ *
+ * Branches are fixed up afterwards.  A conditional branch whose target now
+ * follows it is inverted, and a jump is added wherever a block used to fall
+ * through into one that no longer follows it.  Registers are numbered from
+ * the last sequence point before an instruction, so a block that now comes
+ * after different code starts with a sequence point restoring its numbering.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "ir.h"
+#include "cfg.h"
+#include "branch.h"
+#include "profile.h"
+#include "layout.h"
+#include "pass.h"
+
+int layout_enabled = 1;
+int layout_split_cold = 1;
+
+struct layout_block {
+  struct cfg_block *block;
+  /* Where control went from the block before it was moved */
+  struct cfg_block *fall, *target;
+  long count, frequency;
+  int depth;
+  int cold;
+  int preds, unlikely_preds;
+  /* Register numbering at the start and end of the block, as sequence points */
+  int region_in, region_out;
+  /* First block of the block's chain, and the next block in it */
+  int chain, next;
+  int placed;
+};
+
+struct layout_edge {
+  int from, to;
+  long weight;
+  /* Whether the edge goes to the next block in program order */
+  int falls;
+};
+
+/*********************
+ * WEIGHING EDGES    *
+ *********************/
+
+/* layout_ends_function - whether a block leaves the function */
+static int layout_ends_function(struct cfg_block *block) {
+  return block->last->kind == IR_PROC_END || block->last->kind == IR_TAIL_CALL;
+}
+
+/* layout_in_loop_without - whether some loop holds one block but not another
+ *
+ * Parameters:
+ *   blocks - layout_block - the function's blocks
+ *   count - int - how many there are
+ *   inside - int - the block in the loop
+ *   outside - int - the other block
+ */
+static int layout_in_loop_without(struct layout_block *blocks, int count, int inside, int outside) {
+  int i;
+  for (i = inside; i < count; i++) {
+    struct cfg_block *target = blocks[i].target;
+    // A back edge from i to target->id spans a loop
+    if (NULL != target && target->id <= inside &&
+        (outside < target->id || outside > i)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* layout_probability - guesses, in eighths, how often a two-way branch goes
+ *   to one of its successors
+ *
+ * Parameters:
+ *   blocks - layout_block - the function's blocks
+ *   count - int - how many there are
+ *   from - int - the block ending in the branch
+ *   to - int - the successor
+ *   other - int - the other successor
+ *   unlikely - int * - set if the edge looks like an early return
+ */
+static int layout_probability(struct layout_block *blocks, int count, int from, int to, int other, int *unlikely) {
+  int back = to <= from, other_back = other <= from;
+  int exits = layout_in_loop_without(blocks, count, from, to);
+  int other_exits = layout_in_loop_without(blocks, count, from, other);
+  int returns = layout_ends_function(blocks[to].block);
+  int other_returns = layout_ends_function(blocks[other].block);
+
+  *unlikely = 0;
+  if (back != other_back) {
+    return back ? 7 : 1;
+  }
+  if (exits != other_exits) {
+    return exits ? 1 : 7;
+  }
+  if (returns != other_returns) {
+    *unlikely = returns;
+    return returns ? 2 : 6;
+  }
+  return 4;
+}
+
+/* layout_add_edge - weighs one edge and adds it to the list
+ *
+ * Parameters:
+ *   blocks - layout_block - the function's blocks
+ *   count - int - how many there are
+ *   edges - layout_edge - the list
+ *   num_edges - int * - how many edges there are so far
+ *   from - cfg_block - block the edge leaves
+ *   to - cfg_block - block it enters
+ *   other - cfg_block - the branch's other successor, or NULL
+ */
+static void layout_add_edge(struct layout_block *blocks, int count, struct layout_edge *edges, int *num_edges,
+                            struct cfg_block *from, struct cfg_block *to, struct cfg_block *other) {
+  struct layout_edge *edge = &edges[(*num_edges)++];
+  struct layout_block *source = &blocks[from->id], *sink = &blocks[to->id];
+  int eighths = 8, unlikely = 0;
+
+  if (NULL != other && other != to) {
+    eighths = layout_probability(blocks, count, from->id, to->id, other->id, &unlikely);
+  }
+  edge->from = from->id;
+  edge->to = to->id;
+  edge->falls = to->id == from->id + 1;
+  if (source->count >= 0 && sink->count >= 0) {
+    edge->weight = source->count < sink->count ? source->count : sink->count;
+  } else {
+    edge->weight = source->frequency * eighths;
+  }
+
+  sink->preds++;
+  sink->unlikely_preds += unlikely;
+}
+
+/* layout_compare_edges - orders edges heaviest first, for qsort.  Between
+ *   equals, an edge to the next block in program order wins, so without
+ *   anything to go on the blocks stay where they are.
+ */
+static int layout_compare_edges(const void *left, const void *right) {
+  const struct layout_edge *a = left, *b = right;
+  if (a->weight != b->weight) {
+    return a->weight > b->weight ? -1 : 1;
+  }
+  if (a->falls != b->falls) {
+    return b->falls - a->falls;
+  }
+  return a->from - b->from;
+}
+
+/*********************
+ * PLACING BLOCKS    *
+ *********************/
+
+/* layout_join - appends one chain to another */
+static void layout_join(struct layout_block *blocks, int from, int to) {
+  int head = blocks[from].chain, iter;
+
+  blocks[from].next = to;
+  for (iter = to; -1 != iter; iter = blocks[iter].next) {
+    blocks[iter].chain = head;
+  }
+}
+
+/* layout_place_chain - adds a chain to the new order */
+static void layout_place_chain(struct layout_block *blocks, int head, int *order, int *placed) {
+  int iter;
+  for (iter = head; -1 != iter; iter = blocks[iter].next) {
+    blocks[iter].placed = 1;
+    order[(*placed)++] = iter;
+  }
+}
+
+/* layout_order - works out the new order of a function's blocks
+ *
+ * Parameters:
+ *   blocks - layout_block - the function's blocks
+ *   count - int - how many there are
+ *   edges - layout_edge - their edges, heaviest first
+ *   num_edges - int - how many there are
+ *   order - int * - filled in with block numbers in their new order
+ */
+static void layout_order(struct layout_block *blocks, int count, struct layout_edge *edges, int num_edges,
+                         int *order) {
+  int placed = 0, i, cold;
+
+  for (i = 0; i < num_edges; i++) {
+    struct layout_edge *edge = &edges[i];
+    // The entry stays first, loops keep the test at the bottom that rotation
+    // gave them, and hot and cold code stay apart
+    if (edge->to <= edge->from ||
+        (layout_split_cold && blocks[edge->from].cold != blocks[edge->to].cold)) {
+      continue;
+    }
+    if (-1 == blocks[edge->from].next && blocks[edge->to].chain == edge->to &&
+        blocks[edge->from].chain != edge->to) {
+      layout_join(blocks, edge->from, edge->to);
+    }
+  }
+
+  layout_place_chain(blocks, 0, order, &placed);
+  for (cold = 0; cold <= 1; cold++) {
+    while (placed < count) {
+      long best_weight = -1, weight;
+      int best = -1, j;
+
+      for (i = 0; i < count; i++) {
+        if (blocks[i].chain != i || blocks[i].placed || (layout_split_cold && blocks[i].cold != cold)) {
+          continue;
+        }
+        weight = 0;
+        for (j = 0; j < num_edges; j++) {
+          if (blocks[edges[j].from].placed && blocks[edges[j].to].chain == i) {
+            weight += edges[j].weight;
+          }
+        }
+        if (weight > best_weight) {
+          best_weight = weight;
+          best = i;
+        }
+      }
+      if (-1 == best) {
+        break;
+      }
+      layout_place_chain(blocks, best, order, &placed);
+    }
+  }
+  assert(placed == count);
+}
+
+/*********************
+ * REWRITING         *
+ *********************/
+
+/* layout_label - the label starting a block, made if it has none
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   block - cfg_block - the block
+ *
+ * Returns the label operand
+ */
+static struct ir_operand *layout_label(struct ir_section *section, struct cfg_block *block) {
+  if (block->first->kind != IR_LABEL) {
+    struct ir_instruction *label = ir_instruction(IR_LABEL);
+    ir_operand_label(label, 0);
+    ir_insert_before(section, block->first, label);
+    block->first = label;
+  }
+  return &block->first->operands[0];
+}
+
+/* layout_sequence_point - starts a block with the register numbering it had
+ *   before it was moved
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   block - cfg_block - the block
+ *   region - int - the numbering, as the operand of a sequence point
+ */
+static void layout_sequence_point(struct ir_section *section, struct cfg_block *block, int region) {
+  struct ir_instruction *sequence_point = ir_instruction(IR_SEQUENCE_PT);
+  sequence_point->operands[0].kind = OPERAND_TEMPORARY;
+  sequence_point->operands[0].data.temporary = region;
+
+  if (block->first->kind == IR_LABEL) {
+    ir_insert_after(section, block->first, sequence_point);
+    if (block->last == block->first) {
+      block->last = sequence_point;
+    }
+  } else {
+    ir_insert_before(section, block->first, sequence_point);
+    block->first = sequence_point;
+  }
+}
+
+/* layout_fix_branches - makes control leave a block for the same places it
+ *   did before the blocks were moved
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   source - layout_block - the block
+ *   next - cfg_block - the block that now follows it, or NULL
+ */
+static void layout_fix_branches(struct ir_section *section, struct layout_block *source, struct cfg_block *next) {
+  struct cfg_block *block = source->block;
+  struct ir_instruction *last = block->last, *jump;
+
+  // Code nothing reaches can go anywhere
+  if (0 == source->preds && 0 != block->id) {
+    return;
+  }
+  if (last->kind == IR_GOTO && NULL != source->target && source->target == next && block->first != last) {
+    block->last = last->prev;
+    ir_remove(section, last);
+    return;
+  }
+  if (NULL == source->fall || source->fall == next) {
+    return;
+  }
+  if (NULL != source->target && source->target == next && 0 != branch_inverse(last->kind)) {
+    last->kind = branch_inverse(last->kind);
+    *cfg_branch_label(last) = *layout_label(section, source->fall);
+    return;
+  }
+  jump = ir_instruction(IR_GOTO);
+  jump->operands[0] = *layout_label(section, source->fall);
+  ir_insert_after(section, last, jump);
+  block->last = jump;
+}
+
+/* layout_function - reorders the blocks of one function
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   graph - cfg - the function
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void layout_function(struct ir_section *section, struct cfg *graph) {
+  int count = graph->num_blocks, num_edges = 0, region = -1, i, j, moved = 0;
+  struct layout_block *blocks;
+  struct layout_edge *edges;
+  struct cfg_block *block;
+  struct ir_instruction *iter, *before, *after;
+  int *order;
+
+  if (count < 3) {
+    return;
+  }
+  // A two-way branch has two edges; a jump table may have more
+  for (block = graph->entry; NULL != block; block = block->next) {
+    struct cfg_edge *edge;
+    for (edge = block->successors; NULL != edge; edge = edge->next) {
+      num_edges++;
+    }
+  }
+  blocks = calloc(count, sizeof(struct layout_block));
+  edges = malloc(sizeof(struct layout_edge) * (2 * count + num_edges));
+  num_edges = 0;
+  order = malloc(sizeof(int) * count);
+  assert(NULL != blocks && NULL != edges && NULL != order);
+
+  // Numbering carries on from the code before the function
+  for (iter = graph->begin->prev; NULL != iter; iter = iter->prev) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      region = iter->operands[0].data.temporary;
+      break;
+    }
+  }
+
+  for (block = graph->entry; NULL != block; block = block->next) {
+    struct layout_block *current = &blocks[block->id];
+    struct ir_instruction *last = block->last;
+
+    current->block = block;
+    current->count = profile_block_count(block);
+    current->chain = block->id;
+    current->next = -1;
+    if (NULL != cfg_branch_label(last)) {
+      current->target = cfg_find_label(graph, cfg_branch_label(last)->data.label_name);
+    }
+    if (last->kind != IR_GOTO && last->kind != IR_GOTO_TABLE && !layout_ends_function(block)) {
+      current->fall = block->next;
+    }
+    current->region_in = region;
+    for (iter = block->first; iter != last->next; iter = iter->next) {
+      if (iter->kind == IR_SEQUENCE_PT) {
+        region = iter->operands[0].data.temporary;
+      }
+    }
+    current->region_out = region;
+  }
+
+  // Without a profile, code is as hot as the loops around it
+  for (i = 0; i < count; i++) {
+    if (NULL != blocks[i].target && blocks[i].target->id <= i) {
+      for (j = blocks[i].target->id; j <= i; j++) {
+        blocks[j].depth++;
+      }
+    }
+  }
+  for (i = 0; i < count; i++) {
+    blocks[i].frequency = 1;
+    for (j = 0; j < blocks[i].depth && j < LAYOUT_MAX_DEPTH; j++) {
+      blocks[i].frequency *= LAYOUT_LOOP_SCALE;
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    if (NULL != blocks[i].target) {
+      layout_add_edge(blocks, count, edges, &num_edges, blocks[i].block, blocks[i].target, blocks[i].fall);
+    }
+    if (NULL != blocks[i].fall && blocks[i].fall != blocks[i].target) {
+      layout_add_edge(blocks, count, edges, &num_edges, blocks[i].block, blocks[i].fall, blocks[i].target);
+    }
+    // Nothing says which entry of a jump table is likely, so each gets the lot
+    if (blocks[i].block->last->kind == IR_GOTO_TABLE) {
+      struct cfg_edge *edge;
+      for (edge = blocks[i].block->successors; NULL != edge; edge = edge->next) {
+        layout_add_edge(blocks, count, edges, &num_edges, blocks[i].block, edge->block, NULL);
+      }
+    }
+  }
+  for (i = 1; i < count; i++) {
+    if (blocks[i].count >= 0) {
+      blocks[i].cold = 0 == blocks[i].count;
+    } else {
+      blocks[i].cold = blocks[i].preds == blocks[i].unlikely_preds;
+    }
+  }
+
+  qsort(edges, num_edges, sizeof(struct layout_edge), layout_compare_edges);
+  layout_order(blocks, count, edges, num_edges, order);
+  for (i = 0; i < count; i++) {
+    moved |= order[i] != i;
+  }
+
+  if (moved) {
+    for (i = 0; i < count; i++) {
+      layout_fix_branches(section, &blocks[order[i]], i + 1 < count ? blocks[order[i + 1]].block : NULL);
+    }
+
+    region = blocks[0].region_in;
+    for (i = 0; i < count; i++) {
+      struct layout_block *current = &blocks[order[i]];
+      if (region != current->region_in) {
+        layout_sequence_point(section, current->block, current->region_in);
+      }
+      region = current->region_out;
+    }
+
+    // Link the blocks up again in their new order
+    before = graph->begin->prev;
+    after = blocks[count - 1].block->last->next;
+    for (i = 0; i < count; i++) {
+      struct layout_block *current = &blocks[order[i]];
+      current->block->first->prev = before;
+      if (NULL == before) {
+        section->first = current->block->first;
+      } else {
+        before->next = current->block->first;
+      }
+      before = current->block->last;
+    }
+    before->next = after;
+    if (NULL == after) {
+      section->last = before;
+    } else {
+      after->prev = before;
+    }
+
+    // ...and leave the numbering as it was for the code after the function
+    if (region != blocks[count - 1].region_out) {
+      struct ir_instruction *sequence_point = ir_instruction(IR_SEQUENCE_PT);
+      sequence_point->operands[0].kind = OPERAND_TEMPORARY;
+      sequence_point->operands[0].data.temporary = blocks[count - 1].region_out;
+      ir_insert_after(section, before, sequence_point);
+    }
+  }
+
+  free(order);
+  free(edges);
+  free(blocks);
+}
+
+/* layout_program - reorders the blocks of every function
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void layout_program(struct ir_section *section) {
+  struct cfg *graphs, *graph;
+
+  if (!layout_enabled || NULL == section || NULL == section->first) {
+    return;
+  }
+  graphs = pass_cfg(section);
+  for (graph = graphs; NULL != graph; graph = graph->next) {
+    layout_function(section, graph);
+  }
+}
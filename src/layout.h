@@ -0,0 +1,17 @@
+#ifndef _LAYOUT_H
+#define _LAYOUT_H
+
+struct ir_section;
+
+/* Without a profile, a loop body is assumed to run this many times for each
+ * time the loop is entered */
+#define LAYOUT_LOOP_SCALE 8
+/* ...up to this depth of nesting */
+#define LAYOUT_MAX_DEPTH  4
+
+void layout_program(struct ir_section *section);
+
+extern int layout_enabled;
+extern int layout_split_cold;
+
+#endif
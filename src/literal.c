@@ -0,0 +1,331 @@
+/*
+ * literal.c
+ *
+ * The pool of string literals that goes into the data section.  Identical
+ * literals share one label: the pool is a hash table keyed on the bytes of
+ * the literal (which may include embedded NULs), and it grows as needed, so
+ * there is no limit on the number of strings in a program.
+ *
+ * When the pool is printed, a literal that is a suffix of another, like "abc"
+ * and "xabc", is given a label in the middle of the longer one instead of its
+ * own copy.  Finding the suffixes is a sort on the reversed bytes: after the
+ * sort, a literal is a suffix of the next one if it is one at all.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "literal.h"
+
+int literal_merge_suffixes = 1;
+
+/* The number of distinct literals in the pool */
+static int literal_count;
+
+struct literal {
+  char *contents;
+  int len;
+  char *label;
+  /* Set when the pool is printed: the literal this one is the tail of */
+  int host;
+  /* Set by literal_layout: where it starts in the data section */
+  int offset;
+};
+
+static struct literal *literal_pool;
+static int literal_pool_size;
+
+/* Hash table of indexes into literal_pool, -1 for an empty slot */
+static int *literal_table;
+static int literal_table_size;
+
+/* literal_hash - FNV-1a over the bytes of a literal */
+static unsigned long literal_hash(char *contents, int len) {
+  unsigned long hash = 2166136261UL;
+  int i;
+
+  for (i = 0; i < len; i++) {
+    hash = ((hash ^ (unsigned char)contents[i]) * 16777619UL) & 0xffffffffUL;
+  }
+  return hash;
+}
+
+/* literal_slot - the table slot that holds, or would hold, a literal */
+static int *literal_slot(char *contents, int len) {
+  unsigned long i = literal_hash(contents, len) % literal_table_size;
+
+  while (-1 != literal_table[i]) {
+    struct literal *literal = &literal_pool[literal_table[i]];
+    if (len == literal->len && !memcmp(contents, literal->contents, len)) {
+      break;
+    }
+    i = (i + 1) % literal_table_size;
+  }
+  return &literal_table[i];
+}
+
+/* literal_grow_table - doubles the hash table and rehashes the pool */
+static void literal_grow_table(void) {
+  int i;
+
+  free(literal_table);
+  literal_table_size = literal_table_size ? literal_table_size * 2 : 64;
+  literal_table = malloc(sizeof(int) * literal_table_size);
+  assert(NULL != literal_table);
+  for (i = 0; i < literal_table_size; i++) {
+    literal_table[i] = -1;
+  }
+  for (i = 0; i < literal_count; i++) {
+    *literal_slot(literal_pool[i].contents, literal_pool[i].len) = i;
+  }
+}
+
+/* literal_label - finds the label of a literal, adding it to the pool if it
+ *   is not there yet
+ *
+ * Parameters:
+ *   contents - char * - the literal's bytes, without escapes
+ *   len - int - how many there are, not counting the terminating NUL
+ *
+ * Returns the label, which is shared by every use of the same literal
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+char *literal_label(char *contents, int len) {
+  struct literal *literal;
+  int *slot;
+
+  if (2 * (literal_count + 1) > literal_table_size) {
+    literal_grow_table();
+  }
+  slot = literal_slot(contents, len);
+  if (-1 != *slot) {
+    return literal_pool[*slot].label;
+  }
+
+  if (literal_count == literal_pool_size) {
+    literal_pool_size = literal_pool_size ? literal_pool_size * 2 : 64;
+    literal_pool = realloc(literal_pool, sizeof(struct literal) * literal_pool_size);
+    assert(NULL != literal_pool);
+  }
+  literal = &literal_pool[literal_count];
+  literal->contents = malloc(len + 1);
+  assert(NULL != literal->contents);
+  memcpy(literal->contents, contents, len);
+  literal->contents[len] = 0;
+  literal->len = len;
+  literal->label = malloc(32);
+  assert(NULL != literal->label);
+  sprintf(literal->label, "_StringLabel_%d", literal_count);
+  literal->host = literal_count;
+
+  *slot = literal_count++;
+  return literal->label;
+}
+
+/* literal_contents - looks up a literal by its label
+ *
+ * Parameters:
+ *   label - char * - a label from literal_label
+ *   len - int * - set to the number of bytes, not counting the terminating NUL
+ *
+ * Returns the bytes, NUL-terminated, or NULL if no literal has the label
+ */
+char *literal_contents(char *label, int *len) {
+  int i;
+
+  for (i = 0; i < literal_count; i++) {
+    if (!strcmp(literal_pool[i].label, label)) {
+      *len = literal_pool[i].len;
+      return literal_pool[i].contents;
+    }
+  }
+  return NULL;
+}
+
+/* literal_compare_reversed - orders literals by their bytes read backwards,
+ *   for qsort
+ */
+static int literal_compare_reversed(const void *left, const void *right) {
+  struct literal *a = &literal_pool[*(const int *)left];
+  struct literal *b = &literal_pool[*(const int *)right];
+  int i;
+
+  for (i = 1; i <= a->len && i <= b->len; i++) {
+    unsigned char x = a->contents[a->len - i], y = b->contents[b->len - i];
+    if (x != y) {
+      return x < y ? -1 : 1;
+    }
+  }
+  return a->len - b->len;
+}
+
+/* literal_is_suffix - "true" if literal a is the tail of literal b */
+static int literal_is_suffix(struct literal *a, struct literal *b) {
+  return a->len <= b->len && !memcmp(a->contents, b->contents + b->len - a->len, a->len);
+}
+
+/* literal_find_hosts - points each literal that is the tail of a longer one
+ *   at the longest literal it is the tail of
+ */
+static void literal_find_hosts(void) {
+  int *order, i;
+
+  order = malloc(sizeof(int) * (literal_count + 1));
+  assert(NULL != order);
+  for (i = 0; i < literal_count; i++) {
+    order[i] = i;
+  }
+  qsort(order, literal_count, sizeof(int), literal_compare_reversed);
+
+  // Each literal's tails sort just before it, so walking backwards the host
+  // of a literal is already known when its tails are reached
+  for (i = literal_count - 2; i >= 0; i--) {
+    if (literal_is_suffix(&literal_pool[order[i]], &literal_pool[order[i + 1]])) {
+      literal_pool[order[i]].host = literal_pool[order[i + 1]].host;
+    }
+  }
+  free(order);
+}
+
+/* literal_printable - "true" if a byte can go inside an .ascii string */
+static int literal_printable(unsigned char c) {
+  return '\n' == c || '\t' == c || (c >= ' ' && c < 127);
+}
+
+/* literal_print_bytes - prints part of a literal as assembler directives
+ *
+ * Printable characters go in .ascii strings, escaped where the assembler
+ * needs it; anything else is a .byte.  The terminating NUL is folded into
+ * the last string when it runs to the end.
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ *   contents - char * - the bytes
+ *   len - int - how many to print
+ *   terminate - int - "true" to end with a NUL
+ */
+static void literal_print_bytes(FILE *output, char *contents, int len, int terminate) {
+  int i = 0, end;
+
+  while (i < len) {
+    unsigned char c = contents[i];
+    if (!literal_printable(c)) {
+      fprintf(output, " .byte %d\n", c);
+      i++;
+      continue;
+    }
+
+    for (end = i; end < len && literal_printable(contents[end]); end++)
+      ;
+    fprintf(output, " %s \"", terminate && end == len ? ".asciiz" : ".ascii");
+    for (; i < end; i++) {
+      c = contents[i];
+      if ('\n' == c) {
+        fputs("\\n", output);
+      } else if ('\t' == c) {
+        fputs("\\t", output);
+      } else if ('"' == c || '\\' == c) {
+        fprintf(output, "\\%c", c);
+      } else {
+        fputc(c, output);
+      }
+    }
+    fputs("\"\n", output);
+    if (terminate && i == len) {
+      return;
+    }
+  }
+  if (terminate) {
+    fputs(" .asciiz \"\"\n", output);
+  }
+}
+
+/* literal_print - prints the pool
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void literal_print(FILE *output) {
+  int i, j, offset, next;
+
+  if (literal_merge_suffixes) {
+    literal_find_hosts();
+  }
+
+  for (i = 0; i < literal_count; i++) {
+    struct literal *host = &literal_pool[i];
+    if (i != host->host) {
+      continue;
+    }
+
+    // Labels go in where each tail starts, longest tail first
+    fprintf(output, "%s:", host->label);
+    offset = 0;
+    for (;;) {
+      next = -1;
+      for (j = 0; j < literal_count; j++) {
+        if (j != i && i == literal_pool[j].host && host->len - literal_pool[j].len > offset
+            && (-1 == next || literal_pool[j].len > literal_pool[next].len)) {
+          next = j;
+        }
+      }
+      if (-1 == next) {
+        break;
+      }
+      literal_print_bytes(output, host->contents + offset, host->len - literal_pool[next].len - offset, 0);
+      offset = host->len - literal_pool[next].len;
+      fprintf(output, "%s:", literal_pool[next].label);
+    }
+    literal_print_bytes(output, host->contents + offset, host->len - offset, 1);
+  }
+}
+
+/* literal_layout - lays the pool out byte for byte as literal_print would
+ *   have the assembler do, for a data section written directly
+ *
+ * Parameters:
+ *   image - char ** - set to the bytes, on the heap
+ *
+ * Returns how many bytes there are; literal_offset then finds each label
+ */
+int literal_layout(char **image) {
+  int i, size = 0;
+
+  if (literal_merge_suffixes) {
+    literal_find_hosts();
+  }
+  for (i = 0; i < literal_count; i++) {
+    if (i == literal_pool[i].host) {
+      literal_pool[i].offset = size;
+      size += literal_pool[i].len + 1;
+    }
+  }
+
+  *image = malloc(size + 1);
+  assert(NULL != *image);
+  for (i = 0; i < literal_count; i++) {
+    struct literal *host = &literal_pool[literal_pool[i].host];
+    literal_pool[i].offset = host->offset + host->len - literal_pool[i].len;
+    if (i == literal_pool[i].host) {
+      memcpy(*image + host->offset, host->contents, host->len + 1);
+    }
+  }
+  return size;
+}
+
+/* literal_offset - where a label is in the pool as literal_layout laid it out,
+ *   or -1 if no literal has the label
+ */
+int literal_offset(char *label) {
+  int i;
+
+  for (i = 0; i < literal_count; i++) {
+    if (!strcmp(literal_pool[i].label, label)) {
+      return literal_pool[i].offset;
+    }
+  }
+  return -1;
+}
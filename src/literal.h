@@ -0,0 +1,14 @@
+#ifndef _LITERAL_H
+#define _LITERAL_H
+
+#include <stdio.h>
+
+char *literal_label(char *contents, int len);
+char *literal_contents(char *label, int *len);
+void literal_print(FILE *output);
+int literal_layout(char **image);
+int literal_offset(char *label);
+
+extern int literal_merge_suffixes;
+
+#endif
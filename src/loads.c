@@ -0,0 +1,484 @@
+/*
+ * loads.c
+ *
+ * Redundant load elimination.  The IR loads a variable every time its value
+ * is used, and stores it every time it is assigned, so the same word is often
+ * read again while a register still holds it.  This pass keeps track, through
+ * each function, of which registers are known to hold what is at which
+ * address, and turns a load whose value is already in a register into a move,
+ * or drops it if it is the same register.
+ *
+ * A load makes its destination hold what it read, and a sw makes the value
+ * stored be what a lw from there would read.  A store forgets whatever it may
+ * overlap, as alias.c tells; a call forgets whatever the callee may reach; and
+ * writing a register forgets what it held, or what it was the address in.
+ *
+ * Accesses alias.c places exactly (a slot of the frame, a global plus a
+ * constant) are known by their location, so they survive the register the
+ * address was in being reused.  Other accesses are known by their base
+ * register and displacement.
+ *
+ * What is known at the start of a block is what is known at the end of every
+ * block that may run before it, found by iterating over the function's blocks
+ * until nothing changes.  A function that jumps through a register (to an
+ * entry of a jump table) may go to any of its labels, so nothing is carried
+ * into one there.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "ir.h"
+#include "mips.h"
+#include "alias.h"
+#include "loads.h"
+
+int loads_enabled = 1;
+
+/* A register known to hold what a load would read */
+struct loads_entry {
+  struct alias_location where;
+  /* "true" if known by where, rather than by base and displacement */
+  int located;
+  int base;
+  long displacement;
+  /* The load that would read it */
+  char *opcode;
+  int value;
+};
+
+struct loads_set {
+  /* Set until some path to the block is known: anything may be assumed */
+  int everything;
+  int count;
+  struct loads_entry entries[LOADS_MAX_ENTRIES];
+};
+
+struct loads_block {
+  struct mips_instruction *first, *last;
+  /* Blocks control may go to next, or -1 */
+  int successors[2];
+  /* Nothing is known at the start, whatever comes before */
+  int entry;
+  struct loads_set in, out;
+};
+
+static char *loads_loads[] = { "lw", "lh", "lhu", "lb", "lbu", NULL };
+static char *loads_stores[] = { "sw", "sh", "sb", NULL };
+static int loads_load_widths[] = { 4, 2, 2, 1, 1 };
+static int loads_store_widths[] = { 4, 2, 1 };
+
+/* loads_find_opcode - looks an opcode up in a NULL-terminated list
+ *
+ * Returns its index, or -1
+ */
+static int loads_find_opcode(char *opcode, char **list) {
+  int i;
+  for (i = 0; NULL != list[i]; i++) {
+    if (!strcmp(opcode, list[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* loads_same_label - whether two labels, either of which may be NULL, are the same */
+static int loads_same_label(char *a, char *b) {
+  return a == b || (NULL != a && NULL != b && !strcmp(a, b));
+}
+
+/* loads_same_location - whether two tags say the same thing */
+static int loads_same_location(struct alias_location *a, struct alias_location *b) {
+  return a->kind == b->kind && a->exact == b->exact && loads_same_label(a->label, b->label) &&
+         a->offset == b->offset && a->size == b->size && a->width == b->width && a->escapes == b->escapes;
+}
+
+/* loads_same_key - whether two entries are about the same memory and the same load */
+static int loads_same_key(struct loads_entry *a, struct loads_entry *b) {
+  if (a->located != b->located || strcmp(a->opcode, b->opcode)) {
+    return 0;
+  }
+  if (a->located) {
+    return a->where.kind == b->where.kind && a->where.offset == b->where.offset &&
+           loads_same_label(a->where.label, b->where.label);
+  }
+  return a->base == b->base && a->displacement == b->displacement;
+}
+
+/* loads_describe - works out what a load or store accesses
+ *
+ * Parameters:
+ *   instruction - mips_instruction - the load or store
+ *   width - int - bytes it accesses
+ *   access - loads_entry - filled in, except for its opcode and value
+ *
+ * Returns "true" if the access can be remembered; where is filled in either way
+ */
+static int loads_describe(struct mips_instruction *instruction, int width, struct loads_entry *access) {
+  struct mips_operand *address = &instruction->operands[1];
+
+  memset(access, 0, sizeof(struct loads_entry));
+  access->where = instruction->alias;
+  access->base = -1;
+  if (address->kind == MIPS_OPERAND_ADDRESS) {
+    access->base = address->reg;
+    access->displacement = address->number;
+  }
+
+  // Code that no IR load or store was behind: the prologue, the epilogue...
+  if (access->where.kind == ALIAS_NONE) {
+    if (address->kind == MIPS_OPERAND_ADDRESS && address->reg == MIPS_REGISTER_FP) {
+      alias_set_frame(&access->where, (int)address->number, width, 1);
+    } else if (address->kind == MIPS_OPERAND_LABEL) {
+      access->where.kind = ALIAS_GLOBAL;
+      access->where.exact = 1;
+      access->where.label = address->label;
+      access->where.width = width;
+      access->where.escapes = 1;
+    }
+  }
+
+  access->located = access->where.exact &&
+                    (access->where.kind == ALIAS_FRAME || access->where.kind == ALIAS_GLOBAL);
+  // The assembler uses $at for its own purposes
+  return access->located || (access->base >= 0 && access->base != MIPS_REGISTER_AT);
+}
+
+/* loads_remove - drops one entry of a set */
+static void loads_remove(struct loads_set *set, int index) {
+  set->entries[index] = set->entries[--set->count];
+}
+
+/* loads_add - remembers that a register holds what a load would read */
+static void loads_add(struct loads_set *set, struct loads_entry *entry) {
+  if (set->count == LOADS_MAX_ENTRIES || entry->value == MIPS_REGISTER_AT) {
+    return;
+  }
+  set->entries[set->count++] = *entry;
+}
+
+/* loads_find - finds a register holding what a load would read
+ *
+ * Returns the entry, or NULL
+ */
+static struct loads_entry *loads_find(struct loads_set *set, struct loads_entry *access) {
+  int i;
+  for (i = 0; i < set->count; i++) {
+    if (loads_same_key(&set->entries[i], access)) {
+      return &set->entries[i];
+    }
+  }
+  return NULL;
+}
+
+/* loads_kill_registers - forgets what depends on registers that are written
+ *
+ * Parameters:
+ *   set - loads_set - what is known
+ *   written - unsigned int - mask of the registers
+ */
+static void loads_kill_registers(struct loads_set *set, unsigned int written) {
+  int i;
+  for (i = set->count - 1; i >= 0; i--) {
+    struct loads_entry *entry = &set->entries[i];
+    if ((written & (1u << entry->value)) ||
+        (!entry->located && (written & (1u << entry->base))) ||
+        // Frame locations are relative to $fp
+        (entry->located && entry->where.kind == ALIAS_FRAME && (written & (1u << MIPS_REGISTER_FP)))) {
+      loads_remove(set, i);
+    }
+  }
+}
+
+/* loads_kill_memory - forgets what a store may overwrite
+ *
+ * Parameters:
+ *   set - loads_set - what is known
+ *   where - alias_location - what the store touches
+ */
+static void loads_kill_memory(struct loads_set *set, struct alias_location *where) {
+  int i;
+  for (i = set->count - 1; i >= 0; i--) {
+    if (alias_may_overlap(&set->entries[i].where, where)) {
+      loads_remove(set, i);
+    }
+  }
+}
+
+/* loads_kill_call - forgets what a called function may overwrite */
+static void loads_kill_call(struct loads_set *set) {
+  int i;
+  for (i = set->count - 1; i >= 0; i--) {
+    if (!alias_survives_call(&set->entries[i].where)) {
+      loads_remove(set, i);
+    }
+  }
+}
+
+/* loads_meet - keeps only what is known on both paths
+ *
+ * Parameters:
+ *   set - loads_set - what is known on one, and then on both
+ *   other - loads_set - what is known on the other
+ */
+static void loads_meet(struct loads_set *set, struct loads_set *other) {
+  int i, j;
+
+  if (other->everything) {
+    return;
+  }
+  if (set->everything) {
+    *set = *other;
+    return;
+  }
+  for (i = set->count - 1; i >= 0; i--) {
+    struct loads_entry *entry = &set->entries[i];
+    for (j = 0; j < other->count; j++) {
+      struct loads_entry *match = &other->entries[j];
+      if (loads_same_key(entry, match) && entry->value == match->value &&
+          loads_same_location(&entry->where, &match->where)) {
+        break;
+      }
+    }
+    if (j == other->count) {
+      loads_remove(set, i);
+    }
+  }
+}
+
+/* loads_same_set - whether two sets hold the same entries */
+static int loads_same_set(struct loads_set *a, struct loads_set *b) {
+  struct loads_set both;
+
+  if (a->everything != b->everything || a->count != b->count) {
+    return 0;
+  }
+  both = *a;
+  loads_meet(&both, b);
+  return both.count == a->count;
+}
+
+/* loads_step - updates what is known across one instruction, and if asked to,
+ *   replaces the instruction if it is a load of something known
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *   set - loads_set - what is known before the instruction, and then after
+ *   instruction - mips_instruction - the instruction
+ *   rewrite - int - "true" to replace redundant loads
+ *
+ * Returns "true" if the instruction was removed
+ */
+static int loads_step(struct mips_section *code, struct loads_set *set, struct mips_instruction *instruction,
+                      int rewrite) {
+  struct loads_entry access, *known;
+  int index, trackable, destination;
+
+  if (instruction->kind != MIPS_INSTRUCTION_OPERATION) {
+    return 0;
+  }
+
+  if ((index = loads_find_opcode(instruction->opcode, loads_loads)) >= 0) {
+    trackable = loads_describe(instruction, loads_load_widths[index], &access);
+    access.opcode = loads_loads[index];
+    destination = instruction->operands[0].reg;
+    if (trackable && rewrite && NULL != (known = loads_find(set, &access))) {
+      if (known->value == destination) {
+        mips_remove(code, instruction);
+        return 1;
+      }
+      instruction->opcode = "or";
+      instruction->num_operands = 3;
+      instruction->operands[1] = mips_register(known->value);
+      instruction->operands[2] = mips_register(MIPS_REGISTER_ZERO);
+      memset(&instruction->alias, 0, sizeof(instruction->alias));
+    }
+    loads_kill_registers(set, 1u << destination);
+    // Unless the load changed the address
+    if (trackable && (access.located ? access.where.kind != ALIAS_FRAME || destination != MIPS_REGISTER_FP :
+                                       access.base != destination)) {
+      access.value = destination;
+      loads_add(set, &access);
+    }
+    return 0;
+  }
+
+  if ((index = loads_find_opcode(instruction->opcode, loads_stores)) >= 0) {
+    trackable = loads_describe(instruction, loads_store_widths[index], &access);
+    loads_kill_memory(set, &access.where);
+    // A narrower store only keeps the low bytes of its register
+    if (trackable && !strcmp(instruction->opcode, "sw")) {
+      access.opcode = "lw";
+      access.value = instruction->operands[0].reg;
+      loads_add(set, &access);
+    }
+    return 0;
+  }
+
+  if (!strcmp(instruction->opcode, "jal") || !strcmp(instruction->opcode, "syscall")) {
+    loads_kill_call(set);
+  }
+  loads_kill_registers(set, mips_register_defs(instruction));
+  return 0;
+}
+
+/* loads_find_block - the block a label starts, or -1 if it is not in the function */
+static int loads_find_block(struct loads_block *blocks, int count, char *label) {
+  int i;
+  for (i = 0; i < count; i++) {
+    if (blocks[i].first->kind == MIPS_INSTRUCTION_LABEL && !strcmp(blocks[i].first->operands[0].label, label)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* loads_function - removes the redundant loads of one function
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *   first - mips_instruction - the function's label
+ *   stop - mips_instruction - the next function's label, or NULL
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void loads_function(struct mips_section *code, struct mips_instruction *first, struct mips_instruction *stop) {
+  struct mips_instruction *iter, *next;
+  struct loads_block *blocks;
+  struct loads_set set;
+  int count = 0, computed_jump = 0, changed = 1, rounds = 0, i, j;
+
+  for (iter = first; iter != stop; iter = iter->next) {
+    if (iter == first || iter->kind == MIPS_INSTRUCTION_LABEL ||
+        (iter->prev->kind == MIPS_INSTRUCTION_OPERATION && mips_ends_block(iter->prev))) {
+      count++;
+    }
+    if (iter->kind == MIPS_INSTRUCTION_OPERATION && !strcmp(iter->opcode, "jr") &&
+        iter->operands[0].reg != MIPS_REGISTER_RA) {
+      computed_jump = 1;
+    }
+  }
+  blocks = calloc(count, sizeof(struct loads_block));
+  assert(NULL != blocks);
+
+  for (i = -1, iter = first; iter != stop; iter = iter->next) {
+    if (iter == first || iter->kind == MIPS_INSTRUCTION_LABEL ||
+        (iter->prev->kind == MIPS_INSTRUCTION_OPERATION && mips_ends_block(iter->prev))) {
+      blocks[++i].first = iter;
+      blocks[i].entry = (i == 0) || computed_jump;
+      blocks[i].out.everything = 1;
+    }
+    blocks[i].last = iter;
+  }
+
+  for (i = 0; i < count; i++) {
+    struct mips_instruction *last = blocks[i].last;
+    int falls_through = 1;
+
+    blocks[i].successors[0] = blocks[i].successors[1] = -1;
+    if (last->kind == MIPS_INSTRUCTION_OPERATION && mips_ends_block(last)) {
+      struct mips_operand *target = &last->operands[last->num_operands - 1];
+      if (target->kind == MIPS_OPERAND_LABEL) {
+        blocks[i].successors[0] = loads_find_block(blocks, count, target->label);
+      }
+      falls_through = strcmp(last->opcode, "b") && strcmp(last->opcode, "j") && strcmp(last->opcode, "jr");
+    }
+    if (falls_through && i + 1 < count) {
+      blocks[i].successors[1] = i + 1;
+    }
+  }
+
+  while (changed) {
+    changed = 0;
+    // Entries dropped for lack of room can keep this from settling; then give up
+    if (++rounds > LOADS_MAX_ROUNDS) {
+      for (i = 0; i < count; i++) {
+        blocks[i].entry = 1;
+      }
+    }
+    for (i = 0; i < count; i++) {
+      blocks[i].in.everything = !blocks[i].entry;
+      blocks[i].in.count = 0;
+      for (j = 0; !blocks[i].entry && j < count; j++) {
+        if (blocks[j].successors[0] == i || blocks[j].successors[1] == i) {
+          loads_meet(&blocks[i].in, &blocks[j].out);
+        }
+      }
+
+      set = blocks[i].in;
+      if (!set.everything) {
+        for (iter = blocks[i].first; iter != blocks[i].last->next; iter = iter->next) {
+          loads_step(code, &set, iter, 0);
+        }
+      }
+      if (!loads_same_set(&set, &blocks[i].out)) {
+        blocks[i].out = set;
+        changed = 1;
+      }
+    }
+  }
+
+  // A block nothing reaches is never run; it assumes nothing rather than everything
+  for (i = 0; i < count; i++) {
+    set = blocks[i].in;
+    if (set.everything) {
+      set.everything = 0;
+      set.count = 0;
+    }
+    for (iter = blocks[i].first; ; iter = next) {
+      int last = (iter == blocks[i].last);
+      next = iter->next;
+      loads_step(code, &set, iter, 1);
+      if (last) {
+        break;
+      }
+    }
+  }
+  free(blocks);
+}
+
+/* loads_optimize - removes the redundant loads of every function
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *   ir - ir_section - the IR it was generated from, for the functions' names
+ */
+void loads_optimize(struct mips_section *code, struct ir_section *ir) {
+  struct ir_instruction *instruction;
+  struct mips_instruction *iter, *first = code->first;
+  char **functions;
+  int count = 0, i;
+
+  if (!loads_enabled || NULL == first) {
+    return;
+  }
+  for (instruction = ir->first; NULL != instruction; instruction = instruction->next) {
+    if (instruction->kind == IR_PROC_BEGIN) {
+      count++;
+    }
+  }
+  functions = malloc(sizeof(char *) * (count + 1));
+  assert(NULL != functions);
+  for (i = 0, instruction = ir->first; NULL != instruction; instruction = instruction->next) {
+    if (instruction->kind == IR_PROC_BEGIN) {
+      functions[i++] = instruction->operands[0].data.label_name;
+    }
+  }
+
+  for (iter = first->next; NULL != iter; iter = iter->next) {
+    if (iter->kind != MIPS_INSTRUCTION_LABEL) {
+      continue;
+    }
+    for (i = 0; i < count && strcmp(functions[i], iter->operands[0].label); i++)
+      ;
+    if (i < count) {
+      loads_function(code, first, iter);
+      first = iter;
+    }
+  }
+  loads_function(code, first, NULL);
+  free(functions);
+}
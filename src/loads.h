@@ -0,0 +1,16 @@
+#ifndef _LOADS_H
+#define _LOADS_H
+
+struct mips_section;
+struct ir_section;
+
+/* Values known to be in memory at one point, at most */
+#define LOADS_MAX_ENTRIES 32
+/* Passes over a function's blocks before assuming nothing at any of them */
+#define LOADS_MAX_ROUNDS  32
+
+void loads_optimize(struct mips_section *code, struct ir_section *ir);
+
+extern int loads_enabled;
+
+#endif
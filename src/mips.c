@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <assert.h>
 #include <string.h>
 
@@ -8,6 +9,8 @@
 #include "symbol.h"
 #include "ir.h"
 #include "mips.h"
+#include "select.h"
+#include "literal.h"
 
 #define REG_EXHAUSTED   -1
 
@@ -15,7 +18,293 @@
 #define LAST_USABLE_REGISTER  23
 #define NUM_REGISTERS         32
 
-int register_offset;
+/* The register each temporary is in, by temporary; see mips_assign_registers */
+static int *mips_temporary_registers;
+static int mips_num_temporaries;
+/* Every MIPS instruction ever made, for the pass manager's counters */
+long mips_instructions_made;
+
+/****************************
+ * MIPS INSTRUCTION LIST    *
+ ****************************/
+
+struct mips_operand mips_register(int reg) {
+  struct mips_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = MIPS_OPERAND_REGISTER;
+  operand.reg = reg;
+  return operand;
+}
+
+struct mips_operand mips_number(long number) {
+  struct mips_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = MIPS_OPERAND_NUMBER;
+  operand.number = number;
+  return operand;
+}
+
+struct mips_operand mips_label(char *label) {
+  struct mips_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = MIPS_OPERAND_LABEL;
+  operand.label = label;
+  return operand;
+}
+
+struct mips_operand mips_address(long offset, int reg) {
+  struct mips_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = MIPS_OPERAND_ADDRESS;
+  operand.number = offset;
+  operand.reg = reg;
+  return operand;
+}
+
+/* mips_append - links an instruction onto the end of a section
+ *
+ * Parameters:
+ * 		code - mips_section - section to append to
+ * 		instruction - mips_instruction - the new instruction
+ */
+static void mips_append(struct mips_section *code, struct mips_instruction *instruction) {
+	instruction->next = NULL;
+	instruction->prev = code->last;
+	if(NULL == code->last)
+		code->first = instruction;
+	else
+		code->last->next = instruction;
+	code->last = instruction;
+}
+
+/* mips_emit - appends an operation to a section
+ *
+ * Parameters:
+ * 		code - mips_section - section to append to
+ * 		opcode - char * - the mnemonic
+ * 		num_operands - int - how many mips_operand arguments follow
+ *
+ * Returns the new instruction
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+struct mips_instruction *mips_emit(struct mips_section *code, char *opcode, int num_operands, ...) {
+	struct mips_instruction *instruction = malloc(sizeof(struct mips_instruction));
+	va_list operands;
+	int i;
+
+	assert(NULL != instruction);
+	assert(num_operands >= 0 && num_operands <= 3);
+	mips_instructions_made++;
+	memset(instruction, 0, sizeof(struct mips_instruction));
+	instruction->kind = MIPS_INSTRUCTION_OPERATION;
+	instruction->opcode = opcode;
+	instruction->num_operands = num_operands;
+
+	va_start(operands, num_operands);
+	for(i = 0; i < num_operands; i++)
+		instruction->operands[i] = va_arg(operands, struct mips_operand);
+	va_end(operands);
+
+	mips_append(code, instruction);
+	return instruction;
+}
+
+/* mips_emit_label - appends a label definition to a section
+ *
+ * Parameters:
+ * 		code - mips_section - section to append to
+ * 		label - char * - the label name
+ *
+ * Returns the new instruction
+ */
+struct mips_instruction *mips_emit_label(struct mips_section *code, char *label) {
+	struct mips_instruction *instruction = mips_emit(code, NULL, 1, mips_label(label));
+	instruction->kind = MIPS_INSTRUCTION_LABEL;
+	return instruction;
+}
+
+/* mips_insert_after - links an instruction into a section
+ *
+ * Parameters:
+ * 		code - mips_section - the section
+ * 		where - mips_instruction - the instruction to insert after, or NULL for the front
+ * 		instruction - mips_instruction - the instruction, which must not be in any section
+ */
+void mips_insert_after(struct mips_section *code, struct mips_instruction *where, struct mips_instruction *instruction) {
+	instruction->prev = where;
+	instruction->next = (NULL == where) ? code->first : where->next;
+	if(NULL != instruction->next)
+		instruction->next->prev = instruction;
+	else
+		code->last = instruction;
+	if(NULL != where)
+		where->next = instruction;
+	else
+		code->first = instruction;
+}
+
+/* mips_remove - unlinks an instruction from a section
+ *
+ * Parameters:
+ * 		code - mips_section - the section holding the instruction
+ * 		instruction - mips_instruction - the instruction to unlink
+ */
+void mips_remove(struct mips_section *code, struct mips_instruction *instruction) {
+	if(NULL != instruction->prev)
+		instruction->prev->next = instruction->next;
+	else
+		code->first = instruction->next;
+	if(NULL != instruction->next)
+		instruction->next->prev = instruction->prev;
+	else
+		code->last = instruction->prev;
+	instruction->prev = NULL;
+	instruction->next = NULL;
+}
+
+/****************************
+ * REGISTER USE             *
+ ****************************/
+
+/* mips_opcode_in - looks an opcode up in a NULL-terminated list */
+static int mips_opcode_in(char *opcode, char **list) {
+	for(; NULL != *list; list++)
+		if(!strcmp(opcode, *list))
+			return 1;
+	return 0;
+}
+
+/* Operations whose first operand is the one register they write */
+static char *mips_first_operand_written[] = {
+	"add", "addu", "addi", "addiu", "sub", "subu", "mul",
+	"and", "andi", "or", "ori", "xor", "xori", "nor", "not", "neg", "negu", "move",
+	"slt", "sltu", "slti", "sltiu", "sle", "sgt", "sge", "seq", "sne",
+	"sll", "srl", "sra", "sllv", "srlv", "srav",
+	"li", "la", "lui", "lw", "lh", "lhu", "lb", "lbu", "mflo", "mfhi",
+	"movn", "movz",
+	NULL
+};
+
+/* Operations that read the register they conditionally write */
+static char *mips_conditional_move[] = { "movn", "movz", NULL };
+
+/* mips_defined_register - the register an operation writes through its first operand
+ *
+ * Parameters:
+ * 		instruction - mips_instruction - the instruction
+ *
+ * Returns the register number, or -1 if the instruction has no such operand
+ */
+int mips_defined_register(struct mips_instruction *instruction) {
+	if(instruction->kind != MIPS_INSTRUCTION_OPERATION ||
+			!mips_opcode_in(instruction->opcode, mips_first_operand_written))
+		return -1;
+	assert(instruction->operands[0].kind == MIPS_OPERAND_REGISTER);
+	return instruction->operands[0].reg;
+}
+
+#define MIPS_BIT(reg) (1u << (reg))
+/* $a0-$a3 */
+#define MIPS_ARGUMENT_REGISTERS (0xfu << MIPS_REGISTER_A0)
+/* Registers the caller expects to find intact, or holding the result, on return */
+#define MIPS_RETURN_REGISTERS (MIPS_BIT(MIPS_REGISTER_V0) | MIPS_BIT(MIPS_REGISTER_V1) | 0x00ffff00u | \
+		MIPS_BIT(MIPS_REGISTER_GP) | MIPS_BIT(MIPS_REGISTER_SP) | MIPS_BIT(MIPS_REGISTER_FP) | MIPS_BIT(MIPS_REGISTER_RA))
+
+/* mips_register_uses - the registers an instruction reads
+ *
+ * Parameters:
+ * 		instruction - mips_instruction - the instruction
+ *
+ * Returns a mask with bit n set if register n is read
+ */
+unsigned int mips_register_uses(struct mips_instruction *instruction) {
+	unsigned int uses = 0;
+	int i, first = 0;
+
+	if(instruction->kind != MIPS_INSTRUCTION_OPERATION)
+		return 0;
+
+	if(!strcmp(instruction->opcode, "jal"))
+		return MIPS_ARGUMENT_REGISTERS | MIPS_BIT(MIPS_REGISTER_SP) | MIPS_BIT(MIPS_REGISTER_FP) | MIPS_BIT(MIPS_REGISTER_GP);
+	if(!strcmp(instruction->opcode, "syscall"))
+		return MIPS_BIT(MIPS_REGISTER_V0) | MIPS_BIT(MIPS_REGISTER_A0) | MIPS_BIT(MIPS_REGISTER_A0 + 1);
+
+	if(mips_defined_register(instruction) >= 0 && !mips_opcode_in(instruction->opcode, mips_conditional_move))
+		first = 1;
+	for(i = first; i < instruction->num_operands; i++)
+	{
+		struct mips_operand *operand = &instruction->operands[i];
+		if(operand->kind == MIPS_OPERAND_REGISTER || operand->kind == MIPS_OPERAND_ADDRESS)
+			uses |= MIPS_BIT(operand->reg);
+	}
+	return uses & ~MIPS_BIT(MIPS_REGISTER_ZERO);
+}
+
+/* mips_register_defs - the registers an instruction may change
+ *
+ * Parameters:
+ * 		instruction - mips_instruction - the instruction
+ *
+ * Returns a mask with bit n set if register n may be written
+ */
+unsigned int mips_register_defs(struct mips_instruction *instruction) {
+	int reg;
+
+	if(instruction->kind != MIPS_INSTRUCTION_OPERATION)
+		return 0;
+
+	// Callees save every $t and $s register, so a call only clobbers these
+	if(!strcmp(instruction->opcode, "jal"))
+		return MIPS_BIT(MIPS_REGISTER_AT) | MIPS_BIT(MIPS_REGISTER_V0) | MIPS_BIT(MIPS_REGISTER_V1) |
+				MIPS_ARGUMENT_REGISTERS | MIPS_BIT(MIPS_REGISTER_RA);
+	if(!strcmp(instruction->opcode, "syscall"))
+		return MIPS_BIT(MIPS_REGISTER_V0);
+
+	reg = mips_defined_register(instruction);
+	if(reg <= MIPS_REGISTER_ZERO)
+		return 0;
+	return MIPS_BIT(reg);
+}
+
+/* mips_reads_register - whether an instruction reads a register
+ *
+ * Parameters:
+ * 		instruction - mips_instruction - the instruction
+ * 		reg - int - the register number
+ */
+int mips_reads_register(struct mips_instruction *instruction, int reg) {
+	return (mips_register_uses(instruction) & MIPS_BIT(reg)) != 0;
+}
+
+/* mips_writes_register - whether an instruction may change a register
+ *
+ * Parameters:
+ * 		instruction - mips_instruction - the instruction
+ * 		reg - int - the register number
+ */
+int mips_writes_register(struct mips_instruction *instruction, int reg) {
+	return (mips_register_defs(instruction) & MIPS_BIT(reg)) != 0;
+}
+
+/* Operations that may transfer control somewhere other than the next instruction */
+static char *mips_control_transfers[] = {
+	"b", "j", "jr", "beq", "bne", "beqz", "bnez", "blez", "bgtz", "bltz", "bgez",
+	NULL
+};
+
+/* mips_ends_block - whether straight-line reasoning has to stop at an instruction:
+ *   a label may be jumped to, a branch may leave
+ *
+ * Parameters:
+ * 		instruction - mips_instruction - the instruction
+ */
+int mips_ends_block(struct mips_instruction *instruction) {
+	if(instruction->kind == MIPS_INSTRUCTION_LABEL)
+		return 1;
+	return mips_opcode_in(instruction->opcode, mips_control_transfers);
+}
 
 /****************************
  * MIPS TEXT SECTION OUTPUT *
@@ -83,410 +372,693 @@ char *mips_kind_to_opcode(int kind) {
 		"sw",
 		NULL, // SEQ
 		NULL, // PRINT S
-		"addi"
+		"addi",
+		NULL, // TAIL CALL
+		"mult", // MULTIPLY HIGH
+		"multu",
+		"srl", // SHIFT RIGHT UNSIGNED
+		"beq", // Fused compare and branch
+		"bne",
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL, // GOTO TABLE
+		"movn",
+		"movz"
 
 	};
 	return opcodes[kind];
 }
 
-/* mips_sequence_point - sets the register offset to the sequence point's operand
- *   so that the following instruction's operands can be "zeroed"
+/* mips_is_jump - whether control never falls through an instruction */
+static int mips_is_jump(struct mips_instruction *instruction) {
+	return instruction->kind == MIPS_INSTRUCTION_OPERATION &&
+			(!strcmp(instruction->opcode, "b") || !strcmp(instruction->opcode, "j") || !strcmp(instruction->opcode, "jr"));
+}
+
+/* mips_compute_liveness - works out which registers hold a value that may still
+ *   be read after each instruction, and stores it in the instruction's live_out
  *
  * Parameters:
- * 		operand - ir_operand - the sequence point's one and only operand
+ * 		code - mips_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
  */
-void mips_sequence_point(struct ir_operand *operand) {
-	register_offset = operand->data.temporary + 1;
+void mips_compute_liveness(struct mips_section *code) {
+	struct mips_instruction *iter, **instructions;
+	unsigned int *live_in, *uses, *defs;
+	int *target, *label_index;
+	int count = 0, num_labels = 0, i, j, changed = 1;
+
+	for(iter = code->first; NULL != iter; iter = iter->next)
+		count++;
+	if(count == 0)
+		return;
+
+	instructions = malloc(sizeof(struct mips_instruction *) * count);
+	live_in = calloc(count, sizeof(unsigned int));
+	uses = malloc(sizeof(unsigned int) * count);
+	defs = malloc(sizeof(unsigned int) * count);
+	target = malloc(sizeof(int) * count);
+	label_index = malloc(sizeof(int) * count);
+	assert(NULL != instructions && NULL != live_in && NULL != uses && NULL != defs &&
+			NULL != target && NULL != label_index);
+
+	for(i = 0, iter = code->first; NULL != iter; iter = iter->next, i++)
+	{
+		instructions[i] = iter;
+		uses[i] = mips_register_uses(iter);
+		defs[i] = mips_register_defs(iter);
+		iter->live_out = 0;
+		if(iter->kind == MIPS_INSTRUCTION_LABEL)
+			label_index[num_labels++] = i;
+	}
+
+	// Find where each local branch goes; a jump to another function ends it
+	for(i = 0; i < count; i++)
+	{
+		struct mips_instruction *instruction = instructions[i];
+		target[i] = -1;
+		if(instruction->kind != MIPS_INSTRUCTION_OPERATION || !mips_ends_block(instruction) ||
+				!strcmp(instruction->opcode, "j") || !strcmp(instruction->opcode, "jr"))
+			continue;
+		for(j = 0; j < num_labels; j++)
+			if(!strcmp(instructions[label_index[j]]->operands[0].label,
+					instruction->operands[instruction->num_operands - 1].label))
+				target[i] = label_index[j];
+	}
+
+	while(changed)
+	{
+		changed = 0;
+		for(i = count - 1; i >= 0; i--)
+		{
+			struct mips_instruction *instruction = instructions[i];
+			unsigned int out = 0, in;
+
+			// A jump through $ra returns; any other is through a jump table, to anywhere
+			if(instruction->kind == MIPS_INSTRUCTION_OPERATION && !strcmp(instruction->opcode, "jr"))
+				out = instruction->operands[0].reg == MIPS_REGISTER_RA ? MIPS_RETURN_REGISTERS : ~0u;
+			else if(instruction->kind == MIPS_INSTRUCTION_OPERATION && !strcmp(instruction->opcode, "j"))
+				out = MIPS_RETURN_REGISTERS | MIPS_ARGUMENT_REGISTERS;
+			else
+			{
+				if(!mips_is_jump(instruction) && i + 1 < count)
+					out |= live_in[i + 1];
+				if(target[i] >= 0)
+					out |= live_in[target[i]];
+			}
+
+			in = uses[i] | (out & ~defs[i]);
+			if(in != live_in[i] || out != instruction->live_out)
+			{
+				live_in[i] = in;
+				instruction->live_out = out;
+				changed = 1;
+			}
+		}
+	}
+
+	free(instructions);
+	free(live_in);
+	free(uses);
+	free(defs);
+	free(target);
+	free(label_index);
 }
 
-/* mips_print_temporary_operand - "zeros" the temporary operand value and prints its
- *   formatted string mips representation
+/* mips_branch_target - the instruction a branch within a function goes to
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		operand - ir_operand - a temporary operand
+ * 		instructions - ir_instruction - the program, in order
+ * 		label_index - int - where each label is in it
+ * 		num_labels - int - how many labels there are
+ * 		i - int - the instruction
+ *
+ * Returns the label's place, or -1 for anything but a branch
  */
-void mips_print_temporary_operand(FILE *output, struct ir_operand *operand) {
-  assert(OPERAND_TEMPORARY == operand->kind);
+static int mips_branch_target(struct ir_instruction **instructions, int *label_index, int num_labels, int i) {
+	struct ir_instruction *instruction = instructions[i];
+	int j, k;
 
-  fprintf(output, "%8s%02d", "$", operand->data.temporary + FIRST_USABLE_REGISTER - register_offset);
+	switch(instruction->kind)
+	{
+	case IR_GOTO:
+	case IR_GOTO_IF_FALSE:
+	case IR_GOTO_IF_TRUE:
+	case IR_GOTO_IF_EQUAL:
+	case IR_GOTO_IF_NOT_EQUAL:
+	case IR_GOTO_IF_LESS:
+	case IR_GOTO_IF_LESS_EQUAL:
+	case IR_GOTO_IF_GREATER:
+	case IR_GOTO_IF_GREATER_EQUAL:
+		for(j = 0; j < 3; j++)
+			if(instruction->operands[j].kind == OPERAND_LABEL)
+				for(k = 0; k < num_labels; k++)
+					if(!strcmp(instructions[label_index[k]]->operands[0].data.label_name,
+							instruction->operands[j].data.label_name))
+						return label_index[k];
+		return -1;
+	default:
+		return -1;
+	}
 }
 
-/* mips_print_number_operand - prints a formatted string representing a number (to be used
- *   in an immediate command)
+/* mips_order_tree - numbers an instruction in the order its code comes out,
+ *   after the folded definitions it reads, which come out with it
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		operand - ir_operand - a number operand
+ * 		instructions - ir_instruction - the program, in order
+ * 		definition - int - where each folded temporary is defined, or -1
+ * 		when - int - set to when each instruction's code comes out
+ * 		time - int - the next number to give
+ * 		i - int - the instruction
  */
-void mips_print_number_operand(FILE *output, struct ir_operand *operand) {
-  assert(OPERAND_NUMBER == operand->kind);
+static void mips_order_tree(struct ir_instruction **instructions, int *definition, int *when, int *time, int i) {
+	int j, t;
+
+	for(j = 0; j < 3; j++)
+		if(instructions[i]->operands[j].kind == OPERAND_TEMPORARY)
+		{
+			t = instructions[i]->operands[j].data.temporary;
+			if(definition[t] >= 0 && definition[t] != i)
+				mips_order_tree(instructions, definition, when, time, definition[t]);
+		}
+	when[i] = (*time)++;
+}
+
+/* mips_assign_registers - gives each temporary one of $t0-$s7, reusing a
+ *   register once nothing reads its temporary any more.  Instructions are
+ *   taken in the order their code comes out, which select.c changes by
+ *   emitting a folded definition with the tree it is read in.  A temporary is
+ *   live from the first instruction that names it to the last, and over the
+ *   whole of any loop it is live at the start of.  Temporaries are handed the
+ *   lowest free register in the order they start in; one that finds none
+ *   gets REG_EXHAUSTED, which mips_temporary stops at.
+ *
+ * Parameters:
+ * 		section - ir_section - all the instructions
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void mips_assign_registers(struct ir_section *section) {
+	struct ir_instruction *iter, **instructions;
+	int *start, *end, *definition, *label_index, *target, *when, *first, *next;
+	int owner[NUM_REGISTERS];
+	int count = 0, num_labels = 0, max = -1, time = 0, changed = 1, i, j, t, reg;
+
+	for(iter = section->first; iter != section->last->next; iter = iter->next)
+	{
+		count++;
+		for(i = 0; i < 3; i++)
+			if(iter->operands[i].kind == OPERAND_TEMPORARY && iter->operands[i].data.temporary > max)
+				max = iter->operands[i].data.temporary;
+	}
+
+	mips_num_temporaries = max + 1;
+	mips_temporary_registers = malloc(sizeof(int) * (max + 1));
+	instructions = malloc(sizeof(struct ir_instruction *) * count);
+	start = malloc(sizeof(int) * (max + 1));
+	end = malloc(sizeof(int) * (max + 1));
+	definition = malloc(sizeof(int) * (max + 1));
+	next = malloc(sizeof(int) * (max + 1));
+	label_index = malloc(sizeof(int) * count);
+	target = malloc(sizeof(int) * count);
+	when = malloc(sizeof(int) * count);
+	first = malloc(sizeof(int) * count);
+	assert(NULL != mips_temporary_registers && NULL != instructions && NULL != start && NULL != end &&
+			NULL != definition && NULL != next && NULL != label_index && NULL != target && NULL != when &&
+			NULL != first);
+
+	for(t = 0; t <= max; t++)
+	{
+		start[t] = end[t] = definition[t] = -1;
+		mips_temporary_registers[t] = REG_EXHAUSTED;
+	}
+	for(i = 0, iter = section->first; i < count; iter = iter->next, i++)
+	{
+		instructions[i] = iter;
+		when[i] = first[i] = -1;
+		if(iter->kind == IR_LABEL)
+			label_index[num_labels++] = i;
+		if(iter->kind != IR_SEQUENCE_PT && iter->operands[0].kind == OPERAND_TEMPORARY)
+		{
+			t = iter->operands[0].data.temporary;
+			if(definition[t] < 0 && select_is_folded(t))
+				definition[t] = i;
+		}
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		iter = instructions[i];
+		if(iter->kind != IR_SEQUENCE_PT && iter->operands[0].kind == OPERAND_TEMPORARY &&
+				definition[iter->operands[0].data.temporary] == i)
+			continue;
+		mips_order_tree(instructions, definition, when, &time, i);
+	}
+	assert(time == count);
 
-  fprintf(output, "%10ld", operand->data.number);
+	for(i = 0; i < count; i++)
+	{
+		iter = instructions[i];
+		if(iter->kind == IR_SEQUENCE_PT)
+			continue;
+		for(j = 0; j < 3; j++)
+			if(iter->operands[j].kind == OPERAND_TEMPORARY)
+			{
+				t = iter->operands[j].data.temporary;
+				if(start[t] < 0 || when[i] < start[t])
+					start[t] = when[i];
+				if(when[i] > end[t])
+					end[t] = when[i];
+			}
+	}
+
+	// A temporary live where a loop starts has to last until its branch back
+	for(i = 0; i < count; i++)
+		target[i] = mips_branch_target(instructions, label_index, num_labels, i);
+	while(changed)
+	{
+		changed = 0;
+		for(i = 0; i < count; i++)
+		{
+			int top = target[i] < 0 ? -1 : when[target[i]];
+			if(top < 0 || top > when[i])
+				continue;
+			for(t = 0; t <= max; t++)
+				if(start[t] >= 0 && start[t] < top && end[t] >= top && end[t] < when[i])
+				{
+					end[t] = when[i];
+					changed = 1;
+				}
+		}
+	}
+
+	// The temporaries that start at each point, lowest first
+	for(t = max; t >= 0; t--)
+		if(start[t] >= 0)
+		{
+			next[t] = first[start[t]];
+			first[start[t]] = t;
+		}
+
+	for(reg = 0; reg < NUM_REGISTERS; reg++)
+		owner[reg] = -1;
+	for(i = 0; i < count; i++)
+	{
+		// An instruction's result never shares a register with what it reads
+		for(reg = FIRST_USABLE_REGISTER; reg <= LAST_USABLE_REGISTER; reg++)
+			if(owner[reg] >= 0 && end[owner[reg]] < i)
+				owner[reg] = -1;
+		for(t = first[i]; t >= 0; t = next[t])
+			for(reg = FIRST_USABLE_REGISTER; reg <= LAST_USABLE_REGISTER; reg++)
+				if(owner[reg] < 0)
+				{
+					owner[reg] = t;
+					mips_temporary_registers[t] = reg;
+					break;
+				}
+	}
+
+	free(instructions);
+	free(start);
+	free(end);
+	free(definition);
+	free(next);
+	free(label_index);
+	free(target);
+	free(when);
+	free(first);
 }
 
-/* mips_print_hi_lo - prints a multiply or divide mips command, and a mfhi or mflo
+/* mips_temporary - makes the register operand of a temporary
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		operand - ir_operand - a temporary operand
+ */
+struct mips_operand mips_temporary(struct ir_operand *operand) {
+  int reg;
+
+  assert(OPERAND_TEMPORARY == operand->kind);
+  assert(operand->data.temporary < mips_num_temporaries);
+  reg = mips_temporary_registers[operand->data.temporary];
+  // There is no spilling: a statement that needs more than $t0-$s7 stops here
+  // rather than write $t8, $k0 or $sp
+  assert(reg >= FIRST_USABLE_REGISTER && reg <= LAST_USABLE_REGISTER);
+  return mips_register(reg);
+}
+
+/* mips_memory - makes the address operand of a load or store, either through a
+ *   register or at an offset from the frame pointer
+ *
+ * Parameters:
+ * 		operand - ir_operand - a temporary or lvalue operand
+ */
+struct mips_operand mips_memory(struct ir_operand *operand) {
+	if(operand->kind == OPERAND_TEMPORARY)
+		return mips_address(0, mips_temporary(operand).reg);
+	assert(operand->kind == OPERAND_LVALUE);
+	return mips_address(operand->data.offset, MIPS_REGISTER_FP);
+}
+
+/* mips_generate_hi_lo - generates a multiply or divide mips command, and a mfhi or mflo
+ *
+ * Parameters:
+ * 		code - mips_section - section to append to
  * 		instruction - ir_instruction - the instruction containing the op code and operands
  */
-void mips_print_hi_lo(FILE *output, struct ir_instruction *instruction) {
+void mips_generate_hi_lo(struct mips_section *code, struct ir_instruction *instruction) {
 	int kind = instruction->kind;
+	int high = (kind == IR_MOD || kind == IR_MULTIPLY_HIGH || kind == IR_MULTIPLY_HIGH_U);
 	if(kind == IR_MOD)
 		kind = IR_DIVIDE;
 
 	// Do the operation on the second and third operands
-	fprintf(output, "%10s ", mips_kind_to_opcode(kind));
-	mips_print_temporary_operand(output, &instruction->operands[1]);
-	fputs(", ", output);
-	mips_print_temporary_operand(output, &instruction->operands[2]);
-	fputs("\n", output);
+	mips_emit(code, mips_kind_to_opcode(kind), 2,
+			mips_temporary(&instruction->operands[1]), mips_temporary(&instruction->operands[2]));
 
-	// Get the result out of hi or lo
-	switch(instruction->kind)
-	{
-	case IR_MULTIPLY:
-	case IR_MULU:
-	case IR_DIVIDE:
-	case IR_DIVU:
-		fprintf(output, "%10s ", "mflo");
-		break;
-	case IR_MOD:
-		fprintf(output, "%10s ", "mfhi");
-		break;
-	}
-	// Put that result in first operand of IR instruction
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs("\n", output);
+	// Get the result out of hi or lo, into the first operand of the IR instruction
+	mips_emit(code, high ? "mfhi" : "mflo", 1,
+			mips_temporary(&instruction->operands[0]));
 }
 
-/* mips_print_arithmetic - prints a formatted string representing an arithmetic mips command
+/* mips_generate_arithmetic - generates an arithmetic mips command
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		code - mips_section - section to append to
  * 		instruction - ir_instruction - the instruction containing the op code and operands
  */
-void mips_print_arithmetic(FILE *output, struct ir_instruction *instruction) {
-
-  fprintf(output, "%10s ", mips_kind_to_opcode(instruction->kind));
-  mips_print_temporary_operand(output, &instruction->operands[0]);
-  fputs(", ", output);
-  mips_print_temporary_operand(output, &instruction->operands[1]);
-  fputs(", ", output);
+void mips_generate_arithmetic(struct mips_section *code, struct ir_instruction *instruction) {
+  char *opcode = mips_kind_to_opcode(instruction->kind);
   struct ir_operand *op = &instruction->operands[2];
-  if (op->kind == OPERAND_NUMBER)
-	  mips_print_number_operand(output, &instruction->operands[2]);
-  else
-	  mips_print_temporary_operand(output, &instruction->operands[2]);
-  fputs("\n", output);
+  struct mips_operand right;
+
+  if (op->kind == OPERAND_NUMBER) {
+	  right = mips_number(op->data.number);
+  } else {
+	  right = mips_temporary(op);
+	  // Shifting by a register amount is a different instruction
+	  if (instruction->kind == IR_SHIFT_LEFT)
+		  opcode = "sllv";
+	  else if (instruction->kind == IR_SHIFT_RIGHT)
+		  opcode = "srav";
+	  else if (instruction->kind == IR_SHIFT_RIGHT_U)
+		  opcode = "srlv";
+  }
+  mips_emit(code, opcode, 3,
+		  mips_temporary(&instruction->operands[0]), mips_temporary(&instruction->operands[1]), right);
 }
 
-void mips_print_log_not(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s ", "seq");
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	mips_print_temporary_operand(output, &instruction->operands[1]);
-	fprintf(output, ", %10s\n", "$0");
+void mips_generate_log_not(struct mips_section *code, struct ir_instruction *instruction) {
+	mips_emit(code, "seq", 3, mips_temporary(&instruction->operands[0]),
+			mips_temporary(&instruction->operands[1]), mips_register(MIPS_REGISTER_ZERO));
 }
 
-/* mips_print_unary - prints a formatted string representing bitwise not or negation
+/* mips_generate_unary - generates bitwise not or negation
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		code - mips_section - section to append to
  * 		instruction - ir_instruction - the instruction containing the op code and operands
  */
-void mips_print_unary(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s ", mips_kind_to_opcode(instruction->kind));
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	mips_print_temporary_operand(output, &instruction->operands[1]);
-	fputs("\n", output);
+void mips_generate_unary(struct mips_section *code, struct ir_instruction *instruction) {
+	mips_emit(code, mips_kind_to_opcode(instruction->kind), 2,
+			mips_temporary(&instruction->operands[0]), mips_temporary(&instruction->operands[1]));
 }
 
-/* mips_print_load_store - prints a formatted string representing a load or store command
+/* mips_generate_load_store - generates a load or store command
  *   Operands can either be temporaries or offsets
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		code - mips_section - section to append to
  * 		instruction - ir_instruction - the instruction containing the op code and operands
  */
-void mips_print_load_store(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s ", mips_kind_to_opcode(instruction->kind));
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	struct ir_operand *op = &instruction->operands[1];
-	if(op->kind == OPERAND_TEMPORARY)
-	{
-		fputs("(", output);
-		mips_print_temporary_operand(output, op);
-		fputs(")\n", output);
-	}
-	else if(op->kind == OPERAND_LVALUE)
-		fprintf(output, "%6d%s\n", op->data.offset, "($fp)");
-
+void mips_generate_load_store(struct mips_section *code, struct ir_instruction *instruction) {
+	struct mips_instruction *access = mips_emit(code, mips_kind_to_opcode(instruction->kind), 2,
+			mips_temporary(&instruction->operands[0]), mips_memory(&instruction->operands[1]));
+	access->alias = instruction->alias;
 }
 
-/* mips_print_load_address - prints a formatted string representing a la command
+/* mips_generate_load_address - generates a la command
  *     either from an offset or a label
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		code - mips_section - section to append to
  * 		instruction - ir_instruction - the instruction containing the op code and operands
  */
-void mips_print_load_address (FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s ", mips_kind_to_opcode(instruction->kind));
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	if(instruction->operands[1].kind == OPERAND_LVALUE)
-	{
-		fprintf(output, "%6d%s\n", instruction->operands[1].data.offset, "($fp)");
-	}
-	else if(instruction->operands[1].kind == OPERAND_LABEL)
-	{
-		fprintf(output, "%10s\n", instruction->operands[1].data.label_name);
-	}
+void mips_generate_load_address(struct mips_section *code, struct ir_instruction *instruction) {
+	struct mips_operand source;
+	if(instruction->operands[1].kind == OPERAND_LABEL)
+		source = mips_label(instruction->operands[1].data.label_name);
+	else
+		source = mips_memory(&instruction->operands[1]);
+	mips_emit(code, mips_kind_to_opcode(instruction->kind), 2, mips_temporary(&instruction->operands[0]), source);
 }
 
-/* mips_print_copy - prints an or command to move a value from one register to another
+/* mips_generate_move - generates an or command to move a value from one register to another
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the operands
+ * 		code - mips_section - section to append to
+ * 		destination - int - register to move to
+ * 		source - int - register to move from
  */
-void mips_print_copy(FILE *output, struct ir_instruction *instruction) {
-  fprintf(output, "%10s ", "or");
-  mips_print_temporary_operand(output, &instruction->operands[0]);
-  fputs(", ", output);
-  mips_print_temporary_operand(output, &instruction->operands[1]);
-  fprintf(output, ", %10s\n", "$0");
+void mips_generate_move(struct mips_section *code, int destination, int source) {
+  mips_emit(code, "or", 3, mips_register(destination), mips_register(source), mips_register(MIPS_REGISTER_ZERO));
 }
 
-/* mips_print_load_immediate - prints a li command
+/* mips_generate_conversion - generates a change of width.  Values are kept
+ *   sign-extended in their registers, so widening is a move and narrowing
+ *   sign-extends the low bits.
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the operands
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing the op code and operands
  */
-void mips_print_load_immediate(FILE *output, struct ir_instruction *instruction) {
-  fprintf(output, "%10s ", "li");
-  mips_print_temporary_operand(output, &instruction->operands[0]);
-  fputs(", ", output);
-  mips_print_number_operand(output, &instruction->operands[1]);
-  fputs("\n", output);
+void mips_generate_conversion(struct mips_section *code, struct ir_instruction *instruction) {
+	struct mips_operand result = mips_temporary(&instruction->operands[0]);
+	int bits;
+
+	switch (instruction->kind) {
+	case IR_WORD_TO_BYTE:
+	case IR_HALF_WORD_TO_BYTE:
+		bits = 24;
+		break;
+	case IR_WORD_TO_HALF_WORD:
+		bits = 16;
+		break;
+	default:
+		mips_generate_move(code, result.reg, mips_temporary(&instruction->operands[1]).reg);
+		return;
+	}
+	mips_emit(code, "sll", 3, result, mips_temporary(&instruction->operands[1]), mips_number(bits));
+	mips_emit(code, "sra", 3, result, result, mips_number(bits));
 }
 
-/* mips_print_print_number - does not print a number, but prints instructions for a syscall
- *   to print a number to the console
+/* mips_generate_load_immediate - generates a li command
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the operand
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing the operands
  */
-void mips_print_print_number(FILE *output, struct ir_instruction *instruction) {
-  fprintf(output, "%10s %10s, %10s, %10d\n", "ori", "$v0", "$0", 1);
-  fprintf(output, "%10s %10s, %10s, ", "or", "$a0", "$0");
-  mips_print_temporary_operand(output, &instruction->operands[0]);
-  fprintf(output, "\n%10s\n", "syscall");
+void mips_generate_load_immediate(struct mips_section *code, struct ir_instruction *instruction) {
+  mips_emit(code, "li", 2, mips_temporary(&instruction->operands[0]), mips_number(instruction->operands[1].data.number));
 }
 
-/* mips_print_print_string - prints instructions for a syscall to print a string to console
+/* mips_generate_syscall - generates instructions for a syscall that takes its
+ *   argument in $a0, e.g. to print a number or a string to the console
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		code - mips_section - section to append to
+ * 		service - int - the syscall number
  * 		instruction - ir_instruction - the instruction containing the operand
  */
-void mips_print_print_string(FILE *output, struct ir_instruction *instruction) {
-  fprintf(output, "%10s %10s, %10s, %10d\n", "ori", "$v0", "$0", 4);
-  fprintf(output, "%10s %10s, %10s, ", "or", "$a0", "$0");
-  mips_print_temporary_operand(output, &instruction->operands[0]);
-  fprintf(output, "\n%10s\n", "syscall");
+void mips_generate_syscall(struct mips_section *code, int service, struct ir_instruction *instruction) {
+  mips_emit(code, "ori", 3, mips_register(MIPS_REGISTER_V0), mips_register(MIPS_REGISTER_ZERO), mips_number(service));
+  mips_generate_move(code, MIPS_REGISTER_A0, mips_temporary(&instruction->operands[0]).reg);
+  mips_emit(code, "syscall", 0);
 }
 
-/* mips_print_label - prints an operand label
+/* mips_generate_goto_cond - generates a conditional branch to the label
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the operand
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing the label name and conditional operand
  */
-void mips_print_label(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "\n%10s:", instruction->operands[0].data.label_name);
-	fputs("\n", output);
+void mips_generate_goto_cond(struct mips_section *code, struct ir_instruction *instruction) {
+	mips_emit(code, mips_kind_to_opcode(instruction->kind), 2, mips_temporary(&instruction->operands[0]),
+			mips_label(instruction->operands[1].data.label_name));
 }
 
-/* mips_print_goto - prints an unconditional branch to the label
+/* mips_compared_register - the register holding one side of a fused comparison,
+ *   which is a temporary or a constant; a constant other than 0 is loaded into $at
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the label name
+ * 		code - mips_section - section to append to
+ * 		operand - ir_operand - the operand
  */
-void mips_print_goto(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s %10s", "b", instruction->operands[0].data.label_name);
-	fputs("\n", output);
+static int mips_compared_register(struct mips_section *code, struct ir_operand *operand) {
+	if(operand->kind == OPERAND_NUMBER)
+	{
+		if(operand->data.number == 0)
+			return MIPS_REGISTER_ZERO;
+		mips_emit(code, "li", 2, mips_register(MIPS_REGISTER_AT), mips_number(operand->data.number));
+		return MIPS_REGISTER_AT;
+	}
+	return mips_temporary(operand).reg;
 }
 
-/* mips_print_goto_cond - prints a conditional branch to the label
+/* mips_generate_compare_branch - generates a branch on the relation between two
+ *   registers: beq or bne, or slt into $at and a branch on $at
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the label name and conditional operand
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing both operands and the label
  */
-void mips_print_goto_cond(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s ", mips_kind_to_opcode(instruction->kind));
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	fprintf(output, "%10s", instruction->operands[1].data.label_name);
-	fputs("\n", output);
-}
+void mips_generate_compare_branch(struct mips_section *code, struct ir_instruction *instruction) {
+	int left, right;
+	struct mips_operand label = mips_label(instruction->operands[2].data.label_name);
 
-/* mips_print_parameter - prints instructions to move a value into specified a register
- *
- * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the value and number of a register
- */
-void mips_print_parameter(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s%10s%d", "or", "$a", (int)instruction->operands[0].data.number);
-	fputs(", ", output);
-	mips_print_temporary_operand(output, &instruction->operands[1]);
-	fputs(", ", output);
-	fprintf(output, "%10s", "$0");
-	fputs("\n", output);
+	// Only one side can be in $at
+	assert(instruction->operands[0].kind != OPERAND_NUMBER || instruction->operands[1].kind != OPERAND_NUMBER ||
+			instruction->operands[0].data.number == 0 || instruction->operands[1].data.number == 0);
+	left = mips_compared_register(code, &instruction->operands[0]);
+	right = mips_compared_register(code, &instruction->operands[1]);
+
+	switch(instruction->kind)
+	{
+	case IR_GOTO_IF_EQUAL:
+	case IR_GOTO_IF_NOT_EQUAL:
+		mips_emit(code, mips_kind_to_opcode(instruction->kind), 3, mips_register(left), mips_register(right), label);
+		return;
+	case IR_GOTO_IF_LESS:
+	case IR_GOTO_IF_GREATER_EQUAL:
+		mips_emit(code, "slt", 3, mips_register(MIPS_REGISTER_AT), mips_register(left), mips_register(right));
+		break;
+	default:
+		mips_emit(code, "slt", 3, mips_register(MIPS_REGISTER_AT), mips_register(right), mips_register(left));
+		break;
+	}
+	// $at is set when the branch is taken for < and >, and clear for >= and <=
+	mips_emit(code, (instruction->kind == IR_GOTO_IF_LESS || instruction->kind == IR_GOTO_IF_GREATER) ? "bne" : "beq", 3,
+			mips_register(MIPS_REGISTER_AT), mips_register(MIPS_REGISTER_ZERO), label);
 }
 
-/* mips_print_return - prints instructions to move a value into $v0
+/* mips_generate_goto_table - generates a jump through a table of labels; the
+ *   entry number is scaled in its own register, which nothing reads after
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the value
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing the entry number and the table's label
  */
-void mips_print_return(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s %10s, ", "or", "$v0");
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	fprintf(output, "%10s", "$0");
-	fputs("\n", output);
+void mips_generate_goto_table(struct mips_section *code, struct ir_instruction *instruction) {
+	struct mips_operand entry = mips_temporary(&instruction->operands[0]);
+
+	mips_emit(code, "sll", 3, entry, entry, mips_number(2));
+	mips_emit(code, "la", 2, mips_register(MIPS_REGISTER_AT), mips_label(instruction->operands[1].data.label_name));
+	mips_emit(code, "addu", 3, mips_register(MIPS_REGISTER_AT), mips_register(MIPS_REGISTER_AT), entry);
+	mips_emit(code, "lw", 2, mips_register(MIPS_REGISTER_AT), mips_address(0, MIPS_REGISTER_AT));
+	mips_emit(code, "jr", 1, mips_register(MIPS_REGISTER_AT));
 }
 
-/* mips_print_result - prints instructions to move a value out of $v0
+/* Registers saved by every callee, with the frame offsets they are saved at */
+static int mips_saved_registers[][2] = {
+	{16, 16}, {17, 20}, {18, 24}, {19, 28}, {20, 32}, {21, 36}, {22, 40}, {23, 44},
+	{ 8, 48}, { 9, 52}, {10, 56}, {11, 60}, {12, 64}, {13, 68}, {14, 72}, {15, 76}
+};
+
+/* mips_generate_epilogue - loads values saved on the stack back into registers, sets the frame pointer
+ *   to the callee's value and increments stack pointer
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the destination
+ * 		code - mips_section - section to append to
+ * 		size - int - the stack frame size
  */
-void mips_print_result(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s ", "or");
-	mips_print_temporary_operand(output, &instruction->operands[0]);
-	fputs(", ", output);
-	fprintf(output, "%10s, %10s\n", "$v0", "$0");
+void mips_generate_epilogue(struct mips_section *code, int size) {
+	int i;
+	for(i = 0; i < 16; i++)
+		mips_emit(code, "lw", 2, mips_register(mips_saved_registers[i][0]),
+				mips_address(mips_saved_registers[i][1], MIPS_REGISTER_FP));
+
+	mips_emit(code, "lw", 2, mips_register(MIPS_REGISTER_RA), mips_address(84, MIPS_REGISTER_FP));
+	mips_emit(code, "lw", 2, mips_register(MIPS_REGISTER_FP), mips_address(80, MIPS_REGISTER_FP));
+	mips_emit(code, "addiu", 3, mips_register(MIPS_REGISTER_SP), mips_register(MIPS_REGISTER_SP), mips_number(size));
 }
 
-/* mips_print_function_call - prints a jal to label
+/* mips_generate_proc_end - tears down the stack frame and returns to ra
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the label name
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing the stack size
  */
-void mips_print_function_call(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s %10s\n", "jal", instruction->operands[0].data.label_name);
+void mips_generate_proc_end(struct mips_section *code, struct ir_instruction *instruction) {
+	mips_generate_epilogue(code, (int)instruction->operands[1].data.number);
+	mips_emit(code, "jr", 1, mips_register(MIPS_REGISTER_RA));
 }
 
-/* mips_print_proc_end - loads values saved on the stack back into registers, sets the frame pointer
- *   to the callee's value, increments stack pointer, returns to ra
+/* mips_generate_tail_call - tears down the stack frame and jumps to the callee, which
+ *   then returns straight to our caller.  Arguments are already in $a0-$a3.
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction containing the stack size
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction containing the label name and stack size
  */
-void mips_print_proc_end(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s7", "44($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s6", "40($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s5", "36($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s4", "32($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s3", "28($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s2", "24($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s1", "20($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$s0", "16($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t7", "76($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t6", "72($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t5", "68($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t4", "64($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t3", "60($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t2", "56($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t1", "52($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$t0", "48($fp)");
-
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$ra", "84($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "lw", "$fp", "80($fp)");
-	fprintf(output, "%10s %10s, %10s, %10lu\n", "addiu", "$sp", "$sp", instruction->operands[1].data.number);
-	fprintf(output, "%10s %10s\n", "jr", "$ra");
-}
-
-/* mips_print_proc_begin - decrements stack pointer, sets a new fp, sets old ra, saves registers on stack,
+void mips_generate_tail_call(struct mips_section *code, struct ir_instruction *instruction) {
+	mips_generate_epilogue(code, (int)instruction->operands[2].data.number);
+	mips_emit(code, "j", 1, mips_label(instruction->operands[0].data.label_name));
+}
+
+/* mips_generate_proc_begin - decrements stack pointer, sets a new fp, sets old ra, saves registers on stack,
  *
  * Parameters:
- * 		output - FILE - file to print to
+ * 		code - mips_section - section to append to
  * 		instruction - ir_instruction - the instruction containing the stack size
  */
-void mips_print_proc_begin(FILE *output, struct ir_instruction *instruction) {
-	fprintf(output, "%s:\n", instruction->operands[0].data.label_name);
+void mips_generate_proc_begin(struct mips_section *code, struct ir_instruction *instruction) {
 	int size = instruction->operands[1].data.number;
-	size = 0 - size;
-	fprintf(output, "%10s %10s, %10s, %10d\n", "addiu", "$sp", "$sp", size);
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$fp", "80($sp)");
-	fprintf(output, "%10s %10s, %10s, %10s\n", "or", "$fp", "$sp", "$0");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$ra", "84($fp)");
-
-	// Find out the number of params
 	int params = instruction->operands[2].data.number;
-	if(params > 0)
-		fprintf(output, "%10s %10s, %10s\n", "sw", "$a0", "0($fp)");
-	if(params > 1)
-		fprintf(output, "%10s %10s, %10s\n", "sw", "$a1", "4($fp)");
-	if(params > 2)
-		fprintf(output, "%10s %10s, %10s\n", "sw", "$a2", "8($fp)");
-	if(params > 3)
-		fprintf(output, "%10s %10s, %10s\n", "sw", "$a3", "12($fp)");
-
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s0", "16($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s1", "20($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s2", "24($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s3", "28($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s4", "32($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s5", "36($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s6", "40($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$s7", "44($fp)");
-
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t0", "48($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t1", "52($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t2", "56($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t3", "60($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t4", "64($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t5", "68($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t6", "72($fp)");
-	fprintf(output, "%10s %10s, %10s\n", "sw", "$t7", "76($fp)");
-}
-
-/* mips_print_instruction - multi-way branch, sends instructions to the correct print function
+	int i;
+
+	mips_emit_label(code, instruction->operands[0].data.label_name);
+	mips_emit(code, "addiu", 3, mips_register(MIPS_REGISTER_SP), mips_register(MIPS_REGISTER_SP), mips_number(0 - size));
+	mips_emit(code, "sw", 2, mips_register(MIPS_REGISTER_FP), mips_address(80, MIPS_REGISTER_SP));
+	mips_generate_move(code, MIPS_REGISTER_FP, MIPS_REGISTER_SP);
+	mips_emit(code, "sw", 2, mips_register(MIPS_REGISTER_RA), mips_address(84, MIPS_REGISTER_FP));
+
+	// Parameters go into their home slots at the bottom of the frame
+	for(i = 0; i < params && i < 4; i++)
+		mips_emit(code, "sw", 2, mips_register(MIPS_REGISTER_A0 + i), mips_address(i * 4, MIPS_REGISTER_FP));
+
+	for(i = 0; i < 16; i++)
+		mips_emit(code, "sw", 2, mips_register(mips_saved_registers[i][0]),
+				mips_address(mips_saved_registers[i][1], MIPS_REGISTER_FP));
+}
+
+/* mips_generate_instruction - multi-way branch, sends instructions to the correct generate function
  *
  * Parameters:
- * 		output - FILE - file to print to
- * 		instruction - ir_instruction - the instruction to print
+ * 		code - mips_section - section to append to
+ * 		instruction - ir_instruction - the instruction to translate
  */
-void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
+void mips_generate_instruction(struct mips_section *code, struct ir_instruction *instruction) {
   switch (instruction->kind) {
     case IR_MULTIPLY:
     case IR_DIVIDE:
     case IR_MULU:
     case IR_DIVU:
     case IR_MOD:
-    	mips_print_hi_lo(output, instruction);
+    case IR_MULTIPLY_HIGH:
+    case IR_MULTIPLY_HIGH_U:
+    	mips_generate_hi_lo(code, instruction);
     	break;
 
     case IR_ADD:
     case IR_SUBTRACT:
     case IR_SHIFT_LEFT:
     case IR_SHIFT_RIGHT:
+    case IR_SHIFT_RIGHT_U:
     case IR_XOR:
     case IR_LESS:
     case IR_LESS_EQUAL:
@@ -499,20 +1071,18 @@ void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_ADDU:
     case IR_SUBU:
     case IR_ADDI:
-      mips_print_arithmetic(output, instruction);
+    case IR_MOVE_IF_NOT_ZERO:
+    case IR_MOVE_IF_ZERO:
+      mips_generate_arithmetic(code, instruction);
       break;
-//
-//    case IR_ADDI:
-//        mips_print_arithmetic(output, instruction, 1);
-//        break;
 
     case IR_LOG_NOT:
-    	mips_print_log_not(output, instruction);
+    	mips_generate_log_not(code, instruction);
     	break;
 
     case IR_BIT_NOT:
     case IR_MAKE_NEGATIVE:
-    	mips_print_unary(output, instruction);
+    	mips_generate_unary(code, instruction);
     	break;
 
     case IR_LOAD_BYTE:
@@ -523,72 +1093,101 @@ void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
     case IR_STORE_BYTE:
     case IR_STORE_HALF_WORD:
     case IR_STORE_WORD:
-    	mips_print_load_store(output, instruction);
+    	mips_generate_load_store(code, instruction);
+    	break;
+
+    case IR_BYTE_TO_HALF_WORD:
+    case IR_BYTE_TO_WORD:
+    case IR_HALF_WORD_TO_BYTE:
+    case IR_HALF_WORD_TO_WORD:
+    case IR_WORD_TO_BYTE:
+    case IR_WORD_TO_HALF_WORD:
+    	mips_generate_conversion(code, instruction);
     	break;
 
     case IR_ADDRESS_OF:
-    	mips_print_load_address(output, instruction);
+    	mips_generate_load_address(code, instruction);
     	break;
 
     case IR_COPY:
-      mips_print_copy(output, instruction);
+      mips_generate_move(code, mips_temporary(&instruction->operands[0]).reg,
+    		  mips_temporary(&instruction->operands[1]).reg);
       break;
 
     case IR_LOAD_IMMEDIATE:
-      mips_print_load_immediate(output, instruction);
+      mips_generate_load_immediate(code, instruction);
       break;
 
     case IR_PRINT_NUMBER:
-      mips_print_print_number(output, instruction);
+      mips_generate_syscall(code, 1, instruction);
       break;
 
     case IR_PRINT_STRING:
-      mips_print_print_string(output, instruction);
+      mips_generate_syscall(code, 4, instruction);
       break;
 
     case IR_LABEL:
-    	mips_print_label(output, instruction);
+    	mips_emit_label(code, instruction->operands[0].data.label_name);
     	break;
 
     case IR_GOTO:
-    	mips_print_goto(output, instruction);
+    	mips_emit(code, "b", 1, mips_label(instruction->operands[0].data.label_name));
     	break;
 
     case IR_PARAMETER:
-    	mips_print_parameter(output, instruction);
+    	// Moves the value into the numbered $a register
+    	mips_generate_move(code, MIPS_REGISTER_A0 + (int)instruction->operands[0].data.number,
+    			mips_temporary(&instruction->operands[1]).reg);
     	break;
 
     case IR_NO_OPERATION:
     case IR_MAKE_POSITIVE:
+    case IR_RETURN_VOID:
       break;
 
     case IR_GOTO_IF_FALSE:
     case IR_GOTO_IF_TRUE:
-    	mips_print_goto_cond(output, instruction);
+    	mips_generate_goto_cond(code, instruction);
+    	break;
+
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+    	mips_generate_compare_branch(code, instruction);
+    	break;
+
+    case IR_GOTO_TABLE:
+    	mips_generate_goto_table(code, instruction);
     	break;
 
     case IR_RETURN:
-    	mips_print_return(output, instruction);
+    	mips_generate_move(code, MIPS_REGISTER_V0, mips_temporary(&instruction->operands[0]).reg);
     	break;
 
     case IR_PROC_END:
-    	mips_print_proc_end(output, instruction);
+    	mips_generate_proc_end(code, instruction);
     	break;
     case IR_PROC_BEGIN:
-    	mips_print_proc_begin(output, instruction);
+    	mips_generate_proc_begin(code, instruction);
     	break;
 
     case IR_RESULT_WORD:
     case IR_RESULT_BYTE:
-    	mips_print_result(output, instruction);
+    	mips_generate_move(code, mips_temporary(&instruction->operands[0]).reg, MIPS_REGISTER_V0);
     	break;
 
     case IR_SEQUENCE_PT:
-    	mips_sequence_point(&instruction->operands[0]);
     	break;
 
     case IR_FUNCTION_CALL:
-    	mips_print_function_call(output, instruction);
+    	mips_emit(code, "jal", 1, mips_label(instruction->operands[0].data.label_name));
+    	break;
+
+    case IR_TAIL_CALL:
+    	mips_generate_tail_call(code, instruction);
     	break;
 
     default:
@@ -597,24 +1196,136 @@ void mips_print_instruction(FILE *output, struct ir_instruction *instruction) {
   }
 }
 
-/* mips_print_text_section - prints a couple of standard pieces of preamble, then the instructions, one by one
+/* mips_generate_program - translates every IR instruction into a list of mips instructions
  *
  * Parameters:
- * 		output - FILE - file to print to
  * 		section - ir_section - all the instructions
+ *
+ * Returns the mips instructions
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
  */
-void mips_print_text_section(FILE *output, struct ir_section *section) {
+struct mips_section *mips_generate_program(struct ir_section *section) {
+  struct mips_section *code = malloc(sizeof(struct mips_section));
   struct ir_instruction *instruction;
 
+  assert(NULL != code);
+  code->first = NULL;
+  code->last = NULL;
+  code->noreorder = 0;
+  select_prepare(section);
+  mips_assign_registers(section);
+  for (instruction = section->first; instruction != section->last->next; instruction = instruction->next) {
+    // Whatever the tree rules do not cover is translated on its own
+    if (!select_instruction(code, instruction))
+      mips_generate_instruction(code, instruction);
+  }
+  select_finish();
+  free(mips_temporary_registers);
+  mips_temporary_registers = NULL;
+  mips_num_temporaries = 0;
+  return code;
+}
+
+/****************************
+ * MIPS OUTPUT              *
+ ****************************/
+
+static char *mips_register_names[NUM_REGISTERS] = {
+	"$0", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+	"$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+	"$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+	"$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+/* mips_print_operand - prints one formatted operand
+ *
+ * Parameters:
+ * 		output - FILE - file to print to
+ * 		operand - mips_operand - the operand
+ */
+void mips_print_operand(FILE *output, struct mips_operand *operand) {
+	assert(operand->kind != MIPS_OPERAND_REGISTER || (operand->reg >= 0 && operand->reg < NUM_REGISTERS));
+	switch(operand->kind)
+	{
+	case MIPS_OPERAND_REGISTER:
+		fprintf(output, "%10s", mips_register_names[operand->reg]);
+		break;
+	case MIPS_OPERAND_NUMBER:
+		fprintf(output, "%10ld", operand->number);
+		break;
+	case MIPS_OPERAND_LABEL:
+		fprintf(output, "%10s", operand->label);
+		break;
+	case MIPS_OPERAND_ADDRESS:
+		fprintf(output, "%6ld(%s)", operand->number, mips_register_names[operand->reg]);
+		break;
+	}
+}
+
+/* mips_print_instruction - prints one line of assembly
+ *
+ * Parameters:
+ * 		output - FILE - file to print to
+ * 		instruction - mips_instruction - the instruction to print
+ */
+void mips_print_instruction(FILE *output, struct mips_instruction *instruction) {
+	int i;
+
+	if(instruction->kind == MIPS_INSTRUCTION_LABEL)
+	{
+		fprintf(output, "\n%s:\n", instruction->operands[0].label);
+		return;
+	}
+
+	fprintf(output, "%10s", instruction->opcode);
+	for(i = 0; i < instruction->num_operands; i++)
+	{
+		fputs((i == 0) ? " " : ", ", output);
+		mips_print_operand(output, &instruction->operands[i]);
+	}
+	fputs("\n", output);
+}
+
+/* mips_print_text_section - prints a couple of standard pieces of preamble, then the instructions, one by one
+ *
+ * Parameters:
+ * 		output - FILE - file to print to
+ * 		code - mips_section - all the instructions
+ */
+void mips_print_text_section(FILE *output, struct mips_section *code) {
+  struct mips_instruction *instruction;
+
   fputs("\n.text\n", output);
-  fputs(".globl  main\n\n", output);
+  fputs(".globl  main\n", output);
+  // Delay slots have been filled already, so the assembler must not add nops
+  if (code->noreorder)
+    fputs(".set noreorder\n", output);
+  fputs("\n", output);
 
-  for (instruction = section->first; instruction != section->last->next; instruction = instruction->next) {
+  for (instruction = code->first; NULL != instruction; instruction = instruction->next) {
     mips_print_instruction(output, instruction);
   }
 }
 
-/* mips_print_date_section - prints string labels from the globally accessible (yes, I'm terrible) string_labels array
+/* mips_align_exponent - the n of ".align n", which aligns to 2^n bytes, for
+ *   an alignment in bytes; object.c aligns its sections with it too
+ *
+ * Parameters:
+ * 		alignment - int - the alignment, a power of two
+ */
+int mips_align_exponent(int alignment) {
+	int exponent = 0;
+
+	assert(alignment > 0 && 0 == (alignment & (alignment - 1)));
+	while((1 << exponent) < alignment)
+		exponent++;
+	return exponent;
+}
+
+/* mips_print_date_section - prints the string literal pool, then the file-scope
+ *   objects in ir_globals
  *
  * Parameters:
  * 		output - FILE - file to print to
@@ -623,21 +1334,31 @@ void mips_print_data_section(FILE *output) {
 	fputs("\n.data\n", output);
 
 	int i;
-	for(i = 0; i < string_labels_len; i++)
+	literal_print(output);
+
+	// File-scope objects, which all start out zero
+	for(i = 0; i < ir_globals_len; i++)
+		fprintf(output, ".align %d\n%s: .space %d\n", mips_align_exponent(ir_globals[i].alignment), ir_globals[i].label,
+				ir_globals[i].size);
+
+	// Jump tables for switch statements
+	for(i = 0; i < ir_jump_tables_len; i++)
 	{
-		fprintf(output, "_StringLabel_%d:", i);
-		fprintf(output, " .asciiz \"%s\"\n", string_labels[i]);
+		int j;
+		fprintf(output, ".align %d\n%s:", mips_align_exponent(4), ir_jump_tables[i].label);
+		for(j = 0; j < ir_jump_tables[i].count; j++)
+			fprintf(output, "%s%s", j == 0 ? " .word " : ", ", ir_jump_tables[i].targets[j]);
+		fputs("\n", output);
 	}
 }
 
-/* mips_print_text_program - calls the preamble print methods and passes the ir section to be printed
+/* mips_print_program - prints the data section and the instructions
  *
  * Parameters:
  * 		output - FILE - file to print to
- * 		section - ir_section - all the instructions
+ * 		code - mips_section - all the instructions
  */
-void mips_print_program(FILE *output, struct ir_section *section) {
-  register_offset = 0;
+void mips_print_program(FILE *output, struct mips_section *code) {
   mips_print_data_section(output);
-  mips_print_text_section(output, section);
+  mips_print_text_section(output, code);
 }
@@ -3,6 +3,83 @@
 
 #include <stdio.h>
 
-void mips_print_program(FILE *output, struct ir_section *section);
+#include "alias.h"
+
+struct ir_section;
+struct ir_operand;
+
+#define MIPS_REGISTER_ZERO   0
+#define MIPS_REGISTER_AT     1
+#define MIPS_REGISTER_V0     2
+#define MIPS_REGISTER_V1     3
+#define MIPS_REGISTER_A0     4
+#define MIPS_REGISTER_GP    28
+#define MIPS_REGISTER_SP    29
+#define MIPS_REGISTER_FP    30
+#define MIPS_REGISTER_RA    31
+
+#define MIPS_OPERAND_REGISTER  1
+#define MIPS_OPERAND_NUMBER    2
+#define MIPS_OPERAND_LABEL     3
+/* number(register), as used by loads, stores and la */
+#define MIPS_OPERAND_ADDRESS   4
+
+struct mips_operand {
+  int kind;
+  int reg;
+  long number;
+  char *label;
+};
+
+#define MIPS_INSTRUCTION_OPERATION 1
+#define MIPS_INSTRUCTION_LABEL     2
+
+/*
+ * One line of assembly: either an operation with up to three operands or the
+ * definition of a label (kept in operands[0]).
+ */
+struct mips_instruction {
+  int kind;
+  char *opcode;
+  int num_operands;
+  struct mips_operand operands[3];
+  /* Registers that may be read later, as a bit mask; see mips_compute_liveness */
+  unsigned int live_out;
+  /* What a load or store may touch, from the IR instruction it came from */
+  struct alias_location alias;
+  struct mips_instruction *prev, *next;
+};
+
+struct mips_section {
+  struct mips_instruction *first, *last;
+  /* Set once every branch and load delay slot is filled explicitly */
+  int noreorder;
+};
+
+struct mips_operand mips_register(int reg);
+struct mips_operand mips_number(long number);
+struct mips_operand mips_label(char *label);
+struct mips_operand mips_address(long offset, int reg);
+
+struct mips_instruction *mips_emit(struct mips_section *code, char *opcode, int num_operands, ...);
+struct mips_instruction *mips_emit_label(struct mips_section *code, char *label);
+void mips_insert_after(struct mips_section *code, struct mips_instruction *where, struct mips_instruction *instruction);
+void mips_remove(struct mips_section *code, struct mips_instruction *instruction);
+
+unsigned int mips_register_uses(struct mips_instruction *instruction);
+unsigned int mips_register_defs(struct mips_instruction *instruction);
+int mips_reads_register(struct mips_instruction *instruction, int reg);
+int mips_writes_register(struct mips_instruction *instruction, int reg);
+int mips_defined_register(struct mips_instruction *instruction);
+int mips_ends_block(struct mips_instruction *instruction);
+void mips_compute_liveness(struct mips_section *code);
+
+struct mips_operand mips_temporary(struct ir_operand *operand);
+struct mips_section *mips_generate_program(struct ir_section *section);
+void mips_print_instruction(FILE *output, struct mips_instruction *instruction);
+void mips_print_program(FILE *output, struct mips_section *code);
+int mips_align_exponent(int alignment);
+
+extern long mips_instructions_made;
 
 #endif
@@ -0,0 +1,240 @@
+/*
+ * multiply.c
+ *
+ * Multiplication by a constant as a chain of shifts, adds and subtracts, for
+ * targets where a multiply is slow.  The search is Bernstein's: the cheapest
+ * way to multiply by an odd n is the cheapest of
+ *
+ *   (x * m << k) + x      where n = m * 2^k + 1
+ *   (x * m << k) - x      where n = m * 2^k - 1
+ *   (y << k) + y          where n = m * (2^k + 1) and y = x * m
+ *   (y << k) - y          where n = m * (2^k - 1) and y = x * m
+ *
+ * and an even n is an odd one shifted left.  Every value the search visits is
+ * remembered, so the search does not go exponential and constants that come
+ * up again (element sizes, mostly) are free the second time.
+ *
+ * The chain is only used when it is cheaper than a multiply according to the
+ * cost table for the target.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "multiply.h"
+
+/*
+ * On the R2000 and R3000 a mult takes 12 cycles to reach lo; the multiply
+ * also needs the constant in a register and an mflo to get the result back.
+ * Shifts and adds take one cycle each.
+ */
+struct multiply_costs multiply_costs_mips = {"mips", 1, 1, 1, 6};
+
+struct multiply_costs *multiply_target = &multiply_costs_mips;
+
+int multiply_chains_enabled = 1;
+
+#define MULTIPLY_ONE              1
+#define MULTIPLY_SHIFTED          2
+#define MULTIPLY_ADD_ONE          3
+#define MULTIPLY_SUBTRACT_ONE     4
+#define MULTIPLY_FACTOR_ADD       5
+#define MULTIPLY_FACTOR_SUBTRACT  6
+
+/* The cheapest chain for one constant: how it is built from a smaller one */
+struct multiply_entry {
+  unsigned long constant;
+  int cost;
+  int rule;
+  unsigned long operand;
+  int amount;
+};
+
+#define MULTIPLY_MEMO_SIZE 4096
+
+static struct multiply_entry multiply_memo[MULTIPLY_MEMO_SIZE];
+static int multiply_memo_count;
+static struct multiply_costs *multiply_memo_target;
+
+/* multiply_slot - the memo slot that holds, or would hold, a constant */
+static struct multiply_entry *multiply_slot(unsigned long constant) {
+  unsigned long i = (constant * 2654435761UL) % MULTIPLY_MEMO_SIZE;
+
+  while (0 != multiply_memo[i].constant && constant != multiply_memo[i].constant) {
+    i = (i + 1) % MULTIPLY_MEMO_SIZE;
+  }
+  return &multiply_memo[i];
+}
+
+/* multiply_remember - stores a search result, starting over when the memo is full */
+static void multiply_remember(struct multiply_entry *entry) {
+  if (multiply_memo_count >= MULTIPLY_MEMO_SIZE * 3 / 4) {
+    memset(multiply_memo, 0, sizeof(multiply_memo));
+    multiply_memo_count = 0;
+  }
+  *multiply_slot(entry->constant) = *entry;
+  multiply_memo_count++;
+}
+
+/* multiply_trailing_zeros - the exponent of the largest power of two dividing a
+ *   non-zero constant
+ */
+static int multiply_trailing_zeros(unsigned long constant) {
+  int zeros = 0;
+
+  while (!(constant & 1)) {
+    constant >>= 1;
+    zeros++;
+  }
+  return zeros;
+}
+
+static struct multiply_entry multiply_search(unsigned long constant);
+
+/* multiply_consider - replaces the best chain so far if another one is cheaper
+ *
+ * Parameters:
+ *   best - multiply_entry - the cheapest chain found so far
+ *   rule - int - how the constant is built from operand
+ *   operand - unsigned long - the smaller constant
+ *   amount - int - the shift applied to it
+ *   extra - int - the cost of the instructions the rule adds
+ */
+static void multiply_consider(struct multiply_entry *best, int rule, unsigned long operand, int amount, int extra) {
+  int cost = multiply_search(operand).cost + extra;
+
+  if (cost < best->cost) {
+    best->cost = cost;
+    best->rule = rule;
+    best->operand = operand;
+    best->amount = amount;
+  }
+}
+
+/* multiply_search - finds the cheapest chain for a positive constant
+ *
+ * Parameters:
+ *   constant - unsigned long - the multiplier
+ *
+ * Returns the first step of the chain and its total cost
+ */
+static struct multiply_entry multiply_search(unsigned long constant) {
+  struct multiply_costs *costs = multiply_target;
+  struct multiply_entry *slot = multiply_slot(constant), best;
+  unsigned long factor;
+  int zeros, k;
+
+  if (constant == slot->constant) {
+    return *slot;
+  }
+
+  best.constant = constant;
+  best.cost = INT_MAX;
+  if (1 == constant) {
+    best.cost = 0;
+    best.rule = MULTIPLY_ONE;
+  } else if (!(constant & 1)) {
+    zeros = multiply_trailing_zeros(constant);
+    multiply_consider(&best, MULTIPLY_SHIFTED, constant >> zeros, zeros, costs->shift);
+  } else {
+    zeros = multiply_trailing_zeros(constant - 1);
+    multiply_consider(&best, MULTIPLY_ADD_ONE, (constant - 1) >> zeros, zeros, costs->shift + costs->add);
+    zeros = multiply_trailing_zeros(constant + 1);
+    multiply_consider(&best, MULTIPLY_SUBTRACT_ONE, (constant + 1) >> zeros, zeros, costs->shift + costs->subtract);
+
+    for (k = 1; k < 32 && (1UL << k) - 1 < constant; k++) {
+      factor = (1UL << k) + 1;
+      if (factor < constant && 0 == constant % factor) {
+        multiply_consider(&best, MULTIPLY_FACTOR_ADD, constant / factor, k, costs->shift + costs->add);
+      }
+      factor = (1UL << k) - 1;
+      if (k > 1 && 0 == constant % factor) {
+        multiply_consider(&best, MULTIPLY_FACTOR_SUBTRACT, constant / factor, k, costs->shift + costs->subtract);
+      }
+    }
+  }
+
+  multiply_remember(&best);
+  return best;
+}
+
+/* multiply_append - adds a step to a chain
+ *
+ * Returns the number of the value the step computes
+ */
+static int multiply_append(struct multiply_step *steps, int *count, int kind, int left, int right, int amount) {
+  assert(*count < MULTIPLY_MAX_STEPS);
+  steps[*count].kind = kind;
+  steps[*count].left = left;
+  steps[*count].right = right;
+  steps[*count].amount = amount;
+  return ++*count;
+}
+
+/* multiply_build - writes out the cheapest chain for a positive constant
+ *
+ * Returns the number of the value that holds the product
+ */
+static int multiply_build(unsigned long constant, struct multiply_step *steps, int *count) {
+  struct multiply_entry entry = multiply_search(constant);
+  int value, shifted;
+
+  if (MULTIPLY_ONE == entry.rule) {
+    return 0;
+  }
+  value = multiply_build(entry.operand, steps, count);
+  shifted = multiply_append(steps, count, MULTIPLY_SHIFT, value, 0, entry.amount);
+  switch (entry.rule) {
+    case MULTIPLY_ADD_ONE:
+      return multiply_append(steps, count, MULTIPLY_ADD, shifted, 0, 0);
+    case MULTIPLY_SUBTRACT_ONE:
+      return multiply_append(steps, count, MULTIPLY_SUBTRACT, shifted, 0, 0);
+    case MULTIPLY_FACTOR_ADD:
+      return multiply_append(steps, count, MULTIPLY_ADD, shifted, value, 0);
+    case MULTIPLY_FACTOR_SUBTRACT:
+      return multiply_append(steps, count, MULTIPLY_SUBTRACT, shifted, value, 0);
+    default:
+      return shifted;
+  }
+}
+
+/* multiply_plan - works out a shift and add chain for multiplying by a constant
+ *
+ * Parameters:
+ *   constant - long - the multiplier, a non-zero 32-bit value
+ *   steps - multiply_step - room for MULTIPLY_MAX_STEPS steps
+ *
+ * Returns the number of steps, the last of which computes the product (none
+ *   for a multiplier of 1), or -1 if a multiply is cheaper on the target
+ */
+int multiply_plan(long constant, struct multiply_step *steps) {
+  unsigned long magnitude = constant < 0 ? 0UL - (unsigned long)constant : (unsigned long)constant;
+  int cost, count = 0, value;
+
+  assert(0 != constant);
+  if (!multiply_chains_enabled) {
+    return -1;
+  }
+  // Costs depend on the target, so a new target starts a new memo
+  if (multiply_memo_target != multiply_target) {
+    memset(multiply_memo, 0, sizeof(multiply_memo));
+    multiply_memo_count = 0;
+    multiply_memo_target = multiply_target;
+  }
+
+  cost = multiply_search(magnitude).cost;
+  if (constant < 0) {
+    cost += multiply_target->subtract;
+  }
+  if (cost >= multiply_target->multiply) {
+    return -1;
+  }
+
+  value = multiply_build(magnitude, steps, &count);
+  if (constant < 0) {
+    multiply_append(steps, &count, MULTIPLY_NEGATE, value, 0, 0);
+  }
+  return count;
+}
@@ -0,0 +1,41 @@
+#ifndef _MULTIPLY_H
+#define _MULTIPLY_H
+
+/*
+ * One step of a multiplication by a constant.  Value 0 is the multiplicand
+ * and step i computes value i + 1 from earlier values.
+ */
+#define MULTIPLY_SHIFT     1 /* values[left] << amount */
+#define MULTIPLY_ADD       2 /* values[left] + values[right] */
+#define MULTIPLY_SUBTRACT  3 /* values[left] - values[right] */
+#define MULTIPLY_NEGATE    4 /* 0 - values[left] */
+
+struct multiply_step {
+  int kind;
+  int left, right;
+  int amount;
+};
+
+/* Enough steps for any 32-bit constant whose chain beats a multiply */
+#define MULTIPLY_MAX_STEPS 32
+
+/*
+ * What a target charges for the instructions a chain is built from, and for
+ * the multiply (including loading the constant and fetching the result) that
+ * the chain replaces.
+ */
+struct multiply_costs {
+  char *target;
+  int shift;
+  int add;
+  int subtract;
+  int multiply;
+};
+
+int multiply_plan(long constant, struct multiply_step *steps);
+
+extern struct multiply_costs multiply_costs_mips;
+extern struct multiply_costs *multiply_target;
+extern int multiply_chains_enabled;
+
+#endif
@@ -561,6 +561,56 @@ struct node *node_conditional(struct node *expr, struct node *st1, struct node *
   return node;
 }
 
+/*
+ * node_switch - allocate a node to represent a switch statement
+ *
+ * Parameters:
+ *   expr - node - contains a node representing the controlling expression
+ *
+ *   statement - node - contatins a node representing the body
+ *
+ * Returns a node containing the above.
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ *
+ */
+struct node *node_switch(struct node *expr, struct node *statement)
+{
+  struct node *node = node_create(NODE_SWITCH);
+  node->data.switch_statement.expr = expr;
+  node->data.switch_statement.statement = statement;
+  node->data.switch_statement.cases = NULL;
+  node->data.switch_statement.default_case = NULL;
+  return node;
+}
+
+/*
+ * node_case - allocate a node to represent a case or default label
+ *
+ * Parameters:
+ *   expr - node - contains a node representing the case's constant
+ *   expression, or NULL for default
+ *
+ *   statement - node - contatins a node representing the labeled statement
+ *
+ * Returns a node containing the above.
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ *
+ */
+struct node *node_case(struct node *expr, struct node *statement)
+{
+  struct node *node = node_create(NODE_CASE);
+  node->data.case_label.expr = expr;
+  node->data.case_label.statement = statement;
+  node->data.case_label.value = 0;
+  node->data.case_label.next = NULL;
+  node->data.case_label.label_name = NULL;
+  return node;
+}
+
 /*
  * node_operator - allocate a node to represent an operator
  *
@@ -1169,6 +1219,25 @@ void node_print_conditional(FILE *output, struct node *conditional) {
   }
 }
 
+void node_print_switch(FILE *output, struct node *switch_statement) {
+  fputs("switch(", output);
+  node_print_expression(output, switch_statement->data.switch_statement.expr);
+  fputs(")", output);
+  node_print_statement(output, switch_statement->data.switch_statement.statement);
+}
+
+void node_print_case(FILE *output, struct node *case_label) {
+  if(case_label->data.case_label.expr != NULL)
+  {
+    fputs("case ", output);
+    node_print_expression(output, case_label->data.case_label.expr);
+    fputs(": ", output);
+  }
+  else
+    fputs("default: ", output);
+  node_print_statement(output, case_label->data.case_label.statement);
+}
+
 void node_print_for(FILE *output, struct node *for_node) {
   fputs("for (", output);
   if(for_node->data.for_loop.expr1 != NULL)
@@ -1432,6 +1501,12 @@ void node_print_statement(FILE *output, struct node *statement) {
     case NODE_CONDITIONAL:
       node_print_conditional(output, statement);
       break;
+    case NODE_SWITCH:
+      node_print_switch(output, statement);
+      break;
+    case NODE_CASE:
+      node_print_case(output, statement);
+      break;
     case NODE_WHILE:
       node_print_while(output, statement);
       break;
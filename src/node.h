@@ -53,6 +53,8 @@ struct type;
 #define NODE_DIR_ABST_DEC                   29
 #define NODE_POSTFIX                        30
 #define NODE_PREFIX                         31
+#define NODE_SWITCH                         32
+#define NODE_CASE                           33
 
 
 /* node members specific to each type of node */
@@ -159,6 +161,24 @@ struct node {
       struct node *statement;
     } labeled_statement;
 
+    struct {
+      struct node *expr;
+      struct node *statement;
+      /* The switch's case and default labels, linked by symbol.c */
+      struct node *cases;
+      struct node *default_case;
+    } switch_statement;
+
+    struct {
+      /* NULL for a default label */
+      struct node *expr;
+      struct node *statement;
+      /* The value, once type.c has converted it to the switch's type */
+      long value;
+      struct node *next;
+      char *label_name;
+    } case_label;
+
     struct {
       struct node *type;
       struct node *declarator;
@@ -322,6 +342,8 @@ struct node *node_type_name(struct node *type, struct node *declarator);
 struct node *node_labeled_statement(struct node *id, struct node *statement);
 struct node *node_compound(struct node *statement_list);
 struct node *node_conditional(struct node *expr, struct node *st1, struct node *st2);
+struct node *node_switch(struct node *expr, struct node *statement);
+struct node *node_case(struct node *expr, struct node *statement);
 struct node *node_operator(int op);
 struct node *node_while(struct node *expr, struct node *statement, int type);
 struct node *node_for(struct node *expr1, struct node *expr2, struct node *expr3);
@@ -0,0 +1,1163 @@
+/*
+ * object.c
+ *
+ * Assembles the program straight into an ELF32 relocatable object, for -c,
+ * instead of printing assembly for an assembler to read back in.  Each
+ * mips_instruction is expanded into machine instructions the way the
+ * assembler expands its macros (li, la, move, b, the set-on-condition
+ * pseudo-instructions, immediates that need more than 16 bits), and each of
+ * those is encoded into a word.  Labels are placed in a first pass, since how
+ * many words an instruction takes never depends on where anything is, so
+ * branches are resolved as they are encoded; la, j and jal and the words of
+ * the jump tables are left to the linker as relocations against the section
+ * they point into.  Unless the code is written for .set noreorder, every
+ * branch gets a nop in its delay slot, as the assembler would give it.
+ *
+ * The data section is laid out the way mips_print_data_section has the
+ * assembler lay it out: the string literals, then the file-scope objects, then
+ * the jump tables.
+ *
+ * Every word is decoded again as soon as it is encoded, and it has to decode
+ * to the instruction it was encoded from and encode back to the same word.
+ * The same decoder prints the listing.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "ir.h"
+#include "mips.h"
+#include "literal.h"
+#include "object.h"
+
+int object_big_endian = 0;
+int object_num_errors;
+
+/* The most machine instructions one mips_instruction becomes, delay slot included */
+#define OBJECT_MAX_EXPANSION 4
+
+/* Where the operands of an instruction go */
+#define OBJECT_FORMAT_NONE        0  /* no operands */
+#define OBJECT_FORMAT_R           1  /* rd, rs, rt */
+#define OBJECT_FORMAT_SHIFT_V     2  /* rd, rt, rs */
+#define OBJECT_FORMAT_SHIFT       3  /* rd, rt, shift amount */
+#define OBJECT_FORMAT_I           4  /* rt, rs, signed immediate */
+#define OBJECT_FORMAT_I_U         5  /* rt, rs, unsigned immediate */
+#define OBJECT_FORMAT_LUI         6  /* rt, immediate */
+#define OBJECT_FORMAT_MEMORY      7  /* rt, offset(base) */
+#define OBJECT_FORMAT_BRANCH      8  /* rs, rt, label */
+#define OBJECT_FORMAT_BRANCH_Z    9  /* rs, label */
+#define OBJECT_FORMAT_JUMP       10  /* label */
+#define OBJECT_FORMAT_JR         11  /* rs */
+#define OBJECT_FORMAT_HI_LO      12  /* rs, rt */
+#define OBJECT_FORMAT_MOVE_FROM  13  /* rd */
+
+#define OBJECT_SPECIAL   0x00
+#define OBJECT_REGIMM    0x01
+#define OBJECT_SPECIAL2  0x1c
+
+#define OBJECT_RS(reg) ((uint32_t)(reg) << 21)
+#define OBJECT_RT(reg) ((uint32_t)(reg) << 16)
+#define OBJECT_RD(reg) ((uint32_t)(reg) << 11)
+
+struct object_opcode {
+  char *name;
+  int format;
+  int opcode;
+  /* The function field, or the rt field of a REGIMM branch */
+  int function;
+  /* For an operation with an immediate, the one that takes a register instead */
+  char *register_form;
+};
+
+static struct object_opcode object_opcodes[] = {
+  {"nop",     OBJECT_FORMAT_NONE,      OBJECT_SPECIAL,  0x00, NULL},
+  {"sll",     OBJECT_FORMAT_SHIFT,     OBJECT_SPECIAL,  0x00, NULL},
+  {"srl",     OBJECT_FORMAT_SHIFT,     OBJECT_SPECIAL,  0x02, NULL},
+  {"sra",     OBJECT_FORMAT_SHIFT,     OBJECT_SPECIAL,  0x03, NULL},
+  {"sllv",    OBJECT_FORMAT_SHIFT_V,   OBJECT_SPECIAL,  0x04, NULL},
+  {"srlv",    OBJECT_FORMAT_SHIFT_V,   OBJECT_SPECIAL,  0x06, NULL},
+  {"srav",    OBJECT_FORMAT_SHIFT_V,   OBJECT_SPECIAL,  0x07, NULL},
+  {"jr",      OBJECT_FORMAT_JR,        OBJECT_SPECIAL,  0x08, NULL},
+  {"movz",    OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x0a, NULL},
+  {"movn",    OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x0b, NULL},
+  {"syscall", OBJECT_FORMAT_NONE,      OBJECT_SPECIAL,  0x0c, NULL},
+  {"mfhi",    OBJECT_FORMAT_MOVE_FROM, OBJECT_SPECIAL,  0x10, NULL},
+  {"mflo",    OBJECT_FORMAT_MOVE_FROM, OBJECT_SPECIAL,  0x12, NULL},
+  {"mult",    OBJECT_FORMAT_HI_LO,     OBJECT_SPECIAL,  0x18, NULL},
+  {"multu",   OBJECT_FORMAT_HI_LO,     OBJECT_SPECIAL,  0x19, NULL},
+  {"div",     OBJECT_FORMAT_HI_LO,     OBJECT_SPECIAL,  0x1a, NULL},
+  {"divu",    OBJECT_FORMAT_HI_LO,     OBJECT_SPECIAL,  0x1b, NULL},
+  {"add",     OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x20, NULL},
+  {"addu",    OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x21, NULL},
+  {"sub",     OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x22, NULL},
+  {"subu",    OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x23, NULL},
+  {"and",     OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x24, NULL},
+  {"or",      OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x25, NULL},
+  {"xor",     OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x26, NULL},
+  {"nor",     OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x27, NULL},
+  {"slt",     OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x2a, NULL},
+  {"sltu",    OBJECT_FORMAT_R,         OBJECT_SPECIAL,  0x2b, NULL},
+  {"mul",     OBJECT_FORMAT_R,         OBJECT_SPECIAL2, 0x02, NULL},
+  {"bltz",    OBJECT_FORMAT_BRANCH_Z,  OBJECT_REGIMM,   0x00, NULL},
+  {"bgez",    OBJECT_FORMAT_BRANCH_Z,  OBJECT_REGIMM,   0x01, NULL},
+  {"j",       OBJECT_FORMAT_JUMP,      0x02,            0x00, NULL},
+  {"jal",     OBJECT_FORMAT_JUMP,      0x03,            0x00, NULL},
+  {"beq",     OBJECT_FORMAT_BRANCH,    0x04,            0x00, NULL},
+  {"bne",     OBJECT_FORMAT_BRANCH,    0x05,            0x00, NULL},
+  {"blez",    OBJECT_FORMAT_BRANCH_Z,  0x06,            0x00, NULL},
+  {"bgtz",    OBJECT_FORMAT_BRANCH_Z,  0x07,            0x00, NULL},
+  {"addi",    OBJECT_FORMAT_I,         0x08,            0x00, "add"},
+  {"addiu",   OBJECT_FORMAT_I,         0x09,            0x00, "addu"},
+  {"slti",    OBJECT_FORMAT_I,         0x0a,            0x00, "slt"},
+  {"sltiu",   OBJECT_FORMAT_I,         0x0b,            0x00, "sltu"},
+  {"andi",    OBJECT_FORMAT_I_U,       0x0c,            0x00, "and"},
+  {"ori",     OBJECT_FORMAT_I_U,       0x0d,            0x00, "or"},
+  {"xori",    OBJECT_FORMAT_I_U,       0x0e,            0x00, "xor"},
+  {"lui",     OBJECT_FORMAT_LUI,       0x0f,            0x00, NULL},
+  {"lb",      OBJECT_FORMAT_MEMORY,    0x20,            0x00, NULL},
+  {"lh",      OBJECT_FORMAT_MEMORY,    0x21,            0x00, NULL},
+  {"lw",      OBJECT_FORMAT_MEMORY,    0x23,            0x00, NULL},
+  {"lbu",     OBJECT_FORMAT_MEMORY,    0x24,            0x00, NULL},
+  {"lhu",     OBJECT_FORMAT_MEMORY,    0x25,            0x00, NULL},
+  {"sb",      OBJECT_FORMAT_MEMORY,    0x28,            0x00, NULL},
+  {"sh",      OBJECT_FORMAT_MEMORY,    0x29,            0x00, NULL},
+  {"sw",      OBJECT_FORMAT_MEMORY,    0x2b,            0x00, NULL},
+  {NULL,      0,                       0,               0x00, NULL}
+};
+
+/* Operations the assembler puts a nop after unless told .set noreorder */
+static char *object_delayed[] = {
+  "b", "j", "jal", "jr", "beq", "bne", "beqz", "bnez", "blez", "bgtz", "bltz", "bgez", NULL
+};
+
+#define OBJECT_SECTION_TEXT 1
+#define OBJECT_SECTION_DATA 2
+
+/* Relocation types */
+#define OBJECT_R_MIPS_32    2
+#define OBJECT_R_MIPS_26    4
+#define OBJECT_R_MIPS_HI16  5
+#define OBJECT_R_MIPS_LO16  6
+
+struct object_buffer {
+  unsigned char *bytes;
+  uint32_t len;
+  uint32_t size;
+};
+
+struct object_label {
+  char *name;
+  int section;
+  uint32_t offset;
+};
+
+struct object_relocation {
+  uint32_t offset;
+  int type;
+  /* The section it is against, or 0 for a symbol the program does not define */
+  int section;
+  char *symbol;
+};
+
+static struct object_buffer object_sections[3];
+static struct object_relocation *object_relocations[3];
+static int object_relocations_len[3];
+
+/* Labels in the order they are defined, text before data, and sorted by name */
+static struct object_label *object_labels;
+static int object_labels_len;
+static int object_text_labels_len;
+static struct object_label *object_labels_by_name;
+
+static char **object_undefined;
+static int object_undefined_len;
+
+static struct mips_operand object_none;
+
+/*********************
+ * BYTES             *
+ *********************/
+
+/* object_set - writes a value of 1, 2 or 4 bytes in the target's byte order */
+static void object_set(struct object_buffer *buffer, uint32_t at, uint32_t value, int width) {
+  int i;
+
+  for (i = 0; i < width; i++) {
+    int shift = 8 * (object_big_endian ? width - 1 - i : i);
+    buffer->bytes[at + i] = (unsigned char)(value >> shift);
+  }
+}
+
+/* object_get - reads a value of 1, 2 or 4 bytes in the target's byte order */
+static uint32_t object_get(struct object_buffer *buffer, uint32_t at, int width) {
+  uint32_t value = 0;
+  int i;
+
+  for (i = 0; i < width; i++) {
+    int shift = 8 * (object_big_endian ? width - 1 - i : i);
+    value |= (uint32_t)buffer->bytes[at + i] << shift;
+  }
+  return value;
+}
+
+/* object_reserve - makes room for len more bytes, zeroed, at the end of a buffer
+ *
+ * Returns where they start
+ */
+static uint32_t object_reserve(struct object_buffer *buffer, uint32_t len) {
+  uint32_t at = buffer->len;
+
+  if (buffer->len + len > buffer->size) {
+    buffer->size = buffer->size ? buffer->size * 2 : 256;
+    if (buffer->size < buffer->len + len) {
+      buffer->size = buffer->len + len;
+    }
+    buffer->bytes = realloc(buffer->bytes, buffer->size);
+    assert(NULL != buffer->bytes);
+  }
+  memset(buffer->bytes + at, 0, len);
+  buffer->len += len;
+  return at;
+}
+
+static void object_put(struct object_buffer *buffer, uint32_t value, int width) {
+  object_set(buffer, object_reserve(buffer, width), value, width);
+}
+
+static void object_put_bytes(struct object_buffer *buffer, const void *bytes, uint32_t len) {
+  uint32_t at = object_reserve(buffer, len);
+
+  if (len > 0) {
+    memcpy(buffer->bytes + at, bytes, len);
+  }
+}
+
+/* object_align - pads a buffer to a multiple of an alignment in bytes, as the
+ *   .align the assembly output gives for it would
+ */
+static void object_align(struct object_buffer *buffer, uint32_t alignment) {
+  uint32_t mask = (1u << mips_align_exponent(alignment)) - 1;
+
+  if (buffer->len & mask) {
+    object_reserve(buffer, mask + 1 - (buffer->len & mask));
+  }
+}
+
+/*********************
+ * LABELS            *
+ *********************/
+
+static void object_add_label(char *name, int section, uint32_t offset) {
+  object_labels = realloc(object_labels, sizeof(struct object_label) * (object_labels_len + 1));
+  assert(NULL != object_labels);
+  object_labels[object_labels_len].name = name;
+  object_labels[object_labels_len].section = section;
+  object_labels[object_labels_len++].offset = offset;
+}
+
+static int object_compare_labels(const void *left, const void *right) {
+  return strcmp(((const struct object_label *)left)->name, ((const struct object_label *)right)->name);
+}
+
+/* object_find_label - where a label is, or NULL if the program does not
+ *   define it; a string literal is found in the pool
+ */
+static struct object_label *object_find_label(char *name) {
+  static struct object_label literal;
+  struct object_label key, *found;
+  int offset;
+
+  key.name = name;
+  found = bsearch(&key, object_labels_by_name, object_labels_len, sizeof(struct object_label),
+                  object_compare_labels);
+  if (NULL != found) {
+    return found;
+  }
+  offset = literal_offset(name);
+  if (offset < 0) {
+    return NULL;
+  }
+  literal.name = name;
+  literal.section = OBJECT_SECTION_DATA;
+  literal.offset = offset;
+  return &literal;
+}
+
+/* object_text_label_at - the first label at an offset in the text, or NULL */
+static char *object_text_label_at(uint32_t offset) {
+  int low = 0, high = object_text_labels_len;
+
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (object_labels[middle].offset < offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < object_text_labels_len && object_labels[low].offset == offset ? object_labels[low].name : NULL;
+}
+
+static void object_relocate(int section, uint32_t offset, int type, struct object_label *label, char *name) {
+  struct object_relocation *relocation;
+  int i;
+
+  object_relocations[section] = realloc(object_relocations[section],
+                                        sizeof(struct object_relocation) * (object_relocations_len[section] + 1));
+  assert(NULL != object_relocations[section]);
+  relocation = &object_relocations[section][object_relocations_len[section]++];
+  relocation->offset = offset;
+  relocation->type = type;
+  relocation->section = NULL == label ? 0 : label->section;
+  relocation->symbol = NULL == label ? name : NULL;
+
+  if (NULL == label) {
+    for (i = 0; i < object_undefined_len; i++) {
+      if (!strcmp(object_undefined[i], name)) {
+        return;
+      }
+    }
+    object_undefined = realloc(object_undefined, sizeof(char *) * (object_undefined_len + 1));
+    assert(NULL != object_undefined);
+    object_undefined[object_undefined_len++] = name;
+  }
+}
+
+/*********************
+ * ENCODING          *
+ *********************/
+
+static struct object_opcode *object_find_opcode(char *name) {
+  int i;
+
+  for (i = 0; NULL != object_opcodes[i].name; i++) {
+    if (!strcmp(object_opcodes[i].name, name)) {
+      return &object_opcodes[i];
+    }
+  }
+  return NULL;
+}
+
+static int object_opcode_in(char *opcode, char **list) {
+  for (; NULL != *list; list++) {
+    if (!strcmp(opcode, *list)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* object_reference - the field of an instruction that refers to a label
+ *
+ * Parameters:
+ *   label - char * - the label
+ *   type - int - the relocation the field needs: the upper or lower half of
+ *     the address, or the word index of a jump
+ *   at - uint32_t - where the instruction is in the text
+ *   record - int - "true" to record the relocation
+ */
+static uint32_t object_reference(char *label, int type, uint32_t at, int record) {
+  struct object_label *found = object_find_label(label);
+  uint32_t value = NULL == found ? 0 : found->offset;
+
+  if (record) {
+    object_relocate(OBJECT_SECTION_TEXT, at, type, found, label);
+  }
+  switch (type) {
+    case OBJECT_R_MIPS_HI16:
+      return ((value + 0x8000) >> 16) & 0xffff;
+    case OBJECT_R_MIPS_LO16:
+      return value & 0xffff;
+    default:
+      return (value >> 2) & 0x3ffffff;
+  }
+}
+
+/* object_branch - the offset field of a branch to a label */
+static uint32_t object_branch(struct mips_operand *operand, uint32_t at, int record) {
+  struct object_label *found = object_find_label(operand->label);
+  int32_t delta;
+
+  if (NULL == found || found->section != OBJECT_SECTION_TEXT) {
+    if (record) {
+      object_num_errors++;
+      printf("ERROR - Branch to %s, which is not in the text.\n", operand->label);
+    }
+    return 0;
+  }
+  delta = ((int32_t)found->offset - (int32_t)(at + 4)) / 4;
+  if (delta < -32768 || delta > 32767) {
+    if (record) {
+      object_num_errors++;
+      printf("ERROR - Branch to %s is too far away.\n", operand->label);
+    }
+    return 0;
+  }
+  return (uint32_t)delta & 0xffff;
+}
+
+/* object_encode - encodes one machine instruction
+ *
+ * Parameters:
+ *   instruction - mips_instruction - an instruction the machine has, with a
+ *     label as the immediate of lui for the upper half of its address, and as
+ *     any other immediate or offset for the lower half
+ *   at - uint32_t - where it goes in the text
+ *   record - int - "true" to record relocations and errors; "false" to
+ *     encode it again only to check it
+ *
+ * Returns the word
+ */
+static uint32_t object_encode(struct mips_instruction *instruction, uint32_t at, int record) {
+  struct object_opcode *form = object_find_opcode(instruction->opcode);
+  struct mips_operand *operands = instruction->operands;
+  uint32_t word;
+
+  assert(NULL != form);
+  word = (uint32_t)form->opcode << 26;
+  switch (form->format) {
+    case OBJECT_FORMAT_NONE:
+      return word | form->function;
+    case OBJECT_FORMAT_R:
+      return word | OBJECT_RD(operands[0].reg) | OBJECT_RS(operands[1].reg) | OBJECT_RT(operands[2].reg) | form->function;
+    case OBJECT_FORMAT_SHIFT_V:
+      return word | OBJECT_RD(operands[0].reg) | OBJECT_RT(operands[1].reg) | OBJECT_RS(operands[2].reg) | form->function;
+    case OBJECT_FORMAT_SHIFT:
+      return word | OBJECT_RD(operands[0].reg) | OBJECT_RT(operands[1].reg) | ((uint32_t)operands[2].number & 31) << 6 |
+          form->function;
+    case OBJECT_FORMAT_I:
+    case OBJECT_FORMAT_I_U:
+      word |= OBJECT_RT(operands[0].reg) | OBJECT_RS(operands[1].reg);
+      if (operands[2].kind == MIPS_OPERAND_LABEL) {
+        return word | object_reference(operands[2].label, OBJECT_R_MIPS_LO16, at, record);
+      }
+      return word | ((uint32_t)operands[2].number & 0xffff);
+    case OBJECT_FORMAT_LUI:
+      word |= OBJECT_RT(operands[0].reg);
+      if (operands[1].kind == MIPS_OPERAND_LABEL) {
+        return word | object_reference(operands[1].label, OBJECT_R_MIPS_HI16, at, record);
+      }
+      return word | ((uint32_t)operands[1].number & 0xffff);
+    case OBJECT_FORMAT_MEMORY:
+      word |= OBJECT_RT(operands[0].reg) | OBJECT_RS(operands[1].reg);
+      if (NULL != operands[1].label) {
+        return word | object_reference(operands[1].label, OBJECT_R_MIPS_LO16, at, record);
+      }
+      return word | ((uint32_t)operands[1].number & 0xffff);
+    case OBJECT_FORMAT_BRANCH:
+      return word | OBJECT_RS(operands[0].reg) | OBJECT_RT(operands[1].reg) | object_branch(&operands[2], at, record);
+    case OBJECT_FORMAT_BRANCH_Z:
+      return word | OBJECT_RS(operands[0].reg) | OBJECT_RT(form->function) | object_branch(&operands[1], at, record);
+    case OBJECT_FORMAT_JUMP:
+      return word | object_reference(operands[0].label, OBJECT_R_MIPS_26, at, record);
+    case OBJECT_FORMAT_JR:
+      return word | OBJECT_RS(operands[0].reg) | form->function;
+    case OBJECT_FORMAT_HI_LO:
+      return word | OBJECT_RS(operands[0].reg) | OBJECT_RT(operands[1].reg) | form->function;
+    case OBJECT_FORMAT_MOVE_FROM:
+      return word | OBJECT_RD(operands[0].reg) | form->function;
+  }
+  assert(0);
+  return 0;
+}
+
+/*********************
+ * EXPANSION         *
+ *********************/
+
+/* object_add - sets the nth machine instruction of an expansion
+ *
+ * Returns n + 1
+ */
+static int object_add(struct mips_instruction *machine, int n, char *opcode, int num_operands,
+                      struct mips_operand a, struct mips_operand b, struct mips_operand c) {
+  assert(n < OBJECT_MAX_EXPANSION);
+  memset(&machine[n], 0, sizeof(struct mips_instruction));
+  machine[n].kind = MIPS_INSTRUCTION_OPERATION;
+  machine[n].opcode = opcode;
+  machine[n].num_operands = num_operands;
+  machine[n].operands[0] = a;
+  machine[n].operands[1] = b;
+  machine[n].operands[2] = c;
+  return n + 1;
+}
+
+/* object_load_immediate - expands li: one addiu or ori if the constant fits in
+ *   16 bits, otherwise lui and, for any lower half, ori
+ */
+static int object_load_immediate(struct mips_instruction *machine, int n, int reg, long number) {
+  uint32_t value = (uint32_t)number;
+
+  if ((int32_t)value >= -32768 && (int32_t)value <= 32767) {
+    return object_add(machine, n, "addiu", 3, mips_register(reg), mips_register(MIPS_REGISTER_ZERO),
+                      mips_number((int32_t)value));
+  }
+  if (value <= 0xffff) {
+    return object_add(machine, n, "ori", 3, mips_register(reg), mips_register(MIPS_REGISTER_ZERO), mips_number(value));
+  }
+  n = object_add(machine, n, "lui", 2, mips_register(reg), mips_number(value >> 16), object_none);
+  if (value & 0xffff) {
+    n = object_add(machine, n, "ori", 3, mips_register(reg), mips_register(reg), mips_number(value & 0xffff));
+  }
+  return n;
+}
+
+/* object_in_register - a register holding an operand, which is put in $at
+ *   first if it is a constant
+ */
+static struct mips_operand object_in_register(struct mips_instruction *machine, int *n, struct mips_operand operand) {
+  if (operand.kind != MIPS_OPERAND_NUMBER) {
+    return operand;
+  }
+  if (0 == operand.number) {
+    return mips_register(MIPS_REGISTER_ZERO);
+  }
+  *n = object_load_immediate(machine, *n, MIPS_REGISTER_AT, operand.number);
+  return mips_register(MIPS_REGISTER_AT);
+}
+
+/* object_immediate - expands an operation with an immediate, through $at and
+ *   the register form if the immediate does not fit
+ */
+static int object_immediate(struct mips_instruction *machine, int n, char *opcode, struct mips_operand target,
+                            struct mips_operand source, long number) {
+  struct object_opcode *form = object_find_opcode(opcode);
+  int fits = form->format == OBJECT_FORMAT_I_U ? number >= 0 && number <= 65535 : number >= -32768 && number <= 32767;
+
+  if (fits) {
+    return object_add(machine, n, opcode, 3, target, source, mips_number(number));
+  }
+  n = object_load_immediate(machine, n, MIPS_REGISTER_AT, number);
+  return object_add(machine, n, form->register_form, 3, target, source, mips_register(MIPS_REGISTER_AT));
+}
+
+/* object_expand_compare - expands the set-on-condition pseudo-instructions */
+static int object_expand_compare(struct mips_instruction *machine, struct mips_instruction *instruction) {
+  struct mips_operand target = instruction->operands[0], left = instruction->operands[1], right;
+  struct mips_operand zero = mips_register(MIPS_REGISTER_ZERO);
+  char *opcode = instruction->opcode;
+  int n = 0;
+
+  right = object_in_register(machine, &n, instruction->operands[2]);
+  if (!strcmp(opcode, "sgt")) {
+    return object_add(machine, n, "slt", 3, target, right, left);
+  } else if (!strcmp(opcode, "sle")) {
+    n = object_add(machine, n, "slt", 3, target, right, left);
+    return object_add(machine, n, "xori", 3, target, target, mips_number(1));
+  } else if (!strcmp(opcode, "sge")) {
+    n = object_add(machine, n, "slt", 3, target, left, right);
+    return object_add(machine, n, "xori", 3, target, target, mips_number(1));
+  } else if (!strcmp(opcode, "seq")) {
+    n = object_add(machine, n, "xor", 3, target, left, right);
+    return object_add(machine, n, "sltiu", 3, target, target, mips_number(1));
+  }
+  n = object_add(machine, n, "xor", 3, target, left, right);
+  return object_add(machine, n, "sltu", 3, target, zero, target);
+}
+
+/* object_expand_operation - expands an operation the machine has, for the
+ *   operands it does not take directly: a constant where it wants a register,
+ *   an immediate too big for its field, a label to load from or store to
+ */
+static int object_expand_operation(struct mips_instruction *machine, struct mips_instruction *instruction,
+                                   struct object_opcode *form) {
+  struct mips_operand *operands = instruction->operands, address, registers[3];
+  long offset, upper;
+  int n = 0, base, i;
+
+  switch (form->format) {
+    case OBJECT_FORMAT_I:
+    case OBJECT_FORMAT_I_U:
+      if (operands[2].kind == MIPS_OPERAND_NUMBER) {
+        return object_immediate(machine, 0, form->name, operands[0], operands[1], operands[2].number);
+      }
+      break;
+    case OBJECT_FORMAT_R:
+      if (operands[2].kind != MIPS_OPERAND_NUMBER) {
+        break;
+      }
+      for (i = 0; NULL != object_opcodes[i].name; i++) {
+        if (NULL != object_opcodes[i].register_form && !strcmp(object_opcodes[i].register_form, form->name)) {
+          return object_immediate(machine, 0, object_opcodes[i].name, operands[0], operands[1], operands[2].number);
+        }
+      }
+      if (!strcmp(form->name, "sub") || !strcmp(form->name, "subu")) {
+        return object_immediate(machine, 0, strcmp(form->name, "sub") ? "addiu" : "addi", operands[0], operands[1],
+                                -operands[2].number);
+      }
+      break;
+    case OBJECT_FORMAT_MEMORY:
+      if (operands[1].kind == MIPS_OPERAND_LABEL) {
+        // A load can build the address in the register it loads, as the assembler does
+        base = form->name[0] == 'l' && operands[0].reg != MIPS_REGISTER_ZERO ? operands[0].reg : MIPS_REGISTER_AT;
+        address = mips_address(0, base);
+        address.label = operands[1].label;
+        n = object_add(machine, 0, "lui", 2, mips_register(base), operands[1], object_none);
+        return object_add(machine, n, form->name, 2, operands[0], address, object_none);
+      }
+      offset = operands[1].number;
+      if (offset < -32768 || offset > 32767) {
+        upper = (offset + 0x8000) >> 16;
+        n = object_add(machine, 0, "lui", 2, mips_register(MIPS_REGISTER_AT), mips_number(upper & 0xffff), object_none);
+        n = object_add(machine, n, "addu", 3, mips_register(MIPS_REGISTER_AT), mips_register(MIPS_REGISTER_AT),
+                       mips_register(operands[1].reg));
+        return object_add(machine, n, form->name, 2, operands[0],
+                          mips_address(offset - upper * 65536, MIPS_REGISTER_AT), object_none);
+      }
+      return object_add(machine, 0, form->name, 2, operands[0], operands[1], object_none);
+  }
+
+  memcpy(registers, operands, sizeof(registers));
+  if (form->format == OBJECT_FORMAT_R || form->format == OBJECT_FORMAT_SHIFT_V || form->format == OBJECT_FORMAT_HI_LO ||
+      form->format == OBJECT_FORMAT_BRANCH) {
+    for (i = 0; i < (form->format == OBJECT_FORMAT_BRANCH ? 2 : instruction->num_operands); i++) {
+      registers[i] = object_in_register(machine, &n, registers[i]);
+    }
+  }
+  return object_add(machine, n, form->name, instruction->num_operands, registers[0], registers[1], registers[2]);
+}
+
+/* object_expand - the machine instructions an operation assembles to
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *   instruction - mips_instruction - an operation
+ *   machine - mips_instruction[OBJECT_MAX_EXPANSION] - set to the machine
+ *     instructions, and the nop in the delay slot outside .set noreorder
+ *   record - int - "true" to report an operation there is no encoding for
+ *
+ * Returns how many there are
+ */
+static int object_expand(struct mips_section *code, struct mips_instruction *instruction,
+                         struct mips_instruction *machine, int record) {
+  struct mips_operand *operands = instruction->operands;
+  struct mips_operand zero = mips_register(MIPS_REGISTER_ZERO);
+  char *opcode = instruction->opcode;
+  struct object_opcode *form;
+  int n;
+
+  if (!strcmp(opcode, "li")) {
+    n = object_load_immediate(machine, 0, operands[0].reg, operands[1].number);
+  } else if (!strcmp(opcode, "la") && operands[1].kind == MIPS_OPERAND_LABEL) {
+    n = object_add(machine, 0, "lui", 2, operands[0], operands[1], object_none);
+    n = object_add(machine, n, "addiu", 3, operands[0], operands[0], operands[1]);
+  } else if (!strcmp(opcode, "la")) {
+    n = object_immediate(machine, 0, "addiu", operands[0], mips_register(operands[1].reg), operands[1].number);
+  } else if (!strcmp(opcode, "move")) {
+    n = object_add(machine, 0, "addu", 3, operands[0], operands[1], zero);
+  } else if (!strcmp(opcode, "b")) {
+    n = object_add(machine, 0, "beq", 3, zero, zero, operands[0]);
+  } else if (!strcmp(opcode, "beqz") || !strcmp(opcode, "bnez")) {
+    n = object_add(machine, 0, strcmp(opcode, "beqz") ? "bne" : "beq", 3, operands[0], zero, operands[1]);
+  } else if (!strcmp(opcode, "neg") || !strcmp(opcode, "negu")) {
+    n = object_add(machine, 0, strcmp(opcode, "neg") ? "subu" : "sub", 3, operands[0], zero, operands[1]);
+  } else if (!strcmp(opcode, "not")) {
+    n = object_add(machine, 0, "nor", 3, operands[0], operands[1], zero);
+  } else if (!strcmp(opcode, "sgt") || !strcmp(opcode, "sle") || !strcmp(opcode, "sge") || !strcmp(opcode, "seq") ||
+             !strcmp(opcode, "sne")) {
+    n = object_expand_compare(machine, instruction);
+  } else if (NULL != (form = object_find_opcode(opcode))) {
+    n = object_expand_operation(machine, instruction, form);
+  } else {
+    if (record) {
+      object_num_errors++;
+      printf("ERROR - No encoding for %s.\n", opcode);
+    }
+    return 0;
+  }
+
+  if (!code->noreorder && object_opcode_in(opcode, object_delayed)) {
+    n = object_add(machine, n, "nop", 0, object_none, object_none, object_none);
+  }
+  return n;
+}
+
+/*********************
+ * DECODING          *
+ *********************/
+
+/* object_decode - works out which machine instruction a word is
+ *
+ * Parameters:
+ *   word - uint32_t - the word
+ *   at - uint32_t - where it is in the text, for branch targets
+ *   instruction - mips_instruction - set to the instruction, with branches
+ *     and jumps to the label at their target, and whatever a relocation
+ *     will add to left as a number
+ *
+ * Returns "true" if the word is an instruction this file encodes
+ */
+static int object_decode(uint32_t word, uint32_t at, struct mips_instruction *instruction) {
+  int opcode = word >> 26, rs = (word >> 21) & 31, rt = (word >> 16) & 31, rd = (word >> 11) & 31;
+  int function = word & 0x3f;
+  int32_t immediate = (int16_t)(word & 0xffff);
+  struct object_opcode *form = NULL;
+  struct mips_operand *operands = instruction->operands;
+  char *target;
+  int i;
+
+  memset(instruction, 0, sizeof(struct mips_instruction));
+  instruction->kind = MIPS_INSTRUCTION_OPERATION;
+  for (i = 0; NULL != object_opcodes[i].name && NULL == form; i++) {
+    struct object_opcode *candidate = &object_opcodes[i];
+    if (candidate->opcode != opcode || (0 == word) != !strcmp(candidate->name, "nop")) {
+      continue;
+    }
+    if (OBJECT_SPECIAL == opcode || OBJECT_SPECIAL2 == opcode) {
+      form = candidate->function == function ? candidate : NULL;
+    } else if (OBJECT_REGIMM == opcode) {
+      form = candidate->function == rt ? candidate : NULL;
+    } else {
+      form = candidate;
+    }
+  }
+  if (NULL == form) {
+    return 0;
+  }
+
+  instruction->opcode = form->name;
+  switch (form->format) {
+    case OBJECT_FORMAT_NONE:
+      instruction->num_operands = 0;
+      break;
+    case OBJECT_FORMAT_R:
+      instruction->num_operands = 3;
+      operands[0] = mips_register(rd);
+      operands[1] = mips_register(rs);
+      operands[2] = mips_register(rt);
+      break;
+    case OBJECT_FORMAT_SHIFT_V:
+      instruction->num_operands = 3;
+      operands[0] = mips_register(rd);
+      operands[1] = mips_register(rt);
+      operands[2] = mips_register(rs);
+      break;
+    case OBJECT_FORMAT_SHIFT:
+      instruction->num_operands = 3;
+      operands[0] = mips_register(rd);
+      operands[1] = mips_register(rt);
+      operands[2] = mips_number((word >> 6) & 31);
+      break;
+    case OBJECT_FORMAT_I:
+    case OBJECT_FORMAT_I_U:
+      instruction->num_operands = 3;
+      operands[0] = mips_register(rt);
+      operands[1] = mips_register(rs);
+      operands[2] = mips_number(form->format == OBJECT_FORMAT_I ? immediate : (long)(word & 0xffff));
+      break;
+    case OBJECT_FORMAT_LUI:
+      instruction->num_operands = 2;
+      operands[0] = mips_register(rt);
+      operands[1] = mips_number(word & 0xffff);
+      break;
+    case OBJECT_FORMAT_MEMORY:
+      instruction->num_operands = 2;
+      operands[0] = mips_register(rt);
+      operands[1] = mips_address(immediate, rs);
+      break;
+    case OBJECT_FORMAT_BRANCH:
+    case OBJECT_FORMAT_BRANCH_Z:
+      if (NULL == (target = object_text_label_at(at + 4 + (uint32_t)immediate * 4))) {
+        return 0;
+      }
+      operands[0] = mips_register(rs);
+      if (form->format == OBJECT_FORMAT_BRANCH) {
+        instruction->num_operands = 3;
+        operands[1] = mips_register(rt);
+        operands[2] = mips_label(target);
+      } else {
+        instruction->num_operands = 2;
+        operands[1] = mips_label(target);
+      }
+      break;
+    case OBJECT_FORMAT_JUMP:
+      if (NULL == (target = object_text_label_at((word & 0x3ffffff) << 2))) {
+        return 0;
+      }
+      instruction->num_operands = 1;
+      operands[0] = mips_label(target);
+      break;
+    case OBJECT_FORMAT_JR:
+      instruction->num_operands = 1;
+      operands[0] = mips_register(rs);
+      break;
+    case OBJECT_FORMAT_HI_LO:
+      instruction->num_operands = 2;
+      operands[0] = mips_register(rs);
+      operands[1] = mips_register(rt);
+      break;
+    case OBJECT_FORMAT_MOVE_FROM:
+      instruction->num_operands = 1;
+      operands[0] = mips_register(rd);
+      break;
+  }
+  return 1;
+}
+
+/* object_check - decodes a word just encoded, which must give back the
+ *   instruction it came from and encode to the same word again
+ *
+ * A register past $31 is a temporary the register window had no room for;
+ * it is reported as such rather than as an encoding that does not round-trip.
+ */
+static void object_check(struct mips_instruction *instruction, uint32_t at) {
+  struct mips_instruction decoded;
+  uint32_t word = object_get(&object_sections[OBJECT_SECTION_TEXT], at, 4);
+  int i;
+
+  for (i = 0; i < instruction->num_operands; i++) {
+    struct mips_operand *operand = &instruction->operands[i];
+    if ((operand->kind == MIPS_OPERAND_REGISTER || operand->kind == MIPS_OPERAND_ADDRESS) &&
+        (operand->reg < 0 || operand->reg > MIPS_REGISTER_RA)) {
+      object_num_errors++;
+      printf("ERROR - %s at 0x%08x uses register %d, outside the register window.\n", instruction->opcode, at,
+             operand->reg);
+      return;
+    }
+  }
+  if (!object_decode(word, at, &decoded) || strcmp(decoded.opcode, instruction->opcode) ||
+      decoded.num_operands != instruction->num_operands || object_encode(&decoded, at, 0) != word) {
+    object_num_errors++;
+    printf("ERROR - %s at 0x%08x does not decode to itself.\n", instruction->opcode, at);
+  }
+}
+
+/*********************
+ * ASSEMBLY          *
+ *********************/
+
+/* object_lay_out_data - puts the string literals, file-scope objects and jump
+ *   tables in the data section, and labels them
+ */
+static void object_lay_out_data(void) {
+  struct object_buffer *data = &object_sections[OBJECT_SECTION_DATA];
+  char *image;
+  int size = literal_layout(&image), i;
+
+  object_put_bytes(data, image, size);
+  free(image);
+
+  for (i = 0; i < ir_globals_len; i++) {
+    object_align(data, ir_globals[i].alignment);
+    object_add_label(ir_globals[i].label, OBJECT_SECTION_DATA, data->len);
+    object_reserve(data, ir_globals[i].size);
+  }
+  for (i = 0; i < ir_jump_tables_len; i++) {
+    object_align(data, 4);
+    object_add_label(ir_jump_tables[i].label, OBJECT_SECTION_DATA, data->len);
+    object_reserve(data, 4 * ir_jump_tables[i].count);
+  }
+}
+
+/* object_fill_jump_tables - writes the target of each entry of each jump
+ *   table, to be relocated against the text
+ */
+static void object_fill_jump_tables(void) {
+  struct object_label *table, *target;
+  int i, j;
+
+  for (i = 0; i < ir_jump_tables_len; i++) {
+    table = object_find_label(ir_jump_tables[i].label);
+    for (j = 0; j < ir_jump_tables[i].count; j++) {
+      target = object_find_label(ir_jump_tables[i].targets[j]);
+      if (NULL == target || target->section != OBJECT_SECTION_TEXT) {
+        object_num_errors++;
+        printf("ERROR - Jump table %s goes to %s, which is not in the text.\n", ir_jump_tables[i].label,
+               ir_jump_tables[i].targets[j]);
+        continue;
+      }
+      object_set(&object_sections[OBJECT_SECTION_DATA], table->offset + 4 * j, target->offset, 4);
+      object_relocate(OBJECT_SECTION_DATA, table->offset + 4 * j, OBJECT_R_MIPS_32, target, NULL);
+    }
+  }
+}
+
+/* object_assemble - encodes the program into the text and data sections
+ *
+ * Parameters:
+ *   code - mips_section - all the instructions
+ *
+ * Side-effects:
+ *   Any error is printed and counted in object_num_errors.
+ */
+void object_assemble(struct mips_section *code) {
+  struct mips_instruction *iter, machine[OBJECT_MAX_EXPANSION];
+  struct object_buffer *text = &object_sections[OBJECT_SECTION_TEXT];
+  uint32_t at = 0;
+  int n, i, in_slot = 0;
+
+  // Where each label is
+  for (iter = code->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == MIPS_INSTRUCTION_LABEL) {
+      object_add_label(iter->operands[0].label, OBJECT_SECTION_TEXT, at);
+    } else {
+      at += 4 * object_expand(code, iter, machine, 0);
+    }
+  }
+  object_text_labels_len = object_labels_len;
+  object_lay_out_data();
+
+  object_labels_by_name = malloc(sizeof(struct object_label) * (object_labels_len + 1));
+  assert(NULL != object_labels_by_name);
+  memcpy(object_labels_by_name, object_labels, sizeof(struct object_label) * object_labels_len);
+  qsort(object_labels_by_name, object_labels_len, sizeof(struct object_label), object_compare_labels);
+  object_fill_jump_tables();
+
+  for (iter = code->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == MIPS_INSTRUCTION_LABEL) {
+      continue;
+    }
+    n = object_expand(code, iter, machine, 1);
+    // Written for .set noreorder, a delay slot has to hold one instruction
+    if (in_slot && n > 1) {
+      object_num_errors++;
+      printf("ERROR - %s in a delay slot takes %d instructions.\n", iter->opcode, n);
+    }
+    in_slot = code->noreorder && object_opcode_in(iter->opcode, object_delayed);
+    for (i = 0; i < n; i++) {
+      at = object_reserve(text, 4);
+      object_set(text, at, object_encode(&machine[i], at, 1), 4);
+      object_check(&machine[i], at);
+    }
+  }
+}
+
+/*********************
+ * OUTPUT            *
+ *********************/
+
+static char *object_relocation_names[] = {
+  NULL, NULL, "R_MIPS_32", NULL, "R_MIPS_26", "R_MIPS_HI16", "R_MIPS_LO16"
+};
+
+static char *object_section_names[] = { NULL, ".text", ".data" };
+
+/* object_print_listing - prints the text as it decodes, with its relocations
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void object_print_listing(FILE *output) {
+  struct object_buffer *text = &object_sections[OBJECT_SECTION_TEXT];
+  struct object_relocation *relocation;
+  struct mips_instruction decoded;
+  uint32_t at, word;
+  int label = 0, next = 0;
+
+  for (at = 0; at <= text->len; at += 4) {
+    for (; label < object_text_labels_len && object_labels[label].offset == at; label++) {
+      fprintf(output, "\n%s:\n", object_labels[label].name);
+    }
+    if (at == text->len) {
+      break;
+    }
+    word = object_get(text, at, 4);
+    fprintf(output, "%08x %08x", at, word);
+    if (object_decode(word, at, &decoded)) {
+      // A call to a function the program does not define goes wherever the linker says
+      relocation = &object_relocations[OBJECT_SECTION_TEXT][next];
+      if (next < object_relocations_len[OBJECT_SECTION_TEXT] && relocation->offset == at &&
+          relocation->type == OBJECT_R_MIPS_26 && !relocation->section) {
+        decoded.operands[0] = mips_label(relocation->symbol);
+      }
+      mips_print_instruction(output, &decoded);
+    } else {
+      fprintf(output, "%10s %10u\n", ".word", word);
+    }
+    for (; next < object_relocations_len[OBJECT_SECTION_TEXT] &&
+           object_relocations[OBJECT_SECTION_TEXT][next].offset == at; next++) {
+      relocation = &object_relocations[OBJECT_SECTION_TEXT][next];
+      fprintf(output, "%28s %s\n", object_relocation_names[relocation->type],
+              relocation->section ? object_section_names[relocation->section] : relocation->symbol);
+    }
+  }
+  fprintf(output, "\n%u bytes of text, %u bytes of data, %d relocations\n", text->len,
+          object_sections[OBJECT_SECTION_DATA].len,
+          object_relocations_len[OBJECT_SECTION_TEXT] + object_relocations_len[OBJECT_SECTION_DATA]);
+}
+
+/* The sections of the file, by header index */
+#define OBJECT_SH_TEXT      1
+#define OBJECT_SH_DATA      2
+#define OBJECT_SH_REL_TEXT  3
+#define OBJECT_SH_REL_DATA  4
+#define OBJECT_SH_SYMTAB    5
+#define OBJECT_SH_STRTAB    6
+#define OBJECT_SH_SHSTRTAB  7
+#define OBJECT_SH_COUNT     8
+
+#define OBJECT_ELF_HEADER_SIZE   52
+#define OBJECT_ELF_SECTION_SIZE  40
+#define OBJECT_ELF_SYMBOL_SIZE   16
+#define OBJECT_ELF_REL_SIZE       8
+
+/* MIPS32, the o32 ABI, and delay slots filled already */
+#define OBJECT_ELF_FLAGS 0x50001001
+
+static uint32_t object_string(struct object_buffer *table, char *name) {
+  uint32_t at = table->len;
+
+  object_put_bytes(table, name, strlen(name) + 1);
+  return at;
+}
+
+static void object_symbol(struct object_buffer *symtab, uint32_t name, uint32_t value, int info, int section) {
+  object_put(symtab, name, 4);
+  object_put(symtab, value, 4);
+  object_put(symtab, 0, 4);
+  object_put(symtab, info, 1);
+  object_put(symtab, 0, 1);
+  object_put(symtab, section, 2);
+}
+
+/* object_write_section_header - writes one entry of the section header table */
+static void object_write_section_header(struct object_buffer *file, uint32_t name, uint32_t type, uint32_t flags,
+                                        uint32_t offset, uint32_t size, uint32_t link, uint32_t info,
+                                        uint32_t alignment, uint32_t entry_size) {
+  object_put(file, name, 4);
+  object_put(file, type, 4);
+  object_put(file, flags, 4);
+  object_put(file, 0, 4);
+  object_put(file, offset, 4);
+  object_put(file, size, 4);
+  object_put(file, link, 4);
+  object_put(file, info, 4);
+  object_put(file, alignment, 4);
+  object_put(file, entry_size, 4);
+}
+
+/* object_write - writes the assembled program as an ELF32 relocatable object
+ *
+ * Parameters:
+ *   output - FILE - file to write to, opened for binary output
+ *
+ * Side-effects:
+ *   Memory is allocated on the heap and freed.
+ */
+void object_write(FILE *output) {
+  struct object_buffer file = { NULL, 0, 0 }, symtab = { NULL, 0, 0 }, strtab = { NULL, 0, 0 };
+  struct object_buffer shstrtab = { NULL, 0, 0 }, rel[3] = { { NULL, 0, 0 }, { NULL, 0, 0 }, { NULL, 0, 0 } };
+  uint32_t offsets[OBJECT_SH_COUNT], names[OBJECT_SH_COUNT], data_alignment = 4, section_headers;
+  int first_global, main_defined = 0, section, i;
+  struct object_label *main_label = NULL;
+
+  for (i = 0; i < ir_globals_len; i++) {
+    if ((uint32_t)ir_globals[i].alignment > data_alignment) {
+      data_alignment = ir_globals[i].alignment;
+    }
+  }
+
+  // Symbols: the two sections, every label but main, then main and whatever
+  // the program calls without defining
+  object_string(&strtab, "");
+  object_symbol(&symtab, 0, 0, 0, 0);
+  object_symbol(&symtab, 0, 0, 3, OBJECT_SH_TEXT);
+  object_symbol(&symtab, 0, 0, 3, OBJECT_SH_DATA);
+  for (i = 0; i < object_labels_len; i++) {
+    if (!strcmp(object_labels[i].name, "main") && object_labels[i].section == OBJECT_SECTION_TEXT) {
+      main_label = &object_labels[i];
+      main_defined = 1;
+      continue;
+    }
+    object_symbol(&symtab, object_string(&strtab, object_labels[i].name), object_labels[i].offset, 0,
+                  object_labels[i].section == OBJECT_SECTION_TEXT ? OBJECT_SH_TEXT : OBJECT_SH_DATA);
+  }
+  first_global = symtab.len / OBJECT_ELF_SYMBOL_SIZE;
+  if (main_defined) {
+    object_symbol(&symtab, object_string(&strtab, "main"), main_label->offset, 0x12, OBJECT_SH_TEXT);
+  }
+  for (i = 0; i < object_undefined_len; i++) {
+    object_symbol(&symtab, object_string(&strtab, object_undefined[i]), 0, 0x10, 0);
+  }
+
+  for (section = OBJECT_SECTION_TEXT; section <= OBJECT_SECTION_DATA; section++) {
+    for (i = 0; i < object_relocations_len[section]; i++) {
+      struct object_relocation *relocation = &object_relocations[section][i];
+      uint32_t symbol;
+      if (relocation->section) {
+        symbol = relocation->section == OBJECT_SECTION_TEXT ? 1 : 2;
+      } else {
+        for (symbol = 0; strcmp(object_undefined[symbol], relocation->symbol); symbol++)
+          ;
+        symbol += first_global + main_defined;
+      }
+      object_put(&rel[section], relocation->offset, 4);
+      object_put(&rel[section], symbol << 8 | relocation->type, 4);
+    }
+  }
+
+  object_string(&shstrtab, "");
+  names[OBJECT_SH_TEXT] = object_string(&shstrtab, ".text");
+  names[OBJECT_SH_DATA] = object_string(&shstrtab, ".data");
+  names[OBJECT_SH_REL_TEXT] = object_string(&shstrtab, ".rel.text");
+  names[OBJECT_SH_REL_DATA] = object_string(&shstrtab, ".rel.data");
+  names[OBJECT_SH_SYMTAB] = object_string(&shstrtab, ".symtab");
+  names[OBJECT_SH_STRTAB] = object_string(&shstrtab, ".strtab");
+  names[OBJECT_SH_SHSTRTAB] = object_string(&shstrtab, ".shstrtab");
+
+  // The header is filled in last, when the section headers have a place
+  object_reserve(&file, OBJECT_ELF_HEADER_SIZE);
+  object_align(&file, 16);
+  offsets[OBJECT_SH_TEXT] = file.len;
+  object_put_bytes(&file, object_sections[OBJECT_SECTION_TEXT].bytes, object_sections[OBJECT_SECTION_TEXT].len);
+  object_align(&file, data_alignment);
+  offsets[OBJECT_SH_DATA] = file.len;
+  object_put_bytes(&file, object_sections[OBJECT_SECTION_DATA].bytes, object_sections[OBJECT_SECTION_DATA].len);
+  object_align(&file, 4);
+  offsets[OBJECT_SH_REL_TEXT] = file.len;
+  object_put_bytes(&file, rel[OBJECT_SECTION_TEXT].bytes, rel[OBJECT_SECTION_TEXT].len);
+  offsets[OBJECT_SH_REL_DATA] = file.len;
+  object_put_bytes(&file, rel[OBJECT_SECTION_DATA].bytes, rel[OBJECT_SECTION_DATA].len);
+  offsets[OBJECT_SH_SYMTAB] = file.len;
+  object_put_bytes(&file, symtab.bytes, symtab.len);
+  offsets[OBJECT_SH_STRTAB] = file.len;
+  object_put_bytes(&file, strtab.bytes, strtab.len);
+  offsets[OBJECT_SH_SHSTRTAB] = file.len;
+  object_put_bytes(&file, shstrtab.bytes, shstrtab.len);
+  object_align(&file, 4);
+
+  section_headers = file.len;
+  object_reserve(&file, OBJECT_ELF_SECTION_SIZE);
+  object_write_section_header(&file, names[OBJECT_SH_TEXT], 1, 0x6, offsets[OBJECT_SH_TEXT],
+                              object_sections[OBJECT_SECTION_TEXT].len, 0, 0, 16, 0);
+  object_write_section_header(&file, names[OBJECT_SH_DATA], 1, 0x3, offsets[OBJECT_SH_DATA],
+                              object_sections[OBJECT_SECTION_DATA].len, 0, 0, data_alignment, 0);
+  object_write_section_header(&file, names[OBJECT_SH_REL_TEXT], 9, 0x40, offsets[OBJECT_SH_REL_TEXT],
+                              rel[OBJECT_SECTION_TEXT].len, OBJECT_SH_SYMTAB, OBJECT_SH_TEXT, 4, OBJECT_ELF_REL_SIZE);
+  object_write_section_header(&file, names[OBJECT_SH_REL_DATA], 9, 0x40, offsets[OBJECT_SH_REL_DATA],
+                              rel[OBJECT_SECTION_DATA].len, OBJECT_SH_SYMTAB, OBJECT_SH_DATA, 4, OBJECT_ELF_REL_SIZE);
+  object_write_section_header(&file, names[OBJECT_SH_SYMTAB], 2, 0, offsets[OBJECT_SH_SYMTAB], symtab.len,
+                              OBJECT_SH_STRTAB, first_global, 4, OBJECT_ELF_SYMBOL_SIZE);
+  object_write_section_header(&file, names[OBJECT_SH_STRTAB], 3, 0, offsets[OBJECT_SH_STRTAB], strtab.len, 0, 0, 1, 0);
+  object_write_section_header(&file, names[OBJECT_SH_SHSTRTAB], 3, 0, offsets[OBJECT_SH_SHSTRTAB], shstrtab.len,
+                              0, 0, 1, 0);
+
+  // ELF identification: 32-bit, the byte order, version 1
+  memcpy(file.bytes, "\177ELF", 4);
+  file.bytes[4] = 1;
+  file.bytes[5] = object_big_endian ? 2 : 1;
+  file.bytes[6] = 1;
+  object_set(&file, 16, 1, 2);                           // relocatable
+  object_set(&file, 18, 8, 2);                           // MIPS
+  object_set(&file, 20, 1, 4);                           // version
+  object_set(&file, 32, section_headers, 4);
+  object_set(&file, 36, OBJECT_ELF_FLAGS, 4);
+  object_set(&file, 40, OBJECT_ELF_HEADER_SIZE, 2);
+  object_set(&file, 46, OBJECT_ELF_SECTION_SIZE, 2);
+  object_set(&file, 48, OBJECT_SH_COUNT, 2);
+  object_set(&file, 50, OBJECT_SH_SHSTRTAB, 2);
+
+  fwrite(file.bytes, 1, file.len, output);
+
+  free(file.bytes);
+  free(symtab.bytes);
+  free(strtab.bytes);
+  free(shstrtab.bytes);
+  for (section = OBJECT_SECTION_TEXT; section <= OBJECT_SECTION_DATA; section++) {
+    free(rel[section].bytes);
+  }
+}
@@ -0,0 +1,15 @@
+#ifndef _OBJECT_H
+#define _OBJECT_H
+
+#include <stdio.h>
+
+struct mips_section;
+
+void object_assemble(struct mips_section *code);
+void object_print_listing(FILE *output);
+void object_write(FILE *output);
+
+extern int object_big_endian;
+extern int object_num_errors;
+
+#endif
@@ -38,6 +38,7 @@
 
 %token BREAK CHAR CONTINUE DO ELSE FOR GOTO IF
 %token INT LONG RETURN SHORT SIGNED UNSIGNED VOID WHILE
+%token CASE DEFAULT SWITCH
 
 %token LEFT_PAREN RIGHT_PAREN LEFT_SQUARE RIGHT_SQUARE LEFT_CURLY RIGHT_CURLY
 
@@ -428,6 +429,10 @@ statement
 labeled_statement
   : IDENTIFIER COLON statement
         { $$ = node_labeled_statement($1, $3); }
+  | CASE constant_expr COLON statement
+        { $$ = node_case($2, $4); }
+  | DEFAULT COLON statement
+        { $$ = node_case(NULL, $3); }
 ;
 
 compound_statement
@@ -458,6 +463,8 @@ conditional_statement
           { $$ = node_conditional($3, $5, $7); }
   | IF LEFT_PAREN error RIGHT_PAREN 
           { yyerrok; }
+  | SWITCH LEFT_PAREN expr RIGHT_PAREN statement
+          { $$ = node_switch($3, $5); }
 ;
 
 iterative_statement
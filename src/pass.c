@@ -0,0 +1,391 @@
+/*
+ * pass.c
+ *
+ * The pass manager: which optimizations are on, the order the passes over
+ * the IR and over the MIPS code run in, the analyses they share, and what
+ * each pass did.
+ *
+ * The switches are the optimizations -f<name> turns on and -fno-<name> turns
+ * off.  Some are whole passes and some are choices made while generating IR
+ * or selecting instructions.  -O picks a set of them: -O0 none, -O1 those
+ * that cost little compile time, -O2 all of them (the default), and -Os
+ * those that do not make the code bigger.  -O sets them all first, so the
+ * -f switches change what it picked whichever way round they come.
+ *
+ * The pipelines list the passes in the order they run.  A pass that wants
+ * the IR's control flow graphs or the MIPS liveness asks for it here, and it
+ * is built only if no pass has built it since the code last changed.  After
+ * each pass the analyses it does not say it keeps right are thrown away.
+ * Each pass's counters record the instructions it made, the ones it took
+ * out, the analyses it had built and the time it took, for -fpass-report.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "ir.h"
+#include "cfg.h"
+#include "mips.h"
+#include "inline.h"
+#include "evaluate.h"
+#include "profile.h"
+#include "tailcall.h"
+#include "branch.h"
+#include "layout.h"
+#include "switch.h"
+#include "ifconvert.h"
+#include "vectorize.h"
+#include "multiply.h"
+#include "divide.h"
+#include "frame.h"
+#include "literal.h"
+#include "select.h"
+#include "loads.h"
+#include "peephole.h"
+#include "schedule.h"
+#include "pass.h"
+
+int pass_report = 0;
+
+/* -O levels, as pass_switches give them */
+#define PASS_O1 1
+#define PASS_O2 2
+
+/* The optimizations that can be switched one at a time */
+static struct {
+  char *name;
+  int *enabled;
+  /* The lowest -O level it is on at */
+  int level;
+  /* Whether -Os keeps it on: it does not trade size for speed */
+  int for_size;
+} pass_switches[] = {
+  {"ipa-pure-const",               &evaluate_enabled,            PASS_O2, 1},
+  {"inline",                       &inline_enabled,              PASS_O2, 0},
+  {"optimize-sibling-calls",       &tailcall_enabled,            PASS_O1, 1},
+  {"fuse-branches",                &branch_fuse_enabled,         PASS_O1, 1},
+  {"rotate-loops",                 &branch_rotate_enabled,       PASS_O2, 0},
+  {"reorder-blocks",               &layout_enabled,              PASS_O2, 1},
+  {"reorder-blocks-and-partition", &layout_split_cold,           PASS_O2, 0},
+  {"jump-tables",                  &switch_tables_enabled,       PASS_O1, 1},
+  {"bit-tests",                    &switch_bit_tests_enabled,    PASS_O1, 1},
+  {"if-conversion",                &ifconvert_enabled,           PASS_O1, 1},
+  {"conditional-moves",            &ifconvert_conditional_moves, PASS_O1, 1},
+  {"tree-loop-vectorize",          &vectorize_enabled,           PASS_O2, 0},
+  {"multiply-chains",              &multiply_chains_enabled,     PASS_O1, 0},
+  {"magic-division",               &divide_magic_enabled,        PASS_O1, 0},
+  {"frame-layout",                 &frame_layout_enabled,        PASS_O1, 1},
+  {"merge-strings",                &literal_merge_suffixes,      PASS_O1, 1},
+  {"tree-select",                  &select_enabled,              PASS_O1, 1},
+  {"redundant-loads",              &loads_enabled,               PASS_O1, 1},
+  {"peephole",                     &peephole_enabled,            PASS_O1, 1},
+  {"schedule-insns",               &schedule_enabled,            PASS_O2, 1},
+  {NULL,                           NULL,                         0,       0}
+};
+
+/*
+ * A pass over the IR or over the MIPS code.  enabled is the switch that
+ * turns it off, if any; the pass looks at its own switches too.
+ */
+struct pass {
+  char *name;
+  void (*run_ir)(struct ir_section *section);
+  void (*run_mips)(struct mips_section *code, struct ir_section *ir);
+  int *enabled;
+  /* The analyses it leaves right, or keeps right itself */
+  int preserves;
+};
+
+/* What a pass did, for pass_print_report; kept apart from the tables above,
+ * one for each entry */
+struct pass_stats {
+  int runs;
+  long added, removed;
+  int analyses_built;
+  clock_t time;
+};
+
+static void pass_loads(struct mips_section *code, struct ir_section *ir) {
+  loads_optimize(code, ir);
+}
+
+static void pass_peephole(struct mips_section *code, struct ir_section *ir) {
+  (void)ir;
+  peephole_optimize(code);
+}
+
+static void pass_schedule(struct mips_section *code, struct ir_section *ir) {
+  (void)ir;
+  schedule_program(code);
+}
+
+/* The IR passes: unreachable code goes before anything looks at the graphs,
+ * and again after the passes that leave some behind */
+static struct pass pass_ir_pipeline[] = {
+  {"cleanup",                ir_garbage_collect, NULL, NULL,              0},
+  {"ipa-pure-const",         evaluate_program,   NULL, &evaluate_enabled, 0},
+  {"profile",                profile_program,    NULL, NULL,              0},
+  {"inline",                 inline_functions,   NULL, &inline_enabled,   0},
+  {"cleanup",                ir_garbage_collect, NULL, NULL,              0},
+  {"optimize-sibling-calls", tailcall_optimize,  NULL, &tailcall_enabled, 0},
+  {"cleanup",                ir_garbage_collect, NULL, NULL,              0},
+  {"branches",               branch_optimize,    NULL, NULL,              0},
+  {"reorder-blocks",         layout_program,     NULL, &layout_enabled,   0},
+  {NULL,                     NULL,               NULL, NULL,              0}
+};
+
+/* The MIPS passes; peephole keeps the liveness right as it rewrites */
+static struct pass pass_mips_pipeline[] = {
+  {"redundant-loads", NULL, pass_loads,    &loads_enabled,    0},
+  {"peephole",        NULL, pass_peephole, &peephole_enabled, PASS_LIVENESS},
+  {"schedule",        NULL, pass_schedule, NULL,              0},
+  {NULL,              NULL, NULL,          NULL,              0}
+};
+
+static struct pass_stats pass_ir_stats[sizeof(pass_ir_pipeline) / sizeof(pass_ir_pipeline[0])];
+static struct pass_stats pass_mips_stats[sizeof(pass_mips_pipeline) / sizeof(pass_mips_pipeline[0])];
+
+/* The analyses that are up to date, and what they describe */
+static int pass_valid;
+static struct ir_section *pass_cfg_section;
+static struct cfg *pass_graphs;
+static struct mips_section *pass_liveness_code;
+
+/* The counters of the pass running, which is charged for the analyses built */
+static struct pass_stats *pass_current;
+
+/****************************
+ * SWITCHES                 *
+ ****************************/
+
+/* pass_set_level - turns the optimizations on or off for -O<level>
+ *
+ * Parameters:
+ *   level - char * - 0, 1, 2 or s
+ *
+ * Returns "true" if the level was recognized
+ */
+int pass_set_level(char *level) {
+  int i, number;
+
+  if (!strcmp(level, "s")) {
+    for (i = 0; NULL != pass_switches[i].name; i++) {
+      *pass_switches[i].enabled = pass_switches[i].for_size;
+    }
+    return 1;
+  }
+  if (strlen(level) != 1 || level[0] < '0' || level[0] > '2') {
+    return 0;
+  }
+  number = level[0] - '0';
+  for (i = 0; NULL != pass_switches[i].name; i++) {
+    *pass_switches[i].enabled = number >= pass_switches[i].level;
+  }
+  return 1;
+}
+
+/* pass_set_flag - handles -f<name> and -fno-<name> for an optimization
+ *
+ * Parameters:
+ *   flag - char * - the option text following -f
+ *
+ * Returns "true" if the option was recognized
+ */
+int pass_set_flag(char *flag) {
+  int i, on = 1;
+
+  if (!strncmp(flag, "no-", 3)) {
+    flag += 3;
+    on = 0;
+  }
+  for (i = 0; NULL != pass_switches[i].name; i++) {
+    if (!strcmp(flag, pass_switches[i].name)) {
+      *pass_switches[i].enabled = on;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/****************************
+ * ANALYSES                 *
+ ****************************/
+
+/* pass_cfg - the control flow graphs of every function, built again only if
+ *   the IR may have changed since they last were
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Returns the graphs, which belong to the pass manager: pass_invalidate
+ *   frees them
+ */
+struct cfg *pass_cfg(struct ir_section *section) {
+  if (!(pass_valid & PASS_CFG) || section != pass_cfg_section) {
+    pass_invalidate(PASS_CFG);
+    pass_graphs = cfg_build_program(section);
+    pass_cfg_section = section;
+    pass_valid |= PASS_CFG;
+    if (NULL != pass_current) {
+      pass_current->analyses_built++;
+    }
+  }
+  return pass_graphs;
+}
+
+/* pass_liveness - sets the live_out of every MIPS instruction, unless it is
+ *   still right from the last time
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ */
+void pass_liveness(struct mips_section *code) {
+  if (!(pass_valid & PASS_LIVENESS) || code != pass_liveness_code) {
+    mips_compute_liveness(code);
+    pass_liveness_code = code;
+    pass_valid |= PASS_LIVENESS;
+    if (NULL != pass_current) {
+      pass_current->analyses_built++;
+    }
+  }
+}
+
+/* pass_invalidate - marks analyses as out of date, for a pass that has just
+ *   changed the code they describe
+ *
+ * Parameters:
+ *   analyses - int - PASS_CFG, PASS_LIVENESS or both
+ *
+ * Side-effects:
+ *   The graphs pass_cfg returned may be freed.
+ */
+void pass_invalidate(int analyses) {
+  if ((analyses & PASS_CFG) && NULL != pass_graphs) {
+    cfg_free(pass_graphs);
+    pass_graphs = NULL;
+  }
+  pass_valid &= ~analyses;
+}
+
+/****************************
+ * PIPELINES                *
+ ****************************/
+
+static long pass_count_ir(struct ir_section *section) {
+  struct ir_instruction *iter;
+  long count = 0;
+
+  for (iter = section->first; NULL != iter; iter = iter->next) {
+    count++;
+    if (iter == section->last) {
+      break;
+    }
+  }
+  return count;
+}
+
+static long pass_count_mips(struct mips_section *code) {
+  struct mips_instruction *iter;
+  long count = 0;
+
+  for (iter = code->first; NULL != iter; iter = iter->next) {
+    count++;
+  }
+  return count;
+}
+
+/* pass_run - runs one pass and adds to its counters; the instructions it
+ *   made are counted as they are made, and the ones it took out follow from
+ *   how many there are before and after
+ */
+static void pass_run(struct pass *pass, struct pass_stats *stats, struct mips_section *code, struct ir_section *ir) {
+  long before, made;
+  clock_t start;
+
+  if (NULL != pass->enabled && !*pass->enabled) {
+    return;
+  }
+  pass_current = stats;
+  start = clock();
+  if (NULL != pass->run_ir) {
+    before = pass_count_ir(ir);
+    made = ir_instructions_made;
+    pass->run_ir(ir);
+    made = ir_instructions_made - made;
+    stats->removed += before + made - pass_count_ir(ir);
+  } else {
+    before = pass_count_mips(code);
+    made = mips_instructions_made;
+    pass->run_mips(code, ir);
+    made = mips_instructions_made - made;
+    stats->removed += before + made - pass_count_mips(code);
+  }
+  stats->added += made;
+  stats->time += clock() - start;
+  stats->runs++;
+  pass_current = NULL;
+  pass_invalidate(~pass->preserves);
+}
+
+/* pass_run_ir - runs the IR passes over the program
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void pass_run_ir(struct ir_section *section) {
+  int i;
+
+  if (NULL == section) {
+    return;
+  }
+  for (i = 0; NULL != pass_ir_pipeline[i].name; i++) {
+    pass_run(&pass_ir_pipeline[i], &pass_ir_stats[i], NULL, section);
+  }
+  pass_invalidate(PASS_CFG);
+}
+
+/* pass_run_mips - runs the passes over the program's MIPS code
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *   ir - ir_section - the IR it came from
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void pass_run_mips(struct mips_section *code, struct ir_section *ir) {
+  int i;
+
+  for (i = 0; NULL != pass_mips_pipeline[i].name; i++) {
+    pass_run(&pass_mips_pipeline[i], &pass_mips_stats[i], code, ir);
+  }
+  pass_invalidate(PASS_LIVENESS);
+}
+
+static void pass_print_pipeline(FILE *output, struct pass *pipeline, struct pass_stats *stats) {
+  int i;
+
+  for (i = 0; NULL != pipeline[i].name; i++) {
+    fprintf(output, "%-24s %4d %8ld %8ld %8d %8.2f\n", pipeline[i].name, stats[i].runs, stats[i].added,
+            stats[i].removed, stats[i].analyses_built, 1000.0 * stats[i].time / CLOCKS_PER_SEC);
+  }
+}
+
+/* pass_print_report - lists each pass in the order it ran, with how often it
+ *   ran, the instructions it added and removed, the analyses built for it
+ *   and its time in milliseconds
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void pass_print_report(FILE *output) {
+  fprintf(output, "%-24s %4s %8s %8s %8s %8s\n", "pass", "runs", "added", "removed", "analyses", "ms");
+  pass_print_pipeline(output, pass_ir_pipeline, pass_ir_stats);
+  pass_print_pipeline(output, pass_mips_pipeline, pass_mips_stats);
+}
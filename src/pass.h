@@ -0,0 +1,29 @@
+#ifndef _PASS_H
+#define _PASS_H
+
+#include <stdio.h>
+
+struct ir_section;
+struct mips_section;
+struct cfg;
+
+/* Analyses passes share, one bit each: the IR's control flow graphs, and
+ * which registers are live after each MIPS instruction */
+#define PASS_CFG      0x1
+#define PASS_LIVENESS 0x2
+
+int pass_set_level(char *level);
+int pass_set_flag(char *flag);
+
+void pass_run_ir(struct ir_section *section);
+void pass_run_mips(struct mips_section *code, struct ir_section *ir);
+
+struct cfg *pass_cfg(struct ir_section *section);
+void pass_liveness(struct mips_section *code);
+void pass_invalidate(int analyses);
+
+void pass_print_report(FILE *output);
+
+extern int pass_report;
+
+#endif
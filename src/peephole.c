@@ -0,0 +1,506 @@
+/*
+ * peephole.c
+ *
+ * Machine-level peephole optimizer.  It runs over the generated list of mips
+ * instructions before they are printed, and cleans up what translating one IR
+ * instruction at a time leaves behind: moves into registers that are read once,
+ * li followed by an operation that has an immediate form, branches to the very
+ * next label, and so on.
+ *
+ * Each rewrite is an entry in peephole_patterns: the opcodes of the window of
+ * instructions it looks at, plus a function that checks the remaining
+ * conditions and, if they hold, rewrites the window.  Patterns are tried at
+ * every instruction until none of them applies anywhere.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "mips.h"
+#include "peephole.h"
+#include "pass.h"
+
+int peephole_enabled = 1;
+int peephole_report = 0;
+
+#define PEEPHOLE_WINDOW 2
+
+/* Matches any operation in a window */
+#define PEEPHOLE_ANY   "*"
+/* Matches a label definition in a window */
+#define PEEPHOLE_LABEL ":"
+
+struct peephole_pattern {
+  char *name;
+  /* Space-separated opcodes allowed at each window position; NULL ends the window */
+  char *window[PEEPHOLE_WINDOW];
+  int (*apply)(struct mips_section *code, struct mips_instruction *first);
+  int hits;
+};
+
+/*********************
+ * HELPERS           *
+ *********************/
+
+/* peephole_matches - checks an instruction against one window position
+ *
+ * Parameters:
+ *   allowed - char * - space-separated opcodes, PEEPHOLE_ANY or PEEPHOLE_LABEL
+ *   instruction - mips_instruction - the instruction
+ */
+static int peephole_matches(char *allowed, struct mips_instruction *instruction) {
+  size_t length;
+  char *iter;
+
+  if (!strcmp(allowed, PEEPHOLE_LABEL)) {
+    return instruction->kind == MIPS_INSTRUCTION_LABEL;
+  }
+  if (instruction->kind != MIPS_INSTRUCTION_OPERATION) {
+    return 0;
+  }
+  if (!strcmp(allowed, PEEPHOLE_ANY)) {
+    return 1;
+  }
+
+  length = strlen(instruction->opcode);
+  for (iter = allowed; *iter != '\0'; ) {
+    size_t token = strcspn(iter, " ");
+    if (token == length && !strncmp(iter, instruction->opcode, length)) {
+      return 1;
+    }
+    iter += token;
+    while (*iter == ' ') {
+      iter++;
+    }
+  }
+  return 0;
+}
+
+/* peephole_is_register - whether an operand is a particular register */
+static int peephole_is_register(struct mips_operand *operand, int reg) {
+  return operand->kind == MIPS_OPERAND_REGISTER && operand->reg == reg;
+}
+
+/* peephole_copy_source - recognizes a register to register move
+ *
+ * Parameters:
+ *   instruction - mips_instruction - the instruction to check
+ *
+ * Returns the register copied from, or -1 if this is not a move
+ */
+static int peephole_copy_source(struct mips_instruction *instruction) {
+  if (instruction->kind != MIPS_INSTRUCTION_OPERATION) {
+    return -1;
+  }
+  if (!strcmp(instruction->opcode, "move")) {
+    return instruction->operands[1].reg;
+  }
+  if (strcmp(instruction->opcode, "or") && strcmp(instruction->opcode, "addu")) {
+    return -1;
+  }
+  if (instruction->operands[1].kind != MIPS_OPERAND_REGISTER || instruction->operands[2].kind != MIPS_OPERAND_REGISTER) {
+    return -1;
+  }
+  if (instruction->operands[2].reg == MIPS_REGISTER_ZERO) {
+    return instruction->operands[1].reg;
+  }
+  if (instruction->operands[1].reg == MIPS_REGISTER_ZERO) {
+    return instruction->operands[2].reg;
+  }
+  return -1;
+}
+
+/* peephole_is_allocatable - whether a register only ever holds values the
+ *   compiler can track within a block ($v0-$t9, not $sp, $fp, $ra and friends)
+ */
+static int peephole_is_allocatable(int reg) {
+  return reg >= MIPS_REGISTER_V0 && reg <= 25;
+}
+
+static struct mips_section *peephole_code;
+
+/* peephole_dead_after - whether a register's value is never read again
+ *   Looks through the rest of the basic block first, and only falls back on
+ *   the (recomputed if stale) liveness of the whole program at the block's end.
+ *
+ * Parameters:
+ *   instruction - mips_instruction - the instruction after which to look
+ *   reg - int - the register
+ */
+static int peephole_dead_after(struct mips_instruction *instruction, int reg) {
+  struct mips_instruction *iter, *last = instruction;
+  for (iter = instruction->next; NULL != iter; iter = iter->next) {
+    if (mips_reads_register(iter, reg)) {
+      return 0;
+    }
+    if (mips_writes_register(iter, reg)) {
+      return 1;
+    }
+    if (mips_ends_block(iter)) {
+      /* Control reaches a label by falling through; a branch keeps what it doesn't read. */
+      if (iter->kind == MIPS_INSTRUCTION_OPERATION) {
+        last = iter;
+      }
+      break;
+    }
+    last = iter;
+  }
+  pass_liveness(peephole_code);
+  return (last->live_out & (1u << reg)) == 0;
+}
+
+/* peephole_next_use - finds the next instruction in the block that reads or writes a register
+ *
+ * Parameters:
+ *   instruction - mips_instruction - the instruction after which to look
+ *   reg - int - the register
+ *
+ * Returns the instruction, or NULL if the block ends first
+ */
+static struct mips_instruction *peephole_next_use(struct mips_instruction *instruction, int reg) {
+  struct mips_instruction *iter;
+  for (iter = instruction->next; NULL != iter; iter = iter->next) {
+    if (mips_reads_register(iter, reg) || mips_writes_register(iter, reg)) {
+      return iter;
+    }
+    if (mips_ends_block(iter)) {
+      return NULL;
+    }
+  }
+  return NULL;
+}
+
+/* peephole_written_between - whether any instruction strictly between two others writes a register */
+static int peephole_written_between(struct mips_instruction *from, struct mips_instruction *to, int reg) {
+  struct mips_instruction *iter;
+  for (iter = from->next; iter != to; iter = iter->next) {
+    if (mips_writes_register(iter, reg)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* peephole_substitute_reads - replaces the register operands an instruction reads
+ *
+ * Parameters:
+ *   instruction - mips_instruction - the instruction to rewrite
+ *   from - int - the register to replace
+ *   to - int - the register to use instead
+ *
+ * Returns "true" if anything was replaced
+ */
+static int peephole_substitute_reads(struct mips_instruction *instruction, int from, int to) {
+  int i, first = (mips_defined_register(instruction) >= 0) ? 1 : 0;
+  int replaced = 0;
+
+  /* Conditional moves also read their destination; leave them alone. */
+  if (!strcmp(instruction->opcode, "movn") || !strcmp(instruction->opcode, "movz")) {
+    return 0;
+  }
+  for (i = first; i < instruction->num_operands; i++) {
+    struct mips_operand *operand = &instruction->operands[i];
+    if ((operand->kind == MIPS_OPERAND_REGISTER || operand->kind == MIPS_OPERAND_ADDRESS) && operand->reg == from) {
+      operand->reg = to;
+      replaced = 1;
+    }
+  }
+  return replaced;
+}
+
+/*********************
+ * PATTERNS          *
+ *********************/
+
+/* b L / L:  ->  L: */
+static int peephole_jump_to_next(struct mips_section *code, struct mips_instruction *first) {
+  struct mips_operand *target = &first->operands[first->num_operands - 1];
+  struct mips_instruction *iter;
+
+  if (target->kind != MIPS_OPERAND_LABEL) {
+    return 0;
+  }
+  for (iter = first->next; NULL != iter && iter->kind == MIPS_INSTRUCTION_LABEL; iter = iter->next) {
+    if (!strcmp(iter->operands[0].label, target->label)) {
+      mips_remove(code, first);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* or $x, $x, $0  ->  (nothing) */
+static int peephole_self_move(struct mips_section *code, struct mips_instruction *first) {
+  if (peephole_copy_source(first) < 0 || first->operands[0].reg != peephole_copy_source(first)) {
+    return 0;
+  }
+  mips_remove(code, first);
+  return 1;
+}
+
+/* sw $x, n($b) / lw $y, n($b)  ->  sw $x, n($b) / or $y, $x, $0 */
+static int peephole_store_then_load(struct mips_section *code, struct mips_instruction *first) {
+  struct mips_instruction *load = first->next;
+  struct mips_operand *stored = &first->operands[1], *loaded = &load->operands[1];
+
+  if (stored->kind != MIPS_OPERAND_ADDRESS || loaded->kind != MIPS_OPERAND_ADDRESS ||
+      stored->reg != loaded->reg || stored->number != loaded->number) {
+    return 0;
+  }
+  if (load->operands[0].reg == first->operands[0].reg) {
+    mips_remove(code, load);
+  } else {
+    load->opcode = "or";
+    load->num_operands = 3;
+    load->operands[1] = first->operands[0];
+    load->operands[2] = mips_register(MIPS_REGISTER_ZERO);
+  }
+  return 1;
+}
+
+/* li $t, 0 / ... / op ..., $t, ...  ->  li $t, 0 / ... / op ..., $0, ... */
+static int peephole_zero_register(struct mips_section *code, struct mips_instruction *first) {
+  struct mips_instruction *use = peephole_next_use(first, first->operands[0].reg);
+  (void)code;
+  if (first->operands[1].number != 0 || NULL == use || !mips_reads_register(use, first->operands[0].reg)) {
+    return 0;
+  }
+  return peephole_substitute_reads(use, first->operands[0].reg, MIPS_REGISTER_ZERO);
+}
+
+/* Register forms with an immediate form, and the range the immediate must fit */
+static struct {
+  char *opcode;
+  char *immediate;
+  int commutative;
+  int negate;
+  long low, high;
+} peephole_immediate_forms[] = {
+  { "add",  "addi",  1, 0, -32768, 32767 },
+  { "addu", "addiu", 1, 0, -32768, 32767 },
+  { "sub",  "addi",  0, 1, -32768, 32767 },
+  { "subu", "addiu", 0, 1, -32768, 32767 },
+  { "and",  "andi",  1, 0, 0, 65535 },
+  { "or",   "ori",   1, 0, 0, 65535 },
+  { "xor",  "xori",  1, 0, 0, 65535 },
+  { "slt",  "slti",  0, 0, -32768, 32767 },
+  { "sltu", "sltiu", 0, 0, -32768, 32767 },
+  { "sllv", "sll",   0, 0, 0, 31 },
+  { "srlv", "srl",   0, 0, 0, 31 },
+  { "srav", "sra",   0, 0, 0, 31 },
+  { NULL, NULL, 0, 0, 0, 0 }
+};
+
+/* li $t, k / ... / addu $d, $s, $t  ->  ... / addiu $d, $s, k */
+static int peephole_immediate_operand(struct mips_section *code, struct mips_instruction *first) {
+  int temporary = first->operands[0].reg;
+  struct mips_instruction *operation = peephole_next_use(first, temporary);
+  long value = first->operands[1].number;
+  int i, position;
+
+  if (NULL == operation || operation->num_operands != 3 || operation->operands[1].kind != MIPS_OPERAND_REGISTER ||
+      operation->operands[2].kind != MIPS_OPERAND_REGISTER) {
+    return 0;
+  }
+  for (i = 0; NULL != peephole_immediate_forms[i].opcode; i++) {
+    if (!strcmp(peephole_immediate_forms[i].opcode, operation->opcode)) {
+      break;
+    }
+  }
+  if (NULL == peephole_immediate_forms[i].opcode) {
+    return 0;
+  }
+
+  /* The constant has to be the only use of $t, and end up as the last operand. */
+  if (peephole_is_register(&operation->operands[2], temporary) &&
+      !peephole_is_register(&operation->operands[1], temporary)) {
+    position = 2;
+  } else if (peephole_immediate_forms[i].commutative && peephole_is_register(&operation->operands[1], temporary) &&
+             !peephole_is_register(&operation->operands[2], temporary)) {
+    position = 1;
+  } else {
+    return 0;
+  }
+  if (peephole_immediate_forms[i].negate) {
+    value = -value;
+  }
+  if (value < peephole_immediate_forms[i].low || value > peephole_immediate_forms[i].high) {
+    return 0;
+  }
+  if (operation->operands[0].reg != temporary && !peephole_dead_after(operation, temporary)) {
+    return 0;
+  }
+
+  if (position == 1) {
+    operation->operands[1] = operation->operands[2];
+  }
+  operation->opcode = peephole_immediate_forms[i].immediate;
+  operation->operands[2] = mips_number(value);
+  mips_remove(code, first);
+  return 1;
+}
+
+/* or $x, $y, $0 / ... / op ..., $x, ...  ->  or $x, $y, $0 / ... / op ..., $y, ... */
+static int peephole_copy_forward(struct mips_section *code, struct mips_instruction *first) {
+  int destination = first->operands[0].reg;
+  int source = peephole_copy_source(first);
+  struct mips_instruction *use;
+  (void)code;
+
+  if (source < 0 || source == destination || destination == MIPS_REGISTER_ZERO) {
+    return 0;
+  }
+  use = peephole_next_use(first, destination);
+  if (NULL == use || peephole_written_between(first, use, source)) {
+    return 0;
+  }
+  return peephole_substitute_reads(use, destination, source);
+}
+
+/* la $t, n($b) / ... / lw $x, k($t)  ->  ... / lw $x, n+k($b) */
+static int peephole_fold_address(struct mips_section *code, struct mips_instruction *first) {
+  int temporary = first->operands[0].reg;
+  struct mips_instruction *use = peephole_next_use(first, temporary);
+  struct mips_operand *address = &first->operands[1];
+  long offset;
+
+  if (address->kind != MIPS_OPERAND_ADDRESS || NULL == use || !peephole_is_allocatable(temporary)) {
+    return 0;
+  }
+  if (!peephole_matches("lw lh lhu lb lbu sw sh sb", use) || use->operands[1].kind != MIPS_OPERAND_ADDRESS ||
+      use->operands[1].reg != temporary || peephole_is_register(&use->operands[0], temporary) ||
+      peephole_written_between(first, use, address->reg)) {
+    return 0;
+  }
+  offset = address->number + use->operands[1].number;
+  if (offset < -32768 || offset > 32767) {
+    return 0;
+  }
+  if (!peephole_dead_after(use, temporary)) {
+    return 0;
+  }
+  use->operands[1] = mips_address(offset, address->reg);
+  mips_remove(code, first);
+  return 1;
+}
+
+/* op $x, ... / or $y, $x, $0  ->  op $y, ...   when $x is not needed afterward */
+static int peephole_copy_coalesce(struct mips_section *code, struct mips_instruction *first) {
+  struct mips_instruction *copy = first->next;
+  int value = mips_defined_register(first);
+  int source = peephole_copy_source(copy);
+  int destination = copy->operands[0].reg;
+
+  if (value < 0 || source != value || destination == value || !peephole_is_allocatable(value) ||
+      !strcmp(first->opcode, "movn") || !strcmp(first->opcode, "movz")) {
+    return 0;
+  }
+  if (!peephole_dead_after(copy, value)) {
+    return 0;
+  }
+  first->operands[0].reg = destination;
+  mips_remove(code, copy);
+  return 1;
+}
+
+/* op $x, ...  ->  (nothing)   when $x is overwritten before it is read */
+static int peephole_dead_definition(struct mips_section *code, struct mips_instruction *first) {
+  int value = mips_defined_register(first);
+
+  if (value < 0 || !peephole_is_allocatable(value) ||
+      !strcmp(first->opcode, "movn") || !strcmp(first->opcode, "movz")) {
+    return 0;
+  }
+  if (!peephole_dead_after(first, value)) {
+    return 0;
+  }
+  mips_remove(code, first);
+  return 1;
+}
+
+static struct peephole_pattern peephole_patterns[] = {
+  { "jump-to-next-label", { "b j beq bne beqz bnez blez bgtz bltz bgez", PEEPHOLE_LABEL }, peephole_jump_to_next, 0 },
+  { "self-move",          { "or addu move", NULL },                                      peephole_self_move, 0 },
+  { "store-then-load",    { "sw", "lw" },                                                 peephole_store_then_load, 0 },
+  { "immediate-operand",  { "li", NULL },                                                 peephole_immediate_operand, 0 },
+  { "zero-register",      { "li", NULL },                                                 peephole_zero_register, 0 },
+  { "copy-forward",       { "or addu move", NULL },                                       peephole_copy_forward, 0 },
+  { "fold-address",       { "la", NULL },                                                 peephole_fold_address, 0 },
+  { "copy-coalesce",      { PEEPHOLE_ANY, "or addu move" },                               peephole_copy_coalesce, 0 },
+  { "dead-definition",    { PEEPHOLE_ANY, NULL },                                         peephole_dead_definition, 0 },
+  { NULL, { NULL, NULL }, NULL, 0 }
+};
+
+/*********************
+ * DRIVER            *
+ *********************/
+
+/* peephole_window_matches - checks every position of a pattern's window
+ *
+ * Parameters:
+ *   pattern - peephole_pattern - the pattern
+ *   first - mips_instruction - first instruction of the window
+ */
+static int peephole_window_matches(struct peephole_pattern *pattern, struct mips_instruction *first) {
+  struct mips_instruction *iter = first;
+  int i;
+
+  for (i = 0; i < PEEPHOLE_WINDOW && NULL != pattern->window[i]; i++) {
+    if (NULL == iter || !peephole_matches(pattern->window[i], iter)) {
+      return 0;
+    }
+    iter = iter->next;
+  }
+  return 1;
+}
+
+/* peephole_optimize - applies the patterns until none of them matches
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ */
+void peephole_optimize(struct mips_section *code) {
+  struct mips_instruction *iter, *next;
+  int changed = 1;
+  int i;
+
+  if (!peephole_enabled) {
+    return;
+  }
+  peephole_code = code;
+  while (changed) {
+    changed = 0;
+    for (iter = code->first; NULL != iter; iter = next) {
+      /* Patterns may remove iter itself, so look at its neighbours first. */
+      next = iter->next;
+      for (i = 0; NULL != peephole_patterns[i].name; i++) {
+        struct mips_instruction *before = iter->prev;
+        if (!peephole_window_matches(&peephole_patterns[i], iter) ||
+            !peephole_patterns[i].apply(code, iter)) {
+          continue;
+        }
+        peephole_patterns[i].hits++;
+        // The live_out masks no longer describe the code
+        pass_invalidate(PASS_LIVENESS);
+        changed = 1;
+        /* Start again just ahead of the rewritten window, which may now match something new. */
+        next = (NULL == before) ? code->first : before;
+        break;
+      }
+    }
+  }
+}
+
+/* peephole_print_report - lists how often each pattern was applied
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+void peephole_print_report(FILE *output) {
+  int i;
+  for (i = 0; NULL != peephole_patterns[i].name; i++) {
+    fprintf(output, "%-22s %6d\n", peephole_patterns[i].name, peephole_patterns[i].hits);
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef _PEEPHOLE_H
+#define _PEEPHOLE_H
+
+#include <stdio.h>
+
+struct mips_section;
+
+void peephole_optimize(struct mips_section *code);
+void peephole_print_report(FILE *output);
+
+extern int peephole_enabled;
+extern int peephole_report;
+
+#endif
@@ -0,0 +1,577 @@
+/*
+ * profile.c
+ *
+ * Profile-guided optimization.  With -fprofile-generate every basic block of
+ * the program gets a word in _Profile_counts that it increments each time it
+ * runs, and main calls _Profile_dump on its way out to print the table:
+ *
+ *   #profile
+ *   main 0 7 1
+ *   main 1 7 10
+ *
+ * Each line gives the function, the number of the block within it, how many
+ * blocks the function has, and how often the block ran.  What the training
+ * run prints from #profile on is the profile; anything before it is skipped
+ * when the profile is read.
+ *
+ * With -fprofile-use=FILE the counts are read back, and every instruction of
+ * a block carries the block's count for the passes that follow.  The inliner
+ * leaves calls that never ran alone and lets hot ones grow the caller more,
+ * and loop rotation skips loops that never went round.
+ *
+ * Blocks are numbered as soon as the IR is generated, before any other pass
+ * has changed it, so both compiles number them the same way as long as the
+ * source is the same.  A function whose number of blocks has changed since
+ * the training run is left without counts.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "ir.h"
+#include "cfg.h"
+#include "literal.h"
+#include "profile.h"
+#include "pass.h"
+
+#define PROFILE_COUNTS "_Profile_counts"
+#define PROFILE_DUMP   "_Profile_dump"
+#define PROFILE_HEADER "#profile"
+
+/* _Profile_dump has no locals, only the register save area */
+#define PROFILE_DUMP_FRAME_SIZE 88
+
+int profile_generate = 0;
+char *profile_use = NULL;
+
+struct profile_entry {
+  char *function;
+  int block;
+  int num_blocks;
+  /* How often the block ran, or while instrumenting, the index of its counter */
+  long count;
+  struct profile_entry *next;
+};
+
+static long profile_max_count;
+
+/*********************
+ * BUILDING IR       *
+ *********************/
+
+/* profile_emit - makes an instruction and puts it before another
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   position - ir_instruction - the instruction to insert before
+ *   kind - int - the new instruction's kind
+ *
+ * Returns the new instruction, for its operands to be filled in
+ */
+static struct ir_instruction *profile_emit(struct ir_section *section, struct ir_instruction *position, int kind) {
+  struct ir_instruction *instruction = ir_instruction(kind);
+  ir_insert_before(section, position, instruction);
+  return instruction;
+}
+
+static void profile_temporary(struct ir_instruction *instruction, int position, int temporary) {
+  instruction->operands[position].kind = OPERAND_TEMPORARY;
+  instruction->operands[position].data.temporary = temporary;
+}
+
+static void profile_label(struct ir_instruction *instruction, int position, char *label_name) {
+  instruction->operands[position].kind = OPERAND_LABEL;
+  instruction->operands[position].data.label_name = label_name;
+}
+
+static void profile_number(struct ir_instruction *instruction, int position, long number) {
+  instruction->operands[position].kind = OPERAND_NUMBER;
+  instruction->operands[position].data.number = number;
+}
+
+/* profile_counter_address - computes the address of one block's counter
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   position - ir_instruction - the instruction to insert before
+ *   counter - int - index of the counter
+ *   temporary - int - first of the two temporaries to use
+ *
+ * Returns the temporary holding the address
+ */
+static int profile_counter_address(struct ir_section *section, struct ir_instruction *position, int counter,
+                                   int temporary) {
+  struct ir_instruction *instruction;
+
+  instruction = profile_emit(section, position, IR_ADDRESS_OF);
+  profile_temporary(instruction, 0, temporary);
+  profile_label(instruction, 1, PROFILE_COUNTS);
+
+  instruction = profile_emit(section, position, IR_ADDI);
+  profile_temporary(instruction, 0, temporary + 1);
+  profile_temporary(instruction, 1, temporary);
+  profile_number(instruction, 2, 4 * counter);
+  return temporary + 1;
+}
+
+/* profile_print_string - prints a constant string
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   position - ir_instruction - the instruction to insert before
+ *   text - char * - what to print
+ *   temporary - int - temporary to hold the string's address
+ */
+static void profile_print_string(struct ir_section *section, struct ir_instruction *position, char *text,
+                                 int temporary) {
+  struct ir_instruction *instruction;
+
+  instruction = profile_emit(section, position, IR_ADDRESS_OF);
+  profile_temporary(instruction, 0, temporary);
+  profile_label(instruction, 1, literal_label(text, strlen(text)));
+
+  instruction = profile_emit(section, position, IR_PRINT_STRING);
+  profile_temporary(instruction, 0, temporary);
+}
+
+/*********************
+ * INSTRUMENTING     *
+ *********************/
+
+/* profile_uses_temporary - checks whether an instruction mentions a temporary
+ *
+ * Parameters:
+ *   instruction - ir_instruction - instruction to check
+ *   temporary - int - temporary number
+ */
+static int profile_uses_temporary(struct ir_instruction *instruction, int temporary) {
+  int i;
+  if (instruction->kind == IR_SEQUENCE_PT) {
+    return 0;
+  }
+  for (i = 0; i < 3; i++) {
+    if (instruction->operands[i].kind == OPERAND_TEMPORARY &&
+        instruction->operands[i].data.temporary == temporary) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* profile_live_at - checks whether a temporary of the current statement is
+ *   computed before a point and needed after it.  A counter put there would
+ *   take the register holding it.
+ *
+ * Parameters:
+ *   position - ir_instruction - where code would be inserted before
+ */
+static int profile_live_at(struct ir_instruction *position) {
+  struct ir_instruction *before, *later;
+  int i;
+
+  for (before = position->prev; NULL != before && before->kind != IR_SEQUENCE_PT && before->kind != IR_PROC_BEGIN;
+       before = before->prev) {
+    for (i = 0; i < 3; i++) {
+      if (before->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      for (later = position; NULL != later && later->kind != IR_SEQUENCE_PT && later->kind != IR_PROC_END;
+           later = later->next) {
+        if (profile_uses_temporary(later, before->operands[i].data.temporary)) {
+          return 1;
+        }
+      }
+    }
+  }
+  // Values from before a sequence point that keeps them are still in use
+  return NULL != before && before->kind == IR_SEQUENCE_PT && before->operands[1].kind == OPERAND_NUMBER;
+}
+
+/* profile_counter_position - picks where a block's counter goes
+ *
+ * Parameters:
+ *   block - cfg_block - the block
+ *
+ * Returns the instruction to insert the counter before, or NULL if the block
+ *   has no point where the registers are free
+ */
+static struct ir_instruction *profile_counter_position(struct cfg_block *block) {
+  struct ir_instruction *position = block->first, *iter;
+
+  if (position->kind == IR_LABEL || position->kind == IR_PROC_BEGIN) {
+    position = position->next;
+  }
+  if (!profile_live_at(position)) {
+    return position;
+  }
+  // In the middle of an expression; try the start of the next statement
+  for (iter = position; iter != block->last; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT && !profile_live_at(iter->next)) {
+      return iter->next;
+    }
+  }
+  return NULL;
+}
+
+/* profile_restore - makes the sequence point that gives the code after an
+ *   insertion back the register numbering it had before
+ *
+ * Parameters:
+ *   position - ir_instruction - where code is being inserted before
+ */
+static struct ir_instruction *profile_restore(struct ir_instruction *position) {
+  struct ir_instruction *restore = ir_instruction(IR_SEQUENCE_PT), *iter;
+
+  profile_temporary(restore, 0, -1);
+  // Numbering carries on across functions, so the search does too
+  for (iter = position->prev; NULL != iter; iter = iter->prev) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      restore->operands[0] = iter->operands[0];
+      break;
+    }
+  }
+  return restore;
+}
+
+/* profile_count_block - increments a block's counter
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   position - ir_instruction - the instruction to insert before
+ *   counter - int - index of the counter
+ */
+static void profile_count_block(struct ir_section *section, struct ir_instruction *position, int counter) {
+  struct ir_instruction *restore = profile_restore(position), *instruction;
+  int base = ir_reserve_temporaries(5), address;
+
+  instruction = profile_emit(section, position, IR_SEQUENCE_PT);
+  profile_temporary(instruction, 0, base);
+
+  address = profile_counter_address(section, position, counter, base + 1);
+  instruction = profile_emit(section, position, IR_LOAD_WORD);
+  profile_temporary(instruction, 0, base + 3);
+  profile_temporary(instruction, 1, address);
+  instruction = profile_emit(section, position, IR_ADDI);
+  profile_temporary(instruction, 0, base + 4);
+  profile_temporary(instruction, 1, base + 3);
+  profile_number(instruction, 2, 1);
+  instruction = profile_emit(section, position, IR_STORE_WORD);
+  profile_temporary(instruction, 0, base + 4);
+  profile_temporary(instruction, 1, address);
+
+  ir_insert_before(section, position, restore);
+}
+
+/* profile_add_dump - adds _Profile_dump, which prints every counter
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   entries - profile_entry - the counted blocks
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void profile_add_dump(struct ir_section *section, struct profile_entry *entries) {
+  struct ir_instruction *end = ir_instruction(IR_PROC_END), *instruction, *last;
+  struct profile_entry *entry;
+  char text[300];
+  int base;
+
+  for (last = section->last; NULL != last->next; last = last->next)
+    ;
+  ir_insert_after(section, last, end);
+  profile_label(end, 0, PROFILE_DUMP);
+  profile_number(end, 1, PROFILE_DUMP_FRAME_SIZE);
+
+  instruction = profile_emit(section, end, IR_PROC_BEGIN);
+  profile_label(instruction, 0, PROFILE_DUMP);
+  profile_number(instruction, 1, PROFILE_DUMP_FRAME_SIZE);
+  profile_number(instruction, 2, 0);
+
+  base = ir_reserve_temporaries(2);
+  instruction = profile_emit(section, end, IR_SEQUENCE_PT);
+  profile_temporary(instruction, 0, base);
+  profile_print_string(section, end, PROFILE_HEADER "\n", base + 1);
+
+  // One statement per line, so each starts over with the first register
+  for (entry = entries; NULL != entry; entry = entry->next) {
+    base = ir_reserve_temporaries(6);
+    instruction = profile_emit(section, end, IR_SEQUENCE_PT);
+    profile_temporary(instruction, 0, base);
+
+    sprintf(text, "%.255s %d %d ", entry->function, entry->block, entry->num_blocks);
+    profile_print_string(section, end, text, base + 1);
+    instruction = profile_emit(section, end, IR_LOAD_WORD);
+    profile_temporary(instruction, 0, base + 4);
+    profile_temporary(instruction, 1, profile_counter_address(section, end, (int)entry->count, base + 2));
+    instruction = profile_emit(section, end, IR_PRINT_NUMBER);
+    profile_temporary(instruction, 0, base + 4);
+    profile_print_string(section, end, "\n", base + 5);
+  }
+  profile_emit(section, end, IR_RETURN_VOID);
+}
+
+/* profile_call_dump - calls _Profile_dump wherever main returns.  The call
+ *   keeps the registers of the statement around it, so it can go right
+ *   before the return, after the returned value has been worked out.
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   graph - cfg - main's graph
+ */
+static void profile_call_dump(struct ir_section *section, struct cfg *graph) {
+  struct ir_instruction *iter, *previous, *call;
+
+  for (iter = graph->begin; NULL != iter && iter != graph->end->next; iter = iter->next) {
+    if (iter->kind == IR_PROC_END) {
+      // Falling off the end of main; after a return, the call is already there
+      for (previous = iter->prev; previous->kind == IR_SEQUENCE_PT || previous->kind == IR_NO_OPERATION;
+           previous = previous->prev)
+        ;
+      if (previous->kind == IR_RETURN || previous->kind == IR_RETURN_VOID || previous->kind == IR_GOTO) {
+        continue;
+      }
+    } else if (iter->kind != IR_RETURN && iter->kind != IR_RETURN_VOID) {
+      continue;
+    }
+    call = profile_emit(section, iter, IR_FUNCTION_CALL);
+    profile_label(call, 0, PROFILE_DUMP);
+    profile_number(call, 1, 0);
+  }
+}
+
+/* profile_instrument - counts every block of the program, and prints the
+ *   counts when main returns
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void profile_instrument(struct ir_section *section) {
+  struct cfg *graphs, *graph, *main_graph = NULL;
+  struct cfg_block *block;
+  struct ir_instruction *position;
+  struct profile_entry *entries = NULL, *last = NULL, *entry;
+  int counters = 0, index;
+
+  graphs = pass_cfg(section);
+  for (graph = graphs; NULL != graph; graph = graph->next) {
+    if (!strcmp(graph->name, "main")) {
+      main_graph = graph;
+    }
+    for (block = graph->entry, index = 0; NULL != block; block = block->next, index++) {
+      position = profile_counter_position(block);
+      if (NULL == position) {
+        continue;
+      }
+      profile_count_block(section, position, counters);
+
+      entry = malloc(sizeof(struct profile_entry));
+      assert(NULL != entry);
+      entry->function = graph->name;
+      entry->block = index;
+      entry->num_blocks = graph->num_blocks;
+      entry->count = counters++;
+      entry->next = NULL;
+      if (NULL == last) {
+        entries = entry;
+      } else {
+        last->next = entry;
+      }
+      last = entry;
+    }
+  }
+
+  if (NULL != main_graph && counters > 0) {
+    profile_call_dump(section, main_graph);
+    profile_add_dump(section, entries);
+    ir_add_global(PROFILE_COUNTS, 4 * counters, 4);
+  }
+
+  while (NULL != entries) {
+    entry = entries->next;
+    free(entries);
+    entries = entry;
+  }
+}
+
+/*********************
+ * READING PROFILES  *
+ *********************/
+
+/* profile_read - reads the counts a training run printed
+ *
+ * Parameters:
+ *   file_name - char * - the profile
+ *
+ * Returns the counts, or NULL after reporting an error
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static struct profile_entry *profile_read(char *file_name) {
+  struct profile_entry *entries = NULL, *entry;
+  char line[512], function[256];
+  int block, num_blocks, started = 0;
+  long count;
+  FILE *input = fopen(file_name, "r");
+
+  if (NULL == input) {
+    ir_generation_num_errors++;
+    printf("ERROR - Could not open profile %s.\n", file_name);
+    return NULL;
+  }
+  while (NULL != fgets(line, sizeof(line), input)) {
+    if (!started) {
+      // The program's own output need not have ended with a newline
+      started = NULL != strstr(line, PROFILE_HEADER);
+      continue;
+    }
+    if (4 != sscanf(line, "%255s %d %d %ld", function, &block, &num_blocks, &count)) {
+      continue;
+    }
+    entry = malloc(sizeof(struct profile_entry));
+    assert(NULL != entry);
+    entry->function = malloc(strlen(function) + 1);
+    assert(NULL != entry->function);
+    strcpy(entry->function, function);
+    entry->block = block;
+    entry->num_blocks = num_blocks;
+    entry->count = count;
+    entry->next = entries;
+    entries = entry;
+  }
+  fclose(input);
+
+  if (!started) {
+    ir_generation_num_errors++;
+    printf("ERROR - %s is not a profile.\n", file_name);
+  }
+  return entries;
+}
+
+/* profile_annotate - gives every instruction of a function the count of the
+ *   block it is in
+ *
+ * Parameters:
+ *   graph - cfg - the function
+ *   entries - profile_entry - every count in the profile
+ */
+static void profile_annotate(struct cfg *graph, struct profile_entry *entries) {
+  struct profile_entry *entry;
+  struct cfg_block *block;
+  struct ir_instruction *iter;
+  int index;
+
+  for (entry = entries; NULL != entry; entry = entry->next) {
+    if (!strcmp(entry->function, graph->name) &&
+        (entry->num_blocks != graph->num_blocks || entry->block < 0 || entry->block >= graph->num_blocks)) {
+      printf("Profile of %s does not match its code, ignoring it.\n", graph->name);
+      return;
+    }
+  }
+
+  for (entry = entries; NULL != entry; entry = entry->next) {
+    if (strcmp(entry->function, graph->name)) {
+      continue;
+    }
+    for (block = graph->entry, index = 0; index < entry->block; block = block->next, index++)
+      ;
+    for (iter = block->first; iter != block->last->next; iter = iter->next) {
+      iter->profile_count = entry->count;
+    }
+    if (entry->count > profile_max_count) {
+      profile_max_count = entry->count;
+    }
+  }
+}
+
+/*********************
+ * INTERFACE         *
+ *********************/
+
+/* profile_program - instruments the program, or tags it with the counts
+ *   of a training run, as the options ask
+ *
+ * Parameters:
+ *   section - ir_section - the whole program, fresh from IR generation
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void profile_program(struct ir_section *section) {
+  struct profile_entry *entries, *entry;
+  struct cfg *graphs, *graph;
+
+  if (NULL == section || NULL == section->first) {
+    return;
+  }
+  if (profile_generate) {
+    profile_instrument(section);
+  } else if (NULL != profile_use) {
+    entries = profile_read(profile_use);
+    graphs = pass_cfg(section);
+    for (graph = graphs; NULL != graph; graph = graph->next) {
+      profile_annotate(graph, entries);
+    }
+
+    while (NULL != entries) {
+      entry = entries->next;
+      free(entries->function);
+      free(entries);
+      entries = entry;
+    }
+  }
+}
+
+/* profile_scale - scales a count, as for the copy of a callee's body inlined
+ *   at one call site
+ *
+ * Parameters:
+ *   count - long - the count to scale, or -1
+ *   times - long - how often the copy runs, or -1
+ *   per - long - how often the original ran, or -1
+ *
+ * Returns count * times / per, or -1 if any of them is unknown
+ */
+long profile_scale(long count, long times, long per) {
+  if (count < 0 || times < 0 || per < 0) {
+    return -1;
+  }
+  if (0 == per) {
+    return 0;
+  }
+  return (long)((double)count * times / per);
+}
+
+/* profile_is_hot - whether a count is among the highest of the training run
+ *
+ * Parameters:
+ *   count - long - the count, or -1
+ */
+int profile_is_hot(long count) {
+  return count > 0 && count * PROFILE_HOT_FRACTION >= profile_max_count;
+}
+
+/* profile_block_count - how often a block ran in the training run
+ *
+ * Parameters:
+ *   block - cfg_block - the block
+ *
+ * Returns the count, or -1 if none of the block's instructions has one
+ */
+long profile_block_count(struct cfg_block *block) {
+  struct ir_instruction *iter;
+  long count = -1;
+
+  for (iter = block->first; iter != block->last->next; iter = iter->next) {
+    if (iter->profile_count > count) {
+      count = iter->profile_count;
+    }
+  }
+  return count;
+}
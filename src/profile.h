@@ -0,0 +1,19 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+struct ir_section;
+struct cfg_block;
+
+/* A block is hot if it ran at least 1/PROFILE_HOT_FRACTION as often as the
+ * hottest block of the training run */
+#define PROFILE_HOT_FRACTION 16
+
+void profile_program(struct ir_section *section);
+long profile_scale(long count, long times, long per);
+int profile_is_hot(long count);
+long profile_block_count(struct cfg_block *block);
+
+extern int profile_generate;
+extern char *profile_use;
+
+#endif
@@ -0,0 +1,601 @@
+/*
+ * schedule.c
+ *
+ * Instruction scheduling for the selected mips code.  Each basic block is
+ * reordered by a list scheduler that knows how long loads, multiplies and
+ * divides take to deliver their results, so independent work fills the
+ * cycles that would otherwise be spent waiting on them.
+ *
+ * Normally the assembler is left to deal with delay slots: it puts a nop
+ * after every branch and after a load whose result is used straight away.
+ * With schedule_delay_slots the output is written for .set noreorder
+ * instead: each branch delay slot gets an instruction from before the
+ * branch, or a copy of the first instruction at its target, and nops are
+ * added only where a load or hi/lo hazard is left.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "mips.h"
+#include "schedule.h"
+#include "pass.h"
+
+int schedule_enabled = 1;
+int schedule_delay_slots = 0;
+
+/* Cycles before an instruction's result can be used without a stall */
+struct schedule_latency {
+  char *opcode;
+  int cycles;
+};
+
+static struct schedule_latency schedule_latencies[] = {
+  {"lw", 2}, {"lh", 2}, {"lhu", 2}, {"lb", 2}, {"lbu", 2},
+  {"mult", 12}, {"multu", 12}, {"mul", 12},
+  {"div", 35}, {"divu", 35},
+  {NULL, 1}
+};
+
+/* After an mfhi or mflo, two instructions must pass before hi and lo are written again */
+#define SCHEDULE_HI_LO_DISTANCE 3
+
+/* Pseudo-instructions that the assembler expands using $at */
+static char *schedule_at_pseudos[] = { "sle", "sgt", "sge", "seq", "sne", NULL };
+
+/* Instructions that assemble to exactly one machine instruction and never
+ * stall, and so can sit in a branch delay slot */
+static char *schedule_slot_opcodes[] = {
+  "add", "addu", "addi", "addiu", "sub", "subu", "neg", "negu",
+  "and", "andi", "or", "ori", "xor", "xori", "nor", "not", "move", "lui",
+  "slt", "sltu", "slti", "sltiu", "sll", "srl", "sra", "sllv", "srlv", "srav",
+  "sw", "sh", "sb",
+  NULL
+};
+
+#define SCHEDULE_MEMORY_NONE  0
+#define SCHEDULE_MEMORY_LOAD  1
+#define SCHEDULE_MEMORY_STORE 2
+
+/* What an instruction reads and writes, as far as reordering is concerned */
+struct schedule_effects {
+  unsigned int uses, defs;
+  int reads_hi_lo, writes_hi_lo;
+  int memory;
+  int latency;
+};
+
+/*********************
+ * HELPERS           *
+ *********************/
+
+/* schedule_opcode_in - looks an opcode up in a NULL-terminated list */
+static int schedule_opcode_in(char *opcode, char **list) {
+  for (; NULL != *list; list++) {
+    if (!strcmp(opcode, *list)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* schedule_is - whether an instruction is an operation with a given opcode */
+static int schedule_is(struct mips_instruction *instruction, char *opcode) {
+  return instruction->kind == MIPS_INSTRUCTION_OPERATION && !strcmp(instruction->opcode, opcode);
+}
+
+/* schedule_has_delay_slot - whether the instruction after this one runs before it takes effect */
+static int schedule_has_delay_slot(struct mips_instruction *instruction) {
+  return instruction->kind == MIPS_INSTRUCTION_OPERATION &&
+      (mips_ends_block(instruction) || !strcmp(instruction->opcode, "jal"));
+}
+
+/* schedule_ends_block - whether an instruction is the last one a block can hold:
+ *   a branch, or a call, after which every register may have changed
+ */
+static int schedule_ends_block(struct mips_instruction *instruction) {
+  return schedule_has_delay_slot(instruction) || schedule_is(instruction, "syscall");
+}
+
+/* schedule_is_load - whether an instruction is a load from memory */
+static int schedule_is_load(struct mips_instruction *instruction) {
+  static char *loads[] = { "lw", "lh", "lhu", "lb", "lbu", NULL };
+  return instruction->kind == MIPS_INSTRUCTION_OPERATION && schedule_opcode_in(instruction->opcode, loads);
+}
+
+/* schedule_clobbers_at - whether the assembler will expand an instruction
+ *   into a sequence that goes through $at
+ */
+static int schedule_clobbers_at(struct mips_instruction *instruction) {
+  int i;
+
+  if (schedule_opcode_in(instruction->opcode, schedule_at_pseudos)) {
+    return 1;
+  }
+  if (!strcmp(instruction->opcode, "li") || !strcmp(instruction->opcode, "la")) {
+    return 0;
+  }
+  for (i = 0; i < instruction->num_operands; i++) {
+    struct mips_operand *operand = &instruction->operands[i];
+    // A load or store at a label, or an immediate that needs more than 16 bits
+    if ((operand->kind == MIPS_OPERAND_LABEL && !schedule_has_delay_slot(instruction)) ||
+        (operand->kind == MIPS_OPERAND_NUMBER && (operand->number < -32768 || operand->number > 65535))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* schedule_effects - works out what an instruction reads and writes
+ *
+ * Parameters:
+ *   instruction - mips_instruction - an operation
+ *
+ * Returns the registers, hi/lo and memory it touches, and its latency
+ */
+static struct schedule_effects schedule_effects(struct mips_instruction *instruction) {
+  static char *stores[] = { "sw", "sh", "sb", NULL };
+  static char *hi_lo_writers[] = { "mult", "multu", "div", "divu", "mul", NULL };
+  struct schedule_effects effects;
+  int i;
+
+  effects.uses = mips_register_uses(instruction);
+  effects.defs = mips_register_defs(instruction);
+  if (schedule_clobbers_at(instruction)) {
+    effects.defs |= 1u << MIPS_REGISTER_AT;
+  }
+  effects.reads_hi_lo = !strcmp(instruction->opcode, "mflo") || !strcmp(instruction->opcode, "mfhi");
+  effects.writes_hi_lo = schedule_opcode_in(instruction->opcode, hi_lo_writers);
+  effects.memory = SCHEDULE_MEMORY_NONE;
+  if (schedule_is_load(instruction)) {
+    effects.memory = SCHEDULE_MEMORY_LOAD;
+  } else if (schedule_opcode_in(instruction->opcode, stores)) {
+    effects.memory = SCHEDULE_MEMORY_STORE;
+  }
+
+  for (i = 0; NULL != schedule_latencies[i].opcode; i++) {
+    if (!strcmp(schedule_latencies[i].opcode, instruction->opcode)) {
+      break;
+    }
+  }
+  effects.latency = schedule_latencies[i].cycles;
+  return effects;
+}
+
+/* schedule_dependence - how far apart two instructions have to stay
+ *
+ * Parameters:
+ *   first - schedule_effects - the earlier instruction
+ *   second - schedule_effects - the later instruction
+ *
+ * Returns the number of cycles the second has to issue after the first, or -1
+ *   if they can go in either order
+ */
+static int schedule_dependence(struct schedule_effects *first, struct schedule_effects *second) {
+  int distance = -1;
+
+  if ((first->defs & second->uses) || (first->writes_hi_lo && second->reads_hi_lo)) {
+    distance = first->latency;
+  }
+  if (first->reads_hi_lo && second->writes_hi_lo && distance < SCHEDULE_HI_LO_DISTANCE) {
+    distance = SCHEDULE_HI_LO_DISTANCE;
+  }
+  if (((first->defs & second->defs) || (first->writes_hi_lo && second->writes_hi_lo)) && distance < 1) {
+    distance = 1;
+  }
+  if ((first->uses & second->defs) && distance < 0) {
+    distance = 0;
+  }
+  if (first->memory != SCHEDULE_MEMORY_NONE && second->memory != SCHEDULE_MEMORY_NONE &&
+      (first->memory == SCHEDULE_MEMORY_STORE || second->memory == SCHEDULE_MEMORY_STORE) && distance < 0) {
+    distance = 0;
+  }
+  return distance;
+}
+
+/* schedule_new_operation - makes an operation that is not yet in any section */
+static struct mips_instruction *schedule_new_operation(char *opcode) {
+  struct mips_section scratch = { NULL, NULL, 0 };
+  return mips_emit(&scratch, opcode, 0);
+}
+
+/*********************
+ * LIST SCHEDULING   *
+ *********************/
+
+/* schedule_better - whether one ready instruction should issue before another:
+ *   one that can issue now beats one that would stall, the shorter stall
+ *   beats the longer, and then the longer critical path goes first
+ */
+static int schedule_better(int i, int best, int *earliest, int *priority, int cycle) {
+  int stall = earliest[i] > cycle ? earliest[i] - cycle : 0;
+  int best_stall = earliest[best] > cycle ? earliest[best] - cycle : 0;
+
+  if (stall != best_stall) {
+    return stall < best_stall;
+  }
+  return priority[i] > priority[best];
+}
+
+/* schedule_block - reorders one basic block
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *   first - mips_instruction - the first operation of the block
+ *   count - int - how many operations the block holds, ending with its
+ *           branch, if it has one, which stays last
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void schedule_block(struct mips_section *code, struct mips_instruction *first, int count) {
+  struct mips_instruction **instructions, *iter, *before = first->prev;
+  struct schedule_effects *effects;
+  int *distance, *priority, *earliest, *waiting;
+  int i, j, placed, cycle = 0;
+  int fixed_last;
+
+  if (count < 2) {
+    return;
+  }
+  instructions = malloc(sizeof(struct mips_instruction *) * count);
+  effects = malloc(sizeof(struct schedule_effects) * count);
+  distance = malloc(sizeof(int) * count * count);
+  priority = malloc(sizeof(int) * count);
+  earliest = calloc(count, sizeof(int));
+  waiting = calloc(count, sizeof(int));
+  assert(NULL != instructions && NULL != effects && NULL != distance && NULL != priority &&
+      NULL != earliest && NULL != waiting);
+
+  for (i = 0, iter = first; i < count; i++, iter = iter->next) {
+    instructions[i] = iter;
+    effects[i] = schedule_effects(iter);
+  }
+  fixed_last = schedule_ends_block(instructions[count - 1]);
+
+  for (i = 0; i < count; i++) {
+    for (j = 0; j < count; j++) {
+      distance[i * count + j] = -1;
+      if (j <= i) {
+        continue;
+      }
+      distance[i * count + j] = schedule_dependence(&effects[i], &effects[j]);
+      // Nothing moves past the branch that ends the block
+      if (fixed_last && j == count - 1 && distance[i * count + j] < 0) {
+        distance[i * count + j] = 0;
+      }
+      if (distance[i * count + j] >= 0) {
+        waiting[j]++;
+      }
+    }
+  }
+
+  // Critical path: the longest chain of latencies from each instruction to the end
+  for (i = count - 1; i >= 0; i--) {
+    priority[i] = effects[i].latency;
+    for (j = i + 1; j < count; j++) {
+      if (distance[i * count + j] >= 0 && distance[i * count + j] + priority[j] > priority[i]) {
+        priority[i] = distance[i * count + j] + priority[j];
+      }
+    }
+  }
+
+  for (placed = 0; placed < count; placed++) {
+    int best = -1;
+    for (i = 0; i < count; i++) {
+      if (waiting[i] == 0 && (best < 0 || schedule_better(i, best, earliest, priority, cycle))) {
+        best = i;
+      }
+    }
+    assert(best >= 0);
+
+    if (earliest[best] > cycle) {
+      cycle = earliest[best];
+    }
+    waiting[best] = -1;
+    for (j = 0; j < count; j++) {
+      int d = distance[best * count + j];
+      if (d >= 0) {
+        waiting[j]--;
+        if (cycle + d > earliest[j]) {
+          earliest[j] = cycle + d;
+        }
+      }
+    }
+    cycle++;
+
+    mips_remove(code, instructions[best]);
+    mips_insert_after(code, before, instructions[best]);
+    before = instructions[best];
+  }
+
+  free(instructions);
+  free(effects);
+  free(distance);
+  free(priority);
+  free(earliest);
+  free(waiting);
+}
+
+/* schedule_blocks - runs the list scheduler over every basic block
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ */
+static void schedule_blocks(struct mips_section *code) {
+  struct mips_instruction *iter = code->first, *first, *next;
+  int count;
+
+  while (NULL != iter) {
+    if (iter->kind == MIPS_INSTRUCTION_LABEL) {
+      iter = iter->next;
+      continue;
+    }
+    first = iter;
+    count = 0;
+    while (NULL != iter && iter->kind == MIPS_INSTRUCTION_OPERATION) {
+      count++;
+      if (schedule_ends_block(iter)) {
+        iter = iter->next;
+        break;
+      }
+      iter = iter->next;
+    }
+    next = iter;
+    schedule_block(code, first, count);
+    iter = next;
+  }
+}
+
+/*********************
+ * DELAY SLOTS       *
+ *********************/
+
+/* schedule_slot_safe - whether an instruction can go in a delay slot */
+static int schedule_slot_safe(struct mips_instruction *instruction) {
+  int i;
+
+  if (instruction->kind != MIPS_INSTRUCTION_OPERATION) {
+    return 0;
+  }
+  if (!strcmp(instruction->opcode, "li")) {
+    // One instruction only if the constant fits in an addiu or ori
+    return instruction->operands[1].number >= -32768 && instruction->operands[1].number <= 65535;
+  }
+  if (!schedule_opcode_in(instruction->opcode, schedule_slot_opcodes)) {
+    return 0;
+  }
+  for (i = 0; i < instruction->num_operands; i++) {
+    if (instruction->operands[i].kind == MIPS_OPERAND_NUMBER &&
+        (instruction->operands[i].number < -32768 || instruction->operands[i].number > 65535)) {
+      return 0;
+    }
+    if (instruction->operands[i].kind == MIPS_OPERAND_ADDRESS &&
+        (instruction->operands[i].number < -32768 || instruction->operands[i].number > 32767)) {
+      return 0;
+    }
+    if (instruction->operands[i].kind == MIPS_OPERAND_LABEL) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* schedule_branch_reads - the registers a branch itself looks at, which an
+ *   instruction moved into its delay slot must not change
+ */
+static unsigned int schedule_branch_reads(struct mips_instruction *branch) {
+  unsigned int reads = 0;
+  int i;
+
+  for (i = 0; i < branch->num_operands; i++) {
+    if (branch->operands[i].kind == MIPS_OPERAND_REGISTER) {
+      reads |= 1u << branch->operands[i].reg;
+    }
+  }
+  return reads & ~1u;
+}
+
+/* schedule_fill_from_before - moves an instruction from earlier in the block
+ *   into a branch's delay slot
+ *
+ * Returns "true" if the slot was filled
+ */
+static int schedule_fill_from_before(struct mips_section *code, struct mips_instruction *branch) {
+  unsigned int branch_reads = schedule_branch_reads(branch);
+  struct mips_instruction *candidate, *iter;
+  struct schedule_effects moved, passed;
+
+  for (candidate = branch->prev; NULL != candidate; candidate = candidate->prev) {
+    if (candidate->kind != MIPS_INSTRUCTION_OPERATION || schedule_ends_block(candidate) ||
+        (NULL != candidate->prev && schedule_has_delay_slot(candidate->prev))) {
+      return 0;
+    }
+    if (!schedule_slot_safe(candidate)) {
+      continue;
+    }
+    moved = schedule_effects(candidate);
+    if (moved.defs & branch_reads) {
+      continue;
+    }
+    // A call sets $ra before its delay slot runs
+    if (!strcmp(branch->opcode, "jal") && ((moved.defs | moved.uses) & (1u << MIPS_REGISTER_RA))) {
+      continue;
+    }
+    // Taking it out must not leave a load right before a use of what it loads
+    if (NULL != candidate->prev && schedule_is_load(candidate->prev) &&
+        mips_reads_register(candidate->next, mips_defined_register(candidate->prev))) {
+      continue;
+    }
+    for (iter = candidate->next; iter != branch; iter = iter->next) {
+      passed = schedule_effects(iter);
+      if (schedule_dependence(&moved, &passed) >= 0) {
+        break;
+      }
+    }
+    if (iter != branch) {
+      continue;
+    }
+    mips_remove(code, candidate);
+    mips_insert_after(code, branch, candidate);
+    return 1;
+  }
+  return 0;
+}
+
+/* schedule_find_label - the definition of a label in the program, or NULL */
+static struct mips_instruction *schedule_find_label(struct mips_section *code, char *label) {
+  struct mips_instruction *iter;
+
+  for (iter = code->first; NULL != iter; iter = iter->next) {
+    if (iter->kind == MIPS_INSTRUCTION_LABEL && !strcmp(iter->operands[0].label, label)) {
+      return iter;
+    }
+  }
+  return NULL;
+}
+
+/* schedule_fill_from_target - copies the first instruction at a branch's target
+ *   into its delay slot, and moves the target past it
+ *
+ * A conditional branch also runs the copy when it falls through, so the
+ *   copy must not change anything that is still needed on that path.
+ *
+ * Returns "true" if the slot was filled
+ */
+static int schedule_fill_from_target(struct mips_section *code, struct mips_instruction *branch) {
+  static int slot_labels;
+  struct mips_operand *target_operand = &branch->operands[branch->num_operands - 1];
+  struct mips_instruction *label, *target, *copy, *fallthrough = branch->next;
+  struct schedule_effects effects;
+  char *name;
+
+  if (!strcmp(branch->opcode, "j") || !strcmp(branch->opcode, "jr") || !strcmp(branch->opcode, "jal") ||
+      NULL == (label = schedule_find_label(code, target_operand->label))) {
+    return 0;
+  }
+  for (target = label; NULL != target && target->kind == MIPS_INSTRUCTION_LABEL; target = target->next)
+    ;
+  if (NULL == target || !schedule_slot_safe(target)) {
+    return 0;
+  }
+
+  effects = schedule_effects(target);
+  if (strcmp(branch->opcode, "b")) {
+    unsigned int live = 0;
+    if (NULL != fallthrough) {
+      live = mips_register_uses(fallthrough) | (fallthrough->live_out & ~mips_register_defs(fallthrough));
+    }
+    if (effects.memory != SCHEDULE_MEMORY_NONE || (effects.defs & live)) {
+      return 0;
+    }
+  }
+
+  copy = schedule_new_operation(target->opcode);
+  copy->num_operands = target->num_operands;
+  memcpy(copy->operands, target->operands, sizeof(copy->operands));
+  mips_insert_after(code, branch, copy);
+
+  if (NULL != target->next && target->next->kind == MIPS_INSTRUCTION_LABEL) {
+    name = target->next->operands[0].label;
+  } else {
+    struct mips_section scratch = { NULL, NULL, 0 };
+    name = malloc(32);
+    assert(NULL != name);
+    sprintf(name, "_DelaySlot_%d", slot_labels++);
+    mips_insert_after(code, target, mips_emit_label(&scratch, name));
+  }
+  target_operand->label = name;
+  return 1;
+}
+
+/* schedule_fill_delay_slots - puts an instruction, or a nop, after every branch
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ */
+static void schedule_fill_delay_slots(struct mips_section *code) {
+  struct mips_instruction *iter;
+
+  for (iter = code->first; NULL != iter; iter = iter->next) {
+    if (!schedule_has_delay_slot(iter)) {
+      continue;
+    }
+    if (!schedule_fill_from_before(code, iter)) {
+      pass_liveness(code);
+      if (schedule_fill_from_target(code, iter)) {
+        pass_invalidate(PASS_LIVENESS);
+      } else {
+        mips_insert_after(code, iter, schedule_new_operation("nop"));
+      }
+    }
+    // Step over the slot
+    iter = iter->next;
+  }
+}
+
+/* schedule_fix_hazards - adds the nops that the assembler would otherwise add:
+ *   after a load whose result is read by the next instruction, and after an
+ *   mfhi or mflo that is followed too soon by a multiply or divide
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ */
+static void schedule_fix_hazards(struct mips_section *code) {
+  struct mips_instruction *iter, *next;
+  struct schedule_effects effects;
+  int i;
+
+  for (iter = code->first; NULL != iter; iter = iter->next) {
+    if (iter->kind != MIPS_INSTRUCTION_OPERATION) {
+      continue;
+    }
+    if (schedule_is_load(iter)) {
+      for (next = iter->next; NULL != next && next->kind == MIPS_INSTRUCTION_LABEL; next = next->next)
+        ;
+      if (NULL != next && mips_reads_register(next, mips_defined_register(iter))) {
+        mips_insert_after(code, iter, schedule_new_operation("nop"));
+      }
+      continue;
+    }
+    effects = schedule_effects(iter);
+    if (!effects.reads_hi_lo) {
+      continue;
+    }
+    for (i = 1, next = iter->next; NULL != next && i < SCHEDULE_HI_LO_DISTANCE; next = next->next) {
+      if (next->kind != MIPS_INSTRUCTION_OPERATION) {
+        continue;
+      }
+      if (schedule_effects(next).writes_hi_lo) {
+        for (; i < SCHEDULE_HI_LO_DISTANCE; i++) {
+          mips_insert_after(code, iter, schedule_new_operation("nop"));
+        }
+        break;
+      }
+      i++;
+    }
+  }
+}
+
+/* schedule_program - schedules the instructions of a program and, when
+ *   schedule_delay_slots is set, fills its delay slots
+ *
+ * Parameters:
+ *   code - mips_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void schedule_program(struct mips_section *code) {
+  if (schedule_enabled) {
+    schedule_blocks(code);
+    pass_invalidate(PASS_LIVENESS);
+  }
+  if (schedule_delay_slots) {
+    schedule_fill_delay_slots(code);
+    schedule_fix_hazards(code);
+    code->noreorder = 1;
+  }
+}
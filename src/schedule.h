@@ -0,0 +1,11 @@
+#ifndef _SCHEDULE_H
+#define _SCHEDULE_H
+
+struct mips_section;
+
+void schedule_program(struct mips_section *code);
+
+extern int schedule_enabled;
+extern int schedule_delay_slots;
+
+#endif
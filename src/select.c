@@ -0,0 +1,921 @@
+/*
+ * select.c
+ *
+ * Tree-pattern instruction selection.  mips_generate_instruction translates
+ * one IR instruction at a time, so every constant goes through li, every
+ * variable access through la and a load, and every comparison through one of
+ * the slt pseudo-instructions.  Here the IR of a statement is put back
+ * together into expression trees, and each tree is covered with the cheapest
+ * combination of the patterns in select_rules, the way a BURS code generator
+ * does: immediate forms when a constant fits in 16 bits, base+displacement
+ * addressing, $zero for the constant 0, and so on.
+ *
+ * A temporary becomes a subtree of the instruction that uses it when it is
+ * defined once, used once, and nothing between the definition and the use
+ * could change its value: no label, branch, call or sequence point, and, for
+ * trees that read memory or $v0, no store, call or syscall.  mips.c keeps
+ * what a folded definition reads in its register until the tree is emitted.
+ *
+ * Labelling is bottom-up dynamic programming: every node records, for each
+ * nonterminal, the cheapest rule that derives it and what that costs.  The
+ * tree is then reduced top-down from the nonterminal its root needs, emitting
+ * instructions as it goes.  Instructions the rules do not cover are left to
+ * mips_generate_instruction.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "ir.h"
+#include "mips.h"
+#include "select.h"
+
+int select_enabled = 1;
+
+/* Nonterminals: what a subtree can be reduced to */
+#define SELECT_REG      0  /* a value in a register */
+#define SELECT_CONST    1  /* a compile-time constant */
+#define SELECT_ADDR     2  /* a memory operand, offset(register) */
+#define SELECT_LABEL    3  /* a label in the data section */
+#define SELECT_STMT     4  /* an instruction executed for its effect */
+#define SELECT_NUM_NONTERMINALS 5
+
+/* Leaves made from IR operands that are not temporaries defined in the tree */
+#define SELECT_LEAF_TEMPORARY  -1
+#define SELECT_LEAF_NUMBER     -2
+#define SELECT_LEAF_FRAME      -3
+#define SELECT_LEAF_LABEL      -4
+/* Rules that turn one nonterminal into another at the same node */
+#define SELECT_CHAIN            0
+
+/* Ranges a constant must be in for a rule to apply */
+#define SELECT_ANY        0
+#define SELECT_ZERO       1
+#define SELECT_SIGNED     2  /* fits a sign-extended 16-bit immediate */
+#define SELECT_UNSIGNED   3  /* fits a zero-extended 16-bit immediate */
+#define SELECT_IMMEDIATE  4  /* either of the above, so li is one instruction */
+#define SELECT_SHIFT      5  /* a shift amount */
+
+/* Adjustments made to a constant before it is range-checked and emitted */
+#define SELECT_AS_IS      0
+#define SELECT_NEGATE     1
+#define SELECT_PLUS_ONE   2
+
+/* How a rule is emitted */
+#define SELECT_FORM_LEAF           1  /* the leaf's own register */
+#define SELECT_FORM_CONSTANT       2  /* the constant itself */
+#define SELECT_FORM_ZERO           3  /* $zero */
+#define SELECT_FORM_LOAD_IMMEDIATE 4  /* opcode dest, constant */
+#define SELECT_FORM_FRAME          5  /* offset($fp) */
+#define SELECT_FORM_DATA_LABEL     6  /* label */
+#define SELECT_FORM_BASE           7  /* 0(register) */
+#define SELECT_FORM_FORWARD        8  /* the kid's own operand */
+#define SELECT_FORM_DISPLACEMENT   9  /* constant(register), constant second */
+#define SELECT_FORM_DISPLACEMENT_SWAPPED 10 /* constant(register), constant first */
+#define SELECT_FORM_ADDRESS       11  /* opcode dest, base, offset */
+#define SELECT_FORM_LOAD          12  /* opcode dest, kid */
+#define SELECT_FORM_RESULT        13  /* move dest, $v0 */
+#define SELECT_FORM_REGISTERS     14  /* opcode dest, left, right */
+#define SELECT_FORM_REGISTERS_SWAPPED 15 /* opcode dest, right, left */
+#define SELECT_FORM_IMMEDIATE     16  /* opcode dest, left, constant right */
+#define SELECT_FORM_IMMEDIATE_SWAPPED 17 /* opcode dest, right, constant left */
+#define SELECT_FORM_ZERO_LEFT     18  /* opcode dest, $zero, kid */
+#define SELECT_FORM_ZERO_RIGHT    19  /* opcode dest, kid, $zero */
+#define SELECT_FORM_HI_LO         20  /* opcode left, right; then the finish */
+#define SELECT_FORM_TEST          21  /* only the finish, applied to the kid */
+#define SELECT_FORM_STORE         22  /* opcode value, address */
+#define SELECT_FORM_BRANCH        23  /* opcode condition, label */
+#define SELECT_FORM_PARAMETER     24  /* the value into $a<n> */
+#define SELECT_FORM_RETURN        25  /* the value into $v0 */
+#define SELECT_FORM_PRINT         26  /* the value into $a0, then a syscall */
+#define SELECT_FORM_COMPARE_BRANCH 27 /* opcode left, right, label */
+#define SELECT_FORM_ZERO_BRANCH   28  /* opcode left, label; right is 0 */
+#define SELECT_FORM_ZERO_BRANCH_SWAPPED 29 /* opcode right, label; left is 0 */
+#define SELECT_FORM_SET_BRANCH    30  /* opcode $at, left, right; then the finish */
+#define SELECT_FORM_SET_BRANCH_SWAPPED 31 /* opcode $at, right, left; then the finish */
+#define SELECT_FORM_SET_BRANCH_IMMEDIATE 32 /* opcode $at, left, constant; then the finish */
+
+/* Instructions that finish a rule, applied to the value it has computed */
+#define SELECT_FINISH_NONE     0
+#define SELECT_FINISH_INVERT   1  /* xori dest, value, 1 */
+#define SELECT_FINISH_IS_ZERO  2  /* sltiu dest, value, 1 */
+#define SELECT_FINISH_NOT_ZERO 3  /* sltu dest, $zero, value */
+#define SELECT_FINISH_LO       4  /* mflo dest */
+#define SELECT_FINISH_HI       5  /* mfhi dest */
+#define SELECT_FINISH_IF_SET   6  /* bne $at, $zero, label */
+#define SELECT_FINISH_IF_CLEAR 7  /* beq $at, $zero, label */
+
+#define SELECT_INFINITE (INT_MAX / 4)
+#define SELECT_NO_KID -1
+
+struct select_rule {
+  int nonterminal;
+  /* IR instruction kind or leaf kind the rule matches, or SELECT_CHAIN */
+  int kind;
+  /* Nonterminals the node's kids must reduce to; for a chain rule, kids[0]
+   * is the nonterminal of the same node the rule starts from */
+  int kids[2];
+  /* Which kid has to be a constant in range (2 is the node itself), or SELECT_NO_KID */
+  int constant;
+  int range;
+  int adjust;
+  int cost;
+  int form;
+  char *opcode;
+  int finish;
+};
+
+#define SELF 2
+#define NONE SELECT_NO_KID
+
+static struct select_rule select_rules[] = {
+  /* Leaves */
+  {SELECT_CONST, SELECT_LEAF_NUMBER,     {NONE, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_CONSTANT, NULL, 0},
+  {SELECT_CONST, IR_LOAD_IMMEDIATE,      {NONE, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_CONSTANT, NULL, 0},
+  {SELECT_REG,   SELECT_LEAF_TEMPORARY,  {NONE, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_LEAF, NULL, 0},
+  {SELECT_ADDR,  SELECT_LEAF_FRAME,      {NONE, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_FRAME, NULL, 0},
+  {SELECT_LABEL, SELECT_LEAF_LABEL,      {NONE, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_DATA_LABEL, NULL, 0},
+
+  /* Constants in registers */
+  {SELECT_REG, SELECT_CHAIN, {SELECT_CONST, NONE}, SELF, SELECT_ZERO,      SELECT_AS_IS, 0, SELECT_FORM_ZERO, NULL, 0},
+  {SELECT_REG, SELECT_CHAIN, {SELECT_CONST, NONE}, SELF, SELECT_IMMEDIATE, SELECT_AS_IS, 1, SELECT_FORM_LOAD_IMMEDIATE, "li", 0},
+  {SELECT_REG, SELECT_CHAIN, {SELECT_CONST, NONE}, SELF, SELECT_ANY,       SELECT_AS_IS, 2, SELECT_FORM_LOAD_IMMEDIATE, "li", 0},
+
+  /* Addresses */
+  {SELECT_ADDR, SELECT_CHAIN,  {SELECT_REG, NONE},          NONE, SELECT_ANY,    SELECT_AS_IS, 0, SELECT_FORM_BASE, NULL, 0},
+  {SELECT_ADDR, IR_ADDRESS_OF, {SELECT_ADDR, NONE},         NONE, SELECT_ANY,    SELECT_AS_IS, 0, SELECT_FORM_FORWARD, NULL, 0},
+  {SELECT_ADDR, IR_ADDRESS_OF, {SELECT_LABEL, NONE},        NONE, SELECT_ANY,    SELECT_AS_IS, 1, SELECT_FORM_FORWARD, NULL, 0},
+  {SELECT_ADDR, IR_ADD,        {SELECT_REG, SELECT_CONST},  1,    SELECT_SIGNED, SELECT_AS_IS, 0, SELECT_FORM_DISPLACEMENT, NULL, 0},
+  {SELECT_ADDR, IR_ADD,        {SELECT_CONST, SELECT_REG},  0,    SELECT_SIGNED, SELECT_AS_IS, 0, SELECT_FORM_DISPLACEMENT_SWAPPED, NULL, 0},
+  {SELECT_ADDR, IR_ADDU,       {SELECT_REG, SELECT_CONST},  1,    SELECT_SIGNED, SELECT_AS_IS, 0, SELECT_FORM_DISPLACEMENT, NULL, 0},
+  {SELECT_ADDR, IR_ADDU,       {SELECT_CONST, SELECT_REG},  0,    SELECT_SIGNED, SELECT_AS_IS, 0, SELECT_FORM_DISPLACEMENT_SWAPPED, NULL, 0},
+  {SELECT_ADDR, IR_ADDI,       {SELECT_REG, SELECT_CONST},  1,    SELECT_SIGNED, SELECT_AS_IS, 0, SELECT_FORM_DISPLACEMENT, NULL, 0},
+  {SELECT_REG,  IR_ADDRESS_OF, {SELECT_ADDR, NONE},         NONE, SELECT_ANY,    SELECT_AS_IS, 1, SELECT_FORM_ADDRESS, "addiu", 0},
+  {SELECT_REG,  IR_ADDRESS_OF, {SELECT_LABEL, NONE},        NONE, SELECT_ANY,    SELECT_AS_IS, 1, SELECT_FORM_LOAD, "la", 0},
+
+  /* Loads */
+  {SELECT_REG, IR_LOAD_WORD,        {SELECT_ADDR, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_LOAD, "lw", 0},
+  {SELECT_REG, IR_LOAD_HALF_WORD,   {SELECT_ADDR, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_LOAD, "lh", 0},
+  {SELECT_REG, IR_LOAD_HALF_WORD_U, {SELECT_ADDR, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_LOAD, "lhu", 0},
+  {SELECT_REG, IR_LOAD_BYTE,        {SELECT_ADDR, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_LOAD, "lb", 0},
+  {SELECT_REG, IR_LOAD_BYTE_U,      {SELECT_ADDR, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_LOAD, "lbu", 0},
+  {SELECT_REG, IR_RESULT_WORD,      {NONE, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_RESULT, NULL, 0},
+  {SELECT_REG, IR_RESULT_BYTE,      {NONE, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_RESULT, NULL, 0},
+
+  /* Addition and subtraction */
+  {SELECT_REG, IR_ADD,      {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,  1, SELECT_FORM_REGISTERS, "add", 0},
+  {SELECT_REG, IR_ADD,      {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_AS_IS,  1, SELECT_FORM_IMMEDIATE, "addi", 0},
+  {SELECT_REG, IR_ADD,      {SELECT_CONST, SELECT_REG}, 0,    SELECT_SIGNED, SELECT_AS_IS,  1, SELECT_FORM_IMMEDIATE_SWAPPED, "addi", 0},
+  {SELECT_REG, IR_ADDU,     {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,  1, SELECT_FORM_REGISTERS, "addu", 0},
+  {SELECT_REG, IR_ADDU,     {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_AS_IS,  1, SELECT_FORM_IMMEDIATE, "addiu", 0},
+  {SELECT_REG, IR_ADDU,     {SELECT_CONST, SELECT_REG}, 0,    SELECT_SIGNED, SELECT_AS_IS,  1, SELECT_FORM_IMMEDIATE_SWAPPED, "addiu", 0},
+  {SELECT_REG, IR_ADDI,     {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,  1, SELECT_FORM_REGISTERS, "add", 0},
+  {SELECT_REG, IR_ADDI,     {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_AS_IS,  1, SELECT_FORM_IMMEDIATE, "addi", 0},
+  {SELECT_REG, IR_SUBTRACT, {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,  1, SELECT_FORM_REGISTERS, "sub", 0},
+  {SELECT_REG, IR_SUBTRACT, {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_NEGATE, 1, SELECT_FORM_IMMEDIATE, "addi", 0},
+  {SELECT_REG, IR_SUBU,     {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,  1, SELECT_FORM_REGISTERS, "subu", 0},
+  {SELECT_REG, IR_SUBU,     {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_NEGATE, 1, SELECT_FORM_IMMEDIATE, "addiu", 0},
+
+  /* Multiplication and division go through hi and lo */
+  {SELECT_REG, IR_MULTIPLY, {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "mult",  SELECT_FINISH_LO},
+  {SELECT_REG, IR_MULU,     {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "multu", SELECT_FINISH_LO},
+  {SELECT_REG, IR_DIVIDE,   {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "div",   SELECT_FINISH_LO},
+  {SELECT_REG, IR_DIVU,     {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "divu",  SELECT_FINISH_LO},
+  {SELECT_REG, IR_MOD,      {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "div",   SELECT_FINISH_HI},
+  {SELECT_REG, IR_MULTIPLY_HIGH,   {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "mult",  SELECT_FINISH_HI},
+  {SELECT_REG, IR_MULTIPLY_HIGH_U, {SELECT_REG, SELECT_REG}, NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_HI_LO, "multu", SELECT_FINISH_HI},
+
+  /* Shifts and bitwise operations */
+  {SELECT_REG, IR_SHIFT_LEFT,  {SELECT_REG, SELECT_CONST}, 1,    SELECT_SHIFT,    SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE, "sll", 0},
+  {SELECT_REG, IR_SHIFT_LEFT,  {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS, 1, SELECT_FORM_REGISTERS, "sllv", 0},
+  {SELECT_REG, IR_SHIFT_RIGHT, {SELECT_REG, SELECT_CONST}, 1,    SELECT_SHIFT,    SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE, "sra", 0},
+  {SELECT_REG, IR_SHIFT_RIGHT, {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS, 1, SELECT_FORM_REGISTERS, "srav", 0},
+  {SELECT_REG, IR_SHIFT_RIGHT_U, {SELECT_REG, SELECT_CONST}, 1,  SELECT_SHIFT,    SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE, "srl", 0},
+  {SELECT_REG, IR_SHIFT_RIGHT_U, {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS, 1, SELECT_FORM_REGISTERS, "srlv", 0},
+  {SELECT_REG, IR_BIT_AND,     {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS, 1, SELECT_FORM_REGISTERS, "and", 0},
+  {SELECT_REG, IR_BIT_AND,     {SELECT_REG, SELECT_CONST}, 1,    SELECT_UNSIGNED, SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE, "andi", 0},
+  {SELECT_REG, IR_BIT_AND,     {SELECT_CONST, SELECT_REG}, 0,    SELECT_UNSIGNED, SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE_SWAPPED, "andi", 0},
+  {SELECT_REG, IR_BIT_OR,      {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS, 1, SELECT_FORM_REGISTERS, "or", 0},
+  {SELECT_REG, IR_BIT_OR,      {SELECT_REG, SELECT_CONST}, 1,    SELECT_UNSIGNED, SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE, "ori", 0},
+  {SELECT_REG, IR_BIT_OR,      {SELECT_CONST, SELECT_REG}, 0,    SELECT_UNSIGNED, SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE_SWAPPED, "ori", 0},
+  {SELECT_REG, IR_XOR,         {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS, 1, SELECT_FORM_REGISTERS, "xor", 0},
+  {SELECT_REG, IR_XOR,         {SELECT_REG, SELECT_CONST}, 1,    SELECT_UNSIGNED, SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE, "xori", 0},
+  {SELECT_REG, IR_XOR,         {SELECT_CONST, SELECT_REG}, 0,    SELECT_UNSIGNED, SELECT_AS_IS, 1, SELECT_FORM_IMMEDIATE_SWAPPED, "xori", 0},
+
+  /* Comparisons, all built from slt and friends rather than the pseudo-instructions */
+  {SELECT_REG, IR_LESS,          {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS,    1, SELECT_FORM_REGISTERS, "slt", 0},
+  {SELECT_REG, IR_LESS,          {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED,   SELECT_AS_IS,    1, SELECT_FORM_IMMEDIATE, "slti", 0},
+  {SELECT_REG, IR_LESS_EQUAL,    {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS,    2, SELECT_FORM_REGISTERS_SWAPPED, "slt", SELECT_FINISH_INVERT},
+  {SELECT_REG, IR_LESS_EQUAL,    {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED,   SELECT_PLUS_ONE, 1, SELECT_FORM_IMMEDIATE, "slti", 0},
+  {SELECT_REG, IR_GREATER,       {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS,    1, SELECT_FORM_REGISTERS_SWAPPED, "slt", 0},
+  {SELECT_REG, IR_GREATER,       {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED,   SELECT_PLUS_ONE, 2, SELECT_FORM_IMMEDIATE, "slti", SELECT_FINISH_INVERT},
+  {SELECT_REG, IR_GREATER_EQUAL, {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS,    2, SELECT_FORM_REGISTERS, "slt", SELECT_FINISH_INVERT},
+  {SELECT_REG, IR_GREATER_EQUAL, {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED,   SELECT_AS_IS,    2, SELECT_FORM_IMMEDIATE, "slti", SELECT_FINISH_INVERT},
+  {SELECT_REG, IR_EQUAL,         {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS,    2, SELECT_FORM_REGISTERS, "xor", SELECT_FINISH_IS_ZERO},
+  {SELECT_REG, IR_EQUAL,         {SELECT_REG, SELECT_CONST}, 1,    SELECT_UNSIGNED, SELECT_AS_IS,    2, SELECT_FORM_IMMEDIATE, "xori", SELECT_FINISH_IS_ZERO},
+  {SELECT_REG, IR_EQUAL,         {SELECT_REG, SELECT_CONST}, 1,    SELECT_ZERO,     SELECT_AS_IS,    1, SELECT_FORM_TEST, NULL, SELECT_FINISH_IS_ZERO},
+  {SELECT_REG, IR_NOT_EQUAL,     {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,      SELECT_AS_IS,    2, SELECT_FORM_REGISTERS, "xor", SELECT_FINISH_NOT_ZERO},
+  {SELECT_REG, IR_NOT_EQUAL,     {SELECT_REG, SELECT_CONST}, 1,    SELECT_UNSIGNED, SELECT_AS_IS,    2, SELECT_FORM_IMMEDIATE, "xori", SELECT_FINISH_NOT_ZERO},
+  {SELECT_REG, IR_NOT_EQUAL,     {SELECT_REG, SELECT_CONST}, 1,    SELECT_ZERO,     SELECT_AS_IS,    1, SELECT_FORM_TEST, NULL, SELECT_FINISH_NOT_ZERO},
+
+  /* Unary operations */
+  {SELECT_REG, IR_LOG_NOT,       {SELECT_REG, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_TEST, NULL, SELECT_FINISH_IS_ZERO},
+  {SELECT_REG, IR_BIT_NOT,       {SELECT_REG, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_ZERO_RIGHT, "nor", 0},
+  {SELECT_REG, IR_MAKE_NEGATIVE, {SELECT_REG, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_ZERO_LEFT, "sub", 0},
+  {SELECT_REG, IR_COPY,          {SELECT_REG, NONE}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_ZERO_RIGHT, "or", 0},
+
+  /* Statements */
+  {SELECT_STMT, IR_STORE_WORD,      {SELECT_REG, SELECT_ADDR}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_STORE, "sw", 0},
+  {SELECT_STMT, IR_STORE_HALF_WORD, {SELECT_REG, SELECT_ADDR}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_STORE, "sh", 0},
+  {SELECT_STMT, IR_STORE_BYTE,      {SELECT_REG, SELECT_ADDR}, NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_STORE, "sb", 0},
+  {SELECT_STMT, IR_GOTO_IF_FALSE,   {SELECT_REG, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_BRANCH, "beqz", 0},
+  {SELECT_STMT, IR_GOTO_IF_TRUE,    {SELECT_REG, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 1, SELECT_FORM_BRANCH, "bnez", 0},
+
+  /* Fused compare and branch: against zero where MIPS has a branch for it, else slt into $at */
+  {SELECT_STMT, IR_GOTO_IF_EQUAL,         {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,    1, SELECT_FORM_COMPARE_BRANCH, "beq", 0},
+  {SELECT_STMT, IR_GOTO_IF_NOT_EQUAL,     {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,    1, SELECT_FORM_COMPARE_BRANCH, "bne", 0},
+  {SELECT_STMT, IR_GOTO_IF_LESS,          {SELECT_REG, SELECT_CONST}, 1,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH, "bltz", 0},
+  {SELECT_STMT, IR_GOTO_IF_LESS,          {SELECT_CONST, SELECT_REG}, 0,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH_SWAPPED, "bgtz", 0},
+  {SELECT_STMT, IR_GOTO_IF_LESS,          {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_AS_IS,    2, SELECT_FORM_SET_BRANCH_IMMEDIATE, "slti", SELECT_FINISH_IF_SET},
+  {SELECT_STMT, IR_GOTO_IF_LESS,          {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,    2, SELECT_FORM_SET_BRANCH, "slt", SELECT_FINISH_IF_SET},
+  {SELECT_STMT, IR_GOTO_IF_LESS_EQUAL,    {SELECT_REG, SELECT_CONST}, 1,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH, "blez", 0},
+  {SELECT_STMT, IR_GOTO_IF_LESS_EQUAL,    {SELECT_CONST, SELECT_REG}, 0,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH_SWAPPED, "bgez", 0},
+  {SELECT_STMT, IR_GOTO_IF_LESS_EQUAL,    {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_PLUS_ONE, 2, SELECT_FORM_SET_BRANCH_IMMEDIATE, "slti", SELECT_FINISH_IF_SET},
+  {SELECT_STMT, IR_GOTO_IF_LESS_EQUAL,    {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,    2, SELECT_FORM_SET_BRANCH_SWAPPED, "slt", SELECT_FINISH_IF_CLEAR},
+  {SELECT_STMT, IR_GOTO_IF_GREATER,       {SELECT_REG, SELECT_CONST}, 1,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH, "bgtz", 0},
+  {SELECT_STMT, IR_GOTO_IF_GREATER,       {SELECT_CONST, SELECT_REG}, 0,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH_SWAPPED, "bltz", 0},
+  {SELECT_STMT, IR_GOTO_IF_GREATER,       {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_PLUS_ONE, 2, SELECT_FORM_SET_BRANCH_IMMEDIATE, "slti", SELECT_FINISH_IF_CLEAR},
+  {SELECT_STMT, IR_GOTO_IF_GREATER,       {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,    2, SELECT_FORM_SET_BRANCH_SWAPPED, "slt", SELECT_FINISH_IF_SET},
+  {SELECT_STMT, IR_GOTO_IF_GREATER_EQUAL, {SELECT_REG, SELECT_CONST}, 1,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH, "bgez", 0},
+  {SELECT_STMT, IR_GOTO_IF_GREATER_EQUAL, {SELECT_CONST, SELECT_REG}, 0,    SELECT_ZERO,   SELECT_AS_IS,    1, SELECT_FORM_ZERO_BRANCH_SWAPPED, "blez", 0},
+  {SELECT_STMT, IR_GOTO_IF_GREATER_EQUAL, {SELECT_REG, SELECT_CONST}, 1,    SELECT_SIGNED, SELECT_AS_IS,    2, SELECT_FORM_SET_BRANCH_IMMEDIATE, "slti", SELECT_FINISH_IF_CLEAR},
+  {SELECT_STMT, IR_GOTO_IF_GREATER_EQUAL, {SELECT_REG, SELECT_REG},   NONE, SELECT_ANY,    SELECT_AS_IS,    2, SELECT_FORM_SET_BRANCH, "slt", SELECT_FINISH_IF_CLEAR},
+
+  {SELECT_STMT, IR_PARAMETER,       {SELECT_REG, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_PARAMETER, NULL, 0},
+  {SELECT_STMT, IR_RETURN,          {SELECT_REG, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 0, SELECT_FORM_RETURN, NULL, 0},
+  {SELECT_STMT, IR_PRINT_NUMBER,    {SELECT_REG, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_PRINT, NULL, 0},
+  {SELECT_STMT, IR_PRINT_STRING,    {SELECT_REG, NONE},        NONE, SELECT_ANY, SELECT_AS_IS, 2, SELECT_FORM_PRINT, NULL, 0},
+
+  {-1, 0, {NONE, NONE}, NONE, 0, 0, 0, 0, NULL, 0}
+};
+
+#undef SELF
+#undef NONE
+
+struct select_node {
+  int kind;
+  /* The IR instruction the node was built from; NULL for leaves */
+  struct ir_instruction *instruction;
+  /* Register of a temporary leaf */
+  int reg;
+  /* Constant, frame offset or label of a leaf or IR_LOAD_IMMEDIATE */
+  long value;
+  char *label;
+  struct select_node *kids[2];
+  int cost[SELECT_NUM_NONTERMINALS];
+  struct select_rule *rule[SELECT_NUM_NONTERMINALS];
+};
+
+/* What the analysis in select_prepare knows about each temporary */
+struct select_temporary {
+  int defs, uses;
+  struct ir_instruction *definition;
+  /* Straight-line region the definition is in, or -1 before it is reached */
+  int region;
+  /* Memory state the oldest load in its tree saw, or SELECT_INFINITE if none */
+  int memory;
+  /* Whether the definition is emitted as part of its use */
+  int folded;
+};
+
+static struct select_temporary *select_temporaries = NULL;
+static int select_num_temporaries = 0;
+
+/* select_is_value - whether an instruction is a tree node that computes a
+ *   value into its first operand
+ */
+static int select_is_value(int kind) {
+  switch (kind) {
+    case IR_MULTIPLY: case IR_DIVIDE: case IR_MOD: case IR_MULU: case IR_DIVU:
+    case IR_MULTIPLY_HIGH: case IR_MULTIPLY_HIGH_U:
+    case IR_ADD: case IR_SUBTRACT: case IR_ADDU: case IR_SUBU: case IR_ADDI:
+    case IR_SHIFT_LEFT: case IR_SHIFT_RIGHT: case IR_SHIFT_RIGHT_U:
+    case IR_XOR: case IR_BIT_AND: case IR_BIT_OR:
+    case IR_LESS: case IR_LESS_EQUAL: case IR_GREATER: case IR_GREATER_EQUAL:
+    case IR_EQUAL: case IR_NOT_EQUAL:
+    case IR_LOG_NOT: case IR_BIT_NOT: case IR_MAKE_NEGATIVE: case IR_COPY:
+    case IR_LOAD_WORD: case IR_LOAD_HALF_WORD: case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_BYTE: case IR_LOAD_BYTE_U:
+    case IR_ADDRESS_OF: case IR_LOAD_IMMEDIATE: case IR_RESULT_WORD: case IR_RESULT_BYTE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* select_is_compare_branch - whether an instruction is a fused compare and branch */
+static int select_is_compare_branch(int kind) {
+  switch (kind) {
+    case IR_GOTO_IF_EQUAL: case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS: case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER: case IR_GOTO_IF_GREATER_EQUAL:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* select_is_statement - whether an instruction is a tree root executed for its effect */
+static int select_is_statement(int kind) {
+  if (select_is_compare_branch(kind))
+    return 1;
+  switch (kind) {
+    case IR_STORE_WORD: case IR_STORE_HALF_WORD: case IR_STORE_BYTE:
+    case IR_GOTO_IF_FALSE: case IR_GOTO_IF_TRUE:
+    case IR_PARAMETER: case IR_RETURN: case IR_PRINT_NUMBER: case IR_PRINT_STRING:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* select_reads_state - whether a tree node reads memory or $v0, and so cannot
+ *   be moved past a store, call or syscall
+ */
+static int select_reads_state(int kind) {
+  switch (kind) {
+    case IR_LOAD_WORD: case IR_LOAD_HALF_WORD: case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_BYTE: case IR_LOAD_BYTE_U:
+    case IR_RESULT_WORD: case IR_RESULT_BYTE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* select_kid_operands - the operand positions of an instruction that are kids
+ *   in its tree
+ *
+ * Parameters:
+ *   instruction - ir_instruction - a value or statement instruction
+ *   positions - int[2] - filled with the operand positions
+ *
+ * Returns the number of kids
+ */
+static int select_kid_operands(struct ir_instruction *instruction, int positions[2]) {
+  switch (instruction->kind) {
+    case IR_LOAD_IMMEDIATE: case IR_RESULT_WORD: case IR_RESULT_BYTE:
+      return 0;
+
+    case IR_LOG_NOT: case IR_BIT_NOT: case IR_MAKE_NEGATIVE: case IR_COPY:
+    case IR_LOAD_WORD: case IR_LOAD_HALF_WORD: case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_BYTE: case IR_LOAD_BYTE_U:
+    case IR_ADDRESS_OF: case IR_PARAMETER:
+      positions[0] = 1;
+      return 1;
+
+    case IR_GOTO_IF_FALSE: case IR_GOTO_IF_TRUE:
+    case IR_RETURN: case IR_PRINT_NUMBER: case IR_PRINT_STRING:
+      positions[0] = 0;
+      return 1;
+
+    case IR_STORE_WORD: case IR_STORE_HALF_WORD: case IR_STORE_BYTE:
+    case IR_GOTO_IF_EQUAL: case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS: case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER: case IR_GOTO_IF_GREATER_EQUAL:
+      positions[0] = 0;
+      positions[1] = 1;
+      return 2;
+
+    default:
+      positions[0] = 1;
+      positions[1] = 2;
+      return 2;
+  }
+}
+
+/* select_is_selectable - whether the rules cover an instruction */
+static int select_is_selectable(struct ir_instruction *instruction) {
+  if (select_is_statement(instruction->kind))
+    return 1;
+  return select_is_value(instruction->kind) && OPERAND_TEMPORARY == instruction->operands[0].kind;
+}
+
+/* select_ends_region - whether trees may not span an instruction: control can
+ *   arrive or leave there, or a statement ends
+ */
+static int select_ends_region(struct ir_instruction *instruction) {
+  if (select_is_compare_branch(instruction->kind))
+    return 1;
+  switch (instruction->kind) {
+    case IR_GOTO_IF_FALSE: case IR_GOTO_IF_TRUE: case IR_RETURN:
+      return 1;
+    case IR_NO_OPERATION:
+      return 0;
+    default:
+      return !select_is_selectable(instruction);
+  }
+}
+
+/* select_changes_state - whether an instruction may change memory or $v0 */
+static int select_changes_state(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_STORE_WORD: case IR_STORE_HALF_WORD: case IR_STORE_BYTE:
+    case IR_PRINT_NUMBER: case IR_PRINT_STRING:
+    case IR_FUNCTION_CALL: case IR_TAIL_CALL:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* select_prepare - decides which temporaries become subtrees of the
+ *   instruction that uses them
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void select_prepare(struct ir_section *section) {
+  struct ir_instruction *instruction;
+  int region = 0, memory = 0, max = -1, i;
+
+  select_finish();
+  if (!select_enabled)
+    return;
+
+  for (instruction = section->first; NULL != instruction; instruction = instruction->next)
+    for (i = 0; i < 3; i++)
+      if (OPERAND_TEMPORARY == instruction->operands[i].kind && instruction->operands[i].data.temporary > max)
+        max = instruction->operands[i].data.temporary;
+
+  select_num_temporaries = max + 1;
+  select_temporaries = calloc(select_num_temporaries + 1, sizeof(struct select_temporary));
+  assert(NULL != select_temporaries);
+  for (i = 0; i < select_num_temporaries; i++)
+    select_temporaries[i].region = -1;
+
+  // Count definitions and uses; anything but a tree node's result is a use
+  for (instruction = section->first; NULL != instruction; instruction = instruction->next) {
+    if (IR_SEQUENCE_PT == instruction->kind)
+      continue;
+    for (i = 0; i < 3; i++) {
+      struct ir_operand *operand = &instruction->operands[i];
+      if (OPERAND_TEMPORARY != operand->kind)
+        continue;
+      if (0 == i && select_is_value(instruction->kind)) {
+        select_temporaries[operand->data.temporary].defs++;
+        select_temporaries[operand->data.temporary].definition = instruction;
+      } else {
+        select_temporaries[operand->data.temporary].uses++;
+      }
+    }
+  }
+
+  for (instruction = section->first; NULL != instruction; instruction = instruction->next) {
+    if (select_is_selectable(instruction)) {
+      int positions[2], num_kids = select_kid_operands(instruction, positions);
+      int oldest = select_reads_state(instruction->kind) ? memory : SELECT_INFINITE;
+
+      for (i = 0; i < num_kids; i++) {
+        struct ir_operand *operand = &instruction->operands[positions[i]];
+        struct select_temporary *temporary;
+        if (OPERAND_TEMPORARY != operand->kind)
+          continue;
+        temporary = &select_temporaries[operand->data.temporary];
+        if (1 == temporary->defs && 1 == temporary->uses && temporary->region == region &&
+            (SELECT_INFINITE == temporary->memory || temporary->memory == memory)) {
+          temporary->folded = 1;
+          if (temporary->memory < oldest)
+            oldest = temporary->memory;
+        }
+      }
+
+      if (select_is_value(instruction->kind)) {
+        struct select_temporary *result = &select_temporaries[instruction->operands[0].data.temporary];
+        result->region = region;
+        result->memory = oldest;
+      }
+    }
+
+    if (select_ends_region(instruction))
+      region++;
+    if (select_changes_state(instruction))
+      memory++;
+  }
+}
+
+/* select_is_folded - whether a temporary's definition is emitted as part of its use */
+int select_is_folded(int temporary) {
+  return temporary >= 0 && temporary < select_num_temporaries && select_temporaries[temporary].folded;
+}
+
+/* select_finish - releases what select_prepare worked out */
+void select_finish(void) {
+  free(select_temporaries);
+  select_temporaries = NULL;
+  select_num_temporaries = 0;
+}
+
+/* select_fits - whether a constant is in a rule's range */
+static int select_fits(long value, int range) {
+  switch (range) {
+    case SELECT_ZERO:
+      return 0 == value;
+    case SELECT_SIGNED:
+      return value >= -32768 && value <= 32767;
+    case SELECT_UNSIGNED:
+      return value >= 0 && value <= 65535;
+    case SELECT_IMMEDIATE:
+      return value >= -32768 && value <= 65535;
+    case SELECT_SHIFT:
+      return value >= 0 && value <= 31;
+    default:
+      return 1;
+  }
+}
+
+/* select_adjust - applies a rule's adjustment to a constant */
+static long select_adjust(long value, int adjust) {
+  switch (adjust) {
+    case SELECT_NEGATE:
+      return -value;
+    case SELECT_PLUS_ONE:
+      return value + 1;
+    default:
+      return value;
+  }
+}
+
+/* select_matches - whether a rule's constant, if it has one, is in range */
+static int select_matches(struct select_rule *rule, struct select_node *node) {
+  struct select_node *constant;
+
+  if (SELECT_NO_KID == rule->constant)
+    return 1;
+  constant = rule->constant < 2 ? node->kids[rule->constant] : node;
+  return select_fits(select_adjust(constant->value, rule->adjust), rule->range);
+}
+
+/* select_node_new - allocates a node with nothing derived yet */
+static struct select_node *select_node_new(int kind, struct ir_instruction *instruction) {
+  struct select_node *node = calloc(1, sizeof(struct select_node));
+  int i;
+
+  assert(NULL != node);
+  node->kind = kind;
+  node->instruction = instruction;
+  for (i = 0; i < SELECT_NUM_NONTERMINALS; i++)
+    node->cost[i] = SELECT_INFINITE;
+  return node;
+}
+
+static struct select_node *select_build(struct ir_instruction *instruction);
+
+/* select_build_operand - makes the tree for one operand: the subtree of a
+ *   folded temporary, or a leaf
+ */
+static struct select_node *select_build_operand(struct ir_operand *operand) {
+  struct select_node *node;
+
+  switch (operand->kind) {
+    case OPERAND_TEMPORARY:
+      if (select_temporaries[operand->data.temporary].folded)
+        return select_build(select_temporaries[operand->data.temporary].definition);
+      node = select_node_new(SELECT_LEAF_TEMPORARY, NULL);
+      node->reg = mips_temporary(operand).reg;
+      return node;
+    case OPERAND_NUMBER:
+      node = select_node_new(SELECT_LEAF_NUMBER, NULL);
+      node->value = operand->data.number;
+      return node;
+    case OPERAND_LVALUE:
+      node = select_node_new(SELECT_LEAF_FRAME, NULL);
+      node->value = operand->data.offset;
+      return node;
+    default:
+      assert(OPERAND_LABEL == operand->kind);
+      node = select_node_new(SELECT_LEAF_LABEL, NULL);
+      node->label = operand->data.label_name;
+      return node;
+  }
+}
+
+/* select_build - makes the tree rooted at an instruction */
+static struct select_node *select_build(struct ir_instruction *instruction) {
+  struct select_node *node = select_node_new(instruction->kind, instruction);
+  int positions[2], num_kids = select_kid_operands(instruction, positions), i;
+
+  if (IR_LOAD_IMMEDIATE == instruction->kind)
+    node->value = instruction->operands[1].data.number;
+  for (i = 0; i < num_kids; i++)
+    node->kids[i] = select_build_operand(&instruction->operands[positions[i]]);
+  return node;
+}
+
+/* select_free - frees a tree */
+static void select_free(struct select_node *node) {
+  if (NULL == node)
+    return;
+  select_free(node->kids[0]);
+  select_free(node->kids[1]);
+  free(node);
+}
+
+/* select_label - works out, bottom-up, the cheapest rule deriving each
+ *   nonterminal at every node of a tree
+ */
+static void select_label(struct select_node *node) {
+  struct select_rule *rule;
+  int changed = 1, i;
+
+  for (i = 0; i < 2; i++)
+    if (NULL != node->kids[i])
+      select_label(node->kids[i]);
+
+  for (rule = select_rules; rule->nonterminal >= 0; rule++) {
+    int cost = rule->cost;
+    if (rule->kind != node->kind || !select_matches(rule, node))
+      continue;
+    for (i = 0; i < 2 && cost < SELECT_INFINITE; i++)
+      if (SELECT_NO_KID != rule->kids[i])
+        cost += node->kids[i]->cost[rule->kids[i]];
+    if (cost < node->cost[rule->nonterminal]) {
+      node->cost[rule->nonterminal] = cost;
+      node->rule[rule->nonterminal] = rule;
+    }
+  }
+
+  while (changed) {
+    changed = 0;
+    for (rule = select_rules; rule->nonterminal >= 0; rule++) {
+      int cost;
+      if (SELECT_CHAIN != rule->kind || node->cost[rule->kids[0]] >= SELECT_INFINITE ||
+          !select_matches(rule, node))
+        continue;
+      cost = rule->cost + node->cost[rule->kids[0]];
+      if (cost < node->cost[rule->nonterminal]) {
+        node->cost[rule->nonterminal] = cost;
+        node->rule[rule->nonterminal] = rule;
+        changed = 1;
+      }
+    }
+  }
+}
+
+/* select_destination - the register a node computes its value into: the one
+ *   its parent asked for, otherwise the one its temporary lives in.  Constant
+ *   leaves have no temporary and are put in $at.
+ */
+static int select_destination(struct select_node *node, int hint) {
+  if (hint >= 0)
+    return hint;
+  if (NULL == node->instruction)
+    return MIPS_REGISTER_AT;
+  return mips_temporary(&node->instruction->operands[0]).reg;
+}
+
+/* select_move - copies a register unless it already is the destination */
+static void select_move(struct mips_section *code, int destination, int source) {
+  if (destination != source)
+    mips_emit(code, "or", 3, mips_register(destination), mips_register(source), mips_register(MIPS_REGISTER_ZERO));
+}
+
+/* select_finish_value - emits the instruction that completes a rule */
+static void select_finish_value(struct mips_section *code, int finish, int destination, int value) {
+  switch (finish) {
+    case SELECT_FINISH_INVERT:
+      mips_emit(code, "xori", 3, mips_register(destination), mips_register(value), mips_number(1));
+      break;
+    case SELECT_FINISH_IS_ZERO:
+      mips_emit(code, "sltiu", 3, mips_register(destination), mips_register(value), mips_number(1));
+      break;
+    case SELECT_FINISH_NOT_ZERO:
+      mips_emit(code, "sltu", 3, mips_register(destination), mips_register(MIPS_REGISTER_ZERO), mips_register(value));
+      break;
+    case SELECT_FINISH_LO:
+      mips_emit(code, "mflo", 1, mips_register(destination));
+      break;
+    case SELECT_FINISH_HI:
+      mips_emit(code, "mfhi", 1, mips_register(destination));
+      break;
+    default:
+      break;
+  }
+}
+
+/* select_reduce - emits the instructions of the cheapest derivation of a
+ *   nonterminal at a node
+ *
+ * Parameters:
+ *   code - mips_section - section to append to
+ *   node - select_node - the labelled node
+ *   nonterminal - int - what the node has to be reduced to
+ *   hint - int - register a SELECT_REG result should go in, or -1 for any
+ *
+ * Returns the reduced operand: a register, constant, address or label
+ */
+static struct mips_operand select_reduce(struct mips_section *code, struct select_node *node, int nonterminal, int hint) {
+  struct select_rule *rule = node->rule[nonterminal];
+  struct mips_operand left, right;
+  struct mips_instruction *emitted;
+  int destination;
+
+  assert(NULL != rule);
+  switch (rule->form) {
+    case SELECT_FORM_LEAF:
+      return mips_register(node->reg);
+
+    case SELECT_FORM_CONSTANT:
+      return mips_number(node->value);
+
+    case SELECT_FORM_ZERO:
+      return mips_register(MIPS_REGISTER_ZERO);
+
+    case SELECT_FORM_LOAD_IMMEDIATE:
+      destination = select_destination(node, hint);
+      mips_emit(code, rule->opcode, 2, mips_register(destination), mips_number(node->value));
+      return mips_register(destination);
+
+    case SELECT_FORM_FRAME:
+      return mips_address(node->value, MIPS_REGISTER_FP);
+
+    case SELECT_FORM_DATA_LABEL:
+      return mips_label(node->label);
+
+    case SELECT_FORM_BASE:
+      return mips_address(0, select_reduce(code, node, SELECT_REG, -1).reg);
+
+    case SELECT_FORM_FORWARD:
+      return select_reduce(code, node->kids[0], rule->kids[0], -1);
+
+    case SELECT_FORM_DISPLACEMENT:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      return mips_address(node->kids[1]->value, left.reg);
+
+    case SELECT_FORM_DISPLACEMENT_SWAPPED:
+      right = select_reduce(code, node->kids[1], SELECT_REG, -1);
+      return mips_address(node->kids[0]->value, right.reg);
+
+    case SELECT_FORM_ADDRESS:
+      left = select_reduce(code, node->kids[0], SELECT_ADDR, -1);
+      destination = select_destination(node, hint);
+      mips_emit(code, rule->opcode, 3, mips_register(destination), mips_register(left.reg), mips_number(left.number));
+      return mips_register(destination);
+
+    case SELECT_FORM_LOAD:
+      left = select_reduce(code, node->kids[0], rule->kids[0], -1);
+      destination = select_destination(node, hint);
+      emitted = mips_emit(code, rule->opcode, 2, mips_register(destination), left);
+      emitted->alias = node->instruction->alias;
+      return mips_register(destination);
+
+    case SELECT_FORM_RESULT:
+      destination = select_destination(node, hint);
+      select_move(code, destination, MIPS_REGISTER_V0);
+      return mips_register(destination);
+
+    case SELECT_FORM_REGISTERS:
+    case SELECT_FORM_REGISTERS_SWAPPED:
+    case SELECT_FORM_HI_LO:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      right = select_reduce(code, node->kids[1], SELECT_REG, -1);
+      destination = select_destination(node, hint);
+      if (SELECT_FORM_HI_LO == rule->form)
+        mips_emit(code, rule->opcode, 2, left, right);
+      else if (SELECT_FORM_REGISTERS == rule->form)
+        mips_emit(code, rule->opcode, 3, mips_register(destination), left, right);
+      else
+        mips_emit(code, rule->opcode, 3, mips_register(destination), right, left);
+      select_finish_value(code, rule->finish, destination, destination);
+      return mips_register(destination);
+
+    case SELECT_FORM_IMMEDIATE:
+    case SELECT_FORM_IMMEDIATE_SWAPPED: {
+      int value = SELECT_FORM_IMMEDIATE == rule->form ? 0 : 1;
+      left = select_reduce(code, node->kids[value], SELECT_REG, -1);
+      destination = select_destination(node, hint);
+      mips_emit(code, rule->opcode, 3, mips_register(destination), left,
+          mips_number(select_adjust(node->kids[1 - value]->value, rule->adjust)));
+      select_finish_value(code, rule->finish, destination, destination);
+      return mips_register(destination);
+    }
+
+    case SELECT_FORM_ZERO_LEFT:
+    case SELECT_FORM_ZERO_RIGHT:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      destination = select_destination(node, hint);
+      if (SELECT_FORM_ZERO_LEFT == rule->form)
+        mips_emit(code, rule->opcode, 3, mips_register(destination), mips_register(MIPS_REGISTER_ZERO), left);
+      else
+        mips_emit(code, rule->opcode, 3, mips_register(destination), left, mips_register(MIPS_REGISTER_ZERO));
+      return mips_register(destination);
+
+    case SELECT_FORM_TEST:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      destination = select_destination(node, hint);
+      select_finish_value(code, rule->finish, destination, left.reg);
+      return mips_register(destination);
+
+    case SELECT_FORM_STORE:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      right = select_reduce(code, node->kids[1], SELECT_ADDR, -1);
+      emitted = mips_emit(code, rule->opcode, 2, left, right);
+      emitted->alias = node->instruction->alias;
+      return left;
+
+    case SELECT_FORM_BRANCH:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      mips_emit(code, rule->opcode, 2, left, mips_label(node->instruction->operands[1].data.label_name));
+      return left;
+
+    case SELECT_FORM_COMPARE_BRANCH:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      right = select_reduce(code, node->kids[1], SELECT_REG, -1);
+      mips_emit(code, rule->opcode, 3, left, right, mips_label(node->instruction->operands[2].data.label_name));
+      return left;
+
+    case SELECT_FORM_ZERO_BRANCH:
+    case SELECT_FORM_ZERO_BRANCH_SWAPPED:
+      left = select_reduce(code, node->kids[SELECT_FORM_ZERO_BRANCH == rule->form ? 0 : 1], SELECT_REG, -1);
+      mips_emit(code, rule->opcode, 2, left, mips_label(node->instruction->operands[2].data.label_name));
+      return left;
+
+    case SELECT_FORM_SET_BRANCH:
+    case SELECT_FORM_SET_BRANCH_SWAPPED:
+    case SELECT_FORM_SET_BRANCH_IMMEDIATE:
+      left = select_reduce(code, node->kids[0], SELECT_REG, -1);
+      if (SELECT_FORM_SET_BRANCH_IMMEDIATE == rule->form)
+        right = mips_number(select_adjust(node->kids[1]->value, rule->adjust));
+      else
+        right = select_reduce(code, node->kids[1], SELECT_REG, -1);
+      if (SELECT_FORM_SET_BRANCH_SWAPPED == rule->form)
+        mips_emit(code, rule->opcode, 3, mips_register(MIPS_REGISTER_AT), right, left);
+      else
+        mips_emit(code, rule->opcode, 3, mips_register(MIPS_REGISTER_AT), left, right);
+      mips_emit(code, SELECT_FINISH_IF_SET == rule->finish ? "bne" : "beq", 3, mips_register(MIPS_REGISTER_AT),
+          mips_register(MIPS_REGISTER_ZERO), mips_label(node->instruction->operands[2].data.label_name));
+      return mips_register(MIPS_REGISTER_AT);
+
+    case SELECT_FORM_PARAMETER:
+      destination = MIPS_REGISTER_A0 + (int)node->instruction->operands[0].data.number;
+      left = select_reduce(code, node->kids[0], SELECT_REG, destination);
+      select_move(code, destination, left.reg);
+      return mips_register(destination);
+
+    case SELECT_FORM_RETURN:
+      left = select_reduce(code, node->kids[0], SELECT_REG, MIPS_REGISTER_V0);
+      select_move(code, MIPS_REGISTER_V0, left.reg);
+      return mips_register(MIPS_REGISTER_V0);
+
+    case SELECT_FORM_PRINT:
+      left = select_reduce(code, node->kids[0], SELECT_REG, MIPS_REGISTER_A0);
+      select_move(code, MIPS_REGISTER_A0, left.reg);
+      mips_emit(code, "ori", 3, mips_register(MIPS_REGISTER_V0), mips_register(MIPS_REGISTER_ZERO),
+          mips_number(IR_PRINT_STRING == node->kind ? 4 : 1));
+      mips_emit(code, "syscall", 0);
+      return mips_register(MIPS_REGISTER_A0);
+
+    default:
+      assert(0);
+      return mips_register(MIPS_REGISTER_ZERO);
+  }
+}
+
+/* select_instruction - translates an instruction with the tree rules
+ *
+ * Parameters:
+ *   code - mips_section - section to append to
+ *   instruction - ir_instruction - the instruction to translate
+ *
+ * Returns "true" if the instruction was dealt with: translated as the root of
+ *   a tree, or skipped because it is part of the tree of a later instruction.
+ *   Otherwise it is up to mips_generate_instruction.
+ */
+int select_instruction(struct mips_section *code, struct ir_instruction *instruction) {
+  struct select_node *tree;
+
+  if (NULL == select_temporaries || !select_is_selectable(instruction))
+    return 0;
+
+  if (select_is_value(instruction->kind)) {
+    int result, reg;
+    if (select_temporaries[instruction->operands[0].data.temporary].folded)
+      return 1;
+    tree = select_build(instruction);
+    select_label(tree);
+    result = mips_temporary(&instruction->operands[0]).reg;
+    reg = select_reduce(code, tree, SELECT_REG, result).reg;
+    select_move(code, result, reg);
+  } else {
+    tree = select_build(instruction);
+    select_label(tree);
+    select_reduce(code, tree, SELECT_STMT, -1);
+  }
+  select_free(tree);
+  return 1;
+}
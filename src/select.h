@@ -0,0 +1,15 @@
+#ifndef _SELECT_H
+#define _SELECT_H
+
+struct ir_section;
+struct ir_instruction;
+struct mips_section;
+
+void select_prepare(struct ir_section *section);
+int select_instruction(struct mips_section *code, struct ir_instruction *instruction);
+int select_is_folded(int temporary);
+void select_finish(void);
+
+extern int select_enabled;
+
+#endif
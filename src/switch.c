@@ -0,0 +1,173 @@
+/*
+ * switch.c
+ *
+ * Dispatch for switch statements.  The cases, sorted by value, are split into
+ * as few clusters as possible, where a cluster is a single case, a jump table
+ * over a dense run of values, or a set of bit tests over values close enough
+ * together to fit in a word that go to only a few places.  ir.c searches the
+ * clusters with a balanced tree of comparisons, so finding the case takes
+ * O(log n) compares for n clusters, and a jump table then finds it in O(1).
+ *
+ * The split is the usual dynamic program: the fewest clusters covering the
+ * first i cases is, over every j that can start a cluster ending at i, the
+ * fewest covering the first j plus one.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "switch.h"
+
+int switch_tables_enabled = 1;
+int switch_bit_tests_enabled = 1;
+
+/* A bit test only pays for itself with at least this many cases for its
+ * number of destinations; the tests are a shift, then an and and a branch for
+ * each destination */
+static int switch_bit_test_min_cases[SWITCH_BIT_TEST_TARGETS + 1] = {0, 3, 5, 6};
+
+/* switch_compare_cases - orders cases by value, for qsort */
+static int switch_compare_cases(const void *left, const void *right) {
+  const struct switch_case *a = left, *b = right;
+  if (a->value != b->value) {
+    return a->value < b->value ? -1 : 1;
+  }
+  return 0;
+}
+
+/* switch_sort_cases - sorts cases by value
+ *
+ * Parameters:
+ *   cases - switch_case - the cases
+ *   count - int - how many there are
+ */
+void switch_sort_cases(struct switch_case *cases, int count) {
+  qsort(cases, count, sizeof(struct switch_case), switch_compare_cases);
+}
+
+/* switch_add_target - adds a destination to a list of distinct ones, which
+ *   stops growing once it is too long for a bit test
+ *
+ * Returns the new length of the list
+ */
+static int switch_add_target(int *targets, int count, int target) {
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (targets[i] == target) {
+      return count;
+    }
+  }
+  if (count <= SWITCH_BIT_TEST_TARGETS) {
+    targets[count++] = target;
+  }
+  return count;
+}
+
+/* switch_bit_test_targets - lists the destinations of a cluster's cases
+ *
+ * Parameters:
+ *   cases - switch_case - all the cases, sorted
+ *   cluster - switch_cluster - the cluster
+ *   targets - int[SWITCH_BIT_TEST_TARGETS + 1] - filled with the destinations
+ *
+ * Returns how many there are
+ */
+int switch_bit_test_targets(struct switch_case *cases, struct switch_cluster *cluster, int *targets) {
+  int count = 0, i;
+
+  for (i = cluster->first; i < cluster->first + cluster->count; i++) {
+    count = switch_add_target(targets, count, cases[i].target);
+  }
+  return count;
+}
+
+/* switch_cluster_kind - how a run of cases can be dispatched in one go
+ *
+ * Parameters:
+ *   cases - switch_case - all the cases, sorted
+ *   first - int - the first case of the run
+ *   count - int - how many cases are in it
+ *   num_targets - int - how many destinations they go to
+ *
+ * Returns the kind of cluster, or 0 if the run cannot be one
+ */
+static int switch_cluster_kind(struct switch_case *cases, int first, int count, int num_targets) {
+  long range = cases[first + count - 1].value - cases[first].value + 1;
+
+  if (1 == count) {
+    return SWITCH_CLUSTER_CASE;
+  }
+  // Bit tests need no memory, so they win when both would do
+  if (switch_bit_tests_enabled && range <= SWITCH_BIT_TEST_WIDTH && num_targets <= SWITCH_BIT_TEST_TARGETS &&
+      count >= switch_bit_test_min_cases[num_targets]) {
+    return SWITCH_CLUSTER_BIT_TEST;
+  }
+  if (switch_tables_enabled && count >= SWITCH_TABLE_MIN_CASES && range <= SWITCH_TABLE_MAX_ENTRIES &&
+      count * 100 >= range * SWITCH_TABLE_MIN_DENSITY) {
+    return SWITCH_CLUSTER_TABLE;
+  }
+  return 0;
+}
+
+/* switch_plan - splits sorted cases into the fewest clusters
+ *
+ * Parameters:
+ *   cases - switch_case - the cases, sorted by value, with no value twice
+ *   count - int - how many there are
+ *   clusters - switch_cluster - room for count clusters, filled in order of value
+ *
+ * Returns the number of clusters
+ */
+int switch_plan(struct switch_case *cases, int count, struct switch_cluster *clusters) {
+  int *best = malloc(sizeof(int) * (count + 1));
+  int *start = malloc(sizeof(int) * (count + 1));
+  int *kind = malloc(sizeof(int) * (count + 1));
+  int targets[SWITCH_BIT_TEST_TARGETS + 1];
+  int num_clusters = 0, i, j;
+
+  assert(NULL != best && NULL != start && NULL != kind);
+  best[0] = 0;
+  for (i = 1; i <= count; i++) {
+    int num_targets = 0;
+
+    best[i] = INT_MAX;
+    // Going down, so between equally good splits the longest last cluster wins
+    for (j = i - 1; j >= 0; j--) {
+      int cluster_kind;
+      long range = cases[i - 1].value - cases[j].value + 1;
+
+      if (j < i - 1 && range > SWITCH_TABLE_MAX_ENTRIES && range > SWITCH_BIT_TEST_WIDTH) {
+        break;
+      }
+      num_targets = switch_add_target(targets, num_targets, cases[j].target);
+      cluster_kind = switch_cluster_kind(cases, j, i - j, num_targets);
+      if (0 != cluster_kind && best[j] + 1 <= best[i]) {
+        best[i] = best[j] + 1;
+        start[i] = j;
+        kind[i] = cluster_kind;
+      }
+    }
+  }
+
+  // Walk back from the end, then put the clusters in order
+  for (i = count; i > 0; i = start[i]) {
+    clusters[num_clusters].kind = kind[i];
+    clusters[num_clusters].first = start[i];
+    clusters[num_clusters].count = i - start[i];
+    clusters[num_clusters].low = cases[start[i]].value;
+    clusters[num_clusters].high = cases[i - 1].value;
+    num_clusters++;
+  }
+  for (i = 0, j = num_clusters - 1; i < j; i++, j--) {
+    struct switch_cluster swap = clusters[i];
+    clusters[i] = clusters[j];
+    clusters[j] = swap;
+  }
+
+  free(best);
+  free(start);
+  free(kind);
+  return num_clusters;
+}
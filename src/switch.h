@@ -0,0 +1,49 @@
+#ifndef _SWITCH_H
+#define _SWITCH_H
+
+/* One case label: its value and which of the switch's destinations it goes to */
+struct switch_case {
+  long value;
+  int target;
+};
+
+/*
+ * A run of cases, in order of value, that the dispatch code handles in one go.
+ */
+#define SWITCH_CLUSTER_CASE      1 /* a single value, compared for */
+#define SWITCH_CLUSTER_TABLE     2 /* a jump table indexed by value - low */
+#define SWITCH_CLUSTER_BIT_TEST  3 /* a mask of the values for each destination */
+
+struct switch_cluster {
+  int kind;
+  long low, high;
+  /* The cases it covers */
+  int first, count;
+};
+
+/* A jump table needs at least this many cases, filling this percentage of its
+ * entries, and no more than this many entries */
+#define SWITCH_TABLE_MIN_CASES    4
+#define SWITCH_TABLE_MIN_DENSITY  40
+#define SWITCH_TABLE_MAX_ENTRIES  4096
+
+/* A bit test covers values within a word of each other, going to at most
+ * this many destinations */
+#define SWITCH_BIT_TEST_WIDTH     32
+#define SWITCH_BIT_TEST_TARGETS   3
+
+/* Up to this many clusters are compared for one after another rather than
+ * searched for */
+#define SWITCH_LINEAR_CLUSTERS    3
+
+/* The value and one cluster's temporaries all have to fit in t0-t7 and s0-s7 */
+#define SWITCH_MAX_TEMPORARIES    16
+
+void switch_sort_cases(struct switch_case *cases, int count);
+int switch_plan(struct switch_case *cases, int count, struct switch_cluster *clusters);
+int switch_bit_test_targets(struct switch_case *cases, struct switch_cluster *cluster, int *targets);
+
+extern int switch_tables_enabled;
+extern int switch_bit_tests_enabled;
+
+#endif
@@ -19,6 +19,7 @@ struct type *get_symbol_type_from_type_node(struct node *type_node);
 int compare_types(struct type *type_a, struct type *type_b, int lineno, char *name);
 void symbol_add_from_expression(struct symbol_table *table, struct node *expression, struct type *symbol_type);
 int evaluate_constant_expr(struct node *expr);
+int symbol_fold_constant(struct node *expr, long *value);
 struct symbol_table *make_new_child_table(struct symbol_table *parent_table);
 
 /**********************************************
@@ -285,6 +286,7 @@ void symbol_add_from_function_declarator(struct symbol_table *table, struct node
 	  function_type->data.func.return_type = symbol_type;
 	  function_type->data.func.is_definition = 0;
       function_type->data.func.table = NULL;
+      function_type->data.func.num_params = 0;
 
         while(list_node != NULL) {
           list_node = list_node->data.comma_list.next;
@@ -537,6 +539,60 @@ void symbol_add_from_conditional(struct symbol_table *table, struct node *condit
   }
 }
 
+/* The innermost switch statement being walked, which case and default labels
+ * belong to, or NULL outside of one */
+static struct node *symbol_current_switch = NULL;
+
+void symbol_add_from_switch(struct symbol_table *table, struct node *switch_statement) {
+  struct node *outer_switch = symbol_current_switch;
+
+  symbol_add_from_expression(table, switch_statement->data.switch_statement.expr, NULL);
+  symbol_current_switch = switch_statement;
+  symbol_add_from_statement(table, NULL, switch_statement->data.switch_statement.statement);
+  symbol_current_switch = outer_switch;
+}
+
+/* symbol_add_from_case - links a case or default label to the switch it is in,
+ * working out the value of a case's constant expression
+ *
+ * Parameters:
+ *        table -
+ *        case_label - node - a node containing the case or default label
+ */
+void symbol_add_from_case(struct symbol_table *table, struct node *case_label) {
+  struct node *switch_statement = symbol_current_switch;
+  struct node **last;
+
+  if (switch_statement == NULL)
+  {
+	  printf("ERROR - line %d: %s label not within a switch statement.\n", case_label->line_number,
+			  case_label->data.case_label.expr == NULL ? "Default" : "Case");
+	  symbol_table_num_errors++;
+  }
+  else if (case_label->data.case_label.expr == NULL)
+  {
+	  if (switch_statement->data.switch_statement.default_case != NULL)
+	  {
+		  printf("ERROR - line %d: Multiple default labels in one switch statement.\n", case_label->line_number);
+		  symbol_table_num_errors++;
+	  }
+	  switch_statement->data.switch_statement.default_case = case_label;
+  }
+  else
+  {
+	  if (!symbol_fold_constant(case_label->data.case_label.expr, &case_label->data.case_label.value))
+	  {
+		  printf("ERROR - line %d: Case label does not reduce to an integer constant.\n", case_label->line_number);
+		  symbol_table_num_errors++;
+	  }
+	  // Keep the cases in the order they appear
+	  for (last = &switch_statement->data.switch_statement.cases; *last != NULL; last = &(*last)->data.case_label.next)
+		  ;
+	  *last = case_label;
+  }
+  symbol_add_from_statement(table, NULL, case_label->data.case_label.statement);
+}
+
 void symbol_add_from_expression_statement(struct symbol_table *table, struct node *expression_statement) {
   assert(NODE_EXPRESSION_STATEMENT == expression_statement->kind);
 
@@ -632,6 +688,7 @@ void symbol_add_from_function_definition(struct symbol_table *parent_table, stru
   function_type->data.func.return_type = symbol_type;
   function_type->data.func.is_definition = 1;
   function_type->data.func.table = child_table;
+  function_type->data.func.num_params = 0;
 
   struct node *list_node = func->data.function_definition.declarator->data.function_declarator.params;
   int param_count = 0;
@@ -726,6 +783,12 @@ void symbol_add_from_statement(struct symbol_table *parent_table, struct symbol_
     case NODE_CONDITIONAL:
       symbol_add_from_conditional(parent_table, statement);
       break;
+    case NODE_SWITCH:
+      symbol_add_from_switch(parent_table, statement);
+      break;
+    case NODE_CASE:
+      symbol_add_from_case(parent_table, statement);
+      break;
     case NODE_WHILE:
       symbol_add_from_while(parent_table, statement);
       break;
@@ -924,76 +987,136 @@ struct type *get_symbol_type_from_type_node(struct node *type_node) {
   return symbol_type;
 }
 
-/* Array declarations can specify the length of arrays to create.  If this length is specified,
- * it must be done so with a constant expression that can be evaluated at compile time.
- * Such expressions include single numbers, some binary and some unary operations.  Any other
- * expression will return a -1.
+/* symbol_fold_constant - works out the value of a constant expression at compile time.
+ * Such expressions are numbers, and unary and binary operations (other than assignments)
+ * on constant expressions.
+ *
+ * Parameters:
+ *      expr - node - the expression
+ *      value - long * - set to the value
+ *
+ * Returns "true" if the expression is constant
  */
-int evaluate_constant_expr(struct node *expr) {
+int symbol_fold_constant(struct node *expr, long *value) {
+	long left, right;
+
 	if (expr->kind == NODE_NUMBER)
 	{
-		return expr->data.number.value;
+		*value = expr->data.number.value;
+		return 1;
 	}
 	if (expr->kind == NODE_BINARY_OPERATION)
 	{
-		if(expr->data.binary_operation.left_operand->kind == NODE_NUMBER && expr->data.binary_operation.right_operand->kind == NODE_NUMBER)
+		if(!symbol_fold_constant(expr->data.binary_operation.left_operand, &left) ||
+				!symbol_fold_constant(expr->data.binary_operation.right_operand, &right))
+			return 0;
+
+		switch(expr->data.binary_operation.operation)
 		{
-			int left = expr->data.binary_operation.left_operand->data.number.value;
-			int right = expr->data.binary_operation.right_operand->data.number.value;
-
-			switch(expr->data.binary_operation.operation)
-			{
-			case OP_ASTERISK:
-				return left * right;
-			case OP_SLASH:
-				return left / right;
-			case OP_PLUS:
-				return left + right;
-			case OP_MINUS:
-				return left - right;
-			case OP_AMPERSAND:
-				return left & right;
-			case OP_PERCENT:
-				return left % right;
-			case OP_LESS_LESS:
-				return left << right;
-			case OP_GREATER_GREATER:
-				return left >> right;
-			case OP_VBAR:
-				return left | right;
-			case OP_CARET:
-				return left ^ right;
-			case OP_AMPERSAND_AMPERSAND:
-				return left && right;
-			case OP_VBAR_VBAR:
-				return left || right;
-			default:
-				break;
-			}
+		case OP_ASTERISK:
+			*value = left * right;
+			return 1;
+		case OP_SLASH:
+			if(right == 0)
+				return 0;
+			*value = left / right;
+			return 1;
+		case OP_PERCENT:
+			if(right == 0)
+				return 0;
+			*value = left % right;
+			return 1;
+		case OP_PLUS:
+			*value = left + right;
+			return 1;
+		case OP_MINUS:
+			*value = left - right;
+			return 1;
+		case OP_AMPERSAND:
+			*value = left & right;
+			return 1;
+		case OP_LESS_LESS:
+			*value = left << right;
+			return 1;
+		case OP_GREATER_GREATER:
+			*value = left >> right;
+			return 1;
+		case OP_VBAR:
+			*value = left | right;
+			return 1;
+		case OP_CARET:
+			*value = left ^ right;
+			return 1;
+		case OP_LESS:
+			*value = left < right;
+			return 1;
+		case OP_LESS_EQUAL:
+			*value = left <= right;
+			return 1;
+		case OP_GREATER:
+			*value = left > right;
+			return 1;
+		case OP_GREATER_EQUAL:
+			*value = left >= right;
+			return 1;
+		case OP_EQUAL_EQUAL:
+			*value = left == right;
+			return 1;
+		case OP_EXCLAMATION_EQUAL:
+			*value = left != right;
+			return 1;
+		case OP_AMPERSAND_AMPERSAND:
+			*value = left && right;
+			return 1;
+		case OP_VBAR_VBAR:
+			*value = left || right;
+			return 1;
+		default:
+			return 0;
 		}
 	}
 	if (expr->kind == NODE_UNARY_OPERATION)
 	{
-		if(expr->data.unary_operation.operand->kind == NODE_NUMBER)
+		if(!symbol_fold_constant(expr->data.unary_operation.operand, &right))
+			return 0;
+
+		switch(expr->data.unary_operation.operation)
 		{
-			int op = expr->data.unary_operation.operand->data.number.value;
-
-			switch(expr->data.unary_operation.operation)
-			{
-			case OP_EXCLAMATION:
-				return !op;
-			case OP_TILDE:
-				return ~op;
-			case OP_PLUS:
-				return op;
-			case OP_MINUS:
-				return -op;
-			default:
-				break;
-			}
+		case OP_EXCLAMATION:
+			*value = !right;
+			return 1;
+		case OP_TILDE:
+			*value = ~right;
+			return 1;
+		case OP_PLUS:
+			*value = right;
+			return 1;
+		case OP_MINUS:
+			*value = -right;
+			return 1;
+		default:
+			return 0;
 		}
 	}
+	if (expr->kind == NODE_TERNARY_OPERATION)
+	{
+		if(!symbol_fold_constant(expr->data.ternary_operation.log_expr, &left))
+			return 0;
+		return symbol_fold_constant(left ? expr->data.ternary_operation.expr : expr->data.ternary_operation.cond_expr, value);
+	}
+
+	return 0;
+}
+
+/* Array declarations can specify the length of arrays to create.  If this length is specified,
+ * it must be done so with a constant expression that can be evaluated at compile time.
+ * Any other expression will return a -1.
+ */
+int evaluate_constant_expr(struct node *expr) {
+	long value;
 
+	if (symbol_fold_constant(expr, &value))
+		return value;
 	return -1;
 }
 
@@ -0,0 +1,336 @@
+/*
+ * tailcall.c
+ *
+ * Tail and sibling call optimization.  A call is in tail position when, on
+ * the function's control flow graph, nothing but labels, jumps and sequence
+ * points lies between it and a return of its result (or a return from a void
+ * function).
+ *
+ * A tail call of the function itself becomes stores into the parameter slots
+ * and a jump back to the top of the function body.  A tail call of any other
+ * function becomes an IR_TAIL_CALL, which tears down the caller's frame and
+ * jumps to the callee, so the callee returns straight to our caller.  Since
+ * all arguments travel in $a0-$a3, every callee is frame-compatible; the only
+ * thing that rules a call out is the caller's frame being reachable through a
+ * pointer, because the frame no longer exists (or is reused) once the callee
+ * runs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "node.h"
+#include "ir.h"
+#include "cfg.h"
+#include "tailcall.h"
+#include "pass.h"
+
+int tailcall_enabled = 1;
+
+struct tailcall_site {
+  struct ir_instruction *call;
+  struct ir_instruction *result;
+  int straight;
+  struct tailcall_site *next;
+};
+
+/* tailcall_is_memory_access - whether operand position of an instruction is
+ *   the address a load or store goes through
+ *
+ * Parameters:
+ *   instruction - ir_instruction - the instruction
+ *   position - int - operand number
+ */
+static int tailcall_is_memory_access(struct ir_instruction *instruction, int position) {
+  switch (instruction->kind) {
+    case IR_LOAD_BYTE:
+    case IR_LOAD_BYTE_U:
+    case IR_LOAD_HALF_WORD:
+    case IR_LOAD_HALF_WORD_U:
+    case IR_LOAD_WORD:
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+      return position == 1;
+    default:
+      return 0;
+  }
+}
+
+/* tailcall_frame_escapes - whether the address of anything in the frame is used
+ *   for more than a plain load or store, e.g. passed to a call or kept in memory
+ *
+ * Parameters:
+ *   graph - cfg - the function's graph
+ */
+static int tailcall_frame_escapes(struct cfg *graph) {
+  struct ir_instruction *iter;
+  char *is_address;
+  int max_temporary = 0, escapes = 0, i;
+
+  for (iter = graph->begin; iter != graph->end->next; iter = iter->next) {
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY && iter->operands[i].data.temporary > max_temporary) {
+        max_temporary = iter->operands[i].data.temporary;
+      }
+    }
+  }
+
+  is_address = calloc(max_temporary + 1, 1);
+  assert(NULL != is_address);
+  for (iter = graph->begin; iter != graph->end->next; iter = iter->next) {
+    if (iter->kind == IR_ADDRESS_OF && iter->operands[1].kind == OPERAND_LVALUE) {
+      is_address[iter->operands[0].data.temporary] = 1;
+    }
+  }
+
+  for (iter = graph->begin; !escapes && iter != graph->end->next; iter = iter->next) {
+    if (iter->kind == IR_ADDRESS_OF || iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind == OPERAND_TEMPORARY && is_address[iter->operands[i].data.temporary] &&
+          !tailcall_is_memory_access(iter, i)) {
+        escapes = 1;
+      }
+    }
+  }
+  free(is_address);
+  return escapes;
+}
+
+/* tailcall_return_point - follows control from a call to see whether it is in
+ *   tail position
+ *
+ * Parameters:
+ *   graph - cfg - the function's graph
+ *   after - ir_instruction - the call, or the instruction fetching its result
+ *   result - ir_instruction - the IR_RESULT_WORD/BYTE, or NULL
+ *   straight - int * - set to "false" if control had to leave the call's block
+ *
+ * Returns the IR_RETURN, IR_RETURN_VOID or IR_PROC_END reached, or NULL if the
+ *   call is not in tail position
+ */
+static struct ir_instruction *tailcall_return_point(struct cfg *graph, struct ir_instruction *after,
+                                                    struct ir_instruction *result, int *straight) {
+  struct cfg_block *block = cfg_block_of(graph, after);
+  struct ir_instruction *iter = after;
+  int hops = 0;
+
+  *straight = 1;
+  while (1) {
+    if (iter == block->last) {
+      /* Only a single way out keeps the call in tail position. */
+      if (NULL == block->successors || NULL != block->successors->next || ++hops > graph->num_blocks) {
+        return NULL;
+      }
+      block = block->successors->block;
+      iter = block->first;
+      *straight = 0;
+    } else {
+      iter = iter->next;
+    }
+
+    switch (iter->kind) {
+      case IR_LABEL:
+      case IR_SEQUENCE_PT:
+      case IR_NO_OPERATION:
+      case IR_GOTO:
+        break;
+
+      case IR_RETURN:
+        if (NULL != result && iter->operands[0].kind == OPERAND_TEMPORARY &&
+            iter->operands[0].data.temporary == result->operands[0].data.temporary) {
+          return iter;
+        }
+        return NULL;
+
+      case IR_RETURN_VOID:
+      case IR_PROC_END:
+        return iter;
+
+      default:
+        return NULL;
+    }
+  }
+}
+
+/* tailcall_remove_tail - drops the now unreachable return that followed a call
+ *   in the same block, up to and including its IR_PROC_END
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   from - ir_instruction - the last instruction to keep
+ */
+static void tailcall_remove_tail(struct ir_section *section, struct ir_instruction *from) {
+  struct ir_instruction *iter, *next;
+
+  for (iter = from->next; NULL != iter; iter = next) {
+    int is_end = iter->kind == IR_PROC_END;
+    next = iter->next;
+    /* Register numbering of what follows may still depend on sequence points. */
+    if (iter->kind != IR_SEQUENCE_PT) {
+      ir_remove(section, iter);
+    }
+    if (is_end) {
+      break;
+    }
+  }
+}
+
+/* tailcall_self - turns a self-recursive tail call into a loop
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   graph - cfg - the function's graph
+ *   site - tailcall_site - the call
+ *   params - ir_instruction ** - the call's IR_PARAMETERs, by number
+ *   top - ir_instruction ** - label at the top of the body, created on first use
+ */
+static void tailcall_self(struct ir_section *section, struct cfg *graph, struct tailcall_site *site,
+                          struct ir_instruction **params, struct ir_instruction **top) {
+  int num_params = (int)site->call->operands[1].data.number;
+  int i;
+
+  if (NULL == *top) {
+    *top = ir_instruction(IR_LABEL);
+    ir_operand_label(*top, 0);
+    ir_insert_after(section, graph->begin, *top);
+  }
+
+  /* All arguments are computed before any parameter slot is overwritten. */
+  for (i = 0; i < num_params; i++) {
+    struct ir_instruction *store = ir_instruction(IR_STORE_WORD);
+    store->operands[0] = params[i]->operands[1];
+    store->operands[1].kind = OPERAND_LVALUE;
+    store->operands[1].data.offset = i * 4;
+    ir_insert_before(section, site->call, store);
+    ir_remove(section, params[i]);
+  }
+
+  struct ir_instruction *jump = ir_instruction(IR_GOTO);
+  jump->operands[0] = (*top)->operands[0];
+  ir_insert_before(section, site->call, jump);
+
+  if (NULL != site->result) {
+    ir_remove(section, site->result);
+  }
+  ir_remove(section, site->call);
+  if (site->straight) {
+    tailcall_remove_tail(section, jump);
+  }
+}
+
+/* tailcall_sibling - turns a tail call of another function into a jump
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   graph - cfg - the function's graph
+ *   site - tailcall_site - the call
+ *   params - ir_instruction ** - the call's IR_PARAMETERs, by number
+ */
+static void tailcall_sibling(struct ir_section *section, struct cfg *graph, struct tailcall_site *site,
+                             struct ir_instruction **params) {
+  int num_params = (int)site->call->operands[1].data.number;
+  int i;
+
+  /* Argument registers are set last, so nothing computed in between can clobber them. */
+  for (i = 0; i < num_params; i++) {
+    ir_remove(section, params[i]);
+    ir_insert_before(section, site->call, params[i]);
+  }
+
+  site->call->kind = IR_TAIL_CALL;
+  site->call->operands[2].kind = OPERAND_NUMBER;
+  site->call->operands[2].data.number = graph->begin->operands[1].data.number;
+
+  if (NULL != site->result) {
+    ir_remove(section, site->result);
+  }
+  if (site->straight) {
+    tailcall_remove_tail(section, site->call);
+  }
+}
+
+/* tailcall_function - finds and rewrites the tail calls of one function
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *   graph - cfg - the function's graph
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+static void tailcall_function(struct ir_section *section, struct cfg *graph) {
+  struct tailcall_site *sites = NULL, *site;
+  struct ir_instruction *iter, *top = NULL;
+  struct ir_instruction *params[4];
+
+  if (tailcall_frame_escapes(graph)) {
+    return;
+  }
+
+  /* Find every site first; rewriting one never changes whether another is a tail call. */
+  for (iter = graph->begin; iter != graph->end->next; iter = iter->next) {
+    struct ir_instruction *result = NULL, *return_point;
+    int straight;
+
+    if (iter->kind != IR_FUNCTION_CALL) {
+      continue;
+    }
+    if (iter->next->kind == IR_RESULT_WORD || iter->next->kind == IR_RESULT_BYTE) {
+      result = iter->next;
+    }
+    return_point = tailcall_return_point(graph, (NULL == result) ? iter : result, result, &straight);
+    if (NULL == return_point) {
+      continue;
+    }
+
+    site = malloc(sizeof(struct tailcall_site));
+    assert(NULL != site);
+    site->call = iter;
+    site->result = result;
+    site->straight = straight;
+    site->next = sites;
+    sites = site;
+  }
+
+  while (NULL != sites) {
+    site = sites;
+    sites = site->next;
+
+    memset(params, 0, sizeof(params));
+    if ((int)site->call->operands[1].data.number <= 4 &&
+        ir_find_call_parameters(site->call, graph->begin, params)) {
+      if (!strcmp(site->call->operands[0].data.label_name, graph->name)) {
+        tailcall_self(section, graph, site, params, &top);
+      } else {
+        tailcall_sibling(section, graph, site, params);
+      }
+    }
+    free(site);
+  }
+}
+
+/* tailcall_optimize - runs tail and sibling call optimization over the program
+ *
+ * Parameters:
+ *   section - ir_section - the whole program
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+void tailcall_optimize(struct ir_section *section) {
+  struct cfg *graphs, *graph;
+
+  if (!tailcall_enabled || NULL == section || NULL == section->first) {
+    return;
+  }
+
+  graphs = pass_cfg(section);
+  for (graph = graphs; NULL != graph; graph = graph->next) {
+    tailcall_function(section, graph);
+  }
+}
@@ -0,0 +1,10 @@
+#ifndef _TAILCALL_H
+#define _TAILCALL_H
+
+struct ir_section;
+
+void tailcall_optimize(struct ir_section *section);
+
+extern int tailcall_enabled;
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
 
 #include "node.h"
 #include "symbol.h"
@@ -1116,6 +1117,48 @@ struct type *type_assign_in_conditional(struct node *conditional, struct type *r
 	  return if_type;
 }
 
+/*
+ * type_assign_in_switch - promotes the controlling expression, which must have an
+ * integer type, and converts each case value to that type
+ *
+ * Parameters:
+ *   switch_statement - node - the node to check
+ *   return_type - type - comes from function definition
+ */
+struct type *type_assign_in_switch(struct node *switch_statement, struct type *return_type) {
+  struct node *case_label, *other;
+  struct type *type;
+
+  type_assign_in_expression(switch_statement->data.switch_statement.expr);
+  switch_statement->data.switch_statement.expr = type_convert_usual_unary(switch_statement->data.switch_statement.expr);
+  type = type_get_from_node(switch_statement->data.switch_statement.expr);
+  if(!type_is_arithmetic(type))
+  {
+	  type_checking_num_errors++;
+	  printf("ERROR: line %d - Switch quantity is not an integer.\n", switch_statement->line_number);
+  }
+
+  for(case_label = switch_statement->data.switch_statement.cases; case_label != NULL; case_label = case_label->data.case_label.next)
+  {
+	  // Every type is at most a word wide, so compare as the word the value converts to
+	  case_label->data.case_label.value = (int32_t)(uint32_t)case_label->data.case_label.value;
+	  for(other = switch_statement->data.switch_statement.cases; other != case_label; other = other->data.case_label.next)
+		  if(other->data.case_label.value == case_label->data.case_label.value)
+		  {
+			  type_checking_num_errors++;
+			  printf("ERROR: line %d - Duplicate case value.\n", case_label->line_number);
+			  break;
+		  }
+  }
+
+  return type_assign_in_statement(switch_statement->data.switch_statement.statement, return_type);
+}
+
+struct type *type_assign_in_case(struct node *case_label, struct type *return_type) {
+  assert(NODE_CASE == case_label->kind);
+  return type_assign_in_statement(case_label->data.case_label.statement, return_type);
+}
+
 /*
  * type_assign_in_for - just passes contents to assign_in_expression
  *
@@ -1263,6 +1306,12 @@ struct type *type_assign_in_statement(struct node *statement, struct type *retur
     case NODE_CONDITIONAL:
       return type_assign_in_conditional(statement, return_type);
       break;
+    case NODE_SWITCH:
+      return type_assign_in_switch(statement, return_type);
+      break;
+    case NODE_CASE:
+      return type_assign_in_case(statement, return_type);
+      break;
     case NODE_WHILE:
       return type_assign_in_while(statement, return_type);
       break;
@@ -0,0 +1,266 @@
+/*
+ * vectorize.c
+ *
+ * SIMD within a register.  MIPS32 has no vector unit, but a word holds four
+ * chars, and a loop like
+ *
+ *     for (i = 0; i < n; i++)
+ *       d[i] = s[i] + 13;
+ *
+ * can go through its arrays a word at a time with lw and sw, as long as the
+ * arithmetic keeps the bytes from spilling into each other.  The bitwise
+ * operators never do; addition does, so the top bit of each byte is summed
+ * apart from the rest,
+ *
+ *     sum = ((x & 0x7f7f7f7f) + (kk & 0x7f7f7f7f)) ^ ((x ^ kk) & 0x80808080)
+ *
+ * where kk is 13 in every byte; subtracting is adding the negation.  Copies
+ * and fills are loads and stores alone.
+ *
+ * The decisions are made here, on the tree; ir.c generates the code: a scalar
+ * loop until the destination is word aligned, the word loop while four bytes
+ * remain, and a scalar loop for the rest.  Arrays whose addresses differ in
+ * their low two bits cannot both be aligned, and go through the scalar loop.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "node.h"
+#include "symbol.h"
+#include "type.h"
+#include "vectorize.h"
+
+int vectorize_enabled = 1;
+
+/* vectorize_strip - an expression with any list of one item taken off it,
+ *   and, if casts is "true", any conversions between integer types too.  Only
+ *   the low byte of the value is stored, and that does not depend on them.
+ */
+static struct node *vectorize_strip(struct node *expression, int casts) {
+  for (;;) {
+    if (NODE_COMMA_LIST == expression->kind && NULL == expression->data.comma_list.next) {
+      expression = expression->data.comma_list.data;
+    } else if (casts && NODE_CAST == expression->kind && TYPE_BASIC == expression->data.cast.type->kind) {
+      expression = expression->data.cast.cast;
+    } else {
+      return expression;
+    }
+  }
+}
+
+/* vectorize_is_int - whether an expression is a variable of type int */
+static int vectorize_is_int(struct node *expression) {
+  struct type *type;
+
+  if (NODE_IDENTIFIER != expression->kind) {
+    return 0;
+  }
+  type = expression->data.identifier.symbol->result.type;
+  return TYPE_BASIC == type->kind && TYPE_WIDTH_INT == type->data.basic.width && !type->data.basic.is_unsigned;
+}
+
+/* vectorize_is_index - whether an expression is the loop's index variable */
+static int vectorize_is_index(struct node *expression, struct node *index) {
+  expression = vectorize_strip(expression, 0);
+  return NODE_IDENTIFIER == expression->kind &&
+         expression->data.identifier.symbol == index->data.identifier.symbol;
+}
+
+/* vectorize_is_one - whether an expression is the number 1 */
+static int vectorize_is_one(struct node *expression) {
+  expression = vectorize_strip(expression, 0);
+  return NODE_NUMBER == expression->kind && 1 == expression->data.number.value;
+}
+
+/* vectorize_is_invariant - whether an expression is a number or a variable
+ *   of a basic type other than the index, which the loop cannot change
+ */
+static int vectorize_is_invariant(struct node *expression, struct node *index) {
+  if (NODE_NUMBER == expression->kind) {
+    return 1;
+  }
+  return NODE_IDENTIFIER == expression->kind &&
+         TYPE_BASIC == expression->data.identifier.symbol->result.type->kind &&
+         !vectorize_is_index(expression, index);
+}
+
+/* vectorize_element - the char array of an "a[i]" for the loop's index
+ *
+ * Returns the array's identifier, or NULL if the expression is anything else
+ */
+static struct node *vectorize_element(struct node *expression, struct node *index) {
+  struct node *sum, *array;
+  struct type *type;
+
+  expression = vectorize_strip(expression, 0);
+  if (NODE_UNARY_OPERATION != expression->kind || OP_ASTERISK != expression->data.unary_operation.operation) {
+    return NULL;
+  }
+  sum = vectorize_strip(expression->data.unary_operation.operand, 0);
+  if (NODE_BINARY_OPERATION != sum->kind || OP_PLUS != sum->data.binary_operation.operation ||
+      !vectorize_is_index(sum->data.binary_operation.right_operand, index)) {
+    return NULL;
+  }
+
+  // An array (a pointer type with a size, as symbol.c makes them), not a
+  // pointer: it is a whole object of its own, so two of them are either the
+  // same array or do not overlap at all
+  array = sum->data.binary_operation.left_operand;
+  if (NODE_IDENTIFIER != array->kind) {
+    return NULL;
+  }
+  type = array->data.identifier.symbol->result.type;
+  if (TYPE_POINTER != type->kind || type->data.pointer.size <= 1 || 1 == type->is_param ||
+      TYPE_BASIC != type->data.pointer.type->kind || TYPE_WIDTH_CHAR != type->data.pointer.type->data.basic.width) {
+    return NULL;
+  }
+  return array;
+}
+
+/* vectorize_is_increment - whether an expression adds one to the index */
+static int vectorize_is_increment(struct node *expression, struct node *index) {
+  struct node *sum;
+
+  expression = vectorize_strip(expression, 0);
+  switch (expression->kind) {
+    case NODE_POSTFIX:
+      return OP_PLUS_PLUS == expression->data.postfix.op && vectorize_is_index(expression->data.postfix.expr, index);
+
+    case NODE_PREFIX:
+      return OP_PLUS_PLUS == expression->data.prefix.op && vectorize_is_index(expression->data.prefix.expr, index);
+
+    case NODE_BINARY_OPERATION:
+      if (!vectorize_is_index(expression->data.binary_operation.left_operand, index)) {
+        return 0;
+      }
+      if (OP_PLUS_EQUAL == expression->data.binary_operation.operation) {
+        return vectorize_is_one(expression->data.binary_operation.right_operand);
+      }
+      if (OP_EQUAL != expression->data.binary_operation.operation) {
+        return 0;
+      }
+      sum = vectorize_strip(expression->data.binary_operation.right_operand, 0);
+      return NODE_BINARY_OPERATION == sum->kind && OP_PLUS == sum->data.binary_operation.operation &&
+             ((vectorize_is_index(sum->data.binary_operation.left_operand, index) &&
+               vectorize_is_one(sum->data.binary_operation.right_operand)) ||
+              (vectorize_is_one(sum->data.binary_operation.left_operand) &&
+               vectorize_is_index(sum->data.binary_operation.right_operand, index)));
+
+    default:
+      return 0;
+  }
+}
+
+/* vectorize_body - the one assignment a loop's body consists of, braces and
+ *   all, or NULL
+ */
+static struct node *vectorize_body(struct node *statement) {
+  if (NODE_COMPOUND == statement->kind) {
+    statement = statement->data.compound.statement_list;
+    if (NULL == statement || NULL != statement->data.statement_list.init) {
+      return NULL;
+    }
+    statement = statement->data.statement_list.statement;
+  }
+  if (NODE_EXPRESSION_STATEMENT != statement->kind) {
+    return NULL;
+  }
+  statement = vectorize_strip(statement->data.expression_statement.expression, 0);
+  if (NODE_BINARY_OPERATION != statement->kind || OP_EQUAL != statement->data.binary_operation.operation) {
+    return NULL;
+  }
+  return statement;
+}
+
+/* vectorize_value - works out what an assignment's right side does with the
+ *   source array's element: nothing, one of the operators with a constant, or
+ *   store the constant without reading anything
+ *
+ * Returns "true" if it is one of those
+ */
+static int vectorize_value(struct node *value, struct vectorize_loop *loop) {
+  struct node *left, *right;
+
+  value = vectorize_strip(value, 1);
+  loop->operation = -1;
+  loop->source = vectorize_element(value, loop->index);
+  loop->constant = NULL;
+  if (NULL != loop->source) {
+    return 1;
+  }
+  if (vectorize_is_invariant(value, loop->index)) {
+    loop->constant = value;
+    return 1;
+  }
+
+  if (NODE_BINARY_OPERATION != value->kind) {
+    return 0;
+  }
+  switch (value->data.binary_operation.operation) {
+    case OP_PLUS: case OP_MINUS: case OP_CARET: case OP_AMPERSAND: case OP_VBAR:
+      break;
+    default:
+      return 0;
+  }
+  left = vectorize_strip(value->data.binary_operation.left_operand, 1);
+  right = vectorize_strip(value->data.binary_operation.right_operand, 1);
+  if (NULL == vectorize_element(left, loop->index) && OP_MINUS != value->data.binary_operation.operation) {
+    // "k + a[i]" is "a[i] + k"
+    struct node *swap = left;
+    left = right;
+    right = swap;
+  }
+  loop->source = vectorize_element(left, loop->index);
+  if (NULL == loop->source || !vectorize_is_invariant(right, loop->index)) {
+    return 0;
+  }
+  loop->operation = value->data.binary_operation.operation;
+  loop->constant = right;
+
+  // Adding a variable takes more registers than a statement has, with the
+  // masks worked out as the loop runs rather than by the compiler
+  return NODE_NUMBER == right->kind || (OP_PLUS != loop->operation && OP_MINUS != loop->operation);
+}
+
+/* vectorize_loop - whether a for loop can go through its arrays a word at a
+ *   time
+ *
+ * Parameters:
+ *   statement - node - the NODE_WHILE of a for loop
+ *   loop - vectorize_loop - filled in with the parts of the loop
+ *
+ * Returns "true" if the loop is "for (...; i < n; i++) d[i] = s[i] op k;",
+ *   "d[i] = s[i];" or "d[i] = k;", for char arrays d and s, an int i and
+ *   numbers or variables n and k (a number, for + and -)
+ */
+int vectorize_loop(struct node *statement, struct vectorize_loop *loop) {
+  struct node *for_expr, *condition, *assignment;
+
+  assert(NODE_WHILE == statement->kind);
+  for_expr = statement->data.while_loop.expr;
+  if (NULL == for_expr->data.for_loop.expr2 || NULL == for_expr->data.for_loop.expr3) {
+    return 0;
+  }
+
+  condition = vectorize_strip(for_expr->data.for_loop.expr2, 0);
+  if (NODE_BINARY_OPERATION != condition->kind || OP_LESS != condition->data.binary_operation.operation) {
+    return 0;
+  }
+  loop->index = condition->data.binary_operation.left_operand;
+  loop->bound = condition->data.binary_operation.right_operand;
+  if (!vectorize_is_int(loop->index) || !vectorize_is_invariant(loop->bound, loop->index) ||
+      (NODE_IDENTIFIER == loop->bound->kind && !vectorize_is_int(loop->bound))) {
+    return 0;
+  }
+  if (!vectorize_is_increment(for_expr->data.for_loop.expr3, loop->index)) {
+    return 0;
+  }
+
+  assignment = vectorize_body(statement->data.while_loop.statement);
+  if (NULL == assignment) {
+    return 0;
+  }
+  loop->destination = vectorize_element(assignment->data.binary_operation.left_operand, loop->index);
+  return NULL != loop->destination && vectorize_value(assignment->data.binary_operation.right_operand, loop);
+}
@@ -0,0 +1,29 @@
+#ifndef _VECTORIZE_H
+#define _VECTORIZE_H
+
+struct node;
+
+/* Bytes handled by one pass of the word loop */
+#define VECTORIZE_WIDTH  4
+
+/* A for loop that maps one char array onto another, or fills one */
+struct vectorize_loop {
+  /* The int counting up through the arrays, and what it stops short of: a
+   * number or an int variable */
+  struct node *index;
+  struct node *bound;
+  /* The char arrays written and read; source is NULL for a fill */
+  struct node *destination;
+  struct node *source;
+  /* OP_PLUS, OP_MINUS, OP_CARET, OP_AMPERSAND or OP_VBAR with the constant,
+   * or -1 for a copy (or a fill, which stores the constant itself) */
+  int operation;
+  /* A number or an int variable, or NULL for a copy */
+  struct node *constant;
+};
+
+int vectorize_loop(struct node *statement, struct vectorize_loop *loop);
+
+extern int vectorize_enabled;
+
+#endif
@@ -0,0 +1,1660 @@
+/*
+ * x86.c
+ *
+ * The x86-64 back end, for -s x86-64: translates the IR into assembly for
+ * the GNU assembler (AT&T syntax) that gcc links into a program for the host,
+ * calling through the System V ABI.  Functions take their arguments in %edi,
+ * %esi, %edx and %ecx and return in %eax, and keep %rbx, %rbp and %r12-%r15
+ * as they found them, so a call to a function the program does not define
+ * goes to the C library.
+ *
+ * The IR is 32 bits wide: pointers are words, kept in the frame and in
+ * temporaries like any other int.  So the program is linked with -no-pie,
+ * which puts every label below 4GB, and the frames the IR lays out are taken
+ * from a stack of their own in .bss, which is too.  %rbp points at the frame,
+ * as $fp does on MIPS, and the stack %rsp points at only holds return
+ * addresses, saved registers and spilled temporaries.  Every temporary is
+ * kept zero-extended in its register, so a register that holds an address
+ * can be used as a base as it stands.
+ *
+ * Temporaries are given registers by linear scan over live intervals, which
+ * come from liveness over the control flow graph.  A temporary live across a
+ * call can only go in a register the callee saves; when none is free the one
+ * that stays live longest goes to a slot on the stack instead.  %eax, %ecx,
+ * %edx and %r11 are never given out: they are for the division, shifts,
+ * results, and the operations whose operands are both in memory.
+ *
+ * main is emitted with the program: it sets %rbp to the top of the frame
+ * stack and calls the program's main.  x86_generate_runtime adds the
+ * functions behind the built-ins, for when they are not bound some other way
+ * (see jit.c): print_number and print_string go to printf, and a read_int
+ * the program declares but does not define reads a number with scanf.  The
+ * program's own labels all become local labels, starting .L, so none of them
+ * clashes with the C library.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "ir.h"
+#include "cfg.h"
+#include "literal.h"
+#include "x86.h"
+
+int x86_num_errors;
+
+/* The most arguments a call passes, all in registers */
+#define X86_MAX_ARGUMENTS 4
+
+/* Registers a temporary may be given, in order of preference: those a call
+ * changes first, as they cost nothing to use, then those a callee saves */
+static int x86_allocatable[] = {
+  X86_REGISTER_RSI, X86_REGISTER_RDI, X86_REGISTER_R8, X86_REGISTER_R9, X86_REGISTER_R10,
+  X86_REGISTER_RBX, X86_REGISTER_R12, X86_REGISTER_R13, X86_REGISTER_R14, X86_REGISTER_R15
+};
+#define X86_NUM_ALLOCATABLE ((int)(sizeof(x86_allocatable) / sizeof(x86_allocatable[0])))
+
+#define X86_BIT(reg) (1u << (reg))
+#define X86_CALLEE_SAVED (X86_BIT(X86_REGISTER_RBX) | X86_BIT(X86_REGISTER_R12) | X86_BIT(X86_REGISTER_R13) \
+    | X86_BIT(X86_REGISTER_R14) | X86_BIT(X86_REGISTER_R15))
+
+static int x86_argument_registers[X86_MAX_ARGUMENTS] = {
+  X86_REGISTER_RDI, X86_REGISTER_RSI, X86_REGISTER_RDX, X86_REGISTER_RCX
+};
+
+#define X86_NUMBER_FORMAT_LABEL  ".Lrt.number_format"
+#define X86_STRING_FORMAT_LABEL  ".Lrt.string_format"
+
+/* An IR instruction with its temporaries numbered for the register allocator,
+ * the function's temporaries from 0 */
+struct x86_node {
+  struct ir_instruction *instruction;
+  /* Each operand's virtual register, or -1 */
+  int vregs[3];
+  int def;
+  int uses[3 + X86_MAX_ARGUMENTS];
+  int num_uses;
+  /* For a call, what IR_PARAMETER put in each argument register */
+  int arguments[X86_MAX_ARGUMENTS];
+  int num_arguments;
+  /* Set if it calls something that may change the registers a callee need not save */
+  int clobbers;
+};
+
+struct x86_function {
+  struct cfg *graph;
+  int frame_size;
+  int num_params;
+  int first_temporary;
+  int num_temporaries;
+  /* For a temporary that only holds a place in the frame for one load or
+   * store to use, its offset from %rbp; INT_MIN for the rest */
+  int *frame_address;
+  int num_vregs;
+  struct x86_node *nodes;
+  int num_nodes;
+  /* The nodes of each block, by block id */
+  int *block_first;
+  int *block_last;
+  /* Live intervals, in half-steps: a node reads at 2n and writes at 2n + 1 */
+  int *start;
+  int *end;
+  unsigned char *crosses_call;
+  /* The register of each virtual register, or -1 and its slot below */
+  int *location;
+  int *slot;
+  int num_slots;
+  /* The callee-saved registers it uses, and the bytes under them on the stack */
+  unsigned int saved;
+  int stack_size;
+};
+
+static struct x86_function *x86_functions;
+static int x86_num_functions;
+/* Set once something calls a read_int the program does not define */
+static int x86_read_int_called;
+
+/* The string literals, laid out by literal_layout */
+static char *x86_strings;
+static int x86_strings_size;
+
+static char *x86_register_names[4][X86_NUM_REGISTERS] = {
+  {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+   "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+  {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+   "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"},
+  {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+   "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+  {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+   "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"}
+};
+
+/****************************
+ * X86 INSTRUCTION LIST     *
+ ****************************/
+
+static struct x86_operand x86_register(int reg, int width) {
+  struct x86_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = X86_OPERAND_REGISTER;
+  operand.reg = reg;
+  operand.width = width;
+  operand.index = -1;
+  return operand;
+}
+
+static struct x86_operand x86_immediate(char *label, long number) {
+  struct x86_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = X86_OPERAND_IMMEDIATE;
+  operand.reg = -1;
+  operand.label = label;
+  operand.number = number;
+  operand.index = -1;
+  return operand;
+}
+
+static struct x86_operand x86_memory(int base, long offset) {
+  struct x86_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = X86_OPERAND_MEMORY;
+  operand.reg = base;
+  operand.number = offset;
+  operand.index = -1;
+  return operand;
+}
+
+static struct x86_operand x86_target(char *label) {
+  struct x86_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = X86_OPERAND_TARGET;
+  operand.reg = -1;
+  operand.label = label;
+  operand.index = -1;
+  return operand;
+}
+
+/* x86_resize - the same register, some other number of bytes of it */
+static struct x86_operand x86_resize(struct x86_operand operand, int width) {
+  if (operand.kind == X86_OPERAND_REGISTER) {
+    operand.width = width;
+  }
+  return operand;
+}
+
+/* x86_same - whether two operands are the same register or the same place in memory */
+static int x86_same(struct x86_operand *left, struct x86_operand *right) {
+  if (left->kind != right->kind || left->reg != right->reg) {
+    return 0;
+  }
+  if (left->kind == X86_OPERAND_REGISTER) {
+    return 1;
+  }
+  return left->kind == X86_OPERAND_MEMORY && left->number == right->number && left->index == right->index
+      && NULL == left->label && NULL == right->label;
+}
+
+/* x86_emit - appends an operation to a section
+ *
+ * Parameters:
+ *   code - x86_section - section to append to
+ *   opcode - char * - the mnemonic
+ *   num_operands - int - how many x86_operand arguments follow, source first
+ *
+ * Returns the new instruction
+ */
+static struct x86_instruction *x86_emit(struct x86_section *code, char *opcode, int num_operands, ...) {
+  struct x86_instruction *instruction = calloc(1, sizeof(struct x86_instruction));
+  va_list operands;
+  int i;
+
+  assert(NULL != instruction);
+  assert(num_operands >= 0 && num_operands <= 2);
+  instruction->kind = X86_INSTRUCTION_OPERATION;
+  instruction->opcode = opcode;
+  instruction->num_operands = num_operands;
+
+  va_start(operands, num_operands);
+  for (i = 0; i < num_operands; i++) {
+    instruction->operands[i] = va_arg(operands, struct x86_operand);
+  }
+  va_end(operands);
+
+  if (NULL == code->last) {
+    code->first = instruction;
+  } else {
+    code->last->next = instruction;
+  }
+  code->last = instruction;
+  return instruction;
+}
+
+static void x86_emit_label(struct x86_section *code, char *label) {
+  struct x86_instruction *instruction = x86_emit(code, NULL, 0);
+  instruction->kind = X86_INSTRUCTION_LABEL;
+  instruction->operands[0] = x86_target(label);
+}
+
+/* x86_local - the local label the program's label becomes */
+static char *x86_local(char *label) {
+  char *local = malloc(strlen(label) + 3);
+  assert(NULL != local);
+  sprintf(local, ".L%s", label);
+  return local;
+}
+
+/****************************
+ * FUNCTIONS                *
+ ****************************/
+
+/* x86_writes - whether an instruction writes its first operand */
+static int x86_writes(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+    case IR_PRINT_NUMBER:
+    case IR_PRINT_STRING:
+    case IR_RETURN:
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+    case IR_GOTO_TABLE:
+    case IR_SEQUENCE_PT:
+      return 0;
+    default:
+      return instruction->operands[0].kind == OPERAND_TEMPORARY;
+  }
+}
+
+/* x86_find_function - looks up a function the program defines, or NULL */
+static struct x86_function *x86_find_function(char *name) {
+  int i;
+
+  for (i = 0; i < x86_num_functions; i++) {
+    if (!strcmp(x86_functions[i].graph->name, name)) {
+      return &x86_functions[i];
+    }
+  }
+  return NULL;
+}
+
+/* x86_callee - the label a call goes to: the function, if the program
+ *   defines it, else the runtime's read_int, else the C library's function
+ */
+static char *x86_callee(char *name) {
+  if (NULL != x86_find_function(name)) {
+    return x86_local(name);
+  }
+  if (!strcmp(name, "read_int")) {
+    x86_read_int_called = 1;
+    return x86_local(name);
+  }
+  return name;
+}
+
+/* x86_measure - works out the range of temporaries a function uses */
+static void x86_measure(struct x86_function *function) {
+  struct ir_instruction *iter;
+  int low = -1, high = -1, i;
+
+  for (iter = function->graph->begin; iter != function->graph->end->next; iter = iter->next) {
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      if (low < 0 || iter->operands[i].data.temporary < low) {
+        low = iter->operands[i].data.temporary;
+      }
+      if (iter->operands[i].data.temporary > high) {
+        high = iter->operands[i].data.temporary;
+      }
+    }
+  }
+  function->first_temporary = low < 0 ? 0 : low;
+  function->num_temporaries = low < 0 ? 0 : high - low + 1;
+  function->num_vregs = function->num_temporaries;
+}
+
+/* x86_vreg - the virtual register of an operand, or -1 if it is no temporary */
+static int x86_vreg(struct x86_function *function, struct ir_operand *operand) {
+  int slot;
+
+  if (operand->kind != OPERAND_TEMPORARY) {
+    return -1;
+  }
+  slot = operand->data.temporary - function->first_temporary;
+  assert(slot >= 0 && slot < function->num_temporaries);
+  return slot;
+}
+
+/* x86_add_use - notes that a node reads a virtual register */
+static void x86_add_use(struct x86_node *node, int vreg) {
+  if (vreg >= 0) {
+    assert(node->num_uses < 3 + X86_MAX_ARGUMENTS);
+    node->uses[node->num_uses++] = vreg;
+  }
+}
+
+/* x86_reads - whether an instruction reads one of its operands */
+static int x86_reads(struct ir_instruction *instruction, int i) {
+  if (instruction->kind == IR_SEQUENCE_PT || instruction->operands[i].kind != OPERAND_TEMPORARY) {
+    return 0;
+  }
+  return i > 0 || !x86_writes(instruction) || instruction->kind == IR_MOVE_IF_NOT_ZERO
+      || instruction->kind == IR_MOVE_IF_ZERO;
+}
+
+/* x86_is_memory_access - whether an instruction is a load or a store */
+static int x86_is_memory_access(struct ir_instruction *instruction) {
+  switch (instruction->kind) {
+    case IR_LOAD_BYTE:
+    case IR_LOAD_HALF_WORD:
+    case IR_LOAD_WORD:
+    case IR_LOAD_BYTE_U:
+    case IR_LOAD_HALF_WORD_U:
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* x86_find_frame_addresses - finds the temporaries that need no register
+ *   because all they do is take the address of a place in the frame for one
+ *   load or store, which can then reach it from %rbp itself
+ *
+ * Returns how many instructions the function has
+ */
+static int x86_find_frame_addresses(struct x86_function *function) {
+  struct ir_instruction *iter;
+  int n = function->num_temporaries + 1, count = 0, i, slot;
+  int *writes = calloc(n, sizeof(int)), *reads = calloc(n, sizeof(int)), *addresses = calloc(n, sizeof(int));
+  struct ir_instruction **definitions = calloc(n, sizeof(struct ir_instruction *));
+
+  function->frame_address = malloc(sizeof(int) * n);
+  assert(NULL != writes && NULL != reads && NULL != addresses && NULL != definitions
+         && NULL != function->frame_address);
+  for (iter = function->graph->begin; iter != function->graph->end->next; iter = iter->next) {
+    count++;
+    if (iter->kind == IR_SEQUENCE_PT) {
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      if (iter->operands[i].kind != OPERAND_TEMPORARY) {
+        continue;
+      }
+      slot = iter->operands[i].data.temporary - function->first_temporary;
+      if (x86_reads(iter, i)) {
+        reads[slot]++;
+        addresses[slot] += 1 == i && x86_is_memory_access(iter);
+      }
+    }
+    if (x86_writes(iter)) {
+      slot = iter->operands[0].data.temporary - function->first_temporary;
+      writes[slot]++;
+      definitions[slot] = iter;
+    }
+  }
+
+  for (slot = 0; slot < n; slot++) {
+    function->frame_address[slot] = INT_MIN;
+    if (1 == writes[slot] && 1 == reads[slot] && 1 == addresses[slot] && definitions[slot]->kind == IR_ADDRESS_OF
+        && definitions[slot]->operands[1].kind == OPERAND_LVALUE) {
+      function->frame_address[slot] = definitions[slot]->operands[1].data.offset;
+    }
+  }
+
+  free(writes);
+  free(reads);
+  free(addresses);
+  free(definitions);
+  return count;
+}
+
+/* x86_build_nodes - numbers the temporaries of a function's instructions,
+ *   block by block
+ */
+static void x86_build_nodes(struct x86_function *function) {
+  struct cfg_block *block;
+  struct ir_instruction *iter;
+  struct x86_node *node;
+  int count, pending[X86_MAX_ARGUMENTS], num_pending = 0, i;
+
+  count = x86_find_frame_addresses(function);
+
+  function->nodes = calloc(count, sizeof(struct x86_node));
+  function->block_first = malloc(sizeof(int) * function->graph->num_blocks);
+  function->block_last = malloc(sizeof(int) * function->graph->num_blocks);
+  assert(NULL != function->nodes && NULL != function->block_first && NULL != function->block_last);
+
+  for (block = function->graph->entry; NULL != block; block = block->next) {
+    function->block_first[block->id] = function->num_nodes;
+    for (iter = block->first; ; iter = iter->next) {
+      node = &function->nodes[function->num_nodes++];
+      node->instruction = iter;
+      node->def = -1;
+      for (i = 0; i < 3; i++) {
+        node->vregs[i] = iter->kind == IR_SEQUENCE_PT ? -1 : x86_vreg(function, &iter->operands[i]);
+        // A place in the frame used once is reached from %rbp where it is used
+        if (node->vregs[i] >= 0 && node->vregs[i] < function->num_temporaries
+            && INT_MIN != function->frame_address[node->vregs[i]]) {
+          node->vregs[i] = -1;
+        }
+      }
+
+      if (x86_writes(iter)) {
+        node->def = node->vregs[0];
+      }
+      for (i = 0; i < 3; i++) {
+        if (x86_reads(iter, i)) {
+          x86_add_use(node, node->vregs[i]);
+        }
+      }
+
+      switch (iter->kind) {
+        case IR_PARAMETER:
+          i = (int)iter->operands[0].data.number;
+          if (i < 0 || i >= X86_MAX_ARGUMENTS || node->vregs[1] < 0) {
+            printf("ERROR - x86-64: %s passes more than %d arguments\n", function->graph->name, X86_MAX_ARGUMENTS);
+            x86_num_errors++;
+            break;
+          }
+          pending[i] = node->vregs[1];
+          if (i >= num_pending) {
+            num_pending = i + 1;
+          }
+          break;
+
+        case IR_FUNCTION_CALL:
+        case IR_TAIL_CALL:
+          // The arguments are moved into their registers at the call
+          for (i = 0; i < num_pending; i++) {
+            node->arguments[i] = pending[i];
+            x86_add_use(node, pending[i]);
+          }
+          node->num_arguments = num_pending;
+          num_pending = 0;
+          node->clobbers = iter->kind == IR_FUNCTION_CALL;
+          break;
+
+        case IR_PRINT_NUMBER:
+        case IR_PRINT_STRING:
+          node->clobbers = 1;
+          break;
+      }
+
+      if (iter == block->last) {
+        break;
+      }
+    }
+    function->block_last[block->id] = function->num_nodes - 1;
+  }
+}
+
+/****************************
+ * REGISTER ALLOCATION      *
+ ****************************/
+
+#define X86_WORDS(bits) (((bits) + 63) / 64)
+
+static int x86_test_bit(uint64_t *set, int bit) {
+  return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void x86_set_bit(uint64_t *set, int bit) {
+  set[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+static void x86_clear_bit(uint64_t *set, int bit) {
+  set[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+/* x86_extend - stretches a live interval over a half-step */
+static void x86_extend(struct x86_function *function, int vreg, int step) {
+  if (step < function->start[vreg]) {
+    function->start[vreg] = step;
+  }
+  if (step > function->end[vreg]) {
+    function->end[vreg] = step;
+  }
+}
+
+/* x86_compute_intervals - finds the virtual registers live into and out of
+ *   each block, then walks each block backwards to stretch every register's
+ *   interval over the steps it is live at, and note which of them a call
+ *   would otherwise change
+ */
+static void x86_compute_intervals(struct x86_function *function) {
+  int words = X86_WORDS(function->num_vregs), blocks = function->graph->num_blocks;
+  uint64_t *gen = calloc((size_t)blocks * words, sizeof(uint64_t));
+  uint64_t *kill = calloc((size_t)blocks * words, sizeof(uint64_t));
+  uint64_t *live_in = calloc((size_t)blocks * words, sizeof(uint64_t));
+  uint64_t *live_out = calloc((size_t)blocks * words, sizeof(uint64_t));
+  uint64_t *live = calloc(words, sizeof(uint64_t));
+  struct cfg_block *block, **order = malloc(sizeof(struct cfg_block *) * blocks);
+  struct cfg_edge *edge;
+  int changed = 1, b, n, i, v;
+
+  assert(NULL != gen && NULL != kill && NULL != live_in && NULL != live_out && NULL != live && NULL != order);
+  function->start = malloc(sizeof(int) * function->num_vregs);
+  function->end = malloc(sizeof(int) * function->num_vregs);
+  function->crosses_call = calloc(function->num_vregs, 1);
+  assert(NULL != function->start && NULL != function->end && NULL != function->crosses_call);
+  for (v = 0; v < function->num_vregs; v++) {
+    function->start[v] = INT_MAX;
+    function->end[v] = -1;
+  }
+
+  for (block = function->graph->entry; NULL != block; block = block->next) {
+    uint64_t *block_gen = gen + (size_t)block->id * words, *block_kill = kill + (size_t)block->id * words;
+    order[block->id] = block;
+    for (n = function->block_first[block->id]; n <= function->block_last[block->id]; n++) {
+      struct x86_node *node = &function->nodes[n];
+      for (i = 0; i < node->num_uses; i++) {
+        if (!x86_test_bit(block_kill, node->uses[i])) {
+          x86_set_bit(block_gen, node->uses[i]);
+        }
+      }
+      if (node->def >= 0) {
+        x86_set_bit(block_kill, node->def);
+      }
+    }
+  }
+
+  while (changed) {
+    changed = 0;
+    for (b = blocks - 1; b >= 0; b--) {
+      uint64_t *out = live_out + (size_t)b * words, *in = live_in + (size_t)b * words;
+      for (edge = order[b]->successors; NULL != edge; edge = edge->next) {
+        for (i = 0; i < words; i++) {
+          out[i] |= live_in[(size_t)edge->block->id * words + i];
+        }
+      }
+      for (i = 0; i < words; i++) {
+        uint64_t word = gen[(size_t)b * words + i] | (out[i] & ~kill[(size_t)b * words + i]);
+        if (word != in[i]) {
+          in[i] = word;
+          changed = 1;
+        }
+      }
+    }
+  }
+
+  for (b = 0; b < blocks; b++) {
+    memcpy(live, live_out + (size_t)b * words, sizeof(uint64_t) * words);
+    for (n = function->block_last[b]; n >= function->block_first[b]; n--) {
+      struct x86_node *node = &function->nodes[n];
+      for (v = 0; v < function->num_vregs; v++) {
+        if (x86_test_bit(live, v)) {
+          x86_extend(function, v, 2 * n + 1);
+          function->crosses_call[v] |= node->clobbers;
+        }
+      }
+      if (node->def >= 0) {
+        x86_extend(function, node->def, 2 * n + 1);
+        x86_clear_bit(live, node->def);
+      }
+      for (i = 0; i < node->num_uses; i++) {
+        x86_set_bit(live, node->uses[i]);
+      }
+      for (v = 0; v < function->num_vregs; v++) {
+        if (x86_test_bit(live, v)) {
+          x86_extend(function, v, 2 * n);
+        }
+      }
+    }
+  }
+
+  free(gen);
+  free(kill);
+  free(live_in);
+  free(live_out);
+  free(live);
+  free(order);
+}
+
+static struct x86_function *x86_sorting;
+
+static int x86_compare_starts(const void *left, const void *right) {
+  int a = *(const int *)left, b = *(const int *)right;
+
+  if (x86_sorting->start[a] != x86_sorting->start[b]) {
+    return x86_sorting->start[a] < x86_sorting->start[b] ? -1 : 1;
+  }
+  return a - b;
+}
+
+/* x86_spill - gives a virtual register a slot on the stack instead of a register */
+static void x86_spill(struct x86_function *function, int vreg) {
+  function->location[vreg] = -1;
+  function->slot[vreg] = 4 * function->num_slots++;
+}
+
+/* x86_allocate_registers - linear scan: goes through the intervals in order
+ *   of where they start, and gives each a register that is free over all of
+ *   it, or when there is none, takes the register of whichever interval ends
+ *   last and puts that one on the stack
+ */
+static void x86_allocate_registers(struct x86_function *function) {
+  int *order = malloc(sizeof(int) * function->num_vregs);
+  int *active = malloc(sizeof(int) * (X86_NUM_ALLOCATABLE + 1));
+  int num_order = 0, num_active = 0, i, j, v, reg, victim, saved = 0;
+  unsigned int free_registers = 0, allowed;
+
+  function->location = malloc(sizeof(int) * function->num_vregs);
+  function->slot = malloc(sizeof(int) * function->num_vregs);
+  assert(NULL != order && NULL != active && NULL != function->location && NULL != function->slot);
+  for (i = 0; i < X86_NUM_ALLOCATABLE; i++) {
+    free_registers |= X86_BIT(x86_allocatable[i]);
+  }
+  for (v = 0; v < function->num_vregs; v++) {
+    function->location[v] = -1;
+    function->slot[v] = 0;
+    if (function->end[v] >= 0) {
+      order[num_order++] = v;
+    }
+  }
+  x86_sorting = function;
+  qsort(order, num_order, sizeof(int), x86_compare_starts);
+
+  for (i = 0; i < num_order; i++) {
+    v = order[i];
+    for (j = 0; j < num_active; ) {
+      if (function->end[active[j]] < function->start[v]) {
+        free_registers |= X86_BIT(function->location[active[j]]);
+        active[j] = active[--num_active];
+      } else {
+        j++;
+      }
+    }
+
+    allowed = function->crosses_call[v] ? X86_CALLEE_SAVED : ~0u;
+    reg = -1;
+    for (j = 0; j < X86_NUM_ALLOCATABLE; j++) {
+      if (free_registers & allowed & X86_BIT(x86_allocatable[j])) {
+        reg = x86_allocatable[j];
+        break;
+      }
+    }
+
+    if (reg < 0) {
+      victim = -1;
+      for (j = 0; j < num_active; j++) {
+        if ((allowed & X86_BIT(function->location[active[j]]))
+            && (victim < 0 || function->end[active[j]] > function->end[active[victim]])) {
+          victim = j;
+        }
+      }
+      if (victim < 0 || function->end[active[victim]] <= function->end[v]) {
+        x86_spill(function, v);
+        continue;
+      }
+      reg = function->location[active[victim]];
+      x86_spill(function, active[victim]);
+      active[victim] = active[--num_active];
+    } else {
+      free_registers &= ~X86_BIT(reg);
+    }
+
+    function->location[v] = reg;
+    function->saved |= X86_BIT(reg) & X86_CALLEE_SAVED;
+    active[num_active++] = v;
+  }
+
+  // The slots and whatever keeps calls 16-byte aligned go under the saved registers
+  for (reg = 0; reg < X86_NUM_REGISTERS; reg++) {
+    saved += (function->saved >> reg) & 1;
+  }
+  function->stack_size = (4 * function->num_slots + 15) & ~15;
+  if (saved % 2) {
+    function->stack_size += 8;
+  }
+
+  free(order);
+  free(active);
+}
+
+/****************************
+ * CODE GENERATION          *
+ ****************************/
+
+/* x86_place - where a virtual register is kept */
+static struct x86_operand x86_place(struct x86_function *function, int vreg) {
+  assert(vreg >= 0 && vreg < function->num_vregs);
+  if (function->location[vreg] >= 0) {
+    return x86_register(function->location[vreg], 4);
+  }
+  return x86_memory(X86_REGISTER_RSP, function->slot[vreg]);
+}
+
+/* x86_operand_of - an operand of a node's instruction: a temporary where it is
+ *   kept, a constant, or a place in the frame
+ */
+static struct x86_operand x86_operand_of(struct x86_function *function, struct x86_node *node, int i) {
+  struct ir_operand *operand = &node->instruction->operands[i];
+
+  switch (operand->kind) {
+    case OPERAND_TEMPORARY:
+      return x86_place(function, node->vregs[i]);
+    case OPERAND_LVALUE:
+      return x86_memory(X86_REGISTER_RBP, operand->data.offset);
+    default:
+      assert(operand->kind == OPERAND_NUMBER);
+      return x86_immediate(NULL, (int32_t)operand->data.number);
+  }
+}
+
+static struct x86_operand x86_scratch(void) {
+  return x86_register(X86_REGISTER_RAX, 4);
+}
+
+/* x86_move - copies a word, through %eax when both sides are in memory
+ *
+ * Parameters:
+ *   code - x86_section - section to append to
+ *   destination - x86_operand - a register or memory
+ *   source - x86_operand - anything
+ */
+static void x86_move(struct x86_section *code, struct x86_operand destination, struct x86_operand source) {
+  if (x86_same(&destination, &source)) {
+    return;
+  }
+  if (destination.kind == X86_OPERAND_MEMORY && source.kind == X86_OPERAND_MEMORY) {
+    x86_emit(code, "movl", 2, source, x86_scratch());
+    source = x86_scratch();
+  }
+  x86_emit(code, "movl", 2, source, destination);
+}
+
+/* x86_in_register - an operand as it is if it is in a register, or else
+ *   loaded into a scratch register
+ */
+static struct x86_operand x86_in_register(struct x86_section *code, struct x86_operand operand, int scratch) {
+  if (operand.kind == X86_OPERAND_REGISTER) {
+    return operand;
+  }
+  x86_move(code, x86_register(scratch, 4), operand);
+  return x86_register(scratch, 4);
+}
+
+/* x86_address - the memory a load or store reaches, at an offset from %rbp or
+ *   through a temporary, which is loaded into %r11 if it is on the stack
+ */
+static struct x86_operand x86_address(struct x86_section *code, struct x86_function *function,
+                                      struct x86_node *node) {
+  struct ir_operand *operand = &node->instruction->operands[1];
+  struct x86_operand address;
+
+  if (operand->kind == OPERAND_TEMPORARY && node->vregs[1] < 0) {
+    return x86_memory(X86_REGISTER_RBP, function->frame_address[operand->data.temporary - function->first_temporary]);
+  }
+  address = x86_operand_of(function, node, 1);
+  if (operand->kind == OPERAND_LVALUE) {
+    return address;
+  }
+  address = x86_in_register(code, address, X86_REGISTER_R11);
+  return x86_memory(address.reg, 0);
+}
+
+/* x86_generate_binary - generates "result = left op right" as a two-operand
+ *   x86 instruction: in the result's register if it has one and that does not
+ *   hold the right operand, else in %eax
+ *
+ * Parameters:
+ *   code - x86_section - section to append to
+ *   opcode - char * - the operation
+ *   commutative - int - "true" if the operands can be swapped
+ *   result, left, right - x86_operand - the operands
+ */
+static void x86_generate_binary(struct x86_section *code, char *opcode, int commutative, struct x86_operand result,
+                                struct x86_operand left, struct x86_operand right) {
+  if (result.kind == X86_OPERAND_REGISTER) {
+    if (!x86_same(&result, &right) || x86_same(&result, &left)) {
+      x86_move(code, result, left);
+      x86_emit(code, opcode, 2, right, result);
+      return;
+    }
+    if (commutative) {
+      x86_emit(code, opcode, 2, left, result);
+      return;
+    }
+  }
+  x86_move(code, x86_scratch(), left);
+  x86_emit(code, opcode, 2, right, x86_scratch());
+  x86_move(code, result, x86_scratch());
+}
+
+/* x86_generate_unary - generates "result = op left" */
+static void x86_generate_unary(struct x86_section *code, char *opcode, struct x86_operand result,
+                               struct x86_operand left) {
+  struct x86_operand target = result.kind == X86_OPERAND_REGISTER ? result : x86_scratch();
+
+  x86_move(code, target, left);
+  x86_emit(code, opcode, 1, target);
+  x86_move(code, result, target);
+}
+
+/* x86_compare - sets the flags from "left - right" */
+static void x86_compare(struct x86_section *code, struct x86_operand left, struct x86_operand right) {
+  if (left.kind == X86_OPERAND_IMMEDIATE || (left.kind == X86_OPERAND_MEMORY && right.kind == X86_OPERAND_MEMORY)) {
+    x86_move(code, x86_scratch(), left);
+    left = x86_scratch();
+  }
+  if (left.kind == X86_OPERAND_REGISTER && right.kind == X86_OPERAND_IMMEDIATE && NULL == right.label
+      && 0 == right.number) {
+    x86_emit(code, "testl", 2, left, left);
+  } else {
+    x86_emit(code, "cmpl", 2, right, left);
+  }
+}
+
+/* x86_generate_set - generates "result = left relation right" as 1 or 0 */
+static void x86_generate_set(struct x86_section *code, char *opcode, struct x86_operand result,
+                             struct x86_operand left, struct x86_operand right) {
+  x86_compare(code, left, right);
+  x86_emit(code, opcode, 1, x86_register(X86_REGISTER_RAX, 1));
+  if (result.kind == X86_OPERAND_REGISTER) {
+    x86_emit(code, "movzbl", 2, x86_register(X86_REGISTER_RAX, 1), result);
+  } else {
+    x86_emit(code, "movzbl", 2, x86_register(X86_REGISTER_RAX, 1), x86_scratch());
+    x86_move(code, result, x86_scratch());
+  }
+}
+
+/* x86_generate_shift - generates a shift, by a constant or by %cl */
+static void x86_generate_shift(struct x86_section *code, char *opcode, struct x86_operand result,
+                               struct x86_operand left, struct x86_operand right) {
+  if (right.kind == X86_OPERAND_IMMEDIATE) {
+    right.number &= 31;
+    x86_generate_binary(code, opcode, 0, result, left, right);
+    return;
+  }
+  x86_move(code, x86_register(X86_REGISTER_RCX, 4), right);
+  x86_move(code, x86_scratch(), left);
+  x86_emit(code, opcode, 2, x86_register(X86_REGISTER_RCX, 1), x86_scratch());
+  x86_move(code, result, x86_scratch());
+}
+
+/* x86_generate_divide - generates a division or the high word of a product,
+ *   which work on %edx:%eax
+ *
+ * Parameters:
+ *   code - x86_section - section to append to
+ *   kind - int - the IR kind
+ *   result, left, right - x86_operand - the operands
+ */
+static void x86_generate_divide(struct x86_section *code, int kind, struct x86_operand result,
+                                struct x86_operand left, struct x86_operand right) {
+  int high = kind == IR_MOD || kind == IR_MULTIPLY_HIGH || kind == IR_MULTIPLY_HIGH_U;
+
+  if (right.kind == X86_OPERAND_IMMEDIATE) {
+    x86_move(code, x86_register(X86_REGISTER_RCX, 4), right);
+    right = x86_register(X86_REGISTER_RCX, 4);
+  }
+  x86_move(code, x86_scratch(), left);
+  switch (kind) {
+    case IR_MULTIPLY_HIGH:
+      x86_emit(code, "imull", 1, right);
+      break;
+    case IR_MULTIPLY_HIGH_U:
+      x86_emit(code, "mull", 1, right);
+      break;
+    case IR_DIVU:
+      x86_emit(code, "xorl", 2, x86_register(X86_REGISTER_RDX, 4), x86_register(X86_REGISTER_RDX, 4));
+      x86_emit(code, "divl", 1, right);
+      break;
+    default:
+      x86_emit(code, "cltd", 0);
+      x86_emit(code, "idivl", 1, right);
+      break;
+  }
+  x86_move(code, result, x86_register(high ? X86_REGISTER_RDX : X86_REGISTER_RAX, 4));
+}
+
+/* x86_generate_conversion - generates a change of width.  Values are kept
+ *   sign-extended to a word, so only narrowing does anything.
+ */
+static void x86_generate_conversion(struct x86_section *code, int kind, struct x86_operand result,
+                                    struct x86_operand left) {
+  struct x86_operand target = result.kind == X86_OPERAND_REGISTER ? result : x86_scratch();
+  char *opcode;
+  int width;
+
+  switch (kind) {
+    case IR_WORD_TO_BYTE:
+    case IR_HALF_WORD_TO_BYTE:
+      opcode = "movsbl";
+      width = 1;
+      break;
+    case IR_WORD_TO_HALF_WORD:
+      opcode = "movswl";
+      width = 2;
+      break;
+    default:
+      x86_move(code, result, left);
+      return;
+  }
+  // A word in memory starts with its low bytes
+  if (left.kind == X86_OPERAND_IMMEDIATE) {
+    left = x86_in_register(code, left, X86_REGISTER_RAX);
+  }
+  x86_emit(code, opcode, 2, x86_resize(left, width), target);
+  x86_move(code, result, target);
+}
+
+/* x86_generate_load - generates a load of a word, or of a half word or byte
+ *   extended to a word
+ */
+static void x86_generate_load(struct x86_section *code, struct x86_function *function, struct x86_node *node) {
+  struct x86_operand result = x86_operand_of(function, node, 0);
+  struct x86_operand target = result.kind == X86_OPERAND_REGISTER ? result : x86_scratch();
+  char *opcode;
+
+  switch (node->instruction->kind) {
+    case IR_LOAD_BYTE:
+      opcode = "movsbl";
+      break;
+    case IR_LOAD_BYTE_U:
+      opcode = "movzbl";
+      break;
+    case IR_LOAD_HALF_WORD:
+      opcode = "movswl";
+      break;
+    case IR_LOAD_HALF_WORD_U:
+      opcode = "movzwl";
+      break;
+    default:
+      opcode = "movl";
+      break;
+  }
+  x86_emit(code, opcode, 2, x86_address(code, function, node), target);
+  x86_move(code, result, target);
+}
+
+/* x86_generate_store - generates a store of the low byte, half word or all
+ *   of a word
+ */
+static void x86_generate_store(struct x86_section *code, struct x86_function *function, struct x86_node *node) {
+  struct x86_operand address = x86_address(code, function, node);
+  struct x86_operand value = x86_in_register(code, x86_operand_of(function, node, 0), X86_REGISTER_RAX);
+
+  switch (node->instruction->kind) {
+    case IR_STORE_BYTE:
+      x86_emit(code, "movb", 2, x86_resize(value, 1), address);
+      break;
+    case IR_STORE_HALF_WORD:
+      x86_emit(code, "movw", 2, x86_resize(value, 2), address);
+      break;
+    default:
+      x86_emit(code, "movl", 2, value, address);
+      break;
+  }
+}
+
+/* x86_generate_address - generates the address of a file-scope object, a
+ *   string literal or a place in the frame
+ */
+static void x86_generate_address(struct x86_section *code, struct x86_function *function, struct x86_node *node) {
+  struct ir_operand *operand = &node->instruction->operands[1];
+  struct x86_operand result = x86_operand_of(function, node, 0);
+  struct x86_operand target = result.kind == X86_OPERAND_REGISTER ? result : x86_scratch();
+  int offset;
+
+  if (operand->kind == OPERAND_LVALUE) {
+    x86_emit(code, "leal", 2, x86_memory(X86_REGISTER_RBP, operand->data.offset), target);
+    x86_move(code, result, target);
+    return;
+  }
+  offset = literal_offset(operand->data.label_name);
+  if (offset >= 0) {
+    x86_move(code, result, x86_immediate(X86_STRINGS_LABEL, offset));
+  } else {
+    x86_move(code, result, x86_immediate(x86_local(operand->data.label_name), 0));
+  }
+}
+
+/* x86_generate_conditional_move - generates a move of the second operand
+ *   into the first if the third is, or is not, zero
+ */
+static void x86_generate_conditional_move(struct x86_section *code, struct x86_function *function,
+                                          struct x86_node *node) {
+  struct x86_operand result = x86_operand_of(function, node, 0);
+  struct x86_operand source = x86_operand_of(function, node, 1);
+  struct x86_operand target = result.kind == X86_OPERAND_REGISTER ? result : x86_scratch();
+  char *opcode = node->instruction->kind == IR_MOVE_IF_NOT_ZERO ? "cmovnel" : "cmovel";
+
+  if (source.kind == X86_OPERAND_IMMEDIATE) {
+    source = x86_in_register(code, source, X86_REGISTER_RCX);
+  }
+  x86_move(code, target, result);
+  x86_compare(code, x86_in_register(code, x86_operand_of(function, node, 2), X86_REGISTER_RDX),
+              x86_immediate(NULL, 0));
+  x86_emit(code, opcode, 2, source, target);
+  x86_move(code, result, target);
+}
+
+/* x86_generate_arguments - moves what the IR_PARAMETERs of a call gave into
+ *   the argument registers.  %edi and %esi may hold temporaries that are
+ *   arguments themselves, so a move waits until nothing else still has to
+ *   read its destination, and a cycle is broken through %eax.
+ */
+static void x86_generate_arguments(struct x86_section *code, struct x86_function *function, struct x86_node *node) {
+  struct x86_operand sources[X86_MAX_ARGUMENTS];
+  int done[X86_MAX_ARGUMENTS], remaining = node->num_arguments, i, j, progress;
+
+  for (i = 0; i < node->num_arguments; i++) {
+    sources[i] = x86_place(function, node->arguments[i]);
+    done[i] = 0;
+  }
+  while (remaining > 0) {
+    progress = 0;
+    for (i = 0; i < node->num_arguments; i++) {
+      int blocked = 0;
+      if (done[i]) {
+        continue;
+      }
+      for (j = 0; j < node->num_arguments; j++) {
+        if (j != i && !done[j] && sources[j].kind == X86_OPERAND_REGISTER
+            && sources[j].reg == x86_argument_registers[i]) {
+          blocked = 1;
+        }
+      }
+      if (!blocked) {
+        x86_move(code, x86_register(x86_argument_registers[i], 4), sources[i]);
+        done[i] = 1;
+        remaining--;
+        progress = 1;
+      }
+    }
+    if (!progress) {
+      for (i = 0; done[i]; i++)
+        ;
+      x86_move(code, x86_scratch(), sources[i]);
+      sources[i] = x86_scratch();
+    }
+  }
+}
+
+/* x86_generate_epilogue - gives back the stack and the registers the function saved */
+static void x86_generate_epilogue(struct x86_section *code, struct x86_function *function) {
+  int i;
+
+  if (function->stack_size > 0) {
+    x86_emit(code, "addq", 2, x86_immediate(NULL, function->stack_size), x86_register(X86_REGISTER_RSP, 8));
+  }
+  for (i = X86_NUM_ALLOCATABLE - 1; i >= 0; i--) {
+    if (function->saved & X86_BIT(x86_allocatable[i])) {
+      x86_emit(code, "popq", 1, x86_register(x86_allocatable[i], 8));
+    }
+  }
+  x86_emit(code, "popq", 1, x86_register(X86_REGISTER_RBP, 8));
+}
+
+/* x86_generate_proc_begin - saves the registers the function uses that a
+ *   callee must save, makes room for its spilled temporaries, takes its frame
+ *   off the frame stack and puts the arguments in the first words of it
+ */
+static void x86_generate_proc_begin(struct x86_section *code, struct x86_function *function) {
+  int i;
+
+  x86_emit_label(code, x86_local(function->graph->name));
+  x86_emit(code, "pushq", 1, x86_register(X86_REGISTER_RBP, 8));
+  for (i = 0; i < X86_NUM_ALLOCATABLE; i++) {
+    if (function->saved & X86_BIT(x86_allocatable[i])) {
+      x86_emit(code, "pushq", 1, x86_register(x86_allocatable[i], 8));
+    }
+  }
+  if (function->stack_size > 0) {
+    x86_emit(code, "subq", 2, x86_immediate(NULL, function->stack_size), x86_register(X86_REGISTER_RSP, 8));
+  }
+  x86_emit(code, "subq", 2, x86_immediate(NULL, function->frame_size), x86_register(X86_REGISTER_RBP, 8));
+  for (i = 0; i < function->num_params && i < X86_MAX_ARGUMENTS; i++) {
+    x86_emit(code, "movl", 2, x86_register(x86_argument_registers[i], 4), x86_memory(X86_REGISTER_RBP, 4 * i));
+  }
+}
+
+/* x86_generate_call - generates a call, with the arguments in their registers */
+static void x86_generate_call(struct x86_section *code, struct x86_function *function, struct x86_node *node) {
+  char *callee = x86_callee(node->instruction->operands[0].data.label_name);
+
+  x86_generate_arguments(code, function, node);
+  if (node->instruction->kind == IR_TAIL_CALL) {
+    x86_generate_epilogue(code, function);
+    x86_emit(code, "jmp", 1, x86_target(callee));
+    return;
+  }
+  // No vector registers hold arguments, in case the C library's function takes a variable number
+  if ('.' != callee[0]) {
+    x86_emit(code, "xorl", 2, x86_scratch(), x86_scratch());
+  }
+  x86_emit(code, "call", 1, x86_target(callee));
+}
+
+/* x86_branch_opcode - the jump taken on a fused comparison */
+static char *x86_branch_opcode(int kind) {
+  switch (kind) {
+    case IR_GOTO_IF_EQUAL:
+      return "je";
+    case IR_GOTO_IF_NOT_EQUAL:
+      return "jne";
+    case IR_GOTO_IF_LESS:
+      return "jl";
+    case IR_GOTO_IF_LESS_EQUAL:
+      return "jle";
+    case IR_GOTO_IF_GREATER:
+      return "jg";
+    default:
+      return "jge";
+  }
+}
+
+/* x86_set_opcode - the setcc for a comparison that makes a value */
+static char *x86_set_opcode(int kind) {
+  switch (kind) {
+    case IR_LESS:
+      return "setl";
+    case IR_LESS_EQUAL:
+      return "setle";
+    case IR_GREATER:
+      return "setg";
+    case IR_GREATER_EQUAL:
+      return "setge";
+    case IR_EQUAL:
+      return "sete";
+    default:
+      return "setne";
+  }
+}
+
+/* x86_generate_node - multi-way branch, translates one instruction
+ *
+ * Parameters:
+ *   code - x86_section - section to append to
+ *   function - x86_function - the function it is in
+ *   node - x86_node - the instruction, with its registers
+ */
+static void x86_generate_node(struct x86_section *code, struct x86_function *function, struct x86_node *node) {
+  struct ir_instruction *instruction = node->instruction;
+  struct x86_operand table;
+
+  switch (instruction->kind) {
+    case IR_ADD:
+    case IR_ADDU:
+    case IR_ADDI:
+      x86_generate_binary(code, "addl", 1, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                          x86_operand_of(function, node, 2));
+      break;
+    case IR_SUBTRACT:
+    case IR_SUBU:
+      x86_generate_binary(code, "subl", 0, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                          x86_operand_of(function, node, 2));
+      break;
+    case IR_MULTIPLY:
+    case IR_MULU:
+      x86_generate_binary(code, "imull", 1, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                          x86_operand_of(function, node, 2));
+      break;
+    case IR_BIT_AND:
+      x86_generate_binary(code, "andl", 1, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                          x86_operand_of(function, node, 2));
+      break;
+    case IR_BIT_OR:
+      x86_generate_binary(code, "orl", 1, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                          x86_operand_of(function, node, 2));
+      break;
+    case IR_XOR:
+      x86_generate_binary(code, "xorl", 1, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                          x86_operand_of(function, node, 2));
+      break;
+
+    case IR_SHIFT_LEFT:
+    case IR_SHIFT_RIGHT:
+    case IR_SHIFT_RIGHT_U:
+      x86_generate_shift(code, instruction->kind == IR_SHIFT_LEFT ? "shll"
+                         : instruction->kind == IR_SHIFT_RIGHT ? "sarl" : "shrl",
+                         x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                         x86_operand_of(function, node, 2));
+      break;
+
+    case IR_DIVIDE:
+    case IR_DIVU:
+    case IR_MOD:
+    case IR_MULTIPLY_HIGH:
+    case IR_MULTIPLY_HIGH_U:
+      x86_generate_divide(code, instruction->kind, x86_operand_of(function, node, 0),
+                          x86_operand_of(function, node, 1), x86_operand_of(function, node, 2));
+      break;
+
+    case IR_LESS:
+    case IR_LESS_EQUAL:
+    case IR_GREATER:
+    case IR_GREATER_EQUAL:
+    case IR_EQUAL:
+    case IR_NOT_EQUAL:
+      x86_generate_set(code, x86_set_opcode(instruction->kind), x86_operand_of(function, node, 0),
+                       x86_operand_of(function, node, 1), x86_operand_of(function, node, 2));
+      break;
+
+    case IR_LOG_NOT:
+      x86_generate_set(code, "sete", x86_operand_of(function, node, 0), x86_operand_of(function, node, 1),
+                       x86_immediate(NULL, 0));
+      break;
+
+    case IR_BIT_NOT:
+      x86_generate_unary(code, "notl", x86_operand_of(function, node, 0), x86_operand_of(function, node, 1));
+      break;
+    case IR_MAKE_NEGATIVE:
+      x86_generate_unary(code, "negl", x86_operand_of(function, node, 0), x86_operand_of(function, node, 1));
+      break;
+
+    case IR_COPY:
+    case IR_MAKE_POSITIVE:
+    case IR_BYTE_TO_HALF_WORD:
+    case IR_BYTE_TO_WORD:
+    case IR_HALF_WORD_TO_WORD:
+    case IR_WORD_TO_BYTE:
+    case IR_HALF_WORD_TO_BYTE:
+    case IR_WORD_TO_HALF_WORD:
+      x86_generate_conversion(code, instruction->kind, x86_operand_of(function, node, 0),
+                              x86_operand_of(function, node, 1));
+      break;
+
+    case IR_MOVE_IF_NOT_ZERO:
+    case IR_MOVE_IF_ZERO:
+      x86_generate_conditional_move(code, function, node);
+      break;
+
+    case IR_LOAD_IMMEDIATE:
+      x86_move(code, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1));
+      break;
+
+    case IR_ADDRESS_OF:
+      if (node->vregs[0] >= 0) {
+        x86_generate_address(code, function, node);
+      }
+      break;
+
+    case IR_LOAD_BYTE:
+    case IR_LOAD_HALF_WORD:
+    case IR_LOAD_WORD:
+    case IR_LOAD_BYTE_U:
+    case IR_LOAD_HALF_WORD_U:
+      x86_generate_load(code, function, node);
+      break;
+
+    case IR_STORE_BYTE:
+    case IR_STORE_HALF_WORD:
+    case IR_STORE_WORD:
+      x86_generate_store(code, function, node);
+      break;
+
+    case IR_LABEL:
+      x86_emit_label(code, x86_local(instruction->operands[0].data.label_name));
+      break;
+
+    case IR_GOTO:
+      x86_emit(code, "jmp", 1, x86_target(x86_local(instruction->operands[0].data.label_name)));
+      break;
+
+    case IR_GOTO_IF_FALSE:
+    case IR_GOTO_IF_TRUE:
+      x86_compare(code, x86_operand_of(function, node, 0), x86_immediate(NULL, 0));
+      x86_emit(code, instruction->kind == IR_GOTO_IF_TRUE ? "jne" : "je", 1,
+               x86_target(x86_local(instruction->operands[1].data.label_name)));
+      break;
+
+    case IR_GOTO_IF_EQUAL:
+    case IR_GOTO_IF_NOT_EQUAL:
+    case IR_GOTO_IF_LESS:
+    case IR_GOTO_IF_LESS_EQUAL:
+    case IR_GOTO_IF_GREATER:
+    case IR_GOTO_IF_GREATER_EQUAL:
+      x86_compare(code, x86_operand_of(function, node, 0), x86_operand_of(function, node, 1));
+      x86_emit(code, x86_branch_opcode(instruction->kind), 1,
+               x86_target(x86_local(instruction->operands[2].data.label_name)));
+      break;
+
+    case IR_GOTO_TABLE:
+      // Entries are quad words, indexed by the whole of %rax
+      x86_move(code, x86_scratch(), x86_operand_of(function, node, 0));
+      table = x86_memory(-1, 0);
+      table.kind = X86_OPERAND_INDIRECT;
+      table.label = x86_local(instruction->operands[1].data.label_name);
+      table.index = X86_REGISTER_RAX;
+      table.scale = 8;
+      x86_emit(code, "jmp", 1, table);
+      break;
+
+    case IR_PRINT_NUMBER:
+    case IR_PRINT_STRING:
+      x86_move(code, x86_register(X86_REGISTER_RDI, 4), x86_operand_of(function, node, 0));
+      x86_emit(code, "call", 1,
+               x86_target(instruction->kind == IR_PRINT_NUMBER ? X86_PRINT_NUMBER_LABEL : X86_PRINT_STRING_LABEL));
+      break;
+
+    case IR_PARAMETER:
+      // Moved into its register at the call
+      break;
+
+    case IR_FUNCTION_CALL:
+    case IR_TAIL_CALL:
+      x86_generate_call(code, function, node);
+      break;
+
+    case IR_RESULT_WORD:
+    case IR_RESULT_BYTE:
+      x86_move(code, x86_operand_of(function, node, 0), x86_scratch());
+      break;
+
+    case IR_RETURN:
+      x86_move(code, x86_scratch(), x86_operand_of(function, node, 0));
+      break;
+
+    case IR_PROC_BEGIN:
+      x86_generate_proc_begin(code, function);
+      break;
+
+    case IR_PROC_END:
+      x86_generate_epilogue(code, function);
+      x86_emit(code, "ret", 0);
+      break;
+
+    case IR_NO_OPERATION:
+    case IR_RETURN_VOID:
+    case IR_SEQUENCE_PT:
+      break;
+
+    default:
+      printf("ERROR - x86-64: no code for IR instruction %d in %s\n", instruction->kind, function->graph->name);
+      x86_num_errors++;
+      break;
+  }
+}
+
+/* x86_generate_entry - generates main, which calls the program's main on
+ *   the frame stack
+ */
+static void x86_generate_entry(struct x86_section *code) {
+  x86_emit_label(code, "main");
+  x86_emit(code, "pushq", 1, x86_register(X86_REGISTER_RBP, 8));
+  x86_emit(code, "movl", 2, x86_immediate(X86_STACK_LABEL, X86_STACK_SIZE), x86_register(X86_REGISTER_RBP, 4));
+  x86_emit(code, "call", 1, x86_target(x86_local("main")));
+  x86_emit(code, "xorl", 2, x86_scratch(), x86_scratch());
+  x86_emit(code, "popq", 1, x86_register(X86_REGISTER_RBP, 8));
+  x86_emit(code, "ret", 0);
+}
+
+/* x86_generate_runtime - generates the functions print_number, print_string
+ *   and read_int go to, on top of the C library's printf and scanf
+ *
+ * Parameters:
+ *   code - x86_section - the program, from x86_generate_program
+ */
+void x86_generate_runtime(struct x86_section *code) {
+  struct x86_operand rsp = x86_register(X86_REGISTER_RSP, 8);
+
+  x86_emit_label(code, X86_PRINT_NUMBER_LABEL);
+  x86_emit(code, "subq", 2, x86_immediate(NULL, 8), rsp);
+  x86_emit(code, "movl", 2, x86_register(X86_REGISTER_RDI, 4), x86_register(X86_REGISTER_RSI, 4));
+  x86_emit(code, "movl", 2, x86_immediate(X86_NUMBER_FORMAT_LABEL, 0), x86_register(X86_REGISTER_RDI, 4));
+  x86_emit(code, "xorl", 2, x86_scratch(), x86_scratch());
+  x86_emit(code, "call", 1, x86_target("printf"));
+  x86_emit(code, "addq", 2, x86_immediate(NULL, 8), rsp);
+  x86_emit(code, "ret", 0);
+
+  x86_emit_label(code, X86_PRINT_STRING_LABEL);
+  x86_emit(code, "subq", 2, x86_immediate(NULL, 8), rsp);
+  x86_emit(code, "movl", 2, x86_register(X86_REGISTER_RDI, 4), x86_register(X86_REGISTER_RSI, 4));
+  x86_emit(code, "movl", 2, x86_immediate(X86_STRING_FORMAT_LABEL, 0), x86_register(X86_REGISTER_RDI, 4));
+  x86_emit(code, "xorl", 2, x86_scratch(), x86_scratch());
+  x86_emit(code, "call", 1, x86_target("printf"));
+  x86_emit(code, "addq", 2, x86_immediate(NULL, 8), rsp);
+  x86_emit(code, "ret", 0);
+
+  if (x86_read_int_called) {
+    x86_emit_label(code, X86_READ_INT_LABEL);
+    x86_emit(code, "subq", 2, x86_immediate(NULL, 24), rsp);
+    x86_emit(code, "movl", 2, x86_immediate(NULL, 0), x86_memory(X86_REGISTER_RSP, 12));
+    x86_emit(code, "leaq", 2, x86_memory(X86_REGISTER_RSP, 12), x86_register(X86_REGISTER_RSI, 8));
+    x86_emit(code, "movl", 2, x86_immediate(X86_NUMBER_FORMAT_LABEL, 0), x86_register(X86_REGISTER_RDI, 4));
+    x86_emit(code, "xorl", 2, x86_scratch(), x86_scratch());
+    x86_emit(code, "call", 1, x86_target("scanf"));
+    x86_emit(code, "movl", 2, x86_memory(X86_REGISTER_RSP, 12), x86_scratch());
+    x86_emit(code, "addq", 2, x86_immediate(NULL, 24), rsp);
+    x86_emit(code, "ret", 0);
+  }
+}
+
+/* x86_free_function - frees what was worked out for a function */
+static void x86_free_function(struct x86_function *function) {
+  free(function->frame_address);
+  free(function->nodes);
+  free(function->block_first);
+  free(function->block_last);
+  free(function->start);
+  free(function->end);
+  free(function->crosses_call);
+  free(function->location);
+  free(function->slot);
+}
+
+/* x86_generate_program - translates the whole program
+ *
+ * Parameters:
+ *   section - ir_section - all the instructions
+ *
+ * Returns the x86 instructions; x86_num_errors says whether any are missing
+ *
+ * Side-effects:
+ *   Memory may be allocated on the heap.
+ */
+struct x86_section *x86_generate_program(struct ir_section *section) {
+  struct x86_section *code = calloc(1, sizeof(struct x86_section));
+  struct cfg *graphs = cfg_build_program(section), *graph;
+  int i, n;
+
+  assert(NULL != code);
+  x86_num_errors = 0;
+  x86_read_int_called = 0;
+  x86_strings_size = literal_layout(&x86_strings);
+
+  x86_num_functions = 0;
+  for (graph = graphs; NULL != graph; graph = graph->next) {
+    x86_num_functions++;
+  }
+  x86_functions = calloc(x86_num_functions + 1, sizeof(struct x86_function));
+  assert(NULL != x86_functions);
+  for (graph = graphs, i = 0; NULL != graph; graph = graph->next, i++) {
+    x86_functions[i].graph = graph;
+    x86_functions[i].frame_size = (int)graph->begin->operands[1].data.number;
+    x86_functions[i].num_params = (int)graph->begin->operands[2].data.number;
+    x86_measure(&x86_functions[i]);
+  }
+  if (NULL == x86_find_function("main")) {
+    printf("ERROR - x86-64: the program has no main\n");
+    x86_num_errors++;
+  }
+
+  for (i = 0; i < x86_num_functions; i++) {
+    struct x86_function *function = &x86_functions[i];
+    if (function->num_params > X86_MAX_ARGUMENTS) {
+      printf("ERROR - x86-64: %s takes more than %d arguments\n", function->graph->name, X86_MAX_ARGUMENTS);
+      x86_num_errors++;
+    }
+    x86_build_nodes(function);
+    x86_compute_intervals(function);
+    x86_allocate_registers(function);
+    for (n = 0; n < function->num_nodes; n++) {
+      x86_generate_node(code, function, &function->nodes[n]);
+    }
+    x86_free_function(function);
+  }
+
+  x86_generate_entry(code);
+
+  cfg_free(graphs);
+  free(x86_functions);
+  x86_functions = NULL;
+  x86_num_functions = 0;
+  return code;
+}
+
+/****************************
+ * X86 OUTPUT               *
+ ****************************/
+
+static int x86_width_index(int width) {
+  switch (width) {
+    case 1:
+      return 0;
+    case 2:
+      return 1;
+    case 8:
+      return 3;
+    default:
+      return 2;
+  }
+}
+
+/* x86_print_displacement - prints label+number, or either alone */
+static void x86_print_displacement(FILE *output, struct x86_operand *operand) {
+  if (NULL != operand->label) {
+    fputs(operand->label, output);
+    if (0 != operand->number) {
+      fprintf(output, "%+ld", operand->number);
+    }
+  } else if (0 != operand->number || (operand->reg < 0 && operand->index < 0)) {
+    fprintf(output, "%ld", operand->number);
+  }
+}
+
+/* x86_print_operand - prints one operand in AT&T syntax
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ *   operand - x86_operand - the operand
+ */
+static void x86_print_operand(FILE *output, struct x86_operand *operand) {
+  switch (operand->kind) {
+    case X86_OPERAND_REGISTER:
+      assert(operand->reg >= 0 && operand->reg < X86_NUM_REGISTERS);
+      fprintf(output, "%%%s", x86_register_names[x86_width_index(operand->width)][operand->reg]);
+      break;
+    case X86_OPERAND_IMMEDIATE:
+      fputs("$", output);
+      x86_print_displacement(output, operand);
+      break;
+    case X86_OPERAND_TARGET:
+      fputs(operand->label, output);
+      break;
+    case X86_OPERAND_INDIRECT:
+      fputs("*", output);
+      // Fall through
+    case X86_OPERAND_MEMORY:
+      x86_print_displacement(output, operand);
+      if (operand->reg < 0 && operand->index < 0) {
+        break;
+      }
+      fputs("(", output);
+      if (operand->reg >= 0) {
+        fprintf(output, "%%%s", x86_register_names[3][operand->reg]);
+      }
+      if (operand->index >= 0) {
+        fprintf(output, ",%%%s,%d", x86_register_names[3][operand->index], operand->scale);
+      }
+      fputs(")", output);
+      break;
+  }
+}
+
+/* x86_print_instruction - prints one line of assembly
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ *   instruction - x86_instruction - the instruction to print
+ */
+void x86_print_instruction(FILE *output, struct x86_instruction *instruction) {
+  int i;
+
+  if (instruction->kind == X86_INSTRUCTION_LABEL) {
+    fprintf(output, "%s:\n", instruction->operands[0].label);
+    return;
+  }
+
+  fprintf(output, "\t%s", instruction->opcode);
+  for (i = 0; i < instruction->num_operands; i++) {
+    fputs((i == 0) ? "\t" : ", ", output);
+    x86_print_operand(output, &instruction->operands[i]);
+  }
+  fputs("\n", output);
+}
+
+/* x86_print_data - prints the string literals, the jump tables, and the
+ *   file-scope objects and the frame stack, which all start out zero
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ */
+static void x86_print_data(FILE *output) {
+  int i, j;
+
+  fputs("\n\t.section .rodata\n", output);
+  fprintf(output, "%s:\n\t.string \"%%d\"\n", X86_NUMBER_FORMAT_LABEL);
+  fprintf(output, "%s:\n\t.string \"%%s\"\n", X86_STRING_FORMAT_LABEL);
+  if (x86_strings_size > 0) {
+    fprintf(output, "%s:", X86_STRINGS_LABEL);
+    for (i = 0; i < x86_strings_size; i++) {
+      fprintf(output, "%s%d", i % 16 == 0 ? "\n\t.byte\t" : ", ", (unsigned char)x86_strings[i]);
+    }
+    fputs("\n", output);
+  }
+
+  // Jump tables for switch statements
+  for (i = 0; i < ir_jump_tables_len; i++) {
+    fprintf(output, "\t.balign 8\n.L%s:\n", ir_jump_tables[i].label);
+    for (j = 0; j < ir_jump_tables[i].count; j++) {
+      fprintf(output, "\t.quad\t.L%s\n", ir_jump_tables[i].targets[j]);
+    }
+  }
+
+  fputs("\n\t.bss\n", output);
+  for (i = 0; i < ir_globals_len; i++) {
+    fprintf(output, "\t.balign %d\n.L%s:\n\t.zero\t%d\n", ir_globals[i].alignment > 0 ? ir_globals[i].alignment : 1,
+            ir_globals[i].label, ir_globals[i].size);
+  }
+  fprintf(output, "\t.balign 16\n%s:\n\t.zero\t%d\n", X86_STACK_LABEL, X86_STACK_SIZE);
+  fputs("\n\t.section .note.GNU-stack,\"\",@progbits\n", output);
+}
+
+/* x86_print_program - prints the instructions, then the data
+ *
+ * Parameters:
+ *   output - FILE - file to print to
+ *   code - x86_section - all the instructions
+ */
+void x86_print_program(FILE *output, struct x86_section *code) {
+  struct x86_instruction *instruction;
+
+  fputs("# x86-64 System V; link with gcc -no-pie, as addresses are 32 bits\n", output);
+  fputs("\t.text\n\t.globl\tmain\n", output);
+  for (instruction = code->first; NULL != instruction; instruction = instruction->next) {
+    x86_print_instruction(output, instruction);
+  }
+  x86_print_data(output);
+}
@@ -0,0 +1,88 @@
+#ifndef _X86_H
+#define _X86_H
+
+#include <stdio.h>
+
+struct ir_section;
+
+/* How big the stack the IR's frames come from is */
+#define X86_STACK_SIZE (16 << 20)
+
+/* What the runtime calls things; the program's labels all start .L and have
+ * no dots of their own */
+#define X86_STRINGS_LABEL        ".Lrt.strings"
+#define X86_STACK_LABEL          ".Lrt.stack"
+#define X86_PRINT_NUMBER_LABEL   ".Lrt.print_number"
+#define X86_PRINT_STRING_LABEL   ".Lrt.print_string"
+#define X86_READ_INT_LABEL       ".Lread_int"
+
+/* Registers by their number in the instruction encoding */
+#define X86_REGISTER_RAX   0
+#define X86_REGISTER_RCX   1
+#define X86_REGISTER_RDX   2
+#define X86_REGISTER_RBX   3
+#define X86_REGISTER_RSP   4
+#define X86_REGISTER_RBP   5
+#define X86_REGISTER_RSI   6
+#define X86_REGISTER_RDI   7
+#define X86_REGISTER_R8    8
+#define X86_REGISTER_R9    9
+#define X86_REGISTER_R10  10
+#define X86_REGISTER_R11  11
+#define X86_REGISTER_R12  12
+#define X86_REGISTER_R13  13
+#define X86_REGISTER_R14  14
+#define X86_REGISTER_R15  15
+#define X86_NUM_REGISTERS 16
+
+#define X86_OPERAND_REGISTER   1
+/* $number or $label+number */
+#define X86_OPERAND_IMMEDIATE  2
+/* label+number(base, index, scale), any part of which may be missing */
+#define X86_OPERAND_MEMORY     3
+/* The label a jump or call goes to */
+#define X86_OPERAND_TARGET     4
+/* *memory, the entry of a table a jump goes through */
+#define X86_OPERAND_INDIRECT   5
+
+struct x86_operand {
+  int kind;
+  /* A register, or the base of an address; -1 for none */
+  int reg;
+  /* How many bytes of a register: 1, 2, 4 or 8 */
+  int width;
+  long number;
+  char *label;
+  /* The index register of an address, -1 for none, and what it is scaled by */
+  int index;
+  int scale;
+};
+
+#define X86_INSTRUCTION_OPERATION 1
+#define X86_INSTRUCTION_LABEL     2
+
+/*
+ * One line of assembly: either an operation with up to two operands, in
+ * AT&T order (source first), or the definition of a label (kept in
+ * operands[0]).
+ */
+struct x86_instruction {
+  int kind;
+  char *opcode;
+  int num_operands;
+  struct x86_operand operands[2];
+  struct x86_instruction *next;
+};
+
+struct x86_section {
+  struct x86_instruction *first, *last;
+};
+
+struct x86_section *x86_generate_program(struct ir_section *section);
+void x86_generate_runtime(struct x86_section *code);
+void x86_print_instruction(FILE *output, struct x86_instruction *instruction);
+void x86_print_program(FILE *output, struct x86_section *code);
+
+extern int x86_num_errors;
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * check.c - checks the plans divide.c makes for dividing by a constant
+ * against the host's own / and %
+ *
+ * Usage: check [-a]
+ *
+ * Each plan is run the way the IR it turns into runs on a 32-bit machine, for
+ * signed and unsigned divisors: negatives, powers of two, 1, 641, 65536 and
+ * the largest there are among them.  The remainder is the dividend less the
+ * quotient times the divisor, as ir_remainder_by_constant works it out.  The
+ * dividends are the ends of the range, each multiple of the divisor near them
+ * and near zero give or take two, and a million more from a xorshift
+ * generator; with -a, every one of the 2^32 dividends is tried instead,
+ * which takes about half an hour built with -O2.
+ *
+ * Build with: cc -o check check.c ../../src/divide.c
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../src/divide.h"
+
+#define SAMPLES 1000000
+
+static const long signed_divisors[] = {
+  1, -1, 2, -2, 3, -3, 5, 6, 7, -7, 8, -8, 10, 16, 25, 26, 125, 641, -641,
+  1000, 65536, -65536, 1000003, 0x7fffffffL, -0x7fffffffL, -0x80000000L
+};
+
+static const long unsigned_divisors[] = {
+  1, 2, 3, 5, 6, 7, 8, 10, 16, 25, 26, 125, 641, 1000, 65536, 1000003,
+  0x40000000L, 0x7fffffffL
+};
+
+static unsigned long failures;
+
+/* evaluate - runs a plan on a dividend, with 32-bit registers
+ *
+ * Returns the quotient
+ */
+static uint32_t evaluate(struct divide_step *steps, int count, uint32_t dividend) {
+  uint32_t values[DIVIDE_MAX_STEPS + 1];
+  uint32_t left, right;
+  int i;
+
+  values[0] = dividend;
+  for (i = 0; i < count; i++) {
+    left = values[steps[i].left];
+    right = values[steps[i].right];
+    switch (steps[i].kind) {
+    case DIVIDE_MULTIPLY_HIGH:
+      values[i + 1] = (uint32_t)(((int64_t)(int32_t)left * (int32_t)(uint32_t)steps[i].amount) >> 32);
+      break;
+    case DIVIDE_MULTIPLY_HIGH_U:
+      values[i + 1] = (uint32_t)(((uint64_t)left * (uint32_t)steps[i].amount) >> 32);
+      break;
+    case DIVIDE_SHIFT_RIGHT:
+      // Arithmetic, whatever the host's >> does with negative values
+      values[i + 1] = left >> steps[i].amount;
+      if ((left & 0x80000000u) && steps[i].amount > 0) {
+        values[i + 1] |= ~(0xffffffffu >> steps[i].amount);
+      }
+      break;
+    case DIVIDE_SHIFT_RIGHT_U:
+      values[i + 1] = left >> steps[i].amount;
+      break;
+    case DIVIDE_ADD:
+      values[i + 1] = left + right;
+      break;
+    case DIVIDE_SUBTRACT:
+      values[i + 1] = left - right;
+      break;
+    case DIVIDE_NEGATE:
+      values[i + 1] = 0u - left;
+      break;
+    default:
+      printf("unknown step kind %d\n", steps[i].kind);
+      failures++;
+      return 0;
+    }
+  }
+  return values[count];
+}
+
+/* check_one - compares a plan's quotient and remainder with the host's */
+static void check_one(struct divide_step *steps, int count, long divisor, int is_unsigned, uint32_t dividend) {
+  uint32_t quotient = evaluate(steps, count, dividend), expected, remainder, expected_remainder;
+
+  remainder = dividend - quotient * (uint32_t)divisor;
+  if (is_unsigned) {
+    expected = dividend / (uint32_t)divisor;
+    expected_remainder = dividend % (uint32_t)divisor;
+  } else if ((int32_t)dividend == INT32_MIN && divisor == -1) {
+    // Overflows in C; a div leaves the dividend, and so do the steps
+    expected = dividend;
+    expected_remainder = 0;
+  } else {
+    expected = (uint32_t)((int32_t)dividend / (int32_t)divisor);
+    expected_remainder = (uint32_t)((int32_t)dividend % (int32_t)divisor);
+  }
+
+  if (quotient != expected || remainder != expected_remainder) {
+    if (failures++ < 20) {
+      if (is_unsigned) {
+        printf("%lu / %ld: got %lu rem %lu, expected %lu rem %lu\n", (unsigned long)dividend, divisor,
+            (unsigned long)quotient, (unsigned long)remainder, (unsigned long)expected,
+            (unsigned long)expected_remainder);
+      } else {
+        printf("%ld / %ld: got %ld rem %ld, expected %ld rem %ld\n", (long)(int32_t)dividend, divisor,
+            (long)(int32_t)quotient, (long)(int32_t)remainder, (long)(int32_t)expected,
+            (long)(int32_t)expected_remainder);
+      }
+    }
+  }
+}
+
+/* check_around - checks the dividends within two of a value */
+static void check_around(struct divide_step *steps, int count, long divisor, int is_unsigned, uint32_t value) {
+  int delta;
+
+  for (delta = -2; delta <= 2; delta++) {
+    check_one(steps, count, divisor, is_unsigned, value + (uint32_t)delta);
+  }
+}
+
+/* check_divisor - checks the plan for one divisor */
+static void check_divisor(long divisor, int is_unsigned, int all) {
+  struct divide_step steps[DIVIDE_MAX_STEPS];
+  uint32_t magnitude = divisor < 0 ? 0u - (uint32_t)divisor : (uint32_t)divisor;
+  uint32_t state = 2463534242u, k;
+  uint64_t dividend;
+  int count = divide_plan(divisor, is_unsigned, steps);
+
+  if (count < 0 || count > DIVIDE_MAX_STEPS) {
+    printf("%s %ld: no plan\n", is_unsigned ? "unsigned" : "signed", divisor);
+    failures++;
+    return;
+  }
+
+  if (all) {
+    for (dividend = 0; dividend <= 0xffffffffu; dividend++) {
+      check_one(steps, count, divisor, is_unsigned, (uint32_t)dividend);
+    }
+    return;
+  }
+
+  check_around(steps, count, divisor, is_unsigned, 0);
+  check_around(steps, count, divisor, is_unsigned, 0x7fffffffu);
+  check_around(steps, count, divisor, is_unsigned, 0x80000000u);
+  check_around(steps, count, divisor, is_unsigned, 0xffffffffu);
+  for (k = 1; k <= 1000; k++) {
+    // Multiples near zero, and near either end of the range
+    check_around(steps, count, divisor, is_unsigned, k * magnitude);
+    check_around(steps, count, divisor, is_unsigned, 0u - k * magnitude);
+    check_around(steps, count, divisor, is_unsigned, (0x7fffffffu / magnitude - k) * magnitude);
+    check_around(steps, count, divisor, is_unsigned, (0xffffffffu / magnitude - k) * magnitude);
+  }
+  for (k = 0; k < SAMPLES; k++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    check_one(steps, count, divisor, is_unsigned, state);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int all = argc > 1 && !strcmp(argv[1], "-a");
+  unsigned i;
+
+  for (i = 0; i < sizeof(signed_divisors) / sizeof(signed_divisors[0]); i++) {
+    check_divisor(signed_divisors[i], 0, all);
+  }
+  for (i = 0; i < sizeof(unsigned_divisors) / sizeof(unsigned_divisors[0]); i++) {
+    check_divisor(unsigned_divisors[i], 1, all);
+  }
+
+  if (failures > 0) {
+    printf("%lu failed\n", failures);
+    return 1;
+  }
+  printf("all passed\n");
+  return 0;
+}
@@ -0,0 +1,68 @@
+void print_number(int n);
+void print_string(char *s);
+
+char text[40];
+int sums[10];
+
+/* The loop that once ran the division out of registers */
+void alphabet(void) {
+  int i;
+  for (i = 0; i < 37; i++) text[i] = 97 + i % 26;
+  text[37] = 0;
+  print_string(text);
+  print_string("\n");
+}
+
+/* The statement that once needed registers past $s7 */
+void buckets(void) {
+  int i;
+  for (i = 0; i < 25; i++) sums[i % 10] = sums[i % 10] + i / 3;
+  for (i = 0; i < 10; i++) {
+    print_number(sums[i]);
+    print_string(" ");
+  }
+  print_string("\n");
+}
+
+int quotients(int x) {
+  int q;
+  q = x / 3 + x / -7;
+  q = q + x / 641 + x / 65536;
+  return q + x / 16 + x / -8;
+}
+
+int remainders(int x) {
+  int r;
+  r = x % 3 + x % -7;
+  r = r + x % 641 + x % 65536;
+  return r + x % 16 + x % -8;
+}
+
+int main(void) {
+  int x, i;
+
+  alphabet();
+  buckets();
+
+  x = -2147483647;
+  for (i = 0; i < 12; i++) {
+    print_number(quotients(x));
+    print_string(" ");
+    print_number(remainders(x));
+    print_string("\n");
+    x = x / 5 * 3 + 1234567;
+  }
+
+  x = 1000003;
+  print_number(x / 1);
+  print_string(" ");
+  print_number(x / -1);
+  print_string(" ");
+  print_number(x % 1);
+  print_string(" ");
+  print_number(-x / 2);
+  print_string(" ");
+  print_number(-x % 2);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,61 @@
+void print_number(int n);
+void print_string(char *s);
+
+int g;
+
+int absolute(int x) {
+  return x < 0 ? -x : x;
+}
+
+int larger(int a, int b) {
+  int m;
+  m = a;
+  if (b > m)
+    m = b;
+  return m;
+}
+
+int smaller(int a, int b) {
+  int m;
+  if (a < b)
+    m = a;
+  else
+    m = b;
+  return m;
+}
+
+int sign(int x) {
+  return x > 0 ? 1 : x < 0 ? -1 : 0;
+}
+
+int side(int v) {
+  g = g + 1;
+  return v;
+}
+
+int sides(int c) {
+  return c ? side(3) : side(4);
+}
+
+int both(int a, int b) {
+  return a > 0 && b > 0 ? 5 : 6;
+}
+
+int main(void) {
+  int i;
+  for (i = -4; i < 5; i++) {
+    print_number(absolute(i));
+    print_number(larger(i, 1));
+    print_number(smaller(i, 1));
+    print_number(sign(i));
+    print_number(both(i, 2));
+    print_string(" ");
+  }
+  print_string("\n");
+  g = 0;
+  print_number(sides(1));
+  print_number(sides(0));
+  print_number(g);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,56 @@
+void print_number(int n);
+void print_string(char *s);
+
+int total;
+
+int square(int x) {
+  return x * x;
+}
+
+int clamp(int x, int low, int high) {
+  if (x < low)
+    return low;
+  if (x > high)
+    return high;
+  return x;
+}
+
+void bump(int by) {
+  total = total + by;
+}
+
+int sum_squares(int n) {
+  int i, s;
+  s = 0;
+  for (i = 1; i <= n; i++)
+    s = s + square(i);
+  return s;
+}
+
+int fact(int n) {
+  if (n < 2)
+    return 1;
+  return n * fact(n - 1);
+}
+
+int twice(int x) {
+  return square(x) + square(x + 1);
+}
+
+int main(void) {
+  int i;
+  total = 0;
+  for (i = -3; i < 12; i++) {
+    print_number(clamp(i * 3, 0, 20));
+    print_string(" ");
+    bump(twice(i));
+  }
+  print_string("\n");
+  print_number(sum_squares(30));
+  print_string(" ");
+  print_number(fact(10));
+  print_string(" ");
+  print_number(total);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,27 @@
+void print_number(int n);
+void print_string(char *s);
+
+int counts[4];
+
+int kind(int x) {
+  switch (x) {
+    case 0: return 3;
+    case 1: return 1;
+    case 2: return 4;
+    case 3: return 1;
+    case 4: return 5;
+  }
+  return 9;
+}
+
+int main(void) {
+  int i;
+  for (i = 0; i < 6; i++) {
+    counts[i & 3] = counts[i & 3] + kind(i);
+  }
+  print_number(counts[0]);
+  print_string(" ");
+  print_number(counts[1]);
+  print_string("\n");
+  return 0;
+}
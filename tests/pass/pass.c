@@ -0,0 +1,45 @@
+void print_number(int n);
+void print_string(char *s);
+
+int squares[10];
+
+int square(int x) {
+  return x * x;
+}
+
+int count_down(int n, int acc) {
+  if (n == 0)
+    return acc;
+  return count_down(n - 1, acc + n % 7);
+}
+
+int classify(int x) {
+  switch (x % 4) {
+    case 0: return 'z';
+    case 1: return 'o';
+    case 2: return 't';
+  }
+  return '?';
+}
+
+int main(void) {
+  int i, k, s;
+  char word[12];
+  for (i = 0; i < 10; i++)
+    squares[i] = square(i);
+  s = 0;
+  for (i = 0; i < 10; i++) {
+    k = squares[i];
+    s = s + (k > 20 ? k / 3 : k);
+  }
+  print_number(s);
+  print_string(" ");
+  print_number(count_down(500, 0));
+  print_string(" ");
+  for (i = 0; i < 11; i++)
+    word[i] = classify(i);
+  word[11] = 0;
+  print_string(word);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,62 @@
+void print_number(int n);
+void print_string(char *s);
+
+int counter;
+int table[8];
+
+int add_zero(int x) {
+  int y;
+  y = x + 0;
+  y = y * 1;
+  return y;
+}
+
+int copy_chain(int x) {
+  int a, b, c;
+  a = x;
+  b = a;
+  c = b;
+  return c;
+}
+
+int store_load(int x) {
+  counter = x;
+  return counter + 1;
+}
+
+void fill(void) {
+  int i;
+  for (i = 0; i < 8; i++) {
+    table[i] = i * i;
+    table[i] = table[i] + 1;
+  }
+}
+
+int branches(int x) {
+  if (x > 0) {
+    if (x > 10)
+      return 2;
+  }
+  return 1;
+}
+
+int main(void) {
+  int i, s;
+  fill();
+  s = 0;
+  for (i = 0; i < 8; i++)
+    s = s + table[i];
+  print_number(s);
+  print_string(" ");
+  print_number(add_zero(-7));
+  print_string(" ");
+  print_number(copy_chain(42));
+  print_string(" ");
+  print_number(store_load(9));
+  print_number(counter);
+  print_string(" ");
+  for (i = -1; i < 13; i = i + 4)
+    print_number(branches(i));
+  print_string("\n");
+  return 0;
+}
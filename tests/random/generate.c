@@ -0,0 +1,517 @@
+/*
+ * generate.c - writes a random program in the language the compiler takes,
+ * for random.sh to compile at each level and back end and compare with the
+ * host's C compiler
+ *
+ * Usage: generate seed
+ *
+ * The same seed always gives the same program.  Programs are free of
+ * undefined behaviour, so any difference is the compiler's: every value
+ * stored is reduced modulo 10007, and each expression tracks how large its
+ * value can get, so that no add, multiply or negation overflows 32 bits.
+ * Division is by constants, which cover powers of two, negatives, 1, 641 and
+ * 65536, or by a value known to be between 1 and 8.  Array indexes are masked
+ * with & 15.
+ *
+ * The compiler doesn't spill: a statement's temporaries all have to fit in
+ * the register window.  Each statement is given a budget of them, and the
+ * operators and leaves an expression is built from are paid for out of it
+ * with a rough count of the temporaries they take.
+ *
+ * The helper functions only read globals and arrays, and only call helpers
+ * before them, so the order in which an expression's operands are evaluated
+ * never shows in the output.  main prints everything at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#define MODULUS 10007
+#define LIMIT 2147483647L
+#define MAX_FUNCTIONS 4
+#define BUDGET 12
+
+/* A generated expression and the largest magnitude its value can have */
+struct expression {
+  char *text;
+  long bound;
+};
+
+static unsigned long state;
+
+/* Where the statements being generated are, which decides what they can use */
+static int function;        /* index of the helper, or -1 for main */
+static int loop_depth;      /* for and while loops around the statement */
+static int num_functions;
+static int budget;          /* temporaries the statement has left */
+
+static const long divisors[] = {
+  1, 2, 3, 5, 7, 10, 16, 26, 641, 1000, 65536, 1000003, -1, -3, -7, -8, -641
+};
+
+/* next - a number from 0 to n - 1, from a xorshift generator */
+static int next(int n) {
+  state ^= (state << 13) & 0xffffffffUL;
+  state ^= state >> 17;
+  state ^= (state << 5) & 0xffffffffUL;
+  return (int)(state % (unsigned long)n);
+}
+
+/* format - printf into a string on the heap */
+static char *format(const char *fmt, ...) {
+  va_list args;
+  char *text;
+  int length;
+
+  va_start(args, fmt);
+  length = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+  text = malloc(length + 1);
+  if (NULL == text) {
+    perror("generate");
+    exit(1);
+  }
+  va_start(args, fmt);
+  vsnprintf(text, length + 1, fmt, args);
+  va_end(args);
+  return text;
+}
+
+/* afford - pays for something taking cost temporaries, if there are enough */
+static int afford(int cost) {
+  if (budget < cost) {
+    return 0;
+  }
+  budget -= cost;
+  return 1;
+}
+
+static struct expression make(char *text, long bound) {
+  struct expression e;
+  e.text = text;
+  e.bound = bound;
+  return e;
+}
+
+/* reduce - brings an expression's value below MODULUS */
+static struct expression reduce(struct expression e) {
+  struct expression r;
+
+  if (e.bound < MODULUS) {
+    return e;
+  }
+  budget -= 2;
+  r = make(format("(%s %% %d)", e.text, MODULUS), MODULUS - 1);
+  free(e.text);
+  return r;
+}
+
+/* power - the smallest power of two above a bound, for the bitwise operators */
+static long power(long bound) {
+  long p = 1;
+  while (p <= bound) {
+    p <<= 1;
+  }
+  return p;
+}
+
+static struct expression expression(int depth);
+
+/* argument - an argument to a call, reduced even when it needn't be, since the
+ *   type checker only passes an int where the parameter is an int
+ */
+static struct expression argument(int depth) {
+  struct expression e = expression(depth), r;
+
+  budget -= 2;
+  r = make(format("(%s %% %d)", e.text, MODULUS), MODULUS - 1);
+  free(e.text);
+  return r;
+}
+
+/* leaf - a variable, array element, constant or call; a constant when the
+ *   budget can't pay for anything else
+ */
+static struct expression leaf(int depth) {
+  struct expression index, a, b;
+  char *text;
+  int callee, value, kind = next(10);
+
+  if (kind < 7 && !afford(kind < 4 ? 2 : 8)) {
+    kind = 9;
+  }
+  switch (kind) {
+  case 0:
+  case 1:
+    return make(format("%s", next(2) ? "x" : "y"), MODULUS - 1);
+  case 2:
+    if (function >= 0) {
+      return make(format("%s", next(2) ? "a" : "b"), MODULUS - 1);
+    }
+    return make(format("g%d", next(3)), MODULUS - 1);
+  case 3:
+    if (loop_depth > 0) {
+      return make(format("%s", next(2) && loop_depth > 1 ? "j" : "i"), 20);
+    }
+    return make(format("%d", next(100)), 99);
+  case 4:
+    index = depth > 0 ? expression(depth - 1) : leaf(0);
+    text = format("v[(%s) & 15]", index.text);
+    free(index.text);
+    return make(text, MODULUS - 1);
+  case 5:
+    index = depth > 0 ? expression(depth - 1) : leaf(0);
+    text = format("c[(%s) & 15]", index.text);
+    free(index.text);
+    return make(text, 128);
+  case 6:
+    // Helpers call the helpers before them, outside loops, to keep runs short
+    callee = function < 0 ? num_functions : loop_depth ? 0 : function;
+    if (callee > 0 && depth > 0) {
+      a = argument(depth - 1);
+      b = argument(depth - 1);
+      text = format("f%d(%s, %s)", next(callee), a.text, b.text);
+      free(a.text);
+      free(b.text);
+      return make(text, MODULUS - 1);
+    }
+    return make(format("g%d", next(3)), MODULUS - 1);
+  case 7:
+    // Negative constants are parenthesized, so that "- -5" can't become "--5"
+    budget--;
+    value = next(2000) - 1000;
+    return make(format(value < 0 ? "(%d)" : "%d", value), 1000);
+  default:
+    budget--;
+    return make(format("%d", next(10)), 9);
+  }
+}
+
+/* binary - joins two expressions with an operator whose result can't overflow */
+static struct expression binary(struct expression a, struct expression b) {
+  long divisor;
+  char *text;
+  long bound;
+
+  // Nothing below can then get past 2^31 - 1, not even a bitwise result
+  if (a.bound + b.bound > LIMIT / 2) {
+    a = reduce(a);
+    b = reduce(b);
+  }
+  switch (next(16)) {
+  case 0:
+  case 1:
+    text = format("(%s + %s)", a.text, b.text);
+    bound = a.bound + b.bound;
+    break;
+  case 2:
+  case 3:
+    text = format("(%s - %s)", a.text, b.text);
+    bound = a.bound + b.bound;
+    break;
+  case 4:
+  case 5:
+    if (a.bound * b.bound > LIMIT) {
+      a = reduce(a);
+      b = reduce(b);
+    }
+    text = format("(%s * %s)", a.text, b.text);
+    bound = a.bound * b.bound;
+    break;
+  case 6:
+  case 7:
+    divisor = divisors[next(sizeof(divisors) / sizeof(divisors[0]))];
+    text = format("(%s / %s%ld%s)", a.text, divisor < 0 ? "(" : "", divisor, divisor < 0 ? ")" : "");
+    bound = a.bound;
+    break;
+  case 8:
+  case 9:
+    divisor = divisors[next(sizeof(divisors) / sizeof(divisors[0]))];
+    text = format("(%s %% %s%ld%s)", a.text, divisor < 0 ? "(" : "", divisor, divisor < 0 ? ")" : "");
+    bound = a.bound < labs(divisor) ? a.bound : labs(divisor) - 1;
+    break;
+  case 10:
+    budget -= 3;
+    text = format("(%s %s ((%s & 7) + 1))", a.text, next(2) ? "/" : "%", b.text);
+    bound = a.bound;
+    break;
+  case 11:
+    text = format("(%s %s %s)", a.text, next(3) ? (next(2) ? "&" : "|") : "^", b.text);
+    bound = power(a.bound > b.bound ? a.bound : b.bound);
+    break;
+  case 12:
+    if (next(2)) {
+      text = format("((%s & 255) << %d)", a.text, next(9));
+      bound = 255L << 8;
+    } else {
+      text = format("(%s >> %d)", a.text, next(12));
+      bound = a.bound;
+    }
+    break;
+  case 13: {
+    static const char *comparisons[] = {"<", "<=", ">", ">=", "==", "!="};
+    text = format("(%s %s %s)", a.text, comparisons[next(6)], b.text);
+    bound = 1;
+    break;
+  }
+  case 14:
+    text = format("(%s %s %s)", a.text, next(2) ? "&&" : "||", b.text);
+    bound = 1;
+    break;
+  default:
+    // Both arms take temporaries of their own, so the other one is a constant
+    text = format("(%s ? %s : %d)", a.text, b.text, next(10));
+    bound = b.bound > 9 ? b.bound : 9;
+    break;
+  }
+  free(a.text);
+  free(b.text);
+  return make(text, bound);
+}
+
+/* expression - an expression at most depth operators deep */
+static struct expression expression(int depth) {
+  struct expression e;
+  char *text;
+
+  if (depth <= 0 || next(4) == 0 || !afford(2)) {
+    return leaf(depth);
+  }
+  switch (next(8)) {
+  case 0:
+    e = expression(depth - 1);
+    text = format("(-%s)", e.text);
+    free(e.text);
+    return make(text, e.bound);
+  case 1:
+    e = expression(depth - 1);
+    text = format("(!%s)", e.text);
+    free(e.text);
+    return make(text, 1);
+  default:
+    e = expression(depth - 1);
+    return binary(e, expression(depth - 1));
+  }
+}
+
+static void indent(int level) {
+  while (level-- > 0) {
+    printf("  ");
+  }
+}
+
+/* assignment - stores a reduced expression in a variable or element */
+static void assignment(int level) {
+  struct expression e, index;
+  int target = function >= 0 ? next(2) : next(6);
+
+  // An element's address takes its own few temporaries
+  budget = target < 4 ? BUDGET : BUDGET - 5;
+  e = reduce(expression(3));
+  indent(level);
+  switch (target) {
+  case 0:
+  case 1:
+    printf("%s = %s;\n", next(2) ? "x" : "y", e.text);
+    break;
+  case 2:
+  case 3:
+    printf("g%d = %s;\n", next(3), e.text);
+    break;
+  case 4:
+    index = expression(1);
+    printf("v[(%s) & 15] = %s;\n", index.text, e.text);
+    free(index.text);
+    break;
+  default:
+    index = expression(1);
+    printf("c[(%s) & 15] = %s;\n", index.text, e.text);
+    free(index.text);
+    break;
+  }
+  free(e.text);
+}
+
+/* condition - an expression for an if, switch or ternary to test, in a
+ *   statement whose own code takes some temporaries besides
+ */
+static struct expression condition(int taken) {
+  budget = BUDGET - taken;
+  return expression(2);
+}
+
+static void statements(int level, int count);
+
+/* statement - one statement, nesting control flow at most two loops deep */
+static void statement(int level) {
+  struct expression e;
+  const char *counter;
+  int trips = function < 0 ? 12 : 5, is_for;
+
+  switch (next(level > 4 ? 2 : 9)) {
+  case 0:
+  case 1:
+    assignment(level);
+    return;
+  case 2:
+  case 3:
+    e = condition(0);
+    indent(level);
+    printf("if (%s) {\n", e.text);
+    free(e.text);
+    statements(level + 1, 1 + next(2));
+    indent(level);
+    if (next(2)) {
+      printf("} else {\n");
+      statements(level + 1, 1 + next(2));
+      indent(level);
+    }
+    printf("}\n");
+    return;
+  case 4:
+  case 5:
+    if (loop_depth >= 2) {
+      assignment(level);
+      return;
+    }
+    counter = loop_depth ? "j" : "i";
+    is_for = next(2);
+    indent(level);
+    if (is_for) {
+      printf("for (%s = 0; %s < %d; %s++) {\n", counter, counter, 1 + next(trips), counter);
+    } else {
+      printf("%s = %d;\n", counter, 1 + next(trips));
+      indent(level);
+      printf("while (%s > 0) {\n", counter);
+    }
+    loop_depth++;
+    statements(level + 1, 1 + next(3));
+    loop_depth--;
+    if (!is_for) {
+      indent(level + 1);
+      printf("%s = %s - 1;\n", counter, counter);
+    }
+    indent(level);
+    printf("}\n");
+    return;
+  case 6:
+    e = condition(2);
+    indent(level);
+    printf("switch ((%s) & 7) {\n", e.text);
+    free(e.text);
+    indent(level);
+    printf("case 0:\n");
+    statements(level + 1, 1);
+    indent(level + 1);
+    printf("break;\n");
+    indent(level);
+    printf("case 1:\n");
+    indent(level);
+    printf("case 2:\n");
+    statements(level + 1, 1);
+    indent(level);
+    printf("case 5:\n");
+    statements(level + 1, 1);
+    indent(level + 1);
+    printf("break;\n");
+    if (next(2)) {
+      indent(level);
+      printf("default:\n");
+      statements(level + 1, 1);
+    }
+    indent(level);
+    printf("}\n");
+    return;
+  case 7:
+    budget = BUDGET - 4;
+    e = argument(2);
+    indent(level);
+    printf("x = walk(%d, %s);\n", next(30), e.text);
+    free(e.text);
+    return;
+  default:
+    e = condition(6);
+    indent(level);
+    printf("%s = %s ? %s : %s;\n", next(2) ? "x" : "y", e.text, next(2) ? "x" : "y", next(2) ? "x" : "y");
+    free(e.text);
+    return;
+  }
+}
+
+static void statements(int level, int count) {
+  while (count-- > 0) {
+    statement(level);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  struct expression e;
+  int i;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s seed\n", argv[0]);
+    return 2;
+  }
+  state = strtoul(argv[1], NULL, 10) * 2654435761UL % 0xffffffffUL + 1;
+  num_functions = 1 + next(MAX_FUNCTIONS);
+
+  printf("void print_number(int n);\n");
+  printf("void print_string(char *s);\n\n");
+  printf("int g0, g1, g2;\n");
+  printf("int v[16];\n");
+  printf("char c[16];\n\n");
+
+  // Tail recursive, so sibling calls are covered
+  printf("int walk(int n, int acc) {\n");
+  printf("  if (n <= 0)\n");
+  printf("    return acc;\n");
+  printf("  return walk(n - 1, (acc * %d + n) %% %d);\n", 2 + next(50), MODULUS);
+  printf("}\n\n");
+
+  for (function = 0; function < num_functions; function++) {
+    printf("int f%d(int a, int b) {\n", function);
+    printf("  int x, y, i, j;\n");
+    printf("  x = a;\n");
+    printf("  y = b;\n");
+    statements(1, 1 + next(4));
+    budget = BUDGET;
+    e = reduce(expression(3));
+    printf("  return %s;\n", e.text);
+    free(e.text);
+    printf("}\n\n");
+  }
+
+  function = -1;
+  printf("int main(void) {\n");
+  printf("  int x, y, i, j;\n");
+  printf("  x = %d;\n", next(MODULUS));
+  printf("  y = %d;\n", next(MODULUS) - MODULUS / 2);
+  for (i = 0; i < 3; i++) {
+    printf("  g%d = %d;\n", i, next(2 * MODULUS - 1) - MODULUS + 1);
+  }
+  printf("  for (i = 0; i < 16; i++) {\n");
+  printf("    v[i] = (i * %d + %d) %% %d;\n", next(1000), next(1000), MODULUS);
+  printf("    c[i] = i * %d;\n", next(100) - 50);
+  printf("  }\n");
+  statements(1, 4 + next(6));
+
+  printf("  print_number(x);\n");
+  printf("  print_string(\" \");\n");
+  printf("  print_number(y);\n");
+  for (i = 0; i < 3; i++) {
+    printf("  print_string(\" \");\n");
+    printf("  print_number(g%d);\n", i);
+  }
+  printf("  x = 0;\n");
+  printf("  for (i = 0; i < 16; i++) {\n");
+  printf("    x = (x * 31 + v[i]) %% %d;\n", MODULUS);
+  printf("    x = (x * 31 + c[i]) %% %d;\n", MODULUS);
+  printf("  }\n");
+  printf("  print_string(\" \");\n");
+  printf("  print_number(x);\n");
+  printf("  print_string(\"\\n\");\n");
+  printf("  return 0;\n");
+  printf("}\n");
+  return 0;
+}
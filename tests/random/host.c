@@ -0,0 +1,14 @@
+/*
+ * host.c - the compiler's built-in output functions, for building the random
+ * programs with the host's C compiler
+ */
+
+#include <stdio.h>
+
+void print_number(int n) {
+  printf("%d", n);
+}
+
+void print_string(char *s) {
+  printf("%s", s);
+}
@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# random.sh - differential testing with random programs
+#
+# Usage: sh tests/random/random.sh [compiler] [count] [seed]
+#
+# Writes count programs (100 by default) with generate.c, from seed (1 by
+# default) on, and builds each with the host's C compiler (CC, or cc) and
+# host.c for the expected output.  Each program is then compiled at -O0, -O1,
+# -O2 and -Os, and run under the IR interpreter (-s ir-run), through the C
+# back end (-s c) and through the x86-64 back end (-s x86-64, linked with
+# -no-pie).  Every run must print what the host build printed.  A failing
+# program can be written out again with "generate seed".
+#
+
+tests=$(cd "$(dirname "$0")/.." && pwd)
+compiler=${1:-$tests/../src/compiler}
+count=${2:-100}
+seed=${3:-1}
+cc=${CC:-cc}
+work=$(mktemp -d "${TMPDIR:-/tmp}/random.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+if ! "$cc" -o "$work/generate" "$tests/random/generate.c" ||
+   ! "$cc" -c -o "$work/host.o" "$tests/random/host.c"; then
+  echo "random.sh: can't build the generator with $cc"
+  exit 1
+fi
+
+# ir_run_output - what the program printed between the IR RUN and IR PROFILE
+#   banners, less the newline the compiler puts before the second
+ir_run_output() {
+  awk '/^=+ IR PROFILE =+$/ { exit }
+       run { if (lines++) printf "\n"; printf "%s", $0 }
+       /^=+ IR RUN =+$/ { run = 1 }' "$1"
+}
+
+# fail - reports one failed build or run and counts it
+fail() {
+  echo "FAIL: seed $seed $1"
+  failures=$((failures + 1))
+}
+
+# check - compares a run's output with the host's
+check() {
+  if ! cmp -s "$work/got" "$work/expected"; then
+    fail "$1: output differs"
+    diff "$work/expected" "$work/got" | head -5
+  fi
+}
+
+last=$((seed + count))
+while [ "$seed" -lt "$last" ]; do
+  "$work/generate" "$seed" > "$work/program.c"
+  if ! "$cc" -w -o "$work/host" "$work/program.c" "$work/host.o" ||
+     ! "$work/host" > "$work/expected"; then
+    fail "host build"
+    seed=$((seed + 1))
+    continue
+  fi
+
+  for level in -O0 -O1 -O2 -Os; do
+    if ! "$compiler" $level -s ir-run -o "$work/out" < "$work/program.c" > "$work/log" 2>&1; then
+      fail "$level -s ir-run"
+    else
+      ir_run_output "$work/log" > "$work/got"
+      check "$level -s ir-run"
+    fi
+
+    if ! "$compiler" $level -s c -o "$work/prog.c" < "$work/program.c" > "$work/log" 2>&1; then
+      fail "$level -s c"
+    elif ! "$cc" -o "$work/prog" "$work/prog.c" > "$work/log" 2>&1; then
+      fail "$level -s c: $cc failed"
+    else
+      "$work/prog" < /dev/null > "$work/got" 2>&1
+      check "$level -s c"
+    fi
+
+    if ! "$compiler" $level -s x86-64 -o "$work/prog.s" < "$work/program.c" > "$work/log" 2>&1; then
+      fail "$level -s x86-64"
+    elif ! "$cc" -no-pie -o "$work/prog" "$work/prog.s" > "$work/log" 2>&1; then
+      fail "$level -s x86-64: $cc failed"
+    else
+      "$work/prog" < /dev/null > "$work/got" 2>&1
+      check "$level -s x86-64"
+    fi
+  done
+  seed=$((seed + 1))
+done
+
+if [ $failures -gt 0 ]; then
+  echo "$failures failed"
+  exit 1
+fi
+echo "all passed"
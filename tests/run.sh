@@ -0,0 +1,134 @@
+#!/bin/sh
+#
+# run.sh - compiles the sample programs under tests/ and checks what they print
+#
+# Usage: sh tests/run.sh [compiler]
+#
+# Every tests/<name>/<name>.c with a <name>.out next to it is compiled at
+# -O0, -O1, -O2 and -Os, and with each line of <name>.flags if there is one.
+# Each build is run under the IR interpreter (-s ir-run), and, when there is
+# a C compiler on the path, through the C back end (-s c) and the x86-64
+# back end (-s x86-64, linked with -no-pie) as well.  The MIPS code is
+# always generated, which catches the back end's assertions, and is run too
+# when MIPS_SIM names a simulator ("spim -quiet -file", say).  Every run must
+# print exactly <name>.out.  Where there is a <name>.elf, the
+# program is also assembled to an object file (-c) at -O1, and what readelf
+# shows of its relocations and section bytes must be exactly <name>.elf.
+# tests/divide/check.c, which tries the plans for division by a constant on
+# the host, is built and run as well.
+#
+
+tests=$(cd "$(dirname "$0")" && pwd)
+compiler=${1:-$tests/../src/compiler}
+cc=${CC:-cc}
+work=$(mktemp -d "${TMPDIR:-/tmp}/tests.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+if ! command -v "$cc" > /dev/null 2>&1; then
+  cc=
+fi
+readelf=readelf
+if ! command -v "$readelf" > /dev/null 2>&1; then
+  readelf=
+fi
+
+# ir_run_output - what the program printed between the IR RUN and IR PROFILE
+#   banners, less the newline the compiler puts before the second
+ir_run_output() {
+  awk '/^=+ IR PROFILE =+$/ { exit }
+       run { if (lines++) printf "\n"; printf "%s", $0 }
+       /^=+ IR RUN =+$/ { run = 1 }' "$1"
+}
+
+# fail - reports one failed build or run and counts it
+fail() {
+  echo "FAIL: $1"
+  failures=$((failures + 1))
+}
+
+# check - compares a run's output with the expected output
+check() {
+  if ! cmp -s "$work/got" "$expected"; then
+    fail "$1: output differs"
+    diff "$expected" "$work/got" | head -5
+  fi
+}
+
+for expected in "$tests"/*/*.out; do
+  [ -f "$expected" ] || continue
+  dir=$(dirname "$expected")
+  name=$(basename "$expected" .out)
+  program=$dir/$name.c
+
+  printf '%s\n' -O0 -O1 -O2 -Os > "$work/flags"
+  if [ -f "$dir/$name.flags" ]; then
+    cat "$dir/$name.flags" >> "$work/flags"
+  fi
+
+  while read -r flags; do
+    what="$name $flags"
+
+    if ! "$compiler" $flags -s ir-run -o "$work/out" < "$program" > "$work/log" 2>&1; then
+      fail "$what -s ir-run"
+    else
+      ir_run_output "$work/log" > "$work/got"
+      check "$what -s ir-run"
+    fi
+
+    if [ -n "$cc" ]; then
+      if ! "$compiler" $flags -s c -o "$work/prog.c" < "$program" > "$work/log" 2>&1; then
+        fail "$what -s c"
+      elif ! "$cc" -o "$work/prog" "$work/prog.c" > "$work/log" 2>&1; then
+        fail "$what -s c: $cc failed"
+      else
+        "$work/prog" < /dev/null > "$work/got" 2>&1
+        check "$what -s c"
+      fi
+
+      if ! "$compiler" $flags -s x86-64 -o "$work/prog.s" < "$program" > "$work/log" 2>&1; then
+        fail "$what -s x86-64"
+      elif ! "$cc" -no-pie -o "$work/prog" "$work/prog.s" > "$work/log" 2>&1; then
+        fail "$what -s x86-64: $cc failed"
+      else
+        "$work/prog" < /dev/null > "$work/got" 2>&1
+        check "$what -s x86-64"
+      fi
+    fi
+
+    if ! "$compiler" $flags -o "$work/prog.s" < "$program" > "$work/log" 2>&1; then
+      fail "$what -s mips"
+    elif [ -n "$MIPS_SIM" ]; then
+      $MIPS_SIM "$work/prog.s" < /dev/null > "$work/got" 2>&1
+      check "$what -s mips"
+    fi
+  done < "$work/flags"
+
+  if [ -f "$dir/$name.elf" ] && [ -n "$readelf" ]; then
+    if ! "$compiler" -O1 -c -o "$work/prog.o" < "$program" > "$work/log" 2>&1; then
+      fail "$name -c"
+    else
+      "$readelf" -r -x .text -x .data "$work/prog.o" > "$work/got" 2>&1
+      if ! cmp -s "$work/got" "$dir/$name.elf"; then
+        fail "$name -c: object differs"
+        diff "$dir/$name.elf" "$work/got" | head -5
+      fi
+    fi
+  fi
+done
+
+# The division plans are checked against the host's arithmetic as well
+if [ -n "$cc" ]; then
+  if ! "$cc" -o "$work/check" "$tests/divide/check.c" "$tests/../src/divide.c" > "$work/log" 2>&1; then
+    fail "divide check: $cc failed"
+  elif ! "$work/check" > "$work/log" 2>&1; then
+    fail "divide check"
+    head -5 "$work/log"
+  fi
+fi
+
+if [ $failures -gt 0 ]; then
+  echo "$failures failed"
+  exit 1
+fi
+echo "all passed"
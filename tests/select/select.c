@@ -0,0 +1,62 @@
+void print_number(int n);
+void print_string(char *s);
+
+int grid[25];
+char name[8];
+int limit;
+
+int offsets(int row) {
+  int base, s;
+  base = row * 5;
+  s = grid[base];
+  s = s + grid[base + 1] * 2;
+  return s + grid[base + 8] * 4;
+}
+
+int masks(int x) {
+  return (x & 255) + (x | 16) - (x ^ 5);
+}
+
+int shifts(int x) {
+  return (x << 3) + (x >> 2);
+}
+
+int compare(int a, int b) {
+  int n;
+  n = 0;
+  if (a < b)
+    n = n + 1;
+  if (a <= 100)
+    n = n + 2;
+  if (a != 0)
+    n = n + 4;
+  if (b >= -3)
+    n = n + 8;
+  return n;
+}
+
+int main(void) {
+  int i, j, k, s;
+  limit = 4;
+  for (i = 0; i < 5; i++)
+    for (j = 0; j < 5; j++) {
+      k = i * 10 + j;
+      grid[i * 5 + j] = k;
+    }
+  print_number(offsets(2));
+  print_string(" ");
+  name[0] = 'o';
+  name[1] = 'k';
+  name[2] = 0;
+  print_string(name);
+  print_string(" ");
+  s = 0;
+  for (i = -20; i < 300; i = i + 37) {
+    s = s + masks(i) + shifts(i);
+    print_number(compare(i, limit));
+    print_string(",");
+  }
+  print_number(s);
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,77 @@
+void print_number(int n);
+void print_string(char *s);
+
+int dense(int x) {
+  switch (x) {
+    case 0: return 10;
+    case 1: return 11;
+    case 2: return 12;
+    case 3: return 13;
+    case 4: return 14;
+    case 5: return 15;
+    case 6: return 16;
+    case 7: return 17;
+  }
+  return -1;
+}
+
+int sparse(int x) {
+  switch (x) {
+    case -1000: return 1;
+    case 7: return 2;
+    case 300: return 3;
+    case 5000: return 4;
+    case 123456: return 5;
+    default: return 0;
+  }
+}
+
+int vowel(int c) {
+  switch (c) {
+    case 'a': case 'e': case 'i': case 'o': case 'u':
+      return 1;
+  }
+  return 0;
+}
+
+int fall(int x) {
+  int n;
+  n = 0;
+  switch (x) {
+    case 1:
+      n = n + 1;
+    case 2:
+      n = n + 10;
+      break;
+    case 3:
+      n = n + 100;
+    default:
+      n = n + 1000;
+  }
+  return n;
+}
+
+int main(void) {
+  int i, s;
+  for (i = -2; i < 10; i++) {
+    print_number(dense(i));
+    print_string(" ");
+  }
+  print_string("\n");
+  print_number(sparse(-1000) + sparse(7) * 10 + sparse(300) * 100);
+  print_number(sparse(5000) + sparse(123456) * 10 + sparse(8) * 100);
+  print_string("\n");
+  s = 0;
+  for (i = 'a'; i <= 'z'; i++) {
+    s = s * 2 % 100003;
+    s = s + vowel(i);
+  }
+  print_number(s);
+  print_string("\n");
+  for (i = 0; i < 5; i++) {
+    print_number(fall(i));
+    print_string(" ");
+  }
+  print_string("\n");
+  return 0;
+}
@@ -0,0 +1,51 @@
+void print_number(int n);
+void print_string(char *s);
+
+int is_even(int n);
+
+int gcd(int a, int b) {
+  if (b == 0)
+    return a;
+  return gcd(b, a % b);
+}
+
+int sum_to(int n, int acc) {
+  if (n == 0)
+    return acc;
+  return sum_to(n - 1, acc + n);
+}
+
+int is_odd(int n) {
+  if (n == 0)
+    return 0;
+  return is_even(n - 1);
+}
+
+int is_even(int n) {
+  if (n == 0)
+    return 1;
+  return is_odd(n - 1);
+}
+
+int digits(int n, int count) {
+  if (n < 10)
+    return count + 1;
+  return digits(n / 10, count + 1);
+}
+
+int main(void) {
+  int i;
+  for (i = 1; i < 10; i++) {
+    print_number(gcd(i * 84, 126));
+    print_string(" ");
+  }
+  print_string("\n");
+  print_number(sum_to(2000, 0));
+  print_string(" ");
+  print_number(is_even(777));
+  print_number(is_odd(777));
+  print_string(" ");
+  print_number(digits(2147483647, 0));
+  print_string("\n");
+  return 0;
+}
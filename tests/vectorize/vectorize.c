@@ -0,0 +1,43 @@
+void print_number(int n);
+void print_string(char *s);
+
+char a[64];
+char b[64];
+
+int checksum(void) {
+  int i, s;
+  s = 0;
+  for (i = 0; i < 64; i++) {
+    s = s * 31 % 1000003;
+    s = s + b[i];
+  }
+  return s;
+}
+
+int main(void) {
+  int i, k;
+  for (i = 0; i < 64; i++)
+    a[i] = i * 3 + 1;
+  for (i = 3; i < 61; i++)
+    b[i] = a[i] + 7;
+  print_number(checksum());
+  print_string(" ");
+  for (i = 1; i < 63; i = i + 1)
+    b[i] = a[i];
+  print_number(checksum());
+  print_string(" ");
+  k = 90;
+  for (i = 5; i < 60; i++)
+    b[i] = a[i] ^ k;
+  print_number(checksum());
+  print_string(" ");
+  for (i = 0; i < 37; i++)
+    b[i] = 120;
+  print_number(checksum());
+  print_string(" ");
+  for (i = 7; i < 47; i++)
+    b[i] = a[i] & 60;
+  print_number(checksum());
+  print_string("\n");
+  return 0;
+}